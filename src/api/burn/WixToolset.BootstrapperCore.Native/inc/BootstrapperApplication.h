@@ -361,6 +361,19 @@ struct BA_ONAPPLYBEGIN_RESULTS
 {
     DWORD cbSize;
     BOOL fCancel;
+
+    // MSI message types to not send to OnExecuteMsiMessage, one bit per type: (1 << (INSTALLMESSAGE_* >> 24)).
+    // The messages are dropped where Windows Installer raises them, including in the elevated process.
+    DWORD dwIgnoredMsiMessages;
+
+    // Minimum change in percentage between OnExecuteProgress messages while executing MSI and MSP packages.
+    // Zero sends every progress message.
+    DWORD dwMsiProgressGranularity;
+
+    // Lets per-user EXE packages authored as Independent run side by side. OnExecutePackageBegin for a package
+    // can then come before OnExecutePackageComplete for the package ahead of it, and OnExecuteProgress for the
+    // running packages interleaves. FALSE runs every package one at a time.
+    BOOL fConcurrentExePackages;
 };
 
 struct BA_ONAPPLYCOMPLETE_ARGS
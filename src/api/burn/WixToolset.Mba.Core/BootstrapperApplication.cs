@@ -1673,12 +1673,15 @@ namespace WixToolset.Mba.Core
             return args.HResult;
         }
 
-        int IBootstrapperApplication.OnApplyBegin(int dwPhaseCount, ref bool fCancel)
+        int IBootstrapperApplication.OnApplyBegin(int dwPhaseCount, ref bool fCancel, ref int dwIgnoredMsiMessages, ref int dwMsiProgressGranularity, ref bool fConcurrentExePackages)
         {
-            ApplyBeginEventArgs args = new ApplyBeginEventArgs(dwPhaseCount, fCancel);
+            ApplyBeginEventArgs args = new ApplyBeginEventArgs(dwPhaseCount, fCancel, dwIgnoredMsiMessages, dwMsiProgressGranularity, fConcurrentExePackages);
             this.OnApplyBegin(args);
 
             fCancel = args.Cancel;
+            dwIgnoredMsiMessages = args.IgnoredMsiMessages;
+            dwMsiProgressGranularity = args.MsiProgressGranularity;
+            fConcurrentExePackages = args.ConcurrentExePackages;
             return args.HResult;
         }
 
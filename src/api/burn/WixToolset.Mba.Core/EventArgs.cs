@@ -1259,10 +1259,13 @@ namespace WixToolset.Mba.Core
     public class ApplyBeginEventArgs : CancellableHResultEventArgs
     {
         /// <summary />
-        public ApplyBeginEventArgs(int phaseCount, bool cancelRecommendation)
+        public ApplyBeginEventArgs(int phaseCount, bool cancelRecommendation, int ignoredMsiMessages, int msiProgressGranularity, bool concurrentExePackages)
             : base(cancelRecommendation)
         {
             this.PhaseCount = phaseCount;
+            this.IgnoredMsiMessages = ignoredMsiMessages;
+            this.MsiProgressGranularity = msiProgressGranularity;
+            this.ConcurrentExePackages = concurrentExePackages;
         }
 
         /// <summary>
@@ -1270,6 +1273,37 @@ namespace WixToolset.Mba.Core
         /// There are currently two possible phases: cache and execute.
         /// </summary>
         public int PhaseCount { get; private set; }
+
+        /// <summary>
+        /// Gets or sets the MSI message types that <see cref="IDefaultBootstrapperApplication.ExecuteMsiMessage"/> is not raised for,
+        /// one bit per <see cref="InstallMessage"/> as set by <see cref="IgnoreMsiMessage"/>.
+        /// Ignored messages are dropped where Windows Installer raises them, so they never reach the bootstrapper application.
+        /// </summary>
+        public int IgnoredMsiMessages { get; set; }
+
+        /// <summary>
+        /// Gets or sets the minimum change in percentage between <see cref="IDefaultBootstrapperApplication.ExecuteProgress"/> events
+        /// while executing MSI and MSP packages. Zero raises the event for every progress message.
+        /// </summary>
+        public int MsiProgressGranularity { get; set; }
+
+        /// <summary>
+        /// Gets or sets whether per-user EXE packages authored as independent may run side by side.
+        /// When set, <see cref="IDefaultBootstrapperApplication.ExecutePackageBegin"/> for a package can be raised before
+        /// <see cref="IDefaultBootstrapperApplication.ExecutePackageComplete"/> for the package ahead of it, and
+        /// <see cref="IDefaultBootstrapperApplication.ExecuteProgress"/> for the running packages interleaves.
+        /// Defaults to false, which runs every package one at a time.
+        /// </summary>
+        public bool ConcurrentExePackages { get; set; }
+
+        /// <summary>
+        /// Stops <see cref="IDefaultBootstrapperApplication.ExecuteMsiMessage"/> from being raised for a type of MSI message.
+        /// </summary>
+        /// <param name="messageType">Type of MSI message to ignore.</param>
+        public void IgnoreMsiMessage(InstallMessage messageType)
+        {
+            this.IgnoredMsiMessages |= 1 << ((int)messageType >> 24);
+        }
     }
 
     /// <summary>
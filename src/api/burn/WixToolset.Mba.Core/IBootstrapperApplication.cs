@@ -10,7 +10,7 @@ namespace WixToolset.Mba.Core
     /// </summary>
     [ComImport]
     [InterfaceType(ComInterfaceType.InterfaceIsIUnknown)]
-    [Guid("53C31D56-49C0-426B-AB06-099D717C67FE")]
+    [Guid("EC68E447-8B5A-4058-938B-C252CAC21DC3")]
     public interface IBootstrapperApplication
     {
         /// <summary>
@@ -449,12 +449,18 @@ namespace WixToolset.Mba.Core
         /// </summary>
         /// <param name="dwPhaseCount"></param>
         /// <param name="fCancel"></param>
+        /// <param name="dwIgnoredMsiMessages"></param>
+        /// <param name="dwMsiProgressGranularity"></param>
+        /// <param name="fConcurrentExePackages"></param>
         /// <returns></returns>
         [PreserveSig]
         [return: MarshalAs(UnmanagedType.I4)]
         int OnApplyBegin(
             [MarshalAs(UnmanagedType.U4)] int dwPhaseCount,
-            [MarshalAs(UnmanagedType.Bool)] ref bool fCancel
+            [MarshalAs(UnmanagedType.Bool)] ref bool fCancel,
+            [MarshalAs(UnmanagedType.U4)] ref int dwIgnoredMsiMessages,
+            [MarshalAs(UnmanagedType.U4)] ref int dwMsiProgressGranularity,
+            [MarshalAs(UnmanagedType.Bool)] ref bool fConcurrentExePackages
             );
 
         /// <summary>
@@ -378,7 +378,10 @@ public: // IBootstrapperApplication
 
     virtual STDMETHODIMP OnApplyBegin(
         __in DWORD /*dwPhaseCount*/,
-        __inout BOOL* /*pfCancel*/
+        __inout BOOL* /*pfCancel*/,
+        __inout DWORD* /*pdwIgnoredMsiMessages*/,
+        __inout DWORD* /*pdwMsiProgressGranularity*/,
+        __inout BOOL* /*pfConcurrentExePackages*/
         )
     {
         return S_OK;
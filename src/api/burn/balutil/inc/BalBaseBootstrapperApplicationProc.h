@@ -258,7 +258,7 @@ static HRESULT BalBaseBAProcOnApplyBegin(
     __inout BA_ONAPPLYBEGIN_RESULTS* pResults
     )
 {
-    return pBA->OnApplyBegin(pArgs->dwPhaseCount, &pResults->fCancel);
+    return pBA->OnApplyBegin(pArgs->dwPhaseCount, &pResults->fCancel, &pResults->dwIgnoredMsiMessages, &pResults->dwMsiProgressGranularity, &pResults->fConcurrentExePackages);
 }
 
 static HRESULT BalBaseBAProcOnElevateBegin(
@@ -2,7 +2,7 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
 
 
-DECLARE_INTERFACE_IID_(IBootstrapperApplication, IUnknown, "53C31D56-49C0-426B-AB06-099D717C67FE")
+DECLARE_INTERFACE_IID_(IBootstrapperApplication, IUnknown, "EC68E447-8B5A-4058-938B-C252CAC21DC3")
 {
     // BAProc - The PFN_BOOTSTRAPPER_APPLICATION_PROC can call this method to give the BA raw access to the callback from the engine.
     //          This might be used to help the BA support more than one version of the engine.
@@ -270,10 +270,17 @@ DECLARE_INTERFACE_IID_(IBootstrapperApplication, IUnknown, "53C31D56-49C0-426B-A
         ) = 0;
 
     // OnApplyBegin - called when the engine begins applying the plan.
-    //
+    //                The BA can name the MSI message types it ignores and
+    //                how coarse MSI progress may be, so they are dropped
+    //                before they are sent. It can also let independent
+    //                EXE packages run side by side, in which case their
+    //                execute callbacks interleave.
     STDMETHOD(OnApplyBegin)(
         __in DWORD dwPhaseCount,
-        __inout BOOL* pfCancel
+        __inout BOOL* pfCancel,
+        __inout DWORD* pdwIgnoredMsiMessages,
+        __inout DWORD* pdwMsiProgressGranularity,
+        __inout BOOL* pfConcurrentExePackages
         ) = 0;
 
     // OnElevateBegin - called before the engine displays an elevation prompt.
@@ -57,6 +57,7 @@ namespace WixToolset.Data.Symbols
         None = 0,
         Bundle = 1,
         ArpWin64 = 2,
+        Independent = 4,
     }
 
     public class WixBundleExePackageSymbol : IntermediateSymbol
@@ -157,6 +158,22 @@ namespace WixToolset.Data.Symbols
             }
         }
 
+        public bool Independent
+        {
+            get { return this.Attributes.HasFlag(WixBundleExePackageAttributes.Independent); }
+            set
+            {
+                if (value)
+                {
+                    this.Attributes |= WixBundleExePackageAttributes.Independent;
+                }
+                else
+                {
+                    this.Attributes &= ~WixBundleExePackageAttributes.Independent;
+                }
+            }
+        }
+
         public bool Repairable => this.RepairCommand != null;
 
         public bool Uninstallable => this.UninstallCommand != null;
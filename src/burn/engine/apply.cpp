@@ -10,6 +10,7 @@
 #endif
 
 const DWORD BURN_CACHE_MAX_RECOMMENDED_VERIFY_TRYAGAIN_ATTEMPTS = 2;
+const DWORD BURN_EXECUTE_MAX_CONCURRENT_EXE_PACKAGES = 4;
 
 enum BURN_CACHE_PROGRESS_TYPE
 {
@@ -66,6 +67,23 @@ typedef struct _BURN_EXECUTE_CONTEXT
     BOOL fAbandonedProcess;
 } BURN_EXECUTE_CONTEXT;
 
+typedef struct _BURN_CONCURRENT_EXE_PACKAGE
+{
+    BURN_EXECUTE_ACTION* pWaitCacheAction;
+    BURN_EXECUTE_ACTION* pExecuteAction;
+    DWORD iExecuteAction;
+    BURN_EXECUTE_ACTION* pCheckpointAction;
+    DWORD iCheckpointAction;
+
+    BURN_EXE_PROCESS process;
+    BOOL fBeginCalled;
+    BOOL fExecuted;
+    BOOL fRunning;
+    BOOL fAbandonedProcess;
+    HRESULT hrOverall;
+    HRESULT hrExecute;
+} BURN_CONCURRENT_EXE_PACKAGE;
+
 
 // internal function declarations
 static HRESULT WINAPI AuthenticationRequired(
@@ -218,6 +236,51 @@ static BOOL ShouldSkipPackage(
     __in BURN_PACKAGE* pPackage,
     __in BOOL fRollback
     );
+static DWORD CountConcurrentExePackages(
+    __in BURN_PLAN* pPlan,
+    __in DWORD iAction
+    );
+static BOOL ReadConcurrentExePackage(
+    __in BURN_PLAN* pPlan,
+    __inout DWORD* piAction,
+    __out BURN_CONCURRENT_EXE_PACKAGE* pConcurrentPackage
+    );
+static BURN_EXECUTE_ACTION* NextExecuteAction(
+    __in BURN_PLAN* pPlan,
+    __inout DWORD* piAction
+    );
+static BOOL IsIndependentExePackage(
+    __in BURN_PACKAGE* pPackage
+    );
+static BURN_CONCURRENT_EXE_PACKAGE* NextConcurrentExePackage(
+    __in_ecount(cPackages) BURN_CONCURRENT_EXE_PACKAGE* rgPackages,
+    __in DWORD cPackages,
+    __in DWORD iComplete,
+    __in DWORD iLaunch
+    );
+static HRESULT ExecuteConcurrentExePackages(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in DWORD cPackages,
+    __inout DWORD* piAction,
+    __inout BURN_EXECUTE_ACTION_CHECKPOINT** ppCheckpoint,
+    __out BOOL* pfSuspend,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart
+    );
+static HRESULT LaunchConcurrentExePackage(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in_z LPCWSTR wzOutputFolder,
+    __in BURN_CONCURRENT_EXE_PACKAGE* pConcurrentPackage
+    );
+static HRESULT CompleteConcurrentExePackage(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in BURN_CONCURRENT_EXE_PACKAGE* pConcurrentPackage,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart,
+    __out BOOL* pfRetry,
+    __out BOOL* pfSuspend
+    );
 static HRESULT ExecuteRelatedBundle(
     __in BURN_ENGINE_STATE* pEngineState,
     __in BURN_EXECUTE_ACTION* pExecuteAction,
@@ -452,6 +515,9 @@ extern "C" HRESULT ApplyRegister(
     {
         hr = ElevationSessionBegin(pEngineState->companionConnection.hPipe, sczEngineWorkingPath, pEngineState->registration.sczResumeCommandLine, pEngineState->registration.fDisableResume, &pEngineState->variables, pEngineState->plan.dwRegistrationOperations, pEngineState->registration.fDetectedForeignProviderKeyBundleId, qwEstimatedSize, registrationType);
         ExitOnFailure(hr, "Failed to begin registration session in per-machine process.");
+
+        // This process tracks what was saved to the state file, so start it over like the per-machine process did.
+        RegistrationResetStateJournal(&pEngineState->registration);
     }
     else
     {
@@ -548,6 +614,11 @@ extern "C" HRESULT ApplyUnregister(
     {
         hr = ElevationSessionEnd(pEngineState->companionConnection.hPipe, resumeMode, restart, pEngineState->registration.fDetectedForeignProviderKeyBundleId, qwEstimatedSize, registrationType);
         ExitOnFailure(hr, "Failed to end session in per-machine process.");
+
+        if (BURN_RESUME_MODE_NONE == resumeMode)
+        {
+            RegistrationResetStateJournal(&pEngineState->registration);
+        }
     }
     else
     {
@@ -705,6 +776,7 @@ extern "C" HRESULT ApplyExecute(
     BURN_EXECUTE_ACTION_CHECKPOINT* pCheckpoint = NULL;
     BURN_EXECUTE_CONTEXT context = { };
     BOOL fSeekRollbackBoundaryEnd = FALSE;
+    DWORD cConcurrentPackages = 0;
 
     context.pCache = pEngineState->plan.pCache;
     context.pUX = &pEngineState->userExperience;
@@ -768,8 +840,21 @@ extern "C" HRESULT ApplyExecute(
             fSeekRollbackBoundaryEnd = FALSE;
         }
 
-        // Execute the action.
-        hr = DoExecuteAction(pEngineState, pExecuteAction, &context, &pCheckpoint, pfSuspend, pRestart);
+        // Execute the action, running independent EXE packages side by side when the BA allowed it and there are several in a row.
+        cConcurrentPackages = 0;
+        if (pEngineState->userExperience.fConcurrentExePackages && !(pCheckpoint && pCheckpoint->pActiveRollbackBoundary && pCheckpoint->pActiveRollbackBoundary->fActiveTransaction))
+        {
+            cConcurrentPackages = CountConcurrentExePackages(&pEngineState->plan, i);
+        }
+
+        if (1 < cConcurrentPackages)
+        {
+            hr = ExecuteConcurrentExePackages(pEngineState, &context, cConcurrentPackages, &i, &pCheckpoint, pfSuspend, pRestart);
+        }
+        else
+        {
+            hr = DoExecuteAction(pEngineState, pExecuteAction, &context, &pCheckpoint, pfSuspend, pRestart);
+        }
 
         if (*pfSuspend || BOOTSTRAPPER_APPLY_RESTART_INITIATED == *pRestart)
         {
@@ -1319,7 +1404,8 @@ static HRESULT ApplyCacheVerifyContainerOrPayload(
     }
     else
     {
-        hr = CacheVerifyPayload(pPayloadGroupItem->pPayload, pContext->wzLayoutDirectory ? pContext->wzLayoutDirectory : pPackage->sczCacheFolder, CacheMessageHandler, CacheProgressRoutine, &progress);
+        // Layouts don't use the content store.
+        hr = CacheVerifyPayload(pContext->wzLayoutDirectory ? NULL : pContext->pCache, pPackage && pPackage->fPerMachine, pPayloadGroupItem->pPayload, pContext->wzLayoutDirectory ? pContext->wzLayoutDirectory : pPackage->sczCacheFolder, CacheMessageHandler, CacheProgressRoutine, &progress);
     }
 
     return hr;
@@ -2721,6 +2807,501 @@ LExit:
     return fSkip;
 }
 
+static DWORD CountConcurrentExePackages(
+    __in BURN_PLAN* pPlan,
+    __in DWORD iAction
+    )
+{
+    DWORD cPackages = 0;
+    BURN_CONCURRENT_EXE_PACKAGE concurrentPackage = { };
+
+    while (ReadConcurrentExePackage(pPlan, &iAction, &concurrentPackage))
+    {
+        ++cPackages;
+    }
+
+    return cPackages;
+}
+
+//
+// ReadConcurrentExePackage - reads the actions planned for an independent EXE package:
+//                            an optional cache wait, the package itself and its checkpoint.
+//
+static BOOL ReadConcurrentExePackage(
+    __in BURN_PLAN* pPlan,
+    __inout DWORD* piAction,
+    __out BURN_CONCURRENT_EXE_PACKAGE* pConcurrentPackage
+    )
+{
+    BOOL fRead = FALSE;
+    DWORD iAction = *piAction;
+    BURN_EXECUTE_ACTION* pAction = NextExecuteAction(pPlan, &iAction);
+
+    memset(pConcurrentPackage, 0, sizeof(BURN_CONCURRENT_EXE_PACKAGE));
+
+    if (pAction && BURN_EXECUTE_ACTION_TYPE_WAIT_CACHE_PACKAGE == pAction->type)
+    {
+        pConcurrentPackage->pWaitCacheAction = pAction;
+
+        ++iAction;
+        pAction = NextExecuteAction(pPlan, &iAction);
+    }
+
+    if (!pAction || BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE != pAction->type || !IsIndependentExePackage(pAction->exePackage.pPackage) ||
+        pConcurrentPackage->pWaitCacheAction && pConcurrentPackage->pWaitCacheAction->waitCachePackage.pPackage != pAction->exePackage.pPackage)
+    {
+        ExitFunction();
+    }
+
+    pConcurrentPackage->pExecuteAction = pAction;
+    pConcurrentPackage->iExecuteAction = iAction;
+
+    ++iAction;
+    pAction = NextExecuteAction(pPlan, &iAction);
+
+    if (!pAction || BURN_EXECUTE_ACTION_TYPE_CHECKPOINT != pAction->type)
+    {
+        ExitFunction();
+    }
+
+    pConcurrentPackage->pCheckpointAction = pAction;
+    pConcurrentPackage->iCheckpointAction = iAction;
+
+    *piAction = iAction + 1;
+    fRead = TRUE;
+
+LExit:
+    return fRead;
+}
+
+static BURN_EXECUTE_ACTION* NextExecuteAction(
+    __in BURN_PLAN* pPlan,
+    __inout DWORD* piAction
+    )
+{
+    for (; *piAction < pPlan->cExecuteActions; ++*piAction)
+    {
+        if (!pPlan->rgExecuteActions[*piAction].fDeleted)
+        {
+            return pPlan->rgExecuteActions + *piAction;
+        }
+    }
+
+    return NULL;
+}
+
+//
+// IsIndependentExePackage - only per-user packages that were authored as independent and
+//                           can't need rollback or initiate a restart may run side by side.
+//                           Per-machine packages go through the elevated companion one at a time.
+//
+static BOOL IsIndependentExePackage(
+    __in BURN_PACKAGE* pPackage
+    )
+{
+    if (!pPackage->Exe.fIndependent || pPackage->fPerMachine || pPackage->Exe.fBundle || pPackage->Exe.fPseudoPackage || pPackage->Exe.fFireAndForget ||
+        BURN_EXE_PROTOCOL_TYPE_NONE != pPackage->Exe.protocol || BOOTSTRAPPER_ACTION_STATE_NONE != pPackage->rollback)
+    {
+        return FALSE;
+    }
+
+    for (DWORD i = 0; i < pPackage->Exe.cExitCodes; ++i)
+    {
+        switch (pPackage->Exe.rgExitCodes[i].type)
+        {
+        case BURN_EXE_EXIT_CODE_TYPE_SCHEDULE_REBOOT: __fallthrough;
+        case BURN_EXE_EXIT_CODE_TYPE_FORCE_REBOOT: __fallthrough;
+        case BURN_EXE_EXIT_CODE_TYPE_ERROR_SCHEDULE_REBOOT: __fallthrough;
+        case BURN_EXE_EXIT_CODE_TYPE_ERROR_FORCE_REBOOT:
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+//
+// NextConcurrentExePackage - returns the next package to start, or NULL when there are no more
+//                            or a vital package before it hasn't completed. A vital package that
+//                            fails stops the chain, so nothing after it may have started.
+//
+static BURN_CONCURRENT_EXE_PACKAGE* NextConcurrentExePackage(
+    __in_ecount(cPackages) BURN_CONCURRENT_EXE_PACKAGE* rgPackages,
+    __in DWORD cPackages,
+    __in DWORD iComplete,
+    __in DWORD iLaunch
+    )
+{
+    for (DWORD i = iComplete; i < iLaunch; ++i)
+    {
+        if (rgPackages[i].pExecuteAction->exePackage.pPackage->fVital)
+        {
+            return NULL;
+        }
+    }
+
+    return iLaunch < cPackages ? rgPackages + iLaunch : NULL;
+}
+
+//
+// ExecuteConcurrentExePackages - runs a sequence of independent EXE packages with up to
+//                                BURN_EXECUTE_MAX_CONCURRENT_EXE_PACKAGES processes at a time.
+//                                Only used when the BA set fConcurrentExePackages in OnApplyBegin,
+//                                because OnExecutePackageBegin for a package can then come before
+//                                OnExecutePackageComplete for the one ahead of it, and progress for
+//                                the running packages interleaves. Packages are still started and
+//                                completed in chain order, so the checkpoints and the exit code
+//                                handling see the same results as when they run one at a time.
+//                                Once a package fails or asks to suspend or restart no more packages
+//                                are started, but the ones already running are waited for and reported.
+//
+static HRESULT ExecuteConcurrentExePackages(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in DWORD cPackages,
+    __inout DWORD* piAction,
+    __inout BURN_EXECUTE_ACTION_CHECKPOINT** ppCheckpoint,
+    __out BOOL* pfSuspend,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrStop = S_OK;
+    BURN_CONCURRENT_EXE_PACKAGE* rgPackages = NULL;
+    BURN_CONCURRENT_EXE_PACKAGE* pConcurrentPackage = NULL;
+    BURN_CONCURRENT_EXE_PACKAGE* pNextPackage = NULL;
+    HANDLE rghWait[BURN_EXECUTE_MAX_CONCURRENT_EXE_PACKAGES + 2] = { };
+    LPWSTR sczOutputFolder = NULL;
+    DWORD iAction = *piAction;
+    DWORD iLaunch = 0;
+    DWORD iComplete = 0;
+    DWORD iCompleteStart = 0;
+    DWORD cRunning = 0;
+    DWORD cWait = 0;
+    DWORD dwSignaledIndex = 0;
+    DWORD dwExitCode = 0;
+    BOOL fWaitCache = FALSE;
+    BOOL fStop = FALSE;
+    BOOL fRetry = FALSE;
+    BOOL fSuspend = FALSE;
+    BOOTSTRAPPER_APPLY_RESTART restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+
+    pContext->fRollback = FALSE;
+
+    rgPackages = static_cast<BURN_CONCURRENT_EXE_PACKAGE*>(MemAlloc(sizeof(BURN_CONCURRENT_EXE_PACKAGE) * cPackages, TRUE));
+    ExitOnNull(rgPackages, hr, E_OUTOFMEMORY, "Failed to allocate independent EXE packages.");
+
+    for (DWORD i = 0; i < cPackages; ++i)
+    {
+        ReadConcurrentExePackage(&pEngineState->plan, &iAction, rgPackages + i);
+    }
+
+    hr = CacheEnsureBaseWorkingFolder(pContext->pCache, &sczOutputFolder);
+    ExitOnFailure(hr, "Failed to create working folder for package output.");
+
+    LogId(REPORT_STANDARD, MSG_APPLY_CONCURRENT_EXE_PACKAGES, cPackages, BURN_EXECUTE_MAX_CONCURRENT_EXE_PACKAGES, rgPackages[0].pExecuteAction->exePackage.pPackage->sczId);
+
+    for (;;)
+    {
+        // Start packages in chain order until the limit is reached, a package isn't cached yet or a vital package has to finish first.
+        pNextPackage = fStop ? NULL : NextConcurrentExePackage(rgPackages, cPackages, iComplete, iLaunch);
+
+        while (pNextPackage && BURN_EXECUTE_MAX_CONCURRENT_EXE_PACKAGES > cRunning)
+        {
+            if (pNextPackage->pWaitCacheAction)
+            {
+                BURN_PACKAGE* pCachePackage = pNextPackage->pWaitCacheAction->waitCachePackage.pPackage;
+                pCachePackage->fReachedExecution = TRUE;
+
+                if (WAIT_TIMEOUT == ::WaitForSingleObject(pCachePackage->hCacheEvent, 0))
+                {
+                    break;
+                }
+            }
+
+            LaunchConcurrentExePackage(pEngineState, pContext, sczOutputFolder, pNextPackage);
+
+            if (pNextPackage->fRunning)
+            {
+                ++cRunning;
+            }
+
+            ++iLaunch;
+            pNextPackage = NextConcurrentExePackage(rgPackages, cPackages, iComplete, iLaunch);
+        }
+
+        // Complete packages in chain order as soon as they and everything before them are done.
+        iCompleteStart = iComplete;
+
+        while (iComplete < iLaunch && !rgPackages[iComplete].fRunning)
+        {
+            pConcurrentPackage = rgPackages + iComplete;
+            restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+
+            hr = CompleteConcurrentExePackage(pEngineState, pContext, pConcurrentPackage, &restart, &fRetry, &fSuspend);
+
+            if (*pRestart < restart)
+            {
+                *pRestart = restart;
+            }
+
+            ++iComplete;
+
+            // Once stopping, the packages that were already running are only reported.
+            if (fStop)
+            {
+                continue;
+            }
+
+            if (SUCCEEDED(hr) && fRetry)
+            {
+                hr = DoExecuteAction(pEngineState, pConcurrentPackage->pExecuteAction, pContext, ppCheckpoint, pfSuspend, pRestart);
+            }
+            else
+            {
+                *pfSuspend = fSuspend;
+            }
+
+            if (FAILED(hr) || *pfSuspend || BOOTSTRAPPER_APPLY_RESTART_INITIATED == *pRestart)
+            {
+                fStop = TRUE;
+                hrStop = hr;
+            }
+            else
+            {
+                *ppCheckpoint = &pConcurrentPackage->pCheckpointAction->checkpoint;
+            }
+        }
+
+        hr = S_OK;
+
+        if (iComplete == iLaunch && (fStop || iComplete == cPackages))
+        {
+            break;
+        }
+        else if (!fStop && iCompleteStart != iComplete)
+        {
+            // A completed vital package may have let the next one start.
+            continue;
+        }
+
+        // Wait for a running package to exit or for the next package to be cached.
+        cWait = 0;
+
+        for (DWORD i = iComplete; i < iLaunch; ++i)
+        {
+            if (rgPackages[i].fRunning)
+            {
+                rghWait[cWait++] = rgPackages[i].process.hProcess;
+            }
+        }
+
+        pNextPackage = fStop ? NULL : NextConcurrentExePackage(rgPackages, cPackages, iComplete, iLaunch);
+        fWaitCache = pNextPackage && pNextPackage->pWaitCacheAction && BURN_EXECUTE_MAX_CONCURRENT_EXE_PACKAGES > cRunning;
+
+        if (fWaitCache)
+        {
+            rghWait[cWait++] = pNextPackage->pWaitCacheAction->waitCachePackage.pPackage->hCacheEvent;
+
+            if (pContext->pApplyContext->hCacheThread)
+            {
+                rghWait[cWait++] = pContext->pApplyContext->hCacheThread;
+            }
+        }
+
+        hr = AppWaitForMultipleObjects(cWait, rghWait, FALSE, cRunning ? 500 : INFINITE, &dwSignaledIndex);
+        if (HRESULT_FROM_WIN32(WAIT_TIMEOUT) != hr)
+        {
+            ExitOnFailure(hr, "Failed to wait for independent EXE packages.");
+
+            if (fWaitCache && pContext->pApplyContext->hCacheThread && cWait - 1 == dwSignaledIndex)
+            {
+                if (!::GetExitCodeThread(pContext->pApplyContext->hCacheThread, &dwExitCode))
+                {
+                    ExitWithLastError(hr, "Failed to get cache thread exit code.");
+                }
+
+                ExitWithRootFailure(hr, E_UNEXPECTED, "Cache thread exited unexpectedly with exit code: %u.", dwExitCode);
+            }
+        }
+
+        // Send progress for every running package, which also lets the BA cancel it, and pick up the ones that exited.
+        for (DWORD i = iComplete; i < iLaunch; ++i)
+        {
+            pConcurrentPackage = rgPackages + i;
+            if (!pConcurrentPackage->fRunning)
+            {
+                continue;
+            }
+
+            pContext->wzExecutingPackageId = pConcurrentPackage->pExecuteAction->exePackage.pPackage->sczId;
+            pContext->fAbandonedProcess = pConcurrentPackage->fAbandonedProcess;
+
+            hr = ExeEngineWaitForProcess(&pConcurrentPackage->process, 0, GenericExecuteMessageHandler, pContext);
+
+            pConcurrentPackage->fAbandonedProcess = pContext->fAbandonedProcess;
+
+            if (HRESULT_FROM_WIN32(WAIT_TIMEOUT) != hr)
+            {
+                pConcurrentPackage->hrExecute = hr;
+                pConcurrentPackage->fRunning = FALSE;
+                --cRunning;
+            }
+        }
+
+        hr = S_OK;
+    }
+
+LExit:
+    if (rgPackages)
+    {
+        // Anything that was started but not completed is reported with the failure and its process abandoned.
+        for (DWORD i = iComplete; i < iLaunch; ++i)
+        {
+            pConcurrentPackage = rgPackages + i;
+            pConcurrentPackage->hrOverall = FAILED(pConcurrentPackage->hrOverall) ? pConcurrentPackage->hrOverall : hr;
+            pConcurrentPackage->fAbandonedProcess |= pConcurrentPackage->fRunning;
+            pConcurrentPackage->fRunning = FALSE;
+
+            CompleteConcurrentExePackage(pEngineState, pContext, pConcurrentPackage, &restart, &fRetry, &fSuspend);
+        }
+
+        // Continue after the last package that ran, or at the package that stopped the sequence.
+        if (SUCCEEDED(hr) && !fStop)
+        {
+            *piAction = rgPackages[cPackages - 1].iCheckpointAction;
+        }
+        else if (iLaunch)
+        {
+            *piAction = rgPackages[iLaunch - 1].iExecuteAction;
+        }
+
+        MemFree(rgPackages);
+    }
+
+    pContext->wzExecutingPackageId = NULL;
+    pContext->fAbandonedProcess = FALSE;
+
+    ReleaseStr(sczOutputFolder);
+
+    return FAILED(hr) ? hr : hrStop;
+}
+
+static HRESULT LaunchConcurrentExePackage(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in_z LPCWSTR wzOutputFolder,
+    __in BURN_CONCURRENT_EXE_PACKAGE* pConcurrentPackage
+    )
+{
+    HRESULT hr = S_OK;
+    GENERIC_EXECUTE_MESSAGE message = { };
+    int nResult = 0;
+    BURN_EXECUTE_ACTION* pExecuteAction = pConcurrentPackage->pExecuteAction;
+    BURN_PACKAGE* pPackage = pExecuteAction->exePackage.pPackage;
+
+    if (ShouldSkipPackage(pPackage, FALSE))
+    {
+        ExitFunction1(hr = S_OK);
+    }
+    else if (pConcurrentPackage->pWaitCacheAction && FAILED(pPackage->hrCacheResult))
+    {
+        // The cache sync-point was signaled but the package didn't make it into the cache, so there is nothing to launch.
+        LogId(REPORT_STANDARD, MSG_APPLY_SKIPPED_FAILED_CACHED_PACKAGE, pPackage->sczId, pPackage->hrCacheResult);
+        ExitFunction1(hr = S_OK);
+    }
+
+    pContext->wzExecutingPackageId = pPackage->sczId;
+    pContext->fAbandonedProcess = FALSE;
+    pConcurrentPackage->fBeginCalled = TRUE;
+
+    // Send package execute begin to BA.
+    hr = UserExperienceOnExecutePackageBegin(&pEngineState->userExperience, pPackage->sczId, TRUE, pExecuteAction->exePackage.action, INSTALLUILEVEL_NOCHANGE, FALSE);
+    ExitOnRootFailure(hr, "BA aborted execute EXE package begin.");
+
+    message.type = GENERIC_EXECUTE_MESSAGE_PROGRESS;
+    message.dwUIHint = MB_OKCANCEL;
+    message.progress.dwPercentage = 0;
+    nResult = GenericExecuteMessageHandler(&message, pContext);
+    hr = UserExperienceInterpretExecuteResult(&pEngineState->userExperience, FALSE, message.dwUIHint, nResult);
+    ExitOnRootFailure(hr, "BA aborted EXE progress.");
+
+    pConcurrentPackage->fExecuted = TRUE;
+
+    // Start package.
+    pConcurrentPackage->hrExecute = ExeEngineLaunchPackage(pExecuteAction, pContext->pCache, &pEngineState->variables, wzOutputFolder, GenericExecuteMessageHandler, pContext, &pConcurrentPackage->process);
+    ExitOnFailure(pConcurrentPackage->hrExecute, "Failed to start per-user EXE package.");
+
+    // Nothing was started when there was nothing to do.
+    pConcurrentPackage->hrExecute = S_OK;
+    pConcurrentPackage->fRunning = NULL != pConcurrentPackage->process.hProcess;
+
+LExit:
+    pConcurrentPackage->hrOverall = hr;
+    pConcurrentPackage->fAbandonedProcess = pContext->fAbandonedProcess;
+
+    return hr;
+}
+
+static HRESULT CompleteConcurrentExePackage(
+    __in BURN_ENGINE_STATE* pEngineState,
+    __in BURN_EXECUTE_CONTEXT* pContext,
+    __in BURN_CONCURRENT_EXE_PACKAGE* pConcurrentPackage,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart,
+    __out BOOL* pfRetry,
+    __out BOOL* pfSuspend
+    )
+{
+    HRESULT hr = pConcurrentPackage->hrOverall;
+    GENERIC_EXECUTE_MESSAGE message = { };
+    int nResult = 0;
+    BURN_PACKAGE* pPackage = pConcurrentPackage->pExecuteAction->exePackage.pPackage;
+
+    *pfRetry = FALSE;
+    *pfSuspend = FALSE;
+
+    if (!pConcurrentPackage->fBeginCalled || FAILED(hr) || FAILED(pConcurrentPackage->hrExecute))
+    {
+        ExitFunction();
+    }
+
+    pContext->wzExecutingPackageId = pPackage->sczId;
+
+    if (pConcurrentPackage->process.hProcess)
+    {
+        pConcurrentPackage->hrExecute = ExeEngineCompleteProcess(&pConcurrentPackage->process, pRestart);
+        ExitOnFailure(pConcurrentPackage->hrExecute, "Failed to configure per-user EXE package.");
+    }
+
+    message.type = GENERIC_EXECUTE_MESSAGE_PROGRESS;
+    message.dwUIHint = MB_OKCANCEL;
+    message.progress.dwPercentage = 100;
+    nResult = GenericExecuteMessageHandler(&message, pContext);
+    hr = UserExperienceInterpretExecuteResult(&pEngineState->userExperience, FALSE, message.dwUIHint, nResult);
+    ExitOnRootFailure(hr, "BA aborted EXE progress.");
+
+    pContext->cExecutedPackages += 1;
+
+    hr = ReportOverallProgressTicks(&pEngineState->userExperience, FALSE, pEngineState->plan.cOverallProgressTicksTotal, pContext->pApplyContext);
+    ExitOnRootFailure(hr, "BA aborted EXE package execute progress.");
+
+LExit:
+    if (pConcurrentPackage->fExecuted)
+    {
+        ExeEngineUpdateInstallRegistrationState(pConcurrentPackage->pExecuteAction, pConcurrentPackage->hrExecute);
+    }
+
+    if (pConcurrentPackage->fBeginCalled)
+    {
+        pPackage->fAbandonedProcess = pConcurrentPackage->fAbandonedProcess;
+        hr = ExecutePackageComplete(pEngineState, pPackage->sczId, pPackage->fVital, pPackage->fAbandonedProcess, hr, pConcurrentPackage->hrExecute, FALSE, pRestart, pfRetry, pfSuspend);
+    }
+
+    ExeEngineProcessUninitialize(&pConcurrentPackage->process);
+
+    return hr;
+}
+
 static HRESULT ExecuteRelatedBundle(
     __in BURN_ENGINE_STATE* pEngineState,
     __in BURN_EXECUTE_ACTION* pExecuteAction,
@@ -3047,7 +3628,7 @@ static HRESULT ExecuteMsiPackage(
     }
     else
     {
-        hrExecute = MsiEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
+        hrExecute = MsiEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, &pEngineState->userExperience, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
         ExitOnFailure(hrExecute, "Failed to configure per-user MSI package.");
     }
 
@@ -3121,7 +3702,7 @@ static HRESULT ExecuteMspPackage(
     }
     else
     {
-        hrExecute = MspEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
+        hrExecute = MspEngineExecutePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, &pEngineState->userExperience, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
         ExitOnFailure(hrExecute, "Failed to configure per-user MSP package.");
     }
 
@@ -3526,7 +4107,7 @@ static HRESULT ExecuteUninstallMsiCompatiblePackage(
     }
     else
     {
-        hrExecute = MsiEngineUninstallCompatiblePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
+        hrExecute = MsiEngineUninstallCompatiblePackage(pEngineState->userExperience.hwndApply, pExecuteAction, pContext->pCache, &pEngineState->variables, &pEngineState->userExperience, fRollback, MsiExecuteMessageHandler, pContext, pRestart);
         ExitOnFailure(hrExecute, "Failed to uninstall per-user MSI compatible package.");
     }
 
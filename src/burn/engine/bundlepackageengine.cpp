@@ -262,7 +262,8 @@ extern "C" HRESULT BundlePackageEngineDetectPackage(
     queryContext.pPackage = pPackage;
     queryContext.pUserExperience = pUserExperience;
 
-    hr = BundleQueryRelatedBundles(
+    hr = BundleSnapshotQueryRelatedBundles(
+        pRegistration->hBundleSnapshot,
         BUNDLE_INSTALL_CONTEXT_MACHINE,
         const_cast<LPCWSTR*>(pPackage->Bundle.rgsczDetectCodes),
         pPackage->Bundle.cDetectCodes,
@@ -276,7 +277,8 @@ extern "C" HRESULT BundlePackageEngineDetectPackage(
         &queryContext);
     ExitOnFailure(hr, "Failed to query per-machine related bundle packages.");
 
-    hr = BundleQueryRelatedBundles(
+    hr = BundleSnapshotQueryRelatedBundles(
+        pRegistration->hBundleSnapshot,
         BUNDLE_INSTALL_CONTEXT_USER,
         const_cast<LPCWSTR*>(pPackage->Bundle.rgsczDetectCodes),
         pPackage->Bundle.cDetectCodes,
@@ -6,10 +6,13 @@ static const LPCWSTR BUNDLE_CLEAN_ROOM_WORKING_FOLDER_NAME = L".cr";
 static const LPCWSTR BUNDLE_WORKING_FOLDER_NAME = L".be";
 static const LPCWSTR UNVERIFIED_CACHE_FOLDER_NAME = L".unverified";
 static const LPCWSTR PACKAGE_CACHE_FOLDER_NAME = L"Package Cache";
+static const LPCWSTR CONTENT_STORE_FOLDER_NAME = L".store";
 static const DWORD FILE_OPERATION_RETRY_COUNT = 3;
 static const DWORD FILE_OPERATION_RETRY_WAIT = 2000;
+static const DWORD PAYLOAD_TRUST_LIFETIME_DEFAULT = 24 * 60 * 60;
 
 static HRESULT CacheVerifyPayloadSignature(
+    __in_opt BURN_CACHE* pCache,
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzUnverifiedPayloadPath,
     __in HANDLE hFile,
@@ -91,6 +94,7 @@ static HRESULT VerifyFileAgainstContainer(
     __in LPVOID pContext
     );
 static HRESULT VerifyFileAgainstPayload(
+    __in_opt BURN_CACHE* pCache,
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzVerifyPath,
     __in BOOL fAlreadyCached,
@@ -168,6 +172,49 @@ static HRESULT SendCacheFailureMessage(
     __in LPVOID pContext,
     __in BURN_CACHE_STEP cacheStep
     );
+static HRESULT GetContentStorePath(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
+    __in BOOL fCreate,
+    __in BURN_PAYLOAD* pPayload,
+    __deref_out_z_opt LPWSTR* psczStorePath
+    );
+static HRESULT LinkPayloadFromStore(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzCachedPath
+    );
+static HRESULT AddPayloadToStore(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzCachedPath
+    );
+static HRESULT VerifyStoreEntry(
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzStorePath
+    );
+static void RemoveUnreferencedStoreEntries(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine
+    );
+static HRESULT GetPayloadTrustValueName(
+    __in HANDLE hFile,
+    __out BY_HANDLE_FILE_INFORMATION* pFileInfo,
+    __deref_out_z LPWSTR* psczName
+    );
+static HRESULT GetIndexDirectory(
+    __in BURN_CACHE_INDEX* pIndex,
+    __in_z LPCWSTR wzDirectory,
+    __out BURN_CACHE_INDEX_DIRECTORY** ppDirectory
+    );
+static HRESULT IndexDirectory(
+    __in BURN_CACHE_INDEX_DIRECTORY* pDirectory
+    );
+static void UninitializeIndexDirectory(
+    __in BURN_CACHE_INDEX_DIRECTORY* pDirectory
+    );
 
 extern "C" HRESULT CacheInitialize(
     __in BURN_CACHE* pCache,
@@ -179,6 +226,7 @@ extern "C" HRESULT CacheInitialize(
     HRESULT hr = S_OK;
     LPWSTR sczAppData = NULL;
     BOOL fPathEqual = FALSE;
+    DWORD dwContentStore = 0;
 
     // Cache paths are initialized once so they cannot be changed while the engine is caching payloads.
     // Always construct the default machine package cache path so we can determine if we're redirected.
@@ -217,6 +265,15 @@ extern "C" HRESULT CacheInitialize(
 
     pCache->fCustomMachinePackageCache = !fPathEqual;
 
+    // Payloads verified by hash can be shared between packages through hard links into a content store.
+    hr = PolcReadNumber(POLICY_BURN_REGISTRY_PATH, L"ContentStore", 0, &dwContentStore);
+    ExitOnFailure(hr, "Failed to read ContentStore policy.");
+
+    pCache->fContentStore = 0 != dwContentStore;
+
+    hr = PolcReadNumber(POLICY_BURN_REGISTRY_PATH, L"PayloadTrustLifetime", PAYLOAD_TRUST_LIFETIME_DEFAULT, &pCache->dwPayloadTrustLifetime);
+    ExitOnFailure(hr, "Failed to read PayloadTrustLifetime policy.");
+
 
     hr = ShelGetFolder(&sczAppData, CSIDL_LOCAL_APPDATA);
     ExitOnFailure(hr, "Failed to find local %hs appdata directory.", "per-user");
@@ -1107,6 +1164,7 @@ extern "C" HRESULT CacheCompletePayload(
     )
 {
     HRESULT hr = S_OK;
+    HRESULT hrStore = S_OK;
     LPWSTR sczCachedPath = NULL;
     LPWSTR sczUnverifiedPayloadPath = NULL;
 
@@ -1114,7 +1172,7 @@ extern "C" HRESULT CacheCompletePayload(
     ExitOnFailure(hr, "Failed to get cached path for package with cache id: %ls", wzCacheId);
 
     // If the cached file matches what we expected, we're good.
-    hr = VerifyFileAgainstPayload(pPayload, sczCachedPath, TRUE, BURN_CACHE_STEP_HASH_TO_SKIP_VERIFY, pfnCacheMessageHandler, pfnProgress, pContext);
+    hr = VerifyFileAgainstPayload(fPerMachine ? pCache : NULL, pPayload, sczCachedPath, TRUE, BURN_CACHE_STEP_HASH_TO_SKIP_VERIFY, pfnCacheMessageHandler, pfnProgress, pContext);
     if (SUCCEEDED(hr))
     {
         ExitFunction();
@@ -1148,7 +1206,7 @@ extern "C" HRESULT CacheCompletePayload(
     hr = ResetPathPermissions(fPerMachine, sczUnverifiedPayloadPath);
     ExitOnFailure(hr, "Failed to reset permissions on unverified cached payload: %ls", pPayload->sczKey);
 
-    hr = VerifyFileAgainstPayload(pPayload, sczUnverifiedPayloadPath, FALSE, BURN_CACHE_STEP_HASH, pfnCacheMessageHandler, pfnProgress, pContext);
+    hr = VerifyFileAgainstPayload(fPerMachine ? pCache : NULL, pPayload, sczUnverifiedPayloadPath, FALSE, BURN_CACHE_STEP_HASH, pfnCacheMessageHandler, pfnProgress, pContext);
     LogExitOnFailure(hr, MSG_FAILED_VERIFY_PAYLOAD, "Failed to verify payload: %ls at path: %ls", pPayload->sczKey, sczUnverifiedPayloadPath, NULL);
 
     LogId(REPORT_STANDARD, MSG_VERIFIED_ACQUIRED_PAYLOAD, pPayload->sczKey, sczUnverifiedPayloadPath, fMove ? "moving" : "copying", sczCachedPath);
@@ -1158,6 +1216,16 @@ extern "C" HRESULT CacheCompletePayload(
 
     ::DecryptFileW(sczCachedPath, 0);  // Let's try to make sure it's not encrypted.
 
+    if (pCache->fContentStore)
+    {
+        // The store only saves work for later packages so not being able to add to it isn't fatal.
+        hrStore = AddPayloadToStore(pCache, fPerMachine, pPayload, sczCachedPath);
+        if (FAILED(hrStore))
+        {
+            LogId(REPORT_WARNING, MSG_FAILED_STORE_PAYLOAD, pPayload->sczKey, hrStore);
+        }
+    }
+
 LExit:
     ReleaseStr(sczUnverifiedPayloadPath);
     ReleaseStr(sczCachedPath);
@@ -1188,6 +1256,8 @@ LExit:
 }
 
 extern "C" HRESULT CacheVerifyPayload(
+    __in_opt BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzCachedDirectory,
     __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
@@ -1201,7 +1271,31 @@ extern "C" HRESULT CacheVerifyPayload(
     hr = PathConcatRelativeToFullyQualifiedBase(wzCachedDirectory, pPayload->sczFilePath, &sczCachedPath);
     ExitOnFailure(hr, "Failed to concat complete cached path.");
 
-    hr = VerifyFileAgainstPayload(pPayload, sczCachedPath, TRUE, BURN_CACHE_STEP_HASH_TO_SKIP_ACQUIRE, pfnCacheMessageHandler, pfnProgress, pContext);
+    // A payload that is already in the content store is linked into the package instead of being acquired and verified again.
+    // Only a store miss or a failure to find or link the entry falls back to verifying the cached path, the BA aborting doesn't.
+    if (pCache && pCache->fContentStore && !FileExistsEx(sczCachedPath, NULL))
+    {
+        hr = LinkPayloadFromStore(pCache, fPerMachine, pPayload, sczCachedPath);
+        if (FAILED(hr))
+        {
+            LogId(REPORT_WARNING, MSG_FAILED_LINK_STORED_PAYLOAD, pPayload->sczKey, hr);
+        }
+        else if (S_OK == hr)
+        {
+            // The entry was verified when it was added to the store so there is nothing to hash.
+            hr = SendCacheBeginMessage(pfnCacheMessageHandler, pContext, BURN_CACHE_STEP_HASH_TO_SKIP_ACQUIRE);
+            if (SUCCEEDED(hr))
+            {
+                hr = SendCacheSuccessMessage(pfnCacheMessageHandler, pContext, pPayload->qwFileSize);
+            }
+            SendCacheCompleteMessage(pfnCacheMessageHandler, pContext, hr);
+            ExitOnFailure(hr, "Aborted linking payload from content store: %ls", pPayload->sczKey);
+
+            ExitFunction();
+        }
+    }
+
+    hr = VerifyFileAgainstPayload(fPerMachine ? pCache : NULL, pPayload, sczCachedPath, TRUE, BURN_CACHE_STEP_HASH_TO_SKIP_ACQUIRE, pfnCacheMessageHandler, pfnProgress, pContext);
 
 LExit:
     ReleaseStr(sczCachedPath);
@@ -1257,6 +1351,7 @@ LExit:
 }
 
 static HRESULT CacheVerifyPayloadSignature(
+    __in_opt BURN_CACHE* pCache,
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzUnverifiedPayloadPath,
     __in HANDLE hFile,
@@ -1267,8 +1362,10 @@ static HRESULT CacheVerifyPayloadSignature(
     )
 {
     HRESULT hr = S_OK;
+    HRESULT hrTrust = S_OK;
     LONG er = ERROR_SUCCESS;
     BOOL fFailedVerification = FALSE;
+    BOOL fTrusted = FALSE;
 
     GUID guidAuthenticode = WINTRUST_ACTION_GENERIC_VERIFY_V2;
     WINTRUST_FILE_INFO wfi = { };
@@ -1281,6 +1378,27 @@ static HRESULT CacheVerifyPayloadSignature(
 
     fFailedVerification = TRUE;
 
+    // If this exact file already passed verification recently, don't build the certificate chain again.
+    if (pCache && pCache->dwPayloadTrustLifetime)
+    {
+        hrTrust = CachePayloadTrustRead(pCache, pPayload, hFile, &fTrusted);
+        if (FAILED(hrTrust))
+        {
+            TraceError(hrTrust, "Failed to read previous verification of payload: %ls", pPayload->sczKey);
+        }
+
+        if (fTrusted)
+        {
+            ++pCache->cPayloadTrustHits;
+            LogId(REPORT_STANDARD, MSG_PAYLOAD_TRUST_HIT, pPayload->sczKey, wzUnverifiedPayloadPath);
+
+            ExitFunction1(fFailedVerification = FALSE);
+        }
+
+        ++pCache->cPayloadTrustMisses;
+        LogId(REPORT_VERBOSE, MSG_PAYLOAD_TRUST_MISS, pPayload->sczKey, wzUnverifiedPayloadPath);
+    }
+
     // Verify the payload assuming online.
     wfi.cbStruct = sizeof(wfi);
     wfi.pcwszFilePath = wzUnverifiedPayloadPath;
@@ -1314,9 +1432,21 @@ static HRESULT CacheVerifyPayloadSignature(
 
     fFailedVerification = FALSE;
 
-    hr = SendCacheSuccessMessage(pfnCacheMessageHandler, pContext, pPayload->qwFileSize);
+    if (pCache && pCache->dwPayloadTrustLifetime)
+    {
+        hrTrust = CachePayloadTrustWrite(pPayload, hFile);
+        if (FAILED(hrTrust))
+        {
+            TraceError(hrTrust, "Failed to remember verification of payload: %ls", pPayload->sczKey);
+        }
+    }
 
 LExit:
+    if (SUCCEEDED(hr) && !fFailedVerification)
+    {
+        hr = SendCacheSuccessMessage(pfnCacheMessageHandler, pContext, pPayload->qwFileSize);
+    }
+
     if (fFailedVerification)
     {
         // Make sure the BA process marks this payload as having failed verification.
@@ -1346,7 +1476,19 @@ extern "C" void CacheCleanup(
     hr = CacheGetCompletedPath(pCache, fPerMachine, UNVERIFIED_CACHE_FOLDER_NAME, &sczFolder);
     if (SUCCEEDED(hr))
     {
-        hr = DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_SCHEDULE);
+        hr = DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_SCHEDULE | DIR_DELETE_PARALLEL);
+    }
+
+    if (pCache->fContentStore)
+    {
+        RemoveUnreferencedStoreEntries(pCache, fPerMachine);
+    }
+
+    if (fPerMachine && pCache->dwPayloadTrustLifetime)
+    {
+        LogId(REPORT_STANDARD, MSG_PAYLOAD_TRUST_SUMMARY, pCache->cPayloadTrustHits, pCache->cPayloadTrustMisses);
+
+        CachePayloadTrustRemoveExpired(pCache);
     }
 
     if (!fPerMachine)
@@ -1408,9 +1550,275 @@ extern "C" void CacheUninitialize(
     ReleaseStr(pCache->sczAcquisitionFolder);
     ReleaseStr(pCache->sczSourceProcessFolder);
 
+    CacheIndexReset(&pCache->index);
+
     memset(pCache, 0, sizeof(BURN_CACHE));
 }
 
+extern "C" HRESULT CacheIndexDirectoryExists(
+    __in BURN_CACHE_INDEX* pIndex,
+    __in_z LPCWSTR wzDirectory,
+    __out BOOL* pfExists
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_CACHE_INDEX_DIRECTORY* pDirectory = NULL;
+
+    hr = GetIndexDirectory(pIndex, wzDirectory, &pDirectory);
+    ExitOnFailure(hr, "Failed to index directory: %ls", wzDirectory);
+
+    *pfExists = pDirectory->fExists;
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT CacheIndexFileExists(
+    __in BURN_CACHE_INDEX* pIndex,
+    __in_z LPCWSTR wzPath,
+    __out BOOL* pfExists,
+    __out_opt DWORD64* pqwFileSize
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczDirectory = NULL;
+    BURN_CACHE_INDEX_DIRECTORY* pDirectory = NULL;
+    BURN_CACHE_INDEX_ENTRY* pEntry = NULL;
+
+    *pfExists = FALSE;
+
+    hr = PathGetDirectory(wzPath, &sczDirectory);
+    ExitOnFailure(hr, "Failed to get directory of path: %ls", wzPath);
+
+    if (S_FALSE == hr)
+    {
+        ExitWithRootFailure(hr, E_INVALIDARG, "Cache index requires a full path: %ls", wzPath);
+    }
+
+    hr = GetIndexDirectory(pIndex, sczDirectory, &pDirectory);
+    ExitOnFailure(hr, "Failed to index directory: %ls", sczDirectory);
+
+    if (pDirectory->sdhEntries)
+    {
+        hr = DictGetValue(pDirectory->sdhEntries, PathFile(wzPath), reinterpret_cast<void**>(&pEntry));
+        if (E_NOTFOUND == hr)
+        {
+            hr = S_OK;
+        }
+        else
+        {
+            ExitOnFailure(hr, "Failed to find file in cache index: %ls", wzPath);
+
+            *pfExists = !pEntry->fDirectory;
+        }
+    }
+
+    if (pqwFileSize)
+    {
+        *pqwFileSize = *pfExists ? pEntry->qwFileSize : 0;
+    }
+
+LExit:
+    ReleaseStr(sczDirectory);
+
+    return hr;
+}
+
+extern "C" void CacheIndexReset(
+    __in BURN_CACHE_INDEX* pIndex
+    )
+{
+    for (DWORD i = 0; i < pIndex->cDirectories; ++i)
+    {
+        UninitializeIndexDirectory(pIndex->rgpDirectories[i]);
+        MemFree(pIndex->rgpDirectories[i]);
+    }
+
+    ReleaseMem(pIndex->rgpDirectories);
+    ReleaseDict(pIndex->sdhDirectories);
+
+    memset(pIndex, 0, sizeof(BURN_CACHE_INDEX));
+}
+
+extern "C" HRESULT CachePayloadTrustRead(
+    __in BURN_CACHE* pCache,
+    __in BURN_PAYLOAD* pPayload,
+    __in HANDLE hFile,
+    __out BOOL* pfTrusted
+    )
+{
+    HRESULT hr = S_OK;
+    HKEY hk = NULL;
+    LPWSTR sczName = NULL;
+    BYTE* pbRecord = NULL;
+    SIZE_T cbRecord = 0;
+    BY_HANDLE_FILE_INFORMATION fileInfo = { };
+
+    *pfTrusted = FALSE;
+
+    hr = GetPayloadTrustValueName(hFile, &fileInfo, &sczName);
+    ExitOnFailure(hr, "Failed to get payload trust value name.");
+
+    hr = RegOpen(HKEY_LOCAL_MACHINE, BURN_PAYLOAD_TRUST_REGISTRY_PATH, KEY_QUERY_VALUE, &hk);
+    if (E_FILENOTFOUND == hr)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+    ExitOnFailure(hr, "Failed to open payload trust key.");
+
+    hr = RegReadBinary(hk, sczName, &pbRecord, &cbRecord);
+    if (E_FILENOTFOUND == hr)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+    ExitOnFailure(hr, "Failed to read payload trust value: %ls", sczName);
+
+    *pfTrusted = sizeof(BURN_PAYLOAD_TRUST_RECORD) == cbRecord && CachePayloadTrustIsRecordValid(pCache, reinterpret_cast<BURN_PAYLOAD_TRUST_RECORD*>(pbRecord), pPayload, &fileInfo);
+
+LExit:
+    ReleaseMem(pbRecord);
+    ReleaseStr(sczName);
+    ReleaseRegKey(hk);
+
+    return hr;
+}
+
+extern "C" HRESULT CachePayloadTrustWrite(
+    __in BURN_PAYLOAD* pPayload,
+    __in HANDLE hFile
+    )
+{
+    HRESULT hr = S_OK;
+    HKEY hk = NULL;
+    LPWSTR sczName = NULL;
+    BY_HANDLE_FILE_INFORMATION fileInfo = { };
+    BURN_PAYLOAD_TRUST_RECORD record = { };
+
+    if (sizeof(record.rgbCertificateRootPublicKeyIdentifier) < pPayload->cbCertificateRootPublicKeyIdentifier ||
+        sizeof(record.rgbCertificateRootThumbprint) < pPayload->cbCertificateRootThumbprint)
+    {
+        ExitFunction();
+    }
+
+    hr = GetPayloadTrustValueName(hFile, &fileInfo, &sczName);
+    ExitOnFailure(hr, "Failed to get payload trust value name.");
+
+    record.qwFileSize = (static_cast<DWORD64>(fileInfo.nFileSizeHigh) << 32) | fileInfo.nFileSizeLow;
+    record.ftLastWrite = fileInfo.ftLastWriteTime;
+    ::GetSystemTimeAsFileTime(&record.ftVerified);
+
+    record.cbCertificateRootPublicKeyIdentifier = pPayload->cbCertificateRootPublicKeyIdentifier;
+    memcpy(record.rgbCertificateRootPublicKeyIdentifier, pPayload->pbCertificateRootPublicKeyIdentifier, pPayload->cbCertificateRootPublicKeyIdentifier);
+
+    record.cbCertificateRootThumbprint = pPayload->cbCertificateRootThumbprint;
+    if (pPayload->pbCertificateRootThumbprint)
+    {
+        memcpy(record.rgbCertificateRootThumbprint, pPayload->pbCertificateRootThumbprint, pPayload->cbCertificateRootThumbprint);
+    }
+
+    hr = RegCreate(HKEY_LOCAL_MACHINE, BURN_PAYLOAD_TRUST_REGISTRY_PATH, KEY_SET_VALUE, &hk);
+    ExitOnFailure(hr, "Failed to create payload trust key.");
+
+    hr = RegWriteBinary(hk, sczName, reinterpret_cast<BYTE*>(&record), sizeof(record));
+    ExitOnFailure(hr, "Failed to write payload trust value: %ls", sczName);
+
+LExit:
+    ReleaseStr(sczName);
+    ReleaseRegKey(hk);
+
+    return hr;
+}
+
+extern "C" BOOL CachePayloadTrustIsRecordValid(
+    __in BURN_CACHE* pCache,
+    __in const BURN_PAYLOAD_TRUST_RECORD* pRecord,
+    __in_opt BURN_PAYLOAD* pPayload,
+    __in_opt const BY_HANDLE_FILE_INFORMATION* pFileInfo
+    )
+{
+    FILETIME ftNow = { };
+    ULARGE_INTEGER uliNow = { };
+    ULARGE_INTEGER uliVerified = { };
+
+    ::GetSystemTimeAsFileTime(&ftNow);
+    uliNow.LowPart = ftNow.dwLowDateTime;
+    uliNow.HighPart = ftNow.dwHighDateTime;
+    uliVerified.LowPart = pRecord->ftVerified.dwLowDateTime;
+    uliVerified.HighPart = pRecord->ftVerified.dwHighDateTime;
+
+    // FILETIMEs count 100 nanosecond intervals.
+    if (uliVerified.QuadPart > uliNow.QuadPart || uliNow.QuadPart - uliVerified.QuadPart > pCache->dwPayloadTrustLifetime * 10000000ui64)
+    {
+        return FALSE;
+    }
+
+    // The file must not have changed since it was verified...
+    if (pFileInfo &&
+        (pRecord->qwFileSize != ((static_cast<DWORD64>(pFileInfo->nFileSizeHigh) << 32) | pFileInfo->nFileSizeLow) ||
+         0 != ::CompareFileTime(&pRecord->ftLastWrite, &pFileInfo->ftLastWriteTime)))
+    {
+        return FALSE;
+    }
+
+    // ...and it must have been verified against the same certificate the payload expects now.
+    if (pPayload &&
+        (pRecord->cbCertificateRootPublicKeyIdentifier != pPayload->cbCertificateRootPublicKeyIdentifier ||
+         pRecord->cbCertificateRootThumbprint != pPayload->cbCertificateRootThumbprint ||
+         0 != memcmp(pRecord->rgbCertificateRootPublicKeyIdentifier, pPayload->pbCertificateRootPublicKeyIdentifier, pRecord->cbCertificateRootPublicKeyIdentifier) ||
+         0 != memcmp(pRecord->rgbCertificateRootThumbprint, pPayload->pbCertificateRootThumbprint, pRecord->cbCertificateRootThumbprint)))
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
+extern "C" void CachePayloadTrustRemoveExpired(
+    __in BURN_CACHE* pCache
+    )
+{
+    HRESULT hr = S_OK;
+    HKEY hk = NULL;
+    LPWSTR sczName = NULL;
+    BYTE* pbRecord = NULL;
+    SIZE_T cbRecord = 0;
+    DWORD dwIndex = 0;
+
+    hr = RegOpen(HKEY_LOCAL_MACHINE, BURN_PAYLOAD_TRUST_REGISTRY_PATH, KEY_QUERY_VALUE | KEY_SET_VALUE, &hk);
+    if (E_FILENOTFOUND == hr)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+    ExitOnFailure(hr, "Failed to open payload trust key.");
+
+    // Records for files that were removed from the cache are never read again, so drop them when they expire.
+    while (SUCCEEDED(hr = RegValueEnum(hk, dwIndex, &sczName, NULL)))
+    {
+        hr = RegReadBinary(hk, sczName, &pbRecord, &cbRecord);
+        if (SUCCEEDED(hr) && sizeof(BURN_PAYLOAD_TRUST_RECORD) == cbRecord && CachePayloadTrustIsRecordValid(pCache, reinterpret_cast<BURN_PAYLOAD_TRUST_RECORD*>(pbRecord), NULL, NULL))
+        {
+            ++dwIndex;
+        }
+        else if (ERROR_SUCCESS != ::RegDeleteValueW(hk, sczName))
+        {
+            ++dwIndex;
+        }
+
+        ReleaseNullMem(pbRecord);
+    }
+
+    if (E_NOMOREITEMS == hr)
+    {
+        hr = S_OK;
+    }
+    ExitOnFailure(hr, "Failed to enumerate payload trust values.");
+
+LExit:
+    ReleaseMem(pbRecord);
+    ReleaseStr(sczName);
+    ReleaseRegKey(hk);
+}
+
 // Internal functions.
 
 static HRESULT CalculatePotentialBaseWorkingFolders(
@@ -1771,7 +2179,7 @@ static HRESULT VerifyThenTransferPayload(
     switch (pPayload->verification)
     {
     case BURN_PAYLOAD_VERIFICATION_AUTHENTICODE:
-        hr = CacheVerifyPayloadSignature(pPayload, wzUnverifiedPayloadPath, hFile, BURN_CACHE_STEP_HASH, pfnCacheMessageHandler, pfnProgress, pContext);
+        hr = CacheVerifyPayloadSignature(NULL, pPayload, wzUnverifiedPayloadPath, hFile, BURN_CACHE_STEP_HASH, pfnCacheMessageHandler, pfnProgress, pContext);
         ExitOnFailure(hr, "Failed to verify payload signature: %ls", wzCachedPath);
         break;
     case BURN_PAYLOAD_VERIFICATION_HASH:
@@ -1889,6 +2297,7 @@ LExit:
 }
 
 static HRESULT VerifyFileAgainstPayload(
+    __in_opt BURN_CACHE* pCache,
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzVerifyPath,
     __in BOOL fAlreadyCached,
@@ -1917,7 +2326,7 @@ static HRESULT VerifyFileAgainstPayload(
     switch (pPayload->verification)
     {
     case BURN_PAYLOAD_VERIFICATION_AUTHENTICODE:
-        hr = CacheVerifyPayloadSignature(pPayload, wzVerifyPath, hFile, cacheStep, pfnCacheMessageHandler, pfnProgress, pContext);
+        hr = CacheVerifyPayloadSignature(pCache, pPayload, wzVerifyPath, hFile, cacheStep, pfnCacheMessageHandler, pfnProgress, pContext);
         ExitOnFailure(hr, "Failed to verify signature of payload: %ls", pPayload->sczKey);
         break;
     case BURN_PAYLOAD_VERIFICATION_HASH:
@@ -2243,7 +2652,7 @@ static HRESULT RemoveBundleOrPackage(
             ::Sleep(FILE_OPERATION_RETRY_WAIT);
         }
 
-        hr = DirEnsureDeleteEx(sczDirectory, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_SCHEDULE);
+        hr = DirEnsureDeleteEx(sczDirectory, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_SCHEDULE | DIR_DELETE_PARALLEL);
         if (E_PATHNOTFOUND == hr)
         {
             break;
@@ -2501,3 +2910,451 @@ static HRESULT SendCacheFailureMessage(
 
     return hr;
 }
+
+static HRESULT GetContentStorePath(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
+    __in BOOL fCreate,
+    __in BURN_PAYLOAD* pPayload,
+    __deref_out_z_opt LPWSTR* psczStorePath
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczHash = NULL;
+    LPWSTR sczStoreDirectory = NULL;
+
+    // Only payloads verified by their SHA-512 hash can be found by content.
+    if (BURN_PAYLOAD_VERIFICATION_HASH != pPayload->verification || SHA512_HASH_LEN != pPayload->cbHash)
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+
+    hr = StrAllocHexEncode(pPayload->pbHash, pPayload->cbHash, &sczHash);
+    ExitOnFailure(hr, "Failed to encode hash of payload: %ls", pPayload->sczKey);
+
+    if (fCreate)
+    {
+        hr = CreateCompletedPath(pCache, fPerMachine, CONTENT_STORE_FOLDER_NAME, sczHash, psczStorePath);
+        ExitOnFailure(hr, "Failed to create content store path.");
+    }
+    else
+    {
+        hr = CacheGetCompletedPath(pCache, fPerMachine, CONTENT_STORE_FOLDER_NAME, &sczStoreDirectory);
+        ExitOnFailure(hr, "Failed to get content store directory.");
+
+        hr = PathConcat(sczStoreDirectory, sczHash, psczStorePath);
+        ExitOnFailure(hr, "Failed to concat content store path.");
+    }
+
+LExit:
+    ReleaseStr(sczStoreDirectory);
+    ReleaseStr(sczHash);
+
+    return hr;
+}
+
+static HRESULT LinkPayloadFromStore(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzCachedPath
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczStorePath = NULL;
+    LPWSTR sczCachedDirectory = NULL;
+    LONGLONG llSize = 0;
+
+    hr = GetContentStorePath(pCache, fPerMachine, FALSE, pPayload, &sczStorePath);
+    ExitOnFailure(hr, "Failed to get content store path for payload: %ls", pPayload->sczKey);
+
+    if (S_FALSE == hr)
+    {
+        ExitFunction();
+    }
+
+    hr = FileSize(sczStorePath, &llSize);
+    if (E_PATHNOTFOUND == hr || E_FILENOTFOUND == hr || SUCCEEDED(hr) && static_cast<DWORD64>(llSize) != pPayload->qwFileSize)
+    {
+        ExitFunction1(hr = S_FALSE);
+    }
+    ExitOnFailure(hr, "Failed to get size of content store entry: %ls", sczStorePath);
+
+    hr = PathGetDirectory(wzCachedPath, &sczCachedDirectory);
+    ExitOnFailure(hr, "Failed to get directory of cached path: %ls", wzCachedPath);
+
+    hr = DirEnsureExists(sczCachedDirectory, NULL);
+    ExitOnFailure(hr, "Failed to create cache directory: %ls", sczCachedDirectory);
+
+    if (!::CreateHardLinkW(wzCachedPath, sczStorePath, NULL))
+    {
+        ExitWithLastError(hr, "Failed to link content store entry: %ls to: %ls", sczStorePath, wzCachedPath);
+    }
+
+    LogId(REPORT_STANDARD, MSG_LINKED_STORED_PAYLOAD, pPayload->sczKey, sczStorePath, wzCachedPath);
+
+LExit:
+    ReleaseStr(sczCachedDirectory);
+    ReleaseStr(sczStorePath);
+
+    return hr;
+}
+
+static HRESULT AddPayloadToStore(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzCachedPath
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    LPWSTR sczStorePath = NULL;
+    LPWSTR sczLinkPath = NULL;
+
+    hr = GetContentStorePath(pCache, fPerMachine, TRUE, pPayload, &sczStorePath);
+    ExitOnFailure(hr, "Failed to get content store path for payload: %ls", pPayload->sczKey);
+
+    if (S_FALSE == hr)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+
+    // The store entry and the cached payload are the same file so the file's link count tracks how many
+    // package cache folders still use it.
+    if (::CreateHardLinkW(sczStorePath, wzCachedPath, NULL))
+    {
+        ExitFunction();
+    }
+
+    er = ::GetLastError();
+    if (ERROR_ALREADY_EXISTS != er)
+    {
+        ExitOnWin32Error(er, hr, "Failed to link payload: %ls into content store: %ls", wzCachedPath, sczStorePath);
+    }
+
+    // Another package already stored the same content.
+    hr = VerifyStoreEntry(pPayload, sczStorePath);
+    if (CRYPT_E_HASH_VALUE == hr)
+    {
+        // The entry no longer matches its hash so replace it with the payload that was just verified.
+        hr = FileEnsureDelete(sczStorePath);
+        ExitOnFailure(hr, "Failed to remove corrupt content store entry: %ls", sczStorePath);
+
+        if (!::CreateHardLinkW(sczStorePath, wzCachedPath, NULL))
+        {
+            ExitWithLastError(hr, "Failed to link payload: %ls into content store: %ls", wzCachedPath, sczStorePath);
+        }
+    }
+    else
+    {
+        ExitOnFailure(hr, "Failed to verify content store entry: %ls", sczStorePath);
+
+        // Share the entry instead of keeping a second copy of the same content. The link is created next to
+        // the cached payload and then moved over it so the cached path never goes missing.
+        hr = StrAllocFormatted(&sczLinkPath, L"%ls.store", wzCachedPath);
+        ExitOnFailure(hr, "Failed to allocate content store link path.");
+
+        FileEnsureDelete(sczLinkPath);
+
+        if (!::CreateHardLinkW(sczLinkPath, sczStorePath, NULL))
+        {
+            ExitWithLastError(hr, "Failed to link content store entry: %ls to: %ls", sczStorePath, sczLinkPath);
+        }
+
+        hr = FileEnsureMove(sczLinkPath, wzCachedPath, TRUE, FALSE);
+        if (FAILED(hr))
+        {
+            FileEnsureDelete(sczLinkPath);
+        }
+        ExitOnFailure(hr, "Failed to replace cached payload: %ls with content store entry: %ls", wzCachedPath, sczStorePath);
+
+        LogId(REPORT_STANDARD, MSG_LINKED_STORED_PAYLOAD, pPayload->sczKey, sczStorePath, wzCachedPath);
+    }
+
+LExit:
+    ReleaseStr(sczLinkPath);
+    ReleaseStr(sczStorePath);
+
+    return hr;
+}
+
+static HRESULT VerifyStoreEntry(
+    __in BURN_PAYLOAD* pPayload,
+    __in_z LPCWSTR wzStorePath
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    LONGLONG llSize = 0;
+    BYTE rgbActualHash[SHA512_HASH_LEN] = { };
+    DWORD64 qwHashedBytes = 0;
+
+    hFile = ::CreateFileW(wzStorePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    ExitOnInvalidHandleWithLastError(hFile, hr, "Failed to open content store entry: %ls", wzStorePath);
+
+    hr = FileSizeByHandle(hFile, &llSize);
+    ExitOnFailure(hr, "Failed to get size of content store entry: %ls", wzStorePath);
+
+    if (static_cast<DWORD64>(llSize) != pPayload->qwFileSize)
+    {
+        ExitWithRootFailure(hr, CRYPT_E_HASH_VALUE, "File size mismatch for content store entry: %ls, expected: %llu, actual: %lld", wzStorePath, pPayload->qwFileSize, llSize);
+    }
+
+    hr = CrypHashFileHandle(hFile, PROV_RSA_AES, CALG_SHA_512, rgbActualHash, sizeof(rgbActualHash), &qwHashedBytes);
+    ExitOnFailure(hr, "Failed to calculate hash for content store entry: %ls", wzStorePath);
+
+    if (pPayload->cbHash != sizeof(rgbActualHash) || 0 != memcmp(pPayload->pbHash, rgbActualHash, sizeof(rgbActualHash)))
+    {
+        ExitWithRootFailure(hr, CRYPT_E_HASH_VALUE, "Hash mismatch for content store entry: %ls", wzStorePath);
+    }
+
+LExit:
+    ReleaseFileHandle(hFile);
+
+    return hr;
+}
+
+static void RemoveUnreferencedStoreEntries(
+    __in BURN_CACHE* pCache,
+    __in BOOL fPerMachine
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczStoreDirectory = NULL;
+    LPWSTR sczSearch = NULL;
+    LPWSTR sczEntry = NULL;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW wfd = { };
+    BY_HANDLE_FILE_INFORMATION fileInfo = { };
+
+    hr = CacheGetCompletedPath(pCache, fPerMachine, CONTENT_STORE_FOLDER_NAME, &sczStoreDirectory);
+    ExitOnFailure(hr, "Failed to get content store directory.");
+
+    hr = PathConcat(sczStoreDirectory, L"*", &sczSearch);
+    ExitOnFailure(hr, "Failed to concat wild cards to content store directory.");
+
+    hFind = ::FindFirstFileExW(sczSearch, FindExInfoBasic, &wfd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (INVALID_HANDLE_VALUE == hFind)
+    {
+        ExitFunction();
+    }
+
+    // Removing a package's cache folder removes its links, so an entry with no other link isn't used
+    // by any package that is still registered.
+    do
+    {
+        if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            continue;
+        }
+
+        hr = PathConcat(sczStoreDirectory, wfd.cFileName, &sczEntry);
+        ExitOnFailure(hr, "Failed to concat content store entry.");
+
+        hFile = ::CreateFileW(sczEntry, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+        if (INVALID_HANDLE_VALUE == hFile)
+        {
+            continue;
+        }
+
+        if (::GetFileInformationByHandle(hFile, &fileInfo) && 1 >= fileInfo.nNumberOfLinks)
+        {
+            ReleaseFileHandle(hFile);
+
+            hr = FileEnsureDelete(sczEntry);
+            if (FAILED(hr))
+            {
+                TraceError(hr, "Failed to remove unreferenced content store entry: %ls", sczEntry);
+            }
+        }
+
+        ReleaseFileHandle(hFile);
+    } while (::FindNextFileW(hFind, &wfd));
+
+LExit:
+    ReleaseFileHandle(hFile);
+    ReleaseFileFindHandle(hFind);
+    ReleaseStr(sczEntry);
+    ReleaseStr(sczSearch);
+    ReleaseStr(sczStoreDirectory);
+}
+
+static HRESULT GetPayloadTrustValueName(
+    __in HANDLE hFile,
+    __out BY_HANDLE_FILE_INFORMATION* pFileInfo,
+    __deref_out_z LPWSTR* psczName
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (!::GetFileInformationByHandle(hFile, pFileInfo))
+    {
+        ExitWithLastError(hr, "Failed to get file information.");
+    }
+
+    hr = StrAllocFormatted(psczName, L"%08x%08x%08x", pFileInfo->dwVolumeSerialNumber, pFileInfo->nFileIndexHigh, pFileInfo->nFileIndexLow);
+    ExitOnFailure(hr, "Failed to format payload trust value name.");
+
+LExit:
+    return hr;
+}
+
+static HRESULT GetIndexDirectory(
+    __in BURN_CACHE_INDEX* pIndex,
+    __in_z LPCWSTR wzDirectory,
+    __out BURN_CACHE_INDEX_DIRECTORY** ppDirectory
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczPath = NULL;
+    BURN_CACHE_INDEX_DIRECTORY* pDirectory = NULL;
+    BURN_CACHE_INDEX_DIRECTORY* pNewDirectory = NULL;
+
+    hr = StrAllocString(&sczPath, wzDirectory, 0);
+    ExitOnFailure(hr, "Failed to copy directory path.");
+
+    hr = PathBackslashTerminate(&sczPath);
+    ExitOnFailure(hr, "Failed to ensure directory path was backslash terminated.");
+
+    if (!pIndex->sdhDirectories)
+    {
+        hr = DictCreateWithEmbeddedKey(&pIndex->sdhDirectories, 0, NULL, offsetof(BURN_CACHE_INDEX_DIRECTORY, sczPath), DICT_FLAG_CASEINSENSITIVE);
+        ExitOnFailure(hr, "Failed to create cache index.");
+    }
+
+    hr = DictGetValue(pIndex->sdhDirectories, sczPath, reinterpret_cast<void**>(&pDirectory));
+    if (E_NOTFOUND != hr)
+    {
+        ExitOnFailure(hr, "Failed to find directory in cache index: %ls", sczPath);
+        ExitFunction();
+    }
+
+    pNewDirectory = static_cast<BURN_CACHE_INDEX_DIRECTORY*>(MemAlloc(sizeof(BURN_CACHE_INDEX_DIRECTORY), TRUE));
+    ExitOnNull(pNewDirectory, hr, E_OUTOFMEMORY, "Failed to allocate cache index directory.");
+
+    pNewDirectory->sczPath = sczPath;
+    sczPath = NULL;
+
+    hr = IndexDirectory(pNewDirectory);
+    ExitOnFailure(hr, "Failed to enumerate directory: %ls", pNewDirectory->sczPath);
+
+    hr = MemEnsureArrayCapacityOf(pIndex->rgpDirectories, pIndex->cDirectories + 1, &pIndex->cDirectoriesCapacity);
+    ExitOnFailure(hr, "Failed to grow cache index.");
+
+    pIndex->rgpDirectories[pIndex->cDirectories] = pNewDirectory;
+    ++pIndex->cDirectories;
+    pDirectory = pNewDirectory;
+    pNewDirectory = NULL;
+
+    hr = DictAddValue(pIndex->sdhDirectories, pDirectory);
+    ExitOnFailure(hr, "Failed to add directory to cache index: %ls", pDirectory->sczPath);
+
+LExit:
+    if (pNewDirectory)
+    {
+        UninitializeIndexDirectory(pNewDirectory);
+        MemFree(pNewDirectory);
+    }
+
+    ReleaseStr(sczPath);
+
+    *ppDirectory = SUCCEEDED(hr) ? pDirectory : NULL;
+
+    return hr;
+}
+
+static HRESULT IndexDirectory(
+    __in BURN_CACHE_INDEX_DIRECTORY* pDirectory
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    LPWSTR sczSearch = NULL;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    WIN32_FIND_DATAW wfd = { };
+    BURN_CACHE_INDEX_ENTRY* pEntry = NULL;
+
+    hr = PathConcat(pDirectory->sczPath, L"*", &sczSearch);
+    ExitOnFailure(hr, "Failed to concat wild cards to directory: %ls", pDirectory->sczPath);
+
+    hFind = ::FindFirstFileExW(sczSearch, FindExInfoBasic, &wfd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+    if (INVALID_HANDLE_VALUE == hFind)
+    {
+        er = ::GetLastError();
+        if (ERROR_FILE_NOT_FOUND == er) // an empty root directory.
+        {
+            pDirectory->fExists = TRUE;
+            ExitFunction();
+        }
+        else if (ERROR_PATH_NOT_FOUND == er || ERROR_DIRECTORY == er)
+        {
+            ExitFunction();
+        }
+
+        ExitOnWin32Error(er, hr, "Failed to find first file in directory: %ls", pDirectory->sczPath);
+    }
+
+    pDirectory->fExists = TRUE;
+
+    do
+    {
+        // Skip the dot directories.
+        if (L'.' == wfd.cFileName[0] && (L'\0' == wfd.cFileName[1] || (L'.' == wfd.cFileName[1] && L'\0' == wfd.cFileName[2])))
+        {
+            continue;
+        }
+
+        hr = MemEnsureArrayCapacityOf(pDirectory->rgEntries, pDirectory->cEntries + 1, &pDirectory->cEntriesCapacity);
+        ExitOnFailure(hr, "Failed to grow cache index directory.");
+
+        pEntry = pDirectory->rgEntries + pDirectory->cEntries;
+        ++pDirectory->cEntries;
+
+        hr = StrAllocString(&pEntry->sczName, wfd.cFileName, 0);
+        ExitOnFailure(hr, "Failed to copy file name: %ls", wfd.cFileName);
+
+        pEntry->fDirectory = FILE_ATTRIBUTE_DIRECTORY == (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY);
+        pEntry->qwFileSize = (static_cast<DWORD64>(wfd.nFileSizeHigh) << 32) | wfd.nFileSizeLow;
+    } while (::FindNextFileW(hFind, &wfd));
+
+    er = ::GetLastError();
+    if (ERROR_NO_MORE_FILES != er)
+    {
+        ExitOnWin32Error(er, hr, "Failed while looping through files in directory: %ls", pDirectory->sczPath);
+    }
+
+    // The entries no longer move so the dictionary can point straight at them.
+    if (pDirectory->cEntries)
+    {
+        hr = DictCreateWithEmbeddedKey(&pDirectory->sdhEntries, pDirectory->cEntries, NULL, offsetof(BURN_CACHE_INDEX_ENTRY, sczName), DICT_FLAG_CASEINSENSITIVE);
+        ExitOnFailure(hr, "Failed to create cache index directory.");
+
+        for (DWORD i = 0; i < pDirectory->cEntries; ++i)
+        {
+            hr = DictAddValue(pDirectory->sdhEntries, pDirectory->rgEntries + i);
+            ExitOnFailure(hr, "Failed to add file to cache index: %ls", pDirectory->rgEntries[i].sczName);
+        }
+    }
+
+LExit:
+    ReleaseFileFindHandle(hFind);
+    ReleaseStr(sczSearch);
+
+    return hr;
+}
+
+static void UninitializeIndexDirectory(
+    __in BURN_CACHE_INDEX_DIRECTORY* pDirectory
+    )
+{
+    for (DWORD i = 0; i < pDirectory->cEntries; ++i)
+    {
+        ReleaseStr(pDirectory->rgEntries[i].sczName);
+    }
+
+    ReleaseMem(pDirectory->rgEntries);
+    ReleaseDict(pDirectory->sdhEntries);
+    ReleaseStr(pDirectory->sczPath);
+}
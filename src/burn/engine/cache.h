@@ -2,6 +2,7 @@
 // Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
 
 #define BURN_CACHE_MAX_SEARCH_PATHS 7
+#define BURN_PAYLOAD_TRUST_REGISTRY_PATH L"SOFTWARE\\WiX\\Burn\\PayloadTrust"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,6 +26,50 @@ enum BURN_CACHE_STEP
     BURN_CACHE_STEP_FINALIZE,
 };
 
+// Stored in a registry value named for the volume and file index of a per-machine payload that
+// passed signature verification. While the record is younger than the PayloadTrustLifetime policy
+// the payload isn't verified again, so a revocation of its certificate isn't noticed until the
+// record expires.
+typedef struct _BURN_PAYLOAD_TRUST_RECORD
+{
+    DWORD64 qwFileSize;
+    FILETIME ftLastWrite;
+    FILETIME ftVerified;
+    DWORD cbCertificateRootPublicKeyIdentifier;
+    BYTE rgbCertificateRootPublicKeyIdentifier[SHA1_HASH_LEN];
+    DWORD cbCertificateRootThumbprint;
+    BYTE rgbCertificateRootThumbprint[SHA1_HASH_LEN];
+} BURN_PAYLOAD_TRUST_RECORD;
+
+typedef struct _BURN_CACHE_INDEX_ENTRY
+{
+    LPWSTR sczName;
+    BOOL fDirectory;
+    DWORD64 qwFileSize;
+} BURN_CACHE_INDEX_ENTRY;
+
+typedef struct _BURN_CACHE_INDEX_DIRECTORY
+{
+    LPWSTR sczPath;
+    BOOL fExists;
+
+    BURN_CACHE_INDEX_ENTRY* rgEntries;
+    DWORD cEntries;
+    DWORD cEntriesCapacity;
+    STRINGDICT_HANDLE sdhEntries;
+} BURN_CACHE_INDEX_DIRECTORY;
+
+// Names and sizes of the files in each directory that was asked about, read with a single
+// enumeration per directory. The index is never refreshed so it is only used while the
+// directories aren't expected to change, like during detect.
+typedef struct _BURN_CACHE_INDEX
+{
+    BURN_CACHE_INDEX_DIRECTORY** rgpDirectories;
+    DWORD cDirectories;
+    DWORD cDirectoriesCapacity;
+    STRINGDICT_HANDLE sdhDirectories;
+} BURN_CACHE_INDEX;
+
 typedef struct _BURN_CACHE
 {
     BOOL fInitializedCache;
@@ -32,6 +77,12 @@ typedef struct _BURN_CACHE
     BOOL fOriginalPerMachineCacheRootVerified;
     BOOL fUnverifiedCacheFolderCreated;
     BOOL fCustomMachinePackageCache;
+    BOOL fContentStore;
+
+    // Successful signature verifications of per-machine payloads are remembered for this many seconds.
+    DWORD dwPayloadTrustLifetime;
+    DWORD cPayloadTrustHits;
+    DWORD cPayloadTrustMisses;
     LPWSTR sczDefaultUserPackageCache;
     LPWSTR sczDefaultMachinePackageCache;
     LPWSTR sczCurrentMachinePackageCache;
@@ -49,6 +100,9 @@ typedef struct _BURN_CACHE
     // Only valid after CacheEnsureBaseWorkingFolder
     BOOL fInitializedBaseWorkingFolder;
     LPWSTR sczBaseWorkingFolder;
+
+    // Only valid during detect
+    BURN_CACHE_INDEX index;
 } BURN_CACHE;
 
 typedef struct _BURN_CACHE_MESSAGE
@@ -238,6 +292,8 @@ HRESULT CacheVerifyContainer(
     __in LPVOID pContext
     );
 HRESULT CacheVerifyPayload(
+    __in_opt BURN_CACHE* pCache,
+    __in BOOL fPerMachine,
     __in BURN_PAYLOAD* pPayload,
     __in_z LPCWSTR wzCachedDirectory,
     __in PFN_BURNCACHEMESSAGEHANDLER pfnCacheMessageHandler,
@@ -265,6 +321,39 @@ void CacheCleanup(
 void CacheUninitialize(
     __in BURN_CACHE* pCache
     );
+HRESULT CacheIndexDirectoryExists(
+    __in BURN_CACHE_INDEX* pIndex,
+    __in_z LPCWSTR wzDirectory,
+    __out BOOL* pfExists
+    );
+HRESULT CacheIndexFileExists(
+    __in BURN_CACHE_INDEX* pIndex,
+    __in_z LPCWSTR wzPath,
+    __out BOOL* pfExists,
+    __out_opt DWORD64* pqwFileSize
+    );
+void CacheIndexReset(
+    __in BURN_CACHE_INDEX* pIndex
+    );
+HRESULT CachePayloadTrustRead(
+    __in BURN_CACHE* pCache,
+    __in BURN_PAYLOAD* pPayload,
+    __in HANDLE hFile,
+    __out BOOL* pfTrusted
+    );
+HRESULT CachePayloadTrustWrite(
+    __in BURN_PAYLOAD* pPayload,
+    __in HANDLE hFile
+    );
+BOOL CachePayloadTrustIsRecordValid(
+    __in BURN_CACHE* pCache,
+    __in const BURN_PAYLOAD_TRUST_RECORD* pRecord,
+    __in_opt BURN_PAYLOAD* pPayload,
+    __in_opt const BY_HANDLE_FILE_INFORMATION* pFileInfo
+    );
+void CachePayloadTrustRemoveExpired(
+    __in BURN_CACHE* pCache
+    );
 
 #ifdef __cplusplus
 }
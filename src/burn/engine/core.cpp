@@ -269,9 +269,6 @@ extern "C" HRESULT CoreQueryRegistration(
     )
 {
     HRESULT hr = S_OK;
-    BYTE* pbBuffer = NULL;
-    SIZE_T cbBuffer = 0;
-    SIZE_T iBuffer = 0;
 
     // detect resume type
     hr = RegistrationDetectResumeType(&pEngineState->registration, &pEngineState->command.resumeType);
@@ -282,11 +279,7 @@ extern "C" HRESULT CoreQueryRegistration(
     if (BOOTSTRAPPER_RESUME_TYPE_INVALID < pEngineState->command.resumeType)
     {
         // load resume state
-        hr = RegistrationLoadState(&pEngineState->registration, &pbBuffer, &cbBuffer);
-        if (SUCCEEDED(hr))
-        {
-            hr = VariableDeserialize(&pEngineState->variables, TRUE, pbBuffer, cbBuffer, &iBuffer);
-        }
+        hr = RegistrationLoadState(&pEngineState->registration, &pEngineState->variables);
 
         // Log any failures and continue.
         if (FAILED(hr))
@@ -297,8 +290,6 @@ extern "C" HRESULT CoreQueryRegistration(
     }
 
 LExit:
-    ReleaseBuffer(pbBuffer);
-
     return hr;
 }
 
@@ -332,6 +323,10 @@ extern "C" HRESULT CoreDetect(
     hr = SearchesExecute(&pEngineState->searches, &pEngineState->variables);
     ExitOnFailure(hr, "Failed to execute searches.");
 
+    // Related bundles are queried for the bundle and each bundle package so only read the uninstall keys once.
+    hr = BundleSnapshotCreate(&pEngineState->registration.hBundleSnapshot);
+    ExitOnFailure(hr, "Failed to create related bundle snapshot.");
+
     hr = DependencyDetectBundle(&pEngineState->dependencies, &pEngineState->registration);
     ExitOnFailure(hr, "Failed to detect the dependencies.");
 
@@ -433,6 +428,8 @@ LExit:
     }
 
     pEngineState->userExperience.hwndDetect = NULL;
+    ReleaseNullBundleSnapshot(pEngineState->registration.hBundleSnapshot);
+    CacheIndexReset(&pEngineState->cache.index);
 
     LogId(REPORT_STANDARD, MSG_DETECT_COMPLETE, hr, !fDetectBegan ? "(failed)" : LoggingRegistrationTypeToString(pEngineState->registration.detectedRegistrationType), !fDetectBegan ? "(failed)" : LoggingBoolToString(pEngineState->registration.fCached), FAILED(hr) ? "(failed)" : LoggingBoolToString(pEngineState->registration.fEligibleForCleanup));
 
@@ -922,26 +919,81 @@ extern "C" HRESULT CoreSaveEngineState(
     )
 {
     HRESULT hr = S_OK;
+    BURN_REGISTRATION* pRegistration = &pEngineState->registration;
     BYTE* pbBuffer = NULL;
     SIZE_T cbBuffer = 0;
+    DWORD dwSequence = 0;
+    DWORD cChanges = 0;
+
+    // Once a snapshot is saved, only append the persisted variables that changed since the previous save
+    // until the appended changes outgrow the snapshot.
+    if (pRegistration->fStateSaved && pRegistration->cbStateJournal <= pRegistration->cbStateSnapshot)
+    {
+        hr = VariableSerializeChanges(&pEngineState->variables, pRegistration->dwStateSequence, &pbBuffer, &cbBuffer, &dwSequence, &cChanges);
+        ExitOnFailure(hr, "Failed to serialize changed engine state.");
+
+        if (!cChanges)
+        {
+            ExitFunction();
+        }
+
+        if (pRegistration->fPerMachine)
+        {
+            hr = ElevationAppendState(pEngineState->companionConnection.hPipe, pbBuffer, cbBuffer);
+        }
+        else
+        {
+            hr = RegistrationAppendState(pRegistration, pbBuffer, cbBuffer);
+        }
+
+        if (S_OK == hr)
+        {
+            pRegistration->dwStateSequence = dwSequence;
+            pRegistration->cbStateJournal += cbBuffer;
+
+            ExitFunction();
+        }
+        else if (FAILED(hr))
+        {
+            // A torn append hides anything appended after it, so start over with a new snapshot.
+            TraceError(hr, "Failed to append engine state, saving all of it.");
+        }
+
+        ReleaseNullBuffer(pbBuffer);
+        cbBuffer = 0;
+    }
+
+    // Get the sequence before serializing so a variable that changes in between is appended again next time.
+    hr = VariableGetChangeSequence(&pEngineState->variables, &dwSequence);
+    ExitOnFailure(hr, "Failed to get variable change sequence.");
 
     // serialize engine state
     hr = CoreSerializeEngineState(pEngineState, &pbBuffer, &cbBuffer);
     ExitOnFailure(hr, "Failed to serialize engine state.");
 
     // write to registration store
-    if (pEngineState->registration.fPerMachine)
+    if (pRegistration->fPerMachine)
     {
         hr = ElevationSaveState(pEngineState->companionConnection.hPipe, pbBuffer, cbBuffer);
         ExitOnFailure(hr, "Failed to save engine state in per-machine process.");
     }
     else
     {
-        hr = RegistrationSaveState(&pEngineState->registration, pbBuffer, cbBuffer);
+        hr = RegistrationSaveState(pRegistration, pbBuffer, cbBuffer);
         ExitOnFailure(hr, "Failed to save engine state.");
     }
 
+    pRegistration->fStateSaved = TRUE;
+    pRegistration->dwStateSequence = dwSequence;
+    pRegistration->cbStateSnapshot = cbBuffer;
+    pRegistration->cbStateJournal = 0;
+
 LExit:
+    if (FAILED(hr))
+    {
+        pRegistration->fStateSaved = FALSE;
+    }
+
     ReleaseBuffer(pbBuffer);
 
     return hr;
@@ -2021,6 +2073,65 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT CoreCreateProcessWithOutput(
+    __in_opt LPCWSTR wzApplicationName,
+    __inout_opt LPWSTR sczCommandLine,
+    __in DWORD dwCreationFlags,
+    __in_opt LPCWSTR wzCurrentDirectory,
+    __in HANDLE hOutput,
+    __out LPPROCESS_INFORMATION pProcessInformation
+    )
+{
+    HRESULT hr = S_OK;
+    STARTUPINFOEXW si = { };
+    SIZE_T cbAttributeList = 0;
+    size_t cchCurrentDirectory = 0;
+
+    // CreateProcessW has undocumented MAX_PATH restriction for lpCurrentDirectory even when long path support is enabled.
+    if (wzCurrentDirectory && FAILED(::StringCchLengthW(wzCurrentDirectory, MAX_PATH - 1, &cchCurrentDirectory)))
+    {
+        wzCurrentDirectory = NULL;
+    }
+
+    // Only let the child inherit the output handle, not every inheritable handle in the engine.
+    ::InitializeProcThreadAttributeList(NULL, 1, 0, &cbAttributeList);
+
+    si.lpAttributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(MemAlloc(cbAttributeList, TRUE));
+    ExitOnNull(si.lpAttributeList, hr, E_OUTOFMEMORY, "Failed to allocate process attribute list.");
+
+    if (!::InitializeProcThreadAttributeList(si.lpAttributeList, 1, 0, &cbAttributeList))
+    {
+        MemFree(si.lpAttributeList);
+        si.lpAttributeList = NULL;
+
+        ExitWithLastError(hr, "Failed to initialize process attribute list.");
+    }
+
+    if (!::UpdateProcThreadAttribute(si.lpAttributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST, &hOutput, sizeof(hOutput), NULL, NULL))
+    {
+        ExitWithLastError(hr, "Failed to set inherited handle list.");
+    }
+
+    si.StartupInfo.cb = sizeof(si);
+    si.StartupInfo.dwFlags = STARTF_USESTDHANDLES;
+    si.StartupInfo.hStdOutput = hOutput;
+    si.StartupInfo.hStdError = hOutput;
+
+    if (!vpfnCreateProcessW(wzApplicationName, sczCommandLine, NULL, NULL, TRUE, dwCreationFlags | EXTENDED_STARTUPINFO_PRESENT, NULL, wzCurrentDirectory, &si.StartupInfo, pProcessInformation))
+    {
+        ExitWithLastError(hr, "CreateProcessW failed with return code: %d", Dutil_er);
+    }
+
+LExit:
+    if (si.lpAttributeList)
+    {
+        ::DeleteProcThreadAttributeList(si.lpAttributeList);
+        MemFree(si.lpAttributeList);
+    }
+
+    return hr;
+}
+
 extern "C" HRESULT DAPI CoreWaitForProcCompletion(
     __in HANDLE hProcess,
     __in DWORD dwTimeout,
@@ -2343,6 +2454,7 @@ static HRESULT DetectPackagePayloadsCached(
     HRESULT hr = S_OK;
     LPWSTR sczCachePath = NULL;
     BOOL fCached = FALSE; // assume the package is not cached.
+    BOOL fExists = FALSE;
     LPWSTR sczPayloadCachePath = NULL;
 
     if (pPackage->sczCacheId && *pPackage->sczCacheId)
@@ -2350,8 +2462,18 @@ static HRESULT DetectPackagePayloadsCached(
         hr = CacheGetCompletedPath(pCache, pPackage->fPerMachine, pPackage->sczCacheId, &sczCachePath);
         ExitOnFailure(hr, "Failed to get completed cache path.");
 
+        // Each cache directory is enumerated once for all of the payloads that could be in it.
+        // A directory that can't be enumerated is treated as not cached, like a missing one.
+        hr = CacheIndexDirectoryExists(&pCache->index, sczCachePath, &fExists);
+        if (FAILED(hr))
+        {
+            LogStringLine(REPORT_STANDARD, "Failed to check if completed cache path exists: %ls, error: 0x%x. Treating the package as not cached.", sczCachePath, hr);
+            fExists = FALSE;
+            hr = S_OK;
+        }
+
         // If the cached directory exists, we have something.
-        if (DirExists(sczCachePath, NULL))
+        if (fExists)
         {
             // Check all payloads to see if any exist.
             for (DWORD i = 0; i < pPackage->payloads.cItems; ++i)
@@ -2361,7 +2483,15 @@ static HRESULT DetectPackagePayloadsCached(
                 hr = PathConcatRelativeToFullyQualifiedBase(sczCachePath, pPayload->sczFilePath, &sczPayloadCachePath);
                 ExitOnFailure(hr, "Failed to concat payload cache path.");
 
-                if (FileExistsEx(sczPayloadCachePath, NULL))
+                hr = CacheIndexFileExists(&pCache->index, sczPayloadCachePath, &fExists, NULL);
+                if (FAILED(hr))
+                {
+                    LogStringLine(REPORT_STANDARD, "Failed to check if payload is cached: %ls, error: 0x%x. Treating it as not cached.", sczPayloadCachePath, hr);
+                    fExists = FALSE;
+                    hr = S_OK;
+                }
+
+                if (fExists)
                 {
                     fCached = TRUE;
                     break;
@@ -179,6 +179,7 @@ typedef struct _BURN_ENGINE_STATE
 
     LPWSTR sczBundleEngineWorkingPath;
     BURN_PIPE_CONNECTION companionConnection;
+    HANDLE hCompanionConnectThread;
     BURN_PIPE_CONNECTION embeddedConnection;
 
     CRITICAL_SECTION csRestartState;
@@ -343,6 +344,14 @@ HRESULT CoreCreateProcess(
     __in WORD wShowWindow,
     __out LPPROCESS_INFORMATION pProcessInformation
     );
+HRESULT CoreCreateProcessWithOutput(
+    __in_opt LPCWSTR wzApplicationName,
+    __inout_opt LPWSTR sczCommandLine,
+    __in DWORD dwCreationFlags,
+    __in_opt LPCWSTR wzCurrentDirectory,
+    __in HANDLE hOutput,
+    __out LPPROCESS_INFORMATION pProcessInformation
+    );
 HRESULT DAPI CoreWaitForProcCompletion(
     __in HANDLE hProcess,
     __in DWORD dwTimeout,
@@ -13,6 +13,7 @@ typedef enum _BURN_ELEVATION_MESSAGE_TYPE
     BURN_ELEVATION_MESSAGE_TYPE_SESSION_BEGIN,
     BURN_ELEVATION_MESSAGE_TYPE_SESSION_END,
     BURN_ELEVATION_MESSAGE_TYPE_SAVE_STATE,
+    BURN_ELEVATION_MESSAGE_TYPE_APPEND_STATE,
     BURN_ELEVATION_MESSAGE_TYPE_CACHE_PREPARE_PACKAGE,
     BURN_ELEVATION_MESSAGE_TYPE_CACHE_COMPLETE_PAYLOAD,
     BURN_ELEVATION_MESSAGE_TYPE_CACHE_VERIFY_PAYLOAD,
@@ -177,6 +178,7 @@ static HRESULT ProcessExecuteActionCompleteMessage(
     );
 static HRESULT OnApplyInitialize(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_VARIABLES* pVariables,
     __in BURN_REGISTRATION* pRegistration,
     __in BURN_PACKAGES* pPackages,
@@ -216,6 +218,11 @@ static HRESULT OnSaveState(
     __in BYTE* pbData,
     __in SIZE_T cbData
     );
+static HRESULT OnAppendState(
+    __in BURN_REGISTRATION* pRegistration,
+    __in BYTE* pbData,
+    __in SIZE_T cbData
+    );
 static HRESULT OnCachePreparePackage(
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
@@ -232,6 +239,7 @@ static HRESULT OnCacheCompletePayload(
     );
 static HRESULT OnCacheVerifyPayload(
     __in HANDLE hPipe,
+    __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_PAYLOADS* pPayloads,
     __in BYTE* pbData,
@@ -274,6 +282,7 @@ static HRESULT OnExecuteExePackage(
     );
 static HRESULT OnExecuteMsiPackage(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -283,6 +292,7 @@ static HRESULT OnExecuteMsiPackage(
     );
 static HRESULT OnExecuteMspPackage(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -301,6 +311,7 @@ static HRESULT OnExecuteMsuPackage(
     );
 static HRESULT OnUninstallMsiCompatiblePackage(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -496,6 +507,13 @@ extern "C" HRESULT ElevationApplyInitialize(
 
     hr = BuffWriteNumber(&pbData, &cbData, (DWORD)!pPlan->pInternalCommand->fDisableSystemRestore);
     ExitOnFailure(hr, "Failed to write system restore point action to message buffer.");
+
+    // The elevated process drops the MSI messages the BA doesn't want instead of sending them back here.
+    hr = BuffWriteNumber(&pbData, &cbData, pBA->dwIgnoredMsiMessages);
+    ExitOnFailure(hr, "Failed to write ignored MSI messages to message buffer.");
+
+    hr = BuffWriteNumber(&pbData, &cbData, pBA->dwMsiProgressGranularity);
+    ExitOnFailure(hr, "Failed to write MSI progress granularity to message buffer.");
     
     hr = VariableSerialize(pVariables, FALSE, &pbData, &cbData);
     ExitOnFailure(hr, "Failed to write variables.");
@@ -670,6 +688,29 @@ LExit:
     return hr;
 }
 
+/*******************************************************************
+ ElevationAppendState - 
+
+*******************************************************************/
+HRESULT ElevationAppendState(
+    __in HANDLE hPipe,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwResult = 0;
+
+    // send message
+    hr = PipeSendMessage(hPipe, BURN_ELEVATION_MESSAGE_TYPE_APPEND_STATE, pbBuffer, cbBuffer, NULL, NULL, &dwResult);
+    ExitOnFailure(hr, "Failed to send message to per-machine process.");
+
+    hr = (HRESULT)dwResult;
+
+LExit:
+    return hr;
+}
+
 extern "C" HRESULT ElevationCachePreparePackage(
     __in HANDLE hPipe,
     __in BURN_PACKAGE* pPackage
@@ -2162,7 +2203,7 @@ static HRESULT ProcessElevatedChildMessage(
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_APPLY_INITIALIZE:
-        hrResult = OnApplyInitialize(pContext->hPipe, pContext->pVariables, pContext->pRegistration, pContext->pPackages, pContext->phLock, pContext->pfDisabledAutomaticUpdates, pContext->pfApplying, (BYTE*)pMsg->pvData, pMsg->cbData);
+        hrResult = OnApplyInitialize(pContext->hPipe, pContext->pUserExperience, pContext->pVariables, pContext->pRegistration, pContext->pPackages, pContext->phLock, pContext->pfDisabledAutomaticUpdates, pContext->pfApplying, (BYTE*)pMsg->pvData, pMsg->cbData);
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_APPLY_UNINITIALIZE:
@@ -2181,6 +2222,10 @@ static HRESULT ProcessElevatedChildMessage(
         hrResult = OnSaveState(pContext->pRegistration, (BYTE*)pMsg->pvData, pMsg->cbData);
         break;
 
+    case BURN_ELEVATION_MESSAGE_TYPE_APPEND_STATE:
+        hrResult = OnAppendState(pContext->pRegistration, (BYTE*)pMsg->pvData, pMsg->cbData);
+        break;
+
     case BURN_ELEVATION_MESSAGE_TYPE_PROCESS_DEPENDENT_REGISTRATION:
         hrResult = OnProcessDependentRegistration(pContext->pRegistration, (BYTE*)pMsg->pvData, pMsg->cbData);
         break;
@@ -2201,12 +2246,12 @@ static HRESULT ProcessElevatedChildMessage(
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSI_PACKAGE:
-        hrResult = OnExecuteMsiPackage(pContext->hPipe, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData, &restart);
+        hrResult = OnExecuteMsiPackage(pContext->hPipe, pContext->pUserExperience, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData, &restart);
         fSendRestart = TRUE;
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_EXECUTE_MSP_PACKAGE:
-        hrResult = OnExecuteMspPackage(pContext->hPipe, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData, &restart);
+        hrResult = OnExecuteMspPackage(pContext->hPipe, pContext->pUserExperience, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData, &restart);
         fSendRestart = TRUE;
         break;
 
@@ -2232,7 +2277,7 @@ static HRESULT ProcessElevatedChildMessage(
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_UNINSTALL_MSI_COMPATIBLE_PACKAGE:
-        hrResult = OnUninstallMsiCompatiblePackage(pContext->hPipe, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData, &restart);
+        hrResult = OnUninstallMsiCompatiblePackage(pContext->hPipe, pContext->pUserExperience, pContext->pCache, pContext->pPackages, pContext->pVariables, (BYTE*)pMsg->pvData, pMsg->cbData, &restart);
         fSendRestart = TRUE;
         break;
 
@@ -2277,7 +2322,7 @@ static HRESULT ProcessElevatedChildCacheMessage(
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_CACHE_VERIFY_PAYLOAD:
-        hrResult = OnCacheVerifyPayload(pContext->hPipe, pContext->pPackages, pContext->pPayloads, (BYTE*)pMsg->pvData, pMsg->cbData);
+        hrResult = OnCacheVerifyPayload(pContext->hPipe, pContext->pCache, pContext->pPackages, pContext->pPayloads, (BYTE*)pMsg->pvData, pMsg->cbData);
         break;
 
     case BURN_ELEVATION_MESSAGE_TYPE_CACHE_CLEANUP:
@@ -2321,6 +2366,7 @@ LExit:
 
 static HRESULT OnApplyInitialize(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_VARIABLES* pVariables,
     __in BURN_REGISTRATION* pRegistration,
     __in BURN_PACKAGES* pPackages,
@@ -2349,6 +2395,12 @@ static HRESULT OnApplyInitialize(
     hr = BuffReadNumber(pbData, cbData, &iData, &dwTakeSystemRestorePoint);
     ExitOnFailure(hr, "Failed to read system restore point action.");
 
+    hr = BuffReadNumber(pbData, cbData, &iData, &pUserExperience->dwIgnoredMsiMessages);
+    ExitOnFailure(hr, "Failed to read ignored MSI messages.");
+
+    hr = BuffReadNumber(pbData, cbData, &iData, &pUserExperience->dwMsiProgressGranularity);
+    ExitOnFailure(hr, "Failed to read MSI progress granularity.");
+
     hr = VariableDeserialize(pVariables, FALSE, pbData, cbData, &iData);
     ExitOnFailure(hr, "Failed to read variables.");
 
@@ -2615,6 +2667,22 @@ LExit:
     return hr;
 }
 
+static HRESULT OnAppendState(
+    __in BURN_REGISTRATION* pRegistration,
+    __in BYTE* pbData,
+    __in SIZE_T cbData
+    )
+{
+    HRESULT hr = S_OK;
+
+    // append state in per-machine process
+    hr = RegistrationAppendState(pRegistration, pbData, cbData);
+    ExitOnFailure(hr, "Failed to append state.");
+
+LExit:
+    return hr;
+}
+
 static HRESULT OnCachePreparePackage(
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
@@ -2713,6 +2781,7 @@ LExit:
 
 static HRESULT OnCacheVerifyPayload(
     __in HANDLE hPipe,
+    __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_PAYLOADS* pPayloads,
     __in BYTE* pbData,
@@ -2752,7 +2821,7 @@ static HRESULT OnCacheVerifyPayload(
             ExitOnRootFailure(hr, "Cache verify payload called without starting its package.");
         }
 
-        hr = CacheVerifyPayload(pPayload, pPackage->sczCacheFolder, BurnCacheMessageHandler, ElevatedProgressRoutine, hPipe);
+        hr = CacheVerifyPayload(pCache, pPackage->fPerMachine, pPayload, pPackage->sczCacheFolder, BurnCacheMessageHandler, ElevatedProgressRoutine, hPipe);
     }
     else
     {
@@ -3063,6 +3132,7 @@ LExit:
 
 static HRESULT OnExecuteMsiPackage(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -3146,7 +3216,7 @@ static HRESULT OnExecuteMsiPackage(
     }
 
     // Execute MSI package.
-    hr = MsiEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, hPipe, pRestart);
+    hr = MsiEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, pUserExperience, fRollback, MsiExecuteMessageHandler, hPipe, pRestart);
     ExitOnFailure(hr, "Failed to execute MSI package.");
 
 LExit:
@@ -3158,6 +3228,7 @@ LExit:
 
 static HRESULT OnExecuteMspPackage(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -3239,7 +3310,7 @@ static HRESULT OnExecuteMspPackage(
     }
 
     // Execute MSP package.
-    hr = MspEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, hPipe, pRestart);
+    hr = MspEngineExecutePackage(hwndParent, &executeAction, pCache, pVariables, pUserExperience, fRollback, MsiExecuteMessageHandler, hPipe, pRestart);
     ExitOnFailure(hr, "Failed to execute MSP package.");
 
 LExit:
@@ -3306,6 +3377,7 @@ LExit:
 
 static HRESULT OnUninstallMsiCompatiblePackage(
     __in HANDLE hPipe,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BURN_CACHE* pCache,
     __in BURN_PACKAGES* pPackages,
     __in BURN_VARIABLES* pVariables,
@@ -3364,7 +3436,7 @@ static HRESULT OnUninstallMsiCompatiblePackage(
     }
 
     // Uninstall MSI compatible package.
-    hr = MsiEngineUninstallCompatiblePackage(hwndParent, &executeAction, pCache, pVariables, fRollback, MsiExecuteMessageHandler, hPipe, pRestart);
+    hr = MsiEngineUninstallCompatiblePackage(hwndParent, &executeAction, pCache, pVariables, pUserExperience, fRollback, MsiExecuteMessageHandler, hPipe, pRestart);
     ExitOnFailure(hr, "Failed to execute compatible MSI package.");
 
 LExit:
@@ -46,6 +46,11 @@ HRESULT ElevationSaveState(
     __in_bcount(cbBuffer) BYTE* pbBuffer,
     __in SIZE_T cbBuffer
     );
+HRESULT ElevationAppendState(
+    __in HANDLE hPipe,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer
+    );
 HRESULT ElevationCachePreparePackage(
     __in HANDLE hPipe,
     __in BURN_PACKAGE* pPackage
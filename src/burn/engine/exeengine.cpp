@@ -2,11 +2,28 @@
 
 #include "precomp.h"
 
+const DWORD BURN_EXE_MAX_LOGGED_OUTPUT = 64 * 1024;
+
 static HRESULT DetectArpEntry(
     __in const BURN_PACKAGE* pPackage,
     __out BOOTSTRAPPER_PACKAGE_STATE* pPackageState,
     __out_opt LPWSTR* psczQuietUninstallString
     );
+static HRESULT PrepareExePackage(
+    __in BURN_EXECUTE_ACTION* pExecuteAction,
+    __in BURN_CACHE* pCache,
+    __in BURN_VARIABLES* pVariables,
+    __in BOOL fRollback,
+    __deref_out_z LPWSTR* psczExecutablePath,
+    __deref_out_z LPWSTR* psczBaseCommand,
+    __deref_out_z_opt LPWSTR* psczUserArgs,
+    __deref_out_z LPWSTR* psczCachedDirectory,
+    __inout HANDLE* phExecutableFile
+    );
+static void LogProcessOutput(
+    __in BURN_PACKAGE* pPackage,
+    __in HANDLE hOutputFile
+    );
 
 // function definitions
 
@@ -100,6 +117,10 @@ extern "C" HRESULT ExeEngineParsePackageFromXml(
     hr = XmlGetYesNoAttribute(pixnExePackage, L"Bundle", &pPackage->Exe.fBundle);
     ExitOnOptionalXmlQueryFailure(hr, fFoundXml, "Failed to get @Bundle.");
 
+    // @Independent
+    hr = XmlGetYesNoAttribute(pixnExePackage, L"Independent", &pPackage->Exe.fIndependent);
+    ExitOnOptionalXmlQueryFailure(hr, fFoundXml, "Failed to get @Independent.");
+
     // @Protocol
     hr = XmlGetAttributeEx(pixnExePackage, L"Protocol", &scz);
     ExitOnOptionalXmlQueryFailure(hr, fFoundXml, "Failed to get @Protocol.");
@@ -421,217 +442,23 @@ extern "C" HRESULT ExeEngineExecutePackage(
     )
 {
     HRESULT hr = S_OK;
-    LPCWSTR wzArguments = NULL;
     LPWSTR sczCachedDirectory = NULL;
     LPWSTR sczExecutablePath = NULL;
     LPWSTR sczBaseCommand = NULL;
-    LPWSTR sczUnformattedUserArgs = NULL;
     LPWSTR sczUserArgs = NULL;
-    LPWSTR sczUserArgsObfuscated = NULL;
-    LPWSTR sczCommandObfuscated = NULL;
-    LPWSTR sczArpUninstallString = NULL;
-    int argcArp = 0;
-    LPWSTR* argvArp = NULL;
-    BOOTSTRAPPER_PACKAGE_STATE applyState = BOOTSTRAPPER_PACKAGE_STATE_UNKNOWN;
     HANDLE hExecutableFile = INVALID_HANDLE_VALUE;
     BURN_PIPE_CONNECTION connection = { };
     DWORD dwExitCode = 0;
     BURN_PACKAGE* pPackage = pExecuteAction->exePackage.pPackage;
-    BURN_PAYLOAD* pPackagePayload = pPackage->payloads.rgItems[0].pPayload;
-
-    if (BURN_EXE_DETECTION_TYPE_ARP == pPackage->Exe.detectionType &&
-        (BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action ||
-        BOOTSTRAPPER_ACTION_STATE_INSTALL == pExecuteAction->exePackage.action && fRollback))
-    {
-        hr = DetectArpEntry(pPackage, &applyState, &sczArpUninstallString);
-        ExitOnFailure(hr, "Failed to query ArpEntry for %hs.", BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action ? "uninstall" : "install");
-
-        if (BOOTSTRAPPER_PACKAGE_STATE_ABSENT == applyState && BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action)
-        {
-            if (fRollback)
-            {
-                LogId(REPORT_STANDARD, MSG_ROLLBACK_PACKAGE_SKIPPED, pPackage->sczId, LoggingActionStateToString(pExecuteAction->exePackage.action), LoggingPackageStateToString(applyState));
-            }
-            else
-            {
-                LogId(REPORT_STANDARD, MSG_ATTEMPTED_UNINSTALL_ABSENT_PACKAGE, pPackage->sczId);
-            }
-
-            ExitFunction();
-        }
-        else if (BOOTSTRAPPER_PACKAGE_STATE_ABSENT != applyState && BOOTSTRAPPER_ACTION_STATE_INSTALL == pExecuteAction->exePackage.action)
-        {
-            LogId(REPORT_STANDARD, MSG_ROLLBACK_PACKAGE_SKIPPED, pPackage->sczId, LoggingActionStateToString(pExecuteAction->exePackage.action), LoggingPackageStateToString(applyState));
-            ExitFunction();
-        }
-    }
-
-    if (pPackage->Exe.fPseudoPackage && BURN_PAYLOAD_VERIFICATION_UPDATE_BUNDLE != pPackagePayload->verification)
-    {
-        if (!PathIsFullyQualified(pPackagePayload->sczFilePath))
-        {
-            ExitWithRootFailure(hr, E_INVALIDSTATE, "Pseudo ExePackages must have a fully qualified target path.");
-        }
-
-        hr = StrAllocString(&sczExecutablePath, pPackagePayload->sczFilePath, 0);
-        ExitOnFailure(hr, "Failed to build executable path.");
-
-        hr = PathGetDirectory(sczExecutablePath, &sczCachedDirectory);
-        ExitOnFailure(hr, "Failed to get parent directory for pseudo-package: %ls", pPackage->sczId);
-    }
-    else if (BURN_EXE_DETECTION_TYPE_ARP == pPackage->Exe.detectionType && BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action)
-    {
-        ExitOnNull(sczArpUninstallString, hr, E_INVALIDARG, "QuietUninstallString is null.");
-
-        hr = AppParseCommandLine(sczArpUninstallString, &argcArp, &argvArp);
-        ExitOnFailure(hr, "Failed to parse QuietUninstallString: %ls.", sczArpUninstallString);
-
-        ExitOnNull(argcArp, hr, E_INVALIDARG, "QuietUninstallString must contain an executable path.");
-
-        hr = StrAllocString(&sczExecutablePath, argvArp[0], 0);
-        ExitOnFailure(hr, "Failed to copy executable path.");
-
-        if (pPackage->fPerMachine)
-        {
-            hr = ApprovedExesVerifySecureLocation(pCache, pVariables, sczExecutablePath);
-            ExitOnFailure(hr, "Failed to verify the QuietUninstallString executable path is in a secure location: %ls", sczExecutablePath);
-            if (S_FALSE == hr)
-            {
-                LogStringLine(REPORT_STANDARD, "The QuietUninstallString executable path is not in a secure location: %ls", sczExecutablePath);
-                ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED));
-            }
-        }
-
-        hr = PathGetDirectory(sczExecutablePath, &sczCachedDirectory);
-        ExitOnFailure(hr, "Failed to get parent directory for QuietUninstallString executable path: %ls", sczExecutablePath);
-    }
-    else
-    {
-        // get cached executable path
-        hr = CacheGetCompletedPath(pCache, pPackage->fPerMachine, pPackage->sczCacheId, &sczCachedDirectory);
-        ExitOnFailure(hr, "Failed to get cached path for package: %ls", pPackage->sczId);
-
-        hr = PathConcatRelativeToFullyQualifiedBase(sczCachedDirectory, pPackagePayload->sczFilePath, &sczExecutablePath);
-        ExitOnFailure(hr, "Failed to build executable path.");
-    }
-
-    // Best effort to set the execute package cache folder and action variables.
-    VariableSetString(pVariables, BURN_BUNDLE_EXECUTE_PACKAGE_CACHE_FOLDER, sczCachedDirectory, TRUE, FALSE);
-    VariableSetNumeric(pVariables, BURN_BUNDLE_EXECUTE_PACKAGE_ACTION, pExecuteAction->exePackage.action, TRUE);
-
-    // pick arguments
-    switch (pExecuteAction->exePackage.action)
-    {
-    case BOOTSTRAPPER_ACTION_STATE_INSTALL:
-        wzArguments = pPackage->Exe.sczInstallArguments;
-        break;
-
-    case BOOTSTRAPPER_ACTION_STATE_UNINSTALL:
-        wzArguments = pPackage->Exe.sczUninstallArguments;
-        break;
-
-    case BOOTSTRAPPER_ACTION_STATE_REPAIR:
-        wzArguments = pPackage->Exe.sczRepairArguments;
-        break;
-
-    default:
-        ExitWithRootFailure(hr, E_INVALIDARG, "Invalid Exe package action: %d.", pExecuteAction->exePackage.action);
-    }
-
-    // now add optional arguments
-    hr = StrAllocString(&sczUnformattedUserArgs, wzArguments && *wzArguments ? wzArguments : L"", 0);
-    ExitOnFailure(hr, "Failed to copy package arguments.");
-
-    for (DWORD i = 0; i < pPackage->Exe.cCommandLineArguments; ++i)
-    {
-        BURN_EXE_COMMAND_LINE_ARGUMENT* commandLineArgument = &pPackage->Exe.rgCommandLineArguments[i];
-        BOOL fCondition = FALSE;
-
-        hr = ConditionEvaluate(pVariables, commandLineArgument->sczCondition, &fCondition);
-        ExitOnFailure(hr, "Failed to evaluate executable package command-line condition.");
-
-        if (fCondition)
-        {
-            hr = StrAllocConcat(&sczUnformattedUserArgs, L" ", 0);
-            ExitOnFailure(hr, "Failed to separate command-line arguments.");
-
-            switch (pExecuteAction->exePackage.action)
-            {
-            case BOOTSTRAPPER_ACTION_STATE_INSTALL:
-                hr = StrAllocConcat(&sczUnformattedUserArgs, commandLineArgument->sczInstallArgument, 0);
-                ExitOnFailure(hr, "Failed to get command-line argument for install.");
-                break;
 
-            case BOOTSTRAPPER_ACTION_STATE_UNINSTALL:
-                hr = StrAllocConcat(&sczUnformattedUserArgs, commandLineArgument->sczUninstallArgument, 0);
-                ExitOnFailure(hr, "Failed to get command-line argument for uninstall.");
-                break;
-
-            case BOOTSTRAPPER_ACTION_STATE_REPAIR:
-                hr = StrAllocConcat(&sczUnformattedUserArgs, commandLineArgument->sczRepairArgument, 0);
-                ExitOnFailure(hr, "Failed to get command-line argument for repair.");
-                break;
-
-            default:
-                ExitWithRootFailure(hr, E_INVALIDARG, "Invalid Exe package action: %d.", pExecuteAction->exePackage.action);
-            }
-        }
-    }
-
-    // build base command
-    hr = StrAllocFormatted(&sczBaseCommand, L"\"%ls\"", sczExecutablePath);
-    ExitOnFailure(hr, "Failed to allocate base command.");
-
-    for (int i = 1; i < argcArp; ++i)
-    {
-        hr = AppAppendCommandLineArgument(&sczBaseCommand, argvArp[i]);
-        ExitOnFailure(hr, "Failed to append argument from ARP.");
-    }
-
-    if (pPackage->Exe.fBundle)
-    {
-        hr = StrAllocConcat(&sczBaseCommand, L" -norestart", 0);
-        ExitOnFailure(hr, "Failed to append norestart argument.");
-
-        hr = StrAllocConcatFormatted(&sczBaseCommand, L" -%ls", BURN_COMMANDLINE_SWITCH_RELATED_CHAIN_PACKAGE);
-        ExitOnFailure(hr, "Failed to append the relation type to the command line.");
-
-        hr = StrAllocConcatFormatted(&sczBaseCommand, L" -%ls=ALL", BURN_COMMANDLINE_SWITCH_IGNOREDEPENDENCIES);
-        ExitOnFailure(hr, "Failed to append the list of dependencies to ignore to the command line.");
-
-        // Add the list of ancestors, if any, to the burn command line.
-        if (pExecuteAction->exePackage.sczAncestors)
-        {
-            hr = StrAllocConcatFormatted(&sczBaseCommand, L" -%ls=%ls", BURN_COMMANDLINE_SWITCH_ANCESTORS, pExecuteAction->exePackage.sczAncestors);
-            ExitOnFailure(hr, "Failed to append the list of ancestors to the command line.");
-        }
-
-        if (pExecuteAction->exePackage.sczEngineWorkingDirectory)
-        {
-            hr = CoreAppendEngineWorkingDirectoryToCommandLine(pExecuteAction->exePackage.sczEngineWorkingDirectory, &sczBaseCommand, NULL);
-            ExitOnFailure(hr, "Failed to append the custom working directory to the exepackage command line.");
-        }
-
-        hr = CoreAppendFileHandleSelfToCommandLine(sczExecutablePath, &hExecutableFile, &sczBaseCommand, NULL);
-        ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_FILEHANDLE_SELF);
-    }
+    hr = PrepareExePackage(pExecuteAction, pCache, pVariables, fRollback, &sczExecutablePath, &sczBaseCommand, &sczUserArgs, &sczCachedDirectory, &hExecutableFile);
+    ExitOnFailure(hr, "Failed to prepare EXE package: %ls", pPackage->sczId);
 
-    // build user args
-    if (sczUnformattedUserArgs && *sczUnformattedUserArgs)
+    if (S_FALSE == hr)
     {
-        hr = VariableFormatString(pVariables, sczUnformattedUserArgs, &sczUserArgs, NULL);
-        ExitOnFailure(hr, "Failed to format argument string.");
-
-        hr = VariableFormatStringObfuscated(pVariables, sczUnformattedUserArgs, &sczUserArgsObfuscated, NULL);
-        ExitOnFailure(hr, "Failed to format obfuscated argument string.");
-
-        hr = StrAllocFormatted(&sczCommandObfuscated, L"%ls %ls", sczBaseCommand, sczUserArgsObfuscated);
-        ExitOnFailure(hr, "Failed to allocate obfuscated exe command.");
+        ExitFunction1(hr = S_OK);
     }
 
-    // Log obfuscated command, which won't include raw hidden variable values or protocol specific arguments to avoid exposing secrets.
-    LogId(REPORT_STANDARD, MSG_APPLYING_PACKAGE, LoggingRollbackOrExecute(fRollback), pPackage->sczId, LoggingActionStateToString(pExecuteAction->exePackage.action), sczExecutablePath, sczCommandObfuscated ? sczCommandObfuscated : sczBaseCommand);
-
     if (!pPackage->Exe.fFireAndForget && BURN_EXE_PROTOCOL_TYPE_BURN == pPackage->Exe.protocol)
     {
         hr = EmbeddedRunBundle(&connection, sczExecutablePath, sczBaseCommand, sczUserArgs, pfnGenericMessageHandler, pvContext, &dwExitCode);
@@ -655,17 +482,7 @@ LExit:
     ReleaseStr(sczCachedDirectory);
     ReleaseStr(sczExecutablePath);
     ReleaseStr(sczBaseCommand);
-    ReleaseStr(sczUnformattedUserArgs);
     StrSecureZeroFreeString(sczUserArgs);
-    ReleaseStr(sczUserArgsObfuscated);
-    ReleaseStr(sczCommandObfuscated);
-    ReleaseStr(sczArpUninstallString);
-
-    if (argvArp)
-    {
-        AppFreeCommandLineArgs(argvArp);
-    }
-
     ReleaseFileHandle(hExecutableFile);
 
     // Best effort to clear the execute package cache folder and action variables.
@@ -690,9 +507,7 @@ extern "C" HRESULT ExeEngineRunProcess(
     LPWSTR sczCommand = NULL;
     PROCESS_INFORMATION pi = { };
     GENERIC_EXECUTE_MESSAGE message = { };
-    int nResult = IDNOACTION;
-    DWORD dwProcessId = 0;
-    BOOL fDelayedCancel = FALSE;
+    BURN_EXE_PROCESS process = { };
     BOOL fFireAndForget = BURN_PACKAGE_TYPE_EXE == pPackage->type && pPackage->Exe.fFireAndForget;
     BOOL fInheritHandles = BURN_PACKAGE_TYPE_BUNDLE == pPackage->type;
 
@@ -718,60 +533,23 @@ extern "C" HRESULT ExeEngineRunProcess(
         ExitFunction();
     }
 
-    dwProcessId = ::GetProcessId(pi.hProcess);
+    process.pPackage = pPackage;
+    process.hProcess = pi.hProcess;
+    process.dwProcessId = ::GetProcessId(pi.hProcess);
 
     // Wait for the executable process while sending fake progress to allow cancel.
     do
     {
-        memset(&message, 0, sizeof(message));
-        message.type = GENERIC_EXECUTE_MESSAGE_PROGRESS;
-        message.dwUIHint = MB_OKCANCEL;
-        message.progress.dwPercentage = 50;
-        nResult = pfnGenericMessageHandler(&message, pvContext);
-
-        if (IDCANCEL == nResult)
-        {
-            memset(&message, 0, sizeof(message));
-            message.type = GENERIC_EXECUTE_MESSAGE_PROCESS_CANCEL;
-            message.dwUIHint = MB_ABORTRETRYIGNORE;
-            message.processCancel.dwProcessId = dwProcessId;
-            nResult = pfnGenericMessageHandler(&message, pvContext);
-
-            if (IDIGNORE == nResult) // abandon
-            {
-                nResult = IDCANCEL;
-                fDelayedCancel = FALSE;
-            }
-            //else if (IDABORT == nResult) // kill
-            else // wait
-            {
-                if (!fDelayedCancel)
-                {
-                    fDelayedCancel = TRUE;
-
-                    LogId(REPORT_STANDARD, MSG_EXECUTE_PROCESS_DELAYED_CANCEL_REQUESTED, pPackage->sczId);
-                }
-
-                nResult = IDNOACTION;
-            }
-        }
-
-        hr = (IDOK == nResult || IDNOACTION == nResult) ? S_OK : IDCANCEL == nResult ? HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT) : HRESULT_FROM_WIN32(ERROR_INSTALL_FAILURE);
-        ExitOnRootFailure(hr, "Bootstrapper application aborted during package process progress.");
-
-        hr = CoreWaitForProcCompletion(pi.hProcess, 500, pdwExitCode);
+        hr = ExeEngineWaitForProcess(&process, 500, pfnGenericMessageHandler, pvContext);
         if (HRESULT_FROM_WIN32(WAIT_TIMEOUT) != hr)
         {
             ExitOnFailure(hr, "Failed to wait for executable to complete: %ls", wzExecutablePath);
         }
     } while (HRESULT_FROM_WIN32(WAIT_TIMEOUT) == hr);
 
-    memset(&message, 0, sizeof(message));
-    message.type = GENERIC_EXECUTE_MESSAGE_PROCESS_COMPLETED;
-    message.dwUIHint = MB_OK;
-    pfnGenericMessageHandler(&message, pvContext);
+    *pdwExitCode = process.dwExitCode;
 
-    if (fDelayedCancel)
+    if (process.fDelayedCancel)
     {
         ExitWithRootFailure(hr, HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT), "Bootstrapper application cancelled during package process progress, exit code: 0x%x", *pdwExitCode);
     }
@@ -784,40 +562,227 @@ LExit:
     return hr;
 }
 
-extern "C" void ExeEngineUpdateInstallRegistrationState(
-    __in BURN_EXECUTE_ACTION* pAction,
-    __in HRESULT hrExecute
+extern "C" HRESULT ExeEngineLaunchPackage(
+    __in BURN_EXECUTE_ACTION* pExecuteAction,
+    __in BURN_CACHE* pCache,
+    __in BURN_VARIABLES* pVariables,
+    __in_z LPCWSTR wzOutputFolder,
+    __in PFN_GENERICMESSAGEHANDLER pfnGenericMessageHandler,
+    __in LPVOID pvContext,
+    __inout BURN_EXE_PROCESS* pProcess
     )
 {
-    BURN_PACKAGE* pPackage = pAction->exePackage.pPackage;
+    HRESULT hr = S_OK;
+    LPWSTR sczCachedDirectory = NULL;
+    LPWSTR sczExecutablePath = NULL;
+    LPWSTR sczBaseCommand = NULL;
+    LPWSTR sczUserArgs = NULL;
+    LPWSTR sczCommand = NULL;
+    LPWSTR sczOutputName = NULL;
+    LPWSTR sczOutputPath = NULL;
+    HANDLE hExecutableFile = INVALID_HANDLE_VALUE;
+    SECURITY_ATTRIBUTES sa = { };
+    PROCESS_INFORMATION pi = { };
+    GENERIC_EXECUTE_MESSAGE message = { };
+    BURN_PACKAGE* pPackage = pExecuteAction->exePackage.pPackage;
 
-    if (FAILED(hrExecute) || !pPackage->fCanAffectRegistration)
+    pProcess->pPackage = pPackage;
+
+    hr = PrepareExePackage(pExecuteAction, pCache, pVariables, FALSE, &sczExecutablePath, &sczBaseCommand, &sczUserArgs, &sczCachedDirectory, &hExecutableFile);
+    ExitOnFailure(hr, "Failed to prepare EXE package: %ls", pPackage->sczId);
+
+    if (S_FALSE == hr)
     {
         ExitFunction();
     }
 
-    if (BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pAction->exePackage.action)
+    // Each process gets its own output file so the output of processes running at the same
+    // time doesn't get interleaved. The file goes away when the last handle to it is closed.
+    hr = StrAllocFormatted(&sczOutputName, L"%ls.output", pPackage->sczId);
+    ExitOnFailure(hr, "Failed to allocate output file name.");
+
+    hr = PathConcatRelativeToFullyQualifiedBase(wzOutputFolder, sczOutputName, &sczOutputPath);
+    ExitOnFailure(hr, "Failed to build output path.");
+
+    sa.nLength = sizeof(sa);
+    sa.bInheritHandle = TRUE;
+
+    pProcess->hOutputFile = ::CreateFileW(sczOutputPath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, &sa, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    if (INVALID_HANDLE_VALUE == pProcess->hOutputFile)
     {
-        pPackage->installRegistrationState = BURN_PACKAGE_REGISTRATION_STATE_ABSENT;
+        pProcess->hOutputFile = NULL;
+        ExitWithLastError(hr, "Failed to create output file: %ls", sczOutputPath);
     }
-    else
+
+    // Always add user supplied arguments last.
+    if (sczUserArgs)
     {
-        pPackage->installRegistrationState = BURN_PACKAGE_REGISTRATION_STATE_PRESENT;
+        hr = StrAllocFormattedSecure(&sczCommand, L"%ls %ls", sczBaseCommand, sczUserArgs);
+        ExitOnFailure(hr, "Failed to append user args.");
     }
 
-LExit:
-    return;
-}
+    hr = CoreCreateProcessWithOutput(sczExecutablePath, sczCommand ? sczCommand : sczBaseCommand, CREATE_NO_WINDOW, sczCachedDirectory, pProcess->hOutputFile, &pi);
+    ExitOnFailure(hr, "Failed to CreateProcess on path: %ls", sczExecutablePath);
 
-extern "C" HRESULT ExeEngineParseExitCodesFromXml(
-    __in IXMLDOMNode* pixnPackage,
-    __inout BURN_EXE_EXIT_CODE** prgExitCodes,
-    __inout DWORD* pcExitCodes
-    )
-{
-    HRESULT hr = S_OK;
-    IXMLDOMNodeList* pixnNodes = NULL;
-    IXMLDOMNode* pixnNode = NULL;
+    pProcess->hProcess = pi.hProcess;
+    pi.hProcess = NULL;
+    pProcess->dwProcessId = ::GetProcessId(pProcess->hProcess);
+
+    message.type = GENERIC_EXECUTE_MESSAGE_PROCESS_STARTED;
+    message.dwUIHint = MB_OK;
+    pfnGenericMessageHandler(&message, pvContext);
+
+LExit:
+    ReleaseStr(sczCachedDirectory);
+    ReleaseStr(sczExecutablePath);
+    ReleaseStr(sczBaseCommand);
+    StrSecureZeroFreeString(sczUserArgs);
+    StrSecureZeroFreeString(sczCommand);
+    ReleaseStr(sczOutputName);
+    ReleaseStr(sczOutputPath);
+    ReleaseFileHandle(hExecutableFile);
+    ReleaseHandle(pi.hThread);
+    ReleaseHandle(pi.hProcess);
+
+    // Best effort to clear the execute package cache folder and action variables.
+    VariableSetString(pVariables, BURN_BUNDLE_EXECUTE_PACKAGE_CACHE_FOLDER, NULL, TRUE, FALSE);
+    VariableSetString(pVariables, BURN_BUNDLE_EXECUTE_PACKAGE_ACTION, NULL, TRUE, FALSE);
+
+    return hr;
+}
+
+extern "C" HRESULT ExeEngineWaitForProcess(
+    __in BURN_EXE_PROCESS* pProcess,
+    __in DWORD dwTimeout,
+    __in PFN_GENERICMESSAGEHANDLER pfnGenericMessageHandler,
+    __in LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    GENERIC_EXECUTE_MESSAGE message = { };
+    int nResult = IDNOACTION;
+
+    message.type = GENERIC_EXECUTE_MESSAGE_PROGRESS;
+    message.dwUIHint = MB_OKCANCEL;
+    message.progress.dwPercentage = 50;
+    nResult = pfnGenericMessageHandler(&message, pvContext);
+
+    if (IDCANCEL == nResult)
+    {
+        memset(&message, 0, sizeof(message));
+        message.type = GENERIC_EXECUTE_MESSAGE_PROCESS_CANCEL;
+        message.dwUIHint = MB_ABORTRETRYIGNORE;
+        message.processCancel.dwProcessId = pProcess->dwProcessId;
+        nResult = pfnGenericMessageHandler(&message, pvContext);
+
+        if (IDIGNORE == nResult) // abandon
+        {
+            nResult = IDCANCEL;
+            pProcess->fDelayedCancel = FALSE;
+        }
+        //else if (IDABORT == nResult) // kill
+        else // wait
+        {
+            if (!pProcess->fDelayedCancel)
+            {
+                pProcess->fDelayedCancel = TRUE;
+
+                LogId(REPORT_STANDARD, MSG_EXECUTE_PROCESS_DELAYED_CANCEL_REQUESTED, pProcess->pPackage->sczId);
+            }
+
+            nResult = IDNOACTION;
+        }
+    }
+
+    hr = (IDOK == nResult || IDNOACTION == nResult) ? S_OK : IDCANCEL == nResult ? HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT) : HRESULT_FROM_WIN32(ERROR_INSTALL_FAILURE);
+    ExitOnRootFailure(hr, "Bootstrapper application aborted during package process progress.");
+
+    hr = CoreWaitForProcCompletion(pProcess->hProcess, dwTimeout, &pProcess->dwExitCode);
+    if (HRESULT_FROM_WIN32(WAIT_TIMEOUT) == hr)
+    {
+        ExitFunction();
+    }
+    ExitOnFailure(hr, "Failed to wait for process of package: %ls", pProcess->pPackage->sczId);
+
+    memset(&message, 0, sizeof(message));
+    message.type = GENERIC_EXECUTE_MESSAGE_PROCESS_COMPLETED;
+    message.dwUIHint = MB_OK;
+    pfnGenericMessageHandler(&message, pvContext);
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT ExeEngineCompleteProcess(
+    __in BURN_EXE_PROCESS* pProcess,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_PACKAGE* pPackage = pProcess->pPackage;
+
+    if (pProcess->hOutputFile)
+    {
+        LogProcessOutput(pPackage, pProcess->hOutputFile); // best effort.
+    }
+
+    if (pProcess->fDelayedCancel)
+    {
+        ExitWithRootFailure(hr, HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT), "Bootstrapper application cancelled during package process progress, exit code: 0x%x", pProcess->dwExitCode);
+    }
+
+    hr = ExeEngineHandleExitCode(pPackage->Exe.rgExitCodes, pPackage->Exe.cExitCodes, pPackage->sczId, pProcess->dwExitCode, pRestart);
+    ExitOnRootFailure(hr, "Process returned error: 0x%x", pProcess->dwExitCode);
+
+LExit:
+    return hr;
+}
+
+extern "C" void ExeEngineProcessUninitialize(
+    __in BURN_EXE_PROCESS* pProcess
+    )
+{
+    ReleaseHandle(pProcess->hProcess);
+    ReleaseHandle(pProcess->hOutputFile);
+
+    // clear struct
+    memset(pProcess, 0, sizeof(BURN_EXE_PROCESS));
+}
+
+extern "C" void ExeEngineUpdateInstallRegistrationState(
+    __in BURN_EXECUTE_ACTION* pAction,
+    __in HRESULT hrExecute
+    )
+{
+    BURN_PACKAGE* pPackage = pAction->exePackage.pPackage;
+
+    if (FAILED(hrExecute) || !pPackage->fCanAffectRegistration)
+    {
+        ExitFunction();
+    }
+
+    if (BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pAction->exePackage.action)
+    {
+        pPackage->installRegistrationState = BURN_PACKAGE_REGISTRATION_STATE_ABSENT;
+    }
+    else
+    {
+        pPackage->installRegistrationState = BURN_PACKAGE_REGISTRATION_STATE_PRESENT;
+    }
+
+LExit:
+    return;
+}
+
+extern "C" HRESULT ExeEngineParseExitCodesFromXml(
+    __in IXMLDOMNode* pixnPackage,
+    __inout BURN_EXE_EXIT_CODE** prgExitCodes,
+    __inout DWORD* pcExitCodes
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMNodeList* pixnNodes = NULL;
+    IXMLDOMNode* pixnNode = NULL;
     DWORD cNodes = 0;
     LPWSTR scz = NULL;
 
@@ -1132,3 +1097,282 @@ LExit:
 
     return hr;
 }
+
+static HRESULT PrepareExePackage(
+    __in BURN_EXECUTE_ACTION* pExecuteAction,
+    __in BURN_CACHE* pCache,
+    __in BURN_VARIABLES* pVariables,
+    __in BOOL fRollback,
+    __deref_out_z LPWSTR* psczExecutablePath,
+    __deref_out_z LPWSTR* psczBaseCommand,
+    __deref_out_z_opt LPWSTR* psczUserArgs,
+    __deref_out_z LPWSTR* psczCachedDirectory,
+    __inout HANDLE* phExecutableFile
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR wzArguments = NULL;
+    LPWSTR sczUnformattedUserArgs = NULL;
+    LPWSTR sczUserArgsObfuscated = NULL;
+    LPWSTR sczCommandObfuscated = NULL;
+    LPWSTR sczArpUninstallString = NULL;
+    int argcArp = 0;
+    LPWSTR* argvArp = NULL;
+    BOOTSTRAPPER_PACKAGE_STATE applyState = BOOTSTRAPPER_PACKAGE_STATE_UNKNOWN;
+    BURN_PACKAGE* pPackage = pExecuteAction->exePackage.pPackage;
+    BURN_PAYLOAD* pPackagePayload = pPackage->payloads.rgItems[0].pPayload;
+
+    if (BURN_EXE_DETECTION_TYPE_ARP == pPackage->Exe.detectionType &&
+        (BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action ||
+        BOOTSTRAPPER_ACTION_STATE_INSTALL == pExecuteAction->exePackage.action && fRollback))
+    {
+        hr = DetectArpEntry(pPackage, &applyState, &sczArpUninstallString);
+        ExitOnFailure(hr, "Failed to query ArpEntry for %hs.", BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action ? "uninstall" : "install");
+
+        if (BOOTSTRAPPER_PACKAGE_STATE_ABSENT == applyState && BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action)
+        {
+            if (fRollback)
+            {
+                LogId(REPORT_STANDARD, MSG_ROLLBACK_PACKAGE_SKIPPED, pPackage->sczId, LoggingActionStateToString(pExecuteAction->exePackage.action), LoggingPackageStateToString(applyState));
+            }
+            else
+            {
+                LogId(REPORT_STANDARD, MSG_ATTEMPTED_UNINSTALL_ABSENT_PACKAGE, pPackage->sczId);
+            }
+
+            ExitFunction1(hr = S_FALSE);
+        }
+        else if (BOOTSTRAPPER_PACKAGE_STATE_ABSENT != applyState && BOOTSTRAPPER_ACTION_STATE_INSTALL == pExecuteAction->exePackage.action)
+        {
+            LogId(REPORT_STANDARD, MSG_ROLLBACK_PACKAGE_SKIPPED, pPackage->sczId, LoggingActionStateToString(pExecuteAction->exePackage.action), LoggingPackageStateToString(applyState));
+            ExitFunction1(hr = S_FALSE);
+        }
+    }
+
+    if (pPackage->Exe.fPseudoPackage && BURN_PAYLOAD_VERIFICATION_UPDATE_BUNDLE != pPackagePayload->verification)
+    {
+        if (!PathIsFullyQualified(pPackagePayload->sczFilePath))
+        {
+            ExitWithRootFailure(hr, E_INVALIDSTATE, "Pseudo ExePackages must have a fully qualified target path.");
+        }
+
+        hr = StrAllocString(psczExecutablePath, pPackagePayload->sczFilePath, 0);
+        ExitOnFailure(hr, "Failed to build executable path.");
+
+        hr = PathGetDirectory(*psczExecutablePath, psczCachedDirectory);
+        ExitOnFailure(hr, "Failed to get parent directory for pseudo-package: %ls", pPackage->sczId);
+    }
+    else if (BURN_EXE_DETECTION_TYPE_ARP == pPackage->Exe.detectionType && BOOTSTRAPPER_ACTION_STATE_UNINSTALL == pExecuteAction->exePackage.action)
+    {
+        ExitOnNull(sczArpUninstallString, hr, E_INVALIDARG, "QuietUninstallString is null.");
+
+        hr = AppParseCommandLine(sczArpUninstallString, &argcArp, &argvArp);
+        ExitOnFailure(hr, "Failed to parse QuietUninstallString: %ls.", sczArpUninstallString);
+
+        ExitOnNull(argcArp, hr, E_INVALIDARG, "QuietUninstallString must contain an executable path.");
+
+        hr = StrAllocString(psczExecutablePath, argvArp[0], 0);
+        ExitOnFailure(hr, "Failed to copy executable path.");
+
+        if (pPackage->fPerMachine)
+        {
+            hr = ApprovedExesVerifySecureLocation(pCache, pVariables, *psczExecutablePath);
+            ExitOnFailure(hr, "Failed to verify the QuietUninstallString executable path is in a secure location: %ls", *psczExecutablePath);
+            if (S_FALSE == hr)
+            {
+                LogStringLine(REPORT_STANDARD, "The QuietUninstallString executable path is not in a secure location: %ls", *psczExecutablePath);
+                ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_ACCESS_DENIED));
+            }
+        }
+
+        hr = PathGetDirectory(*psczExecutablePath, psczCachedDirectory);
+        ExitOnFailure(hr, "Failed to get parent directory for QuietUninstallString executable path: %ls", *psczExecutablePath);
+    }
+    else
+    {
+        // get cached executable path
+        hr = CacheGetCompletedPath(pCache, pPackage->fPerMachine, pPackage->sczCacheId, psczCachedDirectory);
+        ExitOnFailure(hr, "Failed to get cached path for package: %ls", pPackage->sczId);
+
+        hr = PathConcatRelativeToFullyQualifiedBase(*psczCachedDirectory, pPackagePayload->sczFilePath, psczExecutablePath);
+        ExitOnFailure(hr, "Failed to build executable path.");
+    }
+
+    // Best effort to set the execute package cache folder and action variables.
+    VariableSetString(pVariables, BURN_BUNDLE_EXECUTE_PACKAGE_CACHE_FOLDER, *psczCachedDirectory, TRUE, FALSE);
+    VariableSetNumeric(pVariables, BURN_BUNDLE_EXECUTE_PACKAGE_ACTION, pExecuteAction->exePackage.action, TRUE);
+
+    // pick arguments
+    switch (pExecuteAction->exePackage.action)
+    {
+    case BOOTSTRAPPER_ACTION_STATE_INSTALL:
+        wzArguments = pPackage->Exe.sczInstallArguments;
+        break;
+
+    case BOOTSTRAPPER_ACTION_STATE_UNINSTALL:
+        wzArguments = pPackage->Exe.sczUninstallArguments;
+        break;
+
+    case BOOTSTRAPPER_ACTION_STATE_REPAIR:
+        wzArguments = pPackage->Exe.sczRepairArguments;
+        break;
+
+    default:
+        ExitWithRootFailure(hr, E_INVALIDARG, "Invalid Exe package action: %d.", pExecuteAction->exePackage.action);
+    }
+
+    // now add optional arguments
+    hr = StrAllocString(&sczUnformattedUserArgs, wzArguments && *wzArguments ? wzArguments : L"", 0);
+    ExitOnFailure(hr, "Failed to copy package arguments.");
+
+    for (DWORD i = 0; i < pPackage->Exe.cCommandLineArguments; ++i)
+    {
+        BURN_EXE_COMMAND_LINE_ARGUMENT* commandLineArgument = &pPackage->Exe.rgCommandLineArguments[i];
+        BOOL fCondition = FALSE;
+
+        hr = ConditionEvaluate(pVariables, commandLineArgument->sczCondition, &fCondition);
+        ExitOnFailure(hr, "Failed to evaluate executable package command-line condition.");
+
+        if (fCondition)
+        {
+            hr = StrAllocConcat(&sczUnformattedUserArgs, L" ", 0);
+            ExitOnFailure(hr, "Failed to separate command-line arguments.");
+
+            switch (pExecuteAction->exePackage.action)
+            {
+            case BOOTSTRAPPER_ACTION_STATE_INSTALL:
+                hr = StrAllocConcat(&sczUnformattedUserArgs, commandLineArgument->sczInstallArgument, 0);
+                ExitOnFailure(hr, "Failed to get command-line argument for install.");
+                break;
+
+            case BOOTSTRAPPER_ACTION_STATE_UNINSTALL:
+                hr = StrAllocConcat(&sczUnformattedUserArgs, commandLineArgument->sczUninstallArgument, 0);
+                ExitOnFailure(hr, "Failed to get command-line argument for uninstall.");
+                break;
+
+            case BOOTSTRAPPER_ACTION_STATE_REPAIR:
+                hr = StrAllocConcat(&sczUnformattedUserArgs, commandLineArgument->sczRepairArgument, 0);
+                ExitOnFailure(hr, "Failed to get command-line argument for repair.");
+                break;
+
+            default:
+                ExitWithRootFailure(hr, E_INVALIDARG, "Invalid Exe package action: %d.", pExecuteAction->exePackage.action);
+            }
+        }
+    }
+
+    // build base command
+    hr = StrAllocFormatted(psczBaseCommand, L"\"%ls\"", *psczExecutablePath);
+    ExitOnFailure(hr, "Failed to allocate base command.");
+
+    for (int i = 1; i < argcArp; ++i)
+    {
+        hr = AppAppendCommandLineArgument(psczBaseCommand, argvArp[i]);
+        ExitOnFailure(hr, "Failed to append argument from ARP.");
+    }
+
+    if (pPackage->Exe.fBundle)
+    {
+        hr = StrAllocConcat(psczBaseCommand, L" -norestart", 0);
+        ExitOnFailure(hr, "Failed to append norestart argument.");
+
+        hr = StrAllocConcatFormatted(psczBaseCommand, L" -%ls", BURN_COMMANDLINE_SWITCH_RELATED_CHAIN_PACKAGE);
+        ExitOnFailure(hr, "Failed to append the relation type to the command line.");
+
+        hr = StrAllocConcatFormatted(psczBaseCommand, L" -%ls=ALL", BURN_COMMANDLINE_SWITCH_IGNOREDEPENDENCIES);
+        ExitOnFailure(hr, "Failed to append the list of dependencies to ignore to the command line.");
+
+        // Add the list of ancestors, if any, to the burn command line.
+        if (pExecuteAction->exePackage.sczAncestors)
+        {
+            hr = StrAllocConcatFormatted(psczBaseCommand, L" -%ls=%ls", BURN_COMMANDLINE_SWITCH_ANCESTORS, pExecuteAction->exePackage.sczAncestors);
+            ExitOnFailure(hr, "Failed to append the list of ancestors to the command line.");
+        }
+
+        if (pExecuteAction->exePackage.sczEngineWorkingDirectory)
+        {
+            hr = CoreAppendEngineWorkingDirectoryToCommandLine(pExecuteAction->exePackage.sczEngineWorkingDirectory, psczBaseCommand, NULL);
+            ExitOnFailure(hr, "Failed to append the custom working directory to the exepackage command line.");
+        }
+
+        hr = CoreAppendFileHandleSelfToCommandLine(*psczExecutablePath, phExecutableFile, psczBaseCommand, NULL);
+        ExitOnFailure(hr, "Failed to append %ls", BURN_COMMANDLINE_SWITCH_FILEHANDLE_SELF);
+    }
+
+    // build user args
+    if (sczUnformattedUserArgs && *sczUnformattedUserArgs)
+    {
+        hr = VariableFormatString(pVariables, sczUnformattedUserArgs, psczUserArgs, NULL);
+        ExitOnFailure(hr, "Failed to format argument string.");
+
+        hr = VariableFormatStringObfuscated(pVariables, sczUnformattedUserArgs, &sczUserArgsObfuscated, NULL);
+        ExitOnFailure(hr, "Failed to format obfuscated argument string.");
+
+        hr = StrAllocFormatted(&sczCommandObfuscated, L"%ls %ls", *psczBaseCommand, sczUserArgsObfuscated);
+        ExitOnFailure(hr, "Failed to allocate obfuscated exe command.");
+    }
+
+    // Log obfuscated command, which won't include raw hidden variable values or protocol specific arguments to avoid exposing secrets.
+    LogId(REPORT_STANDARD, MSG_APPLYING_PACKAGE, LoggingRollbackOrExecute(fRollback), pPackage->sczId, LoggingActionStateToString(pExecuteAction->exePackage.action), *psczExecutablePath, sczCommandObfuscated ? sczCommandObfuscated : *psczBaseCommand);
+
+
+LExit:
+    ReleaseStr(sczUnformattedUserArgs);
+    ReleaseStr(sczUserArgsObfuscated);
+    ReleaseStr(sczCommandObfuscated);
+    ReleaseStr(sczArpUninstallString);
+
+    if (argvArp)
+    {
+        AppFreeCommandLineArgs(argvArp);
+    }
+
+    return hr;
+}
+
+static void LogProcessOutput(
+    __in BURN_PACKAGE* pPackage,
+    __in HANDLE hOutputFile
+    )
+{
+    HRESULT hr = S_OK;
+    LARGE_INTEGER liSize = { };
+    LARGE_INTEGER liStart = { };
+    DWORD cbOutput = 0;
+    DWORD cbRead = 0;
+    LPSTR pszOutput = NULL;
+
+    if (!::GetFileSizeEx(hOutputFile, &liSize))
+    {
+        ExitWithLastError(hr, "Failed to get size of output for package: %ls", pPackage->sczId);
+    }
+
+    if (!liSize.QuadPart)
+    {
+        ExitFunction();
+    }
+
+    // Only keep the end of very chatty processes, that's where the errors are.
+    cbOutput = liSize.QuadPart < BURN_EXE_MAX_LOGGED_OUTPUT ? static_cast<DWORD>(liSize.QuadPart) : BURN_EXE_MAX_LOGGED_OUTPUT;
+    liStart.QuadPart = liSize.QuadPart - cbOutput;
+
+    if (!::SetFilePointerEx(hOutputFile, liStart, NULL, FILE_BEGIN))
+    {
+        ExitWithLastError(hr, "Failed to seek output for package: %ls", pPackage->sczId);
+    }
+
+    pszOutput = static_cast<LPSTR>(MemAlloc(cbOutput + 1, TRUE));
+    ExitOnNull(pszOutput, hr, E_OUTOFMEMORY, "Failed to allocate buffer for output.");
+
+    if (!::ReadFile(hOutputFile, pszOutput, cbOutput, &cbRead, NULL))
+    {
+        ExitWithLastError(hr, "Failed to read output for package: %ls", pPackage->sczId);
+    }
+
+    pszOutput[cbRead] = '\0';
+
+    LogId(REPORT_STANDARD, MSG_EXECUTE_PACKAGE_PROCESS_OUTPUT, pPackage->sczId, pszOutput);
+
+LExit:
+    ReleaseMem(pszOutput);
+}
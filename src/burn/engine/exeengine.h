@@ -7,6 +7,19 @@ extern "C" {
 #endif
 
 
+// structs
+
+typedef struct _BURN_EXE_PROCESS
+{
+    BURN_PACKAGE* pPackage;
+    HANDLE hProcess;
+    DWORD dwProcessId;
+    HANDLE hOutputFile;         // optional, receives the standard output and error of the process.
+    BOOL fDelayedCancel;
+    DWORD dwExitCode;
+} BURN_EXE_PROCESS;
+
+
 // function declarations
 
 HRESULT ExeEngineParsePackageFromXml(
@@ -52,6 +65,28 @@ HRESULT ExeEngineRunProcess(
     __in_z_opt LPCWSTR wzCachedDirectory,
     __inout DWORD* pdwExitCode
     );
+HRESULT ExeEngineLaunchPackage(
+    __in BURN_EXECUTE_ACTION* pExecuteAction,
+    __in BURN_CACHE* pCache,
+    __in BURN_VARIABLES* pVariables,
+    __in_z LPCWSTR wzOutputFolder,
+    __in PFN_GENERICMESSAGEHANDLER pfnGenericMessageHandler,
+    __in LPVOID pvContext,
+    __inout BURN_EXE_PROCESS* pProcess
+    );
+HRESULT ExeEngineWaitForProcess(
+    __in BURN_EXE_PROCESS* pProcess,
+    __in DWORD dwTimeout,
+    __in PFN_GENERICMESSAGEHANDLER pfnGenericMessageHandler,
+    __in LPVOID pvContext
+    );
+HRESULT ExeEngineCompleteProcess(
+    __in BURN_EXE_PROCESS* pProcess,
+    __out BOOTSTRAPPER_APPLY_RESTART* pRestart
+    );
+void ExeEngineProcessUninitialize(
+    __in BURN_EXE_PROCESS* pProcess
+    );
 void ExeEngineUpdateInstallRegistrationState(
     __in BURN_EXECUTE_ACTION* pAction,
     __in HRESULT hrExecute
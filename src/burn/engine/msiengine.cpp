@@ -1175,6 +1175,7 @@ extern "C" HRESULT MsiEngineExecutePackage(
     __in BURN_EXECUTE_ACTION* pExecuteAction,
     __in BURN_CACHE* pCache,
     __in BURN_VARIABLES* pVariables,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
@@ -1257,6 +1258,8 @@ extern "C" HRESULT MsiEngineExecutePackage(
     {
         hr = WiuInitializeExternalUI(pfnMessageHandler, pExecuteAction->msiPackage.uiLevel, hwndParent, pvContext, fRollback, &context);
         ExitOnFailure(hr, "Failed to initialize external UI handler.");
+
+        WiuSetExternalUIMessageFilter(&context, pUserExperience->dwIgnoredMsiMessages, pUserExperience->dwMsiProgressGranularity);
     }
 
     if (pExecuteAction->msiPackage.sczLogPath && *pExecuteAction->msiPackage.sczLogPath)
@@ -1366,6 +1369,7 @@ extern "C" HRESULT MsiEngineUninstallCompatiblePackage(
     __in BURN_EXECUTE_ACTION* pExecuteAction,
     __in BURN_CACHE* /*pCache*/,
     __in BURN_VARIABLES* /*pVariables*/,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
@@ -1393,6 +1397,8 @@ extern "C" HRESULT MsiEngineUninstallCompatiblePackage(
     hr = WiuInitializeExternalUI(pfnMessageHandler, INSTALLUILEVEL_NONE, hwndParent, pvContext, fRollback, &context);
     ExitOnFailure(hr, "Failed to initialize external UI handler.");
 
+    WiuSetExternalUIMessageFilter(&context, pUserExperience->dwIgnoredMsiMessages, pUserExperience->dwMsiProgressGranularity);
+
     if (pExecuteAction->uninstallMsiCompatiblePackage.sczLogPath && *pExecuteAction->uninstallMsiCompatiblePackage.sczLogPath)
     {
         hr = WiuEnableLog(dwLogMode, pExecuteAction->uninstallMsiCompatiblePackage.sczLogPath, INSTALLLOGATTRIBUTES_APPEND);
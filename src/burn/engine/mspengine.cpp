@@ -577,6 +577,7 @@ extern "C" HRESULT MspEngineExecutePackage(
     __in BURN_EXECUTE_ACTION* pExecuteAction,
     __in BURN_CACHE* pCache,
     __in BURN_VARIABLES* pVariables,
+    __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BOOL fRollback,
     __in PFN_MSIEXECUTEMESSAGEHANDLER pfnMessageHandler,
     __in LPVOID pvContext,
@@ -646,6 +647,8 @@ extern "C" HRESULT MspEngineExecutePackage(
     {
         hr = WiuInitializeExternalUI(pfnMessageHandler, pExecuteAction->mspTarget.uiLevel, hwndParent, pvContext, fRollback, &context);
         ExitOnFailure(hr, "Failed to initialize external UI handler.");
+
+        WiuSetExternalUIMessageFilter(&context, pUserExperience->dwIgnoredMsiMessages, pUserExperience->dwMsiProgressGranularity);
     }
 
     //if (BURN_LOGGING_LEVEL_DEBUG == logLevel)
@@ -1109,11 +1112,18 @@ static HRESULT PlanTargetProduct(
     )
 {
     HRESULT hr = S_OK;
-    BURN_EXECUTE_ACTION* rgActions = fRollback ? pPlan->rgRollbackActions : pPlan->rgExecuteActions;
-    DWORD cActions = fRollback ? pPlan->cRollbackActions : pPlan->cExecuteActions;
+    BURN_EXECUTE_ACTION* rgActions = NULL;
+    DWORD cActions = 0;
     BURN_EXECUTE_ACTION* pAction = NULL;
     DWORD dwInsertSequence = 0;
 
+    // The search below needs every planned action in place.
+    hr = PlanSpliceInsertedActions(pPlan);
+    ExitOnFailure(hr, "Failed to splice inserted actions into plan.");
+
+    rgActions = fRollback ? pPlan->rgRollbackActions : pPlan->rgExecuteActions;
+    cActions = fRollback ? pPlan->cRollbackActions : pPlan->cExecuteActions;
+
     // Try to find another MSP action with the exact same action (install or uninstall) targeting
     // the same product in the same machine context (per-user or per-machine).
     for (DWORD i = 0; i < cActions; ++i)
@@ -1180,8 +1190,7 @@ static HRESULT PlanTargetProduct(
             pWaitSyncPointAction->type = BURN_EXECUTE_ACTION_TYPE_WAIT_CACHE_PACKAGE;
             pWaitSyncPointAction->waitCachePackage.pPackage = pPackage;
 
-            // Since we inserted an action before the MSP target action that we will be updating, need to update the pointer.
-            pAction = pPlan->rgExecuteActions + (dwInsertSequence + 1);
+            // The inserted action is held aside until the plan is spliced, so the MSP target action we are updating has not moved.
         }
     }
 
@@ -375,6 +375,7 @@ typedef struct _BURN_PACKAGE
             BOOL fBundle;
             BOOL fPseudoPackage;
             BOOL fFireAndForget;
+            BOOL fIndependent;
             BOOL fRepairable;
             BOOL fUninstallable;
             BURN_EXE_PROTOCOL_TYPE protocol;
@@ -113,6 +113,20 @@ static HRESULT ProcessPayloadGroup(
     __in BURN_PLAN* pPlan,
     __in BURN_PAYLOAD_GROUP* pPayloadGroup
     );
+static HRESULT InsertAction(
+    __in DWORD dwIndex,
+    __inout BURN_INSERTED_EXECUTE_ACTION** prgInsertedActions,
+    __inout DWORD* pcInsertedActions,
+    __inout DWORD* pcInsertedActionsCapacity,
+    __out BURN_EXECUTE_ACTION** ppAction
+    );
+static HRESULT SpliceInsertedActions(
+    __inout BURN_EXECUTE_ACTION** prgActions,
+    __inout DWORD* pcActions,
+    __inout DWORD* pcActionsCapacity,
+    __in_ecount(*pcInsertedActions) BURN_INSERTED_EXECUTE_ACTION* rgInsertedActions,
+    __inout DWORD* pcInsertedActions
+    );
 static void RemoveUnnecessaryActions(
     __in BOOL fExecute,
     __in BURN_EXECUTE_ACTION* rgActions,
@@ -194,6 +208,15 @@ extern "C" void PlanReset(
         MemFree(pPlan->rgExecuteActions);
     }
 
+    if (pPlan->rgInsertedExecuteActions)
+    {
+        for (DWORD i = 0; i < pPlan->cInsertedExecuteActions; ++i)
+        {
+            PlanUninitializeExecuteAction(&pPlan->rgInsertedExecuteActions[i].action);
+        }
+        MemFree(pPlan->rgInsertedExecuteActions);
+    }
+
     if (pPlan->rgRollbackActions)
     {
         for (DWORD i = 0; i < pPlan->cRollbackActions; ++i)
@@ -203,6 +226,15 @@ extern "C" void PlanReset(
         MemFree(pPlan->rgRollbackActions);
     }
 
+    if (pPlan->rgInsertedRollbackActions)
+    {
+        for (DWORD i = 0; i < pPlan->cInsertedRollbackActions; ++i)
+        {
+            PlanUninitializeExecuteAction(&pPlan->rgInsertedRollbackActions[i].action);
+        }
+        MemFree(pPlan->rgInsertedRollbackActions);
+    }
+
     if (pPlan->rgRestoreRelatedBundleActions)
     {
         for (DWORD i = 0; i < pPlan->cRestoreRelatedBundleActions; ++i)
@@ -1502,6 +1534,9 @@ extern "C" HRESULT PlanRelatedBundlesComplete(
     BOOL fInstallingAnyPackage = FALSE;
     BOOL fUninstalling = BOOTSTRAPPER_ACTION_UNINSTALL == pPlan->action || BOOTSTRAPPER_ACTION_UNSAFE_UNINSTALL == pPlan->action;
 
+    hr = PlanSpliceInsertedActions(pPlan);
+    ExitOnFailure(hr, "Failed to splice inserted actions into plan.");
+
     // Get the list of dependencies to ignore to pass to related bundles.
     hr = DependencyAllocIgnoreDependencies(pPlan, &sczIgnoreDependencies);
     ExitOnFailure(hr, "Failed to get the list of dependencies to ignore.");
@@ -1713,6 +1748,10 @@ extern "C" HRESULT PlanRelatedBundlesComplete(
         }
     }
 
+    // Related bundles are planned after the packages were finalized, so splice their early actions in now.
+    hr = PlanSpliceInsertedActions(pPlan);
+    ExitOnFailure(hr, "Failed to splice inserted actions into plan.");
+
 LExit:
     ReleaseDict(sdProviderKeys);
     ReleaseStr(sczIgnoreDependencies);
@@ -1726,6 +1765,9 @@ extern "C" HRESULT PlanFinalizeActions(
 {
     HRESULT hr = S_OK;
 
+    hr = PlanSpliceInsertedActions(pPlan);
+    ExitOnFailure(hr, "Failed to splice inserted actions into plan.");
+
     FinalizePatchActions(TRUE, pPlan->rgExecuteActions, pPlan->cExecuteActions);
 
     FinalizePatchActions(FALSE, pPlan->rgRollbackActions, pPlan->cRollbackActions);
@@ -1734,6 +1776,7 @@ extern "C" HRESULT PlanFinalizeActions(
 
     RemoveUnnecessaryActions(FALSE, pPlan->rgRollbackActions, pPlan->cRollbackActions);
 
+LExit:
     return hr;
 }
 
@@ -1876,11 +1919,10 @@ extern "C" HRESULT PlanInsertExecuteAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemInsertIntoArray((void**)&pPlan->rgExecuteActions, dwIndex, 1, pPlan->cExecuteActions + 1, sizeof(BURN_EXECUTE_ACTION), 5);
-    ExitOnFailure(hr, "Failed to grow plan's array of execute actions.");
+    AssertSz(dwIndex <= pPlan->cExecuteActions + pPlan->cInsertedExecuteActions, "Execute action inserted past the end of the plan");
 
-    *ppExecuteAction = pPlan->rgExecuteActions + dwIndex;
-    ++pPlan->cExecuteActions;
+    hr = InsertAction(dwIndex, &pPlan->rgInsertedExecuteActions, &pPlan->cInsertedExecuteActions, &pPlan->cInsertedExecuteActionsCapacity, ppExecuteAction);
+    ExitOnFailure(hr, "Failed to insert execute action.");
 
 LExit:
     return hr;
@@ -1894,11 +1936,26 @@ extern "C" HRESULT PlanInsertRollbackAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemInsertIntoArray((void**)&pPlan->rgRollbackActions, dwIndex, 1, pPlan->cRollbackActions + 1, sizeof(BURN_EXECUTE_ACTION), 5);
-    ExitOnFailure(hr, "Failed to grow plan's array of rollback actions.");
+    AssertSz(dwIndex <= pPlan->cRollbackActions + pPlan->cInsertedRollbackActions, "Rollback action inserted past the end of the plan");
 
-    *ppRollbackAction = pPlan->rgRollbackActions + dwIndex;
-    ++pPlan->cRollbackActions;
+    hr = InsertAction(dwIndex, &pPlan->rgInsertedRollbackActions, &pPlan->cInsertedRollbackActions, &pPlan->cInsertedRollbackActionsCapacity, ppRollbackAction);
+    ExitOnFailure(hr, "Failed to insert rollback action.");
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT PlanSpliceInsertedActions(
+    __in BURN_PLAN* pPlan
+    )
+{
+    HRESULT hr = S_OK;
+
+    hr = SpliceInsertedActions(&pPlan->rgExecuteActions, &pPlan->cExecuteActions, &pPlan->cExecuteActionsCapacity, pPlan->rgInsertedExecuteActions, &pPlan->cInsertedExecuteActions);
+    ExitOnFailure(hr, "Failed to splice inserted execute actions.");
+
+    hr = SpliceInsertedActions(&pPlan->rgRollbackActions, &pPlan->cRollbackActions, &pPlan->cRollbackActionsCapacity, pPlan->rgInsertedRollbackActions, &pPlan->cInsertedRollbackActions);
+    ExitOnFailure(hr, "Failed to splice inserted rollback actions.");
 
 LExit:
     return hr;
@@ -1911,7 +1968,7 @@ extern "C" HRESULT PlanAppendExecuteAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemEnsureArraySize((void**)&pPlan->rgExecuteActions, pPlan->cExecuteActions + 1, sizeof(BURN_EXECUTE_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgExecuteActions, pPlan->cExecuteActions + 1, &pPlan->cExecuteActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of execute actions.");
 
     *ppExecuteAction = pPlan->rgExecuteActions + pPlan->cExecuteActions;
@@ -1928,7 +1985,7 @@ extern "C" HRESULT PlanAppendRollbackAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemEnsureArraySize((void**)&pPlan->rgRollbackActions, pPlan->cRollbackActions + 1, sizeof(BURN_EXECUTE_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgRollbackActions, pPlan->cRollbackActions + 1, &pPlan->cRollbackActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of rollback actions.");
 
     *ppRollbackAction = pPlan->rgRollbackActions + pPlan->cRollbackActions;
@@ -2283,7 +2340,7 @@ static HRESULT AddRegistrationAction(
     BURN_DEPENDENT_REGISTRATION_ACTION* pAction = NULL;
 
     // Create forward registration action.
-    hr = MemEnsureArraySize((void**)&pPlan->rgRegistrationActions, pPlan->cRegistrationActions + 1, sizeof(BURN_DEPENDENT_REGISTRATION_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgRegistrationActions, pPlan->cRegistrationActions + 1, &pPlan->cRegistrationActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of registration actions.");
 
     pAction = pPlan->rgRegistrationActions + pPlan->cRegistrationActions;
@@ -2298,7 +2355,7 @@ static HRESULT AddRegistrationAction(
     ExitOnFailure(hr, "Failed to copy dependent provider key to registration action.");
 
     // Create rollback registration action.
-    hr = MemEnsureArraySize((void**)&pPlan->rgRollbackRegistrationActions, pPlan->cRollbackRegistrationActions + 1, sizeof(BURN_DEPENDENT_REGISTRATION_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgRollbackRegistrationActions, pPlan->cRollbackRegistrationActions + 1, &pPlan->cRollbackRegistrationActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of rollback registration actions.");
 
     pAction = pPlan->rgRollbackRegistrationActions + pPlan->cRollbackRegistrationActions;
@@ -2449,7 +2506,7 @@ static HRESULT AppendCacheAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pPlan->rgCacheActions), pPlan->cCacheActions + 1, sizeof(BURN_CACHE_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgCacheActions, pPlan->cCacheActions + 1, &pPlan->cCacheActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of cache actions.");
 
     *ppCacheAction = pPlan->rgCacheActions + pPlan->cCacheActions;
@@ -2466,7 +2523,7 @@ static HRESULT AppendRollbackCacheAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pPlan->rgRollbackCacheActions), pPlan->cRollbackCacheActions + 1, sizeof(BURN_CACHE_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgRollbackCacheActions, pPlan->cRollbackCacheActions + 1, &pPlan->cRollbackCacheActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of rollback cache actions.");
 
     *ppCacheAction = pPlan->rgRollbackCacheActions + pPlan->cRollbackCacheActions;
@@ -2483,7 +2540,7 @@ static HRESULT AppendCleanAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pPlan->rgCleanActions), pPlan->cCleanActions, 1, sizeof(BURN_CLEAN_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgCleanActions, pPlan->cCleanActions + 1, &pPlan->cCleanActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of clean actions.");
 
 
@@ -2501,7 +2558,7 @@ static HRESULT AppendRestoreRelatedBundleAction(
 {
     HRESULT hr = S_OK;
 
-    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pPlan->rgRestoreRelatedBundleActions), pPlan->cRestoreRelatedBundleActions, 1, sizeof(BURN_EXECUTE_ACTION), 5);
+    hr = MemEnsureArrayCapacityOf(pPlan->rgRestoreRelatedBundleActions, pPlan->cRestoreRelatedBundleActions + 1, &pPlan->cRestoreRelatedBundleActionsCapacity);
     ExitOnFailure(hr, "Failed to grow plan's array of restore related bundle actions.");
 
     *ppExecuteAction = pPlan->rgRestoreRelatedBundleActions + pPlan->cRestoreRelatedBundleActions;
@@ -2511,6 +2568,142 @@ LExit:
     return hr;
 }
 
+static HRESULT InsertAction(
+    __in DWORD dwIndex,
+    __inout BURN_INSERTED_EXECUTE_ACTION** prgInsertedActions,
+    __inout DWORD* pcInsertedActions,
+    __inout DWORD* pcInsertedActionsCapacity,
+    __out BURN_EXECUTE_ACTION** ppAction
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_INSERTED_EXECUTE_ACTION* pInsertedAction = NULL;
+
+    hr = MemEnsureArrayCapacityOf(*prgInsertedActions, *pcInsertedActions + 1, pcInsertedActionsCapacity);
+    ExitOnFailure(hr, "Failed to grow plan's array of inserted actions.");
+
+    // Slots are reused after a splice, so clear whatever was moved out of this one.
+    pInsertedAction = *prgInsertedActions + *pcInsertedActions;
+    memset(pInsertedAction, 0, sizeof(BURN_INSERTED_EXECUTE_ACTION));
+
+    pInsertedAction->dwIndex = dwIndex;
+    *ppAction = &pInsertedAction->action;
+    ++*pcInsertedActions;
+
+LExit:
+    return hr;
+}
+
+static HRESULT SpliceInsertedActions(
+    __inout BURN_EXECUTE_ACTION** prgActions,
+    __inout DWORD* pcActions,
+    __inout DWORD* pcActionsCapacity,
+    __in_ecount(*pcInsertedActions) BURN_INSERTED_EXECUTE_ACTION* rgInsertedActions,
+    __inout DWORD* pcInsertedActions
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cInsertedActions = *pcInsertedActions;
+    DWORD cActions = *pcActions;
+    DWORD cFinal = cActions + cInsertedActions;
+    DWORD iAction = cActions;
+    DWORD iFinal = cFinal;
+    DWORD dwHighStep = 1;
+    DWORD* rgcFreeSlots = NULL;
+    DWORD* rgiSlotInsertedAction = NULL;
+    BURN_EXECUTE_ACTION* rgActions = NULL;
+
+    if (!cInsertedActions)
+    {
+        ExitFunction();
+    }
+
+    // Each index was relative to the actions inserted before it. Walking the inserts backwards,
+    // an insert at index N lands in the Nth slot of the final list that no later insert took.
+    // Actions appended in the meantime went to the end so they only take trailing slots and
+    // never move an inserted action. A Fenwick tree counting the free slots finds each one in
+    // O(log n) instead of replaying every earlier insert.
+    hr = MemAllocArray(reinterpret_cast<LPVOID*>(&rgcFreeSlots), sizeof(DWORD), cFinal + 1);
+    ExitOnFailure(hr, "Failed to allocate free slot counts.");
+
+    hr = MemAllocArray(reinterpret_cast<LPVOID*>(&rgiSlotInsertedAction), sizeof(DWORD), cFinal);
+    ExitOnFailure(hr, "Failed to allocate inserted action slots.");
+
+    for (DWORD i = 1; i <= cFinal; ++i)
+    {
+        DWORD iParent = i + (i & (0 - i));
+
+        rgcFreeSlots[i] += 1;
+
+        if (iParent <= cFinal)
+        {
+            rgcFreeSlots[iParent] += rgcFreeSlots[i];
+        }
+    }
+
+    while (dwHighStep <= cFinal / 2)
+    {
+        dwHighStep <<= 1;
+    }
+
+    for (DWORD i = cInsertedActions; i > 0; --i)
+    {
+        DWORD cRemaining = rgInsertedActions[i - 1].dwIndex + 1;
+        DWORD iSlot = 0;
+
+        for (DWORD dwStep = dwHighStep; dwStep; dwStep >>= 1)
+        {
+            if (iSlot + dwStep <= cFinal && rgcFreeSlots[iSlot + dwStep] < cRemaining)
+            {
+                iSlot += dwStep;
+                cRemaining -= rgcFreeSlots[iSlot];
+            }
+        }
+
+        if (iSlot >= cFinal)
+        {
+            ExitWithRootFailure(hr, E_INVALIDSTATE, "Action inserted at index %u past the end of the plan.", rgInsertedActions[i - 1].dwIndex);
+        }
+
+        // Stored one-based so zero marks a slot left for the existing actions.
+        rgiSlotInsertedAction[iSlot] = i;
+
+        for (DWORD j = iSlot + 1; j <= cFinal; j += j & (0 - j))
+        {
+            --rgcFreeSlots[j];
+        }
+    }
+
+    hr = MemEnsureArrayCapacityOf(*prgActions, cFinal, pcActionsCapacity);
+    ExitOnFailure(hr, "Failed to grow plan's array of actions.");
+
+    // Fill from the end so each existing action moves at most once.
+    rgActions = *prgActions;
+    while (iFinal)
+    {
+        --iFinal;
+
+        if (rgiSlotInsertedAction[iFinal])
+        {
+            rgActions[iFinal] = rgInsertedActions[rgiSlotInsertedAction[iFinal] - 1].action;
+        }
+        else
+        {
+            --iAction;
+            rgActions[iFinal] = rgActions[iAction];
+        }
+    }
+
+    *pcActions = cFinal;
+    *pcInsertedActions = 0;
+
+LExit:
+    ReleaseMem(rgiSlotInsertedAction);
+    ReleaseMem(rgcFreeSlots);
+
+    return hr;
+}
+
 static HRESULT ProcessPayloadGroup(
     __in BURN_PLAN* pPlan,
     __in BURN_PAYLOAD_GROUP* pPayloadGroup
@@ -246,6 +246,12 @@ typedef struct _BURN_CLEAN_ACTION
     BURN_PACKAGE* pPackage;
 } BURN_CLEAN_ACTION;
 
+typedef struct _BURN_INSERTED_EXECUTE_ACTION
+{
+    DWORD dwIndex;
+    BURN_EXECUTE_ACTION action;
+} BURN_INSERTED_EXECUTE_ACTION;
+
 typedef struct _BURN_PLAN
 {
     BOOTSTRAPPER_ACTION action;
@@ -276,27 +282,43 @@ typedef struct _BURN_PLAN
 
     BURN_DEPENDENT_REGISTRATION_ACTION* rgRegistrationActions;
     DWORD cRegistrationActions;
+    DWORD cRegistrationActionsCapacity;
 
     BURN_DEPENDENT_REGISTRATION_ACTION* rgRollbackRegistrationActions;
     DWORD cRollbackRegistrationActions;
+    DWORD cRollbackRegistrationActionsCapacity;
 
     BURN_CACHE_ACTION* rgCacheActions;
     DWORD cCacheActions;
+    DWORD cCacheActionsCapacity;
 
     BURN_CACHE_ACTION* rgRollbackCacheActions;
     DWORD cRollbackCacheActions;
+    DWORD cRollbackCacheActionsCapacity;
 
     BURN_EXECUTE_ACTION* rgExecuteActions;
     DWORD cExecuteActions;
+    DWORD cExecuteActionsCapacity;
+
+    BURN_INSERTED_EXECUTE_ACTION* rgInsertedExecuteActions; // spliced into rgExecuteActions by PlanSpliceInsertedActions.
+    DWORD cInsertedExecuteActions;
+    DWORD cInsertedExecuteActionsCapacity;
 
     BURN_EXECUTE_ACTION* rgRollbackActions;
     DWORD cRollbackActions;
+    DWORD cRollbackActionsCapacity;
+
+    BURN_INSERTED_EXECUTE_ACTION* rgInsertedRollbackActions; // spliced into rgRollbackActions by PlanSpliceInsertedActions.
+    DWORD cInsertedRollbackActions;
+    DWORD cInsertedRollbackActionsCapacity;
 
     BURN_EXECUTE_ACTION* rgRestoreRelatedBundleActions;
     DWORD cRestoreRelatedBundleActions;
+    DWORD cRestoreRelatedBundleActionsCapacity;
 
     BURN_CLEAN_ACTION* rgCleanActions;
     DWORD cCleanActions;
+    DWORD cCleanActionsCapacity;
 
     DEPENDENCY* rgPlannedProviders;
     UINT cPlannedProviders;
@@ -453,6 +475,9 @@ HRESULT PlanInsertRollbackAction(
     __in BURN_PLAN* pPlan,
     __out BURN_EXECUTE_ACTION** ppRollbackAction
     );
+HRESULT PlanSpliceInsertedActions(
+    __in BURN_PLAN* pPlan
+    );
 HRESULT PlanAppendExecuteAction(
     __in BURN_PLAN* pPlan,
     __out BURN_EXECUTE_ACTION** ppExecuteAction
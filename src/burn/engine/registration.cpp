@@ -31,6 +31,23 @@ const LPCWSTR REGISTRY_BUNDLE_VERSION_MAJOR = L"VersionMajor";
 const LPCWSTR REGISTRY_BUNDLE_VERSION_MINOR = L"VersionMinor";
 const LPCWSTR SWIDTAG_FOLDER = L"swidtag";
 const LPCWSTR REGISTRY_BUNDLE_VARIABLE_KEY = L"variables";
+const DWORD STATE_JOURNAL_SIGNATURE = 0x4a534e42; // "BNSJ"
+const DWORD STATE_JOURNAL_VERSION = 1;
+
+// The state file is a header followed by records. The first record is a snapshot
+// of all persisted variables and each record after it holds only the ones that changed.
+typedef struct _BURN_STATE_JOURNAL_HEADER
+{
+    DWORD dwSignature;
+    DWORD dwVersion;
+} BURN_STATE_JOURNAL_HEADER;
+
+typedef struct _BURN_STATE_JOURNAL_RECORD
+{
+    DWORD cbData;
+    DWORD dwChecksum;
+    // followed by cbData bytes of serialized variables
+} BURN_STATE_JOURNAL_RECORD;
 
 // internal function declarations
 
@@ -108,6 +125,21 @@ static HRESULT UpdateEstimatedSize(
     );
 static BOOL IsWuRebootPending();
 static BOOL IsRegistryRebootPending();
+static DWORD ComputeStateChecksum(
+    __in_bcount(cbData) const BYTE* pbData,
+    __in SIZE_T cbData
+    );
+static HRESULT WriteStateRecord(
+    __in HANDLE hFile,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer
+    );
+static HRESULT WriteRegistryVariables(
+    __in BURN_REGISTRATION* pRegistration,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer,
+    __in BOOL fReplace
+    );
 
 // function definitions
 
@@ -616,6 +648,9 @@ extern "C" HRESULT RegistrationSessionBegin(
 
     LogId(REPORT_VERBOSE, MSG_SESSION_BEGIN, pRegistration->sczRegistrationKey, dwRegistrationOptions, LoggingBoolToString(pRegistration->fDisableResume));
 
+    // The first save of a session always writes a new snapshot.
+    RegistrationResetStateJournal(pRegistration);
+
     // Cache bundle executable.
     if (dwRegistrationOptions & BURN_REGISTRATION_ACTION_OPERATIONS_CACHE_BUNDLE)
     {
@@ -881,6 +916,9 @@ extern "C" HRESULT RegistrationSessionEnd(
         ExitOnPathFailure(hr, fDeleted, "Failed to delete registration key: %ls", pRegistration->sczRegistrationKey);
 
         CacheRemoveBundle(pCache, pRegistration->fPerMachine, pRegistration->sczId);
+
+        // The state file went away with the cache.
+        RegistrationResetStateJournal(pRegistration);
     }
     else // the mode needs to be updated so open the registration key.
     {
@@ -908,8 +946,24 @@ LExit:
     return hr;
 }
 
+/*******************************************************************
+ RegistrationResetStateJournal - Forgets what was saved to the state file so
+                                 the next save writes a new snapshot.
+
+*******************************************************************/
+extern "C" void RegistrationResetStateJournal(
+    __in BURN_REGISTRATION* pRegistration
+    )
+{
+    pRegistration->fStateSaved = FALSE;
+    pRegistration->dwStateSequence = 0;
+    pRegistration->cbStateSnapshot = 0;
+    pRegistration->cbStateJournal = 0;
+}
+
 /*******************************************************************
  RegistrationSaveState - Saves an engine state BLOB for retreval after a resume.
+                         The state file is started over with the BLOB as its snapshot.
 
 *******************************************************************/
 extern "C" HRESULT RegistrationSaveState(
@@ -919,114 +973,156 @@ extern "C" HRESULT RegistrationSaveState(
     )
 {
     HRESULT hr = S_OK;
-    BURN_VARIABLES variables = { };
-    SIZE_T iBuffer_Unused = 0;
-    HKEY hkRegistration = NULL;
-    LPWSTR sczVariableKey = NULL;
-    LPWSTR sczVariableValue = NULL;
-    LPWSTR sczValueName = NULL;
-    DWORD dwType = 0;
-    DWORD dwNumberOfExistingValues = 0;
-    DWORD er = ERROR_SUCCESS;
-
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    BURN_STATE_JOURNAL_HEADER header = { STATE_JOURNAL_SIGNATURE, STATE_JOURNAL_VERSION };
 
     // write data to file
-    hr = FileWrite(pRegistration->sczStateFile, FILE_ATTRIBUTE_NORMAL, pbBuffer, cbBuffer, NULL);
+    hr = FileWrite(pRegistration->sczStateFile, FILE_ATTRIBUTE_NORMAL, reinterpret_cast<LPCBYTE>(&header), sizeof(header), &hFile);
     if (E_PATHNOTFOUND == hr)
     {
         // TODO: should we log that the bundle's cache folder was not present so the state file wasn't created either?
         hr = S_OK;
     }
+    else if (SUCCEEDED(hr))
+    {
+        hr = WriteStateRecord(hFile, pbBuffer, cbBuffer);
+    }
     ExitOnFailure(hr, "Failed to write state to file: %ls", pRegistration->sczStateFile);
 
-    ::InitializeCriticalSection(&variables.csAccess);
+    hr = WriteRegistryVariables(pRegistration, pbBuffer, cbBuffer, TRUE);
+    ExitOnFailure(hr, "Failed to write registration variables.");
 
-    hr = VariableDeserialize(&variables, TRUE, pbBuffer, cbBuffer, &iBuffer_Unused);
-    ExitOnFailure(hr, "Failed to read variables.");
+LExit:
+    ReleaseFileHandle(hFile);
 
-    // build variable registry key path
-    hr = StrAllocFormatted(&sczVariableKey, L"%s\\%s", pRegistration->sczRegistrationKey, REGISTRY_BUNDLE_VARIABLE_KEY);
-    ExitOnFailure(hr, "Failed to build variable registry key path.");
+    return hr;
+}
 
-    // open registration variable key
-    hr = RegCreate(pRegistration->hkRoot, sczVariableKey, KEY_WRITE | KEY_QUERY_VALUE, &hkRegistration);
-    ExitOnFailure(hr, "Failed to create registration variable key.");
+/*******************************************************************
+ RegistrationAppendState - Appends the variables that changed since the last save
+                           to the state file. Returns S_FALSE when there is no
+                           state file to append to.
 
-    hr = RegQueryInfoKey(hkRegistration, 0, 0, 0, 0, 0, 0, &dwNumberOfExistingValues, 0, 0, 0, 0);
-    ExitOnFailure(hr, "Failed to query registration variable count.");
+*******************************************************************/
+extern "C" HRESULT RegistrationAppendState(
+    __in BURN_REGISTRATION* pRegistration,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
 
-    for (DWORD i = dwNumberOfExistingValues; i >= 0; --i)
+    hFile = ::CreateFileW(pRegistration->sczStateFile, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
     {
-        hr = RegValueEnum(hkRegistration, i, &sczValueName, &dwType);
-
-        if (E_NOMOREITEMS == hr)
-        {
-            hr = S_OK;
-            break;
-        }
-
-        ExitOnFailure(hr, "Failed to enumerate value %u", i);
+        ExitWithPathLastError(hr, "Failed to open state file for append: %ls", pRegistration->sczStateFile);
 
-        er = ::RegDeleteValueW(hkRegistration, sczValueName);
-        if (ERROR_FILE_NOT_FOUND != er)
-        {
-            ExitOnWin32Error(er, hr, "Failed to delete registration variable value.");
-        }
+        // The bundle's cache folder didn't exist when the snapshot was saved, so the caller has to save all of it.
+        ExitFunction1(hr = S_FALSE);
     }
 
-    // Write variables.
-    for (DWORD i = 0; i < variables.cVariables; ++i)
-    {
-        BURN_VARIABLE* pVariable = &variables.rgVariables[i];
+    hr = WriteStateRecord(hFile, pbBuffer, cbBuffer);
+    ExitOnFailure(hr, "Failed to append state to file: %ls", pRegistration->sczStateFile);
 
-        // Write variable value.
-        switch (pVariable->Value.Type)
-        {
-        case BURN_VARIANT_TYPE_NONE:
-            hr = RegWriteNone(hkRegistration, pVariable->sczName);
-            ExitOnFailure(hr, "Failed to set variable value.");
-            break;
-        case BURN_VARIANT_TYPE_NUMERIC: __fallthrough;
-        case BURN_VARIANT_TYPE_VERSION: __fallthrough;
-        case BURN_VARIANT_TYPE_FORMATTED: __fallthrough;
-        case BURN_VARIANT_TYPE_STRING:
-            hr = BVariantGetString(&pVariable->Value, &sczVariableValue);
-            ExitOnFailure(hr, "Failed to get variable value.");
-
-            hr = RegWriteString(hkRegistration, pVariable->sczName, sczVariableValue);
-            ExitOnFailure(hr, "Failed to set variable value.");
-
-            ReleaseNullStrSecure(sczVariableValue);
-
-            break;
-        default:
-            hr = E_INVALIDARG;
-            ExitOnFailure(hr, "Unsupported variable type.");
-        }
+    hr = WriteRegistryVariables(pRegistration, pbBuffer, cbBuffer, FALSE);
+    ExitOnFailure(hr, "Failed to write changed registration variables.");
 
-    }
 LExit:
-    VariablesUninitialize(&variables);
-    ReleaseStr(sczValueName);
-    ReleaseStr(sczVariableValue);
-    ReleaseStr(sczVariableKey);
-    ReleaseRegKey(hkRegistration);
+    ReleaseFileHandle(hFile);
 
     return hr;
 }
 
 /*******************************************************************
- RegistrationLoadState - Loads a previously stored engine state BLOB.
+ RegistrationLoadState - Loads previously stored engine state into the variables.
 
 *******************************************************************/
 extern "C" HRESULT RegistrationLoadState(
     __in BURN_REGISTRATION* pRegistration,
-    __out_bcount(*pcbBuffer) BYTE** ppbBuffer,
-    __out SIZE_T* pcbBuffer
+    __in BURN_VARIABLES* pVariables
     )
 {
-    // read data from file
-    HRESULT hr = FileRead(ppbBuffer, pcbBuffer, pRegistration->sczStateFile);
+    HRESULT hr = S_OK;
+    HANDLE hFile = INVALID_HANDLE_VALUE;
+    HANDLE hMapping = NULL;
+    BYTE* pbView = NULL;
+    LARGE_INTEGER liSize = { };
+    SIZE_T cbView = 0;
+    SIZE_T iView = 0;
+    SIZE_T iBuffer = 0;
+    BURN_STATE_JOURNAL_HEADER* pHeader = NULL;
+    BURN_STATE_JOURNAL_RECORD* pRecord = NULL;
+    DWORD cRecords = 0;
+
+    hFile = ::CreateFileW(pRegistration->sczStateFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    ExitOnInvalidHandleWithLastError(hFile, hr, "Failed to open state file: %ls", pRegistration->sczStateFile);
+
+    if (!::GetFileSizeEx(hFile, &liSize))
+    {
+        ExitWithLastError(hr, "Failed to get size of state file: %ls", pRegistration->sczStateFile);
+    }
+    else if (!liSize.QuadPart || MAXDWORD < liSize.QuadPart)
+    {
+        ExitWithRootFailure(hr, E_INVALIDDATA, "Invalid state file size: %I64u", liSize.QuadPart);
+    }
+
+    cbView = static_cast<SIZE_T>(liSize.QuadPart);
+
+    // Map the file instead of copying it so resume reads the records in place.
+    hMapping = ::CreateFileMappingW(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    ExitOnNullWithLastError(hMapping, hr, "Failed to create mapping of state file: %ls", pRegistration->sczStateFile);
+
+    pbView = static_cast<BYTE*>(::MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0));
+    ExitOnNullWithLastError(pbView, hr, "Failed to map view of state file: %ls", pRegistration->sczStateFile);
+
+    pHeader = reinterpret_cast<BURN_STATE_JOURNAL_HEADER*>(pbView);
+    if (sizeof(BURN_STATE_JOURNAL_HEADER) > cbView || STATE_JOURNAL_SIGNATURE != pHeader->dwSignature)
+    {
+        // State files written before the journal hold nothing but the serialized snapshot.
+        hr = VariableDeserialize(pVariables, TRUE, pbView, cbView, &iBuffer);
+        ExitFunction();
+    }
+    else if (STATE_JOURNAL_VERSION != pHeader->dwVersion)
+    {
+        ExitWithRootFailure(hr, E_INVALIDDATA, "Unsupported state file version: %u", pHeader->dwVersion);
+    }
+
+    // Apply the snapshot and then each set of changes appended after it. A record that runs past the end
+    // of the file or fails its checksum was torn by an interrupted save so it and anything after it are ignored.
+    for (iView = sizeof(BURN_STATE_JOURNAL_HEADER); sizeof(BURN_STATE_JOURNAL_RECORD) <= cbView - iView; iView += sizeof(BURN_STATE_JOURNAL_RECORD) + pRecord->cbData)
+    {
+        pRecord = reinterpret_cast<BURN_STATE_JOURNAL_RECORD*>(pbView + iView);
+
+        if (pRecord->cbData > cbView - iView - sizeof(BURN_STATE_JOURNAL_RECORD) ||
+            pRecord->dwChecksum != ComputeStateChecksum(pbView + iView + sizeof(BURN_STATE_JOURNAL_RECORD), pRecord->cbData))
+        {
+            LogId(REPORT_WARNING, MSG_STATE_FILE_TRUNCATED, pRegistration->sczStateFile, cRecords);
+            break;
+        }
+
+        iBuffer = 0;
+
+        hr = VariableDeserialize(pVariables, TRUE, pbView + iView + sizeof(BURN_STATE_JOURNAL_RECORD), pRecord->cbData, &iBuffer);
+        ExitOnFailure(hr, "Failed to read state record: %u", cRecords);
+
+        ++cRecords;
+    }
+
+    if (!cRecords)
+    {
+        ExitWithRootFailure(hr, E_INVALIDDATA, "State file does not contain a snapshot: %ls", pRegistration->sczStateFile);
+    }
+
+LExit:
+    if (pbView)
+    {
+        ::UnmapViewOfFile(pbView);
+    }
+
+    ReleaseHandle(hMapping);
+    ReleaseFileHandle(hFile);
+
     return hr;
 }
 
@@ -1160,6 +1256,9 @@ static HRESULT SetPaths(
     hr = StrAllocFormatted(&pRegistration->sczStateFile, L"%ls\\state.rsm", sczCacheDirectory);
     ExitOnFailure(hr, "Failed to build state file path.");
 
+    // Anything saved so far went to the previous state file, if any.
+    RegistrationResetStateJournal(pRegistration);
+
 LExit:
     ReleaseStr(sczCacheDirectory);
     return hr;
@@ -1695,3 +1794,141 @@ static BOOL IsRegistryRebootPending()
 
     return fRebootPending;
 }
+
+static DWORD ComputeStateChecksum(
+    __in_bcount(cbData) const BYTE* pbData,
+    __in SIZE_T cbData
+    )
+{
+    // FNV-1a is plenty to notice a torn write, which is all the state file needs.
+    DWORD dwChecksum = 2166136261;
+
+    for (SIZE_T i = 0; i < cbData; ++i)
+    {
+        dwChecksum = (dwChecksum ^ pbData[i]) * 16777619;
+    }
+
+    return dwChecksum;
+}
+
+static HRESULT WriteStateRecord(
+    __in HANDLE hFile,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_STATE_JOURNAL_RECORD record = { };
+
+    hr = ::SizeTToDWord(cbBuffer, &record.cbData);
+    ExitOnRootFailure(hr, "State is too large to save.");
+
+    record.dwChecksum = ComputeStateChecksum(pbBuffer, cbBuffer);
+
+    hr = FileWriteHandle(hFile, reinterpret_cast<LPCBYTE>(&record), sizeof(record));
+    ExitOnFailure(hr, "Failed to write state record header.");
+
+    hr = FileWriteHandle(hFile, pbBuffer, cbBuffer);
+    ExitOnFailure(hr, "Failed to write state record.");
+
+LExit:
+    return hr;
+}
+
+static HRESULT WriteRegistryVariables(
+    __in BURN_REGISTRATION* pRegistration,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer,
+    __in BOOL fReplace
+    )
+{
+    HRESULT hr = S_OK;
+    BURN_VARIABLES variables = { };
+    SIZE_T iBuffer_Unused = 0;
+    HKEY hkRegistration = NULL;
+    LPWSTR sczVariableKey = NULL;
+    LPWSTR sczVariableValue = NULL;
+    LPWSTR sczValueName = NULL;
+    DWORD dwType = 0;
+    DWORD dwNumberOfExistingValues = 0;
+    DWORD er = ERROR_SUCCESS;
+
+    ::InitializeCriticalSection(&variables.csAccess);
+
+    hr = VariableDeserialize(&variables, TRUE, pbBuffer, cbBuffer, &iBuffer_Unused);
+    ExitOnFailure(hr, "Failed to read variables.");
+
+    // build variable registry key path
+    hr = StrAllocFormatted(&sczVariableKey, L"%s\\%s", pRegistration->sczRegistrationKey, REGISTRY_BUNDLE_VARIABLE_KEY);
+    ExitOnFailure(hr, "Failed to build variable registry key path.");
+
+    // open registration variable key
+    hr = RegCreate(pRegistration->hkRoot, sczVariableKey, KEY_WRITE | KEY_QUERY_VALUE, &hkRegistration);
+    ExitOnFailure(hr, "Failed to create registration variable key.");
+
+    // A snapshot replaces all of the values, changes only overwrite the ones they contain.
+    if (fReplace)
+    {
+        hr = RegQueryInfoKey(hkRegistration, 0, 0, 0, 0, 0, 0, &dwNumberOfExistingValues, 0, 0, 0, 0);
+        ExitOnFailure(hr, "Failed to query registration variable count.");
+
+        for (DWORD i = dwNumberOfExistingValues; i >= 0; --i)
+        {
+            hr = RegValueEnum(hkRegistration, i, &sczValueName, &dwType);
+
+            if (E_NOMOREITEMS == hr)
+            {
+                hr = S_OK;
+                break;
+            }
+
+            ExitOnFailure(hr, "Failed to enumerate value %u", i);
+
+            er = ::RegDeleteValueW(hkRegistration, sczValueName);
+            if (ERROR_FILE_NOT_FOUND != er)
+            {
+                ExitOnWin32Error(er, hr, "Failed to delete registration variable value.");
+            }
+        }
+    }
+
+    // Write variables.
+    for (DWORD i = 0; i < variables.cVariables; ++i)
+    {
+        BURN_VARIABLE* pVariable = &variables.rgVariables[i];
+
+        // Write variable value.
+        switch (pVariable->Value.Type)
+        {
+        case BURN_VARIANT_TYPE_NONE:
+            hr = RegWriteNone(hkRegistration, pVariable->sczName);
+            ExitOnFailure(hr, "Failed to set variable value.");
+            break;
+        case BURN_VARIANT_TYPE_NUMERIC: __fallthrough;
+        case BURN_VARIANT_TYPE_VERSION: __fallthrough;
+        case BURN_VARIANT_TYPE_FORMATTED: __fallthrough;
+        case BURN_VARIANT_TYPE_STRING:
+            hr = BVariantGetString(&pVariable->Value, &sczVariableValue);
+            ExitOnFailure(hr, "Failed to get variable value.");
+
+            hr = RegWriteString(hkRegistration, pVariable->sczName, sczVariableValue);
+            ExitOnFailure(hr, "Failed to set variable value.");
+
+            ReleaseNullStrSecure(sczVariableValue);
+
+            break;
+        default:
+            hr = E_INVALIDARG;
+            ExitOnFailure(hr, "Unsupported variable type.");
+        }
+
+    }
+LExit:
+    VariablesUninitialize(&variables);
+    ReleaseStr(sczValueName);
+    ReleaseStr(sczVariableValue);
+    ReleaseStr(sczVariableKey);
+    ReleaseRegKey(hkRegistration);
+
+    return hr;
+}
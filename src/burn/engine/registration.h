@@ -75,6 +75,7 @@ typedef struct _BURN_RELATED_BUNDLES
 {
     BURN_RELATED_BUNDLE* rgRelatedBundles;
     DWORD cRelatedBundles;
+    DWORD cRelatedBundlesCapacity;
     BURN_RELATED_BUNDLE** rgpPlanSortedRelatedBundles;
 } BURN_RELATED_BUNDLES;
 
@@ -125,6 +126,12 @@ typedef struct _BURN_REGISTRATION
     LPWSTR sczResumeCommandLine;
     LPWSTR sczStateFile;
 
+    // resume state journal, tracked by the process that owns the variables
+    BOOL fStateSaved;
+    DWORD dwStateSequence;
+    SIZE_T cbStateSnapshot;
+    SIZE_T cbStateJournal;
+
     // ARP registration
     LPWSTR sczDisplayName;
     LPWSTR sczInProgressDisplayName;
@@ -155,6 +162,8 @@ typedef struct _BURN_REGISTRATION
     BOOL fForwardCompatibleBundleExists; // Only valid after detect.
     BOOL fEligibleForCleanup;            // Only valid after detect.
 
+    BUNDLE_SNAPSHOT_HANDLE hBundleSnapshot; // Only valid during detect.
+
     BOOL fDetectedForeignProviderKeyBundleId;
     LPWSTR sczDetectedProviderKeyBundleId;
     LPWSTR sczBundlePackageAncestors;
@@ -211,15 +220,22 @@ HRESULT RegistrationSessionEnd(
     __in DWORD64 qwEstimatedSize,
     __in BOOTSTRAPPER_REGISTRATION_TYPE registrationType
     );
+void RegistrationResetStateJournal(
+    __in BURN_REGISTRATION* pRegistration
+    );
 HRESULT RegistrationSaveState(
     __in BURN_REGISTRATION* pRegistration,
     __in_bcount_opt(cbBuffer) BYTE* pbBuffer,
     __in_opt SIZE_T cbBuffer
     );
+HRESULT RegistrationAppendState(
+    __in BURN_REGISTRATION* pRegistration,
+    __in_bcount(cbBuffer) BYTE* pbBuffer,
+    __in SIZE_T cbBuffer
+    );
 HRESULT RegistrationLoadState(
     __in BURN_REGISTRATION* pRegistration,
-    __out_bcount(*pcbBuffer) BYTE** ppbBuffer,
-    __out SIZE_T* pcbBuffer
+    __in BURN_VARIABLES* pVariables
     );
 HRESULT RegistrationGetResumeCommandLine(
     __in const BURN_REGISTRATION* pRegistration,
@@ -53,7 +53,8 @@ extern "C" HRESULT RelatedBundlesInitializeForScope(
     queryContext.pRegistration = pRegistration;
     queryContext.pRelatedBundles = pRelatedBundles;
 
-    hr = BundleQueryRelatedBundles(
+    hr = BundleSnapshotQueryRelatedBundles(
+        pRegistration->hBundleSnapshot,
         installContext,
         const_cast<LPCWSTR*>(pRegistration->rgsczDetectCodes),
         pRegistration->cDetectCodes,
@@ -289,7 +290,7 @@ static HRESULT LoadIfRelatedBundle(
         ExitFunction1(hr = S_FALSE);
     }
 
-    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pRelatedBundles->rgRelatedBundles), pRelatedBundles->cRelatedBundles + 1, sizeof(BURN_RELATED_BUNDLE), 5);
+    hr = MemEnsureArrayCapacityOf(pRelatedBundles->rgRelatedBundles, pRelatedBundles->cRelatedBundles + 1, &pRelatedBundles->cRelatedBundlesCapacity);
     ExitOnFailure(hr, "Failed to ensure there is space for related bundles.");
 
     pRelatedBundle = pRelatedBundles->rgRelatedBundles + pRelatedBundles->cRelatedBundles;
@@ -31,6 +31,20 @@ static HRESULT SendBAMessageFromInactiveEngine(
     __inout LPVOID pvResults
     );
 
+static BOOL ShouldSendProgress(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BURN_USER_EXPERIENCE_PROGRESS_TYPE type,
+    __in_z_opt LPCWSTR wzPackageOrContainerId,
+    __in_z_opt LPCWSTR wzPayloadId,
+    __in DWORD dwStep,
+    __in BOOL fLast
+    );
+
+static BOOL UpdateProgressId(
+    __deref_inout_z_opt LPWSTR* psczId,
+    __in_z_opt LPCWSTR wzId
+    );
+
 
 // function definitions
 
@@ -65,6 +79,10 @@ extern "C" HRESULT UserExperienceParseFromXml(
         ExitOnFailure(hr, "Too few UX payloads.");
     }
 
+    // Progress throttling can be tuned through policy.
+    hr = PolcReadNumber(POLICY_BURN_REGISTRY_PATH, L"ProgressInterval", BURN_UX_PROGRESS_INTERVAL_DEFAULT, &pUserExperience->dwProgressInterval);
+    ExitOnFailure(hr, "Failed to read ProgressInterval policy.");
+
 LExit:
     ReleaseObject(pixnUserExperienceNode);
 
@@ -82,6 +100,12 @@ extern "C" void UserExperienceUninitialize(
     ReleaseStr(pUserExperience->sczTempDirectory);
     PayloadsUninitialize(&pUserExperience->payloads);
 
+    for (DWORD i = 0; i < countof(pUserExperience->rgProgress); ++i)
+    {
+        ReleaseStr(pUserExperience->rgProgress[i].sczPackageOrContainerId);
+        ReleaseStr(pUserExperience->rgProgress[i].sczPayloadId);
+    }
+
     // clear struct
     memset(pUserExperience, 0, sizeof(BURN_USER_EXPERIENCE));
 }
@@ -276,6 +300,11 @@ extern "C" void UserExperienceExecuteReset(
 {
     pUserExperience->hrApplyError = S_OK;
     pUserExperience->hwndApply = NULL;
+
+    for (DWORD i = 0; i < countof(pUserExperience->rgProgress); ++i)
+    {
+        pUserExperience->rgProgress[i].fSent = FALSE;
+    }
 }
 
 extern "C" void UserExperienceExecutePhaseComplete(
@@ -311,6 +340,10 @@ EXTERN_C BAAPI UserExperienceOnApplyBegin(
         hr = HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT);
     }
 
+    pUserExperience->dwIgnoredMsiMessages = results.dwIgnoredMsiMessages;
+    pUserExperience->dwMsiProgressGranularity = results.dwMsiProgressGranularity;
+    pUserExperience->fConcurrentExePackages = results.fConcurrentExePackages;
+
 LExit:
     return hr;
 }
@@ -511,6 +544,11 @@ EXTERN_C BAAPI UserExperienceOnCacheAcquireProgress(
     BA_ONCACHEACQUIREPROGRESS_ARGS args = { };
     BA_ONCACHEACQUIREPROGRESS_RESULTS results = { };
 
+    if (!ShouldSendProgress(pUserExperience, BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_ACQUIRE, wzPackageOrContainerId, wzPayloadId, 0, dw64Progress == dw64Total))
+    {
+        ExitFunction();
+    }
+
     args.cbSize = sizeof(args);
     args.wzPackageOrContainerId = wzPackageOrContainerId;
     args.wzPayloadId = wzPayloadId;
@@ -702,6 +740,11 @@ EXTERN_C BAAPI UserExperienceOnCacheContainerOrPayloadVerifyProgress(
     BA_ONCACHECONTAINERORPAYLOADVERIFYPROGRESS_ARGS args = { };
     BA_ONCACHECONTAINERORPAYLOADVERIFYPROGRESS_RESULTS results = { };
 
+    if (!ShouldSendProgress(pUserExperience, BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_CONTAINER_OR_PAYLOAD_VERIFY, wzPackageOrContainerId, wzPayloadId, 0, dw64Progress == dw64Total))
+    {
+        ExitFunction();
+    }
+
     args.cbSize = sizeof(args);
     args.wzPackageOrContainerId = wzPackageOrContainerId;
     args.wzPayloadId = wzPayloadId;
@@ -886,6 +929,11 @@ EXTERN_C BAAPI UserExperienceOnCachePayloadExtractProgress(
     BA_ONCACHEPAYLOADEXTRACTPROGRESS_ARGS args = { };
     BA_ONCACHEPAYLOADEXTRACTPROGRESS_RESULTS results = { };
 
+    if (!ShouldSendProgress(pUserExperience, BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_PAYLOAD_EXTRACT, wzContainerId, wzPayloadId, 0, dw64Progress == dw64Total))
+    {
+        ExitFunction();
+    }
+
     args.cbSize = sizeof(args);
     args.wzContainerId = wzContainerId;
     args.wzPayloadId = wzPayloadId;
@@ -982,6 +1030,11 @@ EXTERN_C BAAPI UserExperienceOnCacheVerifyProgress(
     BA_ONCACHEVERIFYPROGRESS_ARGS args = { };
     BA_ONCACHEVERIFYPROGRESS_RESULTS results = { };
 
+    if (!ShouldSendProgress(pUserExperience, BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_VERIFY, wzPackageOrContainerId, wzPayloadId, verifyStep, dw64Progress == dw64Total))
+    {
+        ExitFunction();
+    }
+
     args.cbSize = sizeof(args);
     args.wzPackageOrContainerId = wzPackageOrContainerId;
     args.wzPayloadId = wzPayloadId;
@@ -1824,6 +1877,11 @@ EXTERN_C BAAPI UserExperienceOnExecuteProgress(
     BA_ONEXECUTEPROGRESS_ARGS args = { };
     BA_ONEXECUTEPROGRESS_RESULTS results = { };
 
+    if (!ShouldSendProgress(pUserExperience, BURN_USER_EXPERIENCE_PROGRESS_TYPE_EXECUTE, wzPackageId, NULL, 0, 100 <= dwProgressPercentage))
+    {
+        ExitFunction();
+    }
+
     args.cbSize = sizeof(args);
     args.wzPackageId = wzPackageId;
     args.dwProgressPercentage = dwProgressPercentage;
@@ -2446,6 +2504,12 @@ EXTERN_C BAAPI UserExperienceOnProgress(
     BA_ONPROGRESS_ARGS args = { };
     BA_ONPROGRESS_RESULTS results = { };
 
+    // Even when the tick isn't sent, an apply error from the other thread still has to stop this one.
+    if (!ShouldSendProgress(pUserExperience, BURN_USER_EXPERIENCE_PROGRESS_TYPE_OVERALL, NULL, NULL, fRollback, 100 <= dwOverallPercentage))
+    {
+        return FilterExecuteResult(pUserExperience, S_OK, fRollback, FALSE, L"OnProgress");
+    }
+
     args.cbSize = sizeof(args);
     args.dwProgressPercentage = dwProgressPercentage;
     args.dwOverallPercentage = dwOverallPercentage;
@@ -2951,6 +3015,81 @@ LExit:
     return hr;
 }
 
+static BOOL ShouldSendProgress(
+    __in BURN_USER_EXPERIENCE* pUserExperience,
+    __in BURN_USER_EXPERIENCE_PROGRESS_TYPE type,
+    __in_z_opt LPCWSTR wzPackageOrContainerId,
+    __in_z_opt LPCWSTR wzPayloadId,
+    __in DWORD dwStep,
+    __in BOOL fLast
+    )
+{
+    BURN_USER_EXPERIENCE_PROGRESS* pProgress = pUserExperience->rgProgress + type;
+    DWORD dwNow = 0;
+    BOOL fChanged = FALSE;
+    BOOL fSend = FALSE;
+
+    if (!pUserExperience->dwProgressInterval)
+    {
+        ExitFunction1(fSend = TRUE);
+    }
+
+    dwNow = ::GetTickCount();
+
+    // The first tick of each package, container, payload or step is always sent.
+    fChanged = UpdateProgressId(&pProgress->sczPackageOrContainerId, wzPackageOrContainerId);
+    fChanged |= UpdateProgressId(&pProgress->sczPayloadId, wzPayloadId);
+    fChanged |= pProgress->dwStep != dwStep;
+    pProgress->dwStep = dwStep;
+
+    fSend = fLast || fChanged || !pProgress->fSent || pUserExperience->dwProgressInterval <= dwNow - pProgress->dwLastSent;
+    if (fSend)
+    {
+        pProgress->fSent = TRUE;
+        pProgress->dwLastSent = dwNow;
+    }
+
+LExit:
+    return fSend;
+}
+
+static BOOL UpdateProgressId(
+    __deref_inout_z_opt LPWSTR* psczId,
+    __in_z_opt LPCWSTR wzId
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fChanged = FALSE;
+
+    if (!*psczId || !wzId)
+    {
+        fChanged = *psczId != wzId;
+    }
+    else
+    {
+        fChanged = CSTR_EQUAL != ::CompareStringOrdinal(*psczId, -1, wzId, -1, FALSE);
+    }
+
+    if (fChanged)
+    {
+        if (wzId)
+        {
+            hr = StrAllocString(psczId, wzId, 0);
+            if (FAILED(hr))
+            {
+                // Without the id the next tick counts as a change, so it gets sent too.
+                ReleaseNullStr(*psczId);
+            }
+        }
+        else
+        {
+            ReleaseNullStr(*psczId);
+        }
+    }
+
+    return fChanged;
+}
+
 static HRESULT SendBAMessage(
     __in BURN_USER_EXPERIENCE* pUserExperience,
     __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
@@ -11,10 +11,35 @@ extern "C" {
 // constants
 
 const DWORD BURN_MB_RETRYTRYAGAIN = 0x10;
+const DWORD BURN_UX_PROGRESS_INTERVAL_DEFAULT = 50;
+
+
+// enums
+
+enum BURN_USER_EXPERIENCE_PROGRESS_TYPE
+{
+    BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_ACQUIRE,
+    BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_CONTAINER_OR_PAYLOAD_VERIFY,
+    BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_PAYLOAD_EXTRACT,
+    BURN_USER_EXPERIENCE_PROGRESS_TYPE_CACHE_VERIFY,
+    BURN_USER_EXPERIENCE_PROGRESS_TYPE_EXECUTE,
+    BURN_USER_EXPERIENCE_PROGRESS_TYPE_OVERALL,
+
+    BURN_USER_EXPERIENCE_PROGRESS_TYPE_COUNT,
+};
 
 
 // structs
 
+typedef struct _BURN_USER_EXPERIENCE_PROGRESS
+{
+    BOOL fSent;
+    DWORD dwLastSent;                   // GetTickCount() when the last progress callback was sent to the BA.
+    LPWSTR sczPackageOrContainerId;
+    LPWSTR sczPayloadId;
+    DWORD dwStep;
+} BURN_USER_EXPERIENCE_PROGRESS;
+
 typedef struct _BURN_USER_EXPERIENCE
 {
     BURN_PAYLOADS payloads;
@@ -43,6 +68,21 @@ typedef struct _BURN_USER_EXPERIENCE
                                         // during Detect.
 
     DWORD dwExitCode;                   // Exit code returned by the user experience for the engine overall.
+
+    DWORD dwProgressInterval;           // Minimum milliseconds between progress callbacks of the same type. Progress
+                                        // ticks in between are dropped, except the first and last of each package,
+                                        // container or payload. Zero sends every tick.
+
+    DWORD dwIgnoredMsiMessages;         // MSI message types the BA asked in OnApplyBegin to not receive. Also sent to
+                                        // the elevated process so they never cross the pipe.
+
+    DWORD dwMsiProgressGranularity;     // Minimum change in percentage between MSI execute progress messages, from
+                                        // OnApplyBegin. Zero sends every progress message.
+
+    BOOL fConcurrentExePackages;        // The BA allowed independent EXE packages to run side by side in OnApplyBegin,
+                                        // and accepts their execute callbacks interleaving.
+
+    BURN_USER_EXPERIENCE_PROGRESS rgProgress[BURN_USER_EXPERIENCE_PROGRESS_TYPE_COUNT]; // Each type is only sent from one thread at a time.
 } BURN_USER_EXPERIENCE;
 
 // functions
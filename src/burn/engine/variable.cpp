@@ -109,6 +109,11 @@ static HRESULT SetVariableValue(
     __in SET_VARIABLE setBuiltin,
     __in BOOL fLog
     );
+static HRESULT SerializeVariable(
+    __in BURN_VARIABLE* pVariable,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer
+    );
 static HRESULT InitializeVariableVersionNT(
     __in DWORD_PTR dwpData,
     __inout BURN_VARIANT* pValue
@@ -833,8 +838,6 @@ extern "C" HRESULT VariableSerialize(
 {
     HRESULT hr = S_OK;
     BOOL fIncluded = FALSE;
-    LONGLONG ll = 0;
-    LPWSTR scz = NULL;
 
     ::EnterCriticalSection(&pVariables->csAccess);
 
@@ -861,53 +864,84 @@ extern "C" HRESULT VariableSerialize(
             continue;
         }
 
-        // Write variable name.
-        hr = BuffWriteString(ppbBuffer, piBuffer, pVariable->sczName);
-        ExitOnFailure(hr, "Failed to write variable name.");
+        hr = SerializeVariable(pVariable, ppbBuffer, piBuffer);
+        ExitOnFailure(hr, "Failed to write variable: %ls", pVariable->sczName);
+    }
 
-        // Write variable value type.
-        hr = BuffWriteNumber(ppbBuffer, piBuffer, (DWORD)pVariable->Value.Type);
-        ExitOnFailure(hr, "Failed to write variable value type.");
+LExit:
+    ::LeaveCriticalSection(&pVariables->csAccess);
 
-        // Write variable value.
-        switch (pVariable->Value.Type)
-        {
-        case BURN_VARIANT_TYPE_NONE:
-            break;
-        case BURN_VARIANT_TYPE_NUMERIC:
-            hr = BVariantGetNumeric(&pVariable->Value, &ll);
-            ExitOnFailure(hr, "Failed to get numeric.");
+    return hr;
+}
 
-            hr = BuffWriteNumber64(ppbBuffer, piBuffer, static_cast<DWORD64>(ll));
-            ExitOnFailure(hr, "Failed to write variable value as number.");
+extern "C" HRESULT VariableSerializeChanges(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD dwSinceSequence,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer,
+    __out DWORD* pdwSequence,
+    __out DWORD* pcChanges
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cChanges = 0;
 
-            SecureZeroMemory(&ll, sizeof(ll));
-            break;
-        case BURN_VARIANT_TYPE_VERSION: __fallthrough;
-        case BURN_VARIANT_TYPE_FORMATTED: __fallthrough;
-        case BURN_VARIANT_TYPE_STRING:
-            hr = BVariantGetString(&pVariable->Value, &scz);
-            ExitOnFailure(hr, "Failed to get string.");
+    ::EnterCriticalSection(&pVariables->csAccess);
 
-            hr = BuffWriteString(ppbBuffer, piBuffer, scz);
-            ExitOnFailure(hr, "Failed to write variable value as string.");
+    for (DWORD i = 0; i < pVariables->cVariables; ++i)
+    {
+        BURN_VARIABLE* pVariable = &pVariables->rgVariables[i];
 
-            ReleaseNullStrSecure(scz);
-            break;
-        default:
-            hr = E_INVALIDARG;
-            ExitOnFailure(hr, "Unsupported variable type.");
+        if (pVariable->fPersisted && dwSinceSequence < pVariable->dwChangeSequence)
+        {
+            ++cChanges;
+        }
+    }
+
+    // Use the same layout as persisting with VariableSerialize so VariableDeserialize can apply the changes,
+    // but leave out everything that was not changed instead of writing an excluded flag for it.
+    hr = BuffWriteNumber(ppbBuffer, piBuffer, cChanges);
+    ExitOnFailure(hr, "Failed to write variable count.");
+
+    for (DWORD i = 0; i < pVariables->cVariables; ++i)
+    {
+        BURN_VARIABLE* pVariable = &pVariables->rgVariables[i];
+
+        if (!pVariable->fPersisted || dwSinceSequence >= pVariable->dwChangeSequence)
+        {
+            continue;
         }
+
+        hr = BuffWriteNumber(ppbBuffer, piBuffer, (DWORD)TRUE);
+        ExitOnFailure(hr, "Failed to write included flag.");
+
+        hr = SerializeVariable(pVariable, ppbBuffer, piBuffer);
+        ExitOnFailure(hr, "Failed to write variable: %ls", pVariable->sczName);
     }
 
+    *pdwSequence = pVariables->dwChangeSequence;
+    *pcChanges = cChanges;
+
 LExit:
     ::LeaveCriticalSection(&pVariables->csAccess);
-    SecureZeroMemory(&ll, sizeof(ll));
-    StrSecureZeroFreeString(scz);
 
     return hr;
 }
 
+extern "C" HRESULT VariableGetChangeSequence(
+    __in BURN_VARIABLES* pVariables,
+    __out DWORD* pdwSequence
+    )
+{
+    ::EnterCriticalSection(&pVariables->csAccess);
+
+    *pdwSequence = pVariables->dwChangeSequence;
+
+    ::LeaveCriticalSection(&pVariables->csAccess);
+
+    return S_OK;
+}
+
 extern "C" HRESULT VariableDeserialize(
     __in BURN_VARIABLES* pVariables,
     __in BOOL fWasPersisted,
@@ -1762,6 +1796,8 @@ static HRESULT SetVariableValue(
     hr = BVariantSetValue(&pVariables->rgVariables[iVariable].Value, pVariant);
     ExitOnFailure(hr, "Failed to set value of variable: %ls", wzVariable);
 
+    pVariables->rgVariables[iVariable].dwChangeSequence = ++pVariables->dwChangeSequence;
+
 LExit:
     ::LeaveCriticalSection(&pVariables->csAccess);
 
@@ -1773,6 +1809,61 @@ LExit:
     return hr;
 }
 
+static HRESULT SerializeVariable(
+    __in BURN_VARIABLE* pVariable,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    LONGLONG ll = 0;
+    LPWSTR scz = NULL;
+
+    // Write variable name.
+    hr = BuffWriteString(ppbBuffer, piBuffer, pVariable->sczName);
+    ExitOnFailure(hr, "Failed to write variable name.");
+
+    // Write variable value type.
+    hr = BuffWriteNumber(ppbBuffer, piBuffer, (DWORD)pVariable->Value.Type);
+    ExitOnFailure(hr, "Failed to write variable value type.");
+
+    // Write variable value.
+    switch (pVariable->Value.Type)
+    {
+    case BURN_VARIANT_TYPE_NONE:
+        break;
+    case BURN_VARIANT_TYPE_NUMERIC:
+        hr = BVariantGetNumeric(&pVariable->Value, &ll);
+        ExitOnFailure(hr, "Failed to get numeric.");
+
+        hr = BuffWriteNumber64(ppbBuffer, piBuffer, static_cast<DWORD64>(ll));
+        ExitOnFailure(hr, "Failed to write variable value as number.");
+
+        SecureZeroMemory(&ll, sizeof(ll));
+        break;
+    case BURN_VARIANT_TYPE_VERSION: __fallthrough;
+    case BURN_VARIANT_TYPE_FORMATTED: __fallthrough;
+    case BURN_VARIANT_TYPE_STRING:
+        hr = BVariantGetString(&pVariable->Value, &scz);
+        ExitOnFailure(hr, "Failed to get string.");
+
+        hr = BuffWriteString(ppbBuffer, piBuffer, scz);
+        ExitOnFailure(hr, "Failed to write variable value as string.");
+
+        ReleaseNullStrSecure(scz);
+        break;
+    default:
+        hr = E_INVALIDARG;
+        ExitOnFailure(hr, "Unsupported variable type.");
+    }
+
+LExit:
+    SecureZeroMemory(&ll, sizeof(ll));
+    StrSecureZeroFreeString(scz);
+
+    return hr;
+}
+
 static HRESULT InitializeVariableVersionNT(
     __in DWORD_PTR dwpData,
     __inout BURN_VARIANT* pValue
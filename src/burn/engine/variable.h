@@ -42,6 +42,7 @@ typedef struct _BURN_VARIABLE
     BURN_VARIANT Value;
     BOOL fHidden;
     BOOL fPersisted;
+    DWORD dwChangeSequence; // value of BURN_VARIABLES::dwChangeSequence when this variable was last set.
 
     // used for late initialization of built-in variables
     BURN_VARIABLE_INTERNAL_TYPE internalType;
@@ -55,6 +56,7 @@ typedef struct _BURN_VARIABLES
     DWORD dwMaxVariables;
     DWORD cVariables;
     BURN_VARIABLE* rgVariables;
+    DWORD dwChangeSequence;
 } BURN_VARIABLES;
 
 
@@ -145,6 +147,18 @@ HRESULT VariableSerialize(
     __inout BYTE** ppbBuffer,
     __inout SIZE_T* piBuffer
     );
+HRESULT VariableSerializeChanges(
+    __in BURN_VARIABLES* pVariables,
+    __in DWORD dwSinceSequence,
+    __inout BYTE** ppbBuffer,
+    __inout SIZE_T* piBuffer,
+    __out DWORD* pdwSequence,
+    __out DWORD* pcChanges
+    );
+HRESULT VariableGetChangeSequence(
+    __in BURN_VARIABLES* pVariables,
+    __out DWORD* pdwSequence
+    );
 HRESULT VariableDeserialize(
     __in BURN_VARIABLES* pVariables,
     __in BOOL fWasPersisted,
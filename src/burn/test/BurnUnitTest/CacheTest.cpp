@@ -19,6 +19,11 @@ static DWORD CALLBACK CacheTestProgressRoutine(
     __in_opt LPVOID lpData
     );
 
+static void CacheTest_GetFileInformation(
+    __in_z LPCWSTR wzPath,
+    __out BY_HANDLE_FILE_INFORMATION* pFileInfo
+    );
+
 typedef struct _CACHE_TEST_CONTEXT
 {
 } CACHE_TEST_CONTEXT;
@@ -188,6 +193,501 @@ namespace Bootstrapper
                 CacheUninitialize(&cache);
             }
         }
+
+        [Fact]
+        void CacheContentStoreTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_CACHE cache = { };
+            BURN_ENGINE_COMMAND internalCommand = { };
+            BURN_PAYLOAD payload = { };
+            LPWSTR sczPayloadPath = NULL;
+            LPWSTR sczCacheFolder = NULL;
+            LPWSTR sczLinkedPath = NULL;
+            LPWSTR sczStoreFolder = NULL;
+            LPWSTR sczStorePath = NULL;
+            BY_HANDLE_FILE_INFORMATION storeInfo = { };
+            BY_HANDLE_FILE_INFORMATION linkedInfo = { };
+            BYTE* pb = NULL;
+            DWORD cb = NULL;
+            CACHE_TEST_CONTEXT context = { };
+            String^ hash = "25e61cd83485062b70713aebddd3fe4992826cb121466fddc8de3eacb1e42f39d4bdd8455d95eec8c9529ced4c0296ab861931fe2c86df2f2b4e8d259a6d9223";
+
+            try
+            {
+                pin_ptr<const wchar_t> dataDirectory = PtrToStringChars(this->TestContext->TestDirectory);
+                hr = PathConcat(dataDirectory, L"TestData\\CacheTest\\CacheSignatureTest.File", &sczPayloadPath);
+                Assert::True(S_OK == hr, "Failed to get path to test file.");
+
+                pin_ptr<const wchar_t> wzHash = PtrToStringChars(hash);
+                hr = StrAllocHexDecode(wzHash, &pb, &cb);
+                Assert::Equal(S_OK, hr);
+
+                payload.sczKey = L"CacheContentStoreTest.PayloadKey";
+                payload.sczFilePath = L"CacheSignatureTest.File";
+                payload.pbHash = pb;
+                payload.cbHash = cb;
+                payload.qwFileSize = 27;
+                payload.verification = BURN_PAYLOAD_VERIFICATION_HASH;
+
+                hr = CacheInitialize(&cache, &internalCommand);
+                TestThrowOnFailure(hr, L"Failed initialize cache.");
+
+                cache.fContentStore = TRUE;
+
+                // Caching the payload for one package adds it to the store...
+                hr = CacheCompletePayload(&cache, FALSE, &payload, L"Bootstrapper.CacheTest.CacheContentStoreTest.A", sczPayloadPath, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                Assert::Equal(S_OK, hr);
+
+                // ...so another package gets it without acquiring it.
+                hr = CacheGetCompletedPath(&cache, FALSE, L"Bootstrapper.CacheTest.CacheContentStoreTest.B", &sczCacheFolder);
+                NativeAssert::Succeeded(hr, "Failed to get completed path.");
+
+                hr = CacheVerifyPayload(&cache, FALSE, &payload, sczCacheFolder, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                Assert::Equal(S_OK, hr);
+
+                hr = PathConcat(sczCacheFolder, payload.sczFilePath, &sczLinkedPath);
+                NativeAssert::Succeeded(hr, "Failed to get linked payload path.");
+                Assert::True(FileExistsEx(sczLinkedPath, NULL), "Payload was not linked from the content store.");
+
+                // The linked payload is the store entry itself, not a copy of it.
+                hr = CacheGetCompletedPath(&cache, FALSE, L".store", &sczStoreFolder);
+                NativeAssert::Succeeded(hr, "Failed to get content store path.");
+
+                hr = PathConcat(sczStoreFolder, wzHash, &sczStorePath);
+                NativeAssert::Succeeded(hr, "Failed to get content store entry path.");
+
+                CacheTest_GetFileInformation(sczStorePath, &storeInfo);
+                CacheTest_GetFileInformation(sczLinkedPath, &linkedInfo);
+                Assert::Equal<DWORD>(storeInfo.nFileIndexHigh, linkedInfo.nFileIndexHigh);
+                Assert::Equal<DWORD>(storeInfo.nFileIndexLow, linkedInfo.nFileIndexLow);
+                Assert::Equal<DWORD>(3, storeInfo.nNumberOfLinks);
+            }
+            finally
+            {
+                ReleaseMem(pb);
+                ReleaseStr(sczStorePath);
+                ReleaseStr(sczStoreFolder);
+                ReleaseStr(sczLinkedPath);
+                ReleaseStr(sczCacheFolder);
+                ReleaseStr(sczPayloadPath);
+
+                String^ cachePath = Path::Combine(Environment::GetFolderPath(Environment::SpecialFolder::LocalApplicationData), "Package Cache");
+                array<String^>^ paths = { "Bootstrapper.CacheTest.CacheContentStoreTest.A\\CacheSignatureTest.File", "Bootstrapper.CacheTest.CacheContentStoreTest.B\\CacheSignatureTest.File", ".store\\" + hash };
+                for each (String^ path in paths)
+                {
+                    String^ filePath = Path::Combine(cachePath, path);
+                    if (File::Exists(filePath))
+                    {
+                        File::SetAttributes(filePath, FileAttributes::Normal);
+                        File::Delete(filePath);
+                    }
+                }
+
+                CacheUninitialize(&cache);
+            }
+        }
+
+        [Fact]
+        void CacheContentStoreExistingEntryTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_CACHE cache = { };
+            BURN_ENGINE_COMMAND internalCommand = { };
+            BURN_PAYLOAD payload = { };
+            LPWSTR sczPayloadPath = NULL;
+            LPWSTR sczCacheFolder = NULL;
+            LPWSTR sczCachedPathA = NULL;
+            LPWSTR sczCachedPathB = NULL;
+            LPWSTR sczStoreFolder = NULL;
+            LPWSTR sczStorePath = NULL;
+            BY_HANDLE_FILE_INFORMATION storeInfo = { };
+            BY_HANDLE_FILE_INFORMATION cachedInfo = { };
+            BYTE* pb = NULL;
+            DWORD cb = NULL;
+            CACHE_TEST_CONTEXT context = { };
+            String^ hash = "25e61cd83485062b70713aebddd3fe4992826cb121466fddc8de3eacb1e42f39d4bdd8455d95eec8c9529ced4c0296ab861931fe2c86df2f2b4e8d259a6d9223";
+
+            try
+            {
+                pin_ptr<const wchar_t> dataDirectory = PtrToStringChars(this->TestContext->TestDirectory);
+                hr = PathConcat(dataDirectory, L"TestData\\CacheTest\\CacheSignatureTest.File", &sczPayloadPath);
+                Assert::True(S_OK == hr, "Failed to get path to test file.");
+
+                pin_ptr<const wchar_t> wzHash = PtrToStringChars(hash);
+                hr = StrAllocHexDecode(wzHash, &pb, &cb);
+                Assert::Equal(S_OK, hr);
+
+                payload.sczKey = L"CacheContentStoreExistingEntryTest.PayloadKey";
+                payload.sczFilePath = L"CacheSignatureTest.File";
+                payload.pbHash = pb;
+                payload.cbHash = cb;
+                payload.qwFileSize = 27;
+                payload.verification = BURN_PAYLOAD_VERIFICATION_HASH;
+
+                hr = CacheInitialize(&cache, &internalCommand);
+                TestThrowOnFailure(hr, L"Failed initialize cache.");
+
+                cache.fContentStore = TRUE;
+
+                hr = CacheGetCompletedPath(&cache, FALSE, L".store", &sczStoreFolder);
+                NativeAssert::Succeeded(hr, "Failed to get content store path.");
+
+                hr = PathConcat(sczStoreFolder, wzHash, &sczStorePath);
+                NativeAssert::Succeeded(hr, "Failed to get content store entry path.");
+
+                hr = CacheCompletePayload(&cache, FALSE, &payload, L"Bootstrapper.CacheTest.CacheContentStoreExistingEntryTest.A", sczPayloadPath, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                Assert::Equal(S_OK, hr);
+
+                // Acquiring the same content for another package replaces its copy with the existing store entry.
+                hr = CacheCompletePayload(&cache, FALSE, &payload, L"Bootstrapper.CacheTest.CacheContentStoreExistingEntryTest.B", sczPayloadPath, FALSE, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                Assert::Equal(S_OK, hr);
+
+                hr = CacheGetCompletedPath(&cache, FALSE, L"Bootstrapper.CacheTest.CacheContentStoreExistingEntryTest.A", &sczCacheFolder);
+                NativeAssert::Succeeded(hr, "Failed to get completed path.");
+
+                hr = PathConcat(sczCacheFolder, payload.sczFilePath, &sczCachedPathA);
+                NativeAssert::Succeeded(hr, "Failed to get cached payload path.");
+
+                hr = CacheGetCompletedPath(&cache, FALSE, L"Bootstrapper.CacheTest.CacheContentStoreExistingEntryTest.B", &sczCacheFolder);
+                NativeAssert::Succeeded(hr, "Failed to get completed path.");
+
+                hr = PathConcat(sczCacheFolder, payload.sczFilePath, &sczCachedPathB);
+                NativeAssert::Succeeded(hr, "Failed to get cached payload path.");
+
+                CacheTest_GetFileInformation(sczStorePath, &storeInfo);
+                CacheTest_GetFileInformation(sczCachedPathB, &cachedInfo);
+                Assert::Equal<DWORD>(storeInfo.nFileIndexHigh, cachedInfo.nFileIndexHigh);
+                Assert::Equal<DWORD>(storeInfo.nFileIndexLow, cachedInfo.nFileIndexLow);
+                Assert::Equal<DWORD>(3, storeInfo.nNumberOfLinks);
+
+                // The entry stays while any package still uses it...
+                hr = FileEnsureDelete(sczCachedPathA);
+                NativeAssert::Succeeded(hr, "Failed to delete cached payload: {0}", sczCachedPathA);
+
+                CacheCleanup(FALSE, &cache);
+                Assert::True(FileExistsEx(sczStorePath, NULL), "Content store entry still in use was removed.");
+
+                // ...and is removed once none do.
+                hr = FileEnsureDelete(sczCachedPathB);
+                NativeAssert::Succeeded(hr, "Failed to delete cached payload: {0}", sczCachedPathB);
+
+                CacheCleanup(FALSE, &cache);
+                Assert::False(FileExistsEx(sczStorePath, NULL), "Unreferenced content store entry was not removed.");
+            }
+            finally
+            {
+                ReleaseMem(pb);
+                ReleaseStr(sczStorePath);
+                ReleaseStr(sczStoreFolder);
+                ReleaseStr(sczCachedPathB);
+                ReleaseStr(sczCachedPathA);
+                ReleaseStr(sczCacheFolder);
+                ReleaseStr(sczPayloadPath);
+
+                String^ cachePath = Path::Combine(Environment::GetFolderPath(Environment::SpecialFolder::LocalApplicationData), "Package Cache");
+                array<String^>^ paths = { "Bootstrapper.CacheTest.CacheContentStoreExistingEntryTest.A\\CacheSignatureTest.File", "Bootstrapper.CacheTest.CacheContentStoreExistingEntryTest.B\\CacheSignatureTest.File", ".store\\" + hash };
+                for each (String^ path in paths)
+                {
+                    String^ filePath = Path::Combine(cachePath, path);
+                    if (File::Exists(filePath))
+                    {
+                        File::SetAttributes(filePath, FileAttributes::Normal);
+                        File::Delete(filePath);
+                    }
+                }
+
+                CacheUninitialize(&cache);
+            }
+        }
+
+        [Fact]
+        void CachePayloadTrustTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_CACHE cache = { };
+            BURN_PAYLOAD payload = { };
+            BYTE rgbKeyIdentifier[SHA1_HASH_LEN] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+            BYTE rgbOtherKeyIdentifier[SHA1_HASH_LEN] = { 20 };
+            HANDLE hFile = INVALID_HANDLE_VALUE;
+            HKEY hk = NULL;
+            LPWSTR sczName = NULL;
+            BYTE* pbRecord = NULL;
+            SIZE_T cbRecord = 0;
+            BURN_PAYLOAD_TRUST_RECORD record = { };
+            BY_HANDLE_FILE_INFORMATION fileInfo = { };
+            FILETIME ftLastWrite = { };
+            FILETIME ftEarlier = { };
+            ULARGE_INTEGER uli = { };
+            BOOL fTrusted = FALSE;
+            DWORD cbWritten = 0;
+            String^ tempFolder = Path::Combine(Path::GetTempPath(), "BurnUnitTest.CacheTest." + Guid::NewGuid().ToString("N"));
+
+            try
+            {
+                this->testRegistry->SetUp();
+
+                String^ filePath = Path::Combine(tempFolder, "CacheSignatureTest.File");
+                Directory::CreateDirectory(tempFolder);
+                File::Copy(Path::Combine(this->TestContext->TestDirectory, "TestData\\CacheTest\\CacheSignatureTest.File"), filePath);
+
+                pin_ptr<const wchar_t> wzFilePath = PtrToStringChars(filePath);
+                hFile = ::CreateFileW(wzFilePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+                Assert::True(INVALID_HANDLE_VALUE != hFile, "Failed to open test file.");
+
+                Assert::True(::GetFileInformationByHandle(hFile, &fileInfo), "Failed to get test file information.");
+                ftLastWrite = fileInfo.ftLastWriteTime;
+
+                cache.dwPayloadTrustLifetime = 60 * 60;
+                payload.sczKey = L"CachePayloadTrustTest.PayloadKey";
+                payload.verification = BURN_PAYLOAD_VERIFICATION_AUTHENTICODE;
+                payload.pbCertificateRootPublicKeyIdentifier = rgbKeyIdentifier;
+                payload.cbCertificateRootPublicKeyIdentifier = sizeof(rgbKeyIdentifier);
+
+                hr = CachePayloadTrustRead(&cache, &payload, hFile, &fTrusted);
+                NativeAssert::Succeeded(hr, "Failed to read missing payload trust.");
+                Assert::False(fTrusted);
+
+                // A recorded verification is reused for the same unchanged file...
+                hr = CachePayloadTrustWrite(&payload, hFile);
+                NativeAssert::Succeeded(hr, "Failed to write payload trust.");
+
+                hr = CachePayloadTrustRead(&cache, &payload, hFile, &fTrusted);
+                NativeAssert::Succeeded(hr, "Failed to read payload trust.");
+                Assert::True(fTrusted);
+
+                // ...but not when the payload expects a different certificate...
+                payload.pbCertificateRootPublicKeyIdentifier = rgbOtherKeyIdentifier;
+
+                hr = CachePayloadTrustRead(&cache, &payload, hFile, &fTrusted);
+                NativeAssert::Succeeded(hr, "Failed to read payload trust for other certificate.");
+                Assert::False(fTrusted);
+
+                payload.pbCertificateRootPublicKeyIdentifier = rgbKeyIdentifier;
+
+                // ...or when the file's last write time changed...
+                uli.LowPart = ftLastWrite.dwLowDateTime;
+                uli.HighPart = ftLastWrite.dwHighDateTime;
+                uli.QuadPart -= 10000000ui64;
+                ftEarlier.dwLowDateTime = uli.LowPart;
+                ftEarlier.dwHighDateTime = uli.HighPart;
+                Assert::True(::SetFileTime(hFile, NULL, NULL, &ftEarlier), "Failed to change last write time.");
+
+                hr = CachePayloadTrustRead(&cache, &payload, hFile, &fTrusted);
+                NativeAssert::Succeeded(hr, "Failed to read payload trust after changing file time.");
+                Assert::False(fTrusted);
+
+                Assert::True(::SetFileTime(hFile, NULL, NULL, &ftLastWrite), "Failed to restore last write time.");
+
+                hr = CachePayloadTrustRead(&cache, &payload, hFile, &fTrusted);
+                NativeAssert::Succeeded(hr, "Failed to read payload trust after restoring file time.");
+                Assert::True(fTrusted);
+
+                // ...or its size.
+                Assert::True(INVALID_SET_FILE_POINTER != ::SetFilePointer(hFile, 0, NULL, FILE_END), "Failed to seek to end of test file.");
+                Assert::True(::WriteFile(hFile, "x", 1, &cbWritten, NULL), "Failed to grow test file.");
+                Assert::True(::SetFileTime(hFile, NULL, NULL, &ftLastWrite), "Failed to restore last write time.");
+
+                hr = CachePayloadTrustRead(&cache, &payload, hFile, &fTrusted);
+                NativeAssert::Succeeded(hr, "Failed to read payload trust after changing file size.");
+                Assert::False(fTrusted);
+
+                // A record is only good for the lifetime.
+                hr = CachePayloadTrustWrite(&payload, hFile);
+                NativeAssert::Succeeded(hr, "Failed to rewrite payload trust.");
+
+                hr = RegOpen(HKEY_LOCAL_MACHINE, BURN_PAYLOAD_TRUST_REGISTRY_PATH, KEY_QUERY_VALUE | KEY_SET_VALUE, &hk);
+                NativeAssert::Succeeded(hr, "Failed to open payload trust key.");
+
+                hr = RegValueEnum(hk, 0, &sczName, NULL);
+                NativeAssert::Succeeded(hr, "Failed to find payload trust value.");
+
+                hr = RegReadBinary(hk, sczName, &pbRecord, &cbRecord);
+                NativeAssert::Succeeded(hr, "Failed to read payload trust value.");
+                Assert::Equal<SIZE_T>(sizeof(record), cbRecord);
+                memcpy(&record, pbRecord, sizeof(record));
+
+                Assert::True(CachePayloadTrustIsRecordValid(&cache, &record, &payload, NULL));
+
+                uli.LowPart = record.ftVerified.dwLowDateTime;
+                uli.HighPart = record.ftVerified.dwHighDateTime;
+                uli.QuadPart -= 2ui64 * cache.dwPayloadTrustLifetime * 10000000ui64;
+                record.ftVerified.dwLowDateTime = uli.LowPart;
+                record.ftVerified.dwHighDateTime = uli.HighPart;
+
+                Assert::False(CachePayloadTrustIsRecordValid(&cache, &record, &payload, NULL));
+
+                hr = RegWriteBinary(hk, sczName, reinterpret_cast<BYTE*>(&record), sizeof(record));
+                NativeAssert::Succeeded(hr, "Failed to write expired payload trust value.");
+
+                hr = CachePayloadTrustRead(&cache, &payload, hFile, &fTrusted);
+                NativeAssert::Succeeded(hr, "Failed to read expired payload trust.");
+                Assert::False(fTrusted);
+
+                // Cleanup removes expired records and keeps the rest.
+                ::GetSystemTimeAsFileTime(&record.ftVerified);
+
+                hr = RegWriteBinary(hk, L"Current", reinterpret_cast<BYTE*>(&record), sizeof(record));
+                NativeAssert::Succeeded(hr, "Failed to write current payload trust value.");
+
+                CachePayloadTrustRemoveExpired(&cache);
+
+                hr = RegReadBinary(hk, sczName, &pbRecord, &cbRecord);
+                NativeAssert::SpecificReturnCode(E_FILENOTFOUND, hr, "Expired payload trust value was not removed.");
+
+                hr = RegReadBinary(hk, L"Current", &pbRecord, &cbRecord);
+                NativeAssert::Succeeded(hr, "Current payload trust value was removed.");
+            }
+            finally
+            {
+                ReleaseMem(pbRecord);
+                ReleaseStr(sczName);
+                ReleaseRegKey(hk);
+                ReleaseFileHandle(hFile);
+
+                if (Directory::Exists(tempFolder))
+                {
+                    Directory::Delete(tempFolder, true);
+                }
+
+                this->testRegistry->TearDown();
+            }
+        }
+
+        [Fact]
+        void CachePayloadTrustPerUserTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_CACHE cache = { };
+            BURN_PAYLOAD payload = { };
+            BYTE rgbKeyIdentifier[SHA1_HASH_LEN] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+            HANDLE hFile = INVALID_HANDLE_VALUE;
+            CACHE_TEST_CONTEXT context = { };
+            String^ tempFolder = Path::Combine(Path::GetTempPath(), "BurnUnitTest.CacheTest." + Guid::NewGuid().ToString("N"));
+
+            try
+            {
+                this->testRegistry->SetUp();
+
+                String^ filePath = Path::Combine(tempFolder, "CacheSignatureTest.File");
+                Directory::CreateDirectory(tempFolder);
+
+                pin_ptr<const wchar_t> wzTempFolder = PtrToStringChars(tempFolder);
+                pin_ptr<const wchar_t> wzFilePath = PtrToStringChars(filePath);
+
+                cache.dwPayloadTrustLifetime = 60 * 60;
+                payload.sczKey = L"CachePayloadTrustPerUserTest.PayloadKey";
+                payload.sczFilePath = L"CacheSignatureTest.File";
+                payload.qwFileSize = 27;
+                payload.verification = BURN_PAYLOAD_VERIFICATION_AUTHENTICODE;
+                payload.pbCertificateRootPublicKeyIdentifier = rgbKeyIdentifier;
+                payload.cbCertificateRootPublicKeyIdentifier = sizeof(rgbKeyIdentifier);
+
+                // The test file isn't signed, so it only verifies when the trust record is used.
+                for (DWORD i = 0; i < 2; ++i)
+                {
+                    BOOL fPerMachine = 1 == i;
+
+                    File::Copy(Path::Combine(this->TestContext->TestDirectory, "TestData\\CacheTest\\CacheSignatureTest.File"), filePath, true);
+
+                    hFile = ::CreateFileW(wzFilePath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+                    Assert::True(INVALID_HANDLE_VALUE != hFile, "Failed to open test file.");
+
+                    hr = CachePayloadTrustWrite(&payload, hFile);
+                    NativeAssert::Succeeded(hr, "Failed to write payload trust.");
+
+                    ReleaseFileHandle(hFile);
+                    hFile = INVALID_HANDLE_VALUE;
+
+                    hr = CacheVerifyPayload(&cache, fPerMachine, &payload, wzTempFolder, CacheTestEventRoutine, CacheTestProgressRoutine, &context);
+                    if (fPerMachine)
+                    {
+                        NativeAssert::Succeeded(hr, "Per-machine payload did not use its trust record.");
+                        Assert::Equal<DWORD>(1, cache.cPayloadTrustHits);
+                    }
+                    else
+                    {
+                        Assert::True(FAILED(hr), "Per-user payload used a trust record.");
+                        Assert::Equal<DWORD>(0, cache.cPayloadTrustHits);
+                        Assert::Equal<DWORD>(0, cache.cPayloadTrustMisses);
+                    }
+                }
+            }
+            finally
+            {
+                ReleaseFileHandle(hFile);
+
+                if (Directory::Exists(tempFolder))
+                {
+                    Directory::Delete(tempFolder, true);
+                }
+
+                this->testRegistry->TearDown();
+            }
+        }
+
+        [Fact]
+        void CacheIndexTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_CACHE_INDEX index = { };
+            LPWSTR sczDirectory = NULL;
+            LPWSTR sczPath = NULL;
+            BOOL fExists = FALSE;
+            DWORD64 qwFileSize = 0;
+
+            try
+            {
+                pin_ptr<const wchar_t> dataDirectory = PtrToStringChars(this->TestContext->TestDirectory);
+                hr = PathConcat(dataDirectory, L"TestData\\CacheTest", &sczDirectory);
+                NativeAssert::Succeeded(hr, "Failed to get path to test directory.");
+
+                hr = CacheIndexDirectoryExists(&index, sczDirectory, &fExists);
+                NativeAssert::Succeeded(hr, "Failed to index test directory.");
+                Assert::True(fExists);
+
+                hr = PathConcat(sczDirectory, L"CacheSignatureTest.File", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to get path to test file.");
+
+                hr = CacheIndexFileExists(&index, sczPath, &fExists, &qwFileSize);
+                NativeAssert::Succeeded(hr, "Failed to find test file in index.");
+                Assert::True(fExists);
+                Assert::Equal<DWORD64>(27, qwFileSize);
+
+                // Lookups are case-insensitive like the file system.
+                hr = PathConcat(sczDirectory, L"CACHESIGNATURETEST.FILE", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to get upper case path to test file.");
+
+                hr = CacheIndexFileExists(&index, sczPath, &fExists, NULL);
+                NativeAssert::Succeeded(hr, "Failed to find upper case test file in index.");
+                Assert::True(fExists);
+
+                hr = PathConcat(sczDirectory, L"DoesNotExist.File", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to get path to missing file.");
+
+                hr = CacheIndexFileExists(&index, sczPath, &fExists, &qwFileSize);
+                NativeAssert::Succeeded(hr, "Failed to look up missing file in index.");
+                Assert::False(fExists);
+                Assert::Equal<DWORD64>(0, qwFileSize);
+
+                // Only the one directory was enumerated.
+                Assert::Equal<DWORD>(1, index.cDirectories);
+
+                hr = PathConcat(sczDirectory, L"DoesNotExist\\CacheSignatureTest.File", &sczPath);
+                NativeAssert::Succeeded(hr, "Failed to get path to file in missing directory.");
+
+                hr = CacheIndexFileExists(&index, sczPath, &fExists, NULL);
+                NativeAssert::Succeeded(hr, "Failed to look up file in missing directory.");
+                Assert::False(fExists);
+            }
+            finally
+            {
+                ReleaseStr(sczPath);
+                ReleaseStr(sczDirectory);
+
+                CacheIndexReset(&index);
+            }
+        }
     };
 }
 }
@@ -217,3 +717,24 @@ static DWORD CALLBACK CacheTestProgressRoutine(
 {
     return PROGRESS_QUIET;
 }
+
+static void CacheTest_GetFileInformation(
+    __in_z LPCWSTR wzPath,
+    __out BY_HANDLE_FILE_INFORMATION* pFileInfo
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hFile = ::CreateFileW(wzPath, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    if (INVALID_HANDLE_VALUE == hFile)
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+    }
+    else if (!::GetFileInformationByHandle(hFile, pFileInfo))
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+    }
+
+    ReleaseFileHandle(hFile);
+
+    NativeAssert::Succeeded(hr, "Failed to get file information: {0}", wzPath);
+}
@@ -8,6 +8,9 @@ const DWORD TEST_PARENT_SENT_MESSAGE_ID = 0xFFFF;
 const HRESULT S_TEST_SUCCEEDED = 0x3133;
 const char TEST_MESSAGE_DATA[] = "{94949868-7EAE-4ac5-BEAC-AFCA2821DE01}";
 
+static DWORD vdwChildIgnoredMsiMessages = 0;
+static DWORD vdwChildMsiProgressGranularity = 0;
+
 
 static BOOL STDAPICALLTYPE ElevateTest_ShellExecuteExW(
     __inout LPSHELLEXECUTEINFOW lpExecInfo
@@ -15,6 +18,12 @@ static BOOL STDAPICALLTYPE ElevateTest_ShellExecuteExW(
 static DWORD CALLBACK ElevateTest_ThreadProc(
     __in LPVOID lpThreadParameter
     );
+static BOOL STDAPICALLTYPE ApplyInitializeTest_ShellExecuteExW(
+    __inout LPSHELLEXECUTEINFOW lpExecInfo
+    );
+static DWORD CALLBACK ApplyInitializeTest_ThreadProc(
+    __in LPVOID lpThreadParameter
+    );
 static HRESULT ProcessParentMessages(
     __in BURN_PIPE_MESSAGE* pMsg,
     __in_opt LPVOID pvContext,
@@ -41,11 +50,14 @@ namespace Bootstrapper
     using namespace System::Threading;
     using namespace Xunit;
 
-    public ref class ElevationTest : BurnUnitTest
+    public ref class ElevationTest : BurnUnitTest, IClassFixture<TestRegistryFixture^>
     {
+    private:
+        TestRegistryFixture^ testRegistry;
     public:
-        ElevationTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        ElevationTest(BurnTestFixture^ fixture, TestRegistryFixture^ registryFixture) : BurnUnitTest(fixture)
         {
+            this->testRegistry = registryFixture;
         }
 
         [Fact]
@@ -89,6 +101,67 @@ namespace Bootstrapper
                 PipeConnectionUninitialize(pConnection);
             }
         }
+
+        [Fact]
+        void ApplyInitializeSendsMsiMessageFilterTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_PIPE_CONNECTION* pConnection = &engineState.companionConnection;
+
+            engineState.sczBundleEngineWorkingPath = L"tests\\ignore\\this\\path\\to\\burn.exe";
+            engineState.plan.action = BOOTSTRAPPER_ACTION_INSTALL;
+            engineState.plan.pInternalCommand = &engineState.internalCommand;
+            engineState.internalCommand.automaticUpdates = BURN_AU_PAUSE_ACTION_NONE;
+            engineState.internalCommand.fDisableSystemRestore = TRUE;
+
+            // What the BA asked for in OnApplyBegin.
+            engineState.userExperience.dwIgnoredMsiMessages = WIU_MSI_MESSAGE_FLAG(INSTALLMESSAGE_ACTIONSTART) | WIU_MSI_MESSAGE_FLAG(INSTALLMESSAGE_ACTIONDATA);
+            engineState.userExperience.dwMsiProgressGranularity = 5;
+
+            vdwChildIgnoredMsiMessages = 0;
+            vdwChildMsiProgressGranularity = 0;
+
+            try
+            {
+                this->testRegistry->SetUp();
+
+                ShelFunctionOverride(ApplyInitializeTest_ShellExecuteExW);
+                CoreFunctionOverride(NULL, ThrdWaitForCompletion);
+
+                VariableInitialize(&engineState.variables);
+                PipeConnectionInitialize(pConnection);
+
+                //
+                // per-user side setup
+                //
+                hr = ElevationElevate(&engineState, WM_BURN_ELEVATE, NULL);
+                TestThrowOnFailure(hr, L"Failed to elevate.");
+
+                hr = ElevationApplyInitialize(pConnection->hPipe, &engineState.userExperience, &engineState.variables, &engineState.plan);
+                TestThrowOnFailure(hr, L"Failed to initialize apply in per-machine process.");
+
+                hr = ElevationApplyUninitialize(pConnection->hPipe);
+                TestThrowOnFailure(hr, L"Failed to uninitialize apply in per-machine process.");
+
+                //
+                // initiate termination
+                //
+                hr = PipeTerminateChildProcess(pConnection, 0, FALSE);
+                TestThrowOnFailure(hr, L"Failed to terminate elevated process.");
+
+                // the per-machine process must filter MSI messages the same way
+                Assert::Equal<DWORD>(engineState.userExperience.dwIgnoredMsiMessages, vdwChildIgnoredMsiMessages);
+                Assert::Equal<DWORD>(engineState.userExperience.dwMsiProgressGranularity, vdwChildMsiProgressGranularity);
+            }
+            finally
+            {
+                PipeConnectionUninitialize(pConnection);
+                VariablesUninitialize(&engineState.variables);
+
+                this->testRegistry->TearDown();
+            }
+        }
     };
 }
 }
@@ -154,6 +227,89 @@ LExit:
     return FAILED(hr) ? (DWORD)hr : result.dwResult;
 }
 
+static BOOL STDAPICALLTYPE ApplyInitializeTest_ShellExecuteExW(
+    __inout LPSHELLEXECUTEINFOW lpExecInfo
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR scz = NULL;
+
+    hr = StrAllocString(&scz, lpExecInfo->lpParameters, 0);
+    ExitOnFailure(hr, "Failed to copy arguments.");
+
+    // Pretend this thread is the elevated process.
+    lpExecInfo->hProcess = ::CreateThread(NULL, 0, ApplyInitializeTest_ThreadProc, scz, 0, NULL);
+    ExitOnNullWithLastError(lpExecInfo->hProcess, hr, "Failed to create thread.");
+    scz = NULL;
+
+LExit:
+    ReleaseStr(scz);
+
+    return SUCCEEDED(hr);
+}
+
+static DWORD CALLBACK ApplyInitializeTest_ThreadProc(
+    __in LPVOID lpThreadParameter
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczArguments = (LPWSTR)lpThreadParameter;
+    BURN_ENGINE_STATE engineState = { };
+    BURN_PIPE_CONNECTION* pConnection = &engineState.companionConnection;
+    IXMLDOMElement* pixeBundle = NULL;
+    HANDLE hLock = NULL;
+    DWORD dwChildExitCode = 0;
+    BOOL fRestart = FALSE;
+    BOOL fApplying = FALSE;
+
+    LPCWSTR wzDocument =
+        L"<Bundle>"
+        L"    <Registration Id='{D54F896D-1952-43E6-9C67-B5652240618C}' Tag='foo' ProviderKey='foo' Version='1.0.0.0' ExecutableName='setup.exe' PerMachine='yes'>"
+        L"        <Arp Register='yes' Publisher='WiX Toolset' DisplayName='ApplyInitializeTest' DisplayVersion='1.0.0.0' />"
+        L"    </Registration>"
+        L"</Bundle>";
+
+    VariableInitialize(&engineState.variables);
+    PipeConnectionInitialize(pConnection);
+
+    hr = CacheInitialize(&engineState.cache, &engineState.internalCommand);
+    ExitOnFailure(hr, "Failed to initialize cache.");
+
+    LoadBundleXmlHelper(wzDocument, &pixeBundle);
+
+    hr = RegistrationParseFromXml(&engineState.registration, &engineState.cache, pixeBundle);
+    ExitOnFailure(hr, "Failed to parse registration from manifest.");
+
+    StrAlloc(&pConnection->sczName, MAX_PATH);
+    StrAlloc(&pConnection->sczSecret, MAX_PATH);
+
+    // parse command line arguments
+    if (3 != swscanf_s(sczArguments, L"-q -burn.elevated %s %s %u", pConnection->sczName, MAX_PATH, pConnection->sczSecret, MAX_PATH, &pConnection->dwProcessId))
+    {
+        hr = E_INVALIDARG;
+        ExitOnFailure(hr, "Failed to parse argument string.");
+    }
+
+    // set up connection with per-user process
+    hr = PipeChildConnect(pConnection, TRUE);
+    ExitOnFailure(hr, "Failed to connect to per-user process.");
+
+    hr = ElevationChildPumpMessages(pConnection->hPipe, pConnection->hCachePipe, &engineState.approvedExes, &engineState.cache, &engineState.containers, &engineState.packages, &engineState.payloads, &engineState.variables, &engineState.registration, &engineState.userExperience, &hLock, &dwChildExitCode, &fRestart, &fApplying);
+    ExitOnFailure(hr, "Failed while pumping messages in child 'process'.");
+
+    vdwChildIgnoredMsiMessages = engineState.userExperience.dwIgnoredMsiMessages;
+    vdwChildMsiProgressGranularity = engineState.userExperience.dwMsiProgressGranularity;
+
+LExit:
+    ReleaseObject(pixeBundle);
+    RegistrationUninitialize(&engineState.registration);
+    PipeConnectionUninitialize(pConnection);
+    VariablesUninitialize(&engineState.variables);
+    ReleaseStr(sczArguments);
+
+    return FAILED(hr) ? (DWORD)hr : dwChildExitCode;
+}
+
 static HRESULT ProcessParentMessages(
     __in BURN_PIPE_MESSAGE* pMsg,
     __in_opt LPVOID /*pvContext*/,
@@ -30,6 +30,15 @@ struct EXIT_CODE_ITEM
     BOOTSTRAPPER_APPLY_RESTART restartPerMachine;
 };
 
+static HANDLE vhReleasePackages = NULL;
+static LONG vcLaunchedPackages = 0;
+static LONG vcRunningPackages = 0;
+static LONG vcMaxRunningPackages = 0;
+static LONG vcReleasePackagesAt = 0;
+
+// Long enough for any test, short enough that a package that is never released doesn't hang the run.
+static const DWORD PACKAGE_WAIT_TIMEOUT = 30000;
+
 static BOOL STDAPICALLTYPE ExitCodeTest_ShellExecuteExW(
     __inout LPSHELLEXECUTEINFOW lpExecInfo
     );
@@ -154,6 +163,276 @@ static void LoadEngineState(
             }
         }
 
+        [Fact]
+        void IndependentPackagesRunConcurrentlyTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_PACKAGE* pPackage = NULL;
+            BURN_EXECUTE_ACTION executeAction = { };
+            BURN_EXE_PROCESS rgProcesses[3] = { };
+            LPCWSTR rgwzPackageIds[] = { L"Independent1", L"Independent2", L"Independent3" };
+            DWORD rgdwExitCodes[] = { 0, 1, ERROR_SUCCESS_REBOOT_REQUIRED };
+            HRESULT rghrExpected[] = { S_OK, HRESULT_FROM_WIN32(1), S_OK };
+            BOOTSTRAPPER_APPLY_RESTART rgExpectedRestart[] = { BOOTSTRAPPER_APPLY_RESTART_NONE, BOOTSTRAPPER_APPLY_RESTART_NONE, BOOTSTRAPPER_APPLY_RESTART_REQUIRED };
+            BOOTSTRAPPER_APPLY_RESTART restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+            LPWSTR sczExitCode = NULL;
+            LPWSTR sczOutputFolder = NULL;
+
+            try
+            {
+                CoreFunctionOverride(ExitCodeTest_CreateProcessW, ThrdWaitForCompletion);
+
+                LoadEngineState(&engineState);
+
+                vhReleasePackages = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+                Assert::True(NULL != vhReleasePackages, "Failed to create event.");
+
+                hr = CacheEnsureBaseWorkingFolder(&engineState.cache, &sczOutputFolder);
+                TestThrowOnFailure(hr, L"Failed to create working folder.");
+
+                executeAction.type = BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE;
+                executeAction.exePackage.action = BOOTSTRAPPER_ACTION_STATE_INSTALL;
+
+                // Start every package before any of them is allowed to exit.
+                for (DWORD i = 0; i < countof(rgProcesses); ++i)
+                {
+                    hr = PackageFindById(&engineState.packages, rgwzPackageIds[i], &pPackage);
+                    TestThrowOnFailure(hr, L"Failed to find package.");
+
+                    executeAction.exePackage.pPackage = pPackage;
+
+                    hr = StrAllocFormatted(&sczExitCode, L"%u", rgdwExitCodes[i]);
+                    TestThrowOnFailure(hr, L"Failed to convert exit code to string.");
+
+                    hr = VariableSetString(&engineState.variables, L"ExeExitCode", sczExitCode, FALSE, FALSE);
+                    TestThrowOnFailure(hr, L"Failed to set variable.");
+
+                    hr = ExeEngineLaunchPackage(&executeAction, &engineState.cache, &engineState.variables, sczOutputFolder, ExitCodeTest_GenericMessageHandler, NULL, rgProcesses + i);
+                    NativeAssert::Succeeded(hr, L"Failed to launch package {0}.", i);
+                    Assert::True(NULL != rgProcesses[i].hProcess);
+                    Assert::True(NULL != rgProcesses[i].hOutputFile);
+                }
+
+                for (DWORD i = 0; i < countof(rgProcesses); ++i)
+                {
+                    hr = ExeEngineWaitForProcess(rgProcesses + i, 0, ExitCodeTest_GenericMessageHandler, NULL);
+                    NativeAssert::SpecificReturnCode(HRESULT_FROM_WIN32(WAIT_TIMEOUT), hr, L"Package {0} should still be running.", i);
+                }
+
+                ::SetEvent(vhReleasePackages);
+
+                for (DWORD i = 0; i < countof(rgProcesses); ++i)
+                {
+                    hr = ExeEngineWaitForProcess(rgProcesses + i, INFINITE, ExitCodeTest_GenericMessageHandler, NULL);
+                    NativeAssert::Succeeded(hr, L"Failed to wait for package {0}.", i);
+
+                    restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+                    hr = ExeEngineCompleteProcess(rgProcesses + i, &restart);
+                    NativeAssert::SpecificReturnCode(rghrExpected[i], hr, L"Package {0}, exit code: {1}", i, rgdwExitCodes[i]);
+                    Assert::True(rgExpectedRestart[i] == restart, String::Format("Package {0}, expected restart type '{1}' but got '{2}'", i, gcnew String(LoggingRestartToString(rgExpectedRestart[i])), gcnew String(LoggingRestartToString(restart))));
+                }
+            }
+            finally
+            {
+                if (vhReleasePackages)
+                {
+                    ::SetEvent(vhReleasePackages);
+                }
+
+                for (DWORD i = 0; i < countof(rgProcesses); ++i)
+                {
+                    ExeEngineProcessUninitialize(rgProcesses + i);
+                }
+
+                ReleaseHandle(vhReleasePackages);
+                ReleaseStr(sczOutputFolder);
+                ReleaseStr(sczExitCode);
+                VariablesUninitialize(&engineState.variables);
+            }
+        }
+
+        [Fact]
+        void IndependentPackagesSkipFailedCacheTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_APPLY_CONTEXT applyContext = { };
+            BURN_PACKAGE* pPackage = NULL;
+            BURN_EXECUTE_ACTION rgExecuteActions[9] = { };
+            LPCWSTR rgwzPackageIds[] = { L"Independent1", L"Independent2", L"Independent3" };
+            BOOL fSuspend = FALSE;
+            BOOTSTRAPPER_APPLY_RESTART restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+
+            try
+            {
+                CoreFunctionOverride(ExitCodeTest_CreateProcessW, ThrdWaitForCompletion);
+
+                LoadEngineState(&engineState);
+
+                ::InitializeCriticalSection(&applyContext.csApply);
+                vcLaunchedPackages = 0;
+                vcRunningPackages = 0;
+                vcMaxRunningPackages = 0;
+                vcReleasePackagesAt = 0;
+
+                engineState.userExperience.fConcurrentExePackages = TRUE;
+
+                vhReleasePackages = ::CreateEventW(NULL, TRUE, TRUE, NULL);
+                Assert::True(NULL != vhReleasePackages, "Failed to create event.");
+
+                hr = VariableSetString(&engineState.variables, L"ExeExitCode", L"0", FALSE, FALSE);
+                TestThrowOnFailure(hr, L"Failed to set variable.");
+
+                // Each package waits for its cache sync-point, runs and then reaches its checkpoint.
+                for (DWORD i = 0; i < countof(rgwzPackageIds); ++i)
+                {
+                    hr = PackageFindById(&engineState.packages, rgwzPackageIds[i], &pPackage);
+                    TestThrowOnFailure(hr, L"Failed to find package.");
+
+                    pPackage->hCacheEvent = ::CreateEventW(NULL, TRUE, TRUE, NULL);
+                    Assert::True(NULL != pPackage->hCacheEvent, "Failed to create cache event.");
+
+                    rgExecuteActions[i * 3].type = BURN_EXECUTE_ACTION_TYPE_WAIT_CACHE_PACKAGE;
+                    rgExecuteActions[i * 3].waitCachePackage.pPackage = pPackage;
+
+                    rgExecuteActions[i * 3 + 1].type = BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE;
+                    rgExecuteActions[i * 3 + 1].exePackage.action = BOOTSTRAPPER_ACTION_STATE_INSTALL;
+                    rgExecuteActions[i * 3 + 1].exePackage.pPackage = pPackage;
+
+                    rgExecuteActions[i * 3 + 2].type = BURN_EXECUTE_ACTION_TYPE_CHECKPOINT;
+                    rgExecuteActions[i * 3 + 2].checkpoint.dwId = i + 1;
+                }
+
+                // The second package signaled its sync-point after failing to cache.
+                hr = PackageFindById(&engineState.packages, L"Independent2", &pPackage);
+                TestThrowOnFailure(hr, L"Failed to find package.");
+
+                pPackage->hrCacheResult = E_FAIL;
+
+                engineState.plan.pCache = &engineState.cache;
+                engineState.plan.rgExecuteActions = rgExecuteActions;
+                engineState.plan.cExecuteActions = countof(rgExecuteActions);
+
+                hr = ApplyExecute(&engineState, &applyContext, &fSuspend, &restart);
+                NativeAssert::Succeeded(hr, L"Failed to execute independent packages.");
+
+                Assert::False(fSuspend);
+                Assert::Equal<LONG>(2, vcLaunchedPackages);
+
+                // The packages are vital, so each one completes before the next one starts.
+                Assert::Equal<LONG>(1, vcMaxRunningPackages);
+            }
+            finally
+            {
+                engineState.plan.rgExecuteActions = NULL;
+                engineState.plan.cExecuteActions = 0;
+
+                for (DWORD i = 0; i < countof(rgwzPackageIds); ++i)
+                {
+                    if (SUCCEEDED(PackageFindById(&engineState.packages, rgwzPackageIds[i], &pPackage)))
+                    {
+                        ReleaseHandle(pPackage->hCacheEvent);
+                    }
+                }
+
+                ::DeleteCriticalSection(&applyContext.csApply);
+                ReleaseHandle(vhReleasePackages);
+                VariablesUninitialize(&engineState.variables);
+            }
+        }
+
+        [Fact]
+        void IndependentPackagesRunConcurrentlyOnlyWhenBAAllowsTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_APPLY_CONTEXT applyContext = { };
+            BURN_PACKAGE* pPackage = NULL;
+            BURN_EXECUTE_ACTION rgExecuteActions[6] = { };
+            LPCWSTR rgwzPackageIds[] = { L"Independent1", L"Independent2", L"Independent3" };
+            BOOL fSuspend = FALSE;
+            BOOTSTRAPPER_APPLY_RESTART restart = BOOTSTRAPPER_APPLY_RESTART_NONE;
+
+            try
+            {
+                CoreFunctionOverride(ExitCodeTest_CreateProcessW, ThrdWaitForCompletion);
+
+                LoadEngineState(&engineState);
+
+                ::InitializeCriticalSection(&applyContext.csApply);
+
+                vhReleasePackages = ::CreateEventW(NULL, TRUE, TRUE, NULL);
+                Assert::True(NULL != vhReleasePackages, "Failed to create event.");
+
+                hr = VariableSetString(&engineState.variables, L"ExeExitCode", L"0", FALSE, FALSE);
+                TestThrowOnFailure(hr, L"Failed to set variable.");
+
+                // Non-vital packages don't stop the chain when they fail, so nothing has to wait for them.
+                for (DWORD i = 0; i < countof(rgwzPackageIds); ++i)
+                {
+                    hr = PackageFindById(&engineState.packages, rgwzPackageIds[i], &pPackage);
+                    TestThrowOnFailure(hr, L"Failed to find package.");
+
+                    pPackage->fVital = FALSE;
+
+                    rgExecuteActions[i * 2].type = BURN_EXECUTE_ACTION_TYPE_EXE_PACKAGE;
+                    rgExecuteActions[i * 2].exePackage.action = BOOTSTRAPPER_ACTION_STATE_INSTALL;
+                    rgExecuteActions[i * 2].exePackage.pPackage = pPackage;
+
+                    rgExecuteActions[i * 2 + 1].type = BURN_EXECUTE_ACTION_TYPE_CHECKPOINT;
+                    rgExecuteActions[i * 2 + 1].checkpoint.dwId = i + 1;
+                }
+
+                engineState.plan.pCache = &engineState.cache;
+                engineState.plan.rgExecuteActions = rgExecuteActions;
+                engineState.plan.cExecuteActions = countof(rgExecuteActions);
+
+                // Without the BA's consent the packages run one at a time.
+                vcLaunchedPackages = 0;
+                vcRunningPackages = 0;
+                vcMaxRunningPackages = 0;
+                vcReleasePackagesAt = 0;
+
+                hr = ApplyExecute(&engineState, &applyContext, &fSuspend, &restart);
+                NativeAssert::Succeeded(hr, L"Failed to execute independent packages one at a time.");
+
+                Assert::Equal<LONG>(3, vcLaunchedPackages);
+                Assert::Equal<LONG>(1, vcMaxRunningPackages);
+
+                // With it they all start, and the last one to start lets them all exit.
+                engineState.userExperience.fConcurrentExePackages = TRUE;
+                ::ResetEvent(vhReleasePackages);
+
+                vcLaunchedPackages = 0;
+                vcRunningPackages = 0;
+                vcMaxRunningPackages = 0;
+                vcReleasePackagesAt = countof(rgwzPackageIds);
+
+                hr = ApplyExecute(&engineState, &applyContext, &fSuspend, &restart);
+                NativeAssert::Succeeded(hr, L"Failed to execute independent packages concurrently.");
+
+                Assert::False(fSuspend);
+                Assert::Equal<LONG>(3, vcLaunchedPackages);
+                Assert::Equal<LONG>(3, vcMaxRunningPackages);
+            }
+            finally
+            {
+                engineState.plan.rgExecuteActions = NULL;
+                engineState.plan.cExecuteActions = 0;
+                vcReleasePackagesAt = 0;
+
+                if (vhReleasePackages)
+                {
+                    ::SetEvent(vhReleasePackages);
+                }
+
+                ::DeleteCriticalSection(&applyContext.csApply);
+                ReleaseHandle(vhReleasePackages);
+                VariablesUninitialize(&engineState.variables);
+            }
+        }
+
     private:
         void ExecuteExePackage(
             __in BURN_ENGINE_STATE* pEngineState,
@@ -275,6 +554,8 @@ static BOOL STDAPICALLTYPE ExitCodeTest_CreateProcessW(
     hr = StrAllocString(&scz, wzArgs, 0);
     ExitOnFailure(hr, "Failed to copy arguments.");
 
+    ::InterlockedIncrement(&vcLaunchedPackages);
+
     // Pretend this thread is the package process.
     lpProcessInformation->hProcess = ::CreateThread(NULL, 0, ExitCodeTest_PackageThreadProc, scz, 0, NULL);
     ExitOnNullWithLastError(lpProcessInformation->hProcess, hr, "Failed to create thread.");
@@ -303,6 +584,26 @@ static DWORD CALLBACK ExitCodeTest_PackageThreadProc(
     hr = StrStringToUInt32(argv[1], 0, reinterpret_cast<UINT*>(&dwResult));
     ExitOnFailure(hr, "Failed to convert %ls to DWORD.", argv[1]);
 
+    // Packages that were asked to wait stay "running" until the test lets them go.
+    if (2 < argc && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, argv[2], -1, L"wait", -1))
+    {
+        LONG cRunning = ::InterlockedIncrement(&vcRunningPackages);
+        LONG cMaxRunning = vcMaxRunningPackages;
+
+        while (cMaxRunning < cRunning && cMaxRunning != ::InterlockedCompareExchange(&vcMaxRunningPackages, cRunning, cMaxRunning))
+        {
+            cMaxRunning = vcMaxRunningPackages;
+        }
+
+        if (vcReleasePackagesAt && vcReleasePackagesAt <= cRunning)
+        {
+            ::SetEvent(vhReleasePackages);
+        }
+
+        ::WaitForSingleObject(vhReleasePackages, PACKAGE_WAIT_TIMEOUT);
+        ::InterlockedDecrement(&vcRunningPackages);
+    }
+
 LExit:
     AppFreeCommandLineArgs(argv);
     ReleaseStr(sczArguments);
@@ -353,6 +654,15 @@ static void LoadEngineState(
         L"        <ExePackage Id='Standard' Cache='remove' CacheId='test.exe' InstallSize='1' Size='1' PerMachine='no' Permanent='yes' Vital='yes' DetectCondition='' InstallArguments='[ExeExitCode]' UninstallArguments='' Uninstallable='no' RepairArguments='' Repairable='no' Protocol='none' DetectionType='condition'>"
         L"            <PayloadRef Id='test.exe' />"
         L"        </ExePackage>"
+        L"        <ExePackage Id='Independent1' Cache='remove' CacheId='test.exe' InstallSize='1' Size='1' PerMachine='no' Permanent='yes' Vital='yes' DetectCondition='' InstallArguments='[ExeExitCode] wait' UninstallArguments='' Uninstallable='no' RepairArguments='' Repairable='no' Protocol='none' DetectionType='condition' Independent='yes'>"
+        L"            <PayloadRef Id='test.exe' />"
+        L"        </ExePackage>"
+        L"        <ExePackage Id='Independent2' Cache='remove' CacheId='test.exe' InstallSize='1' Size='1' PerMachine='no' Permanent='yes' Vital='yes' DetectCondition='' InstallArguments='[ExeExitCode] wait' UninstallArguments='' Uninstallable='no' RepairArguments='' Repairable='no' Protocol='none' DetectionType='condition' Independent='yes'>"
+        L"            <PayloadRef Id='test.exe' />"
+        L"        </ExePackage>"
+        L"        <ExePackage Id='Independent3' Cache='remove' CacheId='test.exe' InstallSize='1' Size='1' PerMachine='no' Permanent='yes' Vital='yes' DetectCondition='' InstallArguments='[ExeExitCode] wait' UninstallArguments='' Uninstallable='no' RepairArguments='' Repairable='no' Protocol='none' DetectionType='condition' Independent='yes'>"
+        L"            <PayloadRef Id='test.exe' />"
+        L"        </ExePackage>"
         L"    </Chain>"
         L"</BurnManifest>";
 
@@ -2680,6 +2680,79 @@ namespace Bootstrapper
             ValidateNonPermanentPackageExpectedStates(&pEngineState->packages.rgPackages[2], L"PatchA", BURN_PACKAGE_REGISTRATION_STATE_ABSENT, BURN_PACKAGE_REGISTRATION_STATE_ABSENT);
         }
 
+        [Fact]
+        void SpliceInsertedActionsTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_ENGINE_STATE engineState = { };
+            BURN_PLAN* pPlan = &engineState.plan;
+            DWORD rgdwExpectedExecute[] = { 103, 1, 2, 106, 105, 102, 101, 3, 4, 5, 104, 6 };
+            DWORD rgdwExpectedRollback[] = { 202, 201, 1, 2, 203 };
+
+            try
+            {
+                hr = VariableInitialize(&engineState.variables);
+                NativeAssert::Succeeded(hr, "Failed to initialize variables.");
+
+                // Each insert index is relative to the plan as it looks at that moment, including
+                // earlier inserts that have not been spliced yet and actions appended in between.
+                AddCheckpointAction(pPlan, FALSE, FALSE, 0, 1);
+                AddCheckpointAction(pPlan, FALSE, FALSE, 0, 2);
+                AddCheckpointAction(pPlan, FALSE, FALSE, 0, 3);
+                AddCheckpointAction(pPlan, FALSE, FALSE, 0, 4);
+                AddCheckpointAction(pPlan, FALSE, TRUE, 2, 101);
+                AddCheckpointAction(pPlan, FALSE, TRUE, 2, 102);
+                AddCheckpointAction(pPlan, FALSE, TRUE, 0, 103);
+                AddCheckpointAction(pPlan, FALSE, FALSE, 0, 5);
+                AddCheckpointAction(pPlan, FALSE, TRUE, 8, 104);
+                AddCheckpointAction(pPlan, FALSE, TRUE, 3, 105);
+                AddCheckpointAction(pPlan, FALSE, TRUE, 3, 106);
+                AddCheckpointAction(pPlan, FALSE, FALSE, 0, 6);
+
+                AddCheckpointAction(pPlan, TRUE, FALSE, 0, 1);
+                AddCheckpointAction(pPlan, TRUE, FALSE, 0, 2);
+                AddCheckpointAction(pPlan, TRUE, TRUE, 0, 201);
+                AddCheckpointAction(pPlan, TRUE, TRUE, 0, 202);
+                AddCheckpointAction(pPlan, TRUE, TRUE, 4, 203);
+
+                hr = PlanSpliceInsertedActions(pPlan);
+                NativeAssert::Succeeded(hr, "Failed to splice inserted actions.");
+
+                Assert::Equal(0ul, pPlan->cInsertedExecuteActions);
+                Assert::Equal(0ul, pPlan->cInsertedRollbackActions);
+
+                for (DWORD i = 0; i < countof(rgdwExpectedExecute); ++i)
+                {
+                    ValidateExecuteCheckpoint(pPlan, FALSE, i, rgdwExpectedExecute[i]);
+                }
+                Assert::Equal<DWORD>(countof(rgdwExpectedExecute), pPlan->cExecuteActions);
+
+                for (DWORD i = 0; i < countof(rgdwExpectedRollback); ++i)
+                {
+                    ValidateExecuteCheckpoint(pPlan, TRUE, i, rgdwExpectedRollback[i]);
+                }
+                Assert::Equal<DWORD>(countof(rgdwExpectedRollback), pPlan->cRollbackActions);
+
+                // Inserting after a splice starts over from the spliced list.
+                AddCheckpointAction(pPlan, FALSE, TRUE, 0, 107);
+                AddCheckpointAction(pPlan, FALSE, TRUE, 13, 108);
+
+                hr = PlanSpliceInsertedActions(pPlan);
+                NativeAssert::Succeeded(hr, "Failed to splice inserted actions again.");
+
+                ValidateExecuteCheckpoint(pPlan, FALSE, 0, 107);
+                ValidateExecuteCheckpoint(pPlan, FALSE, 1, 103);
+                ValidateExecuteCheckpoint(pPlan, FALSE, 12, 6);
+                ValidateExecuteCheckpoint(pPlan, FALSE, 13, 108);
+                Assert::Equal<DWORD>(countof(rgdwExpectedExecute) + 2, pPlan->cExecuteActions);
+            }
+            finally
+            {
+                PlanReset(&engineState.plan, &engineState.variables, &engineState.containers, &engineState.packages, &engineState.layoutPayloads);
+                VariablesUninitialize(&engineState.variables);
+            }
+        }
+
         [Fact]
         void UnuninstallableExePackageForceAbsentTest()
         {
@@ -3221,6 +3294,31 @@ namespace Bootstrapper
             }
         }
 
+        void AddCheckpointAction(
+            __in BURN_PLAN* pPlan,
+            __in BOOL fRollback,
+            __in BOOL fInsert,
+            __in DWORD dwIndex,
+            __in DWORD dwId
+            )
+        {
+            HRESULT hr = S_OK;
+            BURN_EXECUTE_ACTION* pAction = NULL;
+
+            if (fInsert)
+            {
+                hr = fRollback ? PlanInsertRollbackAction(dwIndex, pPlan, &pAction) : PlanInsertExecuteAction(dwIndex, pPlan, &pAction);
+            }
+            else
+            {
+                hr = fRollback ? PlanAppendRollbackAction(pPlan, &pAction) : PlanAppendExecuteAction(pPlan, &pAction);
+            }
+            NativeAssert::Succeeded(hr, "Failed to add checkpoint action.");
+
+            pAction->type = BURN_EXECUTE_ACTION_TYPE_CHECKPOINT;
+            pAction->checkpoint.dwId = dwId;
+        }
+
         void ValidateCacheContainer(
             __in BURN_PLAN* pPlan,
             __in BOOL fRollback,
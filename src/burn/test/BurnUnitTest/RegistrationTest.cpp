@@ -665,6 +665,7 @@ namespace Bootstrapper
             LPWSTR sczCurrentProcess = NULL;
             LPWSTR sczValue = NULL;
             BURN_VARIABLES variables = { };
+            BURN_VARIABLES resumedVariables = { };
             BURN_USER_EXPERIENCE userExperience = { };
             BOOTSTRAPPER_COMMAND command = { };
             BURN_REGISTRATION registration = { };
@@ -676,7 +677,8 @@ namespace Bootstrapper
             BOOTSTRAPPER_RESUME_TYPE resumeType = BOOTSTRAPPER_RESUME_TYPE_NONE;
             BYTE* pbBuffer = NULL;
             SIZE_T cbBuffer = 0;
-            SIZE_T piBuffer = 0;
+            DWORD dwSequence = 0;
+            DWORD cChanges = 0;
             String^ cacheDirectory = Path::Combine(Path::Combine(Environment::GetFolderPath(Environment::SpecialFolder::LocalApplicationData), gcnew String(L"Package Cache")), gcnew String(TEST_BUNDLE_ID));
             String^ cacheExePath = Path::Combine(cacheDirectory, gcnew String(L"setup.exe"));
             DWORD dwRegistrationOptions = 0;
@@ -742,6 +744,9 @@ namespace Bootstrapper
                 VariableSetStringHelper(&variables, L"MyBurnVariable2", L"bar", FALSE);
                 VariableSetVersionHelper(&variables, L"MyBurnVariable3", L"v1.0-beta");
 
+                hr = VariableGetChangeSequence(&variables, &dwSequence);
+                TestThrowOnFailure(hr, L"Failed to get variable change sequence.");
+
                 hr = VariableSerialize(&variables, TRUE, &pbBuffer, &cbBuffer);
                 TestThrowOnFailure(hr, "Failed to serialize variables.");
 
@@ -767,6 +772,25 @@ namespace Bootstrapper
 
                 NativeAssert::StringEqual(L"42", sczValue);
 
+                // append only the changed variable
+                VariableSetStringHelper(&variables, L"MyBurnVariable2", L"baz", FALSE);
+
+                hr = VariableSerializeChanges(&variables, dwSequence, &pbBuffer, &cbBuffer, &dwSequence, &cChanges);
+                TestThrowOnFailure(hr, L"Failed to serialize changed variables.");
+
+                Assert::Equal<DWORD>(1, cChanges);
+
+                hr = RegistrationAppendState(&registration, pbBuffer, cbBuffer);
+                TestThrowOnFailure(hr, L"Failed to append state.");
+
+                Assert::Equal(S_OK, hr);
+
+                ReleaseNullBuffer(pbBuffer);
+                cbBuffer = 0;
+
+                this->ValidateVariableKey(L"MyBurnVariable1", gcnew String(L"42"));
+                this->ValidateVariableKey(L"MyBurnVariable2", gcnew String(L"baz"));
+
                 // read interrupted resume type
                 hr = RegistrationDetectResumeType(&registration, &resumeType);
                 TestThrowOnFailure(hr, L"Failed to read interrupted resume type.");
@@ -787,11 +811,15 @@ namespace Bootstrapper
                 Assert::Equal((int)BOOTSTRAPPER_RESUME_TYPE_SUSPEND, (int)resumeType);
 
                 // read state back
-                hr = RegistrationLoadState(&registration, &pbBuffer, &cbBuffer);
+                hr = VariableInitialize(&resumedVariables);
+                TestThrowOnFailure(hr, L"Failed to initialize resumed variables.");
+
+                hr = RegistrationLoadState(&registration, &resumedVariables);
                 TestThrowOnFailure(hr, L"Failed to load state.");
 
-                hr = VariableDeserialize(&variables, TRUE, pbBuffer, cbBuffer, &piBuffer);
-                TestThrowOnFailure(hr, L"Failed to deserialize variables.");
+                Assert::Equal(42ll, VariableGetNumericHelper(&resumedVariables, L"MyBurnVariable1"));
+                Assert::Equal<String^>(gcnew String(L"baz"), VariableGetStringHelper(&resumedVariables, L"MyBurnVariable2"));
+                Assert::Equal<String^>(gcnew String(L"1.0-beta"), VariableGetVersionHelper(&resumedVariables, L"MyBurnVariable3"));
 
                 // write active resume mode
                 hr = RegistrationSessionBegin(sczCurrentProcess, &registration, &cache, &variables, dwRegistrationOptions, qwEstimatedSize, BOOTSTRAPPER_REGISTRATION_TYPE_INPROGRESS);
@@ -816,6 +844,175 @@ namespace Bootstrapper
                 ReleaseObject(pixeBundle);
                 UserExperienceUninitialize(&userExperience);
                 RegistrationUninitialize(&registration);
+                VariablesUninitialize(&resumedVariables);
+                VariablesUninitialize(&variables);
+
+                if (Directory::Exists(cacheDirectory))
+                {
+                    Directory::Delete(cacheDirectory, true);
+                }
+
+                this->testRegistry->TearDown();
+            }
+        }
+
+        [Fact]
+        void ResumeStateJournalTest()
+        {
+            HRESULT hr = S_OK;
+            IXMLDOMElement* pixeBundle = NULL;
+            LPWSTR sczCurrentProcess = NULL;
+            BURN_VARIABLES variables = { };
+            BURN_VARIABLES resumedVariables = { };
+            BURN_VARIABLES legacyVariables = { };
+            BURN_REGISTRATION registration = { };
+            BURN_CACHE cache = { };
+            BURN_ENGINE_COMMAND internalCommand = { };
+            BYTE* pbBuffer = NULL;
+            SIZE_T cbBuffer = 0;
+            DWORD dwSequence = 0;
+            DWORD cChanges = 0;
+            DWORD rgdwTornRecord[2] = { };
+            HANDLE hFile = INVALID_HANDLE_VALUE;
+            String^ cacheDirectory = Path::Combine(Path::Combine(Environment::GetFolderPath(Environment::SpecialFolder::LocalApplicationData), gcnew String(L"Package Cache")), gcnew String(TEST_BUNDLE_ID));
+            DWORD dwRegistrationOptions = 0;
+            DWORD64 qwEstimatedSize = 1024;
+            try
+            {
+                this->testRegistry->SetUp();
+
+                LPCWSTR wzDocument =
+                    L"<Bundle>"
+                    L"    <Registration Id='{D54F896D-1952-43E6-9C67-B5652240618C}' UpgradeCode='{89FDAE1F-8CC1-48B9-B930-3945E0D3E7F0}' Tag='foo' ProviderKey='foo' Version='1.0.0.0' ExecutableName='setup.exe' PerMachine='no'>"
+                    L"        <Arp Register='yes' Publisher='WiX Toolset' DisplayName='ResumeStateJournalTest' DisplayVersion='1.0.0.0' />"
+                    L"    </Registration>"
+                    L"    <Variable Id='MyBurnVariable1' Type='numeric' Value='0' Hidden='no' Persisted='yes' />"
+                    L"    <Variable Id='MyBurnVariable2' Type='string' Value='foo' Hidden='no' Persisted='yes' />"
+                    L"</Bundle>";
+
+                // load XML document
+                LoadBundleXmlHelper(wzDocument, &pixeBundle);
+
+                hr = CacheInitialize(&cache, &internalCommand);
+                TestThrowOnFailure(hr, L"Failed initialize cache.");
+
+                hr = VariableInitialize(&variables);
+                TestThrowOnFailure(hr, L"Failed to initialize variables.");
+
+                hr = VariablesParseFromXml(&variables, pixeBundle);
+                TestThrowOnFailure(hr, L"Failed to parse variables from XML.");
+
+                hr = RegistrationParseFromXml(&registration, &cache, pixeBundle);
+                TestThrowOnFailure(hr, L"Failed to parse registration from XML.");
+
+                hr = PathForCurrentProcess(&sczCurrentProcess, NULL);
+                TestThrowOnFailure(hr, L"Failed to get current process path.");
+
+                // a new session forgets what an earlier one saved
+                registration.fStateSaved = TRUE;
+                registration.dwStateSequence = 7;
+                registration.cbStateSnapshot = 100;
+                registration.cbStateJournal = 50;
+
+                hr = RegistrationSessionBegin(sczCurrentProcess, &registration, &cache, &variables, dwRegistrationOptions, qwEstimatedSize, BOOTSTRAPPER_REGISTRATION_TYPE_INPROGRESS);
+                TestThrowOnFailure(hr, L"Failed to register bundle.");
+
+                Assert::False(registration.fStateSaved);
+                Assert::Equal<DWORD>(0, registration.dwStateSequence);
+                Assert::Equal<SIZE_T>(0, registration.cbStateSnapshot);
+                Assert::Equal<SIZE_T>(0, registration.cbStateJournal);
+
+                if (!Directory::Exists(cacheDirectory))
+                {
+                    Directory::CreateDirectory(cacheDirectory);
+                }
+
+                // save a snapshot and append a change to it
+                VariableSetNumericHelper(&variables, L"MyBurnVariable1", 42);
+                VariableSetStringHelper(&variables, L"MyBurnVariable2", L"bar", FALSE);
+
+                hr = VariableGetChangeSequence(&variables, &dwSequence);
+                TestThrowOnFailure(hr, L"Failed to get variable change sequence.");
+
+                hr = VariableSerialize(&variables, TRUE, &pbBuffer, &cbBuffer);
+                TestThrowOnFailure(hr, L"Failed to serialize variables.");
+
+                hr = RegistrationSaveState(&registration, pbBuffer, cbBuffer);
+                TestThrowOnFailure(hr, L"Failed to save state.");
+
+                ReleaseNullBuffer(pbBuffer);
+                cbBuffer = 0;
+
+                VariableSetStringHelper(&variables, L"MyBurnVariable2", L"baz", FALSE);
+
+                hr = VariableSerializeChanges(&variables, dwSequence, &pbBuffer, &cbBuffer, &dwSequence, &cChanges);
+                TestThrowOnFailure(hr, L"Failed to serialize changed variables.");
+
+                hr = RegistrationAppendState(&registration, pbBuffer, cbBuffer);
+                TestThrowOnFailure(hr, L"Failed to append state.");
+
+                ReleaseNullBuffer(pbBuffer);
+                cbBuffer = 0;
+
+                // leave a record torn halfway through, like an interrupted append would
+                VariableSetStringHelper(&variables, L"MyBurnVariable2", L"qux", FALSE);
+
+                hr = VariableSerializeChanges(&variables, dwSequence, &pbBuffer, &cbBuffer, &dwSequence, &cChanges);
+                TestThrowOnFailure(hr, L"Failed to serialize torn variables.");
+
+                rgdwTornRecord[0] = static_cast<DWORD>(cbBuffer);
+
+                hFile = ::CreateFileW(registration.sczStateFile, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                Assert::True(INVALID_HANDLE_VALUE != hFile, "Failed to open state file for append.");
+
+                hr = FileWriteHandle(hFile, reinterpret_cast<LPCBYTE>(rgdwTornRecord), sizeof(rgdwTornRecord));
+                TestThrowOnFailure(hr, L"Failed to write torn record header.");
+
+                hr = FileWriteHandle(hFile, pbBuffer, cbBuffer / 2);
+                TestThrowOnFailure(hr, L"Failed to write torn record.");
+
+                ReleaseFileHandle(hFile);
+                ReleaseNullBuffer(pbBuffer);
+                cbBuffer = 0;
+
+                // the records before the torn one still load
+                hr = VariableInitialize(&resumedVariables);
+                TestThrowOnFailure(hr, L"Failed to initialize resumed variables.");
+
+                hr = RegistrationLoadState(&registration, &resumedVariables);
+                TestThrowOnFailure(hr, L"Failed to load state with torn record.");
+
+                Assert::Equal(42ll, VariableGetNumericHelper(&resumedVariables, L"MyBurnVariable1"));
+                Assert::Equal<String^>(gcnew String(L"baz"), VariableGetStringHelper(&resumedVariables, L"MyBurnVariable2"));
+
+                // a state file written before the journal is just the serialized variables
+                hr = VariableSerialize(&variables, TRUE, &pbBuffer, &cbBuffer);
+                TestThrowOnFailure(hr, L"Failed to serialize legacy variables.");
+
+                hr = FileWrite(registration.sczStateFile, FILE_ATTRIBUTE_NORMAL, pbBuffer, cbBuffer, NULL);
+                TestThrowOnFailure(hr, L"Failed to write legacy state file.");
+
+                ReleaseNullBuffer(pbBuffer);
+                cbBuffer = 0;
+
+                hr = VariableInitialize(&legacyVariables);
+                TestThrowOnFailure(hr, L"Failed to initialize legacy variables.");
+
+                hr = RegistrationLoadState(&registration, &legacyVariables);
+                TestThrowOnFailure(hr, L"Failed to load legacy state.");
+
+                Assert::Equal(42ll, VariableGetNumericHelper(&legacyVariables, L"MyBurnVariable1"));
+                Assert::Equal<String^>(gcnew String(L"qux"), VariableGetStringHelper(&legacyVariables, L"MyBurnVariable2"));
+            }
+            finally
+            {
+                ReleaseFileHandle(hFile);
+                ReleaseBuffer(pbBuffer);
+                ReleaseStr(sczCurrentProcess);
+                ReleaseObject(pixeBundle);
+                RegistrationUninitialize(&registration);
+                VariablesUninitialize(&legacyVariables);
+                VariablesUninitialize(&resumedVariables);
                 VariablesUninitialize(&variables);
 
                 if (Directory::Exists(cacheDirectory))
@@ -132,6 +132,78 @@ namespace Bootstrapper
             }
         }
 
+        [Fact]
+        void RelatedBundleDetectFromSnapshotTest()
+        {
+            HRESULT hr = S_OK;
+            IXMLDOMElement* pixeBundle = NULL;
+            BURN_REGISTRATION registration = { };
+            BURN_RELATED_BUNDLES relatedBundles = { };
+            BURN_RELATED_BUNDLES snapshotRelatedBundles = { };
+            BURN_RELATED_BUNDLES refreshedRelatedBundles = { };
+            BURN_CACHE cache = { };
+            BURN_ENGINE_COMMAND internalCommand = { };
+
+            try
+            {
+                this->testRegistry->SetUp();
+                this->RegisterFakeBundles();
+
+                LPCWSTR wzDocument =
+                    L"<Bundle>"
+                    L"    <UX>"
+                    L"        <Payload Id='ux.dll' FilePath='ux.dll' Packaging='embedded' SourcePath='ux.dll' />"
+                    L"    </UX>"
+                    L"    <RelatedBundle Id='{89FDAE1F-8CC1-48B9-B930-3945E0D3E7F0}' Action='Upgrade' />"
+                    L"    <Registration Id='{D54F896D-1952-43E6-9C67-B5652240618C}' Tag='foo' ProviderKey='foo' Version='1.0.0.0' ExecutableName='setup.exe' PerMachine='yes'>"
+                    L"        <Arp Register='yes' Publisher='WiX Toolset' DisplayName='RegisterBasicTest' DisplayVersion='1.0.0.0' />"
+                    L"    </Registration>"
+                    L"</Bundle>";
+
+                // load XML document
+                LoadBundleXmlHelper(wzDocument, &pixeBundle);
+
+                hr = CacheInitialize(&cache, &internalCommand);
+                TestThrowOnFailure(hr, L"Failed initialize cache.");
+
+                hr = RegistrationParseFromXml(&registration, &cache, pixeBundle);
+                TestThrowOnFailure(hr, L"Failed to parse registration from XML.");
+
+                hr = BundleSnapshotCreate(&registration.hBundleSnapshot);
+                TestThrowOnFailure(hr, L"Failed to create bundle snapshot.");
+
+                RelatedBundlesInitializeForScope(registration.fPerMachine, &registration, &relatedBundles);
+
+                Assert::Equal(1lu, relatedBundles.cRelatedBundles);
+                NativeAssert::StringEqual(L"{AD75BE46-B5D7-4208-BC8B-918553C72D83}", relatedBundles.rgRelatedBundles[0].package.sczId);
+
+                // The snapshot already read the uninstall key so a bundle registered afterwards must not be found through it.
+                this->RegisterFakeBundle(L"{0C6F53A2-4A5B-4F0E-8B0D-6C1A25E1B7F4}", L"{89FDAE1F-8CC1-48B9-B930-3945E0D3E7F0}", NULL, L"2.1.0.0", TRUE);
+
+                RelatedBundlesInitializeForScope(registration.fPerMachine, &registration, &snapshotRelatedBundles);
+
+                Assert::Equal(1lu, snapshotRelatedBundles.cRelatedBundles);
+                NativeAssert::StringEqual(L"{AD75BE46-B5D7-4208-BC8B-918553C72D83}", snapshotRelatedBundles.rgRelatedBundles[0].package.sczId);
+
+                ReleaseNullBundleSnapshot(registration.hBundleSnapshot);
+
+                RelatedBundlesInitializeForScope(registration.fPerMachine, &registration, &refreshedRelatedBundles);
+
+                Assert::Equal(2lu, refreshedRelatedBundles.cRelatedBundles);
+            }
+            finally
+            {
+                ReleaseBundleSnapshot(registration.hBundleSnapshot);
+                ReleaseObject(pixeBundle);
+                RelatedBundlesUninitialize(&refreshedRelatedBundles);
+                RelatedBundlesUninitialize(&snapshotRelatedBundles);
+                RelatedBundlesUninitialize(&relatedBundles);
+                RegistrationUninitialize(&registration);
+
+                this->testRegistry->TearDown();
+            }
+        }
+
         void RegisterFakeBundles()
         {
             this->RegisterFakeBundle(L"{D54F896D-1952-43E6-9C67-B5652240618C}", L"{89FDAE1F-8CC1-48B9-B930-3945E0D3E7F0}", NULL, L"1.0.0.0", TRUE);
@@ -0,0 +1,147 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+
+namespace Microsoft
+{
+namespace Tools
+{
+namespace WindowsInstallerXml
+{
+namespace Test
+{
+namespace Bootstrapper
+{
+    using namespace System;
+    using namespace Xunit;
+
+struct USER_EXPERIENCE_TEST_CONTEXT
+{
+    DWORD cCacheAcquireProgress;
+    DWORD cExecuteProgress;
+    DWORD cProgress;
+    BOOL fCancel;
+};
+
+static HRESULT WINAPI UserExperienceTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+    __in const LPVOID pvArgs,
+    __inout LPVOID pvResults,
+    __in_opt LPVOID pvContext
+    );
+
+    public ref class UserExperienceTest : BurnUnitTest
+    {
+    public:
+        UserExperienceTest(BurnTestFixture^ fixture) : BurnUnitTest(fixture)
+        {
+        }
+
+        [Fact]
+        void UserExperienceProgressCoalescingTest()
+        {
+            HRESULT hr = S_OK;
+            BURN_USER_EXPERIENCE userExperience = { };
+            USER_EXPERIENCE_TEST_CONTEXT context = { };
+            int nResult = IDNOACTION;
+
+            try
+            {
+                userExperience.hUXModule = ::GetModuleHandleW(NULL);
+                userExperience.pfnBAProc = UserExperienceTestBAProc;
+                userExperience.pvBAProcContext = &context;
+                userExperience.dwProgressInterval = INFINITE;
+
+                // Only the first and last tick of a payload are sent while the interval hasn't passed.
+                for (DWORD64 i = 0; i <= 100; ++i)
+                {
+                    hr = UserExperienceOnCacheAcquireProgress(&userExperience, L"PackageA", L"PayloadA", i, 100, 0);
+                    NativeAssert::Succeeded(hr, "Failed to send cache acquire progress.");
+                }
+                Assert::Equal<DWORD>(2, context.cCacheAcquireProgress);
+
+                // The first tick of the next payload is sent, and a cancel from the BA is returned right away.
+                context.fCancel = TRUE;
+                hr = UserExperienceOnCacheAcquireProgress(&userExperience, L"PackageA", L"PayloadB", 1, 100, 0);
+                Assert::Equal<HRESULT>(HRESULT_FROM_WIN32(ERROR_INSTALL_USEREXIT), hr);
+                Assert::Equal<DWORD>(3, context.cCacheAcquireProgress);
+
+                hr = UserExperienceOnExecuteProgress(&userExperience, L"PackageA", 10, 5, &nResult);
+                NativeAssert::Succeeded(hr, "Failed to send execute progress.");
+                Assert::Equal<int>(IDCANCEL, nResult);
+                Assert::Equal<DWORD>(1, context.cExecuteProgress);
+
+                context.fCancel = FALSE;
+                hr = UserExperienceOnExecuteProgress(&userExperience, L"PackageA", 20, 10, &nResult);
+                NativeAssert::Succeeded(hr, "Failed to send execute progress.");
+                Assert::Equal<int>(IDNOACTION, nResult);
+                Assert::Equal<DWORD>(1, context.cExecuteProgress);
+
+                // Dropped overall progress still reports an apply error from the other thread.
+                hr = UserExperienceOnProgress(&userExperience, FALSE, 10, 10);
+                NativeAssert::Succeeded(hr, "Failed to send progress.");
+                Assert::Equal<DWORD>(1, context.cProgress);
+
+                userExperience.hrApplyError = E_FAIL;
+                hr = UserExperienceOnProgress(&userExperience, FALSE, 20, 20);
+                Assert::Equal<HRESULT>(E_FAIL, hr);
+                Assert::Equal<DWORD>(1, context.cProgress);
+
+                // Resetting for the next apply sends the first tick again.
+                UserExperienceExecuteReset(&userExperience);
+                hr = UserExperienceOnProgress(&userExperience, FALSE, 20, 20);
+                NativeAssert::Succeeded(hr, "Failed to send progress.");
+                Assert::Equal<DWORD>(2, context.cProgress);
+
+                // Without an interval, every tick is sent.
+                userExperience.dwProgressInterval = 0;
+                for (DWORD i = 0; i < 10; ++i)
+                {
+                    hr = UserExperienceOnProgress(&userExperience, FALSE, 30, 30);
+                    NativeAssert::Succeeded(hr, "Failed to send progress.");
+                }
+                Assert::Equal<DWORD>(12, context.cProgress);
+            }
+            finally
+            {
+                userExperience.hUXModule = NULL;
+                UserExperienceUninitialize(&userExperience);
+            }
+        }
+    };
+
+static HRESULT WINAPI UserExperienceTestBAProc(
+    __in BOOTSTRAPPER_APPLICATION_MESSAGE message,
+    __in const LPVOID /*pvArgs*/,
+    __inout LPVOID pvResults,
+    __in_opt LPVOID pvContext
+    )
+{
+    USER_EXPERIENCE_TEST_CONTEXT* pContext = reinterpret_cast<USER_EXPERIENCE_TEST_CONTEXT*>(pvContext);
+
+    switch (message)
+    {
+    case BOOTSTRAPPER_APPLICATION_MESSAGE_ONCACHEACQUIREPROGRESS:
+        ++pContext->cCacheAcquireProgress;
+        reinterpret_cast<BA_ONCACHEACQUIREPROGRESS_RESULTS*>(pvResults)->fCancel = pContext->fCancel;
+        break;
+    case BOOTSTRAPPER_APPLICATION_MESSAGE_ONEXECUTEPROGRESS:
+        ++pContext->cExecuteProgress;
+        reinterpret_cast<BA_ONEXECUTEPROGRESS_RESULTS*>(pvResults)->fCancel = pContext->fCancel;
+        break;
+    case BOOTSTRAPPER_APPLICATION_MESSAGE_ONPROGRESS:
+        ++pContext->cProgress;
+        reinterpret_cast<BA_ONPROGRESS_RESULTS*>(pvResults)->fCancel = pContext->fCancel;
+        break;
+    default:
+        break;
+    }
+
+    return S_OK;
+}
+}
+}
+}
+}
+}
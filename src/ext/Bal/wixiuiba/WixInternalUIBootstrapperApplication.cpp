@@ -239,11 +239,14 @@ public: // IBootstrapperApplication
 
     virtual STDMETHODIMP OnApplyBegin(
         __in DWORD dwPhaseCount,
-        __inout BOOL* pfCancel
+        __inout BOOL* pfCancel,
+        __inout DWORD* pdwIgnoredMsiMessages,
+        __inout DWORD* pdwMsiProgressGranularity,
+        __inout BOOL* pfConcurrentExePackages
         )
     {
         m_fApplying = TRUE;
-        return __super::OnApplyBegin(dwPhaseCount, pfCancel);
+        return __super::OnApplyBegin(dwPhaseCount, pfCancel, pdwIgnoredMsiMessages, pdwMsiProgressGranularity, pfConcurrentExePackages);
     }
 
 
@@ -694,7 +694,10 @@ public: // IBootstrapperApplication
 
     virtual STDMETHODIMP OnApplyBegin(
         __in DWORD dwPhaseCount,
-        __in BOOL* pfCancel
+        __in BOOL* pfCancel,
+        __inout DWORD* pdwIgnoredMsiMessages,
+        __inout DWORD* pdwMsiProgressGranularity,
+        __inout BOOL* pfConcurrentExePackages
         )
     {
         m_fStartedExecution = FALSE;
@@ -703,7 +706,7 @@ public: // IBootstrapperApplication
         m_nLastMsiFilesInUseResult = IDNOACTION;
         m_nLastNetfxFilesInUseResult = IDNOACTION;
 
-        return __super::OnApplyBegin(dwPhaseCount, pfCancel);
+        return __super::OnApplyBegin(dwPhaseCount, pfCancel, pdwIgnoredMsiMessages, pdwMsiProgressGranularity, pfConcurrentExePackages);
     }
 
 
@@ -80,8 +80,30 @@ HRESULT IIS7SslBinding(
     );
 //local helper functions
 
-static HRESULT GetNextAvailableSiteId(
+// Collection of an AppHost root section with an index kept across actions
+// until the admin manager is released.
+struct IIS7_INDEXED_SECTION
+{
+    IAppHostElement *pSection;
+    IAppHostElementCollection *pCollection;
+    IIS7_APPHOSTINDEX_HANDLE hIndex;
+};
+
+static IIS7_INDEXED_SECTION vSites = { };
+static IIS7_INDEXED_SECTION vAppPools = { };
+
+static HRESULT GetIndexedSection(
     IAppHostWritableAdminManager *pAdminMgr,
+    LPCWSTR pwzSectionName,
+    LPCWSTR pwzElementName,
+    LPCWSTR pwzAttributeName,
+    IIS7_INDEXED_SECTION *pIndexedSection
+    );
+static void ReleaseIndexedSection(
+    IIS7_INDEXED_SECTION *pIndexedSection
+    );
+static HRESULT GetNextAvailableSiteId(
+    IIS7_INDEXED_SECTION *pSites,
     DWORD *plSiteId
     );
 static HRESULT GetSiteElement(
@@ -151,7 +173,7 @@ static HRESULT DeleteSslBinding(
     );
 
 static HRESULT CreateSite(
-    IAppHostElementCollection *pAdminMgr,
+    IIS7_INDEXED_SECTION *pSites,
     LPCWSTR swSiteName,
     IAppHostElement **pSiteElement
     );
@@ -216,6 +238,10 @@ static HRESULT DeleteCollectionElement(
     __in LPCWSTR pwzAttributeName,
     __in LPCWSTR pwzAttributeValue
     );
+static HRESULT DeleteIndexedElement(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in LPCWSTR pwzAttributeValue
+    );
 
 struct SCA_WEB_ERROR_SERVER
 {
@@ -487,6 +513,8 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
                 }
 
                 // Throw away the changes since IIS has no way to remove uncommited changes from an AdminManager.
+                ReleaseIndexedSection(&vSites);
+                ReleaseIndexedSection(&vAppPools);
                 ReleaseNullObject(pAdminMgr);
 
                 // Restore our CA data backup
@@ -516,6 +544,8 @@ HRESULT IIS7ConfigChanges(MSIHANDLE /*hInstall*/, __inout LPWSTR pwzData)
         hr = S_OK;
     }
 LExit:
+    ReleaseIndexedSection(&vSites);
+    ReleaseIndexedSection(&vAppPools);
     ReleaseObject(pAdminMgr);
     ReleaseStr(pwzBackup);
 
@@ -1816,8 +1846,6 @@ HRESULT IIS7Site(
     BOOL fFound = FALSE;
 
     LPWSTR pwzSiteName = NULL;
-    IAppHostElement *pSites = NULL;
-    IAppHostElementCollection *pCollection = NULL;
     IAppHostElement *pSiteElem = NULL;
     IAppHostElement *pElement = NULL;
 
@@ -1833,19 +1861,13 @@ HRESULT IIS7Site(
     hr = GetSiteElement(pAdminMgr, pwzSiteName, &pSiteElem, &fFound);
     ExitOnFailure(hr, "Failed to read sites from config");
 
-    hr = pAdminMgr->GetAdminSection(ScopeBSTR(IIS_CONFIG_SITES_SECTION), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pSites);
-    ExitOnFailure(hr, "Failed get sites section");
-    ExitOnNull(pSites, hr, ERROR_FILE_NOT_FOUND, "Failed get sites section object");
-
-    hr = pSites->get_Collection( &pCollection);
-    ExitOnFailure(hr, "Failed get site collection");
     switch (iAction)
     {
         case IIS_DELETE :
         {
             if (fFound)
             {
-                hr = DeleteCollectionElement(pCollection, IIS_CONFIG_SITE, IIS_CONFIG_NAME, pwzSiteName);
+                hr = DeleteIndexedElement(vSites.hIndex, pwzSiteName);
                 ExitOnFailure(hr, "Failed to delete website");
             }
             ExitFunction();
@@ -1856,7 +1878,7 @@ HRESULT IIS7Site(
             if (!fFound)
             {
                 //Create the site
-                hr = CreateSite(pCollection, pwzSiteName, &pSiteElem);
+                hr = CreateSite(&vSites, pwzSiteName, &pSiteElem);
                 ExitOnFailure(hr, "Failed to create site");
 
             }
@@ -1872,6 +1894,9 @@ HRESULT IIS7Site(
     {
         hr = Iis7PutPropertyInteger(pSiteElem, IIS_CONFIG_SITE_ID, iData);
         ExitOnFailure(hr, "Failed set site Id data");
+
+        // The sites index tracks the largest id and this changed one behind it.
+        Iis7AppHostIndexInvalidate(vSites.hIndex);
     }
     //Set Site AutoStart
     hr = WcaReadIntegerFromCaData(ppwzCustomActionData, &iData);
@@ -1901,8 +1926,6 @@ HRESULT IIS7Site(
 
 LExit:
     ReleaseStr(pwzSiteName);
-    ReleaseObject(pSites);
-    ReleaseObject(pCollection);
     ReleaseObject(pSiteElem);
     ReleaseObject(pElement);
 
@@ -2322,6 +2345,7 @@ HRESULT IIS7AppExtension(
    IAppHostElement *pSection = NULL;
    IAppHostElement *pElement = NULL;
    IAppHostElementCollection *pCollection = NULL;
+   IIS7_APPHOSTINDEX_HANDLE hHandlers = NULL;
 
    BOOL fFound = FALSE;
    DWORD cHandlers = 1000;
@@ -2364,6 +2388,9 @@ HRESULT IIS7AppExtension(
     hr = pSection->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get handlers collection for appext");
 
+    hr = Iis7AppHostIndexCreate(pCollection, IIS_CONFIG_ADD, IIS_CONFIG_NAME, IIS7_APPHOSTINDEX_FLAG_NONE, &hHandlers);
+    ExitOnFailure(hr, "Failed to create handlers index for appext");
+
     while (IIS_APPEXT_END != iAction)
     {
         fFound = FALSE;
@@ -2377,7 +2404,7 @@ HRESULT IIS7AppExtension(
                 hr = StrAllocFormatted(&pwzHandlerName, L"MsiCustom-%u", ++cHandlers);
                 ExitOnFailure(hr, "Failed increment handler name");
 
-                hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_ADD, IIS_CONFIG_NAME, pwzHandlerName, &pElement, NULL);
+                hr = Iis7AppHostIndexFind(hHandlers, pwzHandlerName, &pElement, NULL);
                 ExitOnFailure(hr, "Failed to find mimemap extension");
 
                 fFound = (NULL != pElement);
@@ -2432,7 +2459,7 @@ HRESULT IIS7AppExtension(
         if (!fFound)
         {
             //  put handler element at beginning of list
-            hr = pCollection->AddElement(pElement, 0);
+            hr = Iis7AppHostIndexAddElement(hHandlers, pElement, 0);
             ExitOnFailure(hr, "Failed add handler element for appext");
         }
 
@@ -2450,6 +2477,7 @@ LExit:
     ReleaseStr(pwzConfigPath);
     ReleaseStr(pwzHandlerName);
     ReleaseStr(pwzPath);
+    ReleaseIis7AppHostIndex(hHandlers);
     ReleaseObject(pSection);
     ReleaseObject(pElement);
     ReleaseObject(pCollection);
@@ -2478,6 +2506,7 @@ LExit:
     IAppHostElement *pSection = NULL;
     IAppHostElement *pElement = NULL;
     IAppHostElementCollection *pCollection = NULL;
+    IIS7_APPHOSTINDEX_HANDLE hMimeMaps = NULL;
 
     BOOL fFound = FALSE;
 
@@ -2520,6 +2549,9 @@ LExit:
     hr = pSection->get_Collection(&pCollection);
     ExitOnFailure(hr, "Failed get staticContent collection for mimemap");
 
+    hr = Iis7AppHostIndexCreate(pCollection, IIS_CONFIG_MIMEMAP, IIS_CONFIG_FILEEXT, IIS7_APPHOSTINDEX_FLAG_NONE, &hMimeMaps);
+    ExitOnFailure(hr, "Failed to create mimemap index");
+
     while (IIS_MIMEMAP_END != iAction)
     {
         //Process property action
@@ -2531,7 +2563,7 @@ LExit:
                 hr = WcaReadStringFromCaData(ppwzCustomActionData, &pwzData);
                 ExitOnFailure(hr, "Failed to read mimemap extension");
 
-                hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_MIMEMAP, IIS_CONFIG_FILEEXT, pwzData, &pElement, NULL);
+                hr = Iis7AppHostIndexFind(hMimeMaps, pwzData, &pElement, NULL);
                 ExitOnFailure(hr, "Failed to find mimemap extension");
                 fFound = (NULL != pElement);
 
@@ -2565,7 +2597,7 @@ LExit:
         if (!fFound)
         {
             //  put mimeMap element at beginning of list
-            hr = pCollection->AddElement(pElement, -1);
+            hr = Iis7AppHostIndexAddElement(hMimeMaps, pElement, -1);
             ExitOnFailure(hr, "Failed add mimemap");
         }
 
@@ -2581,6 +2613,7 @@ LExit:
     ReleaseStr(pwzWebName);
     ReleaseStr(pwzWebRoot);
     ReleaseStr(pwzData);
+    ReleaseIis7AppHostIndex(hMimeMaps);
     ReleaseObject(pSection);
     ReleaseObject(pElement);
     ReleaseObject(pCollection);
@@ -2924,57 +2957,22 @@ HRESULT IIS7SslBinding(
 //-------------------------------------------------------------------------------------------------
 
 static HRESULT GetNextAvailableSiteId(
-    IAppHostElementCollection *pCollection,
+    IIS7_INDEXED_SECTION *pSites,
     DWORD *plSiteId
     )
 {
-   HRESULT hr = S_OK;
-   IAppHostElement *pElement = NULL;
-   IAppHostProperty *pProperty = NULL;
-
-   DWORD cSites;
-   DWORD plNextAvailSite  = 0;
-   VARIANT vPropValue;
-   VARIANT vtIndex;
-
-   VariantInit(&vPropValue);
-   VariantInit(&vtIndex);
-
-   *plSiteId = 0;
-
-    hr = pCollection->get_Count(&cSites);
-    ExitOnFailure(hr, "Failed get sites collection count");
+    HRESULT hr = S_OK;
+    DWORD lMaxSiteId = 0;
 
-    vtIndex.vt = VT_UI4;
-    for (DWORD i = 0; i < cSites; ++i)
-    {
-        vtIndex.ulVal = i;
-        hr = pCollection->get_Item(vtIndex , &pElement);
-        ExitOnFailure(hr, "Failed get sites collection item");
+    *plSiteId = 0;
 
-        hr = pElement->GetPropertyByName(ScopeBSTR(IIS_CONFIG_ID), &pProperty);
-        ExitOnFailure(hr, "Failed get site property");
+    // The sites index tracks the largest id, so this does not enumerate every site for each new one.
+    hr = Iis7AppHostIndexGetMaxInteger(pSites->hIndex, IIS_CONFIG_ID, &lMaxSiteId);
+    ExitOnFailure(hr, "Failed get largest site id");
 
-        hr = pProperty->get_Value(&vPropValue);
-        ExitOnFailure(hr, "Failed get site property value");
-
-        *plSiteId = vPropValue.lVal;
-        if (*plSiteId > plNextAvailSite)
-        {
-            plNextAvailSite = *plSiteId;
-        }
-        ReleaseNullObject(pElement);
-        ReleaseNullObject(pProperty);
-    }
-    *plSiteId = ++plNextAvailSite;
+    *plSiteId = lMaxSiteId + 1;
 
 LExit:
-    ReleaseVariant(vPropValue);
-    ReleaseVariant(vtIndex);
-
-    ReleaseObject(pElement);
-    ReleaseObject(pProperty);
-
     return hr;
 }
 
@@ -2986,27 +2984,18 @@ static HRESULT GetSiteElement(
     )
 {
    HRESULT hr = S_OK;
-   IAppHostElement *pSites = NULL;
-   IAppHostElementCollection *pCollection = NULL;
 
    *fFound = FALSE;
 
-    hr = pAdminMgr->GetAdminSection(ScopeBSTR(IIS_CONFIG_SITES_SECTION), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pSites);
+    hr = GetIndexedSection(pAdminMgr, IIS_CONFIG_SITES_SECTION, IIS_CONFIG_SITE, IIS_CONFIG_NAME, &vSites);
     ExitOnFailure(hr, "Failed get sites section");
-    ExitOnNull(pSites, hr, ERROR_FILE_NOT_FOUND, "Failed get sites section object");
-
-    hr = pSites->get_Collection(&pCollection);
-    ExitOnFailure(hr, "Failed get sites collection");
 
-    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_SITE, IIS_CONFIG_NAME, swSiteName, ppSiteElement, NULL);
+    hr = Iis7AppHostIndexFind(vSites.hIndex, swSiteName, ppSiteElement, NULL);
     ExitOnFailure(hr, "Failed to find site %ls", swSiteName);
 
     *fFound = ppSiteElement != NULL && *ppSiteElement != NULL;
 
 LExit:
-    ReleaseObject(pSites);
-    ReleaseObject(pCollection);
-
     return hr;
 }
 
@@ -3092,7 +3081,7 @@ LExit:
 }
 
 static HRESULT CreateSite(
-    __in IAppHostElementCollection *pCollection,
+    __in IIS7_INDEXED_SECTION *pSites,
     __in LPCWSTR swSiteName,
     __out IAppHostElement **pSiteElement
     )
@@ -3100,20 +3089,20 @@ static HRESULT CreateSite(
     HRESULT hr = S_OK;
     IAppHostElement *pNewElement = NULL;
 
-    hr = pCollection->CreateNewElement(ScopeBSTR(IIS_CONFIG_SITE), &pNewElement);
+    hr = pSites->pCollection->CreateNewElement(ScopeBSTR(IIS_CONFIG_SITE), &pNewElement);
     ExitOnFailure(hr, "Failed create site element");
 
     hr = Iis7PutPropertyString(pNewElement, IIS_CONFIG_NAME, swSiteName);
     ExitOnFailure(hr, "Failed set site name property");
 
     DWORD lSiteId = 0;
-    hr = GetNextAvailableSiteId(pCollection, &lSiteId);
+    hr = GetNextAvailableSiteId(pSites, &lSiteId);
     ExitOnFailure(hr, "Failed get next site id");
 
-    Iis7PutPropertyInteger(pNewElement, IIS_CONFIG_ID, lSiteId);
+    hr = Iis7PutPropertyInteger(pNewElement, IIS_CONFIG_ID, lSiteId);
     ExitOnFailure(hr, "Failed set site id property");
 
-    hr = pCollection->AddElement(pNewElement);
+    hr = Iis7AppHostIndexAddElement(pSites->hIndex, pNewElement, -1);
     ExitOnFailure(hr, "Failed add site element");
 
     *pSiteElement = pNewElement;
@@ -3508,23 +3497,14 @@ static HRESULT DeleteAppPool( IAppHostWritableAdminManager *pAdminMgr,
                             LPCWSTR swAppPoolName)
 {
     HRESULT hr = S_OK;
-    IAppHostElement *pAppPools = NULL;
-    IAppHostElementCollection *pCollection = NULL;
 
-    hr = pAdminMgr->GetAdminSection(ScopeBSTR(IIS_CONFIG_APPPOOL_SECTION), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pAppPools);
+    hr = GetIndexedSection(pAdminMgr, IIS_CONFIG_APPPOOL_SECTION, IIS_CONFIG_ADD, IIS_CONFIG_NAME, &vAppPools);
     ExitOnFailure(hr, "Failed get AppPools section");
-    ExitOnNull(pAppPools, hr, E_UNEXPECTED, "Failed get appPools section object");
 
-    hr = pAppPools->get_Collection( &pCollection);
-    ExitOnFailure(hr, "Failed get AppPools collection");
-
-    hr = DeleteCollectionElement(pCollection, IIS_CONFIG_ADD, IIS_CONFIG_NAME, swAppPoolName);
+    hr = DeleteIndexedElement(vAppPools.hIndex, swAppPoolName);
     ExitOnFailure(hr, "Failed to delete app pool %ls", swAppPoolName);
 
 LExit:
-    ReleaseObject(pAppPools);
-    ReleaseObject(pCollection);
-
     return hr;
 }
 
@@ -3535,12 +3515,10 @@ static HRESULT CreateAppPool(
     )
 {
     HRESULT hr = S_OK;
-    IAppHostElement *pAppPools = NULL;
     IAppHostElement *pAppPoolElement = NULL;
     IAppHostElement *pElement = NULL;
     IAppHostElement *pElement2 = NULL;
     IAppHostElement *pElement3 = NULL;
-    IAppHostElementCollection *pCollection = NULL;
     IAppHostElementCollection *pCollection2 = NULL;
     int iAction = -1;
     int iData   =  0;
@@ -3549,20 +3527,16 @@ static HRESULT CreateAppPool(
     WCHAR wcTime[60];
     BOOL fFound = FALSE;
 
-    hr = pAdminMgr->GetAdminSection(ScopeBSTR(IIS_CONFIG_APPPOOL_SECTION), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pAppPools);
+    hr = GetIndexedSection(pAdminMgr, IIS_CONFIG_APPPOOL_SECTION, IIS_CONFIG_ADD, IIS_CONFIG_NAME, &vAppPools);
     ExitOnFailure(hr, "Failed get AppPools section");
-    ExitOnNull(pAppPools, hr, ERROR_FILE_NOT_FOUND, "Failed get AppPools section object");
-
-    hr = pAppPools->get_Collection( &pCollection);
-    ExitOnFailure(hr, "Failed get AppPools collection");
 
-    hr = Iis7FindAppHostElementString(pCollection, IIS_CONFIG_ADD, IIS_CONFIG_NAME, swAppPoolName, &pAppPoolElement, NULL);
+    hr = Iis7AppHostIndexFind(vAppPools.hIndex, swAppPoolName, &pAppPoolElement, NULL);
     ExitOnFailure(hr, "Failed find AppPool element");
     fFound = (NULL != pAppPoolElement);
 
     if (!fFound)
     {
-        hr = pCollection->CreateNewElement(ScopeBSTR(IIS_CONFIG_ADD), &pAppPoolElement);
+        hr = vAppPools.pCollection->CreateNewElement(ScopeBSTR(IIS_CONFIG_ADD), &pAppPoolElement);
         ExitOnFailure(hr, "Failed create AppPool element");
     }
 
@@ -3578,7 +3552,7 @@ static HRESULT CreateAppPool(
 
     if (!fFound)
     {
-        hr = pCollection->AddElement(pAppPoolElement);
+        hr = Iis7AppHostIndexAddElement(vAppPools.hIndex, pAppPoolElement, -1);
         ExitOnFailure(hr, "Failed to add appPool element");
     }
 
@@ -3883,8 +3857,6 @@ static HRESULT CreateAppPool(
     }
 
 LExit:
-    ReleaseObject(pAppPools);
-    ReleaseObject(pCollection);
     ReleaseObject(pCollection2);
     ReleaseObject(pAppPoolElement);
     ReleaseObject(pElement);
@@ -4169,6 +4141,70 @@ LExit:
 
     return hr;
 }
+
+static HRESULT DeleteIndexedElement(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in LPCWSTR pwzAttributeValue
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD dwIndex = MAXDWORD;
+
+    hr = Iis7AppHostIndexFind(hIndex, pwzAttributeValue, NULL, &dwIndex);
+    ExitOnFailure(hr, "Failed while finding IAppHostElement %ls", pwzAttributeValue);
+
+    if (MAXDWORD != dwIndex)
+    {
+        hr = Iis7AppHostIndexDeleteElement(hIndex, dwIndex);
+        ExitOnFailure(hr, "Failed to delete IAppHostElement %ls", pwzAttributeValue);
+    }
+    // else : nothing to do, already deleted
+LExit:
+    return hr;
+}
+
+static HRESULT GetIndexedSection(
+    IAppHostWritableAdminManager *pAdminMgr,
+    LPCWSTR pwzSectionName,
+    LPCWSTR pwzElementName,
+    LPCWSTR pwzAttributeName,
+    IIS7_INDEXED_SECTION *pIndexedSection
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (pIndexedSection->hIndex)
+    {
+        ExitFunction();
+    }
+
+    hr = pAdminMgr->GetAdminSection(ScopeBSTR(pwzSectionName), ScopeBSTR(IIS_CONFIG_APPHOST_ROOT), &pIndexedSection->pSection);
+    ExitOnFailure(hr, "Failed get %ls section", pwzSectionName);
+    ExitOnNull(pIndexedSection->pSection, hr, ERROR_FILE_NOT_FOUND, "Failed get %ls section object", pwzSectionName);
+
+    hr = pIndexedSection->pSection->get_Collection(&pIndexedSection->pCollection);
+    ExitOnFailure(hr, "Failed get %ls collection", pwzSectionName);
+
+    hr = Iis7AppHostIndexCreate(pIndexedSection->pCollection, pwzElementName, pwzAttributeName, IIS7_APPHOSTINDEX_FLAG_NONE, &pIndexedSection->hIndex);
+    ExitOnFailure(hr, "Failed to create %ls index", pwzSectionName);
+
+LExit:
+    if (FAILED(hr))
+    {
+        ReleaseIndexedSection(pIndexedSection);
+    }
+
+    return hr;
+}
+
+static void ReleaseIndexedSection(
+    IIS7_INDEXED_SECTION *pIndexedSection
+    )
+{
+    ReleaseNullIis7AppHostIndex(pIndexedSection->hIndex);
+    ReleaseNullObject(pIndexedSection->pCollection);
+    ReleaseNullObject(pIndexedSection->pSection);
+}
 static void ConvSecToHMS( int Sec,  __out_ecount(cchDest) LPWSTR wcTime, size_t cchDest)
 {
     int ZH, ZM, ZS = 0;
@@ -21,6 +21,7 @@
 
 #include "sca.h"
 #include "scacost.h"
+#include "scasqlscript.h"
 #include "scasqlstr.h"
 
 #include "caDecor.h"
@@ -267,7 +267,7 @@ LExit:
 /********************************************************************
  ExecuteSqlStrings - CUSTOM ACTION ENTRY POINT for running SQL strings
 
-  Input:  deferred CustomActionData - DbKey\tServer\tInstance\tDatabase\tAttributes\tIntegratedAuth\tUser\tPassword\tSQLKey1\tSQLString1\tSQLKey2\tSQLString2\tSQLKey3\tSQLString3\t...
+  Input:  deferred CustomActionData - DbKey\tServer\tInstance\tDatabase\tAttributes\tIntegratedAuth\tUser\tPassword\tSQLKey1\tSQLAttributes1\tSQLRepeat1\tSQLString1\tSQLKey2\tSQLAttributes2\tSQLRepeat2\tSQLString2\t...
           rollback CustomActionData - same as above
  * ****************************************************************/
 extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
@@ -288,6 +288,7 @@ extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
     LPWSTR pwzDatabase = NULL;
     int iAttributesDB;
     int iAttributesSQL;
+    int iRepeatSQL;
     BOOL fIntegratedAuth;
     LPWSTR pwzUser = NULL;
     LPWSTR pwzPassword = NULL;
@@ -339,6 +340,9 @@ extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
         hr = WcaReadIntegerFromCaData(&pwz, &iAttributesSQL);
         ExitOnFailure(hr, "failed to read attributes for SQL string: %ls", pwzSqlKey);
 
+        hr = WcaReadIntegerFromCaData(&pwz, &iRepeatSQL);
+        ExitOnFailure(hr, "failed to read repeat count for SQL string: %ls", pwzSqlKey);
+
         hr = WcaReadStringFromCaData(&pwz, &pwzSql);
         ExitOnFailure(hr, "failed to read SQL string for key: %ls", pwzSqlKey);
 
@@ -352,14 +356,20 @@ extern "C" UINT __stdcall ExecuteSqlStrings(MSIHANDLE hInstall)
         // Now check if the DB connection succeeded
         MessageExitOnFailure(hr = hrDB, msierrSQLFailedConnectDatabase, "failed to connect to database: '%ls'", pwzDatabase);
 
-        WcaLog(LOGMSG_VERBOSE, "Executing SQL string: %ls", pwzSql);
-        hr = SqlSessionExecuteQuery(pidbSession, pwzSql, NULL, NULL, &bstrErrorDescription);
-        if ((iAttributesSQL & SCASQL_CONTINUE_ON_ERROR) && FAILED(hr))
+        // "GO [count]" in a script executes the string count times
+        WcaLog(LOGMSG_VERBOSE, "Executing SQL string (%u times): %ls", static_cast<DWORD>(iRepeatSQL), pwzSql);
+        for (DWORD i = 0; i < static_cast<DWORD>(iRepeatSQL); ++i)
         {
-            WcaLog(LOGMSG_STANDARD, "Error 0x%x: failed to execute SQL string but continuing, error: %ls, SQL key: %ls SQL string: %ls", hr, NULL == bstrErrorDescription ? L"unknown error" : bstrErrorDescription, pwzSqlKey, pwzSql);
-            hr = S_OK;
+            ReleaseNullBSTR(bstrErrorDescription);
+
+            hr = SqlSessionExecuteQuery(pidbSession, pwzSql, NULL, NULL, &bstrErrorDescription);
+            if ((iAttributesSQL & SCASQL_CONTINUE_ON_ERROR) && FAILED(hr))
+            {
+                WcaLog(LOGMSG_STANDARD, "Error 0x%x: failed to execute SQL string but continuing, error: %ls, SQL key: %ls SQL string: %ls", hr, NULL == bstrErrorDescription ? L"unknown error" : bstrErrorDescription, pwzSqlKey, pwzSql);
+                hr = S_OK;
+            }
+            MessageExitOnFailure(hr, msierrSQLFailedExecString, "failed to execute SQL string, error: %ls, SQL key: %ls SQL string: %ls", NULL == bstrErrorDescription ? L"unknown error" : bstrErrorDescription, pwzSqlKey, pwzSql);
         }
-        MessageExitOnFailure(hr, msierrSQLFailedExecString, "failed to execute SQL string, error: %ls, SQL key: %ls SQL string: %ls", NULL == bstrErrorDescription ? L"unknown error" : bstrErrorDescription, pwzSqlKey, pwzSql);
 
         WcaProgressMessage(COST_SQL_STRING, FALSE);
     }
@@ -0,0 +1,468 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+enum SCA_SQLSCRIPT_MATCH
+{
+    SCA_SQLSCRIPT_MATCH_NONE,
+    SCA_SQLSCRIPT_MATCH_FOUND,
+    SCA_SQLSCRIPT_MATCH_MORE, // cannot tell until more of the script is available
+};
+
+
+// prototypes for private helper functions
+static BOOL IsWhitespace(
+    __in WCHAR wc
+    );
+static SCA_SQLSCRIPT_MATCH MatchPair(
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __in SIZE_T ich,
+    __in WCHAR wcFirst,
+    __in WCHAR wcSecond
+    );
+static SCA_SQLSCRIPT_MATCH MatchDelimiter(
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __in SIZE_T ich
+    );
+static SCA_SQLSCRIPT_MATCH MatchGo(
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __in SIZE_T ichGo,
+    __out DWORD* pcRepeat,
+    __out SIZE_T* pichNextBatch
+    );
+static BOOL CompleteBatch(
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in_ecount(ichEnd) const WCHAR* pwzScript,
+    __in SIZE_T ichEnd,
+    __in DWORD cRepeat,
+    __in SIZE_T ichNextBatch,
+    __out SCA_SQLSCRIPT_BATCH* pBatch
+    );
+
+void ScaSqlScriptTokenizerInitialize(
+    __out SCA_SQLSCRIPT_TOKENIZER* pTokenizer
+    )
+{
+    ::ZeroMemory(pTokenizer, sizeof(SCA_SQLSCRIPT_TOKENIZER));
+
+    pTokenizer->state = SCA_SQLSCRIPT_STATE_NORMAL;
+    pTokenizer->fGoAllowed = TRUE;
+}
+
+
+BOOL ScaSqlScriptNextBatch(
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __out SCA_SQLSCRIPT_BATCH* pBatch
+    )
+{
+    BOOL fFound = FALSE;
+    BOOL fMore = FALSE;
+    SIZE_T i = pTokenizer->ichNext;
+    SCA_SQLSCRIPT_MATCH match = SCA_SQLSCRIPT_MATCH_NONE;
+    DWORD cRepeat = 0;
+    SIZE_T ichNextBatch = 0;
+    WCHAR wc = L'\0';
+
+    ::ZeroMemory(pBatch, sizeof(SCA_SQLSCRIPT_BATCH));
+
+    if (pTokenizer->fEnded)
+    {
+        cchScript = pTokenizer->ichEnd;
+        fFinal = TRUE;
+    }
+
+    while (!fFound && !fMore && i < cchScript)
+    {
+        wc = pwzScript[i];
+
+        // a null character ends the script, just like it always has
+        if (L'\0' == wc)
+        {
+            pTokenizer->fEnded = TRUE;
+            pTokenizer->ichEnd = i;
+            cchScript = i;
+            fFinal = TRUE;
+            break;
+        }
+
+        switch (pTokenizer->state)
+        {
+        case SCA_SQLSCRIPT_STATE_NORMAL:
+            if (IsWhitespace(wc))
+            {
+                // strip off leading whitespace
+                if (!pTokenizer->fBatchStarted)
+                {
+                    pTokenizer->ichBatch = i + 1;
+                }
+
+                pTokenizer->fGoAllowed = TRUE;
+                ++i;
+                break;
+            }
+
+            match = MatchPair(pwzScript, cchScript, fFinal, i, L'-', L'-');
+            if (SCA_SQLSCRIPT_MATCH_NONE == match)
+            {
+                match = MatchPair(pwzScript, cchScript, fFinal, i, L'/', L'*');
+            }
+
+            if (SCA_SQLSCRIPT_MATCH_MORE == match)
+            {
+                fMore = TRUE;
+            }
+            else if (SCA_SQLSCRIPT_MATCH_FOUND == match)
+            {
+                pTokenizer->state = (L'-' == wc) ? SCA_SQLSCRIPT_STATE_LINE_COMMENT : SCA_SQLSCRIPT_STATE_BLOCK_COMMENT;
+                pTokenizer->cCommentDepth = 1;
+                i += 2;
+            }
+            else if ((L'G' == wc || L'g' == wc) && pTokenizer->fGoAllowed && SCA_SQLSCRIPT_MATCH_NONE != (match = MatchGo(pwzScript, cchScript, fFinal, i, &cRepeat, &ichNextBatch)))
+            {
+                if (SCA_SQLSCRIPT_MATCH_MORE == match)
+                {
+                    fMore = TRUE;
+                }
+                else
+                {
+                    fFound = CompleteBatch(pTokenizer, pwzScript, i, cRepeat, ichNextBatch, pBatch);
+                    i = ichNextBatch;
+                }
+            }
+            else
+            {
+                if (L'\'' == wc)
+                {
+                    pTokenizer->state = SCA_SQLSCRIPT_STATE_SINGLE_QUOTE;
+                }
+                else if (L'\"' == wc)
+                {
+                    pTokenizer->state = SCA_SQLSCRIPT_STATE_DOUBLE_QUOTE;
+                }
+                else if (L'[' == wc)
+                {
+                    pTokenizer->state = SCA_SQLSCRIPT_STATE_BRACKET;
+                }
+
+                pTokenizer->fBatchStarted = TRUE;
+                pTokenizer->fGoAllowed = FALSE;
+                ++i;
+            }
+            break;
+
+        case SCA_SQLSCRIPT_STATE_LINE_COMMENT:
+            if (L'\n' == wc)
+            {
+                pTokenizer->state = SCA_SQLSCRIPT_STATE_NORMAL;
+                pTokenizer->fGoAllowed = TRUE;
+
+                // comments at the start of a batch are stripped, comments in the middle are kept
+                if (!pTokenizer->fBatchStarted)
+                {
+                    pTokenizer->ichBatch = i + 1;
+                }
+            }
+            ++i;
+            break;
+
+        case SCA_SQLSCRIPT_STATE_BLOCK_COMMENT:
+            match = MatchPair(pwzScript, cchScript, fFinal, i, L'*', L'/');
+            if (SCA_SQLSCRIPT_MATCH_FOUND == match)
+            {
+                i += 2;
+
+                --pTokenizer->cCommentDepth;
+                if (!pTokenizer->cCommentDepth)
+                {
+                    pTokenizer->state = SCA_SQLSCRIPT_STATE_NORMAL;
+                    pTokenizer->fGoAllowed = TRUE;
+
+                    if (!pTokenizer->fBatchStarted)
+                    {
+                        pTokenizer->ichBatch = i;
+                    }
+                }
+                break;
+            }
+            else if (SCA_SQLSCRIPT_MATCH_NONE == match)
+            {
+                // block comments nest in T-SQL
+                match = MatchPair(pwzScript, cchScript, fFinal, i, L'/', L'*');
+                if (SCA_SQLSCRIPT_MATCH_FOUND == match)
+                {
+                    ++pTokenizer->cCommentDepth;
+                    i += 2;
+                    break;
+                }
+            }
+
+            if (SCA_SQLSCRIPT_MATCH_MORE == match)
+            {
+                fMore = TRUE;
+            }
+            else
+            {
+                ++i;
+            }
+            break;
+
+        case SCA_SQLSCRIPT_STATE_SINGLE_QUOTE:
+            // an escaped quote ('') simply closes and reopens the string
+            if (L'\'' == wc)
+            {
+                pTokenizer->state = SCA_SQLSCRIPT_STATE_NORMAL;
+            }
+            ++i;
+            break;
+
+        case SCA_SQLSCRIPT_STATE_DOUBLE_QUOTE:
+            if (L'\"' == wc)
+            {
+                pTokenizer->state = SCA_SQLSCRIPT_STATE_NORMAL;
+            }
+            ++i;
+            break;
+
+        case SCA_SQLSCRIPT_STATE_BRACKET:
+            // an escaped bracket (]]) stays inside the identifier
+            match = MatchPair(pwzScript, cchScript, fFinal, i, L']', L']');
+            if (SCA_SQLSCRIPT_MATCH_MORE == match)
+            {
+                fMore = TRUE;
+            }
+            else if (SCA_SQLSCRIPT_MATCH_FOUND == match)
+            {
+                i += 2;
+            }
+            else
+            {
+                if (L']' == wc)
+                {
+                    pTokenizer->state = SCA_SQLSCRIPT_STATE_NORMAL;
+                }
+                ++i;
+            }
+            break;
+        }
+    }
+
+    if (!fFound)
+    {
+        if (fFinal)
+        {
+            // anything that is left, including unterminated comments and strings, is the last batch
+            fFound = CompleteBatch(pTokenizer, pwzScript, cchScript, 1, cchScript, pBatch);
+            i = cchScript;
+        }
+        else if (!pTokenizer->fBatchStarted && SCA_SQLSCRIPT_STATE_NORMAL != pTokenizer->state)
+        {
+            // the rest of a leading comment is never part of the batch so the caller need not keep it
+            pTokenizer->ichBatch = i;
+        }
+
+        pTokenizer->ichNext = i;
+    }
+
+    return fFound;
+}
+
+
+void ScaSqlScriptTokenizerDiscard(
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in SIZE_T cch
+    )
+{
+    pTokenizer->ichBatch -= cch;
+    pTokenizer->ichNext -= cch;
+
+    if (pTokenizer->fEnded)
+    {
+        pTokenizer->ichEnd -= cch;
+    }
+}
+
+
+// private helper functions
+
+static BOOL IsWhitespace(
+    __in WCHAR wc
+    )
+{
+    return L' ' == wc || L'\t' == wc || L'\r' == wc || L'\n' == wc || L'\v' == wc || L'\f' == wc;
+}
+
+
+static SCA_SQLSCRIPT_MATCH MatchPair(
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __in SIZE_T ich,
+    __in WCHAR wcFirst,
+    __in WCHAR wcSecond
+    )
+{
+    if (wcFirst != pwzScript[ich])
+    {
+        return SCA_SQLSCRIPT_MATCH_NONE;
+    }
+    else if (ich + 1 >= cchScript)
+    {
+        return fFinal ? SCA_SQLSCRIPT_MATCH_NONE : SCA_SQLSCRIPT_MATCH_MORE;
+    }
+
+    return (wcSecond == pwzScript[ich + 1]) ? SCA_SQLSCRIPT_MATCH_FOUND : SCA_SQLSCRIPT_MATCH_NONE;
+}
+
+
+static SCA_SQLSCRIPT_MATCH MatchDelimiter(
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __in SIZE_T ich
+    )
+{
+    SCA_SQLSCRIPT_MATCH match = SCA_SQLSCRIPT_MATCH_NONE;
+
+    if (ich >= cchScript)
+    {
+        return fFinal ? SCA_SQLSCRIPT_MATCH_FOUND : SCA_SQLSCRIPT_MATCH_MORE;
+    }
+    else if (L'\0' == pwzScript[ich] || IsWhitespace(pwzScript[ich]))
+    {
+        return SCA_SQLSCRIPT_MATCH_FOUND;
+    }
+
+    // the start of a comment also ends the token
+    match = MatchPair(pwzScript, cchScript, fFinal, ich, L'-', L'-');
+    if (SCA_SQLSCRIPT_MATCH_NONE == match)
+    {
+        match = MatchPair(pwzScript, cchScript, fFinal, ich, L'/', L'*');
+    }
+
+    return match;
+}
+
+
+static SCA_SQLSCRIPT_MATCH MatchGo(
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __in SIZE_T ichGo,
+    __out DWORD* pcRepeat,
+    __out SIZE_T* pichNextBatch
+    )
+{
+    SCA_SQLSCRIPT_MATCH match = SCA_SQLSCRIPT_MATCH_NONE;
+    SIZE_T i = ichGo + 2;
+    DWORD cCount = 0;
+    DWORD dwDigit = 0;
+    BOOL fDigits = FALSE;
+
+    *pcRepeat = 1;
+    *pichNextBatch = i;
+
+    if (ichGo + 1 >= cchScript)
+    {
+        return fFinal ? SCA_SQLSCRIPT_MATCH_NONE : SCA_SQLSCRIPT_MATCH_MORE;
+    }
+    else if (L'O' != pwzScript[ichGo + 1] && L'o' != pwzScript[ichGo + 1])
+    {
+        return SCA_SQLSCRIPT_MATCH_NONE;
+    }
+
+    match = MatchDelimiter(pwzScript, cchScript, fFinal, i);
+    if (SCA_SQLSCRIPT_MATCH_FOUND != match)
+    {
+        return match;
+    }
+
+    // "GO" may be followed by a repeat count on the same line
+    while (i < cchScript && (L' ' == pwzScript[i] || L'\t' == pwzScript[i]))
+    {
+        ++i;
+    }
+
+    while (i < cchScript && L'0' <= pwzScript[i] && L'9' >= pwzScript[i])
+    {
+        dwDigit = pwzScript[i] - L'0';
+        if ((MAXDWORD - dwDigit) / 10 < cCount)
+        {
+            // too big to be a repeat count so it is just the start of the next batch
+            return SCA_SQLSCRIPT_MATCH_FOUND;
+        }
+
+        cCount = cCount * 10 + dwDigit;
+        fDigits = TRUE;
+        ++i;
+    }
+
+    if (i >= cchScript && !fFinal)
+    {
+        return SCA_SQLSCRIPT_MATCH_MORE;
+    }
+    else if (fDigits)
+    {
+        // the digits are only a repeat count if nothing else follows them,
+        // otherwise they start the next batch
+        match = MatchDelimiter(pwzScript, cchScript, fFinal, i);
+        if (SCA_SQLSCRIPT_MATCH_MORE == match)
+        {
+            return match;
+        }
+        else if (SCA_SQLSCRIPT_MATCH_FOUND == match)
+        {
+            *pcRepeat = cCount;
+            *pichNextBatch = i;
+        }
+    }
+
+    return SCA_SQLSCRIPT_MATCH_FOUND;
+}
+
+
+static BOOL CompleteBatch(
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in_ecount(ichEnd) const WCHAR* pwzScript,
+    __in SIZE_T ichEnd,
+    __in DWORD cRepeat,
+    __in SIZE_T ichNextBatch,
+    __out SCA_SQLSCRIPT_BATCH* pBatch
+    )
+{
+    BOOL fComplete = FALSE;
+    SIZE_T ichStart = pTokenizer->ichBatch;
+
+    // don't process if there's nothing to process
+    if (pTokenizer->fBatchStarted && cRepeat)
+    {
+        // strip off whitespace at the end of the batch
+        while (ichStart < ichEnd && IsWhitespace(pwzScript[ichEnd - 1]))
+        {
+            --ichEnd;
+        }
+
+        pBatch->ichStart = ichStart;
+        pBatch->cchBatch = ichEnd - ichStart;
+        pBatch->cRepeat = cRepeat;
+
+        fComplete = 0 < pBatch->cchBatch;
+    }
+
+    pTokenizer->state = SCA_SQLSCRIPT_STATE_NORMAL;
+    pTokenizer->cCommentDepth = 0;
+    pTokenizer->fBatchStarted = FALSE;
+    pTokenizer->fGoAllowed = TRUE;
+    pTokenizer->ichBatch = ichNextBatch;
+    pTokenizer->ichNext = ichNextBatch;
+
+    return fComplete;
+}
@@ -0,0 +1,63 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+enum SCA_SQLSCRIPT_STATE
+{
+    SCA_SQLSCRIPT_STATE_NORMAL,
+    SCA_SQLSCRIPT_STATE_LINE_COMMENT,
+    SCA_SQLSCRIPT_STATE_BLOCK_COMMENT,
+    SCA_SQLSCRIPT_STATE_SINGLE_QUOTE,
+    SCA_SQLSCRIPT_STATE_DOUBLE_QUOTE,
+    SCA_SQLSCRIPT_STATE_BRACKET,
+};
+
+// Single pass scanner that splits a SQL script into batches on "GO [count]".
+// The scanner does not own or copy the script; it only records offsets into
+// the text the caller hands to ScaSqlScriptNextBatch(), so the script may be
+// supplied a piece at a time by appending to the same buffer.
+struct SCA_SQLSCRIPT_TOKENIZER
+{
+    SCA_SQLSCRIPT_STATE state;
+    DWORD cCommentDepth;
+    BOOL fBatchStarted; // batch has something other than leading whitespace and comments
+    BOOL fGoAllowed;    // previous character(s) can precede an isolated "GO"
+    BOOL fEnded;        // a null character ended the script at ichEnd
+
+    SIZE_T ichBatch;    // start of the batch being scanned
+    SIZE_T ichNext;     // next character to scan
+    SIZE_T ichEnd;
+};
+
+// A batch found in the script. The text is pwzScript[ichStart, ichStart + cchBatch)
+// with leading and trailing whitespace and leading comments removed.
+struct SCA_SQLSCRIPT_BATCH
+{
+    SIZE_T ichStart;
+    SIZE_T cchBatch;
+    DWORD cRepeat;
+};
+
+
+// prototypes
+void ScaSqlScriptTokenizerInitialize(
+    __out SCA_SQLSCRIPT_TOKENIZER* pTokenizer
+    );
+
+// Returns TRUE when the next batch was found. Returns FALSE when more of the
+// script is needed or, when fFinal is set, when the script has no more batches.
+// Empty batches and "GO 0" are skipped.
+BOOL ScaSqlScriptNextBatch(
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in_ecount(cchScript) const WCHAR* pwzScript,
+    __in SIZE_T cchScript,
+    __in BOOL fFinal,
+    __out SCA_SQLSCRIPT_BATCH* pBatch
+    );
+
+// Tells the scanner the caller removed the first cch characters from the
+// script buffer. cch must not be more than pTokenizer->ichBatch.
+void ScaSqlScriptTokenizerDiscard(
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in SIZE_T cch
+    );
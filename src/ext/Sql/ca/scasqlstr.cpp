@@ -14,15 +14,56 @@ enum eSqlScriptQuery { sscrqScriptBinary=1, sscrqSqlScript, sscrqSqlDb, sscrqCom
 LPCWSTR vcsSqlBinaryScriptQuery = L"SELECT `Data` FROM `Binary` WHERE `Name`=?";
 enum eSqlBinaryScriptQuery { ssbsqData = 1 };
 
+// size of the pieces SQL scripts are read from the Binary table in
+#define SQL_SCRIPT_READ_SIZE 65536
+
+struct SQL_SCRIPT_BATCH_CONTEXT
+{
+    const SCA_SQLSTR* psssScript;
+    SCA_SQLSTR** ppsssList;
+    SCA_SQLSTR** ppsssTail;
+};
+
 
 // prototypes for private helper functions
 static HRESULT NewSqlStr(
     __out SCA_SQLSTR** ppsss
     );
-static SCA_SQLSTR* AddSqlStrToList(
-    __in SCA_SQLSTR* psssList,
+static HRESULT ReadScriptStream(
+    __in MSIHANDLE hRecBinary,
+    __in SQL_SCRIPT_BATCH_CONTEXT* pContext,
+    __in_bcount(SQL_SCRIPT_READ_SIZE) BYTE* pbBuffer,
+    __deref_inout_ecount(*pcchScriptCapacity) LPWSTR* ppwzScript,
+    __inout DWORD* pcchScriptCapacity
+    );
+static DWORD CompleteAnsiLength(
+    __in_bcount(cb) const BYTE* pb,
+    __in DWORD cb
+    );
+static HRESULT AddScriptBatches(
+    __in SQL_SCRIPT_BATCH_CONTEXT* pContext,
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in_ecount(cchScript) LPCWSTR wzScript,
+    __in DWORD cchScript,
+    __in BOOL fFinal
+    );
+static HRESULT AddScriptBatch(
+    __in SQL_SCRIPT_BATCH_CONTEXT* pContext,
+    __in_ecount(cchBatch) LPCWSTR wzBatch,
+    __in SIZE_T cchBatch,
+    __in DWORD cRepeat
+    );
+static SCA_SQLSTR* FindSqlStrListTail(
+    __in_opt SCA_SQLSTR* psssList
+    );
+static void AddSqlStrToList(
+    __inout SCA_SQLSTR** ppsssList,
+    __inout SCA_SQLSTR** ppsssTail,
     __in SCA_SQLSTR* psss
     );
+static SCA_SQLSTR* SortSqlStrList(
+    __in_opt SCA_SQLSTR* psssList
+    );
 static HRESULT ExecuteStrings(
     __in SCA_DB* psdList,
     __in SCA_SQLSTR* psssList,
@@ -43,6 +84,7 @@ HRESULT ScaSqlStrsRead(
     LPWSTR pwzData = NULL;
 
     SCA_SQLSTR* psss = NULL;
+    SCA_SQLSTR* psssTail = FindSqlStrListTail(*ppsssList);
 
     if (S_OK != WcaTableExists(L"Wix4SqlString") || S_OK != WcaTableExists(L"Wix4SqlDatabase"))
     {
@@ -105,7 +147,7 @@ HRESULT ScaSqlStrsRead(
         hr = StrAllocString(&psss->pwzSql, pwzData, 0);
         ExitOnFailure(hr, "Failed to alloc string for SQL string '%ls'", psss->wzKey);
 
-        *ppsssList = AddSqlStrToList(*ppsssList, psss);
+        AddSqlStrToList(ppsssList, &psssTail, psss);
         psss = NULL; // set the sss to NULL so it doesn't get freed below
     }
 
@@ -115,6 +157,9 @@ HRESULT ScaSqlStrsRead(
     }
     ExitOnFailure(hr, "Failure occured while reading Wix4SqlString table");
 
+    // elements were appended in table order, so put them in Sequence order now
+    *ppsssList = SortSqlStrList(*ppsssList);
+
 LExit:
     // if anything was left over after an error clean it all up
     if (psss)
@@ -144,18 +189,13 @@ HRESULT ScaSqlStrsReadScripts(
     LPWSTR pwzComponent = NULL;
     LPWSTR pwzData = NULL;
 
-    BYTE* pbScript = NULL;
-    DWORD cbRead = 0;
-    DWORD cbScript = 0;
-    DWORD cchScript = 0;
-
-    LPWSTR pwzScriptBuffer = NULL;
-    WCHAR* pwzScript = NULL;
-    WCHAR* pwz;
-    DWORD cch = 0;
+    BYTE* pbBuffer = NULL;
+    LPWSTR pwzScript = NULL;
+    DWORD cchScriptCapacity = 0;
 
     SCA_SQLSTR sss;
-    SCA_SQLSTR* psss = NULL;
+    SCA_SQLSTR* psssTail = FindSqlStrListTail(*ppsssList);
+    SQL_SCRIPT_BATCH_CONTEXT context = { &sss, ppsssList, &psssTail };
 
     if (S_OK != WcaTableExists(L"Wix4SqlScript") || S_OK != WcaTableExists(L"Wix4SqlDatabase") || S_OK != WcaTableExists(L"Binary"))
     {
@@ -167,6 +207,10 @@ HRESULT ScaSqlStrsReadScripts(
     hr = WcaOpenView(vcsSqlBinaryScriptQuery, &hViewBinary);
     ExitOnFailure(hr, "Failed to open view on Binary table for SQL scripts");
 
+    // the script is read and split into batches a piece at a time so it is never held in memory all at once
+    pbBuffer = static_cast<BYTE*>(MemAlloc(SQL_SCRIPT_READ_SIZE, FALSE));
+    ExitOnNull(pbBuffer, hr, E_OUTOFMEMORY, "failed to allocate buffer for reading SQL scripts");
+
     // loop through all the sql scripts
     hr = WcaOpenExecuteView(vcsSqlScriptQuery, &hView);
     ExitOnFailure(hr, "Failed to open view on Wix4SqlScript table");
@@ -218,254 +262,9 @@ HRESULT ScaSqlStrsReadScripts(
         hr = WcaFetchSingleRecord(hViewBinary, &hRecBinary);
         ExitOnFailure(hr, "Failed to fetch Wix4SqlScript.BinaryScript_ for SqlScript '%ls'", sss.wzKey);
 
-        // Note: We need to allocate an extra character on the stream to NULL terminate the SQL script.
-        //       The WcaGetRecordStream() function won't let us add extra space on the end of the stream
-        //       so we'll read the stream "the old fashioned way".
-        //hr = WcaGetRecordStream(hRecBinary, ssbsqData, (BYTE**)&pbScript, &cbScript);
-        //ExitOnFailure(hr, "Failed to read Wix4SqlScript.BinaryScript_ for SqlScript '%ls'", sss.wzKey);
-        er = ::MsiRecordReadStream(hRecBinary, ssbsqData, NULL, &cbRead);
-        hr = HRESULT_FROM_WIN32(er);
-        ExitOnFailure(hr, "failed to get size of stream");
-
-        cbScript = cbRead + sizeof(WCHAR); // we may have an ANSI SQL script but leave enough to even NULL terminate a WCHAR string
-        hr = WcaAllocStream(&pbScript, cbScript); // this will allocate a fully zeroed out buffer so our string will be NULL terminated
-        ExitOnFailure(hr, "failed to allocate data for stream");
-
-        er = ::MsiRecordReadStream(hRecBinary, ssbsqData, reinterpret_cast<char*>(pbScript), &cbRead); //read the buffer but leave the space for the NULL terminator
-        hr = HRESULT_FROM_WIN32(er);
-        ExitOnFailure(hr, "failed to read from stream");
-
-        Assert(cbRead + sizeof(WCHAR) == cbScript);
-
-        // Check for the UNICODE BOM file marker.
-        if ((0xFF == *pbScript) && (0xFE == *(pbScript + 1)))
-        {
-            // Copy the UNICODE string after the BOM marker (subtract one because we'll skip the BOM marker).
-            cchScript = (cbScript / sizeof(WCHAR)) - 1;
-
-            hr = StrAllocString(&pwzScriptBuffer, reinterpret_cast<LPWSTR>(pbScript) + 1, 0);
-            ExitOnFailure(hr, "Failed to allocate WCHAR string of size '%d'", cchScript);
-        }
-        else
-        {
-            // We have an ANSI string so convert it to UNICODE.
-            cchScript = cbScript;
-
-            hr = StrAllocStringAnsi(&pwzScriptBuffer, reinterpret_cast<LPCSTR>(pbScript), 0, CP_ACP);
-            ExitOnFailure(hr, "Failed to allocate WCHAR string of size '%d'", cchScript);
-        }
-
-        // Free the byte buffer since it has been converted to a new UNICODE string, one way or another.
-        if (pbScript)
-        {
-            WcaFreeStream(pbScript);
-            pbScript = NULL;
-        }
-
-        // Process the SQL script stripping out unnecessary stuff (like comments) and looking for "GO" statements.
-        pwzScript = pwzScriptBuffer;
-        while (cchScript && pwzScript && *pwzScript)
-        {
-            // strip off leading whitespace
-            while (cchScript && *pwzScript && iswspace(*pwzScript))
-            {
-                ++pwzScript;
-                --cchScript;
-            }
-
-            Assert(0 <= cchScript);
-
-            // if there is a SQL comment remove it
-            while (cchScript && L'/' == *pwzScript && L'*' == *(pwzScript + 1))
-            {
-                // go until end of comment
-                while (cchScript && *pwzScript && *(pwzScript + 1) && !(L'*' == *pwzScript && L'/' == *(pwzScript + 1)))
-                {
-                    ++pwzScript;
-                    --cchScript;
-                }
-
-                Assert(2 <= cchScript);
-
-                if (2 <= cchScript)
-                {
-                    // to account for */ at end
-                    pwzScript+=2;
-                    cchScript-=2;
-                }
-
-                Assert(0 <= cchScript);
-
-                // strip off any new leading whitespace
-                while (cchScript && *pwzScript && iswspace(*pwzScript))
-                {
-                    ++pwzScript;
-                    --cchScript;
-                }
-            }
-
-            while (cchScript && L'-' == *pwzScript && L'-' == *(pwzScript + 1))
-            {
-                // go past the new line character
-                while (cchScript && *pwzScript && L'\n' != *pwzScript)
-                {
-                    ++pwzScript;
-                    --cchScript;
-                }
-
-                Assert(0 <= cchScript);
-
-                if (cchScript && L'\n' == *pwzScript)
-                {
-                    ++pwzScript;
-                    --cchScript;
-                }
-
-                Assert(0 <= cchScript);
-
-                // strip off any new leading whitespace
-                while (cchScript && *pwzScript && iswspace(*pwzScript))
-                {
-                    ++pwzScript;
-                    --cchScript;
-                }
-            }
-
-            Assert(0 <= cchScript);
-
-            // try to isolate a "GO" keyword and count the characters in the SQL string
-            pwz = pwzScript;
-            cch = 0;
-            while (cchScript && *pwz)
-            {
-                //skip past comment lines that might have "go" in them
-                //note that these comments are "in the middle" of our function,
-                //or possibly at the end of a line
-                if (cchScript && L'-' == *pwz && L'-' == *(pwz + 1))
-                {
-                    // skip past chars until the new line character
-                    while (cchScript && *pwz && (L'\n' != *pwz))
-                    {
-                        ++pwz;
-                        ++cch;
-                        --cchScript;
-                    }
-                }
-
-                //skip past comment lines of form /* to */ that might have "go" in them
-                //note that these comments are "in the middle" of our function,
-                //or possibly at the end of a line
-                if (cchScript && L'/' == *pwz && L'*' == *(pwz + 1))
-                {
-                    // skip past chars until the new line character
-                    while (cchScript && *pwz && *(pwz + 1) && !((L'*' == *pwz) && (L'/' == *(pwz + 1))))
-                    {
-                        ++pwz;
-                        ++cch;
-                        --cchScript;
-                    }
-
-                    if (2 <= cchScript)
-                    {
-                        // to account for */ at end
-                        pwz+=2;
-                        cch+=2;
-                        cchScript-=2;
-                    }
-                }
-
-                // Skip past strings that may be part of the SQL statement that might have a "go" in them
-                if ( cchScript && L'\'' == *pwz )
-                {
-                    ++pwz;
-                    ++cch;
-                    --cchScript;
-
-                    // Skip past chars until the end of the string
-                    while ( cchScript && *pwz && !(L'\'' == *pwz) )
-                    {
-                        ++pwz;
-                        ++cch;
-                        --cchScript;
-                    }
-                }
-
-                // Skip past strings that may be part of the SQL statement that might have a "go" in them
-                if ( cchScript && L'\"' == *pwz )
-                {
-                    ++pwz;
-                    ++cch;
-                    --cchScript;
-
-                    // Skip past chars until the end of the string
-                    while ( cchScript && *pwz && !(L'\"' == *pwz) )
-                    {
-                        ++pwz;
-                        ++cch;
-                        --cchScript;
-                    }
-                }
-
-                // if "GO" is isolated
-                if ((pwzScript == pwz || iswspace(*(pwz - 1))) && 
-                    (L'G' == *pwz || L'g' == *pwz) && 
-                    (L'O' == *(pwz + 1) || L'o' == *(pwz + 1)) &&
-                    (0 == *(pwz + 2) || iswspace(*(pwz + 2))))
-                {
-                    *pwz = 0; // null terminate the SQL string on the "G"
-                    pwz += 2;
-                    cchScript -= 2;
-                    break;   // found "GO" now add SQL string to list
-                }
-
-                ++pwz;
-                ++cch;
-                --cchScript;
-            }
-
-            Assert(0 <= cchScript);
-
-            if (0 < cch) //don't process if there's nothing to process
-            {
-                // replace tabs with spaces
-                for (LPWSTR pwzTab = wcsstr(pwzScript, L"\t"); pwzTab; pwzTab = wcsstr(pwzTab, L"\t"))
-                    *pwzTab = ' ';
-
-                // strip off whitespace at the end of the script string
-                for (LPWSTR pwzErase = pwzScript + cch - 1; pwzScript < pwzErase && iswspace(*pwzErase); pwzErase--)
-                {
-                    *(pwzErase) = 0;
-                    cch--;
-                }
-            }
-
-            if (0 < cch)
-            {
-                hr = NewSqlStr(&psss);
-                ExitOnFailure(hr, "failed to allocate new sql string element");
-
-                // copy everything over
-                hr = ::StringCchCopyW(psss->wzKey, countof(psss->wzKey), sss.wzKey);
-                ExitOnFailure(hr, "Failed to copy key string to sqlstr object");
-                hr = ::StringCchCopyW(psss->wzSqlDb, countof(psss->wzSqlDb), sss.wzSqlDb);
-                ExitOnFailure(hr, "Failed to copy DB string to sqlstr object");
-                hr = ::StringCchCopyW(psss->wzComponent, countof(psss->wzComponent), sss.wzComponent);
-                ExitOnFailure(hr, "Failed to copy component string to sqlstr object");
-                psss->isInstalled = sss.isInstalled;
-                psss->isAction = sss.isAction;
-                psss->iAttributes = sss.iAttributes;
-                psss->iSequence = sss.iSequence;
-
-                // cchRequired includes the NULL terminating char
-                hr = StrAllocString(&psss->pwzSql, pwzScript, 0);
-                ExitOnFailure(hr, "Failed to allocate string for SQL script: '%ls'", psss->wzKey);
-
-                *ppsssList = AddSqlStrToList(*ppsssList, psss);
-                psss = NULL; // set the db NULL so it doesn't accidentally get freed below
-            }
-
-            pwzScript = pwz;
-        }
+        // split the script on "GO" statements, adding each SQL string to the list as it is found
+        hr = ReadScriptStream(hRecBinary, &context, pbBuffer, &pwzScript, &cchScriptCapacity);
+        ExitOnFailure(hr, "Failed to read Wix4SqlScript.BinaryScript_ for SqlScript '%ls'", sss.wzKey);
     }
 
     if (E_NOMOREITEMS == hr)
@@ -474,19 +273,12 @@ HRESULT ScaSqlStrsReadScripts(
     }
     ExitOnFailure(hr, "Failure occured while reading Wix4SqlScript table");
 
-LExit:
-    // if anything was left over after an error clean it all up
-    if (psss)
-    {
-        ScaSqlStrsFreeList(psss);
-    }
-
-    if (pbScript)
-    {
-        WcaFreeStream(pbScript);
-    }
+    // elements were appended in table order, so put them in Sequence order now
+    *ppsssList = SortSqlStrList(*ppsssList);
 
-    ReleaseStr(pwzScriptBuffer);
+LExit:
+    ReleaseMem(pwzScript);
+    ReleaseMem(pbBuffer);
     ReleaseStr(pwzData);
     ReleaseStr(pwzComponent);
 
@@ -546,6 +338,8 @@ static HRESULT NewSqlStr(
     SCA_SQLSTR* psss = static_cast<SCA_SQLSTR*>(MemAlloc(sizeof(SCA_SQLSTR), TRUE));
     ExitOnNull(psss, hr, E_OUTOFMEMORY, "failed to allocate memory for new sql string element");
 
+    psss->cRepeat = 1;
+
     *ppsss = psss;
 
 LExit:
@@ -553,50 +347,350 @@ LExit:
 }
 
 
-static SCA_SQLSTR* AddSqlStrToList(
-    __in SCA_SQLSTR* psssList,
-    __in SCA_SQLSTR* psss
+static HRESULT ReadScriptStream(
+    __in MSIHANDLE hRecBinary,
+    __in SQL_SCRIPT_BATCH_CONTEXT* pContext,
+    __in_bcount(SQL_SCRIPT_READ_SIZE) BYTE* pbBuffer,
+    __deref_inout_ecount(*pcchScriptCapacity) LPWSTR* ppwzScript,
+    __inout DWORD* pcchScriptCapacity
     )
 {
-    Assert(psss); //just checking
+    HRESULT hr = S_OK;
+    UINT er = ERROR_SUCCESS;
+    CPINFO cpInfo = { };
+    BOOL fDbcs = FALSE;
+    BOOL fFirstRead = TRUE;
+    BOOL fUnicode = FALSE;
+    DWORD cbCarry = 0;
+    DWORD cbRead = 0;
+    DWORD cbData = 0;
+    DWORD ibData = 0;
+    DWORD cbConvert = 0;
+    DWORD cchScript = 0;
+    DWORD cchDiscard = 0;
+    int cchConverted = 0;
+    SCA_SQLSCRIPT_TOKENIZER tokenizer = { };
 
-    //make certain we have a valid sequence number; note that negatives are technically valid
-    if (MSI_NULL_INTEGER == psss->iSequence)
+    ScaSqlScriptTokenizerInitialize(&tokenizer);
+
+    if (::GetCPInfo(CP_ACP, &cpInfo))
     {
-        psss->iSequence = 0;
+        fDbcs = 1 < cpInfo.MaxCharSize;
     }
 
-    if (psssList)
+    // a null character ends the script so there is no need to read past it
+    while (!tokenizer.fEnded)
     {
-        //list already exists, so insert psss into the list in Sequence order
+        cbRead = SQL_SCRIPT_READ_SIZE - cbCarry;
+        er = ::MsiRecordReadStream(hRecBinary, ssbsqData, reinterpret_cast<char*>(pbBuffer + cbCarry), &cbRead);
+        ExitOnWin32Error(er, hr, "failed to read from stream");
+
+        if (!cbRead)
+        {
+            break;
+        }
+
+        cbData = cbCarry + cbRead;
+        ibData = 0;
+
+        // Check for the UNICODE BOM file marker.
+        if (fFirstRead)
+        {
+            fFirstRead = FALSE;
+
+            if (2 <= cbData && 0xFF == pbBuffer[0] && 0xFE == pbBuffer[1])
+            {
+                fUnicode = TRUE;
+                ibData = 2;
+            }
+        }
 
-        //see if we need to change the head, otherwise figure out where in the order it fits
-        if (psss->iSequence < psssList->iSequence)
+        // make room after the batch being scanned for everything that was read
+        hr = MemEnsureArrayCapacityOf(*ppwzScript, cchScript + SQL_SCRIPT_READ_SIZE, pcchScriptCapacity);
+        ExitOnFailure(hr, "failed to grow buffer for SQL script");
+
+        if (fUnicode)
         {
-            psss->psssNext = psssList;
-            psssList = psss;
+            cbConvert = (cbData - ibData) & ~static_cast<DWORD>(1);
+            ::CopyMemory(*ppwzScript + cchScript, pbBuffer + ibData, cbConvert);
+
+            cchScript += cbConvert / sizeof(WCHAR);
         }
         else
         {
-            SCA_SQLSTR* psssT = psssList;
-            //note that if Sequence numbers are duplicated, as in the case of a sqlscript,
-            //we need to insert them "at the end" of the group so the sqlfile stays in order
-            while (psssT->psssNext && (psssT->psssNext->iSequence <= psss->iSequence))
+            // We have an ANSI string so convert it to UNICODE, without splitting a double-byte character.
+            cbConvert = fDbcs ? CompleteAnsiLength(pbBuffer + ibData, cbData - ibData) : cbData - ibData;
+            if (cbConvert)
             {
-                psssT  = psssT->psssNext;
+                cchConverted = ::MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<LPCSTR>(pbBuffer + ibData), cbConvert, *ppwzScript + cchScript, SQL_SCRIPT_READ_SIZE);
+                ExitOnNullWithLastError(cchConverted, hr, "Failed to convert ANSI SQL script to UNICODE");
+
+                cchScript += cchConverted;
             }
+        }
+
+        hr = AddScriptBatches(pContext, &tokenizer, *ppwzScript, cchScript, FALSE);
+        ExitOnFailure(hr, "Failed to split SQL script into strings");
 
-            //insert our new psss AFTER psssT
-            psss->psssNext = psssT->psssNext;
-            psssT->psssNext = psss;
+        // everything before the batch being scanned has been added to the list so only keep the rest
+        cchDiscard = static_cast<DWORD>(tokenizer.ichBatch);
+        if (cchDiscard)
+        {
+            cchScript -= cchDiscard;
+            ::MoveMemory(*ppwzScript, *ppwzScript + cchDiscard, cchScript * sizeof(WCHAR));
+
+            ScaSqlScriptTokenizerDiscard(&tokenizer, cchDiscard);
+        }
+
+        // keep any partial character for the next read
+        cbCarry = cbData - ibData - cbConvert;
+        if (cbCarry)
+        {
+            ::MoveMemory(pbBuffer, pbBuffer + ibData + cbConvert, cbCarry);
         }
     }
+
+    hr = AddScriptBatches(pContext, &tokenizer, *ppwzScript, cchScript, TRUE);
+    ExitOnFailure(hr, "Failed to split end of SQL script into strings");
+
+LExit:
+    return hr;
+}
+
+
+static DWORD CompleteAnsiLength(
+    __in_bcount(cb) const BYTE* pb,
+    __in DWORD cb
+    )
+{
+    DWORD ib = 0;
+
+    while (ib < cb)
+    {
+        if (::IsDBCSLeadByte(pb[ib]))
+        {
+            if (ib + 1 == cb)
+            {
+                break;
+            }
+
+            ib += 2;
+        }
+        else
+        {
+            ++ib;
+        }
+    }
+
+    return ib;
+}
+
+
+static HRESULT AddScriptBatches(
+    __in SQL_SCRIPT_BATCH_CONTEXT* pContext,
+    __in SCA_SQLSCRIPT_TOKENIZER* pTokenizer,
+    __in_ecount(cchScript) LPCWSTR wzScript,
+    __in DWORD cchScript,
+    __in BOOL fFinal
+    )
+{
+    HRESULT hr = S_OK;
+    SCA_SQLSCRIPT_BATCH batch = { };
+
+    while (ScaSqlScriptNextBatch(pTokenizer, wzScript, cchScript, fFinal, &batch))
+    {
+        hr = AddScriptBatch(pContext, wzScript + batch.ichStart, batch.cchBatch, batch.cRepeat);
+        ExitOnFailure(hr, "Failed to add SQL script batch for SqlScript '%ls'", pContext->psssScript->wzKey);
+    }
+
+LExit:
+    return hr;
+}
+
+
+static HRESULT AddScriptBatch(
+    __in SQL_SCRIPT_BATCH_CONTEXT* pContext,
+    __in_ecount(cchBatch) LPCWSTR wzBatch,
+    __in SIZE_T cchBatch,
+    __in DWORD cRepeat
+    )
+{
+    HRESULT hr = S_OK;
+    const SCA_SQLSTR* psssScript = pContext->psssScript;
+    SCA_SQLSTR* psss = NULL;
+
+    hr = NewSqlStr(&psss);
+    ExitOnFailure(hr, "failed to allocate new sql string element");
+
+    // copy everything over
+    hr = ::StringCchCopyW(psss->wzKey, countof(psss->wzKey), psssScript->wzKey);
+    ExitOnFailure(hr, "Failed to copy key string to sqlstr object");
+    hr = ::StringCchCopyW(psss->wzSqlDb, countof(psss->wzSqlDb), psssScript->wzSqlDb);
+    ExitOnFailure(hr, "Failed to copy DB string to sqlstr object");
+    hr = ::StringCchCopyW(psss->wzComponent, countof(psss->wzComponent), psssScript->wzComponent);
+    ExitOnFailure(hr, "Failed to copy component string to sqlstr object");
+    psss->isInstalled = psssScript->isInstalled;
+    psss->isAction = psssScript->isAction;
+    psss->iAttributes = psssScript->iAttributes;
+    psss->iSequence = psssScript->iSequence;
+
+    // "GO [count]" executes the batch count times, which is done when the string is executed
+    psss->cRepeat = cRepeat;
+
+    hr = StrAllocString(&psss->pwzSql, wzBatch, cchBatch);
+    ExitOnFailure(hr, "Failed to allocate string for SQL script: '%ls'", psss->wzKey);
+
+    // tabs have always been replaced with spaces
+    for (SIZE_T i = 0; i < cchBatch; ++i)
+    {
+        if (L'\t' == psss->pwzSql[i])
+        {
+            psss->pwzSql[i] = L' ';
+        }
+    }
+
+    AddSqlStrToList(pContext->ppsssList, pContext->ppsssTail, psss);
+    psss = NULL; // set the db NULL so it doesn't accidentally get freed below
+
+LExit:
+    // if anything was left over after an error clean it all up
+    if (psss)
+    {
+        ScaSqlStrsFreeList(psss);
+    }
+
+    return hr;
+}
+
+
+static SCA_SQLSTR* FindSqlStrListTail(
+    __in_opt SCA_SQLSTR* psssList
+    )
+{
+    SCA_SQLSTR* psssTail = psssList;
+
+    while (psssTail && psssTail->psssNext)
+    {
+        psssTail = psssTail->psssNext;
+    }
+
+    return psssTail;
+}
+
+
+static void AddSqlStrToList(
+    __inout SCA_SQLSTR** ppsssList,
+    __inout SCA_SQLSTR** ppsssTail,
+    __in SCA_SQLSTR* psss
+    )
+{
+    Assert(psss); //just checking
+
+    //make certain we have a valid sequence number; note that negatives are technically valid
+    if (MSI_NULL_INTEGER == psss->iSequence)
+    {
+        psss->iSequence = 0;
+    }
+
+    //append to the end of the list; SortSqlStrList() puts the list in Sequence order
+    //once everything has been read so adding an element never walks the list
+    psss->psssNext = NULL;
+
+    if (*ppsssTail)
+    {
+        (*ppsssTail)->psssNext = psss;
+    }
     else
     {
-        psssList = psss;
+        *ppsssList = psss;
     }
 
-    return psssList;
+    *ppsssTail = psss;
+}
+
+
+static SCA_SQLSTR* SortSqlStrList(
+    __in_opt SCA_SQLSTR* psssList
+    )
+{
+    // Bottom-up merge sort of the list by Sequence. The merge is stable so that if Sequence
+    // numbers are duplicated, as in the case of a sqlscript split on "GO", the elements stay
+    // in the order they were added and the sqlfile stays in order.
+    SCA_SQLSTR* psssSorted = psssList;
+    DWORD cRun = 1;
+    DWORD cMerges = 0;
+
+    do
+    {
+        SCA_SQLSTR* psssLeft = psssSorted;
+        SCA_SQLSTR* psssTail = NULL;
+
+        psssSorted = NULL;
+        cMerges = 0;
+
+        while (psssLeft)
+        {
+            SCA_SQLSTR* psssRight = psssLeft;
+            DWORD cLeft = 0;
+            DWORD cRight = cRun;
+
+            ++cMerges;
+
+            // split off a run of up to cRun elements on the left
+            while (psssRight && cLeft < cRun)
+            {
+                psssRight = psssRight->psssNext;
+                ++cLeft;
+            }
+
+            // merge the left run with the following run of up to cRun elements
+            while (cLeft || (cRight && psssRight))
+            {
+                SCA_SQLSTR* psssNext = NULL;
+
+                if (!cLeft)
+                {
+                    psssNext = psssRight;
+                    psssRight = psssRight->psssNext;
+                    --cRight;
+                }
+                else if (!cRight || !psssRight || psssLeft->iSequence <= psssRight->iSequence)
+                {
+                    psssNext = psssLeft;
+                    psssLeft = psssLeft->psssNext;
+                    --cLeft;
+                }
+                else
+                {
+                    psssNext = psssRight;
+                    psssRight = psssRight->psssNext;
+                    --cRight;
+                }
+
+                if (psssTail)
+                {
+                    psssTail->psssNext = psssNext;
+                }
+                else
+                {
+                    psssSorted = psssNext;
+                }
+
+                psssTail = psssNext;
+            }
+
+            psssLeft = psssRight;
+        }
+
+        if (psssTail)
+        {
+            psssTail->psssNext = NULL;
+        }
+
+        cRun *= 2;
+    } while (1 < cMerges);
+
+    return psssSorted;
 }
 
 
@@ -697,7 +791,7 @@ static HRESULT ExecuteStrings(
                 wzOldDb = psss->wzSqlDb;
             }
 
-            WcaLog(LOGMSG_VERBOSE, "Scheduling SQL string: %ls", psss->pwzSql);
+            WcaLog(LOGMSG_VERBOSE, "Scheduling SQL string (%u times): %ls", psss->cRepeat, psss->pwzSql);
 
             hr = WcaWriteStringToCaData(psss->wzKey, &pwzCustomActionData);
             ExitOnFailure(hr, "Failed to add SQL Key to CustomActionData for SQL string: %ls", psss->wzKey);
@@ -705,6 +799,9 @@ static HRESULT ExecuteStrings(
             hr = WcaWriteIntegerToCaData(psss->iAttributes, &pwzCustomActionData);
             ExitOnFailure(hr, "failed to add attributes to CustomActionData for SQL string: %ls", psss->wzKey);
 
+            hr = WcaWriteIntegerToCaData(static_cast<int>(psss->cRepeat), &pwzCustomActionData);
+            ExitOnFailure(hr, "failed to add repeat count to CustomActionData for SQL string: %ls", psss->wzKey);
+
             hr = WcaWriteStringToCaData(psss->pwzSql, &pwzCustomActionData);
             ExitOnFailure(hr, "Failed to to add SQL Query to CustomActionData for SQL string: %ls", psss->wzKey);
             uiCost += COST_SQL_STRING;
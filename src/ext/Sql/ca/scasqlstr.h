@@ -17,6 +17,7 @@ struct SCA_SQLSTR
     SCA_USER scau;
 
     LPWSTR pwzSql;
+    DWORD cRepeat; // number of times to execute pwzSql, from "GO [count]" in scripts
     int iAttributes;
     int iSequence; //used to sequence Wix4SqlString and Wix4SqlScript tables together
 
@@ -13,6 +13,7 @@ msbuild -Restore -p:Configuration=%_C% || exit /b
 
 :: Test
 dotnet test -c %_C% --no-build test\WixToolsetTest.Sql || exit /b
+dotnet test ..\..\..\build\Sql.wixext\%_C%\x86\SqlCaUnitTest.dll || exit /b
 
 :: Pack
 msbuild -t:Pack -p:Configuration=%_C% -p:NoBuild=true wixext\WixToolset.Sql.wixext.csproj || exit /b
@@ -0,0 +1,216 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixInternal::TestSupport;
+using namespace WixInternal::TestSupport::XunitExtensions;
+
+struct SQL_SCRIPT_TEST_BATCH
+{
+    WCHAR wzBatch[128];
+    DWORD cRepeat;
+};
+
+static DWORD SqlScriptTest_Split(
+    __in_z LPCWSTR wzScript,
+    __in SIZE_T cchPiece,
+    __out_ecount(cBatchesMax) SQL_SCRIPT_TEST_BATCH* rgBatches,
+    __in DWORD cBatchesMax
+    );
+static void SqlScriptTest_AssertBatches(
+    __in_z LPCWSTR wzScript,
+    __in DWORD cExpected,
+    __in_ecount_opt(cExpected) LPCWSTR* rgwzExpected,
+    __in_ecount_opt(cExpected) DWORD* rgcExpectedRepeat
+    );
+
+namespace SqlCaUnitTest
+{
+    public ref class SqlScript
+    {
+    public:
+        [Fact]
+        void SqlScriptIgnoresGoInStringsAndComments()
+        {
+            LPCWSTR rgwzExpected[] =
+            {
+                L"select 'GO' as [GO], \"GO\" as [a]]GO]",
+                L"select 1 -- GO",
+                L"select 2 /* a /* GO */\nGO\n*/",
+                L"select 'it''s\nGO\n'",
+            };
+            DWORD rgcExpectedRepeat[] = { 1, 1, 1, 1 };
+
+            SqlScriptTest_AssertBatches(
+                L"select 'GO' as [GO], \"GO\" as [a]]GO]\n"
+                L"GO\n"
+                L"select 1 -- GO\n"
+                L"GO\n"
+                L"-- GO\n"
+                L"/* GO\nGO */\n"
+                L"select 2 /* a /* GO */\nGO\n*/\n"
+                L"GO\n"
+                L"select 'it''s\nGO\n'\n"
+                L"GO\n",
+                _countof(rgwzExpected), rgwzExpected, rgcExpectedRepeat);
+        }
+
+        [Fact]
+        void SqlScriptUsesGoRepeatCount()
+        {
+            LPCWSTR rgwzExpected[] =
+            {
+                L"insert into t values (1)",
+                L"select 2",
+                L"select 4",
+                L"99999999999",
+            };
+            DWORD rgcExpectedRepeat[] = { 5, 3, 1, 1 };
+
+            SqlScriptTest_AssertBatches(
+                L"insert into t values (1)\n"
+                L"GO 5\n"
+                L"select 2\n"
+                L"go\t3\r\n"
+                L"select 3\n"
+                L"GO 0\n"
+                L"select 4\n"
+                L"GO 99999999999\n", // too big to be a count so it is the next batch
+                _countof(rgwzExpected), rgwzExpected, rgcExpectedRepeat);
+        }
+
+        [Fact]
+        void SqlScriptStartsNextBatchWithTextAfterGo()
+        {
+            LPCWSTR rgwzExpected[] =
+            {
+                L"select 1",
+                L"select 2",
+                L"select 3",
+                L"12x",
+                L"select ago\nGOTO x\nx: select 4",
+            };
+            DWORD rgcExpectedRepeat[] = { 1, 5, 1, 1, 1 };
+
+            SqlScriptTest_AssertBatches(
+                L"select 1 GO select 2\n"
+                L"GO 5 select 3\n"
+                L"GO 12x\n"
+                L"GO\n"
+                L"select ago\n"
+                L"GOTO x\n"
+                L"x: select 4\n",
+                _countof(rgwzExpected), rgwzExpected, rgcExpectedRepeat);
+        }
+
+        [Fact]
+        void SqlScriptFindsGoAfterCommentEnd()
+        {
+            LPCWSTR rgwzExpected[] =
+            {
+                L"select 1 /* c */",
+                L"select 2--c",
+                L"select 3",
+            };
+            DWORD rgcExpectedRepeat[] = { 1, 2, 1 };
+
+            SqlScriptTest_AssertBatches(
+                L"select 1 /* c */GO\n"
+                L"/* c */GO select 2--c\n"
+                L"GO 2--c\n"
+                L"select 3",
+                _countof(rgwzExpected), rgwzExpected, rgcExpectedRepeat);
+        }
+
+        [Fact]
+        void SqlScriptWithoutFinalGo()
+        {
+            LPCWSTR rgwzExpected[] =
+            {
+                L"select 1",
+                L"select\t2",
+            };
+            DWORD rgcExpectedRepeat[] = { 1, 1 };
+
+            SqlScriptTest_AssertBatches(
+                L"  \r\n-- header\nselect 1\nGO\n\tselect\t2  \r\n",
+                _countof(rgwzExpected), rgwzExpected, rgcExpectedRepeat);
+
+            SqlScriptTest_AssertBatches(L"", 0, NULL, NULL);
+            SqlScriptTest_AssertBatches(L"-- nothing\n/* here */\r\nGO\n", 0, NULL, NULL);
+        }
+    };
+}
+
+
+static DWORD SqlScriptTest_Split(
+    __in_z LPCWSTR wzScript,
+    __in SIZE_T cchPiece,
+    __out_ecount(cBatchesMax) SQL_SCRIPT_TEST_BATCH* rgBatches,
+    __in DWORD cBatchesMax
+    )
+{
+    HRESULT hr = S_OK;
+    SCA_SQLSCRIPT_TOKENIZER tokenizer = { };
+    SCA_SQLSCRIPT_BATCH batch = { };
+    SIZE_T cchScript = lstrlenW(wzScript);
+    SIZE_T cchAvailable = 0;
+    SIZE_T ichBase = 0;
+    BOOL fFinal = FALSE;
+    DWORD cBatches = 0;
+
+    ScaSqlScriptTokenizerInitialize(&tokenizer);
+
+    // hand the script over a piece at a time and drop what the scanner no longer needs, like the custom action does
+    do
+    {
+        cchAvailable = min(cchAvailable + cchPiece, cchScript);
+        fFinal = cchAvailable == cchScript;
+
+        while (ScaSqlScriptNextBatch(&tokenizer, wzScript + ichBase, cchAvailable - ichBase, fFinal, &batch))
+        {
+            Assert::True(cBatches < cBatchesMax);
+
+            hr = ::StringCchCopyNW(rgBatches[cBatches].wzBatch, _countof(rgBatches[cBatches].wzBatch), wzScript + ichBase + batch.ichStart, batch.cchBatch);
+            NativeAssert::Succeeded(hr, "Failed to copy batch {0}.", cBatches);
+
+            rgBatches[cBatches].cRepeat = batch.cRepeat;
+            ++cBatches;
+        }
+
+        ichBase += tokenizer.ichBatch;
+        ScaSqlScriptTokenizerDiscard(&tokenizer, tokenizer.ichBatch);
+    } while (!fFinal);
+
+    return cBatches;
+}
+
+
+static void SqlScriptTest_AssertBatches(
+    __in_z LPCWSTR wzScript,
+    __in DWORD cExpected,
+    __in_ecount_opt(cExpected) LPCWSTR* rgwzExpected,
+    __in_ecount_opt(cExpected) DWORD* rgcExpectedRepeat
+    )
+{
+    SQL_SCRIPT_TEST_BATCH rgBatches[8] = { };
+    SIZE_T cchScript = lstrlenW(wzScript);
+    SIZE_T rgcchPieces[] = { cchScript ? cchScript : 1, 1, 2 };
+    DWORD cBatches = 0;
+
+    // the same batches must be found no matter how the script is split up when it is read
+    for (DWORD i = 0; i < _countof(rgcchPieces); ++i)
+    {
+        cBatches = SqlScriptTest_Split(wzScript, rgcchPieces[i], rgBatches, _countof(rgBatches));
+
+        Assert::Equal<DWORD>(cExpected, cBatches);
+
+        for (DWORD j = 0; j < cBatches; ++j)
+        {
+            NativeAssert::StringEqual(rgwzExpected[j], rgBatches[j].wzBatch);
+            Assert::Equal<DWORD>(rgcExpectedRepeat[j], rgBatches[j].cRepeat);
+        }
+    }
+}
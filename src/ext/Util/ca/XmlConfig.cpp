@@ -334,13 +334,65 @@ LExit:
 }
 
 
+static void GroupXmlConfigChangesByFile(
+    __inout XML_CONFIG_CHANGE** ppxfcHead
+    )
+{
+    XML_CONFIG_CHANGE* pxfc = NULL;
+    XML_CONFIG_CHANGE* pxfcCheck = NULL;
+    XML_CONFIG_CHANGE* pxfcCheckNext = NULL;
+
+    // Move later changes to a file up behind the earlier changes to the same file so each file is only loaded, saved,
+    // and captured for rollback once. The relative order of the changes to a single file does not change.
+    for (pxfc = *ppxfcHead; pxfc; pxfc = pxfc->pxfcNext)
+    {
+        if (!pxfc->pxfcNext || 0 == lstrcmpiW(pxfc->wzFile, pxfc->pxfcNext->wzFile))
+        {
+            continue;
+        }
+
+        for (pxfcCheck = pxfc->pxfcNext; pxfcCheck; pxfcCheck = pxfcCheckNext)
+        {
+            pxfcCheckNext = pxfcCheck->pxfcNext;
+
+            if (0 == lstrcmpiW(pxfc->wzFile, pxfcCheck->wzFile))
+            {
+                // Unlink the change...
+                pxfcCheck->pxfcPrev->pxfcNext = pxfcCheck->pxfcNext;
+                if (pxfcCheck->pxfcNext)
+                {
+                    pxfcCheck->pxfcNext->pxfcPrev = pxfcCheck->pxfcPrev;
+                }
+
+                // ...and link it back in after the last change seen for the file.
+                pxfcCheck->pxfcPrev = pxfc;
+                pxfcCheck->pxfcNext = pxfc->pxfcNext;
+                pxfc->pxfcNext->pxfcPrev = pxfcCheck;
+                pxfc->pxfcNext = pxfcCheck;
+
+                pxfc = pxfcCheck;
+            }
+        }
+    }
+}
+
+
+static BOOL IsReusableElementPath(
+    __in_z LPCWSTR wzElementPath
+    )
+{
+    // Without predicates or functions a path selects the same node until elements are added or removed.
+    return NULL == wcspbrk(wzElementPath, L"[(");
+}
+
+
 static HRESULT BeginChangeFile(
     __in LPCWSTR pwzFile,
     __in int iCompAttributes,
-    __inout LPWSTR* ppwzCustomActionData
+    __inout WCA_CADATA_BUILDER* pCustomActionData
     )
 {
-    Assert(pwzFile && *pwzFile && ppwzCustomActionData);
+    Assert(pwzFile && *pwzFile && pCustomActionData);
 
     HRESULT hr = S_OK;
     BOOL fIs64Bit = iCompAttributes & msidbComponentAttributes64bit;
@@ -348,20 +400,20 @@ static HRESULT BeginChangeFile(
     LPBYTE pbData = NULL;
     SIZE_T cbData = 0;
 
-    LPWSTR pwzRollbackCustomActionData = NULL;
+    WCA_CADATA_BUILDER rollbackCustomActionData = { };
 
     if (fIs64Bit)
     {
-        hr = WcaWriteIntegerToCaData((int)xaOpenFilex64, ppwzCustomActionData);
+        hr = WcaCaDataBuilderWriteInteger(pCustomActionData, (int)xaOpenFilex64);
         ExitOnFailure(hr, "failed to write 64-bit file indicator to custom action data");
     }
     else
     {
-        hr = WcaWriteIntegerToCaData((int)xaOpenFile, ppwzCustomActionData);
+        hr = WcaCaDataBuilderWriteInteger(pCustomActionData, (int)xaOpenFile);
         ExitOnFailure(hr, "failed to write file indicator to custom action data");
     }
 
-    hr = WcaWriteStringToCaData(pwzFile, ppwzCustomActionData);
+    hr = WcaCaDataBuilderWriteString(pCustomActionData, pwzFile);
     ExitOnFailure(hr, "failed to write file to custom action data: %ls", pwzFile);
 
     // If the file already exits, then we have to put it back the way it was on failure
@@ -371,21 +423,20 @@ static HRESULT BeginChangeFile(
         ExitOnFailure(hr, "failed to read file: %ls", pwzFile);
 
         // Set up the rollback for this file
-        hr = WcaWriteIntegerToCaData((int)fIs64Bit, &pwzRollbackCustomActionData);
+        hr = WcaCaDataBuilderWriteInteger(&rollbackCustomActionData, (int)fIs64Bit);
         ExitOnFailure(hr, "failed to write component bitness to rollback custom action data");
 
-        hr = WcaWriteStringToCaData(pwzFile, &pwzRollbackCustomActionData);
+        hr = WcaCaDataBuilderWriteString(&rollbackCustomActionData, pwzFile);
         ExitOnFailure(hr, "failed to write file name to rollback custom action data: %ls", pwzFile);
 
-        hr = WcaWriteStreamToCaData(pbData, cbData, &pwzRollbackCustomActionData);
+        hr = WcaCaDataBuilderWriteStream(&rollbackCustomActionData, pbData, cbData);
         ExitOnFailure(hr, "failed to write file contents to rollback custom action data.");
 
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlConfigRollback"), pwzRollbackCustomActionData, COST_XMLFILE);
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlConfigRollback"), rollbackCustomActionData.pwzData, COST_XMLFILE);
         ExitOnFailure(hr, "failed to schedule ExecXmlConfigRollback for file: %ls", pwzFile);
-
-        ReleaseStr(pwzRollbackCustomActionData);
     }
 LExit:
+    WcaCaDataBuilderUninitialize(&rollbackCustomActionData);
     ReleaseMem(pbData);
 
     return hr;
@@ -395,30 +446,30 @@ LExit:
 static HRESULT WriteChangeData(
     __in XML_CONFIG_CHANGE* pxfc,
     __in eXmlAction action,
-    __inout LPWSTR* ppwzCustomActionData
+    __inout WCA_CADATA_BUILDER* pCustomActionData
     )
 {
-    Assert(pxfc && ppwzCustomActionData);
+    Assert(pxfc && pCustomActionData);
 
     HRESULT hr = S_OK;
     XML_CONFIG_CHANGE* pxfcAdditionalChanges = NULL;
     LPCWSTR wzElementPath = pxfc->pwzElementId ? pxfc->pwzElementId : pxfc->pwzElementPath;
 
-    hr = WcaWriteStringToCaData(wzElementPath, ppwzCustomActionData);
+    hr = WcaCaDataBuilderWriteString(pCustomActionData, wzElementPath);
     ExitOnFailure(hr, "failed to write ElementPath to custom action data: %ls", wzElementPath);
 
-    hr = WcaWriteStringToCaData(pxfc->pwzVerifyPath, ppwzCustomActionData);
+    hr = WcaCaDataBuilderWriteString(pCustomActionData, pxfc->pwzVerifyPath);
     ExitOnFailure(hr, "failed to write VerifyPath to custom action data: %ls", pxfc->pwzVerifyPath);
 
-    hr = WcaWriteStringToCaData(pxfc->wzName, ppwzCustomActionData);
+    hr = WcaCaDataBuilderWriteString(pCustomActionData, pxfc->wzName);
     ExitOnFailure(hr, "failed to write Name to custom action data: %ls", pxfc->wzName);
 
-    hr = WcaWriteStringToCaData(pxfc->pwzValue, ppwzCustomActionData);
+    hr = WcaCaDataBuilderWriteString(pCustomActionData, pxfc->pwzValue);
     ExitOnFailure(hr, "failed to write Value to custom action data: %ls", pxfc->pwzValue);
 
     if (pxfc->iXmlFlags & XMLCONFIG_CREATE && pxfc->iXmlFlags & XMLCONFIG_ELEMENT && xaCreateElement == action && pxfc->pxfcAdditionalChanges)
     {
-        hr = WcaWriteIntegerToCaData(pxfc->cAdditionalChanges, ppwzCustomActionData);
+        hr = WcaCaDataBuilderWriteInteger(pCustomActionData, pxfc->cAdditionalChanges);
         ExitOnFailure(hr, "failed to write additional changes value to custom action data");
 
         pxfcAdditionalChanges = pxfc->pxfcAdditionalChanges;
@@ -426,10 +477,10 @@ static HRESULT WriteChangeData(
         {
             Assert((0 == lstrcmpW(pxfcAdditionalChanges->wzComponent, pxfc->wzComponent)) && 0 == pxfcAdditionalChanges->iXmlFlags && (0 == lstrcmpW(pxfcAdditionalChanges->wzFile, pxfc->wzFile)));
 
-            hr = WcaWriteStringToCaData(pxfcAdditionalChanges->wzName, ppwzCustomActionData);
+            hr = WcaCaDataBuilderWriteString(pCustomActionData, pxfcAdditionalChanges->wzName);
             ExitOnFailure(hr, "failed to write Name to custom action data: %ls", pxfc->wzName);
 
-            hr = WcaWriteStringToCaData(pxfcAdditionalChanges->pwzValue, ppwzCustomActionData);
+            hr = WcaCaDataBuilderWriteString(pCustomActionData, pxfcAdditionalChanges->pwzValue);
             ExitOnFailure(hr, "failed to write Value to custom action data: %ls", pxfc->pwzValue);
 
             pxfcAdditionalChanges = pxfcAdditionalChanges->pxfcNext;
@@ -437,7 +488,7 @@ static HRESULT WriteChangeData(
     }
     else
     {
-        hr = WcaWriteIntegerToCaData(0, ppwzCustomActionData);
+        hr = WcaCaDataBuilderWriteInteger(pCustomActionData, 0);
         ExitOnFailure(hr, "failed to write additional changes value to custom action data");
     }
 
@@ -472,7 +523,7 @@ extern "C" UINT __stdcall SchedXmlConfig(
     eXmlAction xa = xaUnknown;
     eXmlPreserveDate xd;
 
-    LPWSTR pwzCustomActionData = NULL;
+    WCA_CADATA_BUILDER customActionData = { };
 
     DWORD cFiles = 0;
 
@@ -486,11 +537,13 @@ extern "C" UINT __stdcall SchedXmlConfig(
     hr = ProcessChanges(&pxfcHead);
     ExitOnFailure(hr, "failed to process Wix4XmlConfig changes");
 
+    GroupXmlConfigChangesByFile(&pxfcHead);
+
     // loop through all the xml configurations
     for (pxfc = pxfcHead; pxfc; pxfc = pxfc->pxfcNext)
     {
         // If this is a different file, or the first file...
-        if (NULL == pwzCurrentFile || 0 != lstrcmpW(pwzCurrentFile, pxfc->wzFile))
+        if (NULL == pwzCurrentFile || 0 != lstrcmpiW(pwzCurrentFile, pxfc->wzFile))
         {
             // Remember the file we're currently working on
             hr = StrAllocString(&pwzCurrentFile, pxfc->wzFile, 0);
@@ -549,20 +602,20 @@ extern "C" UINT __stdcall SchedXmlConfig(
         {
             if (fCurrentFileChanged)
             {
-                hr = BeginChangeFile(pwzCurrentFile, pxfc->iCompAttributes, &pwzCustomActionData);
+                hr = BeginChangeFile(pwzCurrentFile, pxfc->iCompAttributes, &customActionData);
                 ExitOnFailure(hr, "failed to begin file change for file: %ls", pwzCurrentFile);
 
                 fCurrentFileChanged = FALSE;
                 ++cFiles;
             }
 
-            hr = WcaWriteIntegerToCaData((int)xa, &pwzCustomActionData);
+            hr = WcaCaDataBuilderWriteInteger(&customActionData, (int)xa);
             ExitOnFailure(hr, "failed to write action indicator custom action data");
 
-            hr = WcaWriteIntegerToCaData((int)xd, &pwzCustomActionData);
+            hr = WcaCaDataBuilderWriteInteger(&customActionData, (int)xd);
             ExitOnFailure(hr, "failed to write Preserve Date indicator to custom action data");
 
-            hr = WriteChangeData(pxfc, xa, &pwzCustomActionData);
+            hr = WriteChangeData(pxfc, xa, &customActionData);
             ExitOnFailure(hr, "failed to write change data");
         }
     }
@@ -575,17 +628,17 @@ extern "C" UINT __stdcall SchedXmlConfig(
     ExitOnFailure(hr, "failed while looping through all objects to secure");
 
     // Schedule the custom action and add to progress bar
-    if (pwzCustomActionData && *pwzCustomActionData)
+    if (customActionData.cchData)
     {
         Assert(0 < cFiles);
 
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlConfig"), pwzCustomActionData, cFiles * COST_XMLFILE);
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlConfig"), customActionData.pwzData, cFiles * COST_XMLFILE);
         ExitOnFailure(hr, "failed to schedule ExecXmlConfig action");
     }
 
 LExit:
     ReleaseStr(pwzCurrentFile);
-    ReleaseStr(pwzCustomActionData);
+    WcaCaDataBuilderUninitialize(&customActionData);
 
     FreeXmlConfigChangeList(pxfcHead);
 
@@ -619,10 +672,11 @@ extern "C" UINT __stdcall ExecXmlConfig(
     LPWSTR pwzData = NULL;
     LPWSTR pwzFile = NULL;
     LPWSTR pwzElementPath = NULL;
+    LPWSTR pwzSelectedElementPath = NULL;
     LPWSTR pwzVerifyPath = NULL;
     LPWSTR pwzName = NULL;
     LPWSTR pwzValue = NULL;
-    LPWSTR pwz = NULL;
+    WCA_CADATA_READER reader = { };
     int cAdditionalChanges = 0;
 
     IXMLDOMDocument* pixd = NULL;
@@ -653,9 +707,9 @@ extern "C" UINT __stdcall ExecXmlConfig(
 
     WcaLog(LOGMSG_TRACEONLY, "CustomActionData: %ls", pwzCustomActionData);
 
-    pwz = pwzCustomActionData;
+    WcaCaDataReaderInitialize(&reader, pwzCustomActionData);
 
-    hr = WcaReadIntegerFromCaData(&pwz, (int*) &xa);
+    hr = WcaCaDataReaderReadInteger(&reader, (int*) &xa);
     ExitOnFailure(hr, "failed to process CustomActionData");
 
 #ifndef _WIN64
@@ -671,15 +725,17 @@ extern "C" UINT __stdcall ExecXmlConfig(
     }
 
     // loop through all the passed in data
-    while (pwz && *pwz)
+    while (WcaCaDataReaderHasMore(&reader))
     {
-        hr = WcaReadStringFromCaData(&pwz, &pwzFile);
+        hr = WcaCaDataReaderReadString(&reader, &pwzFile);
         ExitOnFailure(hr, "failed to read file name from custom action data");
 
         // Default to not preserve date, preserve it if any modifications require us to
         fPreserveDate = FALSE;
 
         // Open the file
+        ReleaseNullObject(pixn);
+        ReleaseNullStr(pwzSelectedElementPath);
         ReleaseNullObject(pixd);
 
 #ifndef _WIN64
@@ -712,7 +768,7 @@ extern "C" UINT __stdcall ExecXmlConfig(
 
         WcaLog(LOGMSG_VERBOSE, "Configuring Xml File: %ls", pwzFile);
 
-        while (pwz && *pwz)
+        while (WcaCaDataReaderHasMore(&reader))
         {
             // If we skip past an element that has additional changes we need to strip them off the stream before
             // moving on to the next element. Do that now and then restart the outer loop.
@@ -720,9 +776,9 @@ extern "C" UINT __stdcall ExecXmlConfig(
             {
                 while (cAdditionalChanges > 0)
                 {
-                    hr = WcaReadStringFromCaData(&pwz, &pwzName);
+                    hr = WcaCaDataReaderReadString(&reader, &pwzName);
                     ExitOnFailure(hr, "failed to process CustomActionData");
-                    hr = WcaReadStringFromCaData(&pwz, &pwzValue);
+                    hr = WcaCaDataReaderReadString(&reader, &pwzValue);
                     ExitOnFailure(hr, "failed to process CustomActionData");
 
                     cAdditionalChanges--;
@@ -730,7 +786,7 @@ extern "C" UINT __stdcall ExecXmlConfig(
                 continue;
             }
 
-            hr = WcaReadIntegerFromCaData(&pwz, (int*) &xa);
+            hr = WcaCaDataReaderReadInteger(&reader, (int*) &xa);
             ExitOnFailure(hr, "failed to process CustomActionData");
 
             // Break if we need to move on to a different file
@@ -739,7 +795,7 @@ extern "C" UINT __stdcall ExecXmlConfig(
                 break;
             }
 
-            hr = WcaReadIntegerFromCaData(&pwz, (int*) &xd);
+            hr = WcaCaDataReaderReadInteger(&reader, (int*) &xd);
             ExitOnFailure(hr, "failed to process CustomActionData");
 
             if (xdPreserve == xd)
@@ -748,15 +804,15 @@ extern "C" UINT __stdcall ExecXmlConfig(
             }
 
             // Get path, name, and value to be written
-            hr = WcaReadStringFromCaData(&pwz, &pwzElementPath);
+            hr = WcaCaDataReaderReadString(&reader, &pwzElementPath);
             ExitOnFailure(hr, "failed to process CustomActionData");
-            hr = WcaReadStringFromCaData(&pwz, &pwzVerifyPath);
+            hr = WcaCaDataReaderReadString(&reader, &pwzVerifyPath);
             ExitOnFailure(hr, "failed to process CustomActionData");
-            hr = WcaReadStringFromCaData(&pwz, &pwzName);
+            hr = WcaCaDataReaderReadString(&reader, &pwzName);
             ExitOnFailure(hr, "failed to process CustomActionData");
-            hr = WcaReadStringFromCaData(&pwz, &pwzValue);
+            hr = WcaCaDataReaderReadString(&reader, &pwzValue);
             ExitOnFailure(hr, "failed to process CustomActionData");
-            hr = WcaReadIntegerFromCaData(&pwz, &cAdditionalChanges);
+            hr = WcaCaDataReaderReadInteger(&reader, &cAdditionalChanges);
             ExitOnFailure(hr, "failed to process CustomActionData");
 
             // If we failed to open the file and we're adding something to the file, we've got a problem.  Otherwise, just continue on since the file's already gone.
@@ -772,26 +828,42 @@ extern "C" UINT __stdcall ExecXmlConfig(
                 }
             }
 
-            // Select the node we're about to modify
-            ReleaseNullObject(pixn);
+            // Select the node we're about to modify, unless the previous change already selected it
+            if (!pixn || !pwzSelectedElementPath || 0 != lstrcmpW(pwzSelectedElementPath, pwzElementPath))
+            {
+                ReleaseNullObject(pixn);
+                ReleaseNullStr(pwzSelectedElementPath);
 
-            hr = XmlSelectSingleNode(pixd, pwzElementPath, &pixn);
+                hr = XmlSelectSingleNode(pixd, pwzElementPath, &pixn);
 
-            // If we failed to find the node that we are going to add to, we've got a problem. Otherwise, just continue since the node's already gone.
-            if (S_FALSE == hr)
-            {
-                if (xaCreateElement == xa || xaWriteValue == xa || xaWriteDocument == xa)
+                // If we failed to find the node that we are going to add to, we've got a problem. Otherwise, just continue since the node's already gone.
+                if (S_FALSE == hr)
                 {
-                    hr = HRESULT_FROM_WIN32(ERROR_OBJECT_NOT_FOUND);
+                    if (xaCreateElement == xa || xaWriteValue == xa || xaWriteDocument == xa)
+                    {
+                        hr = HRESULT_FROM_WIN32(ERROR_OBJECT_NOT_FOUND);
+                    }
+                    else
+                    {
+                        hr = S_OK;
+                        continue;
+                    }
                 }
-                else
+
+                MessageExitOnFailure(hr, msierrXmlConfigFailedSelect, "failed to find node: %ls in XML file: %ls", pwzElementPath, pwzFile);
+
+                if (IsReusableElementPath(pwzElementPath))
                 {
-                    hr = S_OK;
-                    continue;
+                    hr = StrAllocString(&pwzSelectedElementPath, pwzElementPath, 0);
+                    ExitOnFailure(hr, "failed to copy element path");
                 }
             }
 
-            MessageExitOnFailure(hr, msierrXmlConfigFailedSelect, "failed to find node: %ls in XML file: %ls", pwzElementPath, pwzFile);
+            // Adding or removing elements may change the node the path selects
+            if (xaCreateElement == xa || xaDeleteElement == xa || xaWriteDocument == xa)
+            {
+                ReleaseNullStr(pwzSelectedElementPath);
+            }
 
             // Make the modification
             switch (xa)
@@ -858,9 +930,9 @@ extern "C" UINT __stdcall ExecXmlConfig(
 
                 while (cAdditionalChanges > 0)
                 {
-                    hr = WcaReadStringFromCaData(&pwz, &pwzName);
+                    hr = WcaCaDataReaderReadString(&reader, &pwzName);
                     ExitOnFailure(hr, "failed to process CustomActionData");
-                    hr = WcaReadStringFromCaData(&pwz, &pwzValue);
+                    hr = WcaCaDataReaderReadString(&reader, &pwzValue);
                     ExitOnFailure(hr, "failed to process CustomActionData");
 
                     // Set the additional attribute
@@ -997,6 +1069,7 @@ LExit:
     ReleaseStr(pwzData);
     ReleaseStr(pwzFile);
     ReleaseStr(pwzElementPath);
+    ReleaseStr(pwzSelectedElementPath);
     ReleaseStr(pwzVerifyPath);
     ReleaseStr(pwzName);
     ReleaseStr(pwzValue);
@@ -1037,7 +1110,7 @@ extern "C" UINT __stdcall ExecXmlConfigRollback(
 #endif
 
     LPWSTR pwzCustomActionData = NULL;
-    LPWSTR pwz = NULL;
+    WCA_CADATA_READER reader = { };
     LPWSTR pwzFileName = NULL;
     LPBYTE pbData = NULL;
     DWORD_PTR cbData = 0;
@@ -1056,15 +1129,15 @@ extern "C" UINT __stdcall ExecXmlConfigRollback(
 
     WcaLog(LOGMSG_TRACEONLY, "CustomActionData: %ls", pwzCustomActionData);
 
-    pwz = pwzCustomActionData;
+    WcaCaDataReaderInitialize(&reader, pwzCustomActionData);
 
-    hr = WcaReadIntegerFromCaData(&pwz, &iIs64Bit);
+    hr = WcaCaDataReaderReadInteger(&reader, &iIs64Bit);
     ExitOnFailure(hr, "failed to read component bitness from custom action data");
 
-    hr = WcaReadStringFromCaData(&pwz, &pwzFileName);
+    hr = WcaCaDataReaderReadString(&reader, &pwzFileName);
     ExitOnFailure(hr, "failed to read file name from custom action data");
 
-    hr = WcaReadStreamFromCaData(&pwz, &pbData, &cbData);
+    hr = WcaCaDataReaderReadStream(&reader, &pbData, &cbData);
     ExitOnFailure(hr, "failed to read file contents from custom action data");
 
 #ifndef _WIN64
@@ -114,6 +114,57 @@ LExit:
 }
 
 
+static void GroupXmlFileChangesByFile(
+    __inout XML_FILE_CHANGE** ppxfcHead,
+    __inout XML_FILE_CHANGE** ppxfcTail
+    )
+{
+    XML_FILE_CHANGE* pxfc = NULL;
+    XML_FILE_CHANGE* pxfcCheck = NULL;
+    XML_FILE_CHANGE* pxfcCheckNext = NULL;
+
+    // The table is ordered by the unformatted File column, so different components can target the same
+    // file without their changes being next to each other. Move every later change for a file up behind
+    // the last change already grouped for it, keeping their order, so each file is only changed once.
+    for (pxfc = *ppxfcHead; pxfc; pxfc = pxfc->pxfcNext)
+    {
+        if (pxfc->pxfcNext && 0 == lstrcmpiW(pxfc->wzFile, pxfc->pxfcNext->wzFile))
+        {
+            continue;
+        }
+
+        for (pxfcCheck = pxfc->pxfcNext; pxfcCheck; pxfcCheck = pxfcCheckNext)
+        {
+            pxfcCheckNext = pxfcCheck->pxfcNext;
+
+            if (0 != lstrcmpiW(pxfc->wzFile, pxfcCheck->wzFile))
+            {
+                continue;
+            }
+
+            // Take it out of the list...
+            pxfcCheck->pxfcPrev->pxfcNext = pxfcCheck->pxfcNext;
+            if (pxfcCheck->pxfcNext)
+            {
+                pxfcCheck->pxfcNext->pxfcPrev = pxfcCheck->pxfcPrev;
+            }
+            else
+            {
+                *ppxfcTail = pxfcCheck->pxfcPrev;
+            }
+
+            // ...and put it back right after the group.
+            pxfcCheck->pxfcPrev = pxfc;
+            pxfcCheck->pxfcNext = pxfc->pxfcNext;
+            pxfc->pxfcNext->pxfcPrev = pxfcCheck;
+            pxfc->pxfcNext = pxfcCheck;
+
+            pxfc = pxfcCheck;
+        }
+    }
+}
+
+
 static HRESULT ReadXmlFileTable(
     __inout XML_FILE_CHANGE** ppxfcHead,
     __inout XML_FILE_CHANGE** ppxfcTail
@@ -204,13 +255,16 @@ LExit:
 static HRESULT BeginChangeFile(
     __in LPCWSTR pwzFile,
     __in XML_FILE_CHANGE* pxfc,
+    __inout LPWSTR* ppwzRollbackFile,
+    __inout eXmlAction* pxaRollbackFile,
     __inout LPWSTR* ppwzCustomActionData
     )
 {
-    Assert(pwzFile && *pwzFile && ppwzCustomActionData);
+    Assert(pwzFile && *pwzFile && ppwzRollbackFile && pxaRollbackFile && ppwzCustomActionData);
 
     HRESULT hr = S_OK;
     BOOL fIs64Bit = pxfc->iCompAttributes & msidbComponentAttributes64bit;
+    eXmlAction xaOpen = fIs64Bit ? xaOpenFilex64 : xaOpenFile;
     BOOL fUseXPath = pxfc->iXmlFlags & XMLFILE_USE_XPATH;
     LPBYTE pbData = NULL;
     SIZE_T cbData = 0;
@@ -240,6 +294,19 @@ static HRESULT BeginChangeFile(
     hr = WcaWriteStringToCaData(pwzFile, ppwzCustomActionData);
     ExitOnFailure(hr, "failed to write file to custom action data: %ls", pwzFile);
 
+    // A file changed in more than one group (when the selection language changes) only needs to be put back once.
+    // The same path opened for a 32-bit and a 64-bit component can be two different files under WOW64 file system
+    // redirection, so both get their own rollback.
+    if (*ppwzRollbackFile && xaOpen == *pxaRollbackFile && 0 == lstrcmpiW(*ppwzRollbackFile, pwzFile))
+    {
+        ExitFunction();
+    }
+
+    hr = StrAllocString(ppwzRollbackFile, pwzFile, 0);
+    ExitOnFailure(hr, "failed to copy rollback file name");
+
+    *pxaRollbackFile = xaOpen;
+
     // If the file already exits, then we have to put it back the way it was on failure
     if (FileExistsEx(pwzFile, NULL))
     {
@@ -259,9 +326,9 @@ static HRESULT BeginChangeFile(
         hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecXmlFileRollback"), pwzRollbackCustomActionData, COST_XMLFILE);
         ExitOnFailure(hr, "failed to schedule ExecXmlFileRollback for file: %ls", pwzFile);
 
-        ReleaseStr(pwzRollbackCustomActionData);
     }
 LExit:
+    ReleaseStr(pwzRollbackCustomActionData);
     ReleaseMem(pbData);
 
     return hr;
@@ -305,6 +372,8 @@ extern "C" UINT __stdcall SchedXmlFile(
     UINT er = ERROR_SUCCESS;
 
     LPWSTR pwzCurrentFile = NULL;
+    LPWSTR pwzRollbackFile = NULL;
+    eXmlAction xaRollbackFile = xaOpenFile;
     BOOL fCurrentFileChanged = FALSE;
     BOOL fCurrentUseXPath = FALSE;
 
@@ -333,17 +402,19 @@ extern "C" UINT __stdcall SchedXmlFile(
 
     MessageExitOnFailure(hr, msierrXmlFileFailedRead, "failed to read Wix4XmlFile table");
 
+    GroupXmlFileChangesByFile(&pxfcHead, &pxfcTail);
+
     // loop through all the xml configurations
     for (pxfc = pxfcHead; pxfc; pxfc = pxfc->pxfcNext)
     {
         // If this is the first file, a different file, the last file, or the SelectionLanguage property changes...
-        if (NULL == pwzCurrentFile || 0 != lstrcmpW(pwzCurrentFile, pxfc->wzFile) || NULL == pxfc->pxfcNext || fCurrentUseXPath != ((XMLFILE_USE_XPATH & pxfc->iXmlFlags)))
+        if (NULL == pwzCurrentFile || 0 != lstrcmpiW(pwzCurrentFile, pxfc->wzFile) || NULL == pxfc->pxfcNext || fCurrentUseXPath != ((XMLFILE_USE_XPATH & pxfc->iXmlFlags)))
         {
             // If this isn't the first file
             if (NULL != pwzCurrentFile)
             {
                 // Do the uninstall work for the current file by walking backwards through the list (so the sequence is reversed)
-                for (pxfcUninstall = ((NULL != pxfc->pxfcNext) ? pxfc->pxfcPrev : pxfc); pxfcUninstall && 0 == lstrcmpW(pwzCurrentFile, pxfcUninstall->wzFile) &&  fCurrentUseXPath == ((XMLFILE_USE_XPATH & pxfcUninstall->iXmlFlags)); pxfcUninstall = pxfcUninstall->pxfcPrev)
+                for (pxfcUninstall = ((NULL != pxfc->pxfcNext) ? pxfc->pxfcPrev : pxfc); pxfcUninstall && 0 == lstrcmpiW(pwzCurrentFile, pxfcUninstall->wzFile) &&  fCurrentUseXPath == ((XMLFILE_USE_XPATH & pxfcUninstall->iXmlFlags)); pxfcUninstall = pxfcUninstall->pxfcPrev)
                 {
                     // If it's being uninstalled
                     if (WcaIsUninstalling(pxfcUninstall->isInstalled, pxfcUninstall->isAction))
@@ -353,7 +424,7 @@ extern "C" UINT __stdcall SchedXmlFile(
                         {
                             if (!fCurrentFileChanged)
                             {
-                                hr = BeginChangeFile(pwzCurrentFile, pxfcUninstall, &pwzCustomActionData);
+                                hr = BeginChangeFile(pwzCurrentFile, pxfcUninstall, &pwzRollbackFile, &xaRollbackFile, &pwzCustomActionData);
                                 ExitOnFailure(hr, "failed to begin file change for file: %ls", pwzCurrentFile);
 
                                 fCurrentFileChanged = TRUE;
@@ -402,7 +473,7 @@ extern "C" UINT __stdcall SchedXmlFile(
         {
             if (!fCurrentFileChanged)
             {
-                hr = BeginChangeFile(pwzCurrentFile, pxfc, &pwzCustomActionData);
+                hr = BeginChangeFile(pwzCurrentFile, pxfc, &pwzRollbackFile, &xaRollbackFile, &pwzCustomActionData);
                 ExitOnFailure(hr, "failed to begin file change for file: %ls", pwzCurrentFile);
                 fCurrentFileChanged = TRUE;
                 ++cFiles;
@@ -462,12 +533,123 @@ extern "C" UINT __stdcall SchedXmlFile(
 
 LExit:
     ReleaseStr(pwzCurrentFile);
+    ReleaseStr(pwzRollbackFile);
     ReleaseStr(pwzCustomActionData);
 
     return WcaFinalize(FAILED(hr) ? ERROR_INSTALL_FAILURE : er);
 }
 
 
+static BOOL IsReusableXPath(
+    __in_z LPCWSTR wzXPath
+    )
+{
+    // Without predicates or functions a path selects the same node until elements are added or removed.
+    return NULL == wcspbrk(wzXPath, L"[(");
+}
+
+
+static HRESULT SetSelectionLanguage(
+    __in IXMLDOMDocument* pixd,
+    __in eXmlSelectionLanguage xl
+    )
+{
+    HRESULT hr = S_OK;
+    IXMLDOMDocument2* pixdDocument2 = NULL;
+    BSTR bstrProperty = NULL;
+    VARIANT varValue;
+
+    ::VariantInit(&varValue);
+
+    bstrProperty = ::SysAllocString(L"SelectionLanguage");
+    ExitOnNull(bstrProperty, hr, E_OUTOFMEMORY, "failed SysAllocString");
+
+    varValue.vt = VT_BSTR;
+    varValue.bstrVal = ::SysAllocString(xsXPath == xl ? L"XPath" : L"XSLPattern");
+    ExitOnNull(varValue.bstrVal, hr, E_OUTOFMEMORY, "failed SysAllocString");
+
+    hr = pixd->QueryInterface(XmlUtil_IID_IXMLDOMDocument2, (void**)&pixdDocument2);
+    ExitOnFailure(hr, "failed in querying IXMLDOMDocument2 interface");
+
+    hr = pixdDocument2->setProperty(bstrProperty, varValue);
+    ExitOnFailure(hr, "failed in setting SelectionLanguage");
+
+LExit:
+    ReleaseObject(pixdDocument2);
+    ReleaseBSTR(bstrProperty);
+    ReleaseVariant(varValue);
+
+    return hr;
+}
+
+
+static HRESULT SaveXmlFile(
+    __in IXMLDOMDocument* pixd,
+    __in_z LPCWSTR wzFile,
+    __in BOOL fPreserveDate
+    )
+{
+    HRESULT hr = S_OK;
+    FILETIME ft;
+    int id = IDRETRY;
+    int iSaveAttempt = 0;
+
+    if (fPreserveDate)
+    {
+        hr = FileGetTime(wzFile, NULL, NULL, &ft);
+        ExitOnFailure(hr, "failed to get modified time of file : %ls", wzFile);
+    }
+
+    do
+    {
+        hr = XmlSaveDocument(pixd, wzFile);
+        if (FAILED(hr))
+        {
+            id = WcaErrorMessage(msierrXmlConfigFailedSave, hr, INSTALLMESSAGE_ERROR | MB_ABORTRETRYIGNORE, 1, wzFile);
+            switch (id)
+            {
+            case IDABORT:
+                ExitOnFailure(hr, "Failed to save changes to XML file: %ls", wzFile);
+            case IDRETRY:
+                hr = S_FALSE;   // hit me, baby, one more time
+                break;
+            case IDIGNORE:
+                hr = S_OK;  // pretend everything is okay and bail
+                break;
+            case 0: // No UI case, MsiProcessMessage returns 0
+                if (STIERR_SHARING_VIOLATION == hr)
+                {
+                    // Only in case of sharing violation do we retry 30 times, once a second.
+                    if (iSaveAttempt < 30)
+                    {
+                        hr = S_FALSE;
+                        ++iSaveAttempt;
+                        WcaLog(LOGMSG_VERBOSE, "Unable to save changes to XML file: %ls, retry attempt: %x", wzFile, iSaveAttempt);
+                        Sleep(1000);
+                    }
+                    else
+                    {
+                        ExitOnFailure(hr, "Failed to save changes to XML file: %ls", wzFile);
+                    }
+                }
+                break;
+            default: // Unknown error
+                ExitOnFailure(hr, "Failed to save changes to XML file: %ls", wzFile);
+            }
+        }
+    } while (S_FALSE == hr);
+
+    if (fPreserveDate)
+    {
+        hr = FileSetTime(wzFile, NULL, NULL, &ft);
+        ExitOnFailure(hr, "failed to set modified time of file : %ls", wzFile);
+    }
+
+LExit:
+    return hr;
+}
+
+
 /******************************************************************
  ExecXmlFile - entry point for XmlFile Custom Action
 
@@ -484,12 +666,12 @@ extern "C" UINT __stdcall ExecXmlFile(
     BOOL fIsFSRedirectDisabled = FALSE;
     BOOL fPreserveDate = FALSE;
 
-    int id = IDRETRY;
-
     LPWSTR pwzCustomActionData = NULL;
     LPWSTR pwzData = NULL;
     LPWSTR pwzFile = NULL;
+    LPWSTR pwzOpenFile = NULL;
     LPWSTR pwzXPath = NULL;
+    LPWSTR pwzSelectedXPath = NULL;
     LPWSTR pwzName = NULL;
     LPWSTR pwzValue = NULL;
     LPWSTR pwz = NULL;
@@ -498,20 +680,12 @@ extern "C" UINT __stdcall ExecXmlFile(
     IXMLDOMNode* pixn = NULL;
     IXMLDOMNode* pixnNewNode = NULL;
     IXMLDOMNodeList* pixNodes = NULL;
-    IXMLDOMDocument2 *pixdDocument2 = NULL;
 
-    FILETIME ft;
-
-    BSTR bstrProperty = ::SysAllocString(L"SelectionLanguage");
-    ExitOnNull(bstrProperty, hr, E_OUTOFMEMORY, "failed SysAllocString");
-    VARIANT varValue;
-    ::VariantInit(&varValue);
-    varValue.vt = VT_BSTR;
-    varValue.bstrVal = ::SysAllocString(L"XPath");
-    ExitOnNull(varValue.bstrVal, hr, E_OUTOFMEMORY, "failed SysAllocString");
     eXmlAction xa;
+    eXmlAction xaOpen = xaOpenFile;
     eXmlPreserveDate xd;
     eXmlSelectionLanguage xl;
+    eXmlSelectionLanguage xlOpen = xsXSLPattern;
 
     // initialize
     hr = WcaInitialize(hInstall, "ExecXmlFile");
@@ -549,58 +723,81 @@ extern "C" UINT __stdcall ExecXmlFile(
         hr = WcaReadStringFromCaData(&pwz, &pwzFile);
         ExitOnFailure(hr, "failed to read file name from custom action data");
 
-        // Default to not preserve the modified date
-        fPreserveDate = FALSE;
-
-        // Open the file
-        ReleaseNullObject(pixd);
-
-        if (xaOpenFilex64 == xa)
+        // A file is opened again when the selection language changes part way through its changes. Keep working
+        // on the document that is already loaded so the file is only loaded and saved once.
+        if (!pwzOpenFile || xaOpen != xa || 0 != lstrcmpiW(pwzOpenFile, pwzFile))
         {
-#ifndef _WIN64
-            if (!fIsWow64Process)
+            // Save the changes to the previous file before moving on to this one
+            if (pwzOpenFile && S_OK == hrOpenFailure)
             {
-                hr = E_NOTIMPL;
-                ExitOnFailure(hr, "Custom action was told to act on a 64-bit component, but the custom action process is not running in WOW.");
+                hr = SaveXmlFile(pixd, pwzOpenFile, fPreserveDate);
+                ExitOnFailure(hr, "failed to save XML file: %ls", pwzOpenFile);
             }
 
-            hr = WcaDisableWow64FSRedirection();
-            ExitOnFailure(hr, "Custom action was told to act on a 64-bit component, but was unable to disable filesystem redirection through the Wow64 API.");
+            if (fIsFSRedirectDisabled)
+            {
+                fIsFSRedirectDisabled = FALSE;
+                WcaRevertWow64FSRedirection();
+            }
 
-            fIsFSRedirectDisabled = TRUE;
-#endif
-        }
+            // Default to not preserve the modified date
+            fPreserveDate = FALSE;
 
-        hr = XmlLoadDocumentFromFileEx(pwzFile, XML_LOAD_PRESERVE_WHITESPACE, &pixd);
-        if (FAILED(hr))
-        {
-            // Ignore the return code for now.  If they try to add something, we'll fail the install.  If all they do is remove stuff then it doesn't matter.
-            hrOpenFailure = hr;
-            hr = S_OK;
-        }
-        else
-        {
-            hrOpenFailure = S_OK;
-        }
-        WcaLog(LOGMSG_VERBOSE, "Configuring Xml File: %ls", pwzFile);
+            // Open the file
+            ReleaseNullObject(pixn);
+            ReleaseNullObject(pixd);
 
-        if (xsXPath == xl)
-        {
-            if (vfMsxml30)
+            if (xaOpenFilex64 == xa)
             {
-                // If we failed to open the file, don't fail immediately; just skip setting the selection language, and we'll fail later if appropriate
-                if (SUCCEEDED(hrOpenFailure))
+#ifndef _WIN64
+                if (!fIsWow64Process)
                 {
-                    hr = pixd->QueryInterface(XmlUtil_IID_IXMLDOMDocument2, (void**)&pixdDocument2);
-                    ExitOnFailure(hr, "failed in querying IXMLDOMDocument2 interface");
-                    hr = pixdDocument2->setProperty(bstrProperty, varValue);
-                    ExitOnFailure(hr, "failed in setting SelectionLanguage");
+                    hr = E_NOTIMPL;
+                    ExitOnFailure(hr, "Custom action was told to act on a 64-bit component, but the custom action process is not running in WOW.");
                 }
+
+                hr = WcaDisableWow64FSRedirection();
+                ExitOnFailure(hr, "Custom action was told to act on a 64-bit component, but was unable to disable filesystem redirection through the Wow64 API.");
+
+                fIsFSRedirectDisabled = TRUE;
+#endif
+            }
+
+            hr = XmlLoadDocumentFromFileEx(pwzFile, XML_LOAD_PRESERVE_WHITESPACE, &pixd);
+            if (FAILED(hr))
+            {
+                // Ignore the return code for now.  If they try to add something, we'll fail the install.  If all they do is remove stuff then it doesn't matter.
+                hrOpenFailure = hr;
+                hr = S_OK;
             }
             else
             {
-                ExitOnFailure(hr = E_NOTIMPL, "Error: current MSXML version does not support xpath query.");
+                hrOpenFailure = S_OK;
             }
+            WcaLog(LOGMSG_VERBOSE, "Configuring Xml File: %ls", pwzFile);
+
+            hr = StrAllocString(&pwzOpenFile, pwzFile, 0);
+            ExitOnFailure(hr, "failed to copy file name");
+
+            xaOpen = xa;
+            xlOpen = xsXSLPattern;
+        }
+
+        // Nodes selected with a different selection language can't be reused.
+        ReleaseNullStr(pwzSelectedXPath);
+
+        if (xsXPath == xl && !vfMsxml30)
+        {
+            ExitOnFailure(hr = E_NOTIMPL, "Error: current MSXML version does not support xpath query.");
+        }
+
+        // If we failed to open the file, don't fail immediately; just skip setting the selection language, and we'll fail later if appropriate
+        if (xlOpen != xl && SUCCEEDED(hrOpenFailure))
+        {
+            hr = SetSelectionLanguage(pixd, xl);
+            ExitOnFailure(hr, "failed to set selection language for XML file: %ls", pwzFile);
+
+            xlOpen = xl;
         }
 
         while (pwz && *pwz)
@@ -641,11 +838,13 @@ extern "C" UINT __stdcall ExecXmlFile(
                 }
             }
 
-            // Select the node we're about to modify
-            ReleaseNullObject(pixn);
-
             if (xaBulkWriteValue == xa)
             {
+                // Select the nodes we're about to modify
+                ReleaseNullObject(pixn);
+                ReleaseNullStr(pwzSelectedXPath);
+                ReleaseNullObject(pixNodes);
+
                 hr = XmlSelectNodes(pixd, pwzXPath, &pixNodes);
                 if (S_FALSE == hr)
                 {
@@ -676,10 +875,23 @@ extern "C" UINT __stdcall ExecXmlFile(
             }
             else
             {
-                hr = XmlSelectSingleNode(pixd, pwzXPath, &pixn);
-                if (S_FALSE == hr)
-                    hr = HRESULT_FROM_WIN32(ERROR_OBJECT_NOT_FOUND);
-                MessageExitOnFailure(hr, msierrXmlFileFailedSelect, "failed to find node: %ls in XML file: %ls", pwzXPath, pwzFile);
+                // Select the node we're about to modify, unless the previous change already selected it
+                if (!pixn || !pwzSelectedXPath || 0 != lstrcmpW(pwzSelectedXPath, pwzXPath))
+                {
+                    ReleaseNullObject(pixn);
+                    ReleaseNullStr(pwzSelectedXPath);
+
+                    hr = XmlSelectSingleNode(pixd, pwzXPath, &pixn);
+                    if (S_FALSE == hr)
+                        hr = HRESULT_FROM_WIN32(ERROR_OBJECT_NOT_FOUND);
+                    MessageExitOnFailure(hr, msierrXmlFileFailedSelect, "failed to find node: %ls in XML file: %ls", pwzXPath, pwzFile);
+
+                    if (IsReusableXPath(pwzXPath))
+                    {
+                        hr = StrAllocString(&pwzSelectedXPath, pwzXPath, 0);
+                        ExitOnFailure(hr, "failed to copy XPath");
+                    }
+                }
 
                 // Make the modification
                 if (xaWriteValue == xa)
@@ -709,6 +921,9 @@ extern "C" UINT __stdcall ExecXmlFile(
                     }
 
                     ReleaseNullObject(pixnNewNode);
+
+                    // The path may select a different node now
+                    ReleaseNullStr(pwzSelectedXPath);
                 }
                 else if (xaDeleteValue == xa)
                 {
@@ -730,6 +945,9 @@ extern "C" UINT __stdcall ExecXmlFile(
                     // TODO: This may be a little heavy handed
                     hr = XmlRemoveChildren(pixn, pwzName);
                     ExitOnFailure(hr, "failed to delete child node: %ls", pwzName);
+
+                    // The path may select a different node now
+                    ReleaseNullStr(pwzSelectedXPath);
                 }
                 else
                 {
@@ -737,69 +955,13 @@ extern "C" UINT __stdcall ExecXmlFile(
                 }
             }
         }
+    }
 
-        // Now that we've made all of the changes to this file, save it and move on to the next
-        if (S_OK == hrOpenFailure)
-        {
-            if (fPreserveDate)
-            {
-                hr = FileGetTime(pwzFile, NULL, NULL, &ft);
-                ExitOnFailure(hr, "failed to get modified time of file : %ls", pwzFile);
-            }
-
-            int iSaveAttempt = 0;
-
-            do
-            {
-                hr = XmlSaveDocument(pixd, pwzFile);
-                if (FAILED(hr))
-                {
-                    id = WcaErrorMessage(msierrXmlConfigFailedSave, hr, INSTALLMESSAGE_ERROR | MB_ABORTRETRYIGNORE, 1, pwzFile);
-                    switch (id)
-                    {
-                    case IDABORT:
-                        ExitOnFailure(hr, "Failed to save changes to XML file: %ls", pwzFile);
-                    case IDRETRY:
-                        hr = S_FALSE;   // hit me, baby, one more time
-                        break;
-                    case IDIGNORE:
-                        hr = S_OK;  // pretend everything is okay and bail
-                        break;
-                    case 0: // No UI case, MsiProcessMessage returns 0
-                        if (STIERR_SHARING_VIOLATION == hr)
-                        {
-                            // Only in case of sharing violation do we retry 30 times, once a second.
-                            if (iSaveAttempt < 30)
-                            {
-                                hr = S_FALSE;
-                                ++iSaveAttempt;
-                                WcaLog(LOGMSG_VERBOSE, "Unable to save changes to XML file: %ls, retry attempt: %x", pwzFile, iSaveAttempt);
-                                Sleep(1000);
-                            }
-                            else
-                            {
-                                ExitOnFailure(hr, "Failed to save changes to XML file: %ls", pwzFile);
-                            }
-                        }
-                        break;
-                    default: // Unknown error
-                        ExitOnFailure(hr, "Failed to save changes to XML file: %ls", pwzFile);
-                    }
-                }
-            } while (S_FALSE == hr);
-
-            if (fPreserveDate)
-            {
-                hr = FileSetTime(pwzFile, NULL, NULL, &ft);
-                ExitOnFailure(hr, "failed to set modified time of file : %ls", pwzFile);
-            }
-
-            if (fIsFSRedirectDisabled)
-            {
-                fIsFSRedirectDisabled = FALSE;
-                WcaRevertWow64FSRedirection();
-            }
-        }
+    // Now that we've made all of the changes, save the last file
+    if (pwzOpenFile && S_OK == hrOpenFailure)
+    {
+        hr = SaveXmlFile(pixd, pwzOpenFile, fPreserveDate);
+        ExitOnFailure(hr, "failed to save XML file: %ls", pwzOpenFile);
     }
 
 LExit:
@@ -816,13 +978,12 @@ LExit:
     ReleaseStr(pwzCustomActionData);
     ReleaseStr(pwzData);
     ReleaseStr(pwzFile);
+    ReleaseStr(pwzOpenFile);
     ReleaseStr(pwzXPath);
+    ReleaseStr(pwzSelectedXPath);
     ReleaseStr(pwzName);
     ReleaseStr(pwzValue);
-    ReleaseBSTR(bstrProperty);
-    ReleaseVariant(varValue);
 
-    ReleaseObject(pixdDocument2);
     ReleaseObject(pixn);
     ReleaseObject(pixd);
     ReleaseObject(pixnNewNode);
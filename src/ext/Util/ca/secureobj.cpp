@@ -22,6 +22,40 @@ enum eSECURE_OBJECT_ATTRIBUTE
     SECURE_OBJECT_ATTRIBUTE_INHERITABLE = 0x1,
 };
 
+struct SECURE_OBJECT_ROW
+{
+    DWORD dwSequence;
+    LPWSTR pwzTargetPath;
+    LPWSTR pwzTable;
+    LPWSTR pwzDomain;
+    LPWSTR pwzUser;
+    DWORD dwAttributes;
+    LPWSTR pwzPermission;
+};
+
+struct SECURE_OBJECT_ROLLBACK
+{
+    LPWSTR pwzTable;
+    LPWSTR pwzSecurityInfo;
+    BOOL fProtected;
+    LPWSTR pwzCustomActionData;
+    DWORD cObjects;
+};
+
+struct SECURE_OBJECT_ACCOUNT
+{
+    LPWSTR pwzAccount;
+    PSID psid;
+};
+
+struct SECURE_OBJECT_PREPARED_ACL
+{
+    PACL pAclExisting;
+    EXPLICIT_ACCESSW* rgEntries;
+    DWORD cEntries;
+    PACL pAclNew;
+};
+
 static eOBJECTTYPE EObjectTypeFromString(
     __in LPCWSTR pwzTable
     )
@@ -85,9 +119,11 @@ static SE_OBJECT_TYPE SEObjectTypeFromString(
     return objectType;
 }
 
-static HRESULT StoreACLRollbackInfo(
-    __in LPWSTR pwzObject,
-    __in LPCWSTR pwzTable
+static HRESULT GetRollbackSecurityInfo(
+    __in LPCWSTR pwzObject,
+    __in LPCWSTR pwzTable,
+    __deref_out_z LPWSTR* ppwzSecurityInfo,
+    __out BOOL* pfProtected
     )
 {
     HRESULT hr = S_OK;
@@ -95,9 +131,8 @@ static HRESULT StoreACLRollbackInfo(
     PSECURITY_DESCRIPTOR psd = NULL;
     SECURITY_DESCRIPTOR_CONTROL sdc = {0};
     DWORD dwRevision = 0;
-    LPWSTR pwzCustomActionData = NULL;
     LPWSTR pwzSecurityInfo = NULL;
-    
+
     Assert(pwzObject && pwzTable);
 
     SE_OBJECT_TYPE objectType = SEObjectTypeFromString(const_cast<LPCWSTR> (pwzTable));
@@ -120,47 +155,27 @@ static HRESULT StoreACLRollbackInfo(
             ExitOnLastError(hr, "Unable to schedule rollback for object (failed to get security descriptor control): %ls", pwzObject);
         }
 
-        // Convert the security information to a string, and write this to the custom action data
+        // Convert the security information to a string so objects with the same DACL can share a rollback action
         if (!::ConvertSecurityDescriptorToStringSecurityDescriptorW(psd,SDDL_REVISION_1,DACL_SECURITY_INFORMATION,&pwzSecurityInfo,NULL))
         {
             hr = E_UNEXPECTED;
             ExitOnFailure(hr, "Unable to schedule rollback for object (failed to convert security descriptor to a valid security descriptor string): %ls", pwzObject);
         }
 
-        hr = WcaWriteStringToCaData(pwzObject, &pwzCustomActionData);
-        ExitOnFailure(hr, "failed to add object data to rollback CustomActionData");
-
-        hr = WcaWriteStringToCaData(pwzTable, &pwzCustomActionData);
-        ExitOnFailure(hr, "failed to add table name to rollback CustomActionData");
-
-        hr = WcaWriteStringToCaData(pwzSecurityInfo, &pwzCustomActionData);
-        ExitOnFailure(hr, "failed to add security info data to rollback CustomActionData");
-
-        // Write a 1 if DACL is protected, 0 otherwise
-        if (sdc & SE_DACL_PROTECTED)
-        {
-            hr = WcaWriteIntegerToCaData(1,&pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to rollbackCustomActionData");
-        }
-        else
-        {
-            hr = WcaWriteIntegerToCaData(0,&pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to rollback CustomActionData");
-        }
-
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecSecureObjectsRollback"), pwzCustomActionData, COST_SECUREOBJECT);
-        ExitOnFailure(hr, "failed to schedule ExecSecureObjectsRollback for item: %ls of type: %ls", pwzObject, pwzTable);
-
-        ReleaseStr(pwzCustomActionData);
-        pwzCustomActionData = NULL;
+        hr = StrAllocString(ppwzSecurityInfo, pwzSecurityInfo, 0);
+        ExitOnFailure(hr, "failed to copy security info for object: %ls", pwzObject);
 
+        *pfProtected = (sdc & SE_DACL_PROTECTED) ? TRUE : FALSE;
     }
     else
     {
         MessageExitOnFailure(hr = E_UNEXPECTED, msierrSecureObjectsUnknownType, "unknown object type: %ls", pwzTable);
     }
 LExit:
-    ReleaseStr(pwzCustomActionData);
+    if (pwzSecurityInfo)
+    {
+        ::LocalFree(pwzSecurityInfo);
+    }
 
     if (psd)
     {
@@ -312,24 +327,81 @@ LExit:
     return hr;
 }
 
-/******************************************************************
- SchedSecureObjects - entry point for SchedSecureObjects Custom Action
+static void FreeSecureObjectRows(
+    __in_ecount_opt(cRows) SECURE_OBJECT_ROW* rgRows,
+    __in DWORD cRows
+    )
+{
+    if (rgRows)
+    {
+        for (DWORD i = 0; i < cRows; ++i)
+        {
+            ReleaseStr(rgRows[i].pwzTargetPath);
+            ReleaseStr(rgRows[i].pwzTable);
+            ReleaseStr(rgRows[i].pwzDomain);
+            ReleaseStr(rgRows[i].pwzUser);
+            ReleaseStr(rgRows[i].pwzPermission);
+        }
 
- called as Type 1 CustomAction (binary DLL) from Windows Installer 
- in InstallExecuteSequence, to schedule ExecSecureObjects
+        MemFree(rgRows);
+    }
+}
+
+static int CompareSecureObjectTargets(
+    __in const SECURE_OBJECT_ROW* pLeft,
+    __in const SECURE_OBJECT_ROW* pRight
+    )
+{
+    int nResult = ::CompareStringW(LOCALE_INVARIANT, 0, pLeft->pwzTable, -1, pRight->pwzTable, -1);
+    if (CSTR_EQUAL == nResult)
+    {
+        nResult = ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE | SORT_STRINGSORT, pLeft->pwzTargetPath, -1, pRight->pwzTargetPath, -1);
+    }
+
+    // Map CSTR_LESS_THAN, CSTR_EQUAL and CSTR_GREATER_THAN to -1, 0 and 1.
+    return nResult - CSTR_EQUAL;
+}
+
+static __callback int __cdecl CompareSecureObjectRows(
+    void* pvContext,
+    const void* pvLeft,
+    const void* pvRight
+    )
+{
+    UNREFERENCED_PARAMETER(pvContext);
+
+    const SECURE_OBJECT_ROW* pLeft = static_cast<const SECURE_OBJECT_ROW*>(pvLeft);
+    const SECURE_OBJECT_ROW* pRight = static_cast<const SECURE_OBJECT_ROW*>(pvRight);
+
+    int nResult = CompareSecureObjectTargets(pLeft, pRight);
+    if (0 == nResult)
+    {
+        // Keep the authored order of the rows that secure the same object.
+        nResult = (pLeft->dwSequence < pRight->dwSequence) ? -1 : (pLeft->dwSequence > pRight->dwSequence) ? 1 : 0;
+    }
+
+    return nResult;
+}
+
+/******************************************************************
+ ReadSecureObjectRows - reads the Wix4SecureObject rows for this
+   bitness, sorted so the rows that secure the same object are
+   adjacent. Only rows of components being installed are read,
+   with their full access data, unless fRollback is set.
 ******************************************************************/
-extern "C" UINT __stdcall SchedSecureObjects(
-    __in MSIHANDLE hInstall
+static HRESULT ReadSecureObjectRows(
+    __in BOOL fRollback,
+    __deref_out_ecount(*pcRows) SECURE_OBJECT_ROW** prgRows,
+    __out DWORD* pcRows
     )
 {
-//    AssertSz(FALSE, "debug SchedSecureObjects");
     HRESULT hr = S_OK;
     UINT er = ERROR_SUCCESS;
 
     LPWSTR pwzSecureObject = NULL;
-    LPWSTR pwzData = NULL;
     LPWSTR pwzTable = NULL;
     LPWSTR pwzTargetPath = NULL;
+    LPWSTR pwzComponent = NULL;
 
     PMSIHANDLE hView = NULL;
     PMSIHANDLE hRec = NULL;
@@ -337,28 +409,14 @@ extern "C" UINT __stdcall SchedSecureObjects(
     INSTALLSTATE isInstalled;
     INSTALLSTATE isAction;
 
-    LPWSTR pwzCustomActionData = NULL;
+    SECURE_OBJECT_ROW* rgRows = NULL;
+    DWORD cRows = 0;
+    SECURE_OBJECT_ROW* pRow = NULL;
 
-    DWORD cObjects = 0;
     eOBJECTTYPE eType = OT_UNKNOWN;
-    DWORD dwAttributes = 0;
-
-    //
-    // initialize
-    //
-    hr = WcaInitialize(hInstall, "SchedSecureObjects");
-    ExitOnFailure(hr, "failed to initialize");
+    int iCompAttributes = 0;
+    BOOL fIs64Bit = FALSE;
 
-    // anything to do?
-    if (S_OK != WcaTableExists(L"Wix4SecureObject"))
-    {
-        WcaLog(LOGMSG_STANDARD, "Wix4SecureObject table doesn't exist, so there are no objects to secure.");
-        ExitFunction();
-    }
-
-    //
-    // loop through all the objects to be secured
-    //
     hr = WcaOpenExecuteView(wzQUERY_SECUREOBJECTS, &hView);
     ExitOnFailure(hr, "failed to open view on Wix4SecureObject table");
     while (S_OK == (hr = WcaFetchRecord(hView, &hRec)))
@@ -373,11 +431,10 @@ extern "C" UINT __stdcall SchedSecureObjects(
             ExitOnFailure(hr = E_INVALIDARG, "unknown SecureObject.Table: %ls", pwzTable);
         }
 
-        int iCompAttributes = 0;
         hr = WcaGetRecordInteger(hRec, QSO_COMPATTRIBUTES, &iCompAttributes);
         ExitOnFailure(hr, "failed to get Component attributes for secure object");
 
-        BOOL fIs64Bit = iCompAttributes & msidbComponentAttributes64bit;
+        fIs64Bit = iCompAttributes & msidbComponentAttributes64bit;
 
         // Only process entries in the Wix4SecureObject table whose components match the bitness of this CA
 #ifdef _WIN64
@@ -399,72 +456,415 @@ extern "C" UINT __stdcall SchedSecureObjects(
         hr = GetTargetPath(eType, pwzSecureObject, &pwzTargetPath);
         ExitOnFailure(hr, "failed to get target path of object '%ls'", pwzSecureObject);
 
-        hr = WcaGetRecordString(hRec, QSO_COMPONENT, &pwzData);
-        ExitOnFailure(hr, "failed to get Component name for secure object");
+        if (!fRollback)
+        {
+            hr = WcaGetRecordString(hRec, QSO_COMPONENT, &pwzComponent);
+            ExitOnFailure(hr, "failed to get Component name for secure object");
 
-        //
-        // if we are installing this Component
-        //
-        er = ::MsiGetComponentStateW(hInstall, pwzData, &isInstalled, &isAction);
-        ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to get install state for Component: %ls", pwzData);
+            //
+            // if we are installing this Component
+            //
+            er = ::MsiGetComponentStateW(WcaGetInstallHandle(), pwzComponent, &isInstalled, &isAction);
+            ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to get install state for Component: %ls", pwzComponent);
 
-        if (WcaIsInstalling(isInstalled, isAction))
-        {
-            hr = WcaWriteStringToCaData(pwzTargetPath, &pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to CustomActionData");
+            if (!WcaIsInstalling(isInstalled, isAction))
+            {
+                continue;
+            }
+        }
 
-            // add the data to the CustomActionData
-            hr = WcaGetRecordString(hRec, QSO_SECUREOBJECT, &pwzData);
-            ExitOnFailure(hr, "failed to get name of object");
-            hr = WcaWriteStringToCaData(pwzTable, &pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to CustomActionData");
+        hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&rgRows), cRows + 1, sizeof(SECURE_OBJECT_ROW), 64);
+        ExitOnFailure(hr, "failed to grow array of objects to secure");
+
+        pRow = rgRows + cRows;
+        ++cRows;
+
+        pRow->dwSequence = cRows;
+        pRow->pwzTargetPath = pwzTargetPath;
+        pwzTargetPath = NULL;
 
-            hr = WcaGetRecordFormattedString(hRec, QSO_DOMAIN, &pwzData);
+        hr = StrAllocString(&pRow->pwzTable, pwzTable, 0);
+        ExitOnFailure(hr, "failed to copy object table");
+
+        if (!fRollback)
+        {
+            hr = WcaGetRecordFormattedString(hRec, QSO_DOMAIN, &pRow->pwzDomain);
             ExitOnFailure(hr, "failed to get domain for user to configure object");
-            hr = WcaWriteStringToCaData(pwzData, &pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to CustomActionData");
 
-            hr = WcaGetRecordFormattedString(hRec, QSO_USER, &pwzData);
+            hr = WcaGetRecordFormattedString(hRec, QSO_USER, &pRow->pwzUser);
             ExitOnFailure(hr, "failed to get user to configure object");
-            hr = WcaWriteStringToCaData(pwzData, &pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to CustomActionData");
 
-            hr = WcaGetRecordInteger(hRec, QSO_ATTRIBUTES, reinterpret_cast<int*>(&dwAttributes));
+            hr = WcaGetRecordInteger(hRec, QSO_ATTRIBUTES, reinterpret_cast<int*>(&pRow->dwAttributes));
             ExitOnFailure(hr, "failed to get attributes to configure object");
-            hr = WcaWriteIntegerToCaData(dwAttributes, &pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to CustomActionData");
 
-            hr = WcaGetRecordString(hRec, QSO_PERMISSION, &pwzData);
+            hr = WcaGetRecordString(hRec, QSO_PERMISSION, &pRow->pwzPermission);
             ExitOnFailure(hr, "failed to get permission to configure object");
-            hr = WcaWriteStringToCaData(pwzData, &pwzCustomActionData);
-            ExitOnFailure(hr, "failed to add data to CustomActionData");
-
-            ++cObjects;
         }
     }
 
     // if we looped through all records all is well
     if (E_NOMOREITEMS == hr)
+    {
         hr = S_OK;
+    }
     ExitOnFailure(hr, "failed while looping through all objects to secure");
 
+    if (1 < cRows)
+    {
+        qsort_s(rgRows, cRows, sizeof(SECURE_OBJECT_ROW), CompareSecureObjectRows, NULL);
+    }
+
+    *prgRows = rgRows;
+    rgRows = NULL;
+    *pcRows = cRows;
+    cRows = 0;
+
+LExit:
+    FreeSecureObjectRows(rgRows, cRows);
+    ReleaseStr(pwzComponent);
+    ReleaseStr(pwzTargetPath);
+    ReleaseStr(pwzTable);
+    ReleaseStr(pwzSecureObject);
+
+    return hr;
+}
+
+static HRESULT GetAccountSid(
+    __in LPCWSTR pwzDomain,
+    __in LPCWSTR pwzUser,
+    __out PSID* ppsid
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pwzAccount = NULL;
+
+    // figure out the right user to put into the access block
+    if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Everyone"))
+    {
+        hr = AclGetWellKnownSid(WinWorldSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Administrators"))
+    {
+        hr = AclGetWellKnownSid(WinBuiltinAdministratorsSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"LocalSystem"))
+    {
+        hr = AclGetWellKnownSid(WinLocalSystemSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"LocalService"))
+    {
+        hr = AclGetWellKnownSid(WinLocalServiceSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"NetworkService"))
+    {
+        hr = AclGetWellKnownSid(WinNetworkServiceSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"AuthenticatedUser"))
+    {
+        hr = AclGetWellKnownSid(WinAuthenticatedUserSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Guests"))
+    {
+        hr = AclGetWellKnownSid(WinBuiltinGuestsSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"CREATOR OWNER"))
+    {
+        hr = AclGetWellKnownSid(WinCreatorOwnerSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"INTERACTIVE"))
+    {
+        hr = AclGetWellKnownSid(WinInteractiveSid, ppsid);
+    }
+    else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Users"))
+    {
+        hr = AclGetWellKnownSid(WinBuiltinUsersSid, ppsid);
+    }
+    else
+    {
+        hr = StrAllocFormatted(&pwzAccount, L"%s%s%s", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
+        ExitOnFailure(hr, "failed to build domain user name");
+
+        hr = AclGetAccountSid(NULL, pwzAccount, ppsid);
+    }
+    ExitOnFailure(hr, "failed to get sid for account: %ls%ls%ls", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
+
+LExit:
+    ReleaseStr(pwzAccount);
+
+    return hr;
+}
+
+/******************************************************************
+ GetCachedAccountSid - looks up the SID of an account once per
+   action. The returned SID is owned by the cache.
+******************************************************************/
+static HRESULT GetCachedAccountSid(
+    __in LPCWSTR pwzDomain,
+    __in LPCWSTR pwzUser,
+    __inout SECURE_OBJECT_ACCOUNT** prgAccounts,
+    __inout DWORD* pcAccounts,
+    __out PSID* ppsid
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pwzAccount = NULL;
+    PSID psid = NULL;
+    SECURE_OBJECT_ACCOUNT* pAccount = NULL;
+
+    hr = StrAllocFormatted(&pwzAccount, L"%s\\%s", pwzDomain, pwzUser);
+    ExitOnFailure(hr, "failed to build account cache key");
+
+    for (DWORD i = 0; i < *pcAccounts; ++i)
+    {
+        if (0 == lstrcmpW(pwzAccount, (*prgAccounts)[i].pwzAccount))
+        {
+            *ppsid = (*prgAccounts)[i].psid;
+            ExitFunction();
+        }
+    }
+
+    hr = GetAccountSid(pwzDomain, pwzUser, &psid);
+    ExitOnFailure(hr, "failed to get sid for account: %ls%ls%ls", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(prgAccounts), *pcAccounts + 1, sizeof(SECURE_OBJECT_ACCOUNT), 8);
+    ExitOnFailure(hr, "failed to grow account cache");
+
+    pAccount = *prgAccounts + *pcAccounts;
+    ++*pcAccounts;
+
+    pAccount->pwzAccount = pwzAccount;
+    pwzAccount = NULL;
+    pAccount->psid = psid;
+    psid = NULL;
+
+    *ppsid = pAccount->psid;
+
+LExit:
+    ReleaseSid(psid);
+    ReleaseStr(pwzAccount);
+
+    return hr;
+}
+
+static void ReleasePreparedAcl(
+    __in SECURE_OBJECT_PREPARED_ACL* pPrepared
+    )
+{
+    if (pPrepared->pAclNew)
+    {
+        ::LocalFree(pPrepared->pAclNew);
+    }
+
+    ReleaseMem(pPrepared->pAclExisting);
+    ReleaseMem(pPrepared->rgEntries);
+
+    memset(pPrepared, 0, sizeof(SECURE_OBJECT_PREPARED_ACL));
+}
+
+static BOOL IsPreparedAclMatch(
+    __in const SECURE_OBJECT_PREPARED_ACL* pPrepared,
+    __in_opt PACL pAclExisting,
+    __in_ecount(cEntries) const EXPLICIT_ACCESSW* rgEntries,
+    __in DWORD cEntries
+    )
+{
+    if (!pPrepared->pAclNew || pPrepared->cEntries != cEntries)
+    {
+        return FALSE;
+    }
+
+    if (pAclExisting && pPrepared->pAclExisting)
+    {
+        if (pAclExisting->AclSize != pPrepared->pAclExisting->AclSize || 0 != memcmp(pAclExisting, pPrepared->pAclExisting, pAclExisting->AclSize))
+        {
+            return FALSE;
+        }
+    }
+    else if (pAclExisting || pPrepared->pAclExisting)
+    {
+        return FALSE;
+    }
+
+    for (DWORD i = 0; i < cEntries; ++i)
+    {
+        const EXPLICIT_ACCESSW* pEntry = rgEntries + i;
+        const EXPLICIT_ACCESSW* pPreparedEntry = pPrepared->rgEntries + i;
+
+        if (pEntry->grfAccessPermissions != pPreparedEntry->grfAccessPermissions ||
+            pEntry->grfAccessMode != pPreparedEntry->grfAccessMode ||
+            pEntry->grfInheritance != pPreparedEntry->grfInheritance ||
+            !::EqualSid(reinterpret_cast<PSID>(pEntry->Trustee.ptstrName), reinterpret_cast<PSID>(pPreparedEntry->Trustee.ptstrName)))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/******************************************************************
+ ApplySecureObjectEntries - merges the explicit access entries into
+   an object's DACL with one read and one write of its security.
+   The merged DACL is kept in pPrepared and reused for the next
+   object that starts with the same DACL and gets the same entries.
+******************************************************************/
+static HRESULT ApplySecureObjectEntries(
+    __in LPWSTR pwzObject,
+    __in SE_OBJECT_TYPE objectType,
+    __in_ecount(cEntries) EXPLICIT_ACCESSW* rgEntries,
+    __in DWORD cEntries,
+    __inout SECURE_OBJECT_PREPARED_ACL* pPrepared
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    DWORD dwRevision = 0;
+    PSECURITY_DESCRIPTOR psd = NULL;
+    SECURITY_DESCRIPTOR_CONTROL sdc = {0};
+    SECURITY_INFORMATION si = {0};
+    PACL pAclExisting = NULL;   // doesn't get freed
+    PACL pAclNew = NULL;
+
+    er = ::GetNamedSecurityInfoW(pwzObject, objectType, DACL_SECURITY_INFORMATION, NULL, NULL, &pAclExisting, NULL, &psd);
+    ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to get security info for object: %ls", pwzObject);
+
+    //Need to see if DACL is protected so getting Descriptor information
+    if (!::GetSecurityDescriptorControl(psd, &sdc, &dwRevision))
+    {
+        ExitOnLastError(hr, "failed to get security descriptor control for object: %ls", pwzObject);
+    }
+
+    if (!IsPreparedAclMatch(pPrepared, pAclExisting, rgEntries, cEntries))
+    {
+        ReleasePreparedAcl(pPrepared);
+
+        if (pAclExisting)
+        {
+            pPrepared->pAclExisting = static_cast<PACL>(MemAlloc(pAclExisting->AclSize, FALSE));
+            ExitOnNull(pPrepared->pAclExisting, hr, E_OUTOFMEMORY, "failed to allocate copy of ACL for object: %ls", pwzObject);
+
+            memcpy(pPrepared->pAclExisting, pAclExisting, pAclExisting->AclSize);
+        }
+
+        pPrepared->rgEntries = static_cast<EXPLICIT_ACCESSW*>(MemAlloc(sizeof(EXPLICIT_ACCESSW) * cEntries, FALSE));
+        ExitOnNull(pPrepared->rgEntries, hr, E_OUTOFMEMORY, "failed to allocate copy of ACL entries for object: %ls", pwzObject);
+
+        memcpy(pPrepared->rgEntries, rgEntries, sizeof(EXPLICIT_ACCESSW) * cEntries);
+        pPrepared->cEntries = cEntries;
+
+#pragma prefast(push)
+#pragma prefast(disable:25029)
+        er = ::SetEntriesInAclW(cEntries, rgEntries, pAclExisting, &pAclNew);
+#pragma prefast(pop)
+        ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to add ACLs for object: %ls", pwzObject);
+
+        pPrepared->pAclNew = pAclNew;
+    }
+
+    if (sdc & SE_DACL_PROTECTED)
+    {
+        si = DACL_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION;
+    }
+    else
+    {
+        si = DACL_SECURITY_INFORMATION;
+    }
+    er = ::SetNamedSecurityInfoW(pwzObject, objectType, si, NULL, NULL, pPrepared->pAclNew, NULL);
+    MessageExitOnFailure(hr = HRESULT_FROM_WIN32(er), msierrSecureObjectsFailedSet, "failed to set security info for object: %ls", pwzObject);
+
+LExit:
+    if (psd)
+    {
+        ::LocalFree(psd);
+    }
+
+    return hr;
+}
+
+/******************************************************************
+ SchedSecureObjects - entry point for SchedSecureObjects Custom Action
+
+ called as Type 1 CustomAction (binary DLL) from Windows Installer 
+ in InstallExecuteSequence, to schedule ExecSecureObjects
+******************************************************************/
+extern "C" UINT __stdcall SchedSecureObjects(
+    __in MSIHANDLE hInstall
+    )
+{
+//    AssertSz(FALSE, "debug SchedSecureObjects");
+    HRESULT hr = S_OK;
+    UINT er = ERROR_SUCCESS;
+
+    SECURE_OBJECT_ROW* rgRows = NULL;
+    DWORD cRows = 0;
+    DWORD iNext = 0;
+
+    WCA_CADATA_BUILDER customActionData = { };
+
+    //
+    // initialize
+    //
+    hr = WcaInitialize(hInstall, "SchedSecureObjects");
+    ExitOnFailure(hr, "failed to initialize");
+
+    // anything to do?
+    if (S_OK != WcaTableExists(L"Wix4SecureObject"))
+    {
+        WcaLog(LOGMSG_STANDARD, "Wix4SecureObject table doesn't exist, so there are no objects to secure.");
+        ExitFunction();
+    }
+
+    hr = ReadSecureObjectRows(FALSE, &rgRows, &cRows);
+    ExitOnFailure(hr, "failed to read objects to secure");
+
+    //
+    // loop through all the objects to be secured, writing the rows for each object together
+    //
+    for (DWORD i = 0; i < cRows; i = iNext)
+    {
+        for (iNext = i + 1; iNext < cRows && 0 == CompareSecureObjectTargets(rgRows + i, rgRows + iNext); ++iNext)
+        {
+        }
+
+        hr = WcaCaDataBuilderWriteString(&customActionData, rgRows[i].pwzTargetPath);
+        ExitOnFailure(hr, "failed to add data to CustomActionData");
+
+        hr = WcaCaDataBuilderWriteString(&customActionData, rgRows[i].pwzTable);
+        ExitOnFailure(hr, "failed to add data to CustomActionData");
+
+        hr = WcaCaDataBuilderWriteInteger(&customActionData, iNext - i);
+        ExitOnFailure(hr, "failed to add data to CustomActionData");
+
+        for (DWORD j = i; j < iNext; ++j)
+        {
+            hr = WcaCaDataBuilderWriteString(&customActionData, rgRows[j].pwzDomain);
+            ExitOnFailure(hr, "failed to add data to CustomActionData");
+
+            hr = WcaCaDataBuilderWriteString(&customActionData, rgRows[j].pwzUser);
+            ExitOnFailure(hr, "failed to add data to CustomActionData");
+
+            hr = WcaCaDataBuilderWriteInteger(&customActionData, rgRows[j].dwAttributes);
+            ExitOnFailure(hr, "failed to add data to CustomActionData");
+
+            hr = WcaCaDataBuilderWriteString(&customActionData, rgRows[j].pwzPermission);
+            ExitOnFailure(hr, "failed to add data to CustomActionData");
+        }
+    }
+
     //
     // schedule the custom action and add to progress bar
     //
-    if (pwzCustomActionData && *pwzCustomActionData)
+    if (customActionData.cchData)
     {
-        Assert(0 < cObjects);
+        Assert(0 < cRows);
 
-        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecSecureObjects"), pwzCustomActionData, cObjects * COST_SECUREOBJECT);
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecSecureObjects"), customActionData.pwzData, cRows * COST_SECUREOBJECT);
         ExitOnFailure(hr, "failed to schedule ExecSecureObjects action");
     }
 
 LExit:
-    ReleaseStr(pwzSecureObject);
-    ReleaseStr(pwzCustomActionData);
-    ReleaseStr(pwzData);
-    ReleaseStr(pwzTable);
-    ReleaseStr(pwzTargetPath);
+    WcaCaDataBuilderUninitialize(&customActionData);
+    FreeSecureObjectRows(rgRows, cRows);
 
     if (FAILED(hr))
     {
@@ -487,16 +887,15 @@ extern "C" UINT __stdcall SchedSecureObjectsRollback(
     HRESULT hr = S_OK;
     UINT er = ERROR_SUCCESS;
 
-    LPWSTR pwzSecureObject = NULL;
-    LPWSTR pwzTable = NULL;
-    LPWSTR pwzTargetPath = NULL;
-
-    PMSIHANDLE hView = NULL;
-    PMSIHANDLE hRec = NULL;
+    SECURE_OBJECT_ROW* rgRows = NULL;
+    DWORD cRows = 0;
 
-    LPWSTR pwzCustomActionData = NULL;
+    SECURE_OBJECT_ROLLBACK* rgRollbacks = NULL;
+    DWORD cRollbacks = 0;
+    SECURE_OBJECT_ROLLBACK* pRollback = NULL;
 
-    eOBJECTTYPE eType = OT_UNKNOWN;
+    LPWSTR pwzSecurityInfo = NULL;
+    BOOL fProtected = FALSE;
 
     //
     // initialize
@@ -504,68 +903,88 @@ extern "C" UINT __stdcall SchedSecureObjectsRollback(
     hr = WcaInitialize(hInstall, "SchedSecureObjectsRollback");
     ExitOnFailure(hr, "failed to initialize");
 
+    hr = ReadSecureObjectRows(TRUE, &rgRows, &cRows);
+    ExitOnFailure(hr, "failed to read objects to schedule rollback for");
+
     //
-    // loop through all the objects to be secured
+    // capture each object being secured once, sharing a rollback action between objects with the same DACL
     //
-    hr = WcaOpenExecuteView(wzQUERY_SECUREOBJECTS, &hView);
-    ExitOnFailure(hr, "failed to open view on Wix4SecureObject table");
-    while (S_OK == (hr = WcaFetchRecord(hView, &hRec)))
+    for (DWORD i = 0; i < cRows; ++i)
     {
-        hr = WcaGetRecordString(hRec, QSO_TABLE, &pwzTable);
-        ExitOnFailure(hr, "failed to get object table");
-
-        eType = EObjectTypeFromString(pwzTable);
-
-        if (OT_UNKNOWN == eType)
+        if (0 < i && 0 == CompareSecureObjectTargets(rgRows + i - 1, rgRows + i))
         {
-            ExitOnFailure(hr = E_INVALIDARG, "unknown SecureObject.Table: %ls", pwzTable);
+            continue;
         }
 
-        int iCompAttributes = 0;
-        hr = WcaGetRecordInteger(hRec, QSO_COMPATTRIBUTES, &iCompAttributes);
-        ExitOnFailure(hr, "failed to get Component attributes for secure object");
-
-        BOOL fIs64Bit = iCompAttributes & msidbComponentAttributes64bit;
-
-        // Only process entries in the Wix4SecureObject table whose components match the bitness of this CA
-#ifdef _WIN64
-        if (!fIs64Bit)
+        hr = GetRollbackSecurityInfo(rgRows[i].pwzTargetPath, rgRows[i].pwzTable, &pwzSecurityInfo, &fProtected);
+        if (FAILED(hr))
         {
+            WcaLog(LOGMSG_STANDARD, "Failed to store ACL rollback information with error 0x%x - continuing", hr);
+            hr = S_OK;
             continue;
         }
-#else
-        if (fIs64Bit)
+
+        pRollback = NULL;
+        for (DWORD j = 0; j < cRollbacks; ++j)
         {
-            continue;
+            if (fProtected == rgRollbacks[j].fProtected && 0 == lstrcmpW(rgRows[i].pwzTable, rgRollbacks[j].pwzTable) && 0 == lstrcmpW(pwzSecurityInfo, rgRollbacks[j].pwzSecurityInfo))
+            {
+                pRollback = rgRollbacks + j;
+                break;
+            }
         }
-#endif
 
-        // get the object being secured that we are planning to schedule rollback for
-        hr = WcaGetRecordString(hRec, QSO_SECUREOBJECT, &pwzSecureObject);
-        ExitOnFailure(hr, "failed to get name of object");
+        if (!pRollback)
+        {
+            hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&rgRollbacks), cRollbacks + 1, sizeof(SECURE_OBJECT_ROLLBACK), 8);
+            ExitOnFailure(hr, "failed to grow array of rollback security info");
 
-        hr = GetTargetPath(eType, pwzSecureObject, &pwzTargetPath);
-        ExitOnFailure(hr, "failed to get target path of object '%ls' in order to schedule rollback", pwzSecureObject);
+            pRollback = rgRollbacks + cRollbacks;
+            ++cRollbacks;
 
-        hr = StoreACLRollbackInfo(pwzTargetPath, pwzTable);
-        if (FAILED(hr))
-        {
-            WcaLog(LOGMSG_STANDARD, "Failed to store ACL rollback information with error 0x%x - continuing", hr);
+            pRollback->pwzTable = rgRows[i].pwzTable;
+            pRollback->pwzSecurityInfo = pwzSecurityInfo;
+            pwzSecurityInfo = NULL;
+            pRollback->fProtected = fProtected;
+
+            hr = WcaWriteStringToCaData(pRollback->pwzTable, &pRollback->pwzCustomActionData);
+            ExitOnFailure(hr, "failed to add table name to rollback CustomActionData");
+
+            hr = WcaWriteStringToCaData(pRollback->pwzSecurityInfo, &pRollback->pwzCustomActionData);
+            ExitOnFailure(hr, "failed to add security info data to rollback CustomActionData");
+
+            // Write a 1 if DACL is protected, 0 otherwise
+            hr = WcaWriteIntegerToCaData(pRollback->fProtected ? 1 : 0, &pRollback->pwzCustomActionData);
+            ExitOnFailure(hr, "failed to add data to rollback CustomActionData");
         }
+
+        hr = WcaWriteStringToCaData(rgRows[i].pwzTargetPath, &pRollback->pwzCustomActionData);
+        ExitOnFailure(hr, "failed to add object data to rollback CustomActionData");
+
+        ++pRollback->cObjects;
     }
 
-    // if we looped through all records all is well
-    if (E_NOMOREITEMS == hr)
+    for (DWORD i = 0; i < cRollbacks; ++i)
     {
-        hr = S_OK;
+        hr = WcaDoDeferredAction(CUSTOM_ACTION_DECORATION(L"ExecSecureObjectsRollback"), rgRollbacks[i].pwzCustomActionData, rgRollbacks[i].cObjects * COST_SECUREOBJECT);
+        ExitOnFailure(hr, "failed to schedule ExecSecureObjectsRollback for %u objects of type: %ls", rgRollbacks[i].cObjects, rgRollbacks[i].pwzTable);
     }
-    ExitOnFailure(hr, "failed while looping through all objects to schedule rollback for");
 
 LExit:
-    ReleaseStr(pwzCustomActionData);
-    ReleaseStr(pwzSecureObject);
-    ReleaseStr(pwzTable);
-    ReleaseStr(pwzTargetPath);
+    if (rgRollbacks)
+    {
+        // The table names are owned by the rows.
+        for (DWORD i = 0; i < cRollbacks; ++i)
+        {
+            ReleaseStr(rgRollbacks[i].pwzSecurityInfo);
+            ReleaseStr(rgRollbacks[i].pwzCustomActionData);
+        }
+
+        MemFree(rgRollbacks);
+    }
+
+    FreeSecureObjectRows(rgRows, cRows);
+    ReleaseStr(pwzSecurityInfo);
 
     if (FAILED(hr))
     {
@@ -579,7 +998,7 @@ LExit:
                    called as Type 1025 CustomAction (deferred binary DLL)
 
  NOTE: deferred CustomAction since it modifies the machine
- NOTE: CustomActionData == wzObject\twzTable\twzDomain\twzUser\tdwAttributes\tdwPermissions\t...
+ NOTE: CustomActionData == wzObject\twzTable\tcEntries\t(wzDomain\twzUser\tdwAttributes\tdwPermissions\t)...
 ******************************************************************/
 extern "C" UINT __stdcall ExecSecureObjects(
     __in MSIHANDLE hInstall
@@ -594,20 +1013,20 @@ extern "C" UINT __stdcall ExecSecureObjects(
     LPWSTR pwzObject = NULL;
     LPWSTR pwzTable = NULL;
     LPWSTR pwzDomain = NULL;
-    DWORD dwRevision = 0;
     LPWSTR pwzUser = NULL;
+    DWORD cEntries = 0;
     DWORD dwPermissions = 0;
     DWORD dwAttributes = 0;
-    LPWSTR pwzAccount = NULL;
-    PSID psid = NULL;
+    PSID psid = NULL;   // owned by rgAccounts
+
+    SECURE_OBJECT_ACCOUNT* rgAccounts = NULL;
+    DWORD cAccounts = 0;
 
     EXPLICIT_ACCESSW ea = {0};
+    EXPLICIT_ACCESSW* rgEntries = NULL;
+    DWORD cBatch = 0;
+    SECURE_OBJECT_PREPARED_ACL prepared = { };
     SE_OBJECT_TYPE objectType = SE_UNKNOWN_OBJECT_TYPE;
-    PSECURITY_DESCRIPTOR psd = NULL;
-    SECURITY_DESCRIPTOR_CONTROL sdc = {0};
-    SECURITY_INFORMATION si = {0};
-    PACL pAclExisting = NULL;   // doesn't get freed
-    PACL pAclNew = NULL;
 
     PMSIHANDLE hActionRec = ::MsiCreateRecord(1);
 
@@ -634,135 +1053,93 @@ extern "C" UINT __stdcall ExecSecureObjects(
 
         hr = WcaReadStringFromCaData(&pwz, &pwzTable);
         ExitOnFailure(hr, "failed to process CustomActionData");
-        hr = WcaReadStringFromCaData(&pwz, &pwzDomain);
-        ExitOnFailure(hr, "failed to process CustomActionData");
-        hr = WcaReadStringFromCaData(&pwz, &pwzUser);
-        ExitOnFailure(hr, "failed to process CustomActionData");
-        hr = WcaReadIntegerFromCaData(&pwz, reinterpret_cast<int*>(&dwAttributes));
-        ExitOnFailure(hr, "failed to process CustomActionData");
-        hr = WcaReadIntegerFromCaData(&pwz, reinterpret_cast<int*>(&dwPermissions));
+        hr = WcaReadIntegerFromCaData(&pwz, reinterpret_cast<int*>(&cEntries));
         ExitOnFailure(hr, "failed to process CustomActionData");
 
-        WcaLog(LOGMSG_VERBOSE, "Securing Object: %ls Type: %ls User: %ls", pwzObject, pwzTable, pwzUser);
-
-        //
-        // create the appropriate SID
-        //
-
-        // figure out the right user to put into the access block
-        if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Everyone"))
-        {
-            hr = AclGetWellKnownSid(WinWorldSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Administrators"))
-        {
-            hr = AclGetWellKnownSid(WinBuiltinAdministratorsSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"LocalSystem"))
-        {
-            hr = AclGetWellKnownSid(WinLocalSystemSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"LocalService"))
-        {
-            hr = AclGetWellKnownSid(WinLocalServiceSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"NetworkService"))
-        {
-            hr = AclGetWellKnownSid(WinNetworkServiceSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"AuthenticatedUser"))
-        {
-            hr = AclGetWellKnownSid(WinAuthenticatedUserSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Guests"))
-        {
-            hr = AclGetWellKnownSid(WinBuiltinGuestsSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"CREATOR OWNER"))
-        {
-            hr = AclGetWellKnownSid(WinCreatorOwnerSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"INTERACTIVE"))
-        {
-            hr = AclGetWellKnownSid(WinInteractiveSid, &psid);
-        }
-        else if (!*pwzDomain && 0 == lstrcmpW(pwzUser, L"Users"))
-        {
-            hr = AclGetWellKnownSid(WinBuiltinUsersSid, &psid);
-        }
-        else
-        {
-            hr = StrAllocFormatted(&pwzAccount, L"%s%s%s", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
-            ExitOnFailure(hr, "failed to build domain user name");
-
-            hr = AclGetAccountSid(NULL, pwzAccount, &psid);
-        }
-        ExitOnFailure(hr, "failed to get sid for account: %ls%ls%ls", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
-
-        //
-        // build up the explicit access
-        //
-        ea.grfAccessMode = SET_ACCESS;
-
-        if (dwAttributes & SECURE_OBJECT_ATTRIBUTE_INHERITABLE)
-        {
-            ea.grfInheritance = SUB_CONTAINERS_AND_OBJECTS_INHERIT;
-        }
-        else
-        {
-            ea.grfInheritance = NO_INHERITANCE;
-        }
-
-#pragma prefast(push)
-#pragma prefast(disable:25029)
-        ::BuildTrusteeWithSidW(&ea.Trustee, psid);
-#pragma prefast(pop)
-
         objectType = SEObjectTypeFromString(const_cast<LPCWSTR> (pwzTable));
 
-        // always add these permissions for services
-        // these are basic permissions that are often forgotten
-        if (0 == lstrcmpW(L"ServiceInstall", pwzTable))
+        if (SE_UNKNOWN_OBJECT_TYPE == objectType)
         {
-            dwPermissions |= SERVICE_QUERY_CONFIG | SERVICE_QUERY_STATUS | SERVICE_ENUMERATE_DEPENDENTS | SERVICE_INTERROGATE;
+            MessageExitOnFailure(hr = E_UNEXPECTED, msierrSecureObjectsUnknownType, "unknown object type: %ls", pwzTable);
         }
 
-        ea.grfAccessPermissions = dwPermissions;
+        cBatch = 0;
 
-        if (SE_UNKNOWN_OBJECT_TYPE != objectType)
+        for (DWORD i = 0; i < cEntries; ++i)
         {
-            er = ::GetNamedSecurityInfoW(pwzObject, objectType, DACL_SECURITY_INFORMATION, NULL, NULL, &pAclExisting, NULL, &psd);
-            ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to get security info for object: %ls", pwzObject);
-
-            //Need to see if DACL is protected so getting Descriptor information
-            if (!::GetSecurityDescriptorControl(psd, &sdc, &dwRevision))
+            hr = WcaReadStringFromCaData(&pwz, &pwzDomain);
+            ExitOnFailure(hr, "failed to process CustomActionData");
+            hr = WcaReadStringFromCaData(&pwz, &pwzUser);
+            ExitOnFailure(hr, "failed to process CustomActionData");
+            hr = WcaReadIntegerFromCaData(&pwz, reinterpret_cast<int*>(&dwAttributes));
+            ExitOnFailure(hr, "failed to process CustomActionData");
+            hr = WcaReadIntegerFromCaData(&pwz, reinterpret_cast<int*>(&dwPermissions));
+            ExitOnFailure(hr, "failed to process CustomActionData");
+
+            WcaLog(LOGMSG_VERBOSE, "Securing Object: %ls Type: %ls User: %ls", pwzObject, pwzTable, pwzUser);
+
+            //
+            // create the appropriate SID
+            //
+            hr = GetCachedAccountSid(pwzDomain, pwzUser, &rgAccounts, &cAccounts, &psid);
+            ExitOnFailure(hr, "failed to get sid for account: %ls%ls%ls", pwzDomain, *pwzDomain ? L"\\" : L"", pwzUser);
+
+            //
+            // build up the explicit access
+            //
+            memset(&ea, 0, sizeof(ea));
+            ea.grfAccessMode = SET_ACCESS;
+
+            if (dwAttributes & SECURE_OBJECT_ATTRIBUTE_INHERITABLE)
             {
-                ExitOnLastError(hr, "failed to get security descriptor control for object: %ls", pwzObject);
+                ea.grfInheritance = SUB_CONTAINERS_AND_OBJECTS_INHERIT;
+            }
+            else
+            {
+                ea.grfInheritance = NO_INHERITANCE;
             }
 
 #pragma prefast(push)
 #pragma prefast(disable:25029)
-            er = ::SetEntriesInAclW(1, &ea, pAclExisting, &pAclNew);
+            ::BuildTrusteeWithSidW(&ea.Trustee, psid);
 #pragma prefast(pop)
-            ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to add ACLs for object: %ls", pwzObject);
 
-            if (sdc & SE_DACL_PROTECTED)
+            // always add these permissions for services
+            // these are basic permissions that are often forgotten
+            if (0 == lstrcmpW(L"ServiceInstall", pwzTable))
             {
-                si = DACL_SECURITY_INFORMATION | PROTECTED_DACL_SECURITY_INFORMATION;
+                dwPermissions |= SERVICE_QUERY_CONFIG | SERVICE_QUERY_STATUS | SERVICE_ENUMERATE_DEPENDENTS | SERVICE_INTERROGATE;
             }
-            else
+
+            ea.grfAccessPermissions = dwPermissions;
+
+            // A later entry for the same account replaces the earlier one, so apply what we have before adding it.
+            for (DWORD j = 0; j < cBatch; ++j)
             {
-                si = DACL_SECURITY_INFORMATION;
+                if (::EqualSid(psid, reinterpret_cast<PSID>(rgEntries[j].Trustee.ptstrName)))
+                {
+                    hr = ApplySecureObjectEntries(pwzObject, objectType, rgEntries, cBatch, &prepared);
+                    ExitOnFailure(hr, "failed to secure object: %ls", pwzObject);
+
+                    cBatch = 0;
+                    break;
+                }
             }
-            er = ::SetNamedSecurityInfoW(pwzObject, objectType, si, NULL, NULL, pAclNew, NULL);
-            MessageExitOnFailure(hr = HRESULT_FROM_WIN32(er), msierrSecureObjectsFailedSet, "failed to set security info for object: %ls", pwzObject);
+
+            hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&rgEntries), cBatch + 1, sizeof(EXPLICIT_ACCESSW), 4);
+            ExitOnFailure(hr, "failed to grow array of access entries");
+
+            rgEntries[cBatch] = ea;
+            ++cBatch;
         }
-        else
+
+        if (cBatch)
         {
-            MessageExitOnFailure(hr = E_UNEXPECTED, msierrSecureObjectsUnknownType, "unknown object type: %ls", pwzTable);
+            hr = ApplySecureObjectEntries(pwzObject, objectType, rgEntries, cBatch, &prepared);
+            ExitOnFailure(hr, "failed to secure object: %ls", pwzObject);
         }
 
-        hr = WcaProgressMessage(COST_SECUREOBJECT, FALSE);
+        hr = WcaProgressMessage(COST_SECUREOBJECT * cEntries, FALSE);
         ExitOnFailure(hr, "failed to send progress message");
 
         objectType = SE_UNKNOWN_OBJECT_TYPE;
@@ -774,19 +1151,19 @@ LExit:
     ReleaseStr(pwzTable);
     ReleaseStr(pwzObject);
     ReleaseStr(pwzData);
-    ReleaseStr(pwzAccount);
 
-    if (pAclNew)
-    {
-        ::LocalFree(pAclNew);
-    }
-    if (psd)
-    {
-        ::LocalFree(psd);
-    }
-    if (psid)
+    ReleasePreparedAcl(&prepared);
+    ReleaseMem(rgEntries);
+
+    if (rgAccounts)
     {
-        AclFreeSid(psid);
+        for (DWORD i = 0; i < cAccounts; ++i)
+        {
+            ReleaseStr(rgAccounts[i].pwzAccount);
+            ReleaseSid(rgAccounts[i].psid);
+        }
+
+        MemFree(rgAccounts);
     }
 
     if (FAILED(hr))
@@ -796,12 +1173,19 @@ LExit:
     return WcaFinalize(er);
 }
 
+/******************************************************************
+ ExecSecureObjectsRollback - restores the DACL captured for a group
+   of objects of the same type.
+
+ NOTE: CustomActionData == wzTable\twzSecurityInfo\tfProtected\twzObject\t...
+******************************************************************/
 extern "C" UINT __stdcall ExecSecureObjectsRollback(
     __in MSIHANDLE hInstall
     )
 {
 //    AssertSz(FALSE, "debug ExecSecureObjectsRollback");
     HRESULT hr = S_OK;
+    HRESULT hrRestore = S_OK;
     DWORD er = ERROR_SUCCESS;
 
     LPWSTR pwz = NULL;
@@ -832,9 +1216,6 @@ extern "C" UINT __stdcall ExecSecureObjectsRollback(
 
     pwz = pwzData;
 
-    hr = WcaReadStringFromCaData(&pwz, &pwzObject);
-    ExitOnFailure(hr, "failed to process CustomActionData");
-
     hr = WcaReadStringFromCaData(&pwz, &pwzTable);
     ExitOnFailure(hr, "failed to process CustomActionData");
 
@@ -869,7 +1250,7 @@ extern "C" UINT __stdcall ExecSecureObjectsRollback(
         //Need to see if DACL is protected so getting Descriptor information
         if (!::GetSecurityDescriptorControl(psd, &sdc, &dwRevision))
         {
-            ExitOnLastError(hr, "failed to get security descriptor control for object: %ls", pwzObject);
+            ExitOnLastError(hr, "failed to get security descriptor control for security info: %ls", pwzSecurityInfo);
         }
 
         // Write a 1 if DACL is protected, 0 otherwise
@@ -889,8 +1270,21 @@ extern "C" UINT __stdcall ExecSecureObjectsRollback(
             break;
         }
 
-        er = ::SetNamedSecurityInfoW(pwzObject, objectType, si, NULL, NULL, pDacl, NULL);
-        ExitOnFailure(hr = HRESULT_FROM_WIN32(er), "failed to set security info for object: %ls error code: %d", pwzObject, GetLastError());
+        // Restore every object in the group even if one of them fails
+        while (pwz && *pwz)
+        {
+            hr = WcaReadStringFromCaData(&pwz, &pwzObject);
+            ExitOnFailure(hr, "failed to process CustomActionData");
+
+            er = ::SetNamedSecurityInfoW(pwzObject, objectType, si, NULL, NULL, pDacl, NULL);
+            if (ERROR_SUCCESS != er)
+            {
+                hrRestore = HRESULT_FROM_WIN32(er);
+                WcaLog(LOGMSG_STANDARD, "failed to set security info for object: %ls error code: %u - continuing", pwzObject, er);
+            }
+        }
+
+        ExitOnFailure(hr = hrRestore, "failed to set security info for one or more objects");
     }
     else
     {
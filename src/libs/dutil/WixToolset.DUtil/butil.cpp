@@ -41,32 +41,80 @@ typedef struct _BUNDLE_QUERY_CONTEXT
     PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback;
     LPVOID pvContext;
 
-    LPCWSTR* rgwzDetectCodes;
+    STRINGDICT_HANDLE sdDetectCodes;
+    STRINGDICT_HANDLE sdUpgradeCodes;
+    STRINGDICT_HANDLE sdAddonCodes;
+    STRINGDICT_HANDLE sdPatchCodes;
+} BUNDLE_QUERY_CONTEXT;
+
+typedef struct _BUNDLE_SNAPSHOT_ENTRY
+{
+    LPWSTR sczBundleId;
+
+    LPWSTR* rgsczDetectCodes;
     DWORD cDetectCodes;
 
-    LPCWSTR* rgwzUpgradeCodes;
+    LPWSTR* rgsczUpgradeCodes;
     DWORD cUpgradeCodes;
 
-    LPCWSTR* rgwzAddonCodes;
+    LPWSTR* rgsczAddonCodes;
     DWORD cAddonCodes;
 
-    LPCWSTR* rgwzPatchCodes;
+    LPWSTR* rgsczPatchCodes;
     DWORD cPatchCodes;
-} BUNDLE_QUERY_CONTEXT;
+} BUNDLE_SNAPSHOT_ENTRY;
+
+typedef struct _BUNDLE_SNAPSHOT_VIEW
+{
+    BOOL fLoaded;
+
+    BUNDLE_SNAPSHOT_ENTRY* rgEntries;
+    DWORD cEntries;
+} BUNDLE_SNAPSHOT_VIEW;
+
+typedef struct _BUNDLE_SNAPSHOT
+{
+    // Indexed by BUNDLE_INSTALL_CONTEXT then by 32-bit (0) or 64-bit (1) registry view.
+    BUNDLE_SNAPSHOT_VIEW rgViews[2][2];
+} BUNDLE_SNAPSHOT;
 
 // Forward declarations.
 static HRESULT QueryRelatedBundlesForScopeAndBitness(
-    __in BUNDLE_QUERY_CONTEXT* pQueryContext
+    __in BUNDLE_QUERY_CONTEXT* pQueryContext,
+    __in BUNDLE_SNAPSHOT* pSnapshot
     );
 static HRESULT QueryPotentialRelatedBundle(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext,
-    __in HKEY hkUninstallKey,
-    __in_z LPCWSTR wzRelatedBundleId,
+    __in BUNDLE_SNAPSHOT_ENTRY* pEntry,
+    __inout HKEY* phkUninstallKey,
     __inout BUNDLE_QUERY_CALLBACK_RESULT* pResult
     );
+static HRESULT CreateCodeDictionary(
+    __in_ecount_opt(cCodes) LPCWSTR* rgwzCodes,
+    __in DWORD cCodes,
+    __out STRINGDICT_HANDLE* psdCodes
+    );
+static HRESULT LoadSnapshotView(
+    __in BUNDLE_SNAPSHOT* pSnapshot,
+    __in BUNDLE_INSTALL_CONTEXT installContext,
+    __in REG_KEY_BITNESS regBitness,
+    __out BUNDLE_SNAPSHOT_VIEW** ppView
+    );
+static HRESULT ReadBundleCodes(
+    __in HKEY hkBundleId,
+    __inout BUNDLE_SNAPSHOT_ENTRY* pEntry
+    );
+static void UninitializeSnapshotEntry(
+    __in BUNDLE_SNAPSHOT_ENTRY* pEntry
+    );
+static HRESULT MatchCodes(
+    __in_opt STRINGDICT_HANDLE sdQueryCodes,
+    __in_ecount(cCodes) LPWSTR* rgsczCodes,
+    __in DWORD cCodes
+    );
 static HRESULT DetermineRelationType(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext,
-    __in HKEY hkBundleId,
+    __in BUNDLE_SNAPSHOT_ENTRY* pEntry,
     __out BUNDLE_RELATION_TYPE* pRelationType
     );
 /********************************************************************
@@ -187,17 +235,19 @@ DAPI_(HRESULT) BundleEnumRelatedBundle(
     LPWSTR sczUninstallSubKeyPath = NULL;
     HKEY hkRoot = BUNDLE_INSTALL_CONTEXT_USER == context ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
     BUNDLE_QUERY_CONTEXT queryContext = { };
+    BUNDLE_SNAPSHOT_ENTRY entry = { };
     BUNDLE_RELATION_TYPE relationType = BUNDLE_RELATION_NONE;
 
     queryContext.installContext = context;
-    queryContext.rgwzUpgradeCodes = &wzUpgradeCode;
-    queryContext.cUpgradeCodes = 1;
 
     if (!wzUpgradeCode || !pdwStartIndex)
     {
         ButilExitOnFailure(hr = E_INVALIDARG, "An invalid parameter was passed to the function.");
     }
 
+    hr = CreateCodeDictionary(&wzUpgradeCode, 1, &queryContext.sdUpgradeCodes);
+    ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "upgrade codes");
+
     hr = RegOpenEx(hkRoot, BUNDLE_REGISTRATION_REGISTRY_UNINSTALL_KEY, KEY_READ, kbKeyBitness, &hkUninstall);
     ButilExitOnFailure(hr, "Failed to open bundle uninstall key path.");
 
@@ -212,7 +262,10 @@ DAPI_(HRESULT) BundleEnumRelatedBundle(
         hr = RegOpenEx(hkRoot, sczUninstallSubKeyPath, KEY_READ, kbKeyBitness, &hkBundle);
         ButilExitOnFailure(hr, "Failed to open uninstall key path.");
 
-        hr = DetermineRelationType(&queryContext, hkBundle, &relationType);
+        hr = ReadBundleCodes(hkBundle, &entry);
+        ButilExitOnFailure(hr, "Failed to read codes for potential related bundle: %ls", sczUninstallSubKey);
+
+        hr = DetermineRelationType(&queryContext, &entry, &relationType);
         if (SUCCEEDED(hr) && BUNDLE_RELATION_UPGRADE == relationType)
         {
             fUpgradeCodeFound = TRUE;
@@ -228,10 +281,13 @@ DAPI_(HRESULT) BundleEnumRelatedBundle(
         }
 
         // Cleanup before next iteration
+        UninitializeSnapshotEntry(&entry);
         ReleaseRegKey(hkBundle);
     }
 
 LExit:
+    UninitializeSnapshotEntry(&entry);
+    ReleaseDict(queryContext.sdUpgradeCodes);
     ReleaseStr(sczUninstallSubKey);
     ReleaseStr(sczUninstallSubKeyPath);
     ReleaseRegKey(hkBundle);
@@ -358,8 +414,49 @@ DAPI_(HRESULT) BundleQueryRelatedBundles(
     __in PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback,
     __in_opt LPVOID pvContext
     )
+{
+    return BundleSnapshotQueryRelatedBundles(NULL, installContext, rgwzDetectCodes, cDetectCodes, rgwzUpgradeCodes, cUpgradeCodes, rgwzAddonCodes, cAddonCodes, rgwzPatchCodes, cPatchCodes, pfnCallback, pvContext);
+}
+
+DAPI_(HRESULT) BundleSnapshotCreate(
+    __out BUNDLE_SNAPSHOT_HANDLE* phSnapshot
+    )
+{
+    HRESULT hr = S_OK;
+    BUNDLE_SNAPSHOT* pSnapshot = NULL;
+
+    ButilExitOnNull(phSnapshot, hr, E_INVALIDARG, "Handle not specified while creating bundle snapshot.");
+
+    pSnapshot = reinterpret_cast<BUNDLE_SNAPSHOT*>(MemAlloc(sizeof(BUNDLE_SNAPSHOT), TRUE));
+    ButilExitOnNull(pSnapshot, hr, E_OUTOFMEMORY, "Failed to allocate bundle snapshot.");
+
+    *phSnapshot = pSnapshot;
+    pSnapshot = NULL;
+
+LExit:
+    ReleaseMem(pSnapshot);
+
+    return hr;
+}
+
+DAPI_(HRESULT) BundleSnapshotQueryRelatedBundles(
+    __in_opt BUNDLE_SNAPSHOT_HANDLE hSnapshot,
+    __in BUNDLE_INSTALL_CONTEXT installContext,
+    __in_z_opt LPCWSTR* rgwzDetectCodes,
+    __in DWORD cDetectCodes,
+    __in_z_opt LPCWSTR* rgwzUpgradeCodes,
+    __in DWORD cUpgradeCodes,
+    __in_z_opt LPCWSTR* rgwzAddonCodes,
+    __in DWORD cAddonCodes,
+    __in_z_opt LPCWSTR* rgwzPatchCodes,
+    __in DWORD cPatchCodes,
+    __in PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback,
+    __in_opt LPVOID pvContext
+    )
 {
     HRESULT hr = S_OK;
+    BUNDLE_SNAPSHOT_HANDLE hTemporarySnapshot = NULL;
+    BUNDLE_SNAPSHOT* pSnapshot = static_cast<BUNDLE_SNAPSHOT*>(hSnapshot);
     BUNDLE_QUERY_CONTEXT queryContext = { };
     BOOL fSearch64 = TRUE;
 
@@ -368,67 +465,98 @@ DAPI_(HRESULT) BundleQueryRelatedBundles(
     ProcWow64(::GetCurrentProcess(), &fSearch64);
 #endif
 
+    if (!pSnapshot)
+    {
+        hr = BundleSnapshotCreate(&hTemporarySnapshot);
+        ButilExitOnFailure(hr, "Failed to create temporary bundle snapshot.");
+
+        pSnapshot = static_cast<BUNDLE_SNAPSHOT*>(hTemporarySnapshot);
+    }
+
     queryContext.installContext = installContext;
-    queryContext.rgwzDetectCodes = rgwzDetectCodes;
-    queryContext.cDetectCodes = cDetectCodes;
-    queryContext.rgwzUpgradeCodes = rgwzUpgradeCodes;
-    queryContext.cUpgradeCodes = cUpgradeCodes;
-    queryContext.rgwzAddonCodes = rgwzAddonCodes;
-    queryContext.cAddonCodes = cAddonCodes;
-    queryContext.rgwzPatchCodes = rgwzPatchCodes;
-    queryContext.cPatchCodes = cPatchCodes;
     queryContext.pfnCallback = pfnCallback;
     queryContext.pvContext = pvContext;
 
+    hr = CreateCodeDictionary(rgwzDetectCodes, cDetectCodes, &queryContext.sdDetectCodes);
+    ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "detect codes");
+
+    hr = CreateCodeDictionary(rgwzUpgradeCodes, cUpgradeCodes, &queryContext.sdUpgradeCodes);
+    ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "upgrade codes");
+
+    hr = CreateCodeDictionary(rgwzAddonCodes, cAddonCodes, &queryContext.sdAddonCodes);
+    ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "addon codes");
+
+    hr = CreateCodeDictionary(rgwzPatchCodes, cPatchCodes, &queryContext.sdPatchCodes);
+    ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "patch codes");
+
     queryContext.regBitness = REG_KEY_32BIT;
 
-    hr = QueryRelatedBundlesForScopeAndBitness(&queryContext);
+    hr = QueryRelatedBundlesForScopeAndBitness(&queryContext, pSnapshot);
     ButilExitOnFailure(hr, "Failed to query 32-bit related bundles.");
 
     if (fSearch64)
     {
         queryContext.regBitness = REG_KEY_64BIT;
 
-        hr = QueryRelatedBundlesForScopeAndBitness(&queryContext);
+        hr = QueryRelatedBundlesForScopeAndBitness(&queryContext, pSnapshot);
         ButilExitOnFailure(hr, "Failed to query 64-bit related bundles.");
     }
 
 LExit:
+    ReleaseDict(queryContext.sdPatchCodes);
+    ReleaseDict(queryContext.sdAddonCodes);
+    ReleaseDict(queryContext.sdUpgradeCodes);
+    ReleaseDict(queryContext.sdDetectCodes);
+    ReleaseBundleSnapshot(hTemporarySnapshot);
+
     return hr;
 }
 
+DAPI_(void) BundleSnapshotDestroy(
+    __in BUNDLE_SNAPSHOT_HANDLE hSnapshot
+    )
+{
+    BUNDLE_SNAPSHOT* pSnapshot = static_cast<BUNDLE_SNAPSHOT*>(hSnapshot);
+
+    if (pSnapshot)
+    {
+        for (DWORD i = 0; i < countof(pSnapshot->rgViews); ++i)
+        {
+            for (DWORD j = 0; j < countof(pSnapshot->rgViews[i]); ++j)
+            {
+                BUNDLE_SNAPSHOT_VIEW* pView = &pSnapshot->rgViews[i][j];
+
+                for (DWORD k = 0; k < pView->cEntries; ++k)
+                {
+                    UninitializeSnapshotEntry(pView->rgEntries + k);
+                }
+
+                ReleaseMem(pView->rgEntries);
+            }
+        }
+
+        MemFree(pSnapshot);
+    }
+}
+
 static HRESULT QueryRelatedBundlesForScopeAndBitness(
-    __in BUNDLE_QUERY_CONTEXT* pQueryContext
+    __in BUNDLE_QUERY_CONTEXT* pQueryContext,
+    __in BUNDLE_SNAPSHOT* pSnapshot
     )
 {
     HRESULT hr = S_OK;
-    HKEY hkRoot = BUNDLE_INSTALL_CONTEXT_USER == pQueryContext->installContext ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
     HKEY hkUninstallKey = NULL;
-    BOOL fExists = FALSE;
-    LPWSTR sczRelatedBundleId = NULL;
+    BUNDLE_SNAPSHOT_VIEW* pView = NULL;
     BUNDLE_QUERY_CALLBACK_RESULT result = BUNDLE_QUERY_CALLBACK_RESULT_CONTINUE;
 
-    hr = RegOpenEx(hkRoot, BUNDLE_REGISTRATION_REGISTRY_UNINSTALL_KEY, KEY_READ, pQueryContext->regBitness, &hkUninstallKey);
-    ButilExitOnPathFailure(hr, fExists, "Failed to open uninstall registry key.");
-
-    if (!fExists)
-    {
-        ExitFunction1(hr = S_OK);
-    }
+    hr = LoadSnapshotView(pSnapshot, pQueryContext->installContext, pQueryContext->regBitness, &pView);
+    ButilExitOnFailure(hr, "Failed to load uninstall registry key snapshot.");
 
-    for (DWORD dwIndex = 0; /* exit via break below */; ++dwIndex)
+    for (DWORD i = 0; i < pView->cEntries; ++i)
     {
-        hr = RegKeyEnum(hkUninstallKey, dwIndex, &sczRelatedBundleId);
-        if (E_NOMOREITEMS == hr)
-        {
-            hr = S_OK;
-            break;
-        }
-        ButilExitOnFailure(hr, "Failed to enumerate uninstall key for related bundles.");
-
         // Ignore failures here since we'll often find products that aren't actually
         // related bundles (or even bundles at all).
-        HRESULT hrRelatedBundle = QueryPotentialRelatedBundle(pQueryContext, hkUninstallKey, sczRelatedBundleId, &result);
+        HRESULT hrRelatedBundle = QueryPotentialRelatedBundle(pQueryContext, pView->rgEntries + i, &hkUninstallKey, &result);
         if (SUCCEEDED(hrRelatedBundle) && BUNDLE_QUERY_CALLBACK_RESULT_CONTINUE != result)
         {
             ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_REQUEST_ABORTED));
@@ -436,7 +564,6 @@ static HRESULT QueryRelatedBundlesForScopeAndBitness(
     }
 
 LExit:
-    ReleaseStr(sczRelatedBundleId);
     ReleaseRegKey(hkUninstallKey);
 
     return hr;
@@ -444,28 +571,36 @@ LExit:
 
 static HRESULT QueryPotentialRelatedBundle(
     __in BUNDLE_QUERY_CONTEXT* pQueryContext,
-    __in HKEY hkUninstallKey,
-    __in_z LPCWSTR wzRelatedBundleId,
+    __in BUNDLE_SNAPSHOT_ENTRY* pEntry,
+    __inout HKEY* phkUninstallKey,
     __inout BUNDLE_QUERY_CALLBACK_RESULT* pResult
     )
 {
     HRESULT hr = S_OK;
+    HKEY hkRoot = BUNDLE_INSTALL_CONTEXT_USER == pQueryContext->installContext ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
     HKEY hkBundleId = NULL;
     BUNDLE_RELATION_TYPE relationType = BUNDLE_RELATION_NONE;
     BUNDLE_QUERY_RELATED_BUNDLE_RESULT bundle = { };
 
-    hr = RegOpenEx(hkUninstallKey, wzRelatedBundleId, KEY_READ, pQueryContext->regBitness, &hkBundleId);
-    ButilExitOnFailure(hr, "Failed to open uninstall key for potential related bundle: %ls", wzRelatedBundleId);
-
-    hr = DetermineRelationType(pQueryContext, hkBundleId, &relationType);
+    hr = DetermineRelationType(pQueryContext, pEntry, &relationType);
     if (FAILED(hr))
     {
         ExitFunction();
     }
 
+    // Only related bundles are handed to the callback so the uninstall key is opened on the first match.
+    if (!*phkUninstallKey)
+    {
+        hr = RegOpenEx(hkRoot, BUNDLE_REGISTRATION_REGISTRY_UNINSTALL_KEY, KEY_READ, pQueryContext->regBitness, phkUninstallKey);
+        ButilExitOnFailure(hr, "Failed to open uninstall registry key.");
+    }
+
+    hr = RegOpenEx(*phkUninstallKey, pEntry->sczBundleId, KEY_READ, pQueryContext->regBitness, &hkBundleId);
+    ButilExitOnFailure(hr, "Failed to open uninstall key for potential related bundle: %ls", pEntry->sczBundleId);
+
     bundle.installContext = pQueryContext->installContext;
     bundle.regBitness = pQueryContext->regBitness;
-    bundle.wzBundleId = wzRelatedBundleId;
+    bundle.wzBundleId = pEntry->sczBundleId;
     bundle.relationType = relationType;
     bundle.hkBundle = hkBundleId;
 
@@ -477,255 +612,319 @@ LExit:
     return hr;
 }
 
-static HRESULT DetermineRelationType(
-    __in BUNDLE_QUERY_CONTEXT* pQueryContext,
-    __in HKEY hkBundleId,
-    __out BUNDLE_RELATION_TYPE* pRelationType
+static HRESULT CreateCodeDictionary(
+    __in_ecount_opt(cCodes) LPCWSTR* rgwzCodes,
+    __in DWORD cCodes,
+    __out STRINGDICT_HANDLE* psdCodes
     )
 {
     HRESULT hr = S_OK;
-    LPWSTR* rgsczUpgradeCodes = NULL;
-    DWORD cUpgradeCodes = 0;
-    STRINGDICT_HANDLE sdUpgradeCodes = NULL;
-    LPWSTR* rgsczAddonCodes = NULL;
-    DWORD cAddonCodes = 0;
-    STRINGDICT_HANDLE sdAddonCodes = NULL;
-    LPWSTR* rgsczDetectCodes = NULL;
-    DWORD cDetectCodes = 0;
-    STRINGDICT_HANDLE sdDetectCodes = NULL;
-    LPWSTR* rgsczPatchCodes = NULL;
-    DWORD cPatchCodes = 0;
-    STRINGDICT_HANDLE sdPatchCodes = NULL;
 
-    *pRelationType = BUNDLE_RELATION_NONE;
+    *psdCodes = NULL;
 
-    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &rgsczUpgradeCodes, &cUpgradeCodes);
-    if (HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE) == hr)
+    if (cCodes)
     {
-        TraceError(hr, "Failed to read upgrade codes as REG_MULTI_SZ. Trying again as REG_SZ in case of older bundles.");
+        hr = DictCreateStringListFromArray(psdCodes, rgwzCodes, cCodes, DICT_FLAG_CASEINSENSITIVE);
+    }
 
-        rgsczUpgradeCodes = reinterpret_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR), TRUE));
-        ButilExitOnNull(rgsczUpgradeCodes, hr, E_OUTOFMEMORY, "Failed to allocate list for a single upgrade code from older bundle.");
+    return hr;
+}
 
-        hr = RegReadString(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &rgsczUpgradeCodes[0]);
-        if (SUCCEEDED(hr))
-        {
-            cUpgradeCodes = 1;
-        }
-    }
+static HRESULT LoadSnapshotView(
+    __in BUNDLE_SNAPSHOT* pSnapshot,
+    __in BUNDLE_INSTALL_CONTEXT installContext,
+    __in REG_KEY_BITNESS regBitness,
+    __out BUNDLE_SNAPSHOT_VIEW** ppView
+    )
+{
+    HRESULT hr = S_OK;
+    HKEY hkRoot = BUNDLE_INSTALL_CONTEXT_USER == installContext ? HKEY_CURRENT_USER : HKEY_LOCAL_MACHINE;
+    BUNDLE_SNAPSHOT_VIEW* pView = &pSnapshot->rgViews[BUNDLE_INSTALL_CONTEXT_USER == installContext ? 1 : 0][REG_KEY_64BIT == regBitness ? 1 : 0];
+    HKEY hkUninstallKey = NULL;
+    HKEY hkBundleId = NULL;
+    BOOL fExists = FALSE;
+    BUNDLE_SNAPSHOT_ENTRY entry = { };
 
-    // Compare upgrade codes.
-    if (SUCCEEDED(hr))
+    if (pView->fLoaded)
     {
-        hr = DictCreateStringListFromArray(&sdUpgradeCodes, rgsczUpgradeCodes, cUpgradeCodes, DICT_FLAG_CASEINSENSITIVE);
-        ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "upgrade codes");
+        ExitFunction();
+    }
+
+    hr = RegOpenEx(hkRoot, BUNDLE_REGISTRATION_REGISTRY_UNINSTALL_KEY, KEY_READ, regBitness, &hkUninstallKey);
+    ButilExitOnPathFailure(hr, fExists, "Failed to open uninstall registry key.");
 
-        // Upgrade relationship: when their upgrade codes match our upgrade codes.
-        hr = DictCompareStringListToArray(sdUpgradeCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzUpgradeCodes), pQueryContext->cUpgradeCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
+    for (DWORD dwIndex = 0; fExists; ++dwIndex)
+    {
+        hr = RegKeyEnum(hkUninstallKey, dwIndex, &entry.sczBundleId);
+        if (E_NOMOREITEMS == hr)
         {
             hr = S_OK;
+            break;
         }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for upgrade code match.");
-
-            *pRelationType = BUNDLE_RELATION_UPGRADE;
-            ExitFunction();
-        }
+        ButilExitOnFailure(hr, "Failed to enumerate uninstall key for related bundles.");
 
-        // Detect relationship: when their upgrade codes match our detect codes.
-        hr = DictCompareStringListToArray(sdUpgradeCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzDetectCodes), pQueryContext->cDetectCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
+        // Ignore keys that can't be opened, they can't be queried as related bundles either.
+        hr = RegOpenEx(hkUninstallKey, entry.sczBundleId, KEY_READ, regBitness, &hkBundleId);
+        if (FAILED(hr))
         {
             hr = S_OK;
+            continue;
         }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for detect code match.");
 
-            *pRelationType = BUNDLE_RELATION_DETECT;
-            ExitFunction();
-        }
+        hr = ReadBundleCodes(hkBundleId, &entry);
+        ButilExitOnFailure(hr, "Failed to read codes for potential related bundle: %ls", entry.sczBundleId);
 
-        // Dependent relationship: when their upgrade codes match our addon codes.
-        hr = DictCompareStringListToArray(sdUpgradeCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzAddonCodes), pQueryContext->cAddonCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
-        }
-        else
+        ReleaseRegKey(hkBundleId);
+
+        // Most uninstall entries are not bundles so only keep the ones that could be related.
+        if (entry.cDetectCodes || entry.cUpgradeCodes || entry.cAddonCodes || entry.cPatchCodes)
         {
-            ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
+            hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pView->rgEntries), pView->cEntries, 1, sizeof(BUNDLE_SNAPSHOT_ENTRY), 16);
+            ButilExitOnFailure(hr, "Failed to grow bundle snapshot.");
 
-            *pRelationType = BUNDLE_RELATION_DEPENDENT_ADDON;
-            ExitFunction();
-        }
+            pView->rgEntries[pView->cEntries] = entry;
+            ++pView->cEntries;
 
-        // Dependent relationship: when their upgrade codes match our patch codes.
-        hr = DictCompareStringListToArray(sdUpgradeCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzPatchCodes), pQueryContext->cPatchCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
+            memset(&entry, 0, sizeof(entry));
         }
         else
         {
-            ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
-
-            *pRelationType = BUNDLE_RELATION_DEPENDENT_PATCH;
-            ExitFunction();
+            UninitializeSnapshotEntry(&entry);
         }
-
-        ReleaseNullDict(sdUpgradeCodes);
-        ReleaseNullStrArray(rgsczUpgradeCodes, cUpgradeCodes);
     }
 
-    // Compare addon codes.
-    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_ADDON_CODE, &rgsczAddonCodes, &cAddonCodes);
+    pView->fLoaded = TRUE;
+
+LExit:
     if (SUCCEEDED(hr))
     {
-        hr = DictCreateStringListFromArray(&sdAddonCodes, rgsczAddonCodes, cAddonCodes, DICT_FLAG_CASEINSENSITIVE);
-        ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "addon codes");
+        *ppView = pView;
+    }
 
-        // Addon relationship: when their addon codes match our detect codes.
-        hr = DictCompareStringListToArray(sdAddonCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzDetectCodes), pQueryContext->cDetectCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
-        }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
+    UninitializeSnapshotEntry(&entry);
+    ReleaseRegKey(hkBundleId);
+    ReleaseRegKey(hkUninstallKey);
 
-            *pRelationType = BUNDLE_RELATION_ADDON;
-            ExitFunction();
-        }
+    return hr;
+}
+
+static HRESULT ReadBundleCodes(
+    __in HKEY hkBundleId,
+    __inout BUNDLE_SNAPSHOT_ENTRY* pEntry
+    )
+{
+    HRESULT hr = S_OK;
 
-        // Addon relationship: when their addon codes match our upgrade codes.
-        hr = DictCompareStringListToArray(sdAddonCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzUpgradeCodes), pQueryContext->cUpgradeCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
+    // Missing or unreadable values just mean the bundle can't be related by that kind of code.
+    // A read that fails partway can leave some strings behind, so drop whatever it allocated.
+    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &pEntry->rgsczUpgradeCodes, &pEntry->cUpgradeCodes);
+    if (HRESULT_FROM_WIN32(ERROR_INVALID_DATATYPE) == hr)
+    {
+        TraceError(hr, "Failed to read upgrade codes as REG_MULTI_SZ. Trying again as REG_SZ in case of older bundles.");
+
+        pEntry->rgsczUpgradeCodes = reinterpret_cast<LPWSTR*>(MemAlloc(sizeof(LPWSTR), TRUE));
+        ButilExitOnNull(pEntry->rgsczUpgradeCodes, hr, E_OUTOFMEMORY, "Failed to allocate list for a single upgrade code from older bundle.");
+
+        hr = RegReadString(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_UPGRADE_CODE, &pEntry->rgsczUpgradeCodes[0]);
+        if (SUCCEEDED(hr))
         {
-            hr = S_OK;
+            pEntry->cUpgradeCodes = 1;
         }
         else
         {
-            ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
-
-            *pRelationType = BUNDLE_RELATION_ADDON;
-            ExitFunction();
+            ReleaseStr(pEntry->rgsczUpgradeCodes[0]);
+            ReleaseNullMem(pEntry->rgsczUpgradeCodes);
         }
+    }
+    else if (FAILED(hr))
+    {
+        ReleaseNullStrArray(pEntry->rgsczUpgradeCodes, pEntry->cUpgradeCodes);
+    }
 
-        ReleaseNullDict(sdAddonCodes);
-        ReleaseNullStrArray(rgsczAddonCodes, cAddonCodes);
+    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_ADDON_CODE, &pEntry->rgsczAddonCodes, &pEntry->cAddonCodes);
+    if (FAILED(hr))
+    {
+        ReleaseNullStrArray(pEntry->rgsczAddonCodes, pEntry->cAddonCodes);
     }
 
-    // Compare patch codes.
-    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_PATCH_CODE, &rgsczPatchCodes, &cPatchCodes);
-    if (SUCCEEDED(hr))
+    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_PATCH_CODE, &pEntry->rgsczPatchCodes, &pEntry->cPatchCodes);
+    if (FAILED(hr))
     {
-        hr = DictCreateStringListFromArray(&sdPatchCodes, rgsczPatchCodes, cPatchCodes, DICT_FLAG_CASEINSENSITIVE);
-        ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "patch codes");
+        ReleaseNullStrArray(pEntry->rgsczPatchCodes, pEntry->cPatchCodes);
+    }
 
-        // Patch relationship: when their patch codes match our detect codes.
-        hr = DictCompareStringListToArray(sdPatchCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzDetectCodes), pQueryContext->cDetectCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
-        }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
+    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_DETECT_CODE, &pEntry->rgsczDetectCodes, &pEntry->cDetectCodes);
+    if (FAILED(hr))
+    {
+        ReleaseNullStrArray(pEntry->rgsczDetectCodes, pEntry->cDetectCodes);
+    }
 
-            *pRelationType = BUNDLE_RELATION_PATCH;
-            ExitFunction();
-        }
+    hr = S_OK;
 
-        // Patch relationship: when their patch codes match our upgrade codes.
-        hr = DictCompareStringListToArray(sdPatchCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzUpgradeCodes), pQueryContext->cUpgradeCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
-        }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
+LExit:
+    if (FAILED(hr))
+    {
+        ReleaseNullStrArray(pEntry->rgsczUpgradeCodes, pEntry->cUpgradeCodes);
+        ReleaseNullStrArray(pEntry->rgsczAddonCodes, pEntry->cAddonCodes);
+        ReleaseNullStrArray(pEntry->rgsczPatchCodes, pEntry->cPatchCodes);
+        ReleaseNullStrArray(pEntry->rgsczDetectCodes, pEntry->cDetectCodes);
+    }
 
-            *pRelationType = BUNDLE_RELATION_PATCH;
-            ExitFunction();
-        }
+    return hr;
+}
+
+static void UninitializeSnapshotEntry(
+    __in BUNDLE_SNAPSHOT_ENTRY* pEntry
+    )
+{
+    ReleaseStr(pEntry->sczBundleId);
+    ReleaseStrArray(pEntry->rgsczDetectCodes, pEntry->cDetectCodes);
+    ReleaseStrArray(pEntry->rgsczUpgradeCodes, pEntry->cUpgradeCodes);
+    ReleaseStrArray(pEntry->rgsczAddonCodes, pEntry->cAddonCodes);
+    ReleaseStrArray(pEntry->rgsczPatchCodes, pEntry->cPatchCodes);
 
-        ReleaseNullDict(sdPatchCodes);
-        ReleaseNullStrArray(rgsczPatchCodes, cPatchCodes);
+    memset(pEntry, 0, sizeof(BUNDLE_SNAPSHOT_ENTRY));
+}
+
+static HRESULT MatchCodes(
+    __in_opt STRINGDICT_HANDLE sdQueryCodes,
+    __in_ecount(cCodes) LPWSTR* rgsczCodes,
+    __in DWORD cCodes
+    )
+{
+    HRESULT hr = HRESULT_FROM_WIN32(ERROR_NO_MATCH);
+
+    if (sdQueryCodes && cCodes)
+    {
+        hr = DictCompareStringListToArray(sdQueryCodes, const_cast<LPCWSTR*>(rgsczCodes), cCodes);
     }
 
-    // Compare detect codes.
-    hr = RegReadStringArray(hkBundleId, BUNDLE_REGISTRATION_REGISTRY_BUNDLE_DETECT_CODE, &rgsczDetectCodes, &cDetectCodes);
-    if (SUCCEEDED(hr))
+    return hr;
+}
+
+static HRESULT DetermineRelationType(
+    __in BUNDLE_QUERY_CONTEXT* pQueryContext,
+    __in BUNDLE_SNAPSHOT_ENTRY* pEntry,
+    __out BUNDLE_RELATION_TYPE* pRelationType
+    )
+{
+    HRESULT hr = S_OK;
+
+    *pRelationType = BUNDLE_RELATION_NONE;
+
+    // Upgrade relationship: when their upgrade codes match our upgrade codes.
+    hr = MatchCodes(pQueryContext->sdUpgradeCodes, pEntry->rgsczUpgradeCodes, pEntry->cUpgradeCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
     {
-        hr = DictCreateStringListFromArray(&sdDetectCodes, rgsczDetectCodes, cDetectCodes, DICT_FLAG_CASEINSENSITIVE);
-        ButilExitOnFailure(hr, "Failed to create string dictionary for %hs.", "detect codes");
+        ButilExitOnFailure(hr, "Failed to do array search for upgrade code match.");
 
-        // Detect relationship: when their detect codes match our detect codes.
-        hr = DictCompareStringListToArray(sdDetectCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzDetectCodes), pQueryContext->cDetectCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
-        }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for detect code match.");
+        *pRelationType = BUNDLE_RELATION_UPGRADE;
+        ExitFunction();
+    }
 
-            *pRelationType = BUNDLE_RELATION_DETECT;
-            ExitFunction();
-        }
+    // Detect relationship: when their upgrade codes match our detect codes.
+    hr = MatchCodes(pQueryContext->sdDetectCodes, pEntry->rgsczUpgradeCodes, pEntry->cUpgradeCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for detect code match.");
 
-        // Dependent relationship: when their detect codes match our addon codes.
-        hr = DictCompareStringListToArray(sdDetectCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzAddonCodes), pQueryContext->cAddonCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
-        }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
+        *pRelationType = BUNDLE_RELATION_DETECT;
+        ExitFunction();
+    }
 
-            *pRelationType = BUNDLE_RELATION_DEPENDENT_ADDON;
-            ExitFunction();
-        }
+    // Dependent relationship: when their upgrade codes match our addon codes.
+    hr = MatchCodes(pQueryContext->sdAddonCodes, pEntry->rgsczUpgradeCodes, pEntry->cUpgradeCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
 
-        // Dependent relationship: when their detect codes match our patch codes.
-        hr = DictCompareStringListToArray(sdDetectCodes, const_cast<LPCWSTR*>(pQueryContext->rgwzPatchCodes), pQueryContext->cPatchCodes);
-        if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) == hr)
-        {
-            hr = S_OK;
-        }
-        else
-        {
-            ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
+        *pRelationType = BUNDLE_RELATION_DEPENDENT_ADDON;
+        ExitFunction();
+    }
 
-            *pRelationType = BUNDLE_RELATION_DEPENDENT_PATCH;
-            ExitFunction();
-        }
+    // Dependent relationship: when their upgrade codes match our patch codes.
+    hr = MatchCodes(pQueryContext->sdPatchCodes, pEntry->rgsczUpgradeCodes, pEntry->cUpgradeCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
 
-        ReleaseNullDict(sdDetectCodes);
-        ReleaseNullStrArray(rgsczDetectCodes, cDetectCodes);
+        *pRelationType = BUNDLE_RELATION_DEPENDENT_PATCH;
+        ExitFunction();
     }
 
-LExit:
-    if (SUCCEEDED(hr) && BUNDLE_RELATION_NONE == *pRelationType)
+    // Addon relationship: when their addon codes match our detect codes.
+    hr = MatchCodes(pQueryContext->sdDetectCodes, pEntry->rgsczAddonCodes, pEntry->cAddonCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
+
+        *pRelationType = BUNDLE_RELATION_ADDON;
+        ExitFunction();
+    }
+
+    // Addon relationship: when their addon codes match our upgrade codes.
+    hr = MatchCodes(pQueryContext->sdUpgradeCodes, pEntry->rgsczAddonCodes, pEntry->cAddonCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
+
+        *pRelationType = BUNDLE_RELATION_ADDON;
+        ExitFunction();
+    }
+
+    // Patch relationship: when their patch codes match our detect codes.
+    hr = MatchCodes(pQueryContext->sdDetectCodes, pEntry->rgsczPatchCodes, pEntry->cPatchCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
+
+        *pRelationType = BUNDLE_RELATION_PATCH;
+        ExitFunction();
+    }
+
+    // Patch relationship: when their patch codes match our upgrade codes.
+    hr = MatchCodes(pQueryContext->sdUpgradeCodes, pEntry->rgsczPatchCodes, pEntry->cPatchCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
+
+        *pRelationType = BUNDLE_RELATION_PATCH;
+        ExitFunction();
+    }
+
+    // Detect relationship: when their detect codes match our detect codes.
+    hr = MatchCodes(pQueryContext->sdDetectCodes, pEntry->rgsczDetectCodes, pEntry->cDetectCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
     {
-        hr = E_NOTFOUND;
+        ButilExitOnFailure(hr, "Failed to do array search for detect code match.");
+
+        *pRelationType = BUNDLE_RELATION_DETECT;
+        ExitFunction();
     }
 
-    ReleaseDict(sdUpgradeCodes);
-    ReleaseStrArray(rgsczUpgradeCodes, cUpgradeCodes);
-    ReleaseDict(sdAddonCodes);
-    ReleaseStrArray(rgsczAddonCodes, cAddonCodes);
-    ReleaseDict(sdDetectCodes);
-    ReleaseStrArray(rgsczDetectCodes, cDetectCodes);
-    ReleaseDict(sdPatchCodes);
-    ReleaseStrArray(rgsczPatchCodes, cPatchCodes);
+    // Dependent relationship: when their detect codes match our addon codes.
+    hr = MatchCodes(pQueryContext->sdAddonCodes, pEntry->rgsczDetectCodes, pEntry->cDetectCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for addon code match.");
 
+        *pRelationType = BUNDLE_RELATION_DEPENDENT_ADDON;
+        ExitFunction();
+    }
+
+    // Dependent relationship: when their detect codes match our patch codes.
+    hr = MatchCodes(pQueryContext->sdPatchCodes, pEntry->rgsczDetectCodes, pEntry->cDetectCodes);
+    if (HRESULT_FROM_WIN32(ERROR_NO_MATCH) != hr)
+    {
+        ButilExitOnFailure(hr, "Failed to do array search for patch code match.");
+
+        *pRelationType = BUNDLE_RELATION_DEPENDENT_PATCH;
+        ExitFunction();
+    }
+
+    hr = E_NOTFOUND;
+
+LExit:
     return hr;
 }
 
@@ -36,6 +36,13 @@ const DWORD MAX_BUCKET_SIZES[] = {
 // However many items are in the cab, let's keep the buckets at least 8 times that to avoid collisions
 #define MAX_BUCKETS_TO_ITEMS_RATIO 8
 
+// Case-insensitive keys are upper-cased this many characters at a time on the stack while hashing
+#define DICT_HASH_FOLD_CHARS 64
+
+// 32-bit FNV-1a parameters
+#define DICT_HASH_OFFSET_BASIS 2166136261
+#define DICT_HASH_PRIME 16777619
+
 enum DICT_TYPE
 {
     DICT_INVALID = 0,
@@ -63,6 +70,9 @@ struct STRINGDICT_STRUCT
     // The actual stored buckets
     void **ppvBuckets;
 
+    // Full hash of the key in each occupied bucket, so probing can reject most non-matching buckets without comparing strings
+    DWORD *pdwBucketHashes;
+
     // The actual stored items in the order they were added (used for auto freeing or enumerating)
     void **ppvItemList;
 
@@ -82,14 +92,14 @@ static HRESULT CreateDict(
     );
 static HRESULT StringHash(
     __in const STRINGDICT_STRUCT *psd,
-    __in DWORD dwNumBuckets,
     __in_z LPCWSTR pszString,
-    __out DWORD *pdwHash
+    __out DWORD* pdwHash
     );
 static BOOL IsMatchExact(
     __in const STRINGDICT_STRUCT *psd,
     __in DWORD dwMatchIndex,
-    __in_z LPCWSTR wzOriginalString
+    __in_z LPCWSTR wzOriginalString,
+    __in DWORD dwHash
     );
 static HRESULT GetValue(
     __in const STRINGDICT_STRUCT *psd,
@@ -97,15 +107,16 @@ static HRESULT GetValue(
     __out_opt void **ppvValue
     );
 static HRESULT GetInsertIndex(
-    __in const STRINGDICT_STRUCT *psd,
     __in DWORD dwBucketCount,
     __in void **ppvBuckets,
     __in_z LPCWSTR pszString,
+    __in DWORD dwHash,
     __out DWORD *pdwOutput
     );
 static HRESULT GetIndex(
     __in const STRINGDICT_STRUCT *psd,
     __in_z LPCWSTR pszString,
+    __in DWORD dwHash,
     __out DWORD *pdwOutput
     );
 static LPCWSTR GetKey(
@@ -226,6 +237,7 @@ extern "C" HRESULT DAPI DictAddKey(
 {
     HRESULT hr = S_OK;
     DWORD dwIndex = 0;
+    DWORD dwHash = 0;
     STRINGDICT_STRUCT *psd = static_cast<STRINGDICT_STRUCT *>(sdHandle);
 
     DictExitOnNull(sdHandle, hr, E_INVALIDARG, "Handle not specified while adding value to dict");
@@ -257,7 +269,10 @@ extern "C" HRESULT DAPI DictAddKey(
         DictExitOnFailure(hr, "Failed to grow dictionary");
     }
 
-    hr = GetInsertIndex(psd, MAX_BUCKET_SIZES[psd->dwBucketSizeIndex], psd->ppvBuckets, pszString, &dwIndex);
+    hr = StringHash(psd, pszString, &dwHash);
+    DictExitOnFailure(hr, "Failed to hash key");
+
+    hr = GetInsertIndex(MAX_BUCKET_SIZES[psd->dwBucketSizeIndex], psd->ppvBuckets, pszString, dwHash, &dwIndex);
     DictExitOnFailure(hr, "Failed to get index to insert into");
 
     hr = MemEnsureArraySize(reinterpret_cast<void **>(&(psd->ppvItemList)), psd->dwNumItems + 1, sizeof(void *), 1000);
@@ -267,6 +282,7 @@ extern "C" HRESULT DAPI DictAddKey(
     hr = StrAllocString(reinterpret_cast<LPWSTR *>(&(psd->ppvBuckets[dwIndex])), pszString, 0);
     DictExitOnFailure(hr, "Failed to allocate copy of string");
 
+    psd->pdwBucketHashes[dwIndex] = dwHash;
     psd->ppvItemList[psd->dwNumItems-1] = psd->ppvBuckets[dwIndex];
 
 LExit:
@@ -283,6 +299,7 @@ extern "C" HRESULT DAPI DictAddValue(
     void *pvOffset = NULL;
     LPCWSTR wzKey = NULL;
     DWORD dwIndex = 0;
+    DWORD dwHash = 0;
     STRINGDICT_STRUCT *psd = static_cast<STRINGDICT_STRUCT *>(sdHandle);
 
     DictExitOnNull(sdHandle, hr, E_INVALIDARG, "Handle not specified while adding value to dict");
@@ -317,7 +334,10 @@ extern "C" HRESULT DAPI DictAddValue(
         DictExitOnFailure(hr, "Failed to grow dictionary");
     }
 
-    hr = GetInsertIndex(psd, MAX_BUCKET_SIZES[psd->dwBucketSizeIndex], psd->ppvBuckets, wzKey, &dwIndex);
+    hr = StringHash(psd, wzKey, &dwHash);
+    DictExitOnFailure(hr, "Failed to hash key");
+
+    hr = GetInsertIndex(MAX_BUCKET_SIZES[psd->dwBucketSizeIndex], psd->ppvBuckets, wzKey, dwHash, &dwIndex);
     DictExitOnFailure(hr, "Failed to get index to insert into");
 
     hr = MemEnsureArraySize(reinterpret_cast<void **>(&(psd->ppvItemList)), psd->dwNumItems + 1, sizeof(void *), 1000);
@@ -326,6 +346,7 @@ extern "C" HRESULT DAPI DictAddValue(
 
     pvOffset = TranslateValueToOffset(psd, pvValue);
     psd->ppvBuckets[dwIndex] = pvOffset;
+    psd->pdwBucketHashes[dwIndex] = dwHash;
     psd->ppvItemList[psd->dwNumItems-1] = pvOffset;
 
 LExit:
@@ -404,6 +425,7 @@ extern "C" void DAPI DictDestroy(
 
     ReleaseMem(psd->ppvItemList);
     ReleaseMem(psd->ppvBuckets);
+    ReleaseMem(psd->pdwBucketHashes);
     ReleaseMem(psd);
 }
 
@@ -445,6 +467,9 @@ static HRESULT CreateDict(
     hr = MemAllocArray(reinterpret_cast<LPVOID*>(&psd->ppvBuckets), sizeof(void*), MAX_BUCKET_SIZES[psd->dwBucketSizeIndex]);
     DictExitOnFailure(hr, "Failed to allocate buckets for dictionary.");
 
+    hr = MemAllocArray(reinterpret_cast<LPVOID*>(&psd->pdwBucketHashes), sizeof(DWORD), MAX_BUCKET_SIZES[psd->dwBucketSizeIndex]);
+    DictExitOnFailure(hr, "Failed to allocate bucket hashes for dictionary.");
+
     if (dwNumExpectedItems)
     {
         hr = MemAllocArray(reinterpret_cast<LPVOID*>(&psd->ppvItemList), sizeof(void*), dwNumExpectedItems);
@@ -455,52 +480,99 @@ LExit:
     return hr;
 }
 
+// Hashes the key with FNV-1a. Case-insensitive keys are upper-cased a chunk at a time
+// in a stack buffer as they are hashed, so lookups never allocate a copy of the key.
 static HRESULT StringHash(
     __in const STRINGDICT_STRUCT *psd,
-    __in DWORD dwNumBuckets,
     __in_z LPCWSTR pszString,
-    __out DWORD *pdwHash
+    __out DWORD* pdwHash
     )
 {
     HRESULT hr = S_OK;
-    LPCWSTR wzKey = NULL;
-    LPWSTR sczNewKey = NULL;
-    DWORD result = 0;
+    DWORD dwHash = DICT_HASH_OFFSET_BASIS;
+    LPCWSTR wz = pszString;
 
     if (DICT_FLAG_CASEINSENSITIVE & psd->dfFlags)
     {
-        hr = StrAllocStringToUpperInvariant(&sczNewKey, pszString, 0);
-        DictExitOnFailure(hr, "Failed to convert the string to upper-case.");
+        WCHAR wzFolded[DICT_HASH_FOLD_CHARS];
+
+        while (*wz)
+        {
+            BOOL fAscii = TRUE;
+            DWORD cch = 0;
 
-        wzKey = sczNewKey;
+            for (; cch < countof(wzFolded) && wz[cch]; ++cch)
+            {
+                WCHAR wch = wz[cch];
+
+                if (L'a' <= wch && L'z' >= wch)
+                {
+                    wch -= L'a' - L'A';
+                }
+                else if (0x80 <= wch)
+                {
+                    fAscii = FALSE;
+                }
+
+                wzFolded[cch] = wch;
+            }
+
+            // Keep a surrogate pair in one chunk so it is case-mapped as a single character.
+            if (1 < cch && IS_HIGH_SURROGATE(wz[cch - 1]) && IS_LOW_SURROGATE(wz[cch]))
+            {
+                --cch;
+            }
+
+            // Only characters outside ASCII need the system case mapping. Upper-casing maps each
+            // character to exactly one character so the folded chunk is the same length.
+            if (!fAscii && !::LCMapStringW(LOCALE_INVARIANT, LCMAP_UPPERCASE, wz, cch, wzFolded, cch))
+            {
+                DictExitWithLastError(hr, "Failed to upper-case key for hashing.");
+            }
+
+            for (DWORD i = 0; i < cch; ++i)
+            {
+                dwHash = (dwHash ^ wzFolded[i]) * DICT_HASH_PRIME;
+            }
+
+            wz += cch;
+        }
     }
     else
     {
-        wzKey = pszString;
-    }
-
-    while (*wzKey)
-    {
-        result = ~(*wzKey++ * 509) + result * 65599;
+        while (*wz)
+        {
+            dwHash = (dwHash ^ *wz++) * DICT_HASH_PRIME;
+        }
     }
 
-    *pdwHash = result % dwNumBuckets;
+    *pdwHash = dwHash;
 
 LExit:
-    ReleaseStr(sczNewKey);
-
     return hr;
 }
 
 static BOOL IsMatchExact(
     __in const STRINGDICT_STRUCT *psd,
     __in DWORD dwMatchIndex,
-    __in_z LPCWSTR wzOriginalString
+    __in_z LPCWSTR wzOriginalString,
+    __in DWORD dwHash
     )
 {
+    if (dwHash != psd->pdwBucketHashes[dwMatchIndex])
+    {
+        return FALSE;
+    }
+
     LPCWSTR wzMatchString = GetKey(psd, TranslateOffsetToValue(psd, psd->ppvBuckets[dwMatchIndex]));
     DWORD dwFlags = 0;
 
+    // Identical strings are equal under either comparison, so only differing ones need the linguistic compare
+    if (0 == wcscmp(wzOriginalString, wzMatchString))
+    {
+        return TRUE;
+    }
+
     if (DICT_FLAG_CASEINSENSITIVE & psd->dfFlags)
     {
         dwFlags |= NORM_IGNORECASE;
@@ -521,9 +593,8 @@ static HRESULT GetValue(
     )
 {
     HRESULT hr = S_OK;
-    DWORD dwOriginalIndexCandidate = 0;
-    void *pvCandidateValue = NULL;
     DWORD dwIndex = 0;
+    DWORD dwHash = 0;
 
     DictExitOnNull(psd, hr, E_INVALIDARG, "Handle not specified while searching dict");
     DictExitOnNull(pszString, hr, E_INVALIDARG, "String not specified while searching dict");
@@ -534,24 +605,10 @@ static HRESULT GetValue(
         DictExitOnFailure(hr, "Invalid dictionary - bucket size index is out of range");
     }
 
-    hr = StringHash(psd, MAX_BUCKET_SIZES[psd->dwBucketSizeIndex], pszString, &dwOriginalIndexCandidate);
-    DictExitOnFailure(hr, "Failed to hash the string.");
-
-    DWORD dwIndexCandidate = dwOriginalIndexCandidate;
-
-    pvCandidateValue = TranslateOffsetToValue(psd, psd->ppvBuckets[dwIndexCandidate]);
-
-    // If no match exists in the dict
-    if (NULL == pvCandidateValue)
-    {
-        if (NULL != ppvValue)
-        {
-            *ppvValue = NULL;
-        }
-        ExitFunction1(hr = E_NOTFOUND);
-    }
+    hr = StringHash(psd, pszString, &dwHash);
+    DictExitOnFailure(hr, "Failed to hash key");
 
-    hr = GetIndex(psd, pszString, &dwIndex);
+    hr = GetIndex(psd, pszString, dwHash, &dwIndex);
     if (E_NOTFOUND == hr)
     {
         ExitFunction();
@@ -573,19 +630,15 @@ LExit:
 }
 
 static HRESULT GetInsertIndex(
-    __in const STRINGDICT_STRUCT *psd,
     __in DWORD dwBucketCount,
     __in void **ppvBuckets,
     __in_z LPCWSTR pszString,
+    __in DWORD dwHash,
     __out DWORD *pdwOutput
     )
 {
     HRESULT hr = S_OK;
-    DWORD dwOriginalIndexCandidate = 0;
-
-    hr = StringHash(psd, dwBucketCount, pszString, &dwOriginalIndexCandidate);
-    DictExitOnFailure(hr, "Failed to hash the string.");
-
+    DWORD dwOriginalIndexCandidate = dwHash % dwBucketCount;
     DWORD dwIndexCandidate = dwOriginalIndexCandidate;
 
     // If we collide, keep iterating forward from our intended position, even wrapping around to zero, until we find an empty bucket
@@ -620,10 +673,12 @@ LExit:
 static HRESULT GetIndex(
     __in const STRINGDICT_STRUCT *psd,
     __in_z LPCWSTR pszString,
+    __in DWORD dwHash,
     __out DWORD *pdwOutput
     )
 {
     HRESULT hr = S_OK;
+    DWORD dwBucketCount = 0;
     DWORD dwOriginalIndexCandidate = 0;
 
     if (psd->dwBucketSizeIndex >= countof(MAX_BUCKET_SIZES))
@@ -632,25 +687,30 @@ static HRESULT GetIndex(
         DictExitOnFailure(hr, "Invalid dictionary - bucket size index is out of range");
     }
 
-    hr = StringHash(psd, MAX_BUCKET_SIZES[psd->dwBucketSizeIndex], pszString, &dwOriginalIndexCandidate);
-    DictExitOnFailure(hr, "Failed to hash the string.");
+    dwBucketCount = MAX_BUCKET_SIZES[psd->dwBucketSizeIndex];
+    dwOriginalIndexCandidate = dwHash % dwBucketCount;
 
     DWORD dwIndexCandidate = dwOriginalIndexCandidate;
 
-    while (!IsMatchExact(psd, dwIndexCandidate, pszString))
+    for (;;)
     {
-        ++dwIndexCandidate;
+        // If no match exists in the dict
+        if (NULL == psd->ppvBuckets[dwIndexCandidate])
+        {
+            ExitFunction1(hr = E_NOTFOUND);
+        }
 
-        // If we got to the end of the array, wrap around to zero index
-        if (dwIndexCandidate >= MAX_BUCKET_SIZES[psd->dwBucketSizeIndex])
+        if (IsMatchExact(psd, dwIndexCandidate, pszString, dwHash))
         {
-            dwIndexCandidate = 0;
+            break;
         }
 
-        // If no match exists in the dict
-        if (NULL == psd->ppvBuckets[dwIndexCandidate])
+        ++dwIndexCandidate;
+
+        // If we got to the end of the array, wrap around to zero index
+        if (dwIndexCandidate >= dwBucketCount)
         {
-            ExitFunction1(hr = E_NOTFOUND);
+            dwIndexCandidate = 0;
         }
 
         // If we wrapped all the way back around to our original index, the dict is full and we found nothing, so return as such
@@ -698,6 +758,8 @@ static HRESULT GrowDictionary(
     DWORD dwNewBucketSizeIndex = 0;
     size_t cbAllocSize = 0;
     void **ppvNewBuckets = NULL;
+    DWORD *pdwNewBucketHashes = NULL;
+    DWORD dwHash = 0;
 
     dwNewBucketSizeIndex = psd->dwBucketSizeIndex + 1;
 
@@ -712,24 +774,40 @@ static HRESULT GrowDictionary(
     ppvNewBuckets = static_cast<void**>(MemAlloc(cbAllocSize, TRUE));
     DictExitOnNull(ppvNewBuckets, hr, E_OUTOFMEMORY, "Failed to allocate %u buckets while growing dictionary", MAX_BUCKET_SIZES[dwNewBucketSizeIndex]);
 
-    for (DWORD i = 0; i < psd->dwNumItems; ++i)
+    hr = MemAllocArray(reinterpret_cast<LPVOID*>(&pdwNewBucketHashes), sizeof(DWORD), MAX_BUCKET_SIZES[dwNewBucketSizeIndex]);
+    DictExitOnFailure(hr, "Failed to allocate %u bucket hashes while growing dictionary", MAX_BUCKET_SIZES[dwNewBucketSizeIndex]);
+
+    // Move the occupied buckets over with the hashes stored for them, so no key is hashed again.
+    for (DWORD i = 0; i < MAX_BUCKET_SIZES[psd->dwBucketSizeIndex]; ++i)
     {
-        wzKey = GetKey(psd, TranslateOffsetToValue(psd, psd->ppvItemList[i]));
+        if (NULL == psd->ppvBuckets[i])
+        {
+            continue;
+        }
+
+        wzKey = GetKey(psd, TranslateOffsetToValue(psd, psd->ppvBuckets[i]));
         DictExitOnNull(wzKey, hr, E_INVALIDARG, "String not specified in existing dict value");
 
-        hr = GetInsertIndex(psd, MAX_BUCKET_SIZES[dwNewBucketSizeIndex], ppvNewBuckets, wzKey, &dwInsertIndex);
+        dwHash = psd->pdwBucketHashes[i];
+
+        hr = GetInsertIndex(MAX_BUCKET_SIZES[dwNewBucketSizeIndex], ppvNewBuckets, wzKey, dwHash, &dwInsertIndex);
         DictExitOnFailure(hr, "Failed to get index to insert into");
 
-        ppvNewBuckets[dwInsertIndex] = psd->ppvItemList[i];
+        ppvNewBuckets[dwInsertIndex] = psd->ppvBuckets[i];
+        pdwNewBucketHashes[dwInsertIndex] = dwHash;
     }
 
     psd->dwBucketSizeIndex = dwNewBucketSizeIndex;
     ReleaseMem(psd->ppvBuckets);
     psd->ppvBuckets = ppvNewBuckets;
     ppvNewBuckets = NULL;
+    ReleaseMem(psd->pdwBucketHashes);
+    psd->pdwBucketHashes = pdwNewBucketHashes;
+    pdwNewBucketHashes = NULL;
 
 LExit:
     ReleaseMem(ppvNewBuckets);
+    ReleaseMem(pdwNewBucketHashes);
 
     return hr;
 }
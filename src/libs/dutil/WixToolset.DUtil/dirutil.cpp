@@ -20,6 +20,59 @@
 #define DirExitOnPathFailure(x, b, s, ...) ExitOnPathFailureSource(DUTIL_SOURCE_DIRUTIL, x, b, s, __VA_ARGS__)
 #define DirExitWithPathLastError(x, s, ...) ExitWithPathLastErrorSource(DUTIL_SOURCE_DIRUTIL, x, s, __VA_ARGS__)
 
+// Trees with fewer files than this per thread are deleted on fewer threads.
+#define DIR_DELETE_FILES_PER_WORKER 64
+#define DIR_DELETE_MAX_WORKERS 8
+
+typedef struct _DIR_DELETE_FILE
+{
+    LPWSTR sczPath;
+    DWORD dwAttributes;
+    BOOL fTopLevel; // directly in the directory being deleted rather than in a subdirectory
+} DIR_DELETE_FILE;
+
+typedef struct _DIR_DELETE_TREE
+{
+    BOOL fScheduleDelete;
+    LPWSTR sczTempDirectory;
+
+    LPWSTR* rgsczDirectories;
+    DWORD cDirectories;
+    DWORD cDirectoriesCapacity;
+
+    DIR_DELETE_FILE* rgFiles;
+    DWORD cFiles;
+    DWORD cFilesCapacity;
+
+    volatile LONG iNextFile;
+    volatile LONG hrFiles; // first failure deleting a top-level file
+} DIR_DELETE_TREE;
+
+
+// internal function declarations
+
+static HRESULT DeleteTreeContents(
+    __in_z LPCWSTR wzPath,
+    __in BOOL fScheduleDelete
+    );
+static HRESULT EnumerateTree(
+    __in_z LPCWSTR wzPath,
+    __in DIR_DELETE_TREE* pTree
+    );
+static DWORD WINAPI DeleteFilesWorker(
+    __in LPVOID pvContext
+    );
+static HRESULT DeleteTreeFile(
+    __in DIR_DELETE_TREE* pTree,
+    __in DIR_DELETE_FILE* pFile
+    );
+static HRESULT ScheduleDirectoryDelete(
+    __in_z LPCWSTR wzPath
+    );
+static void UninitializeTree(
+    __in DIR_DELETE_TREE* pTree
+    );
+
 
 /*******************************************************************
  DirExists
@@ -180,6 +233,7 @@ extern "C" HRESULT DAPI DirEnsureDeleteEx(
     BOOL fDeleteFiles = (DIR_DELETE_FILES == (dwFlags & DIR_DELETE_FILES));
     BOOL fRecurse = (DIR_DELETE_RECURSE == (dwFlags & DIR_DELETE_RECURSE));
     BOOL fScheduleDelete = (DIR_DELETE_SCHEDULE == (dwFlags & DIR_DELETE_SCHEDULE));
+    BOOL fParallel = (DIR_DELETE_PARALLEL == (dwFlags & DIR_DELETE_PARALLEL));
     WCHAR wzSafeFileName[MAX_PATH + 1] = { };
     LPWSTR sczTempDirectory = NULL;
     LPWSTR sczTempPath = NULL;
@@ -203,8 +257,13 @@ extern "C" HRESULT DAPI DirEnsureDeleteEx(
             }
         }
 
-        // If we're deleting files and/or child directories loop through the contents of the directory.
-        if (fDeleteFiles || fRecurse)
+        // Deleting a whole tree can enumerate it once and spread the file deletes across threads.
+        if (fParallel && fDeleteFiles && fRecurse)
+        {
+            hr = DeleteTreeContents(wzPath, fScheduleDelete);
+            DirExitOnFailure(hr, "Failed to delete contents of directory: %ls", wzPath);
+        }
+        else if (fDeleteFiles || fRecurse) // if we're deleting files and/or child directories loop through the contents of the directory.
         {
             if (fScheduleDelete)
             {
@@ -306,7 +365,14 @@ extern "C" HRESULT DAPI DirEnsureDeleteEx(
             hr = HRESULT_FROM_WIN32(::GetLastError());
             if (HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION) == hr && fScheduleDelete)
             {
-                if (::MoveFileExW(wzPath, NULL, MOVEFILE_DELAY_UNTIL_REBOOT))
+                if (fParallel)
+                {
+                    if (SUCCEEDED(ScheduleDirectoryDelete(wzPath)))
+                    {
+                        hr = S_OK;
+                    }
+                }
+                else if (::MoveFileExW(wzPath, NULL, MOVEFILE_DELAY_UNTIL_REBOOT))
                 {
                     hr = S_OK;
                 }
@@ -464,3 +530,357 @@ extern "C" HRESULT DAPI DirSetCurrent(
 LExit:
     return hr;
 }
+
+
+// internal function definitions
+
+static HRESULT DeleteTreeContents(
+    __in_z LPCWSTR wzPath,
+    __in BOOL fScheduleDelete
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrDirectory = S_OK;
+    DIR_DELETE_TREE tree = { };
+    SYSTEM_INFO si = { };
+    HANDLE rghWorkers[DIR_DELETE_MAX_WORKERS - 1] = { };
+    DWORD cWorkers = 0;
+    DWORD cMaxWorkers = 0;
+    LPCWSTR wzDirectory = NULL;
+
+    tree.fScheduleDelete = fScheduleDelete;
+
+    if (fScheduleDelete)
+    {
+        hr = PathGetTempPath(&tree.sczTempDirectory, NULL);
+        DirExitOnFailure(hr, "Failed to get temp directory.");
+    }
+
+    hr = EnumerateTree(wzPath, &tree);
+    DirExitOnFailure(hr, "Failed to enumerate directory: %ls", wzPath);
+
+    // The calling thread is one of the workers so small trees don't start any threads.
+    ::GetSystemInfo(&si);
+    cMaxWorkers = min(si.dwNumberOfProcessors, tree.cFiles / DIR_DELETE_FILES_PER_WORKER);
+    cMaxWorkers = min(cMaxWorkers, DIR_DELETE_MAX_WORKERS);
+
+    while (cWorkers + 1 < cMaxWorkers)
+    {
+        rghWorkers[cWorkers] = ::CreateThread(NULL, 0, DeleteFilesWorker, &tree, 0, NULL);
+        if (!rghWorkers[cWorkers])
+        {
+            hr = HRESULT_FROM_WIN32(::GetLastError());
+            ExitTraceSource(DUTIL_SOURCE_DIRUTIL, hr, "Failed to create delete worker thread; continuing with %u threads.", cWorkers + 1);
+            hr = S_OK;
+            break;
+        }
+
+        ++cWorkers;
+    }
+
+    DeleteFilesWorker(&tree);
+
+    if (cWorkers)
+    {
+        ::WaitForMultipleObjects(cWorkers, rghWorkers, TRUE, INFINITE);
+    }
+
+    // Subdirectories are always listed after their parent so removing them in reverse
+    // empties each one before its parent. The caller removes the root.
+    for (DWORD i = tree.cDirectories - 1; 0 < i; --i)
+    {
+        wzDirectory = tree.rgsczDirectories[i];
+
+        if (!::RemoveDirectoryW(wzDirectory))
+        {
+            hrDirectory = HRESULT_FROM_WIN32(::GetLastError());
+            if (HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION) == hrDirectory && fScheduleDelete)
+            {
+                hrDirectory = ScheduleDirectoryDelete(wzDirectory);
+            }
+
+            // if we failed to delete a subdirectory, keep trying to finish the remaining ones
+            if (FAILED(hrDirectory) && E_PATHNOTFOUND != hrDirectory && E_FILENOTFOUND != hrDirectory)
+            {
+                ExitTraceSource(DUTIL_SOURCE_DIRUTIL, hrDirectory, "Failed to delete subdirectory; continuing: %ls", wzDirectory);
+            }
+        }
+    }
+
+    hr = tree.hrFiles;
+    DirExitOnFailure(hr, "Failed to delete files in directory: %ls", wzPath);
+
+LExit:
+    for (DWORD i = 0; i < cWorkers; ++i)
+    {
+        ReleaseHandle(rghWorkers[i]);
+    }
+
+    UninitializeTree(&tree);
+
+    return hr;
+}
+
+static HRESULT EnumerateTree(
+    __in_z LPCWSTR wzPath,
+    __in DIR_DELETE_TREE* pTree
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    HANDLE hFind = INVALID_HANDLE_VALUE;
+    LPWSTR sczSearch = NULL;
+    LPWSTR sczChild = NULL;
+    LPCWSTR wzDirectory = NULL;
+    DIR_DELETE_FILE* pFile = NULL;
+    WIN32_FIND_DATAW wfd = { };
+    WCHAR wzSafeFileName[MAX_PATH + 1] = { };
+
+    hr = MemEnsureArrayCapacityOf(pTree->rgsczDirectories, 1, &pTree->cDirectoriesCapacity);
+    DirExitOnFailure(hr, "Failed to allocate directory list.");
+
+    hr = StrAllocString(pTree->rgsczDirectories, wzPath, 0);
+    DirExitOnFailure(hr, "Failed to copy directory: %ls", wzPath);
+
+    pTree->cDirectories = 1;
+
+    hr = PathBackslashTerminate(pTree->rgsczDirectories);
+    DirExitOnFailure(hr, "Failed to ensure path is backslash terminated: %ls", wzPath);
+
+    // Walk breadth first so the whole list of files is known before any are deleted.
+    for (DWORD i = 0; i < pTree->cDirectories; ++i)
+    {
+        wzDirectory = pTree->rgsczDirectories[i];
+
+        hr = PathConcat(wzDirectory, L"*", &sczSearch);
+        DirExitOnFailure(hr, "Failed to concat wild cards to string: %ls", wzDirectory);
+
+        hFind = ::FindFirstFileExW(sczSearch, FindExInfoBasic, &wfd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+        if (INVALID_HANDLE_VALUE == hFind)
+        {
+            // Only the root is required; a subdirectory that cannot be enumerated is skipped
+            // so the rest of the tree is still deleted, the same as the serial path.
+            if (0 < i)
+            {
+                hr = HRESULT_FROM_WIN32(::GetLastError());
+                ExitTraceSource(DUTIL_SOURCE_DIRUTIL, hr, "Failed to enumerate subdirectory; continuing: %ls", wzDirectory);
+                hr = S_OK;
+                continue;
+            }
+
+            DirExitWithLastError(hr, "failed to get first file in directory: %ls", wzDirectory);
+        }
+
+        do
+        {
+            // Skip the dot directories.
+            if (L'.' == wfd.cFileName[0] && (L'\0' == wfd.cFileName[1] || (L'.' == wfd.cFileName[1] && L'\0' == wfd.cFileName[2])))
+            {
+                continue;
+            }
+
+            // For extra safety and to silence OACR.
+            hr = ::StringCchCopyNExW(wzSafeFileName, countof(wzSafeFileName), wfd.cFileName, countof(wfd.cFileName), NULL, NULL, STRSAFE_FILL_BEHIND_NULL | STRSAFE_NULL_ON_FAILURE);
+            DirExitOnFailure(hr, "Failed to ensure file name was null terminated.");
+
+            hr = PathConcat(wzDirectory, wzSafeFileName, &sczChild);
+            DirExitOnFailure(hr, "Failed to concat filename '%ls' to directory: %ls", wzSafeFileName, wzDirectory);
+
+            if (wfd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                if (wfd.dwFileAttributes & FILE_ATTRIBUTE_READONLY && !::SetFileAttributesW(sczChild, FILE_ATTRIBUTE_NORMAL))
+                {
+                    hr = HRESULT_FROM_WIN32(::GetLastError());
+                    ExitTraceSource(DUTIL_SOURCE_DIRUTIL, hr, "Failed to remove read-only attribute from subdirectory; continuing: %ls", sczChild);
+                    hr = S_OK;
+                    continue;
+                }
+
+                hr = PathBackslashTerminate(&sczChild);
+                DirExitOnFailure(hr, "Failed to ensure path is backslash terminated: %ls", sczChild);
+
+                hr = MemEnsureArrayCapacityOf(pTree->rgsczDirectories, pTree->cDirectories + 1, &pTree->cDirectoriesCapacity);
+                DirExitOnFailure(hr, "Failed to grow directory list.");
+
+                pTree->rgsczDirectories[pTree->cDirectories] = sczChild;
+                sczChild = NULL;
+                ++pTree->cDirectories;
+            }
+            else
+            {
+                hr = MemEnsureArrayCapacityOf(pTree->rgFiles, pTree->cFiles + 1, &pTree->cFilesCapacity);
+                DirExitOnFailure(hr, "Failed to grow file list.");
+
+                pFile = pTree->rgFiles + pTree->cFiles;
+                pFile->sczPath = sczChild;
+                pFile->dwAttributes = wfd.dwFileAttributes;
+                pFile->fTopLevel = (0 == i);
+                sczChild = NULL;
+                ++pTree->cFiles;
+            }
+        } while (::FindNextFileW(hFind, &wfd));
+
+        er = ::GetLastError();
+        if (ERROR_NO_MORE_FILES != er)
+        {
+            if (0 < i)
+            {
+                hr = HRESULT_FROM_WIN32(er);
+                ExitTraceSource(DUTIL_SOURCE_DIRUTIL, hr, "Failed while looping through files in subdirectory; continuing: %ls", wzDirectory);
+                hr = S_OK;
+            }
+            else
+            {
+                DirExitWithLastError(hr, "Failed while looping through files in directory: %ls", wzDirectory);
+            }
+        }
+
+        ReleaseFileFindHandle(hFind);
+    }
+
+LExit:
+    ReleaseFileFindHandle(hFind);
+    ReleaseStr(sczChild);
+    ReleaseStr(sczSearch);
+
+    return hr;
+}
+
+static DWORD WINAPI DeleteFilesWorker(
+    __in LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    DIR_DELETE_TREE* pTree = static_cast<DIR_DELETE_TREE*>(pvContext);
+    DWORD iFile = 0;
+
+    while (pTree->cFiles > (iFile = static_cast<DWORD>(::InterlockedIncrement(&pTree->iNextFile) - 1)))
+    {
+        hr = DeleteTreeFile(pTree, pTree->rgFiles + iFile);
+        if (FAILED(hr))
+        {
+            // Like the serial path, only files directly in the directory fail the delete. A file
+            // in a subdirectory is traced, and that subdirectory then fails to be removed and is
+            // traced as well. Either way keep going so a retry has less left to do.
+            if (pTree->rgFiles[iFile].fTopLevel)
+            {
+                ::InterlockedCompareExchange(&pTree->hrFiles, hr, S_OK);
+            }
+            else
+            {
+                ExitTraceSource(DUTIL_SOURCE_DIRUTIL, hr, "Failed to delete file in subdirectory; continuing: %ls", pTree->rgFiles[iFile].sczPath);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static HRESULT DeleteTreeFile(
+    __in DIR_DELETE_TREE* pTree,
+    __in DIR_DELETE_FILE* pFile
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczTempPath = NULL;
+
+    if (pFile->dwAttributes & FILE_ATTRIBUTE_READONLY || pFile->dwAttributes & FILE_ATTRIBUTE_HIDDEN || pFile->dwAttributes & FILE_ATTRIBUTE_SYSTEM)
+    {
+        if (!::SetFileAttributesW(pFile->sczPath, FILE_ATTRIBUTE_NORMAL))
+        {
+            DirExitWithPathLastError(hr, "Failed to remove attributes from file: %ls", pFile->sczPath);
+
+            // The file is already gone.
+            ExitFunction();
+        }
+    }
+
+    if (!::DeleteFileW(pFile->sczPath))
+    {
+        if (pTree->fScheduleDelete)
+        {
+            hr = PathGetTempFileName(pTree->sczTempDirectory, L"DEL", 0, &sczTempPath);
+            DirExitOnFailure(hr, "Failed to get temp file to move to.");
+
+            // Try to move the file to the temp directory then schedule for delete,
+            // otherwise just schedule for delete.
+            if (::MoveFileExW(pFile->sczPath, sczTempPath, MOVEFILE_REPLACE_EXISTING))
+            {
+                ::MoveFileExW(sczTempPath, NULL, MOVEFILE_DELAY_UNTIL_REBOOT);
+            }
+            else
+            {
+                ::MoveFileExW(pFile->sczPath, NULL, MOVEFILE_DELAY_UNTIL_REBOOT);
+            }
+        }
+        else
+        {
+            DirExitWithPathLastError(hr, "Failed to delete file: %ls", pFile->sczPath);
+        }
+    }
+
+LExit:
+    ReleaseStr(sczTempPath);
+
+    return hr;
+}
+
+static HRESULT ScheduleDirectoryDelete(
+    __in_z LPCWSTR wzPath
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczPath = NULL;
+    LPWSTR sczGuid = NULL;
+    LPWSTR sczRenamed = NULL;
+    LPCWSTR wzDelete = wzPath;
+    SIZE_T cchPath = 0;
+
+    hr = StrAllocString(&sczPath, wzPath, 0);
+    DirExitOnFailure(hr, "Failed to copy directory: %ls", wzPath);
+
+    cchPath = lstrlenW(sczPath);
+    if (cchPath && L'\\' == sczPath[cchPath - 1])
+    {
+        sczPath[cchPath - 1] = L'\0';
+    }
+
+    // Rename the directory out of the way first so its path can be used again before the
+    // reboot. If it can't be renamed, schedule it where it is.
+    hr = GuidCreate(&sczGuid);
+    DirExitOnFailure(hr, "Failed to create guid for directory rename.");
+
+    hr = StrAllocFormatted(&sczRenamed, L"%ls.%ls.del", sczPath, sczGuid);
+    DirExitOnFailure(hr, "Failed to allocate renamed directory path.");
+
+    if (::MoveFileExW(sczPath, sczRenamed, 0))
+    {
+        wzDelete = sczRenamed;
+    }
+
+    if (!::MoveFileExW(wzDelete, NULL, MOVEFILE_DELAY_UNTIL_REBOOT))
+    {
+        DirExitWithLastError(hr, "Failed to schedule directory for delete: %ls", wzDelete);
+    }
+
+LExit:
+    ReleaseStr(sczRenamed);
+    ReleaseStr(sczGuid);
+    ReleaseStr(sczPath);
+
+    return hr;
+}
+
+static void UninitializeTree(
+    __in DIR_DELETE_TREE* pTree
+    )
+{
+    for (DWORD i = 0; i < pTree->cFiles; ++i)
+    {
+        ReleaseStr(pTree->rgFiles[i].sczPath);
+    }
+
+    ReleaseMem(pTree->rgFiles);
+    ReleaseStrArray(pTree->rgsczDirectories, pTree->cDirectories);
+    ReleaseStr(pTree->sczTempDirectory);
+}
@@ -20,6 +20,60 @@
 
 #define ISSTRINGVARIANT(vt) (VT_BSTR == vt || VT_LPWSTR == vt)
 
+#define IIS7_APPHOSTINDEX_GROWTH 64
+
+struct IIS7_APPHOSTINDEX_ENTRY
+{
+    LPWSTR sczValue; // hex encoded sort key of the attribute value
+    DWORD dwIndex; // position in the collection less IIS7_APPHOSTINDEX::dwIndexBase
+};
+
+struct IIS7_APPHOSTINDEX
+{
+    IAppHostElementCollection* pCollection;
+    LPWSTR sczElementName;
+    LPWSTR sczAttributeName;
+    IIS7_APPHOSTINDEX_FLAG flags;
+
+    // Snapshot of the collection, only valid when fBuilt is set. The dictionary
+    // holds the first element for each attribute value like a linear search would find.
+    BOOL fBuilt;
+    DWORD cElements;
+    STRINGDICT_HANDLE sdValues;
+    IIS7_APPHOSTINDEX_ENTRY* rgEntries;
+    DWORD cEntries;
+    DWORD dwIndexBase;
+
+    // Set when an element the linear search might match could not be keyed,
+    // so a miss in the dictionary is not conclusive.
+    BOOL fUnkeyed;
+
+    // Largest integer value of sczMaxAttributeName, tracked once asked for.
+    LPWSTR sczMaxAttributeName;
+    DWORD dwMaxValue;
+};
+
+static HRESULT BuildAppHostIndex(
+    __in IIS7_APPHOSTINDEX* pIndex
+    );
+static HRESULT IndexAppHostElement(
+    __in IIS7_APPHOSTINDEX* pIndex,
+    __in IAppHostElement* pElement,
+    __in DWORD dwIndex
+    );
+static HRESULT GetAppHostIndexKey(
+    __in IIS7_APPHOSTINDEX* pIndex,
+    __in_z LPCWSTR wzValue,
+    __deref_out_z LPWSTR* psczKey
+    );
+static void ClearAppHostIndex(
+    __in IIS7_APPHOSTINDEX* pIndex
+    );
+static DWORD GetAppHostIndexEntryPosition(
+    __in IIS7_APPHOSTINDEX* pIndex,
+    __in IIS7_APPHOSTINDEX_ENTRY* pEntry
+    );
+
 extern "C" HRESULT DAPI Iis7PutPropertyVariant(
     __in IAppHostElement *pElement,
     __in LPCWSTR wzPropName,
@@ -533,3 +587,509 @@ LExit:
 
     return hr;
 }
+
+extern "C" HRESULT DAPI Iis7AppHostIndexCreate(
+    __in IAppHostElementCollection *pCollection,
+    __in_z LPCWSTR wzElementName,
+    __in_z LPCWSTR wzAttributeName,
+    __in IIS7_APPHOSTINDEX_FLAG flags,
+    __out IIS7_APPHOSTINDEX_HANDLE* phIndex
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_APPHOSTINDEX* pIndex = NULL;
+
+    pIndex = static_cast<IIS7_APPHOSTINDEX*>(MemAlloc(sizeof(IIS7_APPHOSTINDEX), TRUE));
+    IisExitOnNull(pIndex, hr, E_OUTOFMEMORY, "Failed to allocate AppHost element index.");
+
+    hr = StrAllocString(&pIndex->sczElementName, wzElementName, 0);
+    IisExitOnFailure(hr, "Failed to copy index element name.");
+
+    hr = StrAllocString(&pIndex->sczAttributeName, wzAttributeName, 0);
+    IisExitOnFailure(hr, "Failed to copy index attribute name.");
+
+    pIndex->flags = flags;
+    pIndex->pCollection = pCollection;
+    pIndex->pCollection->AddRef();
+
+    *phIndex = pIndex;
+    pIndex = NULL;
+
+LExit:
+    ReleaseIis7AppHostIndex(pIndex);
+
+    return hr;
+}
+
+extern "C" HRESULT DAPI Iis7AppHostIndexFind(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzAttributeValue,
+    __out_opt IAppHostElement** ppElement,
+    __out_opt DWORD* pdwIndex
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_APPHOSTINDEX* pIndex = static_cast<IIS7_APPHOSTINDEX*>(hIndex);
+    IIS7_APPHOSTINDEX_ENTRY* pEntry = NULL;
+    IAppHostElement* pElement = NULL;
+    DWORD dwIndex = MAXDWORD;
+    LPWSTR sczKey = NULL;
+    IIS7_APPHOSTELEMENTCOMPARISON comparison = { };
+    VARIANT vtValue;
+    VARIANT vtIndex;
+
+    ::VariantInit(&vtValue);
+    ::VariantInit(&vtIndex);
+
+    if (NULL != ppElement)
+    {
+        *ppElement = NULL;
+    }
+    if (NULL != pdwIndex)
+    {
+        *pdwIndex = MAXDWORD;
+    }
+
+    hr = GetAppHostIndexKey(pIndex, wzAttributeValue, &sczKey);
+    if (FAILED(hr))
+    {
+        TraceError(hr, "Failed to get index key for %ls, searching the collection instead.", wzAttributeValue);
+    }
+    else if (!pIndex->fBuilt)
+    {
+        hr = BuildAppHostIndex(pIndex);
+        if (FAILED(hr))
+        {
+            TraceError(hr, "Failed to build index of %ls elements, searching the collection instead.", pIndex->sczElementName);
+        }
+    }
+
+    if (sczKey && pIndex->fBuilt)
+    {
+        hr = DictGetValue(pIndex->sdValues, sczKey, reinterpret_cast<void**>(&pEntry));
+        if (SUCCEEDED(hr))
+        {
+            vtValue.vt = VT_BSTR;
+            vtValue.bstrVal = ::SysAllocString(wzAttributeValue);
+            IisExitOnNull(vtValue.bstrVal, hr, E_OUTOFMEMORY, "failed SysAllocString");
+
+            comparison.sczElementName = pIndex->sczElementName;
+            comparison.sczAttributeName = pIndex->sczAttributeName;
+            comparison.pvAttributeValue = &vtValue;
+            comparison.pComparator = (IIS7_APPHOSTINDEX_FLAG_PATH & pIndex->flags) ? CompareVariantPath : CompareVariantDefault;
+
+            dwIndex = GetAppHostIndexEntryPosition(pIndex, pEntry);
+
+            vtIndex.vt = VT_UI4;
+            vtIndex.ulVal = dwIndex;
+            hr = pIndex->pCollection->get_Item(vtIndex, &pElement);
+            if (SUCCEEDED(hr) && pElement && Iis7IsMatchingAppHostElement(pElement, &comparison))
+            {
+                ExitFunction1(hr = S_OK);
+            }
+
+            // The collection was changed behind the index.
+            ReleaseNullObject(pElement);
+            Iis7AppHostIndexInvalidate(pIndex);
+        }
+        else if (E_NOTFOUND != hr)
+        {
+            IisExitOnFailure(hr, "Failed to find %ls in index of %ls elements.", wzAttributeValue, pIndex->sczElementName);
+        }
+        else if (!pIndex->fUnkeyed)
+        {
+            // Every element the linear search could match is keyed and all changes go through
+            // the index, so the miss stands without enumerating the collection.
+            ExitFunction1(hr = S_OK);
+        }
+    }
+
+    // The index was not built, held a stale entry or left out elements it could not key,
+    // so let the linear search decide.
+    if (IIS7_APPHOSTINDEX_FLAG_PATH & pIndex->flags)
+    {
+        hr = Iis7FindAppHostElementPath(pIndex->pCollection, pIndex->sczElementName, pIndex->sczAttributeName, wzAttributeValue, &pElement, &dwIndex);
+    }
+    else
+    {
+        hr = Iis7FindAppHostElementString(pIndex->pCollection, pIndex->sczElementName, pIndex->sczAttributeName, wzAttributeValue, &pElement, &dwIndex);
+    }
+    IisExitOnFailure(hr, "Failed to search collection for %ls element with %ls: %ls", pIndex->sczElementName, pIndex->sczAttributeName, wzAttributeValue);
+
+    if (pElement && pIndex->fBuilt && !pIndex->fUnkeyed)
+    {
+        // The index missed an element the search found, so it no longer describes the collection.
+        Iis7AppHostIndexInvalidate(pIndex);
+    }
+
+LExit:
+    if (SUCCEEDED(hr) && pElement)
+    {
+        if (NULL != ppElement)
+        {
+            *ppElement = pElement;
+            pElement = NULL;
+        }
+        if (NULL != pdwIndex)
+        {
+            *pdwIndex = dwIndex;
+        }
+    }
+
+    ReleaseObject(pElement);
+    ReleaseStr(sczKey);
+    ReleaseVariant(vtValue);
+    ReleaseVariant(vtIndex);
+
+    return hr;
+}
+
+extern "C" HRESULT DAPI Iis7AppHostIndexAddElement(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in IAppHostElement* pElement,
+    __in INT iPosition
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_APPHOSTINDEX* pIndex = static_cast<IIS7_APPHOSTINDEX*>(hIndex);
+    DWORD dwPosition = 0;
+
+    hr = pIndex->pCollection->AddElement(pElement, iPosition);
+    IisExitOnFailure(hr, "Failed to add %ls element to collection.", pIndex->sczElementName);
+
+    if (pIndex->fBuilt)
+    {
+        dwPosition = (0 > iPosition) ? pIndex->cElements : static_cast<DWORD>(iPosition);
+        if (dwPosition > pIndex->cElements)
+        {
+            Iis7AppHostIndexInvalidate(pIndex);
+            ExitFunction();
+        }
+
+        // Shift the snapshot past the insertion point instead of enumerating the collection again.
+        // Every entry moves when inserting at the front, so only the base moves.
+        if (0 == dwPosition)
+        {
+            ++pIndex->dwIndexBase;
+        }
+        else if (dwPosition < pIndex->cElements)
+        {
+            for (DWORD i = 0; i < pIndex->cEntries; ++i)
+            {
+                if (GetAppHostIndexEntryPosition(pIndex, pIndex->rgEntries + i) >= dwPosition)
+                {
+                    ++pIndex->rgEntries[i].dwIndex;
+                }
+            }
+        }
+        ++pIndex->cElements;
+
+        hr = IndexAppHostElement(pIndex, pElement, dwPosition);
+        if (FAILED(hr))
+        {
+            // The element is in the collection, the snapshot will catch up on the next find.
+            Iis7AppHostIndexInvalidate(pIndex);
+            hr = S_OK;
+        }
+    }
+
+LExit:
+    return hr;
+}
+
+extern "C" HRESULT DAPI Iis7AppHostIndexDeleteElement(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in DWORD dwIndex
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_APPHOSTINDEX* pIndex = static_cast<IIS7_APPHOSTINDEX*>(hIndex);
+    VARIANT vtIndex;
+
+    ::VariantInit(&vtIndex);
+    vtIndex.vt = VT_UI4;
+    vtIndex.ulVal = dwIndex;
+
+    // Any element with the same value later in the collection becomes the new match, so start over.
+    Iis7AppHostIndexInvalidate(pIndex);
+
+    hr = pIndex->pCollection->DeleteElement(vtIndex);
+    IisExitOnFailure(hr, "Failed to delete element %u from collection.", dwIndex);
+
+LExit:
+    ReleaseVariant(vtIndex);
+
+    return hr;
+}
+
+extern "C" HRESULT DAPI Iis7AppHostIndexGetMaxInteger(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzAttributeName,
+    __out DWORD* pdwMaxValue
+    )
+{
+    HRESULT hr = S_OK;
+    IIS7_APPHOSTINDEX* pIndex = static_cast<IIS7_APPHOSTINDEX*>(hIndex);
+
+    *pdwMaxValue = 0;
+
+    if (!pIndex->sczMaxAttributeName || CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, pIndex->sczMaxAttributeName, -1, wzAttributeName, -1))
+    {
+        hr = StrAllocString(&pIndex->sczMaxAttributeName, wzAttributeName, 0);
+        IisExitOnFailure(hr, "Failed to copy index maximum attribute name.");
+
+        // The snapshot did not read this attribute, so take it again.
+        ClearAppHostIndex(pIndex);
+    }
+
+    if (!pIndex->fBuilt)
+    {
+        hr = BuildAppHostIndex(pIndex);
+        IisExitOnFailure(hr, "Failed to build index of %ls elements.", pIndex->sczElementName);
+    }
+
+    *pdwMaxValue = pIndex->dwMaxValue;
+
+LExit:
+    return hr;
+}
+
+extern "C" void DAPI Iis7AppHostIndexInvalidate(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex
+    )
+{
+    ClearAppHostIndex(static_cast<IIS7_APPHOSTINDEX*>(hIndex));
+}
+
+extern "C" void DAPI Iis7AppHostIndexRelease(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex
+    )
+{
+    IIS7_APPHOSTINDEX* pIndex = static_cast<IIS7_APPHOSTINDEX*>(hIndex);
+
+    if (pIndex)
+    {
+        ClearAppHostIndex(pIndex);
+        ReleaseMem(pIndex->rgEntries);
+        ReleaseStr(pIndex->sczElementName);
+        ReleaseStr(pIndex->sczAttributeName);
+        ReleaseStr(pIndex->sczMaxAttributeName);
+        ReleaseObject(pIndex->pCollection);
+        MemFree(pIndex);
+    }
+}
+
+static HRESULT BuildAppHostIndex(
+    __in IIS7_APPHOSTINDEX* pIndex
+    )
+{
+    HRESULT hr = S_OK;
+    IAppHostElement* pElement = NULL;
+    DWORD cElements = 0;
+    VARIANT vtIndex;
+
+    ::VariantInit(&vtIndex);
+
+    ClearAppHostIndex(pIndex);
+
+    hr = pIndex->pCollection->get_Count(&cElements);
+    IisExitOnFailure(hr, "Failed get IAppHostElementCollection count");
+
+    hr = MemEnsureArraySize(reinterpret_cast<LPVOID*>(&pIndex->rgEntries), cElements, sizeof(IIS7_APPHOSTINDEX_ENTRY), IIS7_APPHOSTINDEX_GROWTH);
+    IisExitOnFailure(hr, "Failed to allocate AppHost element index entries.");
+
+    hr = DictCreateWithEmbeddedKey(&pIndex->sdValues, cElements, reinterpret_cast<void**>(&pIndex->rgEntries), offsetof(IIS7_APPHOSTINDEX_ENTRY, sczValue), DICT_FLAG_NONE);
+    IisExitOnFailure(hr, "Failed to create AppHost element index dictionary.");
+
+    vtIndex.vt = VT_UI4;
+    for (DWORD i = 0; i < cElements; ++i)
+    {
+        vtIndex.ulVal = i;
+        hr = pIndex->pCollection->get_Item(vtIndex, &pElement);
+        IisExitOnFailure(hr, "Failed get IAppHostElement element");
+
+        hr = IndexAppHostElement(pIndex, pElement, i);
+        IisExitOnFailure(hr, "Failed to index IAppHostElement element");
+
+        ReleaseNullObject(pElement);
+    }
+
+    pIndex->cElements = cElements;
+    pIndex->fBuilt = TRUE;
+
+LExit:
+    if (FAILED(hr))
+    {
+        ClearAppHostIndex(pIndex);
+    }
+
+    ReleaseObject(pElement);
+    ReleaseVariant(vtIndex);
+
+    return hr;
+}
+
+static HRESULT IndexAppHostElement(
+    __in IIS7_APPHOSTINDEX* pIndex,
+    __in IAppHostElement* pElement,
+    __in DWORD dwIndex
+    )
+{
+    HRESULT hr = S_OK;
+    BSTR bstrElementName = NULL;
+    LPWSTR sczKey = NULL;
+    IIS7_APPHOSTINDEX_ENTRY* pEntry = NULL;
+    VARIANT vtValue;
+    VARIANT vtMaxValue;
+
+    ::VariantInit(&vtValue);
+    ::VariantInit(&vtMaxValue);
+
+    hr = pElement->get_Name(&bstrElementName);
+    IisExitOnFailure(hr, "Failed to get name of element");
+
+    if (CSTR_EQUAL != ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, pIndex->sczElementName, -1, bstrElementName, -1))
+    {
+        ExitFunction();
+    }
+
+    if (pIndex->sczMaxAttributeName)
+    {
+        // Values that are missing or not integers do not count.
+        hr = Iis7GetPropertyVariant(pElement, pIndex->sczMaxAttributeName, &vtMaxValue);
+        if (SUCCEEDED(hr) && (VT_I4 == vtMaxValue.vt || VT_UI4 == vtMaxValue.vt) && vtMaxValue.ulVal > pIndex->dwMaxValue)
+        {
+            pIndex->dwMaxValue = vtMaxValue.ulVal;
+        }
+    }
+
+    // Elements that the linear search cannot read never match, so they are left out of the index.
+    hr = Iis7GetPropertyVariant(pElement, pIndex->sczAttributeName, &vtValue);
+    if (FAILED(hr))
+    {
+        ExitFunction1(hr = S_OK);
+    }
+
+    // Values of other types may still compare equal to a string, so misses have to be searched.
+    if (!ISSTRINGVARIANT(vtValue.vt))
+    {
+        pIndex->fUnkeyed = TRUE;
+        ExitFunction1(hr = S_OK);
+    }
+
+    hr = GetAppHostIndexKey(pIndex, vtValue.bstrVal ? vtValue.bstrVal : L"", &sczKey);
+    if (FAILED(hr))
+    {
+        pIndex->fUnkeyed = TRUE;
+        ExitFunction1(hr = S_OK);
+    }
+
+    hr = DictGetValue(pIndex->sdValues, sczKey, reinterpret_cast<void**>(&pEntry));
+    if (SUCCEEDED(hr))
+    {
+        // Keep the element that a front to back search finds first.
+        if (dwIndex < GetAppHostIndexEntryPosition(pIndex, pEntry))
+        {
+            pEntry->dwIndex = dwIndex - pIndex->dwIndexBase;
+        }
+        ExitFunction();
+    }
+    else if (E_NOTFOUND != hr)
+    {
+        IisExitOnFailure(hr, "Failed to look up %ls in AppHost element index.", vtValue.bstrVal);
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<LPVOID*>(&pIndex->rgEntries), pIndex->cEntries, 1, sizeof(IIS7_APPHOSTINDEX_ENTRY), IIS7_APPHOSTINDEX_GROWTH);
+    IisExitOnFailure(hr, "Failed to grow AppHost element index entries.");
+
+    pEntry = pIndex->rgEntries + pIndex->cEntries;
+    pEntry->sczValue = sczKey;
+    pEntry->dwIndex = dwIndex - pIndex->dwIndexBase;
+    sczKey = NULL;
+    ++pIndex->cEntries;
+
+    hr = DictAddValue(pIndex->sdValues, pEntry);
+    IisExitOnFailure(hr, "Failed to add %ls to AppHost element index.", vtValue.bstrVal);
+
+LExit:
+    ReleaseBSTR(bstrElementName);
+    ReleaseStr(sczKey);
+    ReleaseVariant(vtMaxValue);
+    ReleaseVariant(vtValue);
+
+    return hr;
+}
+
+static HRESULT GetAppHostIndexKey(
+    __in IIS7_APPHOSTINDEX* pIndex,
+    __in_z LPCWSTR wzValue,
+    __deref_out_z LPWSTR* psczKey
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczPath = NULL;
+    BYTE* pbSortKey = NULL;
+    int cbSortKey = 0;
+
+    if (IIS7_APPHOSTINDEX_FLAG_PATH & pIndex->flags)
+    {
+        hr = PathExpand(&sczPath, wzValue, PATH_EXPAND_ENVIRONMENT | PATH_EXPAND_FULLPATH);
+        IisExitOnFailure(hr, "Failed to expand path %ls", wzValue);
+
+        wzValue = sczPath;
+    }
+
+    // Both comparators end in CompareStringW with LOCALE_INVARIANT and NORM_IGNORECASE, which
+    // compares these sort keys, so values the linear search treats as equal share a key.
+    cbSortKey = ::LCMapStringW(LOCALE_INVARIANT, LCMAP_SORTKEY | NORM_IGNORECASE, wzValue, -1, NULL, 0);
+    if (!cbSortKey)
+    {
+        IisExitWithLastError(hr, "Failed to get sort key size for %ls", wzValue);
+    }
+
+    pbSortKey = static_cast<BYTE*>(MemAlloc(cbSortKey, FALSE));
+    IisExitOnNull(pbSortKey, hr, E_OUTOFMEMORY, "Failed to allocate sort key.");
+
+    cbSortKey = ::LCMapStringW(LOCALE_INVARIANT, LCMAP_SORTKEY | NORM_IGNORECASE, wzValue, -1, reinterpret_cast<LPWSTR>(pbSortKey), cbSortKey);
+    if (!cbSortKey)
+    {
+        IisExitWithLastError(hr, "Failed to get sort key for %ls", wzValue);
+    }
+
+    hr = StrAllocHexEncode(pbSortKey, cbSortKey, psczKey);
+    IisExitOnFailure(hr, "Failed to encode index key.");
+
+LExit:
+    ReleaseMem(pbSortKey);
+    ReleaseStr(sczPath);
+
+    return hr;
+}
+
+static void ClearAppHostIndex(
+    __in IIS7_APPHOSTINDEX* pIndex
+    )
+{
+    ReleaseNullDict(pIndex->sdValues);
+
+    for (DWORD i = 0; i < pIndex->cEntries; ++i)
+    {
+        ReleaseStr(pIndex->rgEntries[i].sczValue);
+    }
+
+    pIndex->cEntries = 0;
+    pIndex->cElements = 0;
+    pIndex->dwIndexBase = 0;
+    pIndex->dwMaxValue = 0;
+    pIndex->fUnkeyed = FALSE;
+    pIndex->fBuilt = FALSE;
+}
+
+static DWORD GetAppHostIndexEntryPosition(
+    __in IIS7_APPHOSTINDEX* pIndex,
+    __in IIS7_APPHOSTINDEX_ENTRY* pEntry
+    )
+{
+    // Unsigned wraparound keeps this right for elements inserted at the front after the base moved.
+    return pEntry->dwIndex + pIndex->dwIndexBase;
+}
@@ -6,6 +6,11 @@
 extern "C" {
 #endif
 
+#define ReleaseBundleSnapshot(h) if (h) { BundleSnapshotDestroy(h); }
+#define ReleaseNullBundleSnapshot(h) if (h) { BundleSnapshotDestroy(h); h = NULL; }
+
+typedef void* BUNDLE_SNAPSHOT_HANDLE;
+
 typedef enum _BUNDLE_INSTALL_CONTEXT
 {
     BUNDLE_INSTALL_CONTEXT_MACHINE,
@@ -204,6 +209,41 @@ HRESULT BundleQueryRelatedBundles(
     __in_opt LPVOID pvContext
     );
 
+/********************************************************************
+BundleSnapshotCreate - Creates a snapshot of the bundle installation metadata.
+                       Each scope and bitness of the uninstall key is read once,
+                       the first time it is queried through the snapshot.
+                       Use BundleSnapshotDestroy or ReleaseBundleSnapshot to release.
+********************************************************************/
+HRESULT DAPI BundleSnapshotCreate(
+    __out BUNDLE_SNAPSHOT_HANDLE* phSnapshot
+    );
+
+/********************************************************************
+BundleSnapshotQueryRelatedBundles - Same as BundleQueryRelatedBundles but matches codes
+                                    against the snapshot instead of the registry.
+                                    Only related bundles are opened to be passed to the callback.
+                                    If hSnapshot is NULL, a temporary snapshot is used.
+********************************************************************/
+HRESULT DAPI BundleSnapshotQueryRelatedBundles(
+    __in_opt BUNDLE_SNAPSHOT_HANDLE hSnapshot,
+    __in BUNDLE_INSTALL_CONTEXT installContext,
+    __in_z_opt LPCWSTR* rgwzDetectCodes,
+    __in DWORD cDetectCodes,
+    __in_z_opt LPCWSTR* rgwzUpgradeCodes,
+    __in DWORD cUpgradeCodes,
+    __in_z_opt LPCWSTR* rgwzAddonCodes,
+    __in DWORD cAddonCodes,
+    __in_z_opt LPCWSTR* rgwzPatchCodes,
+    __in DWORD cPatchCodes,
+    __in PFNBUNDLE_QUERY_RELATED_BUNDLE_CALLBACK pfnCallback,
+    __in_opt LPVOID pvContext
+    );
+
+void DAPI BundleSnapshotDestroy(
+    __in BUNDLE_SNAPSHOT_HANDLE hSnapshot
+    );
+
 
 #ifdef __cplusplus
 }
@@ -7,6 +7,7 @@ typedef enum DIR_DELETE
     DIR_DELETE_FILES = 1,
     DIR_DELETE_RECURSE = 2,
     DIR_DELETE_SCHEDULE = 4,
+    DIR_DELETE_PARALLEL = 8, // with DIR_DELETE_FILES | DIR_DELETE_RECURSE, deletes the files on a small pool of threads.
 } DIR_DELETE;
 
 #ifdef __cplusplus
@@ -115,9 +115,21 @@ extern "C" {
 #define IIS_CONFIG_HTTPLOGGING_SECTION      L"system.webServer/httpLogging"
 #define IIS_CONFIG_DONTLOG                  L"dontLog"
 
+#define ReleaseIis7AppHostIndex(h) if (h) { Iis7AppHostIndexRelease(h); }
+#define ReleaseNullIis7AppHostIndex(h) if (h) { Iis7AppHostIndexRelease(h); h = NULL; }
+
 typedef BOOL (CALLBACK* ENUMAPHOSTELEMENTPROC)(IAppHostElement*, LPVOID);
 typedef BOOL (CALLBACK* VARIANTCOMPARATORPROC)(VARIANT*, VARIANT*);
 
+typedef void* IIS7_APPHOSTINDEX_HANDLE;
+
+typedef enum IIS7_APPHOSTINDEX_FLAG
+{
+    IIS7_APPHOSTINDEX_FLAG_NONE = 0,
+    // Match values the way Iis7FindAppHostElementPath does instead of Iis7FindAppHostElementString.
+    IIS7_APPHOSTINDEX_FLAG_PATH = 1,
+} IIS7_APPHOSTINDEX_FLAG;
+
 HRESULT DAPI Iis7PutPropertyVariant(
     __in IAppHostElement *pElement,
     __in LPCWSTR wzPropName,
@@ -217,6 +229,61 @@ HRESULT DAPI Iis7FindAppHostMethod(
     __out DWORD* pdwIndex
     );
 
+/********************************************************************
+ Iis7AppHostIndex - snapshot index over the elements of a collection
+   keyed by the string value of one attribute, so repeated lookups do
+   not enumerate the collection through COM. The index is built on
+   first use. Add and delete elements through the index to keep it
+   current; call Iis7AppHostIndexInvalidate after any other change.
+   Only hits that still match the live element are returned from the
+   index and stale hits fall back to the linear search. Misses are
+   answered from the index unless an element could not be keyed, so
+   they are only right while every change goes through the index.
+
+ Iis7AppHostIndexGetMaxInteger - largest integer value of another
+   attribute across the indexed elements, kept up to date by adds.
+
+********************************************************************/
+HRESULT DAPI Iis7AppHostIndexCreate(
+    __in IAppHostElementCollection *pCollection,
+    __in_z LPCWSTR wzElementName,
+    __in_z LPCWSTR wzAttributeName,
+    __in IIS7_APPHOSTINDEX_FLAG flags,
+    __out IIS7_APPHOSTINDEX_HANDLE* phIndex
+    );
+
+HRESULT DAPI Iis7AppHostIndexFind(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzAttributeValue,
+    __out_opt IAppHostElement** ppElement,
+    __out_opt DWORD* pdwIndex
+    );
+
+HRESULT DAPI Iis7AppHostIndexAddElement(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in IAppHostElement* pElement,
+    __in INT iPosition
+    );
+
+HRESULT DAPI Iis7AppHostIndexDeleteElement(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in DWORD dwIndex
+    );
+
+HRESULT DAPI Iis7AppHostIndexGetMaxInteger(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzAttributeName,
+    __out DWORD* pdwMaxValue
+    );
+
+void DAPI Iis7AppHostIndexInvalidate(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex
+    );
+
+void DAPI Iis7AppHostIndexRelease(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex
+    );
+
 #ifdef __cplusplus
 }
 #endif
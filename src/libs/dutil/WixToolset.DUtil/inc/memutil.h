@@ -8,6 +8,25 @@ extern "C" {
 
 #define ReleaseMem(p) if (p) { MemFree(p); }
 #define ReleaseNullMem(p) if (p) { MemFree(p); p = NULL; }
+#define ReleaseMemArena(h) if (h) { MemArenaDestroy(h); }
+#define ReleaseNullMemArena(h) if (h) { MemArenaDestroy(h); h = NULL; }
+#define ReleaseMemHeap(h) if (h) { MemHeapDestroy(h); }
+#define ReleaseNullMemHeap(h) if (h) { MemHeapDestroy(h); h = NULL; }
+
+// Typed wrappers that take the item size from the array's type.
+#define MemEnsureArrayCapacityOf(rg, cArray, pcCapacity) MemEnsureArrayCapacity((LPVOID*)&(rg), (cArray), sizeof(*(rg)), (pcCapacity))
+#define MemInsertIntoArrayOf(rg, dwInsertIndex, cInsertItems, cExistingArray, pcCapacity) MemInsertIntoArrayWithCapacity((LPVOID*)&(rg), (dwInsertIndex), (cInsertItems), (cExistingArray), sizeof(*(rg)), (pcCapacity))
+
+typedef void* MEM_ARENA_HANDLE;
+
+typedef struct _MEM_STATISTICS
+{
+    DWORD64 cAllocations;
+    DWORD64 cReAllocations;
+    DWORD64 cFrees;
+    LONG64 cbCurrent;
+    LONG64 cbPeak;
+} MEM_STATISTICS;
 
 HRESULT DAPI MemInitialize();
 void DAPI MemUninitialize();
@@ -59,6 +78,37 @@ HRESULT DAPI MemInsertIntoArray(
     __in SIZE_T cbArrayType,
     __in DWORD dwGrowthCount
     );
+
+/********************************************************************
+MemEnsureArrayCapacity - Makes room for cArray items. *pcCapacity is the
+                         number of items allocated, starts at 0 for a NULL
+                         array and is kept by the caller next to the count.
+                         The capacity at least doubles every time the array
+                         grows, so appending items one at a time copies the
+                         array O(log n) times. New items are zeroed.
+********************************************************************/
+HRESULT DAPI MemEnsureArrayCapacity(
+    __deref_inout_bcount(*pcCapacity * cbArrayType) LPVOID* ppvArray,
+    __in DWORD cArray,
+    __in SIZE_T cbArrayType,
+    __inout DWORD* pcCapacity
+    );
+
+/********************************************************************
+MemInsertIntoArrayWithCapacity - Inserts cInsertItems zeroed items at
+                                 dwInsertIndex into an array of
+                                 cExistingArray items, growing it like
+                                 MemEnsureArrayCapacity.
+********************************************************************/
+HRESULT DAPI MemInsertIntoArrayWithCapacity(
+    __deref_inout_bcount(*pcCapacity * cbArrayType) LPVOID* ppvArray,
+    __in DWORD dwInsertIndex,
+    __in DWORD cInsertItems,
+    __in DWORD cExistingArray,
+    __in SIZE_T cbArrayType,
+    __inout DWORD* pcCapacity
+    );
+
 void DAPI MemRemoveFromArray(
     __inout_bcount((cExistingArray) * cbArrayType) LPVOID pvArray,
     __in DWORD dwRemoveIndex,
@@ -85,6 +135,71 @@ HRESULT DAPI MemSizeChecked(
     __out SIZE_T* pcb
     );
 
+/********************************************************************
+MemStatisticsEnable - Starts or stops counting MemAlloc, MemReAlloc and MemFree calls.
+                      Enabling resets the counters. Memory allocated before counting
+                      was enabled is subtracted from cbCurrent when it is freed.
+********************************************************************/
+void DAPI MemStatisticsEnable(
+    __in BOOL fEnable
+    );
+
+/********************************************************************
+MemStatisticsGet - Returns the counters collected since counting was enabled.
+********************************************************************/
+void DAPI MemStatisticsGet(
+    __out MEM_STATISTICS* pStatistics
+    );
+
+/********************************************************************
+MemHeapCreate - Creates a growable private heap with the low-fragmentation
+                heap enabled, so a subsystem's allocations don't contend
+                with the process heap. Use MemHeapDestroy or ReleaseMemHeap
+                to release everything allocated from it.
+********************************************************************/
+HRESULT DAPI MemHeapCreate(
+    __out HANDLE* phHeap
+    );
+
+void DAPI MemHeapDestroy(
+    __in HANDLE hHeap
+    );
+
+/********************************************************************
+MemArenaCreate - Creates a bump-pointer arena. Allocations from the arena
+                 are never freed individually; they are all released by
+                 MemArenaReset or MemArenaDestroy. Blocks of cbBlock bytes
+                 (0 for the default) come from hHeap, or from the process
+                 heap when hHeap is NULL. An arena is not thread safe.
+********************************************************************/
+HRESULT DAPI MemArenaCreate(
+    __in_opt HANDLE hHeap,
+    __in SIZE_T cbBlock,
+    __out MEM_ARENA_HANDLE* phArena
+    );
+
+/********************************************************************
+MemArenaAlloc - Allocates aligned memory from the arena. Returns NULL
+                when out of memory. The memory must not be passed to MemFree.
+********************************************************************/
+LPVOID DAPI MemArenaAlloc(
+    __in MEM_ARENA_HANDLE hArena,
+    __in SIZE_T cbSize,
+    __in BOOL fZero
+    );
+
+/********************************************************************
+MemArenaReset - Releases everything allocated from the arena while
+                keeping its first block for reuse.
+********************************************************************/
+void DAPI MemArenaReset(
+    __in MEM_ARENA_HANDLE hArena
+    );
+
+void DAPI MemArenaDestroy(
+    __in MEM_ARENA_HANDLE hArena
+    );
+
 #ifdef __cplusplus
 }
 #endif
@@ -49,6 +49,25 @@ typedef void (*PFN_MONREGKEY)(
     __in_opt LPVOID pvRegKeyContext
     );
 
+typedef struct _MON_FILE_CHANGE
+{
+    DWORD dwAction; // FILE_ACTION_ADDED, FILE_ACTION_REMOVED, FILE_ACTION_MODIFIED, FILE_ACTION_RENAMED_OLD_NAME or FILE_ACTION_RENAMED_NEW_NAME
+    LPCWSTR wzPath; // Relative to the monitored directory
+} MON_FILE_CHANGE;
+
+// Only called by monitors created with MonCreateEx(), in place of PFN_MONDIRECTORY when both are provided. The changes are only valid for the duration of the callback.
+// When the individual changes aren't known (the directory was just created, more changed than could be recorded or the wait failed) rgChanges is NULL and
+// cChanges is 0, so the whole directory should be rescanned.
+typedef void (*PFN_MONDIRECTORYCHANGES)(
+    __in HRESULT hr,
+    __in_z LPCWSTR wzPath,
+    __in BOOL fRecursive,
+    __in_ecount_opt(cChanges) const MON_FILE_CHANGE* rgChanges,
+    __in DWORD cChanges,
+    __in_opt LPVOID pvContext,
+    __in_opt LPVOID pvDirectoryContext
+    );
+
 // Silence period allows you to avoid lots of notifications when a lot of writes are going on in a directory
 // MonUtil will wait until the directory has been "silent" for at least dwSilencePeriodInMs milliseconds
 // The drawback to setting this to a value higher than zero is that even single write notifications
@@ -61,6 +80,20 @@ HRESULT DAPI MonCreate(
     __in_opt PFN_MONREGKEY vpfMonRegKey,
     __in_opt LPVOID pvContext
     );
+// Creates a monitor that waits on directories with ReadDirectoryChangesW() on a single I/O completion port serviced by cThreads worker threads
+// (0 for the default) instead of spending a waiter thread on every 63 waits, so it scales to many thousands of directories and registry keys.
+// Adds and removes are handed to the worker threads, so changes made before MonAddDirectory() or MonAddRegKey() has been picked up may not be reported.
+// Drive status is not reported and network waits aren't periodically retried while they succeed; failed waits are retried every minute.
+// The callbacks are called on the worker threads, so unlike MonCreate() they may run concurrently with each other (up to cThreads at once) and must be thread safe.
+HRESULT DAPI MonCreateEx(
+    __out_bcount(MON_HANDLE_BYTES) MON_HANDLE *pHandle,
+    __in DWORD cThreads,
+    __in PFN_MONGENERAL vpfMonGeneral,
+    __in_opt PFN_MONDIRECTORY vpfMonDirectory,
+    __in_opt PFN_MONDIRECTORYCHANGES vpfMonDirectoryChanges,
+    __in_opt PFN_MONREGKEY vpfMonRegKey,
+    __in_opt LPVOID pvContext
+    );
 // Don't add multiple identical waits! Not only is it wasteful and will cause multiple fires for the exact same change, it will also
 // result in slightly odd behavior when you remove a duplicated wait (removing a wait may or may not remove multiple waits)
 // This is due to the way coordinator thread and waiter threads handle removing, and while it is possible to solve, doing so would complicate the code.
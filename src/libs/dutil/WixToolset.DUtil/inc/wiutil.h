@@ -18,6 +18,9 @@ extern "C" {
                         INSTALLLOGMODE_OUTOFDISKSPACE | INSTALLLOGMODE_ACTIONSTART | \
                         INSTALLLOGMODE_ACTIONDATA | INSTALLLOGMODE_COMMONDATA | INSTALLLOGMODE_PROPERTYDUMP
 
+// Bit for an INSTALLMESSAGE type in the ignored messages passed to WiuSetExternalUIMessageFilter.
+#define WIU_MSI_MESSAGE_FLAG(mt) (1 << (((DWORD)(mt)) >> 24))
+
 #define ReleaseMsi(h) if (h) { ::MsiCloseHandle(h); }
 #define ReleaseNullMsi(h) if (h) { ::MsiCloseHandle(h); h = NULL; }
 
@@ -100,6 +103,11 @@ typedef struct _WIU_MSI_EXECUTE_CONTEXT
     WIU_MSI_PROGRESS rgMsiProgress[64];
     DWORD dwCurrentProgressIndex;
 
+    DWORD dwIgnoredMessages;
+    DWORD dwProgressGranularity;
+    DWORD dwLastProgressPercentage;
+    BOOL fProgressSent;
+
     INSTALLUILEVEL previousInstallUILevel;
     HWND hwndPreviousParentWindow;
     INSTALLUI_HANDLERW pfnPreviousExternalUI;
@@ -352,6 +360,22 @@ HRESULT DAPI WiuInitializeExternalUI(
     __in BOOL fRollback,
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     );
+
+/********************************************************************
+WiuSetExternalUIMessageFilter - keeps messages the handler does not need
+                                from ever reaching it. dwIgnoredMessages
+                                is a set of WIU_MSI_MESSAGE_FLAG bits for
+                                the MSI message types to drop, and progress
+                                is only sent once it moved by at least
+                                dwProgressGranularity percent. Errors and
+                                files in use are always sent.
+********************************************************************/
+void DAPI WiuSetExternalUIMessageFilter(
+    __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext,
+    __in DWORD dwIgnoredMessages,
+    __in DWORD dwProgressGranularity
+    );
+
 void DAPI WiuUninitializeExternalUI(
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     );
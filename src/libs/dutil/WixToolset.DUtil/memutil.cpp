@@ -23,6 +23,50 @@
 static BOOL vfMemInitialized = FALSE;
 #endif
 
+#define MEM_ARENA_DEFAULT_BLOCK_SIZE (64 * 1024)
+#define MEM_ARRAY_MINIMUM_CAPACITY 8
+#define MEM_ARENA_ALIGN(cb) (((cb) + MEMORY_ALLOCATION_ALIGNMENT - 1) & ~static_cast<SIZE_T>(MEMORY_ALLOCATION_ALIGNMENT - 1))
+
+struct MEM_ARENA_BLOCK
+{
+    MEM_ARENA_BLOCK* pNext;
+    SIZE_T cb;
+    SIZE_T cbUsed;
+};
+
+struct MEM_ARENA_STRUCT
+{
+    HANDLE hHeap;
+    SIZE_T cbBlock;
+
+    // The head of the list is the block allocations are carved from.
+    MEM_ARENA_BLOCK* pBlocks;
+};
+
+static const SIZE_T MEM_ARENA_BLOCK_HEADER_SIZE = MEM_ARENA_ALIGN(sizeof(MEM_ARENA_BLOCK));
+
+static volatile LONG vfMemStatistics = FALSE;
+static volatile LONG64 vcMemAllocations = 0;
+static volatile LONG64 vcMemReAllocations = 0;
+static volatile LONG64 vcMemFrees = 0;
+static volatile LONG64 vcbMemCurrent = 0;
+static volatile LONG64 vcbMemPeak = 0;
+
+static void TrackBytes(
+    __in LONG64 cbDelta
+    );
+static SIZE_T TrackedSize(
+    __in_opt LPCVOID pv
+    );
+static MEM_ARENA_BLOCK* ArenaAllocBlock(
+    __in MEM_ARENA_STRUCT* pArena,
+    __in SIZE_T cbData
+    );
+static void ArenaFreeBlock(
+    __in MEM_ARENA_STRUCT* pArena,
+    __in MEM_ARENA_BLOCK* pBlock
+    );
+
 extern "C" HRESULT DAPI MemInitialize()
 {
 #if DEBUG
@@ -45,7 +89,15 @@ extern "C" LPVOID DAPI MemAlloc(
 {
 //    AssertSz(vfMemInitialized, "MemInitialize() not called, this would normally crash");
     AssertSz(0 < cbSize, "MemAlloc() called with invalid size");
-    return ::HeapAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, cbSize);
+    LPVOID pv = ::HeapAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, cbSize);
+
+    if (vfMemStatistics && pv)
+    {
+        ::InterlockedIncrement64(&vcMemAllocations);
+        TrackBytes(TrackedSize(pv));
+    }
+
+    return pv;
 }
 
 
@@ -57,7 +109,16 @@ extern "C" LPVOID DAPI MemReAlloc(
 {
 //    AssertSz(vfMemInitialized, "MemInitialize() not called, this would normally crash");
     AssertSz(0 < cbSize, "MemReAlloc() called with invalid size");
-    return ::HeapReAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, pv, cbSize);
+    SIZE_T cbOld = vfMemStatistics ? TrackedSize(pv) : 0;
+    LPVOID pvNew = ::HeapReAlloc(::GetProcessHeap(), fZero ? HEAP_ZERO_MEMORY : 0, pv, cbSize);
+
+    if (vfMemStatistics && pvNew)
+    {
+        ::InterlockedIncrement64(&vcMemReAllocations);
+        TrackBytes(static_cast<LONG64>(TrackedSize(pvNew)) - static_cast<LONG64>(cbOld));
+    }
+
+    return pvNew;
 }
 
 
@@ -76,10 +137,19 @@ extern "C" HRESULT DAPI MemReAllocSecure(
     DWORD dwFlags = HEAP_REALLOC_IN_PLACE_ONLY;
     LPVOID pvNew = NULL;
     SIZE_T cb = 0;
+    SIZE_T cbOld = vfMemStatistics ? TrackedSize(pv) : 0;
 
     dwFlags |= fZero ? HEAP_ZERO_MEMORY : 0;
     pvNew = ::HeapReAlloc(::GetProcessHeap(), dwFlags, pv, cbSize);
-    if (!pvNew)
+    if (pvNew)
+    {
+        if (vfMemStatistics)
+        {
+            ::InterlockedIncrement64(&vcMemReAllocations);
+            TrackBytes(static_cast<LONG64>(TrackedSize(pvNew)) - static_cast<LONG64>(cbOld));
+        }
+    }
+    else
     {
         pvNew = MemAlloc(cbSize, fZero);
         if (pvNew)
@@ -276,6 +346,88 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT DAPI MemEnsureArrayCapacity(
+    __deref_inout_bcount(*pcCapacity * cbArrayType) LPVOID* ppvArray,
+    __in DWORD cArray,
+    __in SIZE_T cbArrayType,
+    __inout DWORD* pcCapacity
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cNew = 0;
+    SIZE_T cbNew = 0;
+    LPVOID pvNew = NULL;
+
+    if (*ppvArray && cArray <= *pcCapacity)
+    {
+        ExitFunction();
+    }
+
+    // Double the capacity so appending one item at a time only copies the array O(log n) times.
+    cNew = *pcCapacity < MEM_ARRAY_MINIMUM_CAPACITY ? MEM_ARRAY_MINIMUM_CAPACITY : (*pcCapacity <= DWORD_MAX / 2 ? *pcCapacity * 2 : DWORD_MAX);
+    if (cNew < cArray)
+    {
+        cNew = cArray;
+    }
+
+    hr = ::SIZETMult(cNew, cbArrayType, &cbNew);
+    MemExitOnFailure(hr, "Integer overflow when calculating new block size.");
+
+    if (*ppvArray)
+    {
+        pvNew = MemReAlloc(*ppvArray, cbNew, TRUE);
+        MemExitOnNull(pvNew, hr, E_OUTOFMEMORY, "Failed to allocate array larger.");
+    }
+    else
+    {
+        pvNew = MemAlloc(cbNew, TRUE);
+        MemExitOnNull(pvNew, hr, E_OUTOFMEMORY, "Failed to allocate new array.");
+    }
+
+    *ppvArray = pvNew;
+    *pcCapacity = cNew;
+
+LExit:
+    return hr;
+}
+
+
+extern "C" HRESULT DAPI MemInsertIntoArrayWithCapacity(
+    __deref_inout_bcount(*pcCapacity * cbArrayType) LPVOID* ppvArray,
+    __in DWORD dwInsertIndex,
+    __in DWORD cInsertItems,
+    __in DWORD cExistingArray,
+    __in SIZE_T cbArrayType,
+    __inout DWORD* pcCapacity
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD cNew = 0;
+    BYTE* pbArray = NULL;
+
+    Assert(dwInsertIndex <= cExistingArray);
+
+    if (0 == cInsertItems)
+    {
+        ExitFunction1(hr = S_OK);
+    }
+
+    hr = ::DWordAdd(cExistingArray, cInsertItems, &cNew);
+    MemExitOnFailure(hr, "Integer overflow when calculating new element count.");
+
+    hr = MemEnsureArrayCapacity(ppvArray, cNew, cbArrayType, pcCapacity);
+    MemExitOnFailure(hr, "Failed to resize array while inserting items");
+
+    pbArray = reinterpret_cast<BYTE*>(*ppvArray);
+    memmove(pbArray + (dwInsertIndex + cInsertItems) * cbArrayType, pbArray + dwInsertIndex * cbArrayType, (cExistingArray - dwInsertIndex) * cbArrayType);
+
+    // Zero out the newly-inserted items
+    memset(pbArray + dwInsertIndex * cbArrayType, 0, cInsertItems * cbArrayType);
+
+LExit:
+    return hr;
+}
+
 extern "C" void DAPI MemRemoveFromArray(
     __inout_bcount((cExistingArray) * cbArrayType) LPVOID pvArray,
     __in DWORD dwRemoveIndex,
@@ -351,7 +503,20 @@ extern "C" HRESULT DAPI MemFree(
     )
 {
 //    AssertSz(vfMemInitialized, "MemInitialize() not called, this would normally crash");
-    return ::HeapFree(::GetProcessHeap(), 0, pv) ? S_OK : HRESULT_FROM_WIN32(::GetLastError());
+    SIZE_T cb = vfMemStatistics ? TrackedSize(pv) : 0;
+
+    if (!::HeapFree(::GetProcessHeap(), 0, pv))
+    {
+        return HRESULT_FROM_WIN32(::GetLastError());
+    }
+
+    if (vfMemStatistics && pv)
+    {
+        ::InterlockedIncrement64(&vcMemFrees);
+        TrackBytes(-static_cast<LONG64>(cb));
+    }
+
+    return S_OK;
 }
 
 
@@ -382,3 +547,293 @@ extern "C" HRESULT DAPI MemSizeChecked(
 LExit:
     return hr;
 }
+
+
+extern "C" void DAPI MemStatisticsEnable(
+    __in BOOL fEnable
+    )
+{
+    if (fEnable)
+    {
+        ::InterlockedExchange64(&vcMemAllocations, 0);
+        ::InterlockedExchange64(&vcMemReAllocations, 0);
+        ::InterlockedExchange64(&vcMemFrees, 0);
+        ::InterlockedExchange64(&vcbMemCurrent, 0);
+        ::InterlockedExchange64(&vcbMemPeak, 0);
+    }
+
+    ::InterlockedExchange(&vfMemStatistics, fEnable ? TRUE : FALSE);
+}
+
+
+extern "C" void DAPI MemStatisticsGet(
+    __out MEM_STATISTICS* pStatistics
+    )
+{
+    pStatistics->cAllocations = static_cast<DWORD64>(vcMemAllocations);
+    pStatistics->cReAllocations = static_cast<DWORD64>(vcMemReAllocations);
+    pStatistics->cFrees = static_cast<DWORD64>(vcMemFrees);
+    pStatistics->cbCurrent = vcbMemCurrent;
+    pStatistics->cbPeak = vcbMemPeak;
+}
+
+
+extern "C" HRESULT DAPI MemHeapCreate(
+    __out HANDLE* phHeap
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hHeap = NULL;
+    ULONG ulHeapCompatibility = 2; // low-fragmentation heap
+
+    hHeap = ::HeapCreate(0, 0, 0);
+    MemExitOnNullWithLastError(hHeap, hr, "Failed to create private heap.");
+
+    // The low-fragmentation heap is not available when running under a debugger
+    // or with some heap flags, in which case the standard heap is still usable.
+    if (!::HeapSetInformation(hHeap, HeapCompatibilityInformation, &ulHeapCompatibility, sizeof(ulHeapCompatibility)))
+    {
+        TraceError(HRESULT_FROM_WIN32(::GetLastError()), "Failed to enable the low-fragmentation heap, continuing.");
+    }
+
+    *phHeap = hHeap;
+    hHeap = NULL;
+
+LExit:
+    if (hHeap)
+    {
+        ::HeapDestroy(hHeap);
+    }
+
+    return hr;
+}
+
+
+extern "C" void DAPI MemHeapDestroy(
+    __in HANDLE hHeap
+    )
+{
+    ::HeapDestroy(hHeap);
+}
+
+
+extern "C" HRESULT DAPI MemArenaCreate(
+    __in_opt HANDLE hHeap,
+    __in SIZE_T cbBlock,
+    __out MEM_ARENA_HANDLE* phArena
+    )
+{
+    HRESULT hr = S_OK;
+    MEM_ARENA_STRUCT* pArena = NULL;
+
+    pArena = static_cast<MEM_ARENA_STRUCT*>(MemAlloc(sizeof(MEM_ARENA_STRUCT), TRUE));
+    MemExitOnNull(pArena, hr, E_OUTOFMEMORY, "Failed to allocate arena.");
+
+    pArena->hHeap = hHeap ? hHeap : ::GetProcessHeap();
+    pArena->cbBlock = cbBlock ? MEM_ARENA_ALIGN(max(cbBlock, MEM_ARENA_BLOCK_HEADER_SIZE * 2)) : MEM_ARENA_DEFAULT_BLOCK_SIZE;
+
+    *phArena = pArena;
+    pArena = NULL;
+
+LExit:
+    ReleaseMem(pArena);
+
+    return hr;
+}
+
+
+extern "C" LPVOID DAPI MemArenaAlloc(
+    __in MEM_ARENA_HANDLE hArena,
+    __in SIZE_T cbSize,
+    __in BOOL fZero
+    )
+{
+    AssertSz(0 < cbSize, "MemArenaAlloc() called with invalid size");
+
+    MEM_ARENA_STRUCT* pArena = static_cast<MEM_ARENA_STRUCT*>(hArena);
+    MEM_ARENA_BLOCK* pBlock = pArena->pBlocks;
+    SIZE_T cbAligned = 0;
+    BYTE* pb = NULL;
+
+    if (cbSize > static_cast<SIZE_T>(-1) - MEM_ARENA_BLOCK_HEADER_SIZE - MEMORY_ALLOCATION_ALIGNMENT)
+    {
+        return NULL;
+    }
+
+    cbAligned = MEM_ARENA_ALIGN(cbSize);
+
+    if (!pBlock || pBlock->cb - pBlock->cbUsed < cbAligned)
+    {
+        if (cbAligned > pArena->cbBlock - MEM_ARENA_BLOCK_HEADER_SIZE)
+        {
+            // Too big for a standard block so give it its own block, leaving
+            // the current block at the head to keep serving small allocations.
+            pBlock = ArenaAllocBlock(pArena, cbAligned);
+            if (!pBlock)
+            {
+                return NULL;
+            }
+
+            pBlock->cbUsed = cbAligned;
+
+            if (pArena->pBlocks)
+            {
+                pBlock->pNext = pArena->pBlocks->pNext;
+                pArena->pBlocks->pNext = pBlock;
+            }
+            else
+            {
+                pArena->pBlocks = pBlock;
+            }
+
+            pb = reinterpret_cast<BYTE*>(pBlock) + MEM_ARENA_BLOCK_HEADER_SIZE;
+            if (fZero)
+            {
+                memset(pb, 0, cbSize);
+            }
+
+            return pb;
+        }
+
+        pBlock = ArenaAllocBlock(pArena, pArena->cbBlock - MEM_ARENA_BLOCK_HEADER_SIZE);
+        if (!pBlock)
+        {
+            return NULL;
+        }
+
+        pBlock->pNext = pArena->pBlocks;
+        pArena->pBlocks = pBlock;
+    }
+
+    pb = reinterpret_cast<BYTE*>(pBlock) + MEM_ARENA_BLOCK_HEADER_SIZE + pBlock->cbUsed;
+    pBlock->cbUsed += cbAligned;
+
+    if (fZero)
+    {
+        memset(pb, 0, cbSize);
+    }
+
+    return pb;
+}
+
+
+extern "C" void DAPI MemArenaReset(
+    __in MEM_ARENA_HANDLE hArena
+    )
+{
+    MEM_ARENA_STRUCT* pArena = static_cast<MEM_ARENA_STRUCT*>(hArena);
+    MEM_ARENA_BLOCK* pKeep = NULL;
+    MEM_ARENA_BLOCK* pBlock = pArena->pBlocks;
+
+    while (pBlock)
+    {
+        MEM_ARENA_BLOCK* pNext = pBlock->pNext;
+
+        if (!pKeep && pArena->cbBlock == pBlock->cb + MEM_ARENA_BLOCK_HEADER_SIZE)
+        {
+            pKeep = pBlock;
+        }
+        else
+        {
+            ArenaFreeBlock(pArena, pBlock);
+        }
+
+        pBlock = pNext;
+    }
+
+    if (pKeep)
+    {
+        pKeep->pNext = NULL;
+        pKeep->cbUsed = 0;
+    }
+
+    pArena->pBlocks = pKeep;
+}
+
+
+extern "C" void DAPI MemArenaDestroy(
+    __in MEM_ARENA_HANDLE hArena
+    )
+{
+    MEM_ARENA_STRUCT* pArena = static_cast<MEM_ARENA_STRUCT*>(hArena);
+    MEM_ARENA_BLOCK* pBlock = pArena->pBlocks;
+
+    while (pBlock)
+    {
+        MEM_ARENA_BLOCK* pNext = pBlock->pNext;
+
+        ArenaFreeBlock(pArena, pBlock);
+        pBlock = pNext;
+    }
+
+    MemFree(pArena);
+}
+
+
+static void TrackBytes(
+    __in LONG64 cbDelta
+    )
+{
+    LONG64 cbCurrent = ::InterlockedExchangeAdd64(&vcbMemCurrent, cbDelta) + cbDelta;
+    LONG64 cbPeak = vcbMemPeak;
+
+    while (cbCurrent > cbPeak)
+    {
+        LONG64 cbPrevious = ::InterlockedCompareExchange64(&vcbMemPeak, cbCurrent, cbPeak);
+        if (cbPrevious == cbPeak)
+        {
+            break;
+        }
+
+        cbPeak = cbPrevious;
+    }
+}
+
+static SIZE_T TrackedSize(
+    __in_opt LPCVOID pv
+    )
+{
+    SIZE_T cb = pv ? ::HeapSize(::GetProcessHeap(), 0, pv) : 0;
+
+    // HeapSize returns (SIZE_T)-1 for a pointer that isn't a block in the process heap; don't let that skew the counters.
+    return static_cast<SIZE_T>(-1) == cb ? 0 : cb;
+}
+
+static MEM_ARENA_BLOCK* ArenaAllocBlock(
+    __in MEM_ARENA_STRUCT* pArena,
+    __in SIZE_T cbData
+    )
+{
+    MEM_ARENA_BLOCK* pBlock = static_cast<MEM_ARENA_BLOCK*>(::HeapAlloc(pArena->hHeap, 0, MEM_ARENA_BLOCK_HEADER_SIZE + cbData));
+
+    if (pBlock)
+    {
+        pBlock->pNext = NULL;
+        pBlock->cb = cbData;
+        pBlock->cbUsed = 0;
+
+        if (vfMemStatistics)
+        {
+            ::InterlockedIncrement64(&vcMemAllocations);
+            TrackBytes(MEM_ARENA_BLOCK_HEADER_SIZE + cbData);
+        }
+    }
+
+    return pBlock;
+}
+
+static void ArenaFreeBlock(
+    __in MEM_ARENA_STRUCT* pArena,
+    __in MEM_ARENA_BLOCK* pBlock
+    )
+{
+    SIZE_T cb = MEM_ARENA_BLOCK_HEADER_SIZE + pBlock->cb;
+
+    ::HeapFree(pArena->hHeap, 0, pBlock);
+
+    if (vfMemStatistics)
+    {
+        ::InterlockedIncrement64(&vcMemFrees);
+        TrackBytes(-static_cast<LONG64>(cb));
+    }
+}
@@ -28,6 +28,12 @@ const int MON_THREAD_NETWORK_FAIL_RETRY_IN_MS = 1000*60; // if we know we failed
 const int MON_THREAD_NETWORK_SUCCESSFUL_RETRY_IN_MS = 1000*60*20; // if we're just checking for remote servers dieing, check much less frequently
 const int MON_THREAD_WAIT_REMOVE_DEVICE = 5000;
 const LPCWSTR MONUTIL_WINDOW_CLASS = L"MonUtilClass";
+const DWORD MON_PORT_DEFAULT_THREADS = 2;
+const DWORD MON_PORT_BUFFER_BYTES = 4096; // ReadDirectoryChangesW() fails over the network with buffers of 64k or more
+const DWORD MON_PORT_MAX_CHANGES = 1024; // if more changes than this pile up before a notification, report them as unknown instead
+const DWORD MON_PORT_FAILED_RETRY_IN_MS = MON_THREAD_NETWORK_FAIL_RETRY_IN_MS;
+const DWORD MON_PORT_STOP_POLL_IN_MS = 50; // while stopping, workers check this often whether they can exit even if no stop message reaches them
+const DWORD MON_PORT_NOTIFY_FILTER = FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_SECURITY;
 
 enum MON_MESSAGE
 {
@@ -56,6 +62,16 @@ enum MON_TYPE
     MON_REGKEY = 2
 };
 
+// Completion keys for packets on a MonCreateEx() completion port
+enum MON_PORT_KEY
+{
+    MON_PORT_KEY_DIRECTORY = 1, // ReadDirectoryChangesW() completed, lpOverlapped is the MON_PORT_WAIT
+    MON_PORT_KEY_REGKEY, // Registry key notification fired, lpOverlapped is the MON_PORT_WAIT
+    MON_PORT_KEY_ADD, // lpOverlapped is the new MON_PORT_WATCH
+    MON_PORT_KEY_REMOVE, // lpOverlapped is a MON_REMOVE_MESSAGE
+    MON_PORT_KEY_STOP
+};
+
 struct MON_REQUEST
 {
     MON_TYPE type;
@@ -185,6 +201,8 @@ struct MON_INTERNAL_TEMPORARY_WAIT
     void *pvContext;
 };
 
+struct MON_PORT_STRUCT;
+
 struct MON_STRUCT
 {
     HANDLE hCoordinatorThread;
@@ -209,10 +227,121 @@ struct MON_STRUCT
     // Waiter thread array
     MON_WAITER_INFO *rgWaiterThreads;
     DWORD cWaiterThreads;
+
+    // Only set for monitors created by MonCreateEx(), in which case nothing above is used
+    MON_PORT_STRUCT *pPort;
 };
 
 const int MON_HANDLE_BYTES = sizeof(MON_STRUCT);
 
+struct MON_PORT_WATCH;
+
+// A single outstanding wait of a watch. Each wait gets its own OVERLAPPED and buffer, so a cancelled wait can finish
+// completing while the watch has already moved on to a new one.
+struct MON_PORT_WAIT
+{
+    OVERLAPPED overlapped;
+    MON_PORT_WATCH *pWatch; // Holds a reference on the watch until the wait is destroyed
+
+    // Directories only, MON_PORT_BUFFER_BYTES allocated right after the struct
+    BYTE *pbBuffer;
+
+    // Registry keys only, RegNotifyChangeKeyValue() can't complete to a port so a thread pool wait posts to it instead
+    HANDLE hEvent;
+    HANDLE hRegisteredWait;
+    LONG fSignaled;
+};
+
+struct MON_PORT_WATCH
+{
+    MON_PORT_STRUCT *pPort;
+    LONG cReferences;
+
+    MON_TYPE type;
+    DWORD dwMaxSilencePeriodInMs;
+    BOOL fRecursive;
+    void *pvContext;
+
+    LPWSTR sczOriginalPathRequest;
+    LPWSTR *rgsczPathHierarchy;
+    DWORD cPathHierarchy;
+
+    // Everything below is protected by the port's critical section
+    HRESULT hrStatus;
+    DWORD dwPathHierarchyIndex;
+    MON_PORT_WAIT *pWait; // The current wait, if any
+
+    BOOL fPendingFire;
+    DWORD dwLastChangeTime;
+
+    // Changes to the target directory since the last notification
+    MON_FILE_CHANGE *rgChanges;
+    DWORD cChanges;
+    BOOL fChangesUnknown;
+
+    union
+    {
+        struct
+        {
+            HANDLE hDirectory;
+        } directory;
+        struct
+        {
+            HKEY hkRoot;
+            HKEY hkSubKey;
+            REG_KEY_BITNESS kbKeyBitness;
+        } regkey;
+    };
+};
+
+// Notifications are collected while holding the critical section and fired by the worker after releasing it
+struct MON_PORT_NOTIFICATION
+{
+    MON_PORT_WATCH *pWatch; // Holds a reference on the watch
+    HRESULT hr;
+    MON_FILE_CHANGE *rgChanges;
+    DWORD cChanges;
+};
+
+struct MON_PORT_NOTIFICATIONS
+{
+    MON_PORT_NOTIFICATION *rgNotifications;
+    DWORD cNotifications;
+};
+
+struct MON_PORT_STRUCT
+{
+    HANDLE hPort;
+    CRITICAL_SECTION cs;
+    BOOL fStopping;
+
+    HANDLE *rgThreads;
+    DWORD cThreads;
+
+    // Callbacks
+    PFN_MONGENERAL vpfMonGeneral;
+    PFN_MONDIRECTORY vpfMonDirectory;
+    PFN_MONDIRECTORYCHANGES vpfMonDirectoryChanges;
+    PFN_MONREGKEY vpfMonRegKey;
+
+    // Context for callbacks
+    LPVOID pvContext;
+
+    // Watches not yet freed, including removed ones still referenced by outstanding waits or notifications
+    LONG cAllocatedWatches;
+
+    // Everything below is protected by cs
+    MON_PORT_WATCH **rgpWatches;
+    DWORD cWatches;
+
+    // Watches waiting for their silence period to pass before notifying
+    MON_PORT_WATCH **rgpPendingFires;
+    DWORD cPendingFires;
+
+    DWORD cWatchesFailing;
+    DWORD dwLastRetryTime;
+};
+
 static DWORD WINAPI CoordinatorThread(
     __in_bcount(sizeof(MON_STRUCT)) LPVOID pvContext
     );
@@ -281,6 +410,126 @@ static HRESULT UpdateWaitStatus(
     __in DWORD dwRequestIndex,
     __out_opt DWORD *pdwNewRequestIndex
     );
+static void PortDestroy(
+    __in MON_PORT_STRUCT *pPort
+    );
+static HRESULT PortAddWatch(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_TYPE type,
+    __in_opt HKEY hkRoot,
+    __in_z LPCWSTR wzPath,
+    __in REG_KEY_BITNESS kbKeyBitness,
+    __in BOOL fRecursive,
+    __in DWORD dwSilencePeriodInMs,
+    __in_opt LPVOID pvContext
+    );
+static void PortWatchRelease(
+    __in MON_PORT_WATCH *pWatch
+    );
+static DWORD WINAPI PortWorkerThread(
+    __in_bcount(sizeof(MON_PORT_STRUCT)) LPVOID pvContext
+    );
+static HRESULT PortProcessAdd(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    );
+static void PortProcessRemove(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_REMOVE_MESSAGE *pMessage
+    );
+static BOOL PortProcessStop(
+    __in MON_PORT_STRUCT *pPort
+    );
+static HRESULT PortProcessWait(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WAIT *pWait,
+    __in DWORD er,
+    __in DWORD cbTransferred,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    );
+static HRESULT PortProcessTimers(
+    __in MON_PORT_STRUCT *pPort,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    );
+static DWORD PortGetTimeout(
+    __in MON_PORT_STRUCT *pPort
+    );
+// Like InitiateWait(), waits on the directory or subkey, or on the first existing parent if it doesn't exist
+static HRESULT PortInitiateWait(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    );
+static HRESULT PortWaitOnDirectory(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    );
+static HRESULT PortWaitOnRegKey(
+    __in MON_PORT_WATCH *pWatch
+    );
+static HRESULT PortReadDirectoryChanges(
+    __in MON_PORT_WATCH *pWatch,
+    __in MON_PORT_WAIT *pWait
+    );
+static HRESULT PortOpenDirectory(
+    __in_z LPCWSTR wzPath,
+    __out HANDLE *phDirectory
+    );
+static void CALLBACK PortRegKeyWaitCallback(
+    __in PVOID pvContext,
+    __in BOOLEAN fTimedOut
+    );
+static void PortCancelWait(
+    __in MON_PORT_WATCH *pWatch
+    );
+static HRESULT PortWaitCreate(
+    __in MON_PORT_WATCH *pWatch,
+    __in DWORD cbBuffer,
+    __out MON_PORT_WAIT **ppWait
+    );
+static void PortWaitDestroy(
+    __in MON_PORT_WAIT *pWait
+    );
+static HRESULT PortCollectChanges(
+    __in MON_PORT_WATCH *pWatch,
+    __in_bcount(cbBuffer) const BYTE *pbBuffer,
+    __in DWORD cbBuffer
+    );
+static void PortDiscardChanges(
+    __in MON_PORT_WATCH *pWatch
+    );
+static HRESULT PortUpdateStatus(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch,
+    __in HRESULT hrNewStatus,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    );
+static HRESULT PortQueueFire(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    );
+static HRESULT PortQueueNotification(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch,
+    __in HRESULT hr,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    );
+static void PortFireNotifications(
+    __in MON_PORT_STRUCT *pPort,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    );
+static void PortRemoveWatch(
+    __in MON_PORT_STRUCT *pPort,
+    __in DWORD dwIndex
+    );
+static void PortRemovePendingFire(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    );
+static void PortReleaseChanges(
+    __in_ecount_opt(cChanges) MON_FILE_CHANGE *rgChanges,
+    __in DWORD cChanges
+    );
 
 extern "C" HRESULT DAPI MonCreate(
     __out_bcount(MON_HANDLE_BYTES) MON_HANDLE *pHandle,
@@ -331,6 +580,72 @@ LExit:
     return hr;
 }
 
+extern "C" HRESULT DAPI MonCreateEx(
+    __out_bcount(MON_HANDLE_BYTES) MON_HANDLE *pHandle,
+    __in DWORD cThreads,
+    __in PFN_MONGENERAL vpfMonGeneral,
+    __in_opt PFN_MONDIRECTORY vpfMonDirectory,
+    __in_opt PFN_MONDIRECTORYCHANGES vpfMonDirectoryChanges,
+    __in_opt PFN_MONREGKEY vpfMonRegKey,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    MON_STRUCT *pm = NULL;
+    MON_PORT_STRUCT *pPort = NULL;
+
+    MonExitOnNull(pHandle, hr, E_INVALIDARG, "Pointer to handle not specified while creating monitor");
+
+    pm = static_cast<MON_STRUCT *>(MemAlloc(sizeof(MON_STRUCT), TRUE));
+    MonExitOnNull(pm, hr, E_OUTOFMEMORY, "Failed to allocate monitor object");
+
+    pPort = static_cast<MON_PORT_STRUCT *>(MemAlloc(sizeof(MON_PORT_STRUCT), TRUE));
+    MonExitOnNull(pPort, hr, E_OUTOFMEMORY, "Failed to allocate completion port monitor object");
+
+    ::InitializeCriticalSection(&pPort->cs);
+    pm->pPort = pPort;
+
+    pPort->vpfMonGeneral = vpfMonGeneral;
+    pPort->vpfMonDirectory = vpfMonDirectory;
+    pPort->vpfMonDirectoryChanges = vpfMonDirectoryChanges;
+    pPort->vpfMonRegKey = vpfMonRegKey;
+    pPort->pvContext = pvContext;
+
+    if (0 == cThreads)
+    {
+        cThreads = MON_PORT_DEFAULT_THREADS;
+    }
+
+    pPort->hPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, cThreads);
+    MonExitOnNullWithLastError(pPort->hPort, hr, "Failed to create completion port.");
+
+    pPort->rgThreads = static_cast<HANDLE *>(MemAlloc(sizeof(HANDLE) * cThreads, TRUE));
+    MonExitOnNull(pPort->rgThreads, hr, E_OUTOFMEMORY, "Failed to allocate completion port worker thread array");
+
+    for (DWORD i = 0; i < cThreads; ++i)
+    {
+        pPort->rgThreads[i] = ::CreateThread(NULL, 0, PortWorkerThread, pPort, 0, NULL);
+        MonExitOnNullWithLastError(pPort->rgThreads[i], hr, "Failed to create completion port worker thread.");
+
+        ++pPort->cThreads;
+    }
+
+    *pHandle = pm;
+    pm = NULL;
+
+LExit:
+    if (pm && pm->pPort)
+    {
+        MonDestroy(pm);
+    }
+    else
+    {
+        ReleaseMem(pm);
+    }
+
+    return hr;
+}
+
 extern "C" HRESULT DAPI MonAddDirectory(
     __in_bcount(MON_HANDLE_BYTES) MON_HANDLE handle,
     __in_z LPCWSTR wzDirectory,
@@ -345,6 +660,12 @@ extern "C" HRESULT DAPI MonAddDirectory(
     LPWSTR sczOriginalPathRequest = NULL;
     MON_ADD_MESSAGE *pMessage = NULL;
 
+    if (pm->pPort)
+    {
+        hr = PortAddWatch(pm->pPort, MON_DIRECTORY, NULL, wzDirectory, REG_KEY_DEFAULT, fRecursive, dwSilencePeriodInMs, pvDirectoryContext);
+        ExitFunction();
+    }
+
     hr = StrAllocString(&sczOriginalPathRequest, wzDirectory, 0);
     MonExitOnFailure(hr, "Failed to convert directory string to UNC path");
 
@@ -421,6 +742,12 @@ extern "C" HRESULT DAPI MonAddRegKey(
     LPWSTR sczSubKey = NULL;
     MON_ADD_MESSAGE *pMessage = NULL;
 
+    if (pm->pPort)
+    {
+        hr = PortAddWatch(pm->pPort, MON_REGKEY, hkRoot, wzSubKey, kbKeyBitness, fRecursive, dwSilencePeriodInMs, pvRegKeyContext);
+        ExitFunction();
+    }
+
     hr = StrAllocString(&sczSubKey, wzSubKey, 0);
     MonExitOnFailure(hr, "Failed to copy subkey string");
 
@@ -489,7 +816,14 @@ extern "C" HRESULT DAPI MonRemoveDirectory(
     hr = StrAllocString(&pMessage->directory.sczDirectory, sczDirectory, 0);
     MonExitOnFailure(hr, "Failed to allocate copy of directory string");
 
-    if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_REMOVE, reinterpret_cast<WPARAM>(pMessage), 0))
+    if (pm->pPort)
+    {
+        if (!::PostQueuedCompletionStatus(pm->pPort->hPort, 0, MON_PORT_KEY_REMOVE, reinterpret_cast<LPOVERLAPPED>(pMessage)))
+        {
+            MonExitWithLastError(hr, "Failed to send message to completion port to remove directory wait for path %ls", sczDirectory);
+        }
+    }
+    else if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_REMOVE, reinterpret_cast<WPARAM>(pMessage), 0))
     {
         MonExitWithLastError(hr, "Failed to send message to worker thread to add directory wait for path %ls", sczDirectory);
     }
@@ -531,7 +865,14 @@ extern "C" HRESULT DAPI MonRemoveRegKey(
     hr = StrAllocString(&pMessage->regkey.sczSubKey, sczSubKey, 0);
     MonExitOnFailure(hr, "Failed to allocate copy of directory string");
 
-    if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_REMOVE, reinterpret_cast<WPARAM>(pMessage), 0))
+    if (pm->pPort)
+    {
+        if (!::PostQueuedCompletionStatus(pm->pPort->hPort, 0, MON_PORT_KEY_REMOVE, reinterpret_cast<LPOVERLAPPED>(pMessage)))
+        {
+            MonExitWithLastError(hr, "Failed to send message to completion port to remove regkey wait for path %ls", sczSubKey);
+        }
+    }
+    else if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_REMOVE, reinterpret_cast<WPARAM>(pMessage), 0))
     {
         MonExitWithLastError(hr, "Failed to send message to worker thread to add directory wait for path %ls", sczSubKey);
     }
@@ -552,6 +893,13 @@ extern "C" void DAPI MonDestroy(
     DWORD er = ERROR_SUCCESS;
     MON_STRUCT *pm = static_cast<MON_STRUCT *>(handle);
 
+    if (pm->pPort)
+    {
+        PortDestroy(pm->pPort);
+        ReleaseMem(pm);
+        ExitFunction();
+    }
+
     if (!::PostThreadMessageW(pm->dwCoordinatorThreadId, MON_MESSAGE_STOP, 0, 0))
     {
         er = ::GetLastError();
@@ -2004,3 +2352,1043 @@ static HRESULT UpdateWaitStatus(
 LExit:
     return hr;
 }
+
+static void PortDestroy(
+    __in MON_PORT_STRUCT *pPort
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (pPort->cThreads)
+    {
+        // Whichever worker gets this removes all watches, and each worker passes it on to the next one as it exits.
+        if (!::PostQueuedCompletionStatus(pPort->hPort, 0, MON_PORT_KEY_STOP, NULL))
+        {
+            // Remove the watches from here instead. The workers still complete the cancelled waits
+            // and exit on their own once the last watch is freed, so the rest can be cleaned up.
+            hr = HRESULT_FROM_WIN32(::GetLastError());
+            TraceError(hr, "Failed to send message to completion port worker threads to halt, stopping them directly");
+
+            PortProcessStop(pPort);
+        }
+
+        for (DWORD i = 0; i < pPort->cThreads; ++i)
+        {
+            ::WaitForSingleObject(pPort->rgThreads[i], INFINITE);
+            ::CloseHandle(pPort->rgThreads[i]);
+        }
+    }
+
+    ReleaseMem(pPort->rgThreads);
+    ReleaseMem(pPort->rgpWatches);
+    ReleaseMem(pPort->rgpPendingFires);
+    ReleaseHandle(pPort->hPort);
+
+    ::DeleteCriticalSection(&pPort->cs);
+    MemFree(pPort);
+}
+
+static HRESULT PortAddWatch(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_TYPE type,
+    __in_opt HKEY hkRoot,
+    __in_z LPCWSTR wzPath,
+    __in REG_KEY_BITNESS kbKeyBitness,
+    __in BOOL fRecursive,
+    __in DWORD dwSilencePeriodInMs,
+    __in_opt LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    MON_PORT_WATCH *pWatch = NULL;
+
+    pWatch = reinterpret_cast<MON_PORT_WATCH *>(MemAlloc(sizeof(MON_PORT_WATCH), TRUE));
+    MonExitOnNull(pWatch, hr, E_OUTOFMEMORY, "Failed to allocate memory for watch");
+
+    // The reference the worker takes over when it adds the watch to its list.
+    pWatch->cReferences = 1;
+    pWatch->pPort = pPort;
+    ::InterlockedIncrement(&pPort->cAllocatedWatches);
+
+    pWatch->type = type;
+    pWatch->fRecursive = fRecursive;
+    pWatch->dwMaxSilencePeriodInMs = dwSilencePeriodInMs;
+    pWatch->pvContext = pvContext;
+
+    if (MON_DIRECTORY == type)
+    {
+        pWatch->directory.hDirectory = INVALID_HANDLE_VALUE;
+    }
+    else
+    {
+        pWatch->regkey.hkRoot = hkRoot;
+        pWatch->regkey.kbKeyBitness = kbKeyBitness;
+    }
+
+    hr = StrAllocString(&pWatch->sczOriginalPathRequest, wzPath, 0);
+    MonExitOnFailure(hr, "Failed to copy path: %ls", wzPath);
+
+    hr = PathBackslashTerminate(&pWatch->sczOriginalPathRequest);
+    MonExitOnFailure(hr, "Failed to ensure path ends in backslash");
+
+    hr = PathGetHierarchyArray(pWatch->sczOriginalPathRequest, &pWatch->rgsczPathHierarchy, reinterpret_cast<LPUINT>(&pWatch->cPathHierarchy));
+    MonExitOnFailure(hr, "Failed to get hierarchy array for path %ls", pWatch->sczOriginalPathRequest);
+
+    if (0 < pWatch->cPathHierarchy)
+    {
+        if (!::PostQueuedCompletionStatus(pPort->hPort, 0, MON_PORT_KEY_ADD, reinterpret_cast<LPOVERLAPPED>(pWatch)))
+        {
+            MonExitWithLastError(hr, "Failed to send message to completion port to add wait for path %ls", pWatch->sczOriginalPathRequest);
+        }
+        pWatch = NULL;
+    }
+
+LExit:
+    if (pWatch)
+    {
+        PortWatchRelease(pWatch);
+    }
+
+    return hr;
+}
+
+static void PortWatchRelease(
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    MON_PORT_STRUCT *pPort = pWatch->pPort;
+
+    if (0 == ::InterlockedDecrement(&pWatch->cReferences))
+    {
+        PortReleaseChanges(pWatch->rgChanges, pWatch->cChanges);
+        ReleaseStr(pWatch->sczOriginalPathRequest);
+        ReleaseStrArray(pWatch->rgsczPathHierarchy, pWatch->cPathHierarchy);
+
+        if (MON_DIRECTORY == pWatch->type)
+        {
+            ReleaseFileHandle(pWatch->directory.hDirectory);
+        }
+        else
+        {
+            ReleaseRegKey(pWatch->regkey.hkSubKey);
+        }
+
+        MemFree(pWatch);
+
+        // Once the last watch is gone the workers can exit.
+        if (0 == ::InterlockedDecrement(&pPort->cAllocatedWatches) && pPort->fStopping)
+        {
+            ::PostQueuedCompletionStatus(pPort->hPort, 0, MON_PORT_KEY_STOP, NULL);
+        }
+    }
+}
+
+static DWORD WINAPI PortWorkerThread(
+    __in_bcount(sizeof(MON_PORT_STRUCT)) LPVOID pvContext
+    )
+{
+    HRESULT hr = S_OK;
+    MON_PORT_STRUCT *pPort = reinterpret_cast<MON_PORT_STRUCT *>(pvContext);
+    MON_PORT_NOTIFICATIONS notifications = { };
+    DWORD er = ERROR_SUCCESS;
+    DWORD dwTimeout = INFINITE;
+    DWORD cbTransferred = 0;
+    ULONG_PTR ulKey = 0;
+    LPOVERLAPPED pOverlapped = NULL;
+    BOOL fContinue = TRUE;
+
+    while (fContinue)
+    {
+        dwTimeout = PortGetTimeout(pPort);
+
+        pOverlapped = NULL;
+        er = ::GetQueuedCompletionStatus(pPort->hPort, &cbTransferred, &ulKey, &pOverlapped, dwTimeout) ? ERROR_SUCCESS : ::GetLastError();
+        if (NULL == pOverlapped && ERROR_SUCCESS != er)
+        {
+            if (WAIT_TIMEOUT != er)
+            {
+                MonExitOnWin32Error(er, hr, "Failed to get completion packet.");
+            }
+        }
+        else
+        {
+            switch (ulKey)
+            {
+            case MON_PORT_KEY_DIRECTORY: __fallthrough;
+            case MON_PORT_KEY_REGKEY:
+                hr = PortProcessWait(pPort, CONTAINING_RECORD(pOverlapped, MON_PORT_WAIT, overlapped), er, cbTransferred, &notifications);
+                MonExitOnFailure(hr, "Failed to process completed wait.");
+                break;
+            case MON_PORT_KEY_ADD:
+                hr = PortProcessAdd(pPort, reinterpret_cast<MON_PORT_WATCH *>(pOverlapped));
+                MonExitOnFailure(hr, "Failed to add watch.");
+                break;
+            case MON_PORT_KEY_REMOVE:
+                PortProcessRemove(pPort, reinterpret_cast<MON_REMOVE_MESSAGE *>(pOverlapped));
+                break;
+            case MON_PORT_KEY_STOP:
+                fContinue = !PortProcessStop(pPort);
+                break;
+            default:
+                Assert(false);
+            }
+        }
+
+        hr = PortProcessTimers(pPort, &notifications);
+        MonExitOnFailure(hr, "Failed to process silence periods and retries.");
+
+        PortFireNotifications(pPort, &notifications);
+
+        if (pPort->fStopping && 0 == ::InterlockedCompareExchange(&pPort->cAllocatedWatches, 0, 0))
+        {
+            fContinue = FALSE;
+        }
+    }
+
+LExit:
+    PortFireNotifications(pPort, &notifications);
+    ReleaseMem(notifications.rgNotifications);
+
+    if (FAILED(hr))
+    {
+        pPort->vpfMonGeneral(hr, pPort->pvContext);
+    }
+
+    return hr;
+}
+
+static HRESULT PortProcessAdd(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    HRESULT hr = S_OK;
+
+    ::EnterCriticalSection(&pPort->cs);
+
+    if (pPort->fStopping)
+    {
+        ExitFunction();
+    }
+
+    hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pPort->rgpWatches), pPort->cWatches, 1, sizeof(MON_PORT_WATCH *), MON_ARRAY_GROWTH);
+    MonExitOnFailure(hr, "Failed to allocate space in watch array.");
+
+    pPort->rgpWatches[pPort->cWatches] = pWatch;
+    ++pPort->cWatches;
+
+    // Like MonAddDirectory() and MonAddRegKey(), a failure to start waiting is only reported when the wait recovers.
+    pWatch->hrStatus = PortInitiateWait(pPort, pWatch);
+    if (FAILED(pWatch->hrStatus))
+    {
+        if (0 == pPort->cWatchesFailing)
+        {
+            pPort->dwLastRetryTime = ::GetTickCount();
+        }
+        ++pPort->cWatchesFailing;
+    }
+
+    pWatch = NULL;
+
+LExit:
+    if (pWatch)
+    {
+        PortWatchRelease(pWatch);
+    }
+    ::LeaveCriticalSection(&pPort->cs);
+
+    return hr;
+}
+
+static void PortProcessRemove(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_REMOVE_MESSAGE *pMessage
+    )
+{
+    MON_PORT_WATCH *pWatch = NULL;
+
+    ::EnterCriticalSection(&pPort->cs);
+
+    for (DWORD i = 0; i < pPort->cWatches; ++i)
+    {
+        pWatch = pPort->rgpWatches[i];
+        if (pWatch->type != pMessage->type || pWatch->fRecursive != pMessage->fRecursive)
+        {
+            continue;
+        }
+
+        if ((MON_DIRECTORY == pWatch->type && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pWatch->rgsczPathHierarchy[pWatch->cPathHierarchy - 1], -1, pMessage->directory.sczDirectory, -1)) ||
+            (MON_REGKEY == pWatch->type && pWatch->regkey.hkRoot == pMessage->regkey.hkRoot && pWatch->regkey.kbKeyBitness == pMessage->regkey.kbKeyBitness && CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, 0, pWatch->rgsczPathHierarchy[pWatch->cPathHierarchy - 1], -1, pMessage->regkey.sczSubKey, -1)))
+        {
+            PortRemoveWatch(pPort, i);
+            break;
+        }
+    }
+
+    ::LeaveCriticalSection(&pPort->cs);
+
+    MonRemoveMessageDestroy(pMessage);
+}
+
+static BOOL PortProcessStop(
+    __in MON_PORT_STRUCT *pPort
+    )
+{
+    BOOL fExit = FALSE;
+
+    ::EnterCriticalSection(&pPort->cs);
+
+    if (!pPort->fStopping)
+    {
+        pPort->fStopping = TRUE;
+
+        while (pPort->cWatches)
+        {
+            PortRemoveWatch(pPort, pPort->cWatches - 1);
+        }
+    }
+
+    ::LeaveCriticalSection(&pPort->cs);
+
+    // Cancelled waits still have to complete before their watches can be freed. The last one to be freed posts this again.
+    if (0 == ::InterlockedCompareExchange(&pPort->cAllocatedWatches, 0, 0))
+    {
+        ::PostQueuedCompletionStatus(pPort->hPort, 0, MON_PORT_KEY_STOP, NULL);
+        fExit = TRUE;
+    }
+
+    return fExit;
+}
+
+static HRESULT PortProcessWait(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WAIT *pWait,
+    __in DWORD er,
+    __in DWORD cbTransferred,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrWait = S_OK;
+    MON_PORT_WATCH *pWatch = pWait->pWatch;
+    BOOL fTarget = FALSE;
+    BOOL fContinued = FALSE;
+
+    ::EnterCriticalSection(&pPort->cs);
+
+    // Waits cancelled since, including all waits of removed watches, only need to be cleaned up.
+    if (pWatch->pWait != pWait)
+    {
+        ExitFunction();
+    }
+
+    fTarget = pWatch->cPathHierarchy - 1 == pWatch->dwPathHierarchyIndex;
+
+    if (MON_DIRECTORY == pWatch->type && fTarget)
+    {
+        if (ERROR_SUCCESS == er && 0 < cbTransferred)
+        {
+            hr = PortCollectChanges(pWatch, pWait->pbBuffer, cbTransferred);
+            if (FAILED(hr))
+            {
+                TraceError(hr, "Failed to collect changes to directory %ls, reporting them as unknown", pWatch->sczOriginalPathRequest);
+                PortDiscardChanges(pWatch);
+                hr = S_OK;
+            }
+        }
+        else
+        {
+            // The buffer overflowed or the wait broke, so the individual changes are lost.
+            PortDiscardChanges(pWatch);
+        }
+
+        // Keep reading from the same handle while it's good, so nothing is missed between reads.
+        if (ERROR_SUCCESS == er)
+        {
+            hrWait = PortReadDirectoryChanges(pWatch, pWait);
+            fContinued = SUCCEEDED(hrWait);
+        }
+    }
+
+    if (!fContinued)
+    {
+        // This wait is done, so detach it before looking for the next thing to wait on.
+        pWatch->pWait = NULL;
+        hrWait = PortInitiateWait(pPort, pWatch);
+    }
+
+    hr = PortUpdateStatus(pPort, pWatch, hrWait, pNotifications);
+    MonExitOnFailure(hr, "Failed to update status of wait for path %ls", pWatch->sczOriginalPathRequest);
+
+    // Only notify if we were waiting on the target itself, or are able to now.
+    if (SUCCEEDED(hrWait) && (fTarget || pWatch->cPathHierarchy - 1 == pWatch->dwPathHierarchyIndex))
+    {
+        if (!fTarget)
+        {
+            PortDiscardChanges(pWatch);
+        }
+
+        hr = PortQueueFire(pPort, pWatch, pNotifications);
+        MonExitOnFailure(hr, "Failed to queue notification for path %ls", pWatch->sczOriginalPathRequest);
+    }
+
+LExit:
+    if (pWatch->pWait != pWait)
+    {
+        PortWaitDestroy(pWait);
+    }
+    ::LeaveCriticalSection(&pPort->cs);
+
+    return hr;
+}
+
+static HRESULT PortProcessTimers(
+    __in MON_PORT_STRUCT *pPort,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrWait = S_OK;
+    DWORD dwNow = 0;
+    DWORD i = 0;
+    MON_PORT_WATCH *pWatch = NULL;
+
+    ::EnterCriticalSection(&pPort->cs);
+
+    if (pPort->fStopping)
+    {
+        ExitFunction();
+    }
+
+    dwNow = ::GetTickCount();
+
+    while (i < pPort->cPendingFires)
+    {
+        pWatch = pPort->rgpPendingFires[i];
+        if (dwNow - pWatch->dwLastChangeTime < pWatch->dwMaxSilencePeriodInMs)
+        {
+            ++i;
+            continue;
+        }
+
+        // Removes the watch from the pending fires, so don't move on to the next index.
+        hr = PortQueueNotification(pPort, pWatch, S_OK, pNotifications);
+        MonExitOnFailure(hr, "Failed to queue notification for path %ls", pWatch->sczOriginalPathRequest);
+    }
+
+    if (pPort->cWatchesFailing && MON_PORT_FAILED_RETRY_IN_MS <= dwNow - pPort->dwLastRetryTime)
+    {
+        pPort->dwLastRetryTime = dwNow;
+
+        for (i = 0; i < pPort->cWatches; ++i)
+        {
+            pWatch = pPort->rgpWatches[i];
+            if (FAILED(pWatch->hrStatus))
+            {
+                hrWait = PortInitiateWait(pPort, pWatch);
+
+                hr = PortUpdateStatus(pPort, pWatch, hrWait, pNotifications);
+                MonExitOnFailure(hr, "Failed to update status of wait for path %ls", pWatch->sczOriginalPathRequest);
+            }
+        }
+    }
+
+LExit:
+    ::LeaveCriticalSection(&pPort->cs);
+
+    return hr;
+}
+
+static DWORD PortGetTimeout(
+    __in MON_PORT_STRUCT *pPort
+    )
+{
+    DWORD dwTimeout = INFINITE;
+    DWORD dwNow = 0;
+    DWORD dwElapsed = 0;
+    MON_PORT_WATCH *pWatch = NULL;
+
+    ::EnterCriticalSection(&pPort->cs);
+
+    dwNow = ::GetTickCount();
+
+    for (DWORD i = 0; i < pPort->cPendingFires; ++i)
+    {
+        pWatch = pPort->rgpPendingFires[i];
+        dwElapsed = dwNow - pWatch->dwLastChangeTime;
+        dwTimeout = min(dwTimeout, dwElapsed < pWatch->dwMaxSilencePeriodInMs ? pWatch->dwMaxSilencePeriodInMs - dwElapsed : 0);
+    }
+
+    if (pPort->cWatchesFailing)
+    {
+        dwElapsed = dwNow - pPort->dwLastRetryTime;
+        dwTimeout = min(dwTimeout, dwElapsed < MON_PORT_FAILED_RETRY_IN_MS ? MON_PORT_FAILED_RETRY_IN_MS - dwElapsed : 0);
+    }
+
+    if (pPort->fStopping)
+    {
+        dwTimeout = min(dwTimeout, MON_PORT_STOP_POLL_IN_MS);
+    }
+
+    ::LeaveCriticalSection(&pPort->cs);
+
+    return dwTimeout;
+}
+
+static HRESULT PortInitiateWait(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    HRESULT hr = S_OK;
+    HRESULT hrTemp = S_OK;
+    BOOL fRedo = FALSE;
+    BOOL fWaiting = FALSE;
+    DWORD dwIndex = 0;
+    HANDLE hDirectory = INVALID_HANDLE_VALUE;
+    HKEY hk = NULL;
+
+    do
+    {
+        fRedo = FALSE;
+        fWaiting = FALSE;
+
+        for (DWORD i = 0; i < pWatch->cPathHierarchy && !fWaiting; ++i)
+        {
+            dwIndex = pWatch->cPathHierarchy - i - 1;
+
+            PortCancelWait(pWatch);
+            pWatch->dwPathHierarchyIndex = dwIndex;
+
+            hr = MON_DIRECTORY == pWatch->type ? PortWaitOnDirectory(pPort, pWatch) : PortWaitOnRegKey(pWatch);
+            if (E_FILENOTFOUND == hr || E_PATHNOTFOUND == hr || E_ACCESSDENIED == hr || HRESULT_FROM_WIN32(ERROR_KEY_DELETED) == hr)
+            {
+                continue;
+            }
+            MonExitOnFailure(hr, "Failed to wait on path %ls", pWatch->rgsczPathHierarchy[dwIndex]);
+
+            fWaiting = TRUE;
+        }
+
+        // If we're waiting on a parent because the real path didn't exist, double-check the child hasn't been created since.
+        // If it has, start over.
+        if (fWaiting && dwIndex < pWatch->cPathHierarchy - 1)
+        {
+            if (MON_DIRECTORY == pWatch->type)
+            {
+                hrTemp = PortOpenDirectory(pWatch->rgsczPathHierarchy[dwIndex + 1], &hDirectory);
+                ReleaseFileHandle(hDirectory);
+            }
+            else
+            {
+                hrTemp = RegOpen(pWatch->regkey.hkRoot, pWatch->rgsczPathHierarchy[dwIndex + 1], KEY_NOTIFY | RegTranslateKeyBitness(pWatch->regkey.kbKeyBitness), &hk);
+                ReleaseRegKey(hk);
+            }
+
+            fRedo = SUCCEEDED(hrTemp);
+        }
+    } while (fRedo);
+
+    MonExitOnFailure(hr, "Didn't get a successful wait after looping through all available options %ls", pWatch->rgsczPathHierarchy[pWatch->cPathHierarchy - 1]);
+
+LExit:
+    if (FAILED(hr))
+    {
+        PortCancelWait(pWatch);
+    }
+
+    return hr;
+}
+
+static HRESULT PortWaitOnDirectory(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    HRESULT hr = S_OK;
+    HANDLE hDirectory = INVALID_HANDLE_VALUE;
+    MON_PORT_WAIT *pWait = NULL;
+
+    hr = PortOpenDirectory(pWatch->rgsczPathHierarchy[pWatch->dwPathHierarchyIndex], &hDirectory);
+    if (FAILED(hr))
+    {
+        ExitFunction();
+    }
+
+    if (!::CreateIoCompletionPort(hDirectory, pPort->hPort, MON_PORT_KEY_DIRECTORY, 0))
+    {
+        MonExitWithLastError(hr, "Failed to associate directory with completion port: %ls", pWatch->rgsczPathHierarchy[pWatch->dwPathHierarchyIndex]);
+    }
+
+    hr = PortWaitCreate(pWatch, MON_PORT_BUFFER_BYTES, &pWait);
+    MonExitOnFailure(hr, "Failed to create wait for directory: %ls", pWatch->rgsczPathHierarchy[pWatch->dwPathHierarchyIndex]);
+
+    pWatch->directory.hDirectory = hDirectory;
+    hDirectory = INVALID_HANDLE_VALUE;
+
+    hr = PortReadDirectoryChanges(pWatch, pWait);
+    if (FAILED(hr))
+    {
+        ReleaseFileHandle(pWatch->directory.hDirectory);
+        ExitFunction();
+    }
+
+    pWatch->pWait = pWait;
+    pWait = NULL;
+
+LExit:
+    ReleaseFileHandle(hDirectory);
+    if (pWait)
+    {
+        PortWaitDestroy(pWait);
+    }
+
+    return hr;
+}
+
+static HRESULT PortWaitOnRegKey(
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    HRESULT hr = S_OK;
+    DWORD er = ERROR_SUCCESS;
+    DWORD dwIndex = pWatch->dwPathHierarchyIndex;
+    MON_PORT_WAIT *pWait = NULL;
+
+    hr = RegOpen(pWatch->regkey.hkRoot, pWatch->rgsczPathHierarchy[dwIndex], KEY_NOTIFY | RegTranslateKeyBitness(pWatch->regkey.kbKeyBitness), &pWatch->regkey.hkSubKey);
+    if (FAILED(hr))
+    {
+        ExitFunction();
+    }
+
+    hr = PortWaitCreate(pWatch, 0, &pWait);
+    MonExitOnFailure(hr, "Failed to create wait for subkey %ls", pWatch->rgsczPathHierarchy[dwIndex]);
+
+    pWait->hEvent = ::CreateEventW(NULL, TRUE, FALSE, NULL);
+    MonExitOnNullWithLastError(pWait->hEvent, hr, "Failed to create anonymous event for regkey monitor");
+
+    er = ::RegNotifyChangeKeyValue(pWatch->regkey.hkSubKey, pWatch->cPathHierarchy - 1 == dwIndex && pWatch->fRecursive, REG_NOTIFY_CHANGE_NAME | REG_NOTIFY_CHANGE_LAST_SET | REG_NOTIFY_CHANGE_SECURITY, pWait->hEvent, TRUE);
+    hr = HRESULT_FROM_WIN32(er);
+    if (FAILED(hr))
+    {
+        ExitFunction();
+    }
+
+    if (!::RegisterWaitForSingleObject(&pWait->hRegisteredWait, pWait->hEvent, PortRegKeyWaitCallback, pWait, INFINITE, WT_EXECUTEONLYONCE))
+    {
+        MonExitWithLastError(hr, "Failed to register wait for subkey %ls", pWatch->rgsczPathHierarchy[dwIndex]);
+    }
+
+    pWatch->pWait = pWait;
+    pWait = NULL;
+
+LExit:
+    if (pWait)
+    {
+        PortWaitDestroy(pWait);
+    }
+
+    if (FAILED(hr))
+    {
+        ReleaseRegKey(pWatch->regkey.hkSubKey);
+    }
+
+    return hr;
+}
+
+static HRESULT PortReadDirectoryChanges(
+    __in MON_PORT_WATCH *pWatch,
+    __in MON_PORT_WAIT *pWait
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fRecursive = pWatch->cPathHierarchy - 1 == pWatch->dwPathHierarchyIndex && pWatch->fRecursive;
+
+    ::ZeroMemory(&pWait->overlapped, sizeof(pWait->overlapped));
+
+    if (!::ReadDirectoryChangesW(pWatch->directory.hDirectory, pWait->pbBuffer, MON_PORT_BUFFER_BYTES, fRecursive, MON_PORT_NOTIFY_FILTER, NULL, &pWait->overlapped, NULL))
+    {
+        MonExitWithLastError(hr, "Failed to read changes to directory %ls", pWatch->rgsczPathHierarchy[pWatch->dwPathHierarchyIndex]);
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT PortOpenDirectory(
+    __in_z LPCWSTR wzPath,
+    __out HANDLE *phDirectory
+    )
+{
+    HRESULT hr = S_OK;
+
+    *phDirectory = ::CreateFileW(wzPath, FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (INVALID_HANDLE_VALUE == *phDirectory)
+    {
+        hr = HRESULT_FROM_WIN32(::GetLastError());
+    }
+
+    return hr;
+}
+
+static void CALLBACK PortRegKeyWaitCallback(
+    __in PVOID pvContext,
+    __in BOOLEAN /*fTimedOut*/
+    )
+{
+    HRESULT hr = S_OK;
+    MON_PORT_WAIT *pWait = reinterpret_cast<MON_PORT_WAIT *>(pvContext);
+
+    ::InterlockedExchange(&pWait->fSignaled, TRUE);
+
+    if (!::PostQueuedCompletionStatus(pWait->pWatch->pPort->hPort, 0, MON_PORT_KEY_REGKEY, &pWait->overlapped))
+    {
+        MonExitWithLastError(hr, "Failed to send regkey notification to completion port for subkey %ls", pWait->pWatch->rgsczPathHierarchy[pWait->pWatch->cPathHierarchy - 1]);
+    }
+
+LExit:
+    return;
+}
+
+static void PortCancelWait(
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    MON_PORT_WAIT *pWait = pWatch->pWait;
+
+    pWatch->pWait = NULL;
+
+    if (MON_DIRECTORY == pWatch->type)
+    {
+        // Closing the handle aborts any outstanding read, and its completion destroys the wait.
+        ReleaseFileHandle(pWatch->directory.hDirectory);
+    }
+    else
+    {
+        if (pWait)
+        {
+            ::UnregisterWaitEx(pWait->hRegisteredWait, INVALID_HANDLE_VALUE);
+            pWait->hRegisteredWait = NULL;
+
+            // If the notification already fired, its completion packet destroys the wait.
+            if (!::InterlockedCompareExchange(&pWait->fSignaled, TRUE, FALSE))
+            {
+                PortWaitDestroy(pWait);
+            }
+        }
+
+        ReleaseRegKey(pWatch->regkey.hkSubKey);
+    }
+}
+
+static HRESULT PortWaitCreate(
+    __in MON_PORT_WATCH *pWatch,
+    __in DWORD cbBuffer,
+    __out MON_PORT_WAIT **ppWait
+    )
+{
+    HRESULT hr = S_OK;
+    MON_PORT_WAIT *pWait = NULL;
+
+    pWait = reinterpret_cast<MON_PORT_WAIT *>(MemAlloc(sizeof(MON_PORT_WAIT) + cbBuffer, TRUE));
+    MonExitOnNull(pWait, hr, E_OUTOFMEMORY, "Failed to allocate memory for wait");
+
+    ::InterlockedIncrement(&pWatch->cReferences);
+    pWait->pWatch = pWatch;
+
+    if (cbBuffer)
+    {
+        // ReadDirectoryChangesW() needs a DWORD aligned buffer, which the end of the struct always is.
+        pWait->pbBuffer = reinterpret_cast<BYTE *>(pWait + 1);
+    }
+
+    *ppWait = pWait;
+
+LExit:
+    return hr;
+}
+
+static void PortWaitDestroy(
+    __in MON_PORT_WAIT *pWait
+    )
+{
+    if (pWait->hRegisteredWait)
+    {
+        ::UnregisterWaitEx(pWait->hRegisteredWait, INVALID_HANDLE_VALUE);
+    }
+
+    ReleaseHandle(pWait->hEvent);
+    PortWatchRelease(pWait->pWatch);
+    MemFree(pWait);
+}
+
+static HRESULT PortCollectChanges(
+    __in MON_PORT_WATCH *pWatch,
+    __in_bcount(cbBuffer) const BYTE *pbBuffer,
+    __in DWORD cbBuffer
+    )
+{
+    HRESULT hr = S_OK;
+    const FILE_NOTIFY_INFORMATION *pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(pbBuffer);
+    LPWSTR sczPath = NULL;
+
+    // Already going to report the changes as unknown.
+    if (pWatch->fChangesUnknown)
+    {
+        ExitFunction();
+    }
+
+    for (;;)
+    {
+        if (MON_PORT_MAX_CHANGES <= pWatch->cChanges || reinterpret_cast<const BYTE *>(pInfo->FileName) + pInfo->FileNameLength > pbBuffer + cbBuffer)
+        {
+            PortDiscardChanges(pWatch);
+            break;
+        }
+
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pWatch->rgChanges), pWatch->cChanges, 1, sizeof(MON_FILE_CHANGE), MON_ARRAY_GROWTH);
+        MonExitOnFailure(hr, "Failed to allocate space in change array.");
+
+        hr = StrAllocString(&sczPath, pInfo->FileName, pInfo->FileNameLength / sizeof(WCHAR));
+        MonExitOnFailure(hr, "Failed to copy changed path.");
+
+        pWatch->rgChanges[pWatch->cChanges].dwAction = pInfo->Action;
+        pWatch->rgChanges[pWatch->cChanges].wzPath = sczPath;
+        sczPath = NULL;
+        ++pWatch->cChanges;
+
+        if (0 == pInfo->NextEntryOffset)
+        {
+            break;
+        }
+
+        pInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(reinterpret_cast<const BYTE *>(pInfo) + pInfo->NextEntryOffset);
+    }
+
+LExit:
+    ReleaseStr(sczPath);
+
+    return hr;
+}
+
+static void PortDiscardChanges(
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    PortReleaseChanges(pWatch->rgChanges, pWatch->cChanges);
+    pWatch->rgChanges = NULL;
+    pWatch->cChanges = 0;
+    pWatch->fChangesUnknown = TRUE;
+}
+
+static HRESULT PortUpdateStatus(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch,
+    __in HRESULT hrNewStatus,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    )
+{
+    HRESULT hr = S_OK;
+    BOOL fFailedBefore = FAILED(pWatch->hrStatus);
+
+    pWatch->hrStatus = hrNewStatus;
+
+    // Like UpdateWaitStatus(), notify whenever a wait starts failing or recovers, since changes may have been missed in between.
+    if (fFailedBefore != FAILED(hrNewStatus))
+    {
+        if (fFailedBefore)
+        {
+            --pPort->cWatchesFailing;
+        }
+        else
+        {
+            if (0 == pPort->cWatchesFailing)
+            {
+                pPort->dwLastRetryTime = ::GetTickCount();
+            }
+            ++pPort->cWatchesFailing;
+        }
+
+        PortDiscardChanges(pWatch);
+
+        hr = PortQueueNotification(pPort, pWatch, hrNewStatus, pNotifications);
+        MonExitOnFailure(hr, "Failed to queue status change notification for path %ls", pWatch->sczOriginalPathRequest);
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT PortQueueFire(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    )
+{
+    HRESULT hr = S_OK;
+
+    if (0 == pWatch->dwMaxSilencePeriodInMs)
+    {
+        hr = PortQueueNotification(pPort, pWatch, S_OK, pNotifications);
+        MonExitOnFailure(hr, "Failed to queue notification for path %ls", pWatch->sczOriginalPathRequest);
+
+        ExitFunction();
+    }
+
+    // Every change restarts the silence period.
+    pWatch->dwLastChangeTime = ::GetTickCount();
+
+    if (!pWatch->fPendingFire)
+    {
+        hr = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pPort->rgpPendingFires), pPort->cPendingFires, 1, sizeof(MON_PORT_WATCH *), MON_ARRAY_GROWTH);
+        MonExitOnFailure(hr, "Failed to allocate space in pending fire array.");
+
+        pPort->rgpPendingFires[pPort->cPendingFires] = pWatch;
+        ++pPort->cPendingFires;
+        pWatch->fPendingFire = TRUE;
+    }
+
+LExit:
+    return hr;
+}
+
+static HRESULT PortQueueNotification(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch,
+    __in HRESULT hr,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    )
+{
+    HRESULT hrQueue = S_OK;
+    MON_PORT_NOTIFICATION *pNotification = NULL;
+
+    hrQueue = MemEnsureArraySizeForNewItems(reinterpret_cast<void **>(&pNotifications->rgNotifications), pNotifications->cNotifications, 1, sizeof(MON_PORT_NOTIFICATION), MON_ARRAY_GROWTH);
+    MonExitOnFailure(hrQueue, "Failed to allocate space in notification array.");
+
+    pNotification = pNotifications->rgNotifications + pNotifications->cNotifications;
+    ++pNotifications->cNotifications;
+
+    ::InterlockedIncrement(&pWatch->cReferences);
+    pNotification->pWatch = pWatch;
+    pNotification->hr = hr;
+
+    // The notification takes over the changes collected so far.
+    pNotification->rgChanges = pWatch->rgChanges;
+    pNotification->cChanges = pWatch->cChanges;
+    pWatch->rgChanges = NULL;
+    pWatch->cChanges = 0;
+    pWatch->fChangesUnknown = FALSE;
+
+    if (pWatch->fPendingFire)
+    {
+        PortRemovePendingFire(pPort, pWatch);
+    }
+
+LExit:
+    return hrQueue;
+}
+
+static void PortFireNotifications(
+    __in MON_PORT_STRUCT *pPort,
+    __inout MON_PORT_NOTIFICATIONS *pNotifications
+    )
+{
+    MON_PORT_NOTIFICATION *pNotification = NULL;
+    MON_PORT_WATCH *pWatch = NULL;
+
+    for (DWORD i = 0; i < pNotifications->cNotifications; ++i)
+    {
+        pNotification = pNotifications->rgNotifications + i;
+        pWatch = pNotification->pWatch;
+
+        // Don't bother firing notifications once we've been told to stop monitoring.
+        if (!pPort->fStopping)
+        {
+            switch (pWatch->type)
+            {
+            case MON_DIRECTORY:
+                if (pPort->vpfMonDirectoryChanges)
+                {
+                    pPort->vpfMonDirectoryChanges(pNotification->hr, pWatch->sczOriginalPathRequest, pWatch->fRecursive, pNotification->rgChanges, pNotification->cChanges, pPort->pvContext, pWatch->pvContext);
+                }
+                else if (pPort->vpfMonDirectory)
+                {
+                    pPort->vpfMonDirectory(pNotification->hr, pWatch->sczOriginalPathRequest, pWatch->fRecursive, pPort->pvContext, pWatch->pvContext);
+                }
+                break;
+            case MON_REGKEY:
+                if (pPort->vpfMonRegKey)
+                {
+                    pPort->vpfMonRegKey(pNotification->hr, pWatch->regkey.hkRoot, pWatch->rgsczPathHierarchy[pWatch->cPathHierarchy - 1], pWatch->regkey.kbKeyBitness, pWatch->fRecursive, pPort->pvContext, pWatch->pvContext);
+                }
+                break;
+            default:
+                Assert(false);
+            }
+        }
+
+        PortReleaseChanges(pNotification->rgChanges, pNotification->cChanges);
+        PortWatchRelease(pWatch);
+    }
+
+    pNotifications->cNotifications = 0;
+}
+
+static void PortRemoveWatch(
+    __in MON_PORT_STRUCT *pPort,
+    __in DWORD dwIndex
+    )
+{
+    MON_PORT_WATCH *pWatch = pPort->rgpWatches[dwIndex];
+
+    PortCancelWait(pWatch);
+
+    if (pWatch->fPendingFire)
+    {
+        PortRemovePendingFire(pPort, pWatch);
+    }
+
+    if (FAILED(pWatch->hrStatus))
+    {
+        --pPort->cWatchesFailing;
+    }
+
+    MemRemoveFromArray(reinterpret_cast<void *>(pPort->rgpWatches), dwIndex, 1, pPort->cWatches, sizeof(MON_PORT_WATCH *), FALSE);
+    --pPort->cWatches;
+
+    PortWatchRelease(pWatch);
+}
+
+static void PortRemovePendingFire(
+    __in MON_PORT_STRUCT *pPort,
+    __in MON_PORT_WATCH *pWatch
+    )
+{
+    for (DWORD i = 0; i < pPort->cPendingFires; ++i)
+    {
+        if (pPort->rgpPendingFires[i] == pWatch)
+        {
+            MemRemoveFromArray(reinterpret_cast<void *>(pPort->rgpPendingFires), i, 1, pPort->cPendingFires, sizeof(MON_PORT_WATCH *), FALSE);
+            --pPort->cPendingFires;
+            break;
+        }
+    }
+
+    pWatch->fPendingFire = FALSE;
+}
+
+static void PortReleaseChanges(
+    __in_ecount_opt(cChanges) MON_FILE_CHANGE *rgChanges,
+    __in DWORD cChanges
+    )
+{
+    if (rgChanges)
+    {
+        for (DWORD i = 0; i < cChanges; ++i)
+        {
+            ReleaseStr(const_cast<LPWSTR>(rgChanges[i].wzPath));
+        }
+
+        MemFree(rgChanges);
+    }
+}
@@ -19,6 +19,12 @@
 
 #define ARRAY_GROWTH_SIZE 5
 
+// SSE2 is part of the baseline for every x86 and x64 processor Windows runs on, so no runtime check is needed.
+#if (defined(_M_IX86) || defined(_M_X64)) && !defined(_M_ARM64EC)
+#include <emmintrin.h>
+#define STRUTIL_SSE2
+#endif
+
 // Forward declarations.
 static HRESULT AllocHelper(
     __deref_out_ecount_part(cch, 0) LPWSTR* ppwz,
@@ -49,6 +55,34 @@ static HRESULT StrAllocStringMapInvariant(
     __in SIZE_T cchSource,
     __in DWORD dwMapFlags
     );
+static SIZE_T HexEncodeBlocks(
+    __in_ecount(cbSource) const BYTE* pbSource,
+    __in SIZE_T cbSource,
+    __out_ecount(2 * cbSource) LPWSTR wzDest
+    );
+static SIZE_T HexDecodeBlocks(
+    __in_ecount(2 * cbDest) LPCWSTR wzSource,
+    __in SIZE_T cbDest,
+    __out_bcount(cbDest) BYTE* pbDest
+    );
+static SIZE_T AsciiPrefixLength(
+    __in_ecount(cch) LPCWSTR wz,
+    __in SIZE_T cch
+    );
+static SIZE_T AsciiPrefixLengthAnsi(
+    __in_ecount(cch) LPCSTR sz,
+    __in SIZE_T cch
+    );
+static void NarrowAscii(
+    __in_ecount(cch) LPCWSTR wzSource,
+    __in SIZE_T cch,
+    __out_ecount(cch) LPSTR szDest
+    );
+static void WidenAscii(
+    __in_ecount(cch) LPCSTR szSource,
+    __in SIZE_T cch,
+    __out_ecount(cch) LPWSTR wzDest
+    );
 
 /********************************************************************
 StrAlloc - allocates or reuses dynamic string memory
@@ -439,6 +473,8 @@ extern "C" HRESULT DAPI StrAnsiAllocString(
     LPSTR psz = NULL;
     SIZE_T cch = 0;
     SIZE_T cchDest = cchSource; // at least enough
+    SIZE_T cchAscii = 0;
+    BOOL fAscii = FALSE;
 
     if (*ppsz)
     {
@@ -446,7 +482,18 @@ extern "C" HRESULT DAPI StrAnsiAllocString(
         StrExitOnFailure(hr, "failed to get size of destination string");
     }
 
-    if (0 == cchSource)
+    // Plain ASCII is the same in UTF-8, so most strings can be copied without asking Windows for the size first.
+    if (CP_UTF8 == uiCodepage)
+    {
+        cchAscii = 0 == cchSource ? wcslen(wzSource) : L'\0' == wzSource[cchSource - 1] ? cchSource - 1 : cchSource;
+        fAscii = cchAscii == AsciiPrefixLength(wzSource, cchAscii);
+    }
+
+    if (fAscii)
+    {
+        cchDest = cchAscii;
+    }
+    else if (0 == cchSource)
     {
         cchDest = ::WideCharToMultiByte(uiCodepage, 0, wzSource, -1, NULL, 0, NULL, NULL);
         if (0 == cchDest)
@@ -483,7 +530,11 @@ extern "C" HRESULT DAPI StrAnsiAllocString(
         *ppsz = psz;
     }
 
-    if (0 == ::WideCharToMultiByte(uiCodepage, 0, wzSource, 0 == cchSource ? -1 : (int)cchSource, *ppsz, (int)cch, NULL, NULL))
+    if (fAscii)
+    {
+        NarrowAscii(wzSource, cchDest, *ppsz);
+    }
+    else if (0 == ::WideCharToMultiByte(uiCodepage, 0, wzSource, 0 == cchSource ? -1 : (int)cchSource, *ppsz, (int)cch, NULL, NULL))
     {
         StrExitWithLastError(hr, "failed to convert to ansi: %ls", wzSource);
     }
@@ -514,6 +565,8 @@ extern "C" HRESULT DAPI StrAllocStringAnsi(
     LPWSTR pwz = NULL;
     SIZE_T cch = 0;
     SIZE_T cchDest = cchSource;  // at least enough
+    SIZE_T cchAscii = 0;
+    BOOL fAscii = FALSE;
 
     if (*ppwz)
     {
@@ -521,7 +574,18 @@ extern "C" HRESULT DAPI StrAllocStringAnsi(
         StrExitOnFailure(hr, "failed to get size of destination string");
     }
 
-    if (0 == cchSource)
+    // Plain ASCII is the same in UTF-8, so most strings can be copied without asking Windows for the size first.
+    if (CP_UTF8 == uiCodepage)
+    {
+        cchAscii = 0 == cchSource ? strlen(szSource) : '\0' == szSource[cchSource - 1] ? cchSource - 1 : cchSource;
+        fAscii = cchAscii == AsciiPrefixLengthAnsi(szSource, cchAscii);
+    }
+
+    if (fAscii)
+    {
+        cchDest = cchAscii;
+    }
+    else if (0 == cchSource)
     {
         cchDest = ::MultiByteToWideChar(uiCodepage, 0, szSource, -1, NULL, 0);
         if (0 == cchDest)
@@ -559,7 +623,11 @@ extern "C" HRESULT DAPI StrAllocStringAnsi(
         *ppwz = pwz;
     }
 
-    if (0 == ::MultiByteToWideChar(uiCodepage, 0, szSource, 0 == cchSource ? -1 : (int)cchSource, *ppwz, (int)cch))
+    if (fAscii)
+    {
+        WidenAscii(szSource, cchDest, *ppwz);
+    }
+    else if (0 == ::MultiByteToWideChar(uiCodepage, 0, szSource, 0 == cchSource ? -1 : (int)cchSource, *ppwz, (int)cch))
     {
         StrExitWithLastError(hr, "failed to convert to unicode: %s", szSource);
     }
@@ -1453,7 +1521,7 @@ extern "C" HRESULT DAPI StrHexEncode(
     Assert(pbSource && wzDest);
 
     HRESULT hr = S_OK;
-    DWORD i;
+    SIZE_T i = 0;
     BYTE b;
 
     if (cchDest < 2 * cbSource + 1)
@@ -1461,7 +1529,11 @@ extern "C" HRESULT DAPI StrHexEncode(
         ExitFunction1(hr = HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER));
     }
 
-    for (i = 0; i < cbSource; ++i)
+    i = HexEncodeBlocks(pbSource, cbSource, wzDest);
+    pbSource += i;
+    wzDest += 2 * i;
+
+    for (; i < cbSource; ++i)
     {
         b = (*pbSource) >> 4;
         *(wzDest++) = (WCHAR)(L'0' + b + ((b < 10) ? 0 : L'A'-L'9'-1));
@@ -1530,7 +1602,11 @@ extern "C" HRESULT DAPI StrHexDecode(
         StrExitOnRootFailure(hr, "Insufficient buffer to decode string '%ls' len: %Iu into %Iu bytes.", wzSource, cchSource, cbDest);
     }
 
-    for (i = 0; i < cchSource / 2; ++i)
+    i = HexDecodeBlocks(wzSource, cchSource / 2, pbDest);
+    wzSource += 2 * i;
+    pbDest += i;
+
+    for (; i < cchSource / 2; ++i)
     {
         b = HexCharToByte(*wzSource++);
         (*pbDest) = b << 4;
@@ -2793,3 +2869,190 @@ extern "C" DAPI_(HRESULT) StrSecureZeroFreeString(
 
     return hr;
 }
+
+
+static SIZE_T HexEncodeBlocks(
+    __in_ecount(cbSource) const BYTE* pbSource,
+    __in SIZE_T cbSource,
+    __out_ecount(2 * cbSource) LPWSTR wzDest
+    )
+{
+    SIZE_T i = 0;
+
+#ifdef STRUTIL_SSE2
+    // Encode 16 bytes at a time: split into nibbles, interleave them high nibble first,
+    // turn each nibble into its character and widen to WCHARs.
+    const __m128i vLowNibble = _mm_set1_epi8(0x0F);
+    const __m128i vNine = _mm_set1_epi8(9);
+    const __m128i vZero = _mm_set1_epi8('0');
+    const __m128i vLetter = _mm_set1_epi8('A' - '9' - 1);
+    const __m128i vEmpty = _mm_setzero_si128();
+
+    for (; i + 16 <= cbSource; i += 16)
+    {
+        __m128i vBytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pbSource + i));
+        __m128i vHigh = _mm_and_si128(_mm_srli_epi16(vBytes, 4), vLowNibble);
+        __m128i vLow = _mm_and_si128(vBytes, vLowNibble);
+        __m128i rgvNibbles[2] = { _mm_unpacklo_epi8(vHigh, vLow), _mm_unpackhi_epi8(vHigh, vLow) };
+
+        for (DWORD j = 0; j < countof(rgvNibbles); ++j)
+        {
+            __m128i vChars = _mm_add_epi8(_mm_add_epi8(rgvNibbles[j], vZero), _mm_and_si128(_mm_cmpgt_epi8(rgvNibbles[j], vNine), vLetter));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest + 2 * i + 16 * j), _mm_unpacklo_epi8(vChars, vEmpty));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest + 2 * i + 16 * j + 8), _mm_unpackhi_epi8(vChars, vEmpty));
+        }
+    }
+#else
+    UNREFERENCED_PARAMETER(pbSource);
+    UNREFERENCED_PARAMETER(cbSource);
+    UNREFERENCED_PARAMETER(wzDest);
+#endif
+
+    return i;
+}
+
+static SIZE_T HexDecodeBlocks(
+    __in_ecount(2 * cbDest) LPCWSTR wzSource,
+    __in SIZE_T cbDest,
+    __out_bcount(cbDest) BYTE* pbDest
+    )
+{
+    SIZE_T i = 0;
+
+#ifdef STRUTIL_SSE2
+    // Decode 32 characters at a time: narrow to bytes, turn each character into its nibble
+    // and combine the pairs. Like HexCharToByte, this expects valid hex characters.
+    const __m128i vNine = _mm_set1_epi8('9');
+    const __m128i vDigit = _mm_set1_epi8('0');
+    const __m128i vLetter = _mm_set1_epi8('a' - 10 - '0');
+    const __m128i vLower = _mm_set1_epi8(0x20);
+    const __m128i vHighByte = _mm_set1_epi16(0x00FF);
+
+    for (; i + 16 <= cbDest; i += 16)
+    {
+        const __m128i* pvSource = reinterpret_cast<const __m128i*>(wzSource + 2 * i);
+        __m128i rgvPairs[2] = { _mm_packus_epi16(_mm_loadu_si128(pvSource), _mm_loadu_si128(pvSource + 1)), _mm_packus_epi16(_mm_loadu_si128(pvSource + 2), _mm_loadu_si128(pvSource + 3)) };
+
+        for (DWORD j = 0; j < countof(rgvPairs); ++j)
+        {
+            __m128i vIsLetter = _mm_cmpgt_epi8(rgvPairs[j], vNine);
+            __m128i vNibbles = _mm_sub_epi8(_mm_or_si128(rgvPairs[j], _mm_and_si128(vIsLetter, vLower)), vDigit);
+            vNibbles = _mm_sub_epi8(vNibbles, _mm_and_si128(vIsLetter, vLetter));
+
+            // Each 16-bit lane holds the high nibble in its low byte and the low nibble in its high byte.
+            rgvPairs[j] = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(vNibbles, vHighByte), 4), _mm_srli_epi16(vNibbles, 8));
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pbDest + i), _mm_packus_epi16(rgvPairs[0], rgvPairs[1]));
+    }
+#else
+    UNREFERENCED_PARAMETER(wzSource);
+    UNREFERENCED_PARAMETER(cbDest);
+    UNREFERENCED_PARAMETER(pbDest);
+#endif
+
+    return i;
+}
+
+static SIZE_T AsciiPrefixLength(
+    __in_ecount(cch) LPCWSTR wz,
+    __in SIZE_T cch
+    )
+{
+    SIZE_T i = 0;
+
+#ifdef STRUTIL_SSE2
+    const __m128i vNonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i vEmpty = _mm_setzero_si128();
+
+    for (; i + 8 <= cch; i += 8)
+    {
+        __m128i vChars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(wz + i));
+        if (0xFFFF != _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(vChars, vNonAscii), vEmpty)))
+        {
+            break;
+        }
+    }
+#endif
+
+    while (i < cch && 0x80 > wz[i])
+    {
+        ++i;
+    }
+
+    return i;
+}
+
+static SIZE_T AsciiPrefixLengthAnsi(
+    __in_ecount(cch) LPCSTR sz,
+    __in SIZE_T cch
+    )
+{
+    SIZE_T i = 0;
+
+#ifdef STRUTIL_SSE2
+    for (; i + 16 <= cch; i += 16)
+    {
+        if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sz + i))))
+        {
+            break;
+        }
+    }
+#endif
+
+    while (i < cch && 0 == (0x80 & sz[i]))
+    {
+        ++i;
+    }
+
+    return i;
+}
+
+static void NarrowAscii(
+    __in_ecount(cch) LPCWSTR wzSource,
+    __in SIZE_T cch,
+    __out_ecount(cch) LPSTR szDest
+    )
+{
+    SIZE_T i = 0;
+
+#ifdef STRUTIL_SSE2
+    for (; i + 16 <= cch; i += 16)
+    {
+        __m128i vLow = _mm_loadu_si128(reinterpret_cast<const __m128i*>(wzSource + i));
+        __m128i vHigh = _mm_loadu_si128(reinterpret_cast<const __m128i*>(wzSource + i + 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(szDest + i), _mm_packus_epi16(vLow, vHigh));
+    }
+#endif
+
+    for (; i < cch; ++i)
+    {
+        szDest[i] = static_cast<CHAR>(wzSource[i]);
+    }
+}
+
+static void WidenAscii(
+    __in_ecount(cch) LPCSTR szSource,
+    __in SIZE_T cch,
+    __out_ecount(cch) LPWSTR wzDest
+    )
+{
+    SIZE_T i = 0;
+
+#ifdef STRUTIL_SSE2
+    const __m128i vEmpty = _mm_setzero_si128();
+
+    for (; i + 16 <= cch; i += 16)
+    {
+        __m128i vChars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(szSource + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest + i), _mm_unpacklo_epi8(vChars, vEmpty));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(wzDest + i + 8), _mm_unpackhi_epi8(vChars, vEmpty));
+    }
+#endif
+
+    for (; i < cch; ++i)
+    {
+        wzDest[i] = static_cast<WCHAR>(static_cast<BYTE>(szSource[i]));
+    }
+}
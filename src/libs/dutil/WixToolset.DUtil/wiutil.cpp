@@ -858,6 +858,17 @@ LExit:
 }
 
 
+extern "C" void DAPI WiuSetExternalUIMessageFilter(
+    __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext,
+    __in DWORD dwIgnoredMessages,
+    __in DWORD dwProgressGranularity
+    )
+{
+    pExecuteContext->dwIgnoredMessages = dwIgnoredMessages;
+    pExecuteContext->dwProgressGranularity = dwProgressGranularity;
+}
+
+
 extern "C" void DAPI WiuUninitializeExternalUI(
     __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext
     )
@@ -1420,6 +1431,12 @@ static INT SendMsiMessage(
     LPWSTR* rgsczData = NULL;
     DWORD cData = 0;
 
+    // Don't even format the record for messages the handler doesn't want.
+    if (pContext->dwIgnoredMessages & WIU_MSI_MESSAGE_FLAG(mt))
+    {
+        return IDNOACTION;
+    }
+
     InitializeMessageData(hRecord, &rgsczData, &cData);
 
     message.type = WIU_MSI_EXECUTE_MESSAGE_MSI_MESSAGE;
@@ -1549,11 +1566,27 @@ static INT SendProgressUpdate(
     //AssertSz(qwCompleted <= qwTotal, "Completed progress is larger than total progress.");
 #endif
 
+    // Hold back small moves when the handler asked for coarser progress, but always report reaching either end.
+    if (pContext->dwProgressGranularity && pContext->fProgressSent)
+    {
+        DWORD dwMoved = dwPercentage > pContext->dwLastProgressPercentage ? dwPercentage - pContext->dwLastProgressPercentage : pContext->dwLastProgressPercentage - dwPercentage;
+        BOOL fEnd = (0 == dwPercentage || 100 == dwPercentage) && dwMoved;
+
+        if (dwMoved < pContext->dwProgressGranularity && !fEnd)
+        {
+            ExitFunction();
+        }
+    }
+
+    pContext->dwLastProgressPercentage = dwPercentage;
+    pContext->fProgressSent = TRUE;
+
     message.type = WIU_MSI_EXECUTE_MESSAGE_PROGRESS;
     message.dwUIHint = MB_OKCANCEL;
     message.progress.dwPercentage = dwPercentage;
     nResult = pContext->pfnMessageHandler(&message, pContext->pvContext);
 
+LExit:
     return nResult;
 }
 
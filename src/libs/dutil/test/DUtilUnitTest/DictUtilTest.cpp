@@ -35,6 +35,83 @@ namespace DutilTests
             DutilUninitialize();
         }
 
+        [Fact]
+        void DictUtilCaseInsensitiveNonAsciiTest()
+        {
+            HRESULT hr = S_OK;
+            STRINGDICT_HANDLE sdValues = NULL;
+            LPWSTR sczLongKey = NULL;
+            LPWSTR sczLongKeyUpper = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = DictCreateStringList(&sdValues, 0, DICT_FLAG_CASEINSENSITIVE);
+                NativeAssert::Succeeded(hr, "Failed to create dictionary of keys");
+
+                hr = DictAddKey(sdValues, L"Stra\x00df" L"e_\x00e4\x00f6\x00fc");
+                NativeAssert::Succeeded(hr, "Failed to add non-ASCII key to dict");
+
+                hr = DictKeyExists(sdValues, L"STRA\x00df" L"E_\x00c4\x00d6\x00dc");
+                NativeAssert::Succeeded(hr, "Failed to find upper-case non-ASCII key");
+
+                hr = DictKeyExists(sdValues, L"STRA\x00df" L"E_\x00c4\x00d6");
+                NativeAssert::SpecificReturnCode(E_NOTFOUND, hr, "Found a prefix of a non-ASCII key");
+
+                // Keys longer than the hash folding chunk, with non-ASCII characters on both sides of the boundary.
+                for (DWORD i = 0; i < 40; ++i)
+                {
+                    hr = StrAllocConcat(&sczLongKey, L"a\x00e9", 0);
+                    NativeAssert::Succeeded(hr, "Failed to build long key");
+
+                    hr = StrAllocConcat(&sczLongKeyUpper, L"A\x00c9", 0);
+                    NativeAssert::Succeeded(hr, "Failed to build long upper-case key");
+                }
+
+                hr = DictAddKey(sdValues, sczLongKey);
+                NativeAssert::Succeeded(hr, "Failed to add long key to dict");
+
+                hr = DictKeyExists(sdValues, sczLongKeyUpper);
+                NativeAssert::Succeeded(hr, "Failed to find long upper-case key");
+
+                // A surrogate pair (DESERET SMALL LETTER LONG I) that would straddle the hash folding chunk boundary.
+                hr = StrAllocString(&sczLongKey, L"", 0);
+                NativeAssert::Succeeded(hr, "Failed to reset long key");
+
+                hr = StrAllocString(&sczLongKeyUpper, L"", 0);
+                NativeAssert::Succeeded(hr, "Failed to reset long upper-case key");
+
+                for (DWORD i = 0; i < 63; ++i)
+                {
+                    hr = StrAllocConcat(&sczLongKey, L"b", 0);
+                    NativeAssert::Succeeded(hr, "Failed to build surrogate key");
+
+                    hr = StrAllocConcat(&sczLongKeyUpper, L"B", 0);
+                    NativeAssert::Succeeded(hr, "Failed to build upper-case surrogate key");
+                }
+
+                hr = StrAllocConcat(&sczLongKey, L"\xd801\xdc28", 0);
+                NativeAssert::Succeeded(hr, "Failed to build surrogate key");
+
+                hr = StrAllocConcat(&sczLongKeyUpper, L"\xd801\xdc00", 0);
+                NativeAssert::Succeeded(hr, "Failed to build upper-case surrogate key");
+
+                hr = DictAddKey(sdValues, sczLongKey);
+                NativeAssert::Succeeded(hr, "Failed to add surrogate key to dict");
+
+                hr = DictKeyExists(sdValues, sczLongKeyUpper);
+                NativeAssert::Succeeded(hr, "Failed to find upper-case surrogate key");
+            }
+            finally
+            {
+                ReleaseStr(sczLongKey);
+                ReleaseStr(sczLongKeyUpper);
+                ReleaseDict(sdValues);
+                DutilUninitialize();
+            }
+        }
+
     private:
         void EmbeddedKeyTestHelper(DICT_FLAG dfFlags, DWORD dwNumIterations)
         {
@@ -66,5 +66,136 @@ namespace DutilTests
                 ReleaseStr(sczCurrentDir);
             }
         }
+
+        [Fact]
+        void DirUtilParallelDeleteTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczCurrentDir = NULL;
+            LPWSTR sczGuid = NULL;
+            LPWSTR sczFolder = NULL;
+            LPWSTR sczSubFolder = NULL;
+            LPWSTR sczFile = NULL;
+
+            try
+            {
+                hr = GuidCreate(&sczGuid);
+                NativeAssert::Succeeded(hr, "Failed to create guid.");
+
+                hr = DirGetCurrent(&sczCurrentDir, NULL);
+                NativeAssert::Succeeded(hr, "Failed to get current directory.");
+
+                hr = PathConcat(sczCurrentDir, sczGuid, &sczFolder);
+                NativeAssert::Succeeded(hr, "Failed to combine current directory: '{0}' with Guid: '{1}'", sczCurrentDir, sczGuid);
+
+                // Enough files to spread the delete across more than one thread.
+                for (DWORD i = 0; i < 8; ++i)
+                {
+                    hr = StrAllocFormatted(&sczSubFolder, L"%ls\\sub%u\\nested", sczFolder, i);
+                    NativeAssert::Succeeded(hr, "Failed to format subfolder.");
+
+                    hr = DirEnsureExists(sczSubFolder, NULL);
+                    NativeAssert::Succeeded(hr, "Failed to create directories: {0}", sczSubFolder);
+
+                    for (DWORD j = 0; j < 64; ++j)
+                    {
+                        hr = StrAllocFormatted(&sczFile, L"%ls\\file%u.txt", 0 == j % 2 ? sczSubFolder : sczFolder, i * 64 + j);
+                        NativeAssert::Succeeded(hr, "Failed to format file name.");
+
+                        hr = FileWrite(sczFile, 0 == j % 16 ? FILE_ATTRIBUTE_READONLY : FILE_ATTRIBUTE_NORMAL, reinterpret_cast<LPCBYTE>(sczGuid), sizeof(WCHAR), NULL);
+                        NativeAssert::Succeeded(hr, "Failed to write file: {0}", sczFile);
+                    }
+                }
+
+                hr = DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_PARALLEL);
+                NativeAssert::Succeeded(hr, "Failed to delete directory tree: {0}", sczFolder);
+
+                Assert::False(DirExists(sczFolder, NULL) == TRUE);
+
+                hr = DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_PARALLEL);
+                Assert::Equal(E_PATHNOTFOUND, hr);
+            }
+            finally
+            {
+                ReleaseStr(sczFile);
+                ReleaseStr(sczSubFolder);
+                ReleaseStr(sczFolder);
+                ReleaseStr(sczGuid);
+                ReleaseStr(sczCurrentDir);
+            }
+        }
+
+        [Fact]
+        void DirUtilParallelDeleteLockedSubdirectoryFileTest()
+        {
+            HRESULT hr = S_OK;
+            LPWSTR sczCurrentDir = NULL;
+            LPWSTR sczGuid = NULL;
+            LPWSTR sczFolder = NULL;
+            LPWSTR sczSubFolder = NULL;
+            LPWSTR sczLockedFile = NULL;
+            LPWSTR sczTopFile = NULL;
+            HANDLE hLocked = INVALID_HANDLE_VALUE;
+            DWORD rgdwFlags[] = { DIR_DELETE_FILES | DIR_DELETE_RECURSE, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_PARALLEL };
+
+            try
+            {
+                hr = GuidCreate(&sczGuid);
+                NativeAssert::Succeeded(hr, "Failed to create guid.");
+
+                hr = DirGetCurrent(&sczCurrentDir, NULL);
+                NativeAssert::Succeeded(hr, "Failed to get current directory.");
+
+                hr = PathConcat(sczCurrentDir, sczGuid, &sczFolder);
+                NativeAssert::Succeeded(hr, "Failed to combine current directory: '{0}' with Guid: '{1}'", sczCurrentDir, sczGuid);
+
+                hr = PathConcat(sczFolder, L"sub", &sczSubFolder);
+                NativeAssert::Succeeded(hr, "Failed to combine folder with subfolder.");
+
+                hr = PathConcat(sczSubFolder, L"locked.txt", &sczLockedFile);
+                NativeAssert::Succeeded(hr, "Failed to combine subfolder with file name.");
+
+                hr = PathConcat(sczFolder, L"top.txt", &sczTopFile);
+                NativeAssert::Succeeded(hr, "Failed to combine folder with file name.");
+
+                hr = DirEnsureExists(sczSubFolder, NULL);
+                NativeAssert::Succeeded(hr, "Failed to create directories: {0}", sczSubFolder);
+
+                hr = FileWrite(sczLockedFile, FILE_ATTRIBUTE_NORMAL, reinterpret_cast<LPCBYTE>(sczGuid), sizeof(WCHAR), NULL);
+                NativeAssert::Succeeded(hr, "Failed to write file: {0}", sczLockedFile);
+
+                hLocked = ::CreateFileW(sczLockedFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                Assert::True(INVALID_HANDLE_VALUE != hLocked);
+
+                // A file that can't be deleted in a subdirectory is skipped, the rest of the tree is
+                // deleted and only removing the root fails. The serial and parallel paths must agree.
+                for (DWORD i = 0; i < countof(rgdwFlags); ++i)
+                {
+                    hr = FileWrite(sczTopFile, FILE_ATTRIBUTE_NORMAL, reinterpret_cast<LPCBYTE>(sczGuid), sizeof(WCHAR), NULL);
+                    NativeAssert::Succeeded(hr, "Failed to write file: {0}", sczTopFile);
+
+                    hr = DirEnsureDeleteEx(sczFolder, rgdwFlags[i]);
+                    Assert::Equal(HRESULT_FROM_WIN32(ERROR_DIR_NOT_EMPTY), hr);
+
+                    Assert::False(FileExistsEx(sczTopFile, NULL) == TRUE);
+                    Assert::True(FileExistsEx(sczLockedFile, NULL) == TRUE);
+                }
+
+                ReleaseFileHandle(hLocked);
+
+                hr = DirEnsureDeleteEx(sczFolder, DIR_DELETE_FILES | DIR_DELETE_RECURSE | DIR_DELETE_PARALLEL);
+                NativeAssert::Succeeded(hr, "Failed to delete directory tree: {0}", sczFolder);
+            }
+            finally
+            {
+                ReleaseFileHandle(hLocked);
+                ReleaseStr(sczTopFile);
+                ReleaseStr(sczLockedFile);
+                ReleaseStr(sczSubFolder);
+                ReleaseStr(sczFolder);
+                ReleaseStr(sczGuid);
+                ReleaseStr(sczCurrentDir);
+            }
+        }
     };
 }
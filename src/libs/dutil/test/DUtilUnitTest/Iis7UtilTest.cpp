@@ -0,0 +1,515 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixInternal::TestSupport;
+
+#define IIS7TEST_MAX_ELEMENTS 16
+
+// Just enough of the AppHost objects for iis7util to find elements by one string attribute
+// and to read an integer id attribute.
+class Iis7TestProperty : public IAppHostProperty
+{
+public:
+    Iis7TestProperty(LPCWSTR wzValue) : m_cRef(1), m_bstrValue(::SysAllocString(wzValue)), m_lValue(0) { }
+    Iis7TestProperty(LONG lValue) : m_cRef(1), m_bstrValue(NULL), m_lValue(lValue) { }
+    virtual ~Iis7TestProperty() { ReleaseBSTR(m_bstrValue); }
+
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv)
+    {
+        if (__uuidof(IUnknown) == riid || __uuidof(IAppHostProperty) == riid)
+        {
+            AddRef();
+            *ppv = this;
+            return S_OK;
+        }
+
+        *ppv = NULL;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() { return ++m_cRef; }
+    STDMETHODIMP_(ULONG) Release() { ULONG cRef = --m_cRef; if (!cRef) { delete this; } return cRef; }
+
+    STDMETHODIMP get_Name(BSTR* /*pbstrName*/) { return E_NOTIMPL; }
+    STDMETHODIMP get_Value(VARIANT* pVariant)
+    {
+        ::VariantInit(pVariant);
+        if (!m_bstrValue)
+        {
+            pVariant->vt = VT_I4;
+            pVariant->lVal = m_lValue;
+            return S_OK;
+        }
+
+        pVariant->vt = VT_BSTR;
+        pVariant->bstrVal = ::SysAllocString(m_bstrValue);
+        return pVariant->bstrVal ? S_OK : E_OUTOFMEMORY;
+    }
+    STDMETHODIMP put_Value(VARIANT /*value*/) { return E_NOTIMPL; }
+    STDMETHODIMP Clear() { return E_NOTIMPL; }
+    STDMETHODIMP get_StringValue(BSTR* /*pbstrValue*/) { return E_NOTIMPL; }
+    STDMETHODIMP get_Exception(IAppHostPropertyException** /*ppException*/) { return E_NOTIMPL; }
+    STDMETHODIMP GetMetadata(BSTR /*bstrMetadataType*/, VARIANT* /*pValue*/) { return E_NOTIMPL; }
+    STDMETHODIMP SetMetadata(BSTR /*bstrMetadataType*/, VARIANT /*value*/) { return E_NOTIMPL; }
+    STDMETHODIMP get_Schema(IAppHostPropertySchema** /*ppSchema*/) { return E_NOTIMPL; }
+
+private:
+    ULONG m_cRef;
+    BSTR m_bstrValue;
+    LONG m_lValue;
+};
+
+class Iis7TestElement : public IAppHostElement
+{
+public:
+    Iis7TestElement(LPCWSTR wzName, LPCWSTR wzAttributeName, LPCWSTR wzValue, LONG lId) : m_cRef(1), m_wzName(wzName), m_wzAttributeName(wzAttributeName), m_wzValue(wzValue), m_lId(lId) { }
+    virtual ~Iis7TestElement() { }
+
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv)
+    {
+        if (__uuidof(IUnknown) == riid || __uuidof(IAppHostElement) == riid)
+        {
+            AddRef();
+            *ppv = this;
+            return S_OK;
+        }
+
+        *ppv = NULL;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() { return ++m_cRef; }
+    STDMETHODIMP_(ULONG) Release() { ULONG cRef = --m_cRef; if (!cRef) { delete this; } return cRef; }
+
+    STDMETHODIMP get_Name(BSTR* pbstrName)
+    {
+        *pbstrName = ::SysAllocString(m_wzName);
+        return *pbstrName ? S_OK : E_OUTOFMEMORY;
+    }
+    STDMETHODIMP get_Collection(IAppHostElementCollection** /*ppCollection*/) { return E_NOTIMPL; }
+    STDMETHODIMP get_Properties(IAppHostPropertyCollection** /*ppProperties*/) { return E_NOTIMPL; }
+    STDMETHODIMP get_ChildElements(IAppHostChildElementCollection** /*ppElements*/) { return E_NOTIMPL; }
+    STDMETHODIMP GetMetadata(BSTR /*bstrMetadataType*/, VARIANT* /*pValue*/) { return E_NOTIMPL; }
+    STDMETHODIMP SetMetadata(BSTR /*bstrMetadataType*/, VARIANT /*value*/) { return E_NOTIMPL; }
+    STDMETHODIMP get_Schema(IAppHostElementSchema** /*ppSchema*/) { return E_NOTIMPL; }
+    STDMETHODIMP GetElementByName(BSTR /*bstrSubName*/, IAppHostElement** /*ppElement*/) { return E_NOTIMPL; }
+    STDMETHODIMP GetPropertyByName(BSTR bstrSubName, IAppHostProperty** ppProperty)
+    {
+        if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, m_wzAttributeName, -1, bstrSubName, -1))
+        {
+            *ppProperty = new Iis7TestProperty(m_wzValue);
+            return S_OK;
+        }
+        else if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"id", -1, bstrSubName, -1))
+        {
+            *ppProperty = new Iis7TestProperty(m_lId);
+            return S_OK;
+        }
+
+        *ppProperty = NULL;
+        return E_INVALIDARG;
+    }
+    STDMETHODIMP Clear() { return E_NOTIMPL; }
+    STDMETHODIMP get_Methods(IAppHostMethodCollection** /*ppMethods*/) { return E_NOTIMPL; }
+
+private:
+    ULONG m_cRef;
+    LPCWSTR m_wzName;
+    LPCWSTR m_wzAttributeName;
+    LPCWSTR m_wzValue;
+    LONG m_lId;
+};
+
+class Iis7TestCollection : public IAppHostElementCollection
+{
+public:
+    DWORD cGetItem;
+
+    Iis7TestCollection() : cGetItem(0), m_cRef(1), m_cElements(0) { }
+    virtual ~Iis7TestCollection()
+    {
+        for (DWORD i = 0; i < m_cElements; ++i)
+        {
+            ReleaseObject(m_rgpElements[i]);
+        }
+    }
+
+    STDMETHODIMP QueryInterface(REFIID riid, void** ppv)
+    {
+        if (__uuidof(IUnknown) == riid || __uuidof(IAppHostElementCollection) == riid)
+        {
+            AddRef();
+            *ppv = this;
+            return S_OK;
+        }
+
+        *ppv = NULL;
+        return E_NOINTERFACE;
+    }
+    STDMETHODIMP_(ULONG) AddRef() { return ++m_cRef; }
+    STDMETHODIMP_(ULONG) Release() { ULONG cRef = --m_cRef; if (!cRef) { delete this; } return cRef; }
+
+    STDMETHODIMP get_Count(DWORD* pcElementCount)
+    {
+        *pcElementCount = m_cElements;
+        return S_OK;
+    }
+    STDMETHODIMP get_Item(VARIANT cIndex, IAppHostElement** ppElement)
+    {
+        ++cGetItem;
+
+        if (VT_UI4 != cIndex.vt || cIndex.ulVal >= m_cElements)
+        {
+            *ppElement = NULL;
+            return E_INVALIDARG;
+        }
+
+        *ppElement = m_rgpElements[cIndex.ulVal];
+        (*ppElement)->AddRef();
+        return S_OK;
+    }
+    STDMETHODIMP AddElement(IAppHostElement* pElement, INT cPosition)
+    {
+        DWORD dwPosition = (0 > cPosition) ? m_cElements : static_cast<DWORD>(cPosition);
+        if (dwPosition > m_cElements || IIS7TEST_MAX_ELEMENTS == m_cElements)
+        {
+            return E_INVALIDARG;
+        }
+
+        ::MoveMemory(m_rgpElements + dwPosition + 1, m_rgpElements + dwPosition, sizeof(IAppHostElement*) * (m_cElements - dwPosition));
+        m_rgpElements[dwPosition] = pElement;
+        pElement->AddRef();
+        ++m_cElements;
+        return S_OK;
+    }
+    STDMETHODIMP DeleteElement(VARIANT cIndex)
+    {
+        if (VT_UI4 != cIndex.vt || cIndex.ulVal >= m_cElements)
+        {
+            return E_INVALIDARG;
+        }
+
+        ReleaseObject(m_rgpElements[cIndex.ulVal]);
+        --m_cElements;
+        ::MoveMemory(m_rgpElements + cIndex.ulVal, m_rgpElements + cIndex.ulVal + 1, sizeof(IAppHostElement*) * (m_cElements - cIndex.ulVal));
+        return S_OK;
+    }
+    STDMETHODIMP Clear() { return E_NOTIMPL; }
+    STDMETHODIMP CreateNewElement(BSTR /*bstrElementName*/, IAppHostElement** /*ppElement*/) { return E_NOTIMPL; }
+    STDMETHODIMP get_Schema(IAppHostCollectionSchema** /*ppSchema*/) { return E_NOTIMPL; }
+
+private:
+    ULONG m_cRef;
+    IAppHostElement* m_rgpElements[IIS7TEST_MAX_ELEMENTS];
+    DWORD m_cElements;
+};
+
+static void Iis7UtilTest_AddElement(
+    __in Iis7TestCollection* pCollection,
+    __in_opt IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzName,
+    __in_z LPCWSTR wzValue,
+    __in LONG lId,
+    __in INT iPosition
+    );
+static void Iis7UtilTest_AssertFind(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzValue,
+    __in DWORD dwExpectedIndex
+    );
+
+namespace DutilTests
+{
+    public ref class Iis7Util
+    {
+    public:
+        [Fact]
+        void Iis7AppHostIndexFindTest()
+        {
+            HRESULT hr = S_OK;
+            Iis7TestCollection* pCollection = NULL;
+            IIS7_APPHOSTINDEX_HANDLE hIndex = NULL;
+            DWORD cGetItem = 0;
+            BOOL fEqual = FALSE;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                pCollection = new Iis7TestCollection();
+
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"alpha", 0, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"remove", L"beta", 0, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"beta", 0, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"BETA", 0, -1);
+
+                hr = Iis7AppHostIndexCreate(pCollection, L"add", L"name", IIS7_APPHOSTINDEX_FLAG_NONE, &hIndex);
+                NativeAssert::Succeeded(hr, "Failed to create index.");
+
+                // Other element names are skipped and the first match wins, like the linear search.
+                Iis7UtilTest_AssertFind(hIndex, L"ALPHA", 0);
+                Iis7UtilTest_AssertFind(hIndex, L"Beta", 2);
+
+                // Once built, a hit only fetches the element it checks.
+                cGetItem = pCollection->cGetItem;
+                Iis7UtilTest_AssertFind(hIndex, L"beta", 2);
+                Assert::Equal<DWORD>(cGetItem + 1, pCollection->cGetItem);
+
+                // A miss is answered by the index too.
+                cGetItem = pCollection->cGetItem;
+                Iis7UtilTest_AssertFind(hIndex, L"gamma", MAXDWORD);
+                Assert::Equal<DWORD>(cGetItem, pCollection->cGetItem);
+
+                // Keys agree with CompareStringW on values that differ by more than case.
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"caf\x00E9", 0, -1);
+                fEqual = CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, L"caf\x00E9", -1, L"CAFE\x0301", -1);
+                Iis7UtilTest_AssertFind(hIndex, L"CAFE\x0301", fEqual ? 4 : MAXDWORD);
+            }
+            finally
+            {
+                ReleaseIis7AppHostIndex(hIndex);
+                ReleaseObject(pCollection);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void Iis7AppHostIndexAddDeleteTest()
+        {
+            HRESULT hr = S_OK;
+            Iis7TestCollection* pCollection = NULL;
+            IIS7_APPHOSTINDEX_HANDLE hIndex = NULL;
+            DWORD dwIndex = 0;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                pCollection = new Iis7TestCollection();
+
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"one", 0, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"two", 0, -1);
+
+                hr = Iis7AppHostIndexCreate(pCollection, L"add", L"name", IIS7_APPHOSTINDEX_FLAG_NONE, &hIndex);
+                NativeAssert::Succeeded(hr, "Failed to create index.");
+
+                Iis7UtilTest_AssertFind(hIndex, L"two", 1);
+
+                // Appending, inserting at the front and inserting in the middle all keep the index current.
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"three", 0, -1);
+                Iis7UtilTest_AssertFind(hIndex, L"three", 2);
+
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"zero", 0, 0);
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"minus", 0, 0);
+                Iis7UtilTest_AssertFind(hIndex, L"minus", 0);
+                Iis7UtilTest_AssertFind(hIndex, L"zero", 1);
+                Iis7UtilTest_AssertFind(hIndex, L"one", 2);
+                Iis7UtilTest_AssertFind(hIndex, L"three", 4);
+
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"half", 0, 3);
+                Iis7UtilTest_AssertFind(hIndex, L"one", 2);
+                Iis7UtilTest_AssertFind(hIndex, L"half", 3);
+                Iis7UtilTest_AssertFind(hIndex, L"two", 4);
+                Iis7UtilTest_AssertFind(hIndex, L"three", 5);
+
+                // A duplicate inserted before the first match becomes the match.
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"TWO", 0, 0);
+                Iis7UtilTest_AssertFind(hIndex, L"two", 0);
+                Iis7UtilTest_AssertFind(hIndex, L"minus", 1);
+
+                // Deleting it makes the later duplicate the match again.
+                hr = Iis7AppHostIndexFind(hIndex, L"two", NULL, &dwIndex);
+                NativeAssert::Succeeded(hr, "Failed to find element to delete.");
+
+                hr = Iis7AppHostIndexDeleteElement(hIndex, dwIndex);
+                NativeAssert::Succeeded(hr, "Failed to delete element.");
+
+                Iis7UtilTest_AssertFind(hIndex, L"two", 4);
+                Iis7UtilTest_AssertFind(hIndex, L"minus", 0);
+            }
+            finally
+            {
+                ReleaseIis7AppHostIndex(hIndex);
+                ReleaseObject(pCollection);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void Iis7AppHostIndexStaleTest()
+        {
+            HRESULT hr = S_OK;
+            Iis7TestCollection* pCollection = NULL;
+            IIS7_APPHOSTINDEX_HANDLE hIndex = NULL;
+            VARIANT vtIndex;
+
+            ::VariantInit(&vtIndex);
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                pCollection = new Iis7TestCollection();
+
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"one", 0, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"two", 0, -1);
+
+                hr = Iis7AppHostIndexCreate(pCollection, L"add", L"name", IIS7_APPHOSTINDEX_FLAG_NONE, &hIndex);
+                NativeAssert::Succeeded(hr, "Failed to create index.");
+
+                Iis7UtilTest_AssertFind(hIndex, L"one", 0);
+
+                // Misses are not checked against the collection, so an element added behind the index
+                // is only found once the index is invalidated.
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"three", 0, 0);
+                Iis7UtilTest_AssertFind(hIndex, L"three", MAXDWORD);
+
+                Iis7AppHostIndexInvalidate(hIndex);
+                Iis7UtilTest_AssertFind(hIndex, L"three", 0);
+
+                // Hits are still checked, so moved elements are found without invalidating...
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"four", 0, 0);
+                Iis7UtilTest_AssertFind(hIndex, L"one", 2);
+                Iis7UtilTest_AssertFind(hIndex, L"two", 3);
+
+                // ...including after deletes.
+                vtIndex.vt = VT_UI4;
+                vtIndex.ulVal = 2;
+                hr = pCollection->DeleteElement(vtIndex);
+                NativeAssert::Succeeded(hr, "Failed to delete element behind the index.");
+
+                Iis7UtilTest_AssertFind(hIndex, L"two", 2);
+                Iis7UtilTest_AssertFind(hIndex, L"one", MAXDWORD);
+            }
+            finally
+            {
+                ReleaseIis7AppHostIndex(hIndex);
+                ReleaseObject(pCollection);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void Iis7AppHostIndexIntegerTest()
+        {
+            HRESULT hr = S_OK;
+            Iis7TestCollection* pCollection = NULL;
+            IIS7_APPHOSTINDEX_HANDLE hIndex = NULL;
+            IIS7_APPHOSTINDEX_HANDLE hIdIndex = NULL;
+            IAppHostElement* pElement = NULL;
+            LPCWSTR rgwzIds[] = { L"7", L"40" };
+            DWORD dwIndex = 0;
+            DWORD dwExpectedIndex = 0;
+            DWORD dwMaxValue = 0;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                pCollection = new Iis7TestCollection();
+
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"a", 3, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"b", 7, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"remove", L"c", 40, -1);
+                Iis7UtilTest_AddElement(pCollection, NULL, L"add", L"d", 5, -1);
+
+                // Integer values cannot be keyed, so the index leaves them to the linear search.
+                hr = Iis7AppHostIndexCreate(pCollection, L"add", L"id", IIS7_APPHOSTINDEX_FLAG_NONE, &hIdIndex);
+                NativeAssert::Succeeded(hr, "Failed to create id index.");
+
+                for (DWORD i = 0; i < countof(rgwzIds); ++i)
+                {
+                    hr = Iis7FindAppHostElementString(pCollection, L"add", L"id", rgwzIds[i], &pElement, &dwIndex);
+                    NativeAssert::Succeeded(hr, "Failed to search collection for {0}.", rgwzIds[i]);
+
+                    dwExpectedIndex = pElement ? dwIndex : MAXDWORD;
+                    ReleaseNullObject(pElement);
+
+                    Iis7UtilTest_AssertFind(hIdIndex, rgwzIds[i], dwExpectedIndex);
+                }
+
+                // The largest id only counts indexed elements and follows adds and deletes.
+                hr = Iis7AppHostIndexCreate(pCollection, L"add", L"name", IIS7_APPHOSTINDEX_FLAG_NONE, &hIndex);
+                NativeAssert::Succeeded(hr, "Failed to create index.");
+
+                hr = Iis7AppHostIndexGetMaxInteger(hIndex, L"id", &dwMaxValue);
+                NativeAssert::Succeeded(hr, "Failed to get largest id.");
+                Assert::Equal<DWORD>(7, dwMaxValue);
+
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"e", 12, -1);
+                Iis7UtilTest_AddElement(pCollection, hIndex, L"add", L"f", 2, 0);
+
+                hr = Iis7AppHostIndexGetMaxInteger(hIndex, L"id", &dwMaxValue);
+                NativeAssert::Succeeded(hr, "Failed to get largest id after adds.");
+                Assert::Equal<DWORD>(12, dwMaxValue);
+                Iis7UtilTest_AssertFind(hIndex, L"e", 5);
+
+                hr = Iis7AppHostIndexFind(hIndex, L"e", NULL, &dwIndex);
+                NativeAssert::Succeeded(hr, "Failed to find element to delete.");
+
+                hr = Iis7AppHostIndexDeleteElement(hIndex, dwIndex);
+                NativeAssert::Succeeded(hr, "Failed to delete element.");
+
+                hr = Iis7AppHostIndexGetMaxInteger(hIndex, L"id", &dwMaxValue);
+                NativeAssert::Succeeded(hr, "Failed to get largest id after delete.");
+                Assert::Equal<DWORD>(7, dwMaxValue);
+            }
+            finally
+            {
+                ReleaseObject(pElement);
+                ReleaseIis7AppHostIndex(hIdIndex);
+                ReleaseIis7AppHostIndex(hIndex);
+                ReleaseObject(pCollection);
+                DutilUninitialize();
+            }
+        }
+    };
+}
+
+
+static void Iis7UtilTest_AddElement(
+    __in Iis7TestCollection* pCollection,
+    __in_opt IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzName,
+    __in_z LPCWSTR wzValue,
+    __in LONG lId,
+    __in INT iPosition
+    )
+{
+    HRESULT hr = S_OK;
+    IAppHostElement* pElement = new Iis7TestElement(wzName, L"name", wzValue, lId);
+
+    if (hIndex)
+    {
+        hr = Iis7AppHostIndexAddElement(hIndex, pElement, iPosition);
+    }
+    else
+    {
+        hr = pCollection->AddElement(pElement, iPosition);
+    }
+
+    ReleaseObject(pElement);
+
+    NativeAssert::Succeeded(hr, "Failed to add element {0}.", wzValue);
+}
+
+static void Iis7UtilTest_AssertFind(
+    __in IIS7_APPHOSTINDEX_HANDLE hIndex,
+    __in_z LPCWSTR wzValue,
+    __in DWORD dwExpectedIndex
+    )
+{
+    HRESULT hr = S_OK;
+    IAppHostElement* pElement = NULL;
+    DWORD dwIndex = 0;
+    BOOL fFound = FALSE;
+
+    hr = Iis7AppHostIndexFind(hIndex, wzValue, &pElement, &dwIndex);
+    fFound = NULL != pElement;
+    ReleaseObject(pElement);
+
+    NativeAssert::Succeeded(hr, "Failed to find element {0}.", wzValue);
+    Assert::Equal<DWORD>(dwExpectedIndex, dwIndex);
+    Assert::Equal<BOOL>(MAXDWORD != dwExpectedIndex, fFound);
+}
@@ -444,6 +444,184 @@ namespace DutilTests
             }
         }
 
+        [Fact]
+        void MemUtilCapacityTest()
+        {
+            HRESULT hr = S_OK;
+            ArrayValue* rgValues = NULL;
+            DWORD cValues = 0;
+            DWORD cCapacity = 0;
+            DWORD cGrowths = 0;
+            DWORD cPreviousCapacity = 0;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                for (DWORD i = 0; i < 1000; ++i)
+                {
+                    hr = MemEnsureArrayCapacityOf(rgValues, cValues + 1, &cCapacity);
+                    NativeAssert::Succeeded(hr, "Failed to grow array.");
+
+                    CheckNullItem(rgValues + cValues);
+                    rgValues[cValues].dwNum = i;
+                    ++cValues;
+
+                    if (cPreviousCapacity != cCapacity)
+                    {
+                        Assert::True(cCapacity >= 2 * cPreviousCapacity);
+                        cPreviousCapacity = cCapacity;
+                        ++cGrowths;
+                    }
+                }
+
+                // 8, 16, ..., 1024
+                NativeAssert::Equal<DWORD>(8, cGrowths);
+                Assert::True(cCapacity * sizeof(ArrayValue) <= MemSize(rgValues));
+
+                // Insert three items in the middle, which shifts the rest of the array.
+                hr = MemInsertIntoArrayOf(rgValues, 500, 3, cValues, &cCapacity);
+                NativeAssert::Succeeded(hr, "Failed to insert into array.");
+                cValues += 3;
+
+                for (DWORD i = 0; i < cValues; ++i)
+                {
+                    if (500 <= i && 503 > i)
+                    {
+                        CheckNullItem(rgValues + i);
+                    }
+                    else
+                    {
+                        NativeAssert::Equal<DWORD>(500 > i ? i : i - 3, rgValues[i].dwNum);
+                    }
+                }
+
+                // Inserting at the end appends.
+                hr = MemInsertIntoArrayOf(rgValues, cValues, 1, cValues, &cCapacity);
+                NativeAssert::Succeeded(hr, "Failed to insert at end of array.");
+                CheckNullItem(rgValues + cValues);
+                NativeAssert::Equal<DWORD>(999, rgValues[cValues - 1].dwNum);
+            }
+            finally
+            {
+                ReleaseMem(rgValues);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void MemUtilArenaTest()
+        {
+            HRESULT hr = S_OK;
+            HANDLE hHeap = NULL;
+            MEM_ARENA_HANDLE hArena = NULL;
+            BYTE* rgpb[100] = { };
+            BYTE* pbLarge = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = MemHeapCreate(&hHeap);
+                NativeAssert::Succeeded(hr, "Failed to create private heap");
+
+                hr = MemArenaCreate(hHeap, 256, &hArena);
+                NativeAssert::Succeeded(hr, "Failed to create arena");
+
+                for (DWORD i = 0; i < countof(rgpb); ++i)
+                {
+                    rgpb[i] = static_cast<BYTE*>(MemArenaAlloc(hArena, i % 13 + 1, TRUE));
+                    Assert::True(NULL != rgpb[i]);
+                    Assert::True(0 == reinterpret_cast<ULONG_PTR>(rgpb[i]) % MEMORY_ALLOCATION_ALIGNMENT);
+
+                    for (DWORD j = 0; j < i % 13 + 1; ++j)
+                    {
+                        Assert::Equal<BYTE>(0, rgpb[i][j]);
+                    }
+
+                    memset(rgpb[i], static_cast<BYTE>(i), i % 13 + 1);
+                }
+
+                // Larger than a block, so it gets a block of its own.
+                pbLarge = static_cast<BYTE*>(MemArenaAlloc(hArena, 1000, TRUE));
+                Assert::True(NULL != pbLarge);
+                memset(pbLarge, 0xff, 1000);
+
+                for (DWORD i = 0; i < countof(rgpb); ++i)
+                {
+                    for (DWORD j = 0; j < i % 13 + 1; ++j)
+                    {
+                        Assert::Equal<BYTE>(static_cast<BYTE>(i), rgpb[i][j]);
+                    }
+                }
+
+                MemArenaReset(hArena);
+
+                rgpb[0] = static_cast<BYTE*>(MemArenaAlloc(hArena, 16, TRUE));
+                Assert::True(NULL != rgpb[0]);
+                for (DWORD j = 0; j < 16; ++j)
+                {
+                    Assert::Equal<BYTE>(0, rgpb[0][j]);
+                }
+            }
+            finally
+            {
+                ReleaseMemArena(hArena);
+                ReleaseMemHeap(hHeap);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void MemUtilStatisticsTest()
+        {
+            MEM_STATISTICS statistics = { };
+            LPVOID rgpv[10] = { };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                MemStatisticsEnable(TRUE);
+
+                for (DWORD i = 0; i < countof(rgpv); ++i)
+                {
+                    rgpv[i] = MemAlloc(100, FALSE);
+                    Assert::True(NULL != rgpv[i]);
+                }
+
+                rgpv[0] = MemReAlloc(rgpv[0], 1000, FALSE);
+                Assert::True(NULL != rgpv[0]);
+
+                MemStatisticsGet(&statistics);
+
+                // Other tests may be allocating at the same time, so only lower bounds are checked.
+                Assert::True(10 <= statistics.cAllocations);
+                Assert::True(1 <= statistics.cReAllocations);
+                Assert::True(statistics.cbCurrent <= statistics.cbPeak);
+                Assert::True(0 < statistics.cbPeak);
+
+                for (DWORD i = 0; i < countof(rgpv); ++i)
+                {
+                    ReleaseNullMem(rgpv[i]);
+                }
+
+                MemStatisticsGet(&statistics);
+                Assert::True(10 <= statistics.cFrees);
+            }
+            finally
+            {
+                MemStatisticsEnable(FALSE);
+
+                for (DWORD i = 0; i < countof(rgpv); ++i)
+                {
+                    ReleaseMem(rgpv[i]);
+                }
+
+                DutilUninitialize();
+            }
+        }
+
     private:
         void SetItem(ArrayValue *pValue, DWORD dwValue)
         {
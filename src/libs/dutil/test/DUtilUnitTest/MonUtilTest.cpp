@@ -15,6 +15,10 @@ namespace DutilTests
     const int POSTWAIT = 480;
     const int FULLWAIT = 500;
     const int SILENCEPERIOD = 100;
+    const DWORD STRESSDIRECTORIES = 10000;
+    const DWORD STRESSATTEMPTS = 60;
+    const DWORD PORTSILENCEPERIOD = 300;
+    const DWORD_PTR PORTSYNCCONTEXT = 1;
 
     struct RegKey
     {
@@ -37,6 +41,24 @@ namespace DutilTests
         Directory *rgDirectories;
         DWORD cDirectories;
     };
+    struct StressResults
+    {
+        HANDLE hChanged;
+        LONG cFailures;
+        HRESULT hrFailure;
+        LONG cFileChanges;
+        LONG rgcDirectoryChanges[STRESSDIRECTORIES];
+    };
+    struct PortResults
+    {
+        HANDLE hChanged;
+        LONG cFailures;
+        HRESULT hrFailure;
+        LONG cSyncChanges;
+        LONG cDirectories;
+        LONG cRegKeys;
+        DWORD dwDirectoryTime;
+    };
 
     public delegate void MonGeneralDelegate(HRESULT, LPVOID);
 
@@ -44,6 +66,8 @@ namespace DutilTests
 
     public delegate void MonDirectoryDelegate(HRESULT, LPCWSTR, BOOL, LPVOID, LPVOID);
 
+    public delegate void MonDirectoryChangesDelegate(HRESULT, LPCWSTR, BOOL, const MON_FILE_CHANGE*, DWORD, LPVOID, LPVOID);
+
     public delegate void MonRegKeyDelegate(HRESULT, HKEY, LPCWSTR, REG_KEY_BITNESS, BOOL, LPVOID, LPVOID);
 
     static void MonGeneral(
@@ -85,6 +109,190 @@ namespace DutilTests
         pResults->rgDirectories[pResults->cDirectories - 1].fRecursive = fRecursive;
     }
 
+    static void MonStressRecordFailure(
+        __in StressResults* pResults,
+        __in HRESULT hrFailure
+        )
+    {
+        ::InterlockedIncrement(&pResults->cFailures);
+        ::InterlockedCompareExchange(&pResults->hrFailure, hrFailure, S_OK);
+        ::SetEvent(pResults->hChanged);
+    }
+
+    static void MonStressGeneral(
+        __in HRESULT hrResult,
+        __in_opt LPVOID pvContext
+        )
+    {
+        MonStressRecordFailure(reinterpret_cast<StressResults *>(pvContext), FAILED(hrResult) ? hrResult : E_UNEXPECTED);
+    }
+
+    static void MonDirectoryChanges(
+        __in HRESULT hrResult,
+        __in_z LPCWSTR /*wzPath*/,
+        __in_z BOOL /*fRecursive*/,
+        __in_ecount_opt(cChanges) const MON_FILE_CHANGE* rgChanges,
+        __in DWORD cChanges,
+        __in_opt LPVOID pvContext,
+        __in_opt LPVOID pvDirectoryContext
+        )
+    {
+        StressResults *pResults = reinterpret_cast<StressResults *>(pvContext);
+        DWORD_PTR dwDirectory = reinterpret_cast<DWORD_PTR>(pvDirectoryContext);
+
+        // Called from multiple worker threads at once, and an assert here wouldn't fail the test, so
+        // just record what happened and let the test thread check it.
+        if (FAILED(hrResult) || STRESSDIRECTORIES <= dwDirectory)
+        {
+            MonStressRecordFailure(pResults, FAILED(hrResult) ? hrResult : E_UNEXPECTED);
+            return;
+        }
+
+        for (DWORD i = 0; i < cChanges; ++i)
+        {
+            if (CSTR_EQUAL == ::CompareStringW(LOCALE_INVARIANT, NORM_IGNORECASE, rgChanges[i].wzPath, -1, L"file.txt", -1))
+            {
+                ::InterlockedIncrement(&pResults->cFileChanges);
+            }
+        }
+
+        ::InterlockedIncrement(&pResults->rgcDirectoryChanges[dwDirectory]);
+        ::SetEvent(pResults->hChanged);
+    }
+
+    static void MonStressWaitForChange(
+        __in StressResults* pResults,
+        __in_z LPCWSTR wzFile,
+        __in DWORD dwDirectory
+        )
+    {
+        HRESULT hr = S_OK;
+        LONG cChanges = pResults->rgcDirectoryChanges[dwDirectory];
+
+        // Adds and removes are picked up by the worker threads asynchronously, so a change made too early can be missed.
+        // Keep changing the file until the change is reported instead of guessing how long that takes.
+        for (DWORD i = 0; cChanges == pResults->rgcDirectoryChanges[dwDirectory] && !pResults->cFailures && i < STRESSATTEMPTS; ++i)
+        {
+            hr = FileFromString(wzFile, 0, 0 == i % 2 ? L"contents" : L"contents2", FILE_ENCODING_UTF16_WITH_BOM);
+            NativeAssert::ValidReturnCode(hr, S_OK);
+
+            ::WaitForSingleObject(pResults->hChanged, FULLWAIT);
+        }
+
+        NativeAssert::ValidReturnCode(pResults->hrFailure, S_OK);
+        Assert::Equal<LONG>(0, pResults->cFailures);
+        Assert::NotEqual<LONG>(cChanges, pResults->rgcDirectoryChanges[dwDirectory]);
+    }
+
+    static void MonPortRecordFailure(
+        __in PortResults* pResults,
+        __in HRESULT hrFailure
+        )
+    {
+        ::InterlockedIncrement(&pResults->cFailures);
+        ::InterlockedCompareExchange(&pResults->hrFailure, hrFailure, S_OK);
+        ::SetEvent(pResults->hChanged);
+    }
+
+    static void MonPortGeneral(
+        __in HRESULT hrResult,
+        __in_opt LPVOID pvContext
+        )
+    {
+        MonPortRecordFailure(reinterpret_cast<PortResults *>(pvContext), FAILED(hrResult) ? hrResult : E_UNEXPECTED);
+    }
+
+    static void MonPortDirectory(
+        __in HRESULT hrResult,
+        __in_z LPCWSTR /*wzPath*/,
+        __in_z BOOL /*fRecursive*/,
+        __in_opt LPVOID pvContext,
+        __in_opt LPVOID pvDirectoryContext
+        )
+    {
+        PortResults *pResults = reinterpret_cast<PortResults *>(pvContext);
+
+        // Called on the worker thread, where an assert wouldn't fail the test.
+        if (FAILED(hrResult))
+        {
+            MonPortRecordFailure(pResults, hrResult);
+            return;
+        }
+
+        if (PORTSYNCCONTEXT == reinterpret_cast<DWORD_PTR>(pvDirectoryContext))
+        {
+            ::InterlockedIncrement(&pResults->cSyncChanges);
+        }
+        else
+        {
+            pResults->dwDirectoryTime = ::GetTickCount();
+            ::InterlockedIncrement(&pResults->cDirectories);
+        }
+
+        ::SetEvent(pResults->hChanged);
+    }
+
+    static void MonPortRegKey(
+        __in HRESULT hrResult,
+        __in HKEY /*hkRoot*/,
+        __in_z LPCWSTR /*wzSubKey*/,
+        __in REG_KEY_BITNESS /*kbKeyBitness*/,
+        __in_z BOOL /*fRecursive*/,
+        __in_opt LPVOID pvContext,
+        __in_opt LPVOID /*pvRegKeyContext*/
+        )
+    {
+        PortResults *pResults = reinterpret_cast<PortResults *>(pvContext);
+
+        if (FAILED(hrResult))
+        {
+            MonPortRecordFailure(pResults, hrResult);
+            return;
+        }
+
+        ::InterlockedIncrement(&pResults->cRegKeys);
+        ::SetEvent(pResults->hChanged);
+    }
+
+    static void MonPortWaitForCount(
+        __in PortResults* pResults,
+        __in LONG volatile* pcCount,
+        __in LONG cExpected
+        )
+    {
+        for (DWORD i = 0; *pcCount < cExpected && !pResults->cFailures && i < STRESSATTEMPTS; ++i)
+        {
+            ::WaitForSingleObject(pResults->hChanged, FULLWAIT);
+        }
+
+        NativeAssert::ValidReturnCode(pResults->hrFailure, S_OK);
+        Assert::Equal<LONG>(0, pResults->cFailures);
+        Assert::Equal<LONG>(cExpected, *pcCount);
+    }
+
+    // With a single worker thread, packets are handled in the order they were queued. Once a change to the sync
+    // directory made now has been reported, every add, remove and directory change queued before it has been handled.
+    static void MonPortSync(
+        __in PortResults* pResults,
+        __in_z LPCWSTR wzSyncFile
+        )
+    {
+        HRESULT hr = S_OK;
+        LONG cChanges = pResults->cSyncChanges;
+
+        for (DWORD i = 0; cChanges == pResults->cSyncChanges && !pResults->cFailures && i < STRESSATTEMPTS; ++i)
+        {
+            hr = FileFromString(wzSyncFile, 0, 0 == i % 2 ? L"contents" : L"contents2", FILE_ENCODING_UTF16_WITH_BOM);
+            NativeAssert::ValidReturnCode(hr, S_OK);
+
+            ::WaitForSingleObject(pResults->hChanged, FULLWAIT);
+        }
+
+        NativeAssert::ValidReturnCode(pResults->hrFailure, S_OK);
+        Assert::Equal<LONG>(0, pResults->cFailures);
+        Assert::NotEqual<LONG>(cChanges, pResults->cSyncChanges);
+    }
+
     static void MonRegKey(
         __in HRESULT hrResult,
         __in HKEY hkRoot,
@@ -485,5 +693,323 @@ namespace DutilTests
                 RegUninitialize();
             }
         }
+
+        [Fact]
+        void MonUtilCompletionPortTest()
+        {
+            HRESULT hr = S_OK;
+            MON_HANDLE handle = NULL;
+            LPWSTR sczBasePath = NULL;
+            LPWSTR sczSyncPath = NULL;
+            LPWSTR sczSyncFile = NULL;
+            LPWSTR sczParentPath = NULL;
+            LPWSTR sczDeepPath = NULL;
+            LPWSTR sczChildPath = NULL;
+            LPWSTR sczChildFilePath = NULL;
+            LPCWSTR wzShallowRegKey = L"Software\\MonUtilPortTest\\";
+            LPCWSTR wzParentRegKey = L"Software\\MonUtilPortTest\\sub\\folder\\";
+            LPCWSTR wzDeepRegKey = L"Software\\MonUtilPortTest\\sub\\folder\\exist\\";
+            LPCWSTR wzChildRegKey = L"Software\\MonUtilPortTest\\sub\\folder\\exist\\some\\child\\";
+            HKEY hk = NULL;
+            DWORD dwChangeTime = 0;
+            LONG cDirectories = 0;
+            List<GCHandle>^ gcHandles = gcnew List<GCHandle>();
+            PortResults *pResults = (PortResults *)MemAlloc(sizeof(PortResults), TRUE);
+            Assert::True(NULL != pResults);
+
+            try
+            {
+                pResults->hChanged = ::CreateEventW(NULL, FALSE, FALSE, NULL);
+                Assert::True(NULL != pResults->hChanged);
+
+                MonGeneralDelegate^ fpMonGeneral = gcnew MonGeneralDelegate(MonPortGeneral);
+                GCHandle gchMonGeneral = GCHandle::Alloc(fpMonGeneral);
+                gcHandles->Add(gchMonGeneral);
+                IntPtr ipMonGeneral = Marshal::GetFunctionPointerForDelegate(fpMonGeneral);
+
+                MonDirectoryDelegate^ fpMonDirectory = gcnew MonDirectoryDelegate(MonPortDirectory);
+                GCHandle gchMonDirectory = GCHandle::Alloc(fpMonDirectory);
+                gcHandles->Add(gchMonDirectory);
+                IntPtr ipMonDirectory = Marshal::GetFunctionPointerForDelegate(fpMonDirectory);
+
+                MonRegKeyDelegate^ fpMonRegKey = gcnew MonRegKeyDelegate(MonPortRegKey);
+                GCHandle gchMonRegKey = GCHandle::Alloc(fpMonRegKey);
+                gcHandles->Add(gchMonRegKey);
+                IntPtr ipMonRegKey = Marshal::GetFunctionPointerForDelegate(fpMonRegKey);
+
+                // A single worker thread, so MonPortSync() can tell when earlier changes have been handled.
+                hr = MonCreateEx(&handle, 1, static_cast<PFN_MONGENERAL>(ipMonGeneral.ToPointer()), static_cast<PFN_MONDIRECTORY>(ipMonDirectory.ToPointer()), NULL, static_cast<PFN_MONREGKEY>(ipMonRegKey.ToPointer()), pResults);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = RegInitialize();
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathExpand(&sczBasePath, L"%TEMP%\\MonUtilPortTest\\", PATH_EXPAND_ENVIRONMENT);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathConcat(sczBasePath, L"sync\\", &sczSyncPath);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathConcat(sczSyncPath, L"file.txt", &sczSyncFile);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathConcat(sczBasePath, L"sub\\folder\\", &sczParentPath);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathConcat(sczParentPath, L"exist\\", &sczDeepPath);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathConcat(sczDeepPath, L"some\\child\\", &sczChildPath);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathConcat(sczChildPath, L"file.txt", &sczChildFilePath);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                RemoveDirectory(sczBasePath);
+
+                hr = RegDelete(HKEY_CURRENT_USER, wzShallowRegKey, REG_KEY_DEFAULT, TRUE);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE, E_PATHNOTFOUND);
+
+                hr = DirEnsureExists(sczSyncPath, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+
+                hr = MonAddDirectory(handle, sczSyncPath, FALSE, SILENCEPERIOD, reinterpret_cast<LPVOID>(PORTSYNCCONTEXT));
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                // A recursive watch on a directory that doesn't exist yet waits on its closest existing parent.
+                hr = MonAddDirectory(handle, sczDeepPath, TRUE, PORTSILENCEPERIOD, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+                MonPortSync(pResults, sczSyncFile);
+
+                // Creating a parent only moves the wait closer, so nothing is reported.
+                hr = DirEnsureExists(sczParentPath, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+                MonPortSync(pResults, sczSyncFile);
+                Assert::Equal<LONG>(0, pResults->cDirectories);
+
+                // Creating the directory itself is reported, but not before the silence period has passed.
+                dwChangeTime = ::GetTickCount();
+                hr = DirEnsureExists(sczDeepPath, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+                MonPortWaitForCount(pResults, &pResults->cDirectories, 1);
+                Assert::True(PORTSILENCEPERIOD / 2 <= pResults->dwDirectoryTime - dwChangeTime);
+
+                // Changes deep below the directory are reported, and a burst of them inside the silence period is reported once.
+                hr = DirEnsureExists(sczChildPath, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+                MonPortWaitForCount(pResults, &pResults->cDirectories, 2);
+
+                hr = FileFromString(sczChildFilePath, 0, L"contents", FILE_ENCODING_UTF16_WITH_BOM);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+                MonPortWaitForCount(pResults, &pResults->cDirectories, 3);
+
+                for (DWORD i = 0; i < 5; ++i)
+                {
+                    hr = FileFromString(sczChildFilePath, 0, 0 == i % 2 ? L"contents2" : L"contents3", FILE_ENCODING_UTF16_WITH_BOM);
+                    NativeAssert::ValidReturnCode(hr, S_OK);
+                }
+                MonPortWaitForCount(pResults, &pResults->cDirectories, 4);
+
+                ::Sleep(2 * PORTSILENCEPERIOD);
+                MonPortSync(pResults, sczSyncFile);
+                Assert::Equal<LONG>(4, pResults->cDirectories);
+
+                // Deleting it along with its parents is reported, and the wait goes back to the closest existing parent.
+                RemoveDirectory(sczParentPath);
+                MonPortWaitForCount(pResults, &pResults->cDirectories, 5);
+
+                hr = DirEnsureExists(sczDeepPath, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+                MonPortWaitForCount(pResults, &pResults->cDirectories, 6);
+
+                // Once removed, changes aren't reported anymore.
+                hr = MonRemoveDirectory(handle, sczDeepPath, TRUE);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+                MonPortSync(pResults, sczSyncFile);
+
+                cDirectories = pResults->cDirectories;
+                hr = DirEnsureExists(sczChildPath, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+
+                hr = FileFromString(sczChildFilePath, 0, L"contents4", FILE_ENCODING_UTF16_WITH_BOM);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                ::Sleep(2 * PORTSILENCEPERIOD);
+                MonPortSync(pResults, sczSyncFile);
+                Assert::Equal<LONG>(cDirectories, pResults->cDirectories);
+
+                // Registry keys are watched the same way.
+                hr = MonAddRegKey(handle, HKEY_CURRENT_USER, wzDeepRegKey, REG_KEY_DEFAULT, TRUE, PORTSILENCEPERIOD, NULL);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+                MonPortSync(pResults, sczSyncFile);
+
+                hr = RegCreate(HKEY_CURRENT_USER, wzParentRegKey, KEY_SET_VALUE | KEY_QUERY_VALUE, &hk);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+                ReleaseRegKey(hk);
+
+                hr = RegCreate(HKEY_CURRENT_USER, wzDeepRegKey, KEY_SET_VALUE | KEY_QUERY_VALUE, &hk);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+                ReleaseRegKey(hk);
+                MonPortWaitForCount(pResults, &pResults->cRegKeys, 1);
+
+                // Registry notifications reach the completion port from the thread pool, so give a stray one from
+                // creating the parent time to show up.
+                ::Sleep(2 * PORTSILENCEPERIOD);
+                Assert::Equal<LONG>(1, pResults->cRegKeys);
+
+                hr = RegCreate(HKEY_CURRENT_USER, wzChildRegKey, KEY_SET_VALUE | KEY_QUERY_VALUE, &hk);
+                NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+                MonPortWaitForCount(pResults, &pResults->cRegKeys, 2);
+
+                hr = RegWriteString(hk, L"valuename", L"testvalue");
+                NativeAssert::ValidReturnCode(hr, S_OK);
+                MonPortWaitForCount(pResults, &pResults->cRegKeys, 3);
+
+                hr = MonRemoveRegKey(handle, HKEY_CURRENT_USER, wzDeepRegKey, REG_KEY_DEFAULT, TRUE);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+                MonPortSync(pResults, sczSyncFile);
+
+                hr = RegWriteString(hk, L"valuename", L"testvalue2");
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                ::Sleep(2 * PORTSILENCEPERIOD);
+                Assert::Equal<LONG>(3, pResults->cRegKeys);
+                NativeAssert::ValidReturnCode(pResults->hrFailure, S_OK);
+            }
+            finally
+            {
+                ReleaseRegKey(hk);
+                ReleaseMon(handle);
+
+                for each (GCHandle gcHandle in gcHandles)
+                {
+                    gcHandle.Free();
+                }
+
+                RegDelete(HKEY_CURRENT_USER, wzShallowRegKey, REG_KEY_DEFAULT, TRUE);
+
+                if (sczBasePath)
+                {
+                    RemoveDirectory(sczBasePath);
+                }
+
+                ReleaseStr(sczBasePath);
+                ReleaseStr(sczSyncPath);
+                ReleaseStr(sczSyncFile);
+                ReleaseStr(sczParentPath);
+                ReleaseStr(sczDeepPath);
+                ReleaseStr(sczChildPath);
+                ReleaseStr(sczChildFilePath);
+                ReleaseHandle(pResults->hChanged);
+                ReleaseMem(pResults);
+
+                RegUninitialize();
+            }
+        }
+
+        [Fact]
+        void MonUtilCompletionPortStressTest()
+        {
+            HRESULT hr = S_OK;
+            MON_HANDLE handle = NULL;
+            LPWSTR sczBaseDir = NULL;
+            LPWSTR sczDir = NULL;
+            LPWSTR sczFile = NULL;
+            LPWSTR sczFirstFile = NULL;
+            List<GCHandle>^ gcHandles = gcnew List<GCHandle>();
+            StressResults *pResults = (StressResults *)MemAlloc(sizeof(StressResults), TRUE);
+            Assert::True(NULL != pResults);
+
+            try
+            {
+                pResults->hChanged = ::CreateEventW(NULL, FALSE, FALSE, NULL);
+                Assert::True(NULL != pResults->hChanged);
+
+                MonGeneralDelegate^ fpMonGeneral = gcnew MonGeneralDelegate(MonStressGeneral);
+                GCHandle gchMonGeneral = GCHandle::Alloc(fpMonGeneral);
+                gcHandles->Add(gchMonGeneral);
+                IntPtr ipMonGeneral = Marshal::GetFunctionPointerForDelegate(fpMonGeneral);
+
+                MonDirectoryChangesDelegate^ fpMonDirectoryChanges = gcnew MonDirectoryChangesDelegate(MonDirectoryChanges);
+                GCHandle gchMonDirectoryChanges = GCHandle::Alloc(fpMonDirectoryChanges);
+                gcHandles->Add(gchMonDirectoryChanges);
+                IntPtr ipMonDirectoryChanges = Marshal::GetFunctionPointerForDelegate(fpMonDirectoryChanges);
+
+                hr = MonCreateEx(&handle, 0, static_cast<PFN_MONGENERAL>(ipMonGeneral.ToPointer()), NULL, static_cast<PFN_MONDIRECTORYCHANGES>(ipMonDirectoryChanges.ToPointer()), NULL, pResults);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                hr = PathExpand(&sczBaseDir, L"%TEMP%\\MonUtilStressTest\\", PATH_EXPAND_ENVIRONMENT);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                RemoveDirectory(sczBaseDir);
+
+                for (DWORD i = 0; i < STRESSDIRECTORIES; ++i)
+                {
+                    hr = StrAllocFormatted(&sczDir, L"%ls%u\\", sczBaseDir, i);
+                    NativeAssert::ValidReturnCode(hr, S_OK);
+
+                    hr = DirEnsureExists(sczDir, NULL);
+                    NativeAssert::ValidReturnCode(hr, S_OK, S_FALSE);
+
+                    hr = MonAddDirectory(handle, sczDir, FALSE, SILENCEPERIOD, reinterpret_cast<LPVOID>(static_cast<DWORD_PTR>(i)));
+                    NativeAssert::ValidReturnCode(hr, S_OK);
+
+                    if (0 == i)
+                    {
+                        hr = PathConcat(sczDir, L"file.txt", &sczFirstFile);
+                        NativeAssert::ValidReturnCode(hr, S_OK);
+                    }
+                }
+
+                // A change to one of the directories is reported for that directory only, with the file that changed
+                hr = PathConcat(sczDir, L"file.txt", &sczFile);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                MonStressWaitForChange(pResults, sczFile, STRESSDIRECTORIES - 1);
+                Assert::True(0 < pResults->cFileChanges);
+
+                for (DWORD i = 0; i < STRESSDIRECTORIES - 1; ++i)
+                {
+                    Assert::Equal<LONG>(0, pResults->rgcDirectoryChanges[i]);
+                }
+
+                // Once removed, changes to the directory aren't reported anymore. Changes to another directory are still
+                // reported, so once one of those has been reported again, a change made before it to the removed directory
+                // would have been reported too.
+                hr = MonRemoveDirectory(handle, sczDir, FALSE);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                MonStressWaitForChange(pResults, sczFirstFile, 0);
+
+                LONG cRemovedChanges = pResults->rgcDirectoryChanges[STRESSDIRECTORIES - 1];
+
+                hr = FileFromString(sczFile, 0, L"contents3", FILE_ENCODING_UTF16_WITH_BOM);
+                NativeAssert::ValidReturnCode(hr, S_OK);
+
+                MonStressWaitForChange(pResults, sczFirstFile, 0);
+                Assert::Equal<LONG>(cRemovedChanges, pResults->rgcDirectoryChanges[STRESSDIRECTORIES - 1]);
+            }
+            finally
+            {
+                ReleaseMon(handle);
+
+                for each (GCHandle gcHandle in gcHandles)
+                {
+                    gcHandle.Free();
+                }
+
+                if (sczBaseDir)
+                {
+                    RemoveDirectory(sczBaseDir);
+                }
+
+                ReleaseStr(sczBaseDir);
+                ReleaseStr(sczDir);
+                ReleaseStr(sczFile);
+                ReleaseStr(sczFirstFile);
+                ReleaseHandle(pResults->hChanged);
+                ReleaseMem(pResults);
+            }
+        }
     };
 }
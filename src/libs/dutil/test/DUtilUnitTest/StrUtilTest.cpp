@@ -80,6 +80,109 @@ namespace DutilTests
             TestStrAnsiAllocString(b, 0, "abCd");
         }
 
+        [Fact]
+        void StrUtilConvertMatchesWindowsTest()
+        {
+            HRESULT hr = S_OK;
+            WCHAR wzSource[80] = { };
+            CHAR szExpected[240] = { };
+            WCHAR wzExpected[80] = { };
+            LPSTR sczOutput = NULL;
+            LPWSTR sczWideOutput = NULL;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                // Cover every length around the block sizes, all ASCII and with a non-ASCII character in every position.
+                for (DWORD cch = 1; cch < countof(wzSource); ++cch)
+                {
+                    for (DWORD iNonAscii = 0; iNonAscii <= cch; ++iNonAscii)
+                    {
+                        for (DWORD i = 0; i < cch; ++i)
+                        {
+                            wzSource[i] = static_cast<WCHAR>(L' ' + (i * 7 + cch) % 95);
+                        }
+
+                        if (iNonAscii < cch)
+                        {
+                            wzSource[iNonAscii] = 0 == iNonAscii % 2 ? L'\x00e9' : L'\x4e2d';
+                        }
+
+                        wzSource[cch] = L'\0';
+
+                        ::WideCharToMultiByte(CP_UTF8, 0, wzSource, -1, szExpected, countof(szExpected), NULL, NULL);
+
+                        hr = StrAnsiAllocString(&sczOutput, wzSource, 0, CP_UTF8);
+                        NativeAssert::Succeeded(hr, "Failed to convert string: {0}", wzSource);
+                        Assert::Equal<int>(0, strcmp(szExpected, sczOutput));
+
+                        ::MultiByteToWideChar(CP_UTF8, 0, szExpected, -1, wzExpected, countof(wzExpected));
+
+                        hr = StrAllocStringAnsi(&sczWideOutput, szExpected, 0, CP_UTF8);
+                        NativeAssert::Succeeded(hr, "Failed to convert string: {0}", wzSource);
+                        NativeAssert::StringEqual(wzExpected, sczWideOutput);
+                    }
+                }
+            }
+            finally
+            {
+                ReleaseStr(sczOutput);
+                ReleaseStr(sczWideOutput);
+                DutilUninitialize();
+            }
+        }
+
+        [Fact]
+        void StrUtilHexTest()
+        {
+            HRESULT hr = S_OK;
+            BYTE rgbSource[70] = { };
+            WCHAR wzExpected[2 * countof(rgbSource) + 1] = { };
+            LPWSTR sczEncoded = NULL;
+            BYTE* pbDecoded = NULL;
+            DWORD cbDecoded = 0;
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                // Cover every length around the block sizes.
+                for (DWORD cb = 1; cb < countof(rgbSource); ++cb)
+                {
+                    for (DWORD i = 0; i < cb; ++i)
+                    {
+                        rgbSource[i] = static_cast<BYTE>(i * 37 + cb);
+                        ::StringCchPrintfW(wzExpected + 2 * i, countof(wzExpected) - 2 * i, L"%02X", rgbSource[i]);
+                    }
+
+                    hr = StrAllocHexEncode(rgbSource, cb, &sczEncoded);
+                    NativeAssert::Succeeded(hr, "Failed to hex encode bytes.");
+                    NativeAssert::StringEqual(wzExpected, sczEncoded);
+
+                    hr = StrAllocHexDecode(sczEncoded, &pbDecoded, &cbDecoded);
+                    NativeAssert::Succeeded(hr, "Failed to hex decode: {0}", sczEncoded);
+                    Assert::Equal<DWORD>(cb, cbDecoded);
+                    Assert::Equal<int>(0, memcmp(rgbSource, pbDecoded, cb));
+                    ReleaseNullMem(pbDecoded);
+
+                    // Lowercase decodes the same.
+                    ::CharLowerW(sczEncoded);
+
+                    hr = StrAllocHexDecode(sczEncoded, &pbDecoded, &cbDecoded);
+                    NativeAssert::Succeeded(hr, "Failed to hex decode: {0}", sczEncoded);
+                    Assert::Equal<int>(0, memcmp(rgbSource, pbDecoded, cb));
+                    ReleaseNullMem(pbDecoded);
+                }
+            }
+            finally
+            {
+                ReleaseStr(sczEncoded);
+                ReleaseMem(pbDecoded);
+                DutilUninitialize();
+            }
+        }
+
     private:
         void TestTrim(LPCWSTR wzInput, LPCWSTR wzExpectedResult)
         {
@@ -0,0 +1,202 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixInternal::TestSupport;
+
+struct WIU_TEST_CONTEXT
+{
+    DWORD cActionStart;
+    DWORD cActionData;
+    DWORD cError;
+    DWORD rgdwProgress[16];
+    DWORD cProgress;
+};
+
+static INSTALLUI_HANDLER_RECORD vpfnExternalUIRecord = NULL;
+
+static UINT WINAPI WiuUtilTest_MsiSetExternalUIRecord(
+    __in_opt INSTALLUI_HANDLER_RECORD puiHandler,
+    __in DWORD dwMessageFilter,
+    __in_opt LPVOID pvContext,
+    __out_opt PINSTALLUI_HANDLER_RECORD ppuiPrevHandler
+    );
+static int WiuUtilTest_MessageHandler(
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in_opt LPVOID pvContext
+    );
+static INT WiuUtilTest_SendRecord(
+    __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext,
+    __in INSTALLMESSAGE mt,
+    __in DWORD cFields,
+    __in_ecount(cFields) INT* rgnFields
+    );
+
+namespace DutilTests
+{
+    public ref class WiuUtil
+    {
+    public:
+        [Fact]
+        void WiuUtilExternalUIMessageFilterTest()
+        {
+            HRESULT hr = S_OK;
+            WIU_TEST_CONTEXT context = { };
+            WIU_MSI_EXECUTE_CONTEXT executeContext = { };
+            INT rgnField[] = { 1 };
+            DWORD rgdwExpectedProgress[] = { 0, 15, 27, 91, 100 };
+
+            // Each progress record is { type, value, direction, script } and the percentage is what wiutil sends after it.
+            // Moves smaller than the granularity are held back, except reaching the end.
+            INT rgrgnProgress[][4] =
+            {
+                { 0, 100, 0, 1 }, // phase 1 starts at 0%, the first update is always sent
+                { 2, 15 },        // 1%
+                { 0, 100, 0, 1 }, // phase 2 starts at 15%
+                { 2, 5 },         // 19%
+                { 2, 5 },         // 23%
+                { 2, 5 },         // 27%
+                { 2, 80 },        // 91%
+                { 2, 5 },         // 95%
+                { 0, 100, 0, 1 }, // phase 3 starts at 95%
+                { 2, 100 },       // 100%
+            };
+            DWORD rgcProgressFields[] = { 4, 2, 4, 2, 2, 2, 2, 2, 4, 2 };
+
+            DutilInitialize(&DutilTestTraceError);
+
+            try
+            {
+                hr = WiuInitialize();
+                NativeAssert::Succeeded(hr, "Failed to initialize wiutil.");
+
+                // Capture the handler wiutil installs so the test can feed it records like Windows Installer would.
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, WiuUtilTest_MsiSetExternalUIRecord, NULL);
+
+                hr = WiuInitializeExternalUI(WiuUtilTest_MessageHandler, INSTALLUILEVEL_NONE, NULL, &context, FALSE, &executeContext);
+                NativeAssert::Succeeded(hr, "Failed to initialize external UI.");
+                Assert::True(NULL != vpfnExternalUIRecord);
+
+                WiuUtilTest_SendRecord(&executeContext, INSTALLMESSAGE_INITIALIZE, countof(rgnField), rgnField);
+
+                // Without a filter every message is sent.
+                WiuUtilTest_SendRecord(&executeContext, INSTALLMESSAGE_ACTIONSTART, countof(rgnField), rgnField);
+                Assert::Equal<DWORD>(1, context.cActionStart);
+
+                WiuSetExternalUIMessageFilter(&executeContext, WIU_MSI_MESSAGE_FLAG(INSTALLMESSAGE_ACTIONSTART) | WIU_MSI_MESSAGE_FLAG(INSTALLMESSAGE_ERROR), 10);
+
+                // Ignored message types are dropped and answered like a BA that ignored them, the rest still go through.
+                Assert::Equal<INT>(IDNOACTION, WiuUtilTest_SendRecord(&executeContext, INSTALLMESSAGE_ACTIONSTART, countof(rgnField), rgnField));
+                Assert::Equal<DWORD>(1, context.cActionStart);
+
+                WiuUtilTest_SendRecord(&executeContext, INSTALLMESSAGE_ACTIONDATA, countof(rgnField), rgnField);
+                Assert::Equal<DWORD>(1, context.cActionData);
+
+                // Errors are never filtered.
+                WiuUtilTest_SendRecord(&executeContext, INSTALLMESSAGE_ERROR, countof(rgnField), rgnField);
+                Assert::Equal<DWORD>(1, context.cError);
+
+                for (DWORD i = 0; i < countof(rgcProgressFields); ++i)
+                {
+                    WiuUtilTest_SendRecord(&executeContext, INSTALLMESSAGE_PROGRESS, rgcProgressFields[i], rgrgnProgress[i]);
+                }
+
+                Assert::Equal<DWORD>(countof(rgdwExpectedProgress), context.cProgress);
+
+                for (DWORD i = 0; i < countof(rgdwExpectedProgress); ++i)
+                {
+                    Assert::Equal<DWORD>(rgdwExpectedProgress[i], context.rgdwProgress[i]);
+                }
+            }
+            finally
+            {
+                WiuUninitializeExternalUI(&executeContext);
+                WiuFunctionOverride(NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+                WiuUninitialize();
+                DutilUninitialize();
+            }
+        }
+    };
+}
+
+
+static UINT WINAPI WiuUtilTest_MsiSetExternalUIRecord(
+    __in_opt INSTALLUI_HANDLER_RECORD puiHandler,
+    __in DWORD /*dwMessageFilter*/,
+    __in_opt LPVOID /*pvContext*/,
+    __out_opt PINSTALLUI_HANDLER_RECORD ppuiPrevHandler
+    )
+{
+    vpfnExternalUIRecord = puiHandler;
+
+    if (ppuiPrevHandler)
+    {
+        *ppuiPrevHandler = NULL;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+
+static int WiuUtilTest_MessageHandler(
+    __in WIU_MSI_EXECUTE_MESSAGE* pMessage,
+    __in_opt LPVOID pvContext
+    )
+{
+    WIU_TEST_CONTEXT* pContext = static_cast<WIU_TEST_CONTEXT*>(pvContext);
+
+    switch (pMessage->type)
+    {
+    case WIU_MSI_EXECUTE_MESSAGE_PROGRESS:
+        if (pContext->cProgress < countof(pContext->rgdwProgress))
+        {
+            pContext->rgdwProgress[pContext->cProgress] = pMessage->progress.dwPercentage;
+        }
+        ++pContext->cProgress;
+        break;
+
+    case WIU_MSI_EXECUTE_MESSAGE_ERROR:
+        ++pContext->cError;
+        break;
+
+    case WIU_MSI_EXECUTE_MESSAGE_MSI_MESSAGE:
+        if (INSTALLMESSAGE_ACTIONSTART == pMessage->msiMessage.mt)
+        {
+            ++pContext->cActionStart;
+        }
+        else if (INSTALLMESSAGE_ACTIONDATA == pMessage->msiMessage.mt)
+        {
+            ++pContext->cActionData;
+        }
+        break;
+    }
+
+    return IDOK;
+}
+
+
+static INT WiuUtilTest_SendRecord(
+    __in WIU_MSI_EXECUTE_CONTEXT* pExecuteContext,
+    __in INSTALLMESSAGE mt,
+    __in DWORD cFields,
+    __in_ecount(cFields) INT* rgnFields
+    )
+{
+    INT nResult = IDNOACTION;
+    MSIHANDLE hRecord = ::MsiCreateRecord(cFields);
+
+    Assert::True(NULL != hRecord, "Failed to create record.");
+
+    for (DWORD i = 0; i < cFields; ++i)
+    {
+        ::MsiRecordSetInteger(hRecord, i + 1, rgnFields[i]);
+    }
+
+    nResult = vpfnExternalUIRecord(pExecuteContext, mt, hRecord);
+
+    ReleaseMsi(hRecord);
+
+    return nResult;
+}
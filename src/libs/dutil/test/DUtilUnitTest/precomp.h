@@ -6,6 +6,9 @@
 #include <strsafe.h>
 #include <ShlObj.h>
 #include <sddl.h>
+#include <ahadmin.h>
+#include <msi.h>
+#include <msiquery.h>
 
 // Include error.h before dutil.h
 #include <dutilsources.h>
@@ -20,6 +23,7 @@
 #include <envutil.h>
 #include <fileutil.h>
 #include <guidutil.h>
+#include <iis7util.h>
 #include <iniutil.h>
 #include <locutil.h>
 #include <memutil.h>
@@ -31,6 +35,7 @@
 #include <rssutil.h>
 #include <apuputil.h> // NOTE: this must come after atomutil.h and rssutil.h since it uses them.
 #include <uriutil.h>
+#include <wiutil.h>
 #include <xmlutil.h>
 
 #pragma managed
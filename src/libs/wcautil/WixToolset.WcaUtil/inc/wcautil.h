@@ -65,6 +65,24 @@ typedef enum WCA_ENCODING
     WCA_ENCODING_ANSI,
 } WCA_ENCODING;
 
+// Accumulates CustomActionData with an explicit length and capacity so appending a field
+// doesn't rescan everything written before it. pwzData is what's passed to WcaDoDeferredAction.
+typedef struct WCA_CADATA_BUILDER
+{
+    LPWSTR pwzData;
+    SIZE_T cchData;
+    SIZE_T cchAlloc;
+} WCA_CADATA_BUILDER;
+
+// Reads fields out of CustomActionData without modifying it.
+typedef struct WCA_CADATA_READER
+{
+    LPCWSTR wzData;
+    SIZE_T cchData;
+    SIZE_T ichNext;
+    BOOL fDone;
+} WCA_CADATA_READER;
+
 void WIXAPI WcaGlobalInitialize(
     __in HINSTANCE hInst
     );
@@ -291,6 +309,47 @@ HRESULT WIXAPI WcaWriteStreamToCaData(
     __deref_inout_z_opt LPWSTR* ppwzCustomActionData
     );
 
+HRESULT WIXAPI WcaCaDataBuilderWriteString(
+    __inout WCA_CADATA_BUILDER* pBuilder,
+    __in_z LPCWSTR wzString
+    );
+HRESULT WIXAPI WcaCaDataBuilderWriteInteger(
+    __inout WCA_CADATA_BUILDER* pBuilder,
+    __in int i
+    );
+HRESULT WIXAPI WcaCaDataBuilderWriteStream(
+    __inout WCA_CADATA_BUILDER* pBuilder,
+    __in_bcount(cbData) const BYTE* pbData,
+    __in SIZE_T cbData
+    );
+void WIXAPI WcaCaDataBuilderReset(
+    __inout WCA_CADATA_BUILDER* pBuilder
+    );
+void WIXAPI WcaCaDataBuilderUninitialize(
+    __inout WCA_CADATA_BUILDER* pBuilder
+    );
+
+void WIXAPI WcaCaDataReaderInitialize(
+    __out WCA_CADATA_READER* pReader,
+    __in_z_opt LPCWSTR wzCustomActionData
+    );
+BOOL WIXAPI WcaCaDataReaderHasMore(
+    __in const WCA_CADATA_READER* pReader
+    );
+HRESULT WIXAPI WcaCaDataReaderReadString(
+    __inout WCA_CADATA_READER* pReader,
+    __deref_out_z LPWSTR* ppwzString
+    );
+HRESULT WIXAPI WcaCaDataReaderReadInteger(
+    __inout WCA_CADATA_READER* pReader,
+    __out int* piResult
+    );
+HRESULT WIXAPI WcaCaDataReaderReadStream(
+    __inout WCA_CADATA_READER* pReader,
+    __deref_out_bcount(*pcbData) BYTE** ppbData,
+    __out DWORD_PTR* pcbData
+    );
+
 HRESULT __cdecl WcaAddTempRecord(
     __inout MSIHANDLE* phTableView,
     __inout MSIHANDLE* phColumns,
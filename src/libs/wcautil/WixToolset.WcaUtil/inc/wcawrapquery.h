@@ -57,6 +57,21 @@ typedef enum eFormatMaskColumn
     efmcColumn32 = 1 << 31,
 } eFormatMaskColumn;
 
+// Hash index over the string values of one column of an unwrapped query
+typedef struct WCA_WRAPQUERY_INDEX
+{
+    // Number of buckets, always a power of two
+    DWORD dwBuckets;
+
+    // Dynamic array of the first row (plus one, zero when empty) in each bucket
+    DWORD *pdwBucketRows;
+
+    // Dynamic arrays, one entry per row: the next row (plus one) in the same bucket, the hash and the string value
+    DWORD *pdwNextRows;
+    DWORD *pdwHashes;
+    LPWSTR *ppwzValues;
+} WCA_WRAPQUERY_INDEX;
+
 // Keeps track of the query instance for the reading CA (deferred CA)
 typedef struct WCA_WRAPQUERY_STRUCT
 {
@@ -69,6 +84,9 @@ typedef struct WCA_WRAPQUERY_STRUCT
 
     // Dynamic array of raw record data
     MSIHANDLE *phRecords;
+
+    // Dynamic array of per column indexes, built on demand by WcaFetchWrappedRecordWhereString
+    WCA_WRAPQUERY_INDEX *pIndexes;
 } *WCA_WRAPQUERY_HANDLE;
 
 // Wrap a query
@@ -115,6 +133,7 @@ HRESULT WIXAPI WcaFetchWrappedRecord(
     );
 
 // Fetch the next record in the query where the string value in column dwComparisonColumn equals the value pwzExpectedValue
+// The first search on a column builds a hash index over that column so later searches don't scan every record.
 // NOTE: the MSIHANDLE returned by this function should not be released, as it is the same handle used by the query object to maintain the item.
 //       so, don't use this function with PMSIHANDLE objects!
 HRESULT WIXAPI WcaFetchWrappedRecordWhereString(
@@ -124,6 +143,12 @@ HRESULT WIXAPI WcaFetchWrappedRecordWhereString(
     __out MSIHANDLE* phRec
     );
 
+// Build the hash index used by WcaFetchWrappedRecordWhereString for column dwColumn ahead of time
+HRESULT WIXAPI WcaIndexWrappedQueryColumn(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in DWORD dwColumn
+    );
+
 // Release a query ID (frees memory, and frees the ID for a new query)
 void WIXAPI WcaFinishUnwrapQuery(
     __in_opt WCA_WRAPQUERY_HANDLE hWrapQuery
@@ -1427,6 +1427,299 @@ LExit:
 }
 
 
+/********************************************************************
+WcaCaDataBuilderWriteString() - appends a string to CustomActionData
+being accumulated for a deferred CustomAction
+
+NOTE: produces the same data as WcaWriteStringToCaData()
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataBuilderWriteString(
+    __inout WCA_CADATA_BUILDER* pBuilder,
+    __in_z LPCWSTR wzString
+    )
+{
+    HRESULT hr = S_OK;
+    SIZE_T cchString = 0;
+    SIZE_T cchRequired = 0;
+    SIZE_T cchAlloc = 0;
+
+    if (!pBuilder)
+    {
+        ExitFunction1(hr = E_INVALIDARG);
+    }
+
+    hr = ::StringCchLengthW(wzString, STRSAFE_MAX_LENGTH, reinterpret_cast<size_t*>(&cchString));
+    ExitOnRootFailure(hr, "failed to get length of ca data string");
+
+    // if data exists the delimiter goes on before adding more to the end, plus the null terminator
+    cchRequired = pBuilder->cchData + (pBuilder->cchData ? 1 : 0) + cchString + 1;
+    if (cchRequired > STRSAFE_MAX_LENGTH)
+    {
+        ExitOnRootFailure(hr = STRSAFE_E_INSUFFICIENT_BUFFER, "CustomActionData is too long");
+    }
+
+    if (cchRequired > pBuilder->cchAlloc)
+    {
+        // grow geometrically so appending many fields stays linear
+        cchAlloc = max(pBuilder->cchAlloc * 2, cchRequired + 255);
+        cchAlloc = min(STRSAFE_MAX_LENGTH, cchAlloc);
+
+        hr = StrAlloc(&pBuilder->pwzData, cchAlloc);
+        ExitOnFailure(hr, "Failed to allocate memory for CustomActionData string");
+
+        pBuilder->cchAlloc = cchAlloc;
+    }
+
+    if (pBuilder->cchData)
+    {
+        pBuilder->pwzData[pBuilder->cchData] = MAGIC_MULTISZ_DELIM;
+        ++pBuilder->cchData;
+    }
+
+    ::CopyMemory(pBuilder->pwzData + pBuilder->cchData, wzString, cchString * sizeof(WCHAR));
+    pBuilder->cchData += cchString;
+    pBuilder->pwzData[pBuilder->cchData] = L'\0';
+
+LExit:
+    return hr;
+}
+
+
+/********************************************************************
+WcaCaDataBuilderWriteInteger() - appends an integer to CustomActionData
+being accumulated for a deferred CustomAction
+
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataBuilderWriteInteger(
+    __inout WCA_CADATA_BUILDER* pBuilder,
+    __in int i
+    )
+{
+    WCHAR wzBuffer[13];
+    HRESULT hr = StringCchPrintfW(wzBuffer, countof(wzBuffer), L"%d", i);
+    ExitOnFailure(hr, "failed to write integer to ca data");
+
+    hr = WcaCaDataBuilderWriteString(pBuilder, wzBuffer);
+    ExitOnFailure(hr, "failed to write integer to ca data");
+
+LExit:
+    return hr;
+}
+
+
+/********************************************************************
+WcaCaDataBuilderWriteStream() - appends a byte stream to CustomActionData
+being accumulated for a deferred CustomAction
+
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataBuilderWriteStream(
+    __inout WCA_CADATA_BUILDER* pBuilder,
+    __in_bcount(cbData) const BYTE* pbData,
+    __in SIZE_T cbData
+    )
+{
+    HRESULT hr;
+    LPWSTR pwzData = NULL;
+
+    hr = StrAllocBase85Encode(pbData, cbData, &pwzData);
+    ExitOnFailure(hr, "failed to encode data into string");
+
+    hr = WcaCaDataBuilderWriteString(pBuilder, pwzData);
+
+LExit:
+    ReleaseStr(pwzData);
+    return hr;
+}
+
+
+/********************************************************************
+WcaCaDataBuilderReset() - empties the CustomActionData, keeping the
+memory so the builder can be reused for the next deferred CustomAction
+
+********************************************************************/
+extern "C" void WIXAPI WcaCaDataBuilderReset(
+    __inout WCA_CADATA_BUILDER* pBuilder
+    )
+{
+    pBuilder->cchData = 0;
+    if (pBuilder->pwzData)
+    {
+        *pBuilder->pwzData = L'\0';
+    }
+}
+
+
+/********************************************************************
+WcaCaDataBuilderUninitialize() - frees the CustomActionData
+
+********************************************************************/
+extern "C" void WIXAPI WcaCaDataBuilderUninitialize(
+    __inout WCA_CADATA_BUILDER* pBuilder
+    )
+{
+    ReleaseStr(pBuilder->pwzData);
+    ::ZeroMemory(pBuilder, sizeof(WCA_CADATA_BUILDER));
+}
+
+
+/********************************************************************
+WcaCaDataReaderInitialize() - starts reading fields from the beginning
+of the CustomActionData
+
+NOTE: the CustomActionData must outlive the reader
+********************************************************************/
+extern "C" void WIXAPI WcaCaDataReaderInitialize(
+    __out WCA_CADATA_READER* pReader,
+    __in_z_opt LPCWSTR wzCustomActionData
+    )
+{
+    pReader->wzData = wzCustomActionData;
+    pReader->cchData = wzCustomActionData ? lstrlenW(wzCustomActionData) : 0;
+    pReader->ichNext = 0;
+    pReader->fDone = !wzCustomActionData;
+}
+
+
+/********************************************************************
+NextCaDataField() - internal helper to find the next field in the
+CustomActionData without modifying it
+
+********************************************************************/
+static BOOL NextCaDataField(
+    __inout WCA_CADATA_READER* pReader,
+    __out LPCWSTR* pwzField,
+    __out SIZE_T* pcchField
+    )
+{
+    if (pReader->fDone)
+    {
+        return FALSE;
+    }
+
+    LPCWSTR wzField = pReader->wzData + pReader->ichNext;
+    SIZE_T cchRemaining = pReader->cchData - pReader->ichNext;
+    const WCHAR* pwzDelim = wmemchr(wzField, MAGIC_MULTISZ_DELIM, cchRemaining);
+
+    *pwzField = wzField;
+    if (pwzDelim)
+    {
+        *pcchField = pwzDelim - wzField;
+        pReader->ichNext += *pcchField + 1;
+    }
+    else
+    {
+        // the last field
+        *pcchField = cchRemaining;
+        pReader->ichNext = pReader->cchData;
+        pReader->fDone = TRUE;
+    }
+
+    return TRUE;
+}
+
+
+/********************************************************************
+WcaCaDataReaderHasMore() - returns whether there is non-empty data
+left to read, like checking the pointer passed to WcaReadXxxFromCaData()
+
+********************************************************************/
+extern "C" BOOL WIXAPI WcaCaDataReaderHasMore(
+    __in const WCA_CADATA_READER* pReader
+    )
+{
+    return !pReader->fDone && pReader->ichNext < pReader->cchData;
+}
+
+
+/********************************************************************
+WcaCaDataReaderReadString() - reads the next string out of the
+CustomActionData
+
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataReaderReadString(
+    __inout WCA_CADATA_READER* pReader,
+    __deref_out_z LPWSTR* ppwzString
+    )
+{
+    HRESULT hr = S_OK;
+    LPCWSTR wzField = NULL;
+    SIZE_T cchField = 0;
+
+    if (!NextCaDataField(pReader, &wzField, &cchField))
+    {
+        return E_NOMOREITEMS;
+    }
+
+    if (cchField)
+    {
+        hr = StrAllocString(ppwzString, wzField, cchField);
+    }
+    else
+    {
+        hr = StrAllocString(ppwzString, L"", 0);
+    }
+    ExitOnFailure(hr, "failed to allocate memory for string");
+
+LExit:
+    return hr;
+}
+
+
+/********************************************************************
+WcaCaDataReaderReadInteger() - reads the next integer out of the
+CustomActionData
+
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataReaderReadInteger(
+    __inout WCA_CADATA_READER* pReader,
+    __out int* piResult
+    )
+{
+    LPCWSTR wzField = NULL;
+    SIZE_T cchField = 0;
+
+    if (!NextCaDataField(pReader, &wzField, &cchField) || !cchField)
+    {
+        return E_NOMOREITEMS;
+    }
+
+    // wcstol stops at the delimiter since it isn't a digit
+    *piResult = wcstol(wzField, NULL, 10);
+    return S_OK;
+}
+
+
+/********************************************************************
+WcaCaDataReaderReadStream() - reads the next stream out of the
+CustomActionData
+
+NOTE: returned stream should be freed with WcaFreeStream()
+********************************************************************/
+extern "C" HRESULT WIXAPI WcaCaDataReaderReadStream(
+    __inout WCA_CADATA_READER* pReader,
+    __deref_out_bcount(*pcbData) BYTE** ppbData,
+    __out DWORD_PTR* pcbData
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR pwzField = NULL;
+
+    hr = WcaCaDataReaderReadString(pReader, &pwzField);
+    if (E_NOMOREITEMS == hr)
+    {
+        ExitFunction();
+    }
+    ExitOnFailure(hr, "failed to read stream from ca data");
+
+    hr = StrAllocBase85Decode(pwzField, ppbData, pcbData);
+    ExitOnFailure(hr, "failed to decode string into stream");
+
+LExit:
+    ReleaseStr(pwzField);
+    return hr;
+}
+
+
 /********************************************************************
 WcaAddTempRecord - adds a temporary record to the active database
 
@@ -8,6 +8,15 @@ static const LPWSTR ISACTIONCOLUMNNAME = L"ISAction";
 static const LPWSTR SOURCEPATHCOLUMNNAME = L"SourcePath";
 static const LPWSTR TARGETPATHCOLUMNNAME = L"TargetPath";
 
+static HRESULT HashColumnValue(
+    __in_z LPCWSTR pwzValue,
+    __out DWORD* pdwHash
+    );
+static void ReleaseQueryIndex(
+    __in WCA_WRAPQUERY_INDEX* pIndex,
+    __in DWORD dwRows
+    );
+
 // This instantiates a new query object in the deferred CA, and returns the handle to the query
 WCA_WRAPQUERY_HANDLE WIXAPI GetNewQueryInstance(
     DWORD dwInColumns,
@@ -655,6 +664,36 @@ HRESULT WIXAPI WcaFetchWrappedRecordWhereString(
     HRESULT hr = S_OK;
     MSIHANDLE hRec = NULL;
     LPWSTR pwzData = NULL;
+    WCA_WRAPQUERY_INDEX* pIndex = NULL;
+    DWORD dwHash = 0;
+    DWORD dwRow = 0;
+
+    if (0 < dwComparisonColumn && dwComparisonColumn <= hWrapQuery->dwColumns)
+    {
+        hr = WcaIndexWrappedQueryColumn(hWrapQuery, dwComparisonColumn);
+        ExitOnFailure(hr, "Failed to index wrapped query column %d", dwComparisonColumn);
+
+        pIndex = hWrapQuery->pIndexes + dwComparisonColumn - 1;
+        hr = HashColumnValue(pwzExpectedValue, &dwHash);
+        ExitOnFailure(hr, "Failed to hash expected value for column %d", dwComparisonColumn);
+
+        // Rows are chained in ascending order, so the first match at or after the next index is the next record
+        for (DWORD dwRowPlusOne = pIndex->pdwBucketRows[dwHash & (pIndex->dwBuckets - 1)]; dwRowPlusOne; dwRowPlusOne = pIndex->pdwNextRows[dwRow])
+        {
+            dwRow = dwRowPlusOne - 1;
+
+            if (dwRow >= hWrapQuery->dwNextIndex && dwHash == pIndex->pdwHashes[dwRow] && 0 == lstrcmpW(pIndex->ppwzValues[dwRow], pwzExpectedValue))
+            {
+                hWrapQuery->dwNextIndex = dwRow;
+
+                hr = WcaFetchWrappedRecord(hWrapQuery, phRec);
+                ExitFunction();
+            }
+        }
+
+        hWrapQuery->dwNextIndex = hWrapQuery->dwRows;
+        ExitFunction1(hr = E_NOMOREITEMS);
+    }
 
     while (S_OK == (hr = WcaFetchWrappedRecord(hWrapQuery, &hRec)))
     {
@@ -681,6 +720,87 @@ LExit:
     return hr;
 }
 
+// Builds the hash index over the string values in column dwColumn, if it hasn't been built already
+HRESULT WIXAPI WcaIndexWrappedQueryColumn(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in DWORD dwColumn
+    )
+{
+    HRESULT hr = S_OK;
+    WCA_WRAPQUERY_INDEX* pIndex = NULL;
+    DWORD dwBucket = 0;
+
+    if (0 == dwColumn || dwColumn > hWrapQuery->dwColumns)
+    {
+        hr = E_INVALIDARG;
+        ExitOnFailure(hr, "Cannot index column %d of a wrapped query with %d columns", dwColumn, hWrapQuery->dwColumns);
+    }
+
+    if (NULL == hWrapQuery->pIndexes)
+    {
+        hWrapQuery->pIndexes = static_cast<WCA_WRAPQUERY_INDEX *>(MemAlloc(hWrapQuery->dwColumns * sizeof(WCA_WRAPQUERY_INDEX), TRUE));
+        ExitOnNull(hWrapQuery->pIndexes, hr, E_OUTOFMEMORY, "Failed to allocate wrapped query index array");
+    }
+
+    pIndex = hWrapQuery->pIndexes + dwColumn - 1;
+    if (NULL != pIndex->pdwBucketRows)
+    {
+        ExitFunction();
+    }
+
+    // Size the table to at least the number of rows so chains stay short
+    pIndex->dwBuckets = 1;
+    while (pIndex->dwBuckets < hWrapQuery->dwRows && pIndex->dwBuckets < 0x80000000)
+    {
+        pIndex->dwBuckets <<= 1;
+    }
+
+    pIndex->pdwBucketRows = static_cast<DWORD *>(MemAlloc(pIndex->dwBuckets * sizeof(DWORD), TRUE));
+    ExitOnNull(pIndex->pdwBucketRows, hr, E_OUTOFMEMORY, "Failed to allocate wrapped query index buckets");
+
+    if (0 != hWrapQuery->dwRows)
+    {
+        pIndex->pdwNextRows = static_cast<DWORD *>(MemAlloc(hWrapQuery->dwRows * sizeof(DWORD), TRUE));
+        ExitOnNull(pIndex->pdwNextRows, hr, E_OUTOFMEMORY, "Failed to allocate wrapped query index chains");
+
+        pIndex->pdwHashes = static_cast<DWORD *>(MemAlloc(hWrapQuery->dwRows * sizeof(DWORD), TRUE));
+        ExitOnNull(pIndex->pdwHashes, hr, E_OUTOFMEMORY, "Failed to allocate wrapped query index hashes");
+
+        pIndex->ppwzValues = static_cast<LPWSTR *>(MemAlloc(hWrapQuery->dwRows * sizeof(LPWSTR), TRUE));
+        ExitOnNull(pIndex->ppwzValues, hr, E_OUTOFMEMORY, "Failed to allocate wrapped query index values");
+    }
+
+    // Insert the rows in reverse so each bucket chain ends up in ascending row order
+    for (DWORD i = hWrapQuery->dwRows; 0 < i; --i)
+    {
+        DWORD dwRow = i - 1;
+
+        if (NULL == hWrapQuery->phRecords[dwRow])
+        {
+            hr = E_HANDLE;
+            ExitOnFailure(hr, "Failed to index wrapped record %d", dwRow);
+        }
+
+        hr = WcaGetRecordString(hWrapQuery->phRecords[dwRow], dwColumn, &pIndex->ppwzValues[dwRow]);
+        ExitOnFailure(hr, "Failed to get record string in column %d", dwColumn);
+
+        hr = HashColumnValue(pIndex->ppwzValues[dwRow], &pIndex->pdwHashes[dwRow]);
+        ExitOnFailure(hr, "Failed to hash record string in column %d", dwColumn);
+
+        dwBucket = pIndex->pdwHashes[dwRow] & (pIndex->dwBuckets - 1);
+        pIndex->pdwNextRows[dwRow] = pIndex->pdwBucketRows[dwBucket];
+        pIndex->pdwBucketRows[dwBucket] = dwRow + 1;
+    }
+
+LExit:
+    if (FAILED(hr) && NULL != pIndex)
+    {
+        ReleaseQueryIndex(pIndex, hWrapQuery->dwRows);
+    }
+
+    return hr;
+}
+
 /********************************************************************
 WcaBeginUnwrapQuery() - Finishes unwrapping a view for direct access
                         from the CustomActionData property
@@ -713,5 +833,89 @@ void WIXAPI WcaFinishUnwrapQuery(
     }
     ReleaseMem(hWrapQuery->phRecords);
 
+    if (NULL != hWrapQuery->pIndexes)
+    {
+        for (DWORD i=0;i<hWrapQuery->dwColumns;i++)
+        {
+            ReleaseQueryIndex(hWrapQuery->pIndexes + i, hWrapQuery->dwRows);
+        }
+        ReleaseMem(hWrapQuery->pIndexes);
+    }
+
     ReleaseMem(hWrapQuery);
 }
+
+// FNV-1a over the user locale sort key of a column value. Matches are confirmed with lstrcmpW,
+// which compares with the same sort keys, so strings it treats as equal always share a hash.
+static HRESULT HashColumnValue(
+    __in_z LPCWSTR pwzValue,
+    __out DWORD* pdwHash
+    )
+{
+    HRESULT hr = S_OK;
+    BYTE rgbSortKey[256];
+    BYTE* pbSortKey = rgbSortKey;
+    int cbSortKey = 0;
+    DWORD dwHash = 2166136261;
+
+    cbSortKey = ::LCMapStringW(LOCALE_USER_DEFAULT, LCMAP_SORTKEY, pwzValue, -1, reinterpret_cast<LPWSTR>(rgbSortKey), sizeof(rgbSortKey));
+    if (0 == cbSortKey)
+    {
+        if (ERROR_INSUFFICIENT_BUFFER != ::GetLastError())
+        {
+            ExitWithLastError(hr, "Failed to get sort key for value: %ls", pwzValue);
+        }
+
+        cbSortKey = ::LCMapStringW(LOCALE_USER_DEFAULT, LCMAP_SORTKEY, pwzValue, -1, NULL, 0);
+        if (0 == cbSortKey)
+        {
+            ExitWithLastError(hr, "Failed to get sort key size for value: %ls", pwzValue);
+        }
+
+        pbSortKey = static_cast<BYTE*>(MemAlloc(cbSortKey, FALSE));
+        ExitOnNull(pbSortKey, hr, E_OUTOFMEMORY, "Failed to allocate sort key");
+
+        cbSortKey = ::LCMapStringW(LOCALE_USER_DEFAULT, LCMAP_SORTKEY, pwzValue, -1, reinterpret_cast<LPWSTR>(pbSortKey), cbSortKey);
+        if (0 == cbSortKey)
+        {
+            ExitWithLastError(hr, "Failed to get sort key for value: %ls", pwzValue);
+        }
+    }
+
+    for (int i = 0; i < cbSortKey; ++i)
+    {
+        dwHash ^= static_cast<DWORD>(pbSortKey[i]);
+        dwHash *= 16777619;
+    }
+
+    *pdwHash = dwHash;
+
+LExit:
+    if (pbSortKey != rgbSortKey)
+    {
+        ReleaseMem(pbSortKey);
+    }
+
+    return hr;
+}
+
+static void ReleaseQueryIndex(
+    __in WCA_WRAPQUERY_INDEX* pIndex,
+    __in DWORD dwRows
+    )
+{
+    if (NULL != pIndex->ppwzValues)
+    {
+        for (DWORD i=0;i<dwRows;i++)
+        {
+            ReleaseStr(pIndex->ppwzValues[i]);
+        }
+    }
+
+    ReleaseMem(pIndex->ppwzValues);
+    ReleaseMem(pIndex->pdwHashes);
+    ReleaseMem(pIndex->pdwNextRows);
+    ReleaseMem(pIndex->pdwBucketRows);
+
+    ::ZeroMemory(pIndex, sizeof(WCA_WRAPQUERY_INDEX));
+}
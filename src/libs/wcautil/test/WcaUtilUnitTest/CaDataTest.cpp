@@ -0,0 +1,193 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixInternal::TestSupport;
+
+namespace WcaUtilTests
+{
+    public ref class CaData
+    {
+    public:
+        [Fact]
+        void CaDataBuilderMatchesLegacyWritersTest()
+        {
+            HRESULT hr = S_OK;
+            WCA_CADATA_BUILDER builder = { };
+            LPWSTR sczLegacy = NULL;
+            BYTE rgbStream[] = { 0x00, 0x01, 0x7F, 0x80, 0xFF };
+            WCHAR wzLong[300] = { };
+
+            for (DWORD i = 0; i < countof(wzLong) - 1; ++i)
+            {
+                wzLong[i] = static_cast<WCHAR>(L'a' + i % 26);
+            }
+
+            try
+            {
+                // An empty first field adds no delimiter in the legacy writer, so the builder must not either.
+                hr = WcaWriteStringToCaData(L"", &sczLegacy);
+                NativeAssert::Succeeded(hr, "Failed to write empty string with legacy writer.");
+                hr = WcaCaDataBuilderWriteString(&builder, L"");
+                NativeAssert::Succeeded(hr, "Failed to write empty string with builder.");
+
+                // Enough fields to grow the builder several times.
+                for (DWORD i = 0; i < 50; ++i)
+                {
+                    hr = WcaWriteStringToCaData(L"field", &sczLegacy);
+                    NativeAssert::Succeeded(hr, "Failed to write string with legacy writer.");
+                    hr = WcaCaDataBuilderWriteString(&builder, L"field");
+                    NativeAssert::Succeeded(hr, "Failed to write string with builder.");
+
+                    hr = WcaWriteIntegerToCaData(static_cast<int>(i) - 25, &sczLegacy);
+                    NativeAssert::Succeeded(hr, "Failed to write integer with legacy writer.");
+                    hr = WcaCaDataBuilderWriteInteger(&builder, static_cast<int>(i) - 25);
+                    NativeAssert::Succeeded(hr, "Failed to write integer with builder.");
+
+                    hr = WcaWriteStringToCaData(L"", &sczLegacy);
+                    NativeAssert::Succeeded(hr, "Failed to write empty string with legacy writer.");
+                    hr = WcaCaDataBuilderWriteString(&builder, L"");
+                    NativeAssert::Succeeded(hr, "Failed to write empty string with builder.");
+
+                    hr = WcaWriteStreamToCaData(rgbStream, countof(rgbStream), &sczLegacy);
+                    NativeAssert::Succeeded(hr, "Failed to write stream with legacy writer.");
+                    hr = WcaCaDataBuilderWriteStream(&builder, rgbStream, countof(rgbStream));
+                    NativeAssert::Succeeded(hr, "Failed to write stream with builder.");
+
+                    hr = WcaWriteStringToCaData(wzLong, &sczLegacy);
+                    NativeAssert::Succeeded(hr, "Failed to write long string with legacy writer.");
+                    hr = WcaCaDataBuilderWriteString(&builder, wzLong);
+                    NativeAssert::Succeeded(hr, "Failed to write long string with builder.");
+                }
+
+                NativeAssert::StringEqual(sczLegacy, builder.pwzData);
+                Assert::Equal<SIZE_T>(lstrlenW(sczLegacy), builder.cchData);
+                Assert::True(builder.cchData < builder.cchAlloc);
+
+                // Reset keeps the buffer and starts over without a leading delimiter.
+                WcaCaDataBuilderReset(&builder);
+                Assert::Equal<SIZE_T>(0, builder.cchData);
+                Assert::True(NULL != builder.pwzData);
+
+                hr = WcaCaDataBuilderWriteString(&builder, L"z");
+                NativeAssert::Succeeded(hr, "Failed to write string after reset.");
+                NativeAssert::StringEqual(L"z", builder.pwzData);
+            }
+            finally
+            {
+                ReleaseStr(sczLegacy);
+                WcaCaDataBuilderUninitialize(&builder);
+            }
+
+            Assert::True(NULL == builder.pwzData);
+        }
+
+        [Fact]
+        void CaDataReaderMatchesLegacyReadersTest()
+        {
+            HRESULT hr = S_OK;
+            WCA_CADATA_BUILDER builder = { };
+            WCA_CADATA_READER reader = { };
+            LPWSTR sczCopy = NULL;
+            LPWSTR pwzLegacy = NULL;
+            LPWSTR sczLegacyValue = NULL;
+            LPWSTR sczValue = NULL;
+            BYTE* pbLegacy = NULL;
+            BYTE* pbValue = NULL;
+            DWORD_PTR cbLegacy = 0;
+            DWORD_PTR cbValue = 0;
+            int iLegacy = 0;
+            int iValue = 0;
+            BYTE rgbStream[] = { 0x00, 0x01, 0x7F, 0x80, 0xFF };
+
+            try
+            {
+                hr = WcaCaDataBuilderWriteString(&builder, L"first");
+                NativeAssert::Succeeded(hr, "Failed to write first string.");
+                hr = WcaCaDataBuilderWriteInteger(&builder, 42);
+                NativeAssert::Succeeded(hr, "Failed to write integer.");
+                hr = WcaCaDataBuilderWriteString(&builder, L"");
+                NativeAssert::Succeeded(hr, "Failed to write empty string.");
+                hr = WcaCaDataBuilderWriteInteger(&builder, -7);
+                NativeAssert::Succeeded(hr, "Failed to write negative integer.");
+                hr = WcaCaDataBuilderWriteStream(&builder, rgbStream, countof(rgbStream));
+                NativeAssert::Succeeded(hr, "Failed to write stream.");
+                hr = WcaCaDataBuilderWriteString(&builder, L"");
+                NativeAssert::Succeeded(hr, "Failed to write empty field.");
+                hr = WcaCaDataBuilderWriteString(&builder, L"last");
+                NativeAssert::Succeeded(hr, "Failed to write last string.");
+
+                // The legacy readers break the data apart in place, so they get a copy.
+                hr = StrAllocString(&sczCopy, builder.pwzData, 0);
+                NativeAssert::Succeeded(hr, "Failed to copy custom action data.");
+                pwzLegacy = sczCopy;
+
+                WcaCaDataReaderInitialize(&reader, builder.pwzData);
+                Assert::True(WcaCaDataReaderHasMore(&reader));
+
+                NativeAssert::Succeeded(WcaReadStringFromCaData(&pwzLegacy, &sczLegacyValue), "Failed to read first string with legacy reader.");
+                NativeAssert::Succeeded(WcaCaDataReaderReadString(&reader, &sczValue), "Failed to read first string.");
+                NativeAssert::StringEqual(sczLegacyValue, sczValue);
+                NativeAssert::StringEqual(L"first", sczValue);
+
+                NativeAssert::Succeeded(WcaReadIntegerFromCaData(&pwzLegacy, &iLegacy), "Failed to read integer with legacy reader.");
+                NativeAssert::Succeeded(WcaCaDataReaderReadInteger(&reader, &iValue), "Failed to read integer.");
+                Assert::Equal(iLegacy, iValue);
+                Assert::Equal(42, iValue);
+
+                NativeAssert::Succeeded(WcaReadStringFromCaData(&pwzLegacy, &sczLegacyValue), "Failed to read empty string with legacy reader.");
+                NativeAssert::Succeeded(WcaCaDataReaderReadString(&reader, &sczValue), "Failed to read empty string.");
+                NativeAssert::StringEqual(sczLegacyValue, sczValue);
+                NativeAssert::StringEqual(L"", sczValue);
+
+                NativeAssert::Succeeded(WcaReadIntegerFromCaData(&pwzLegacy, &iLegacy), "Failed to read negative integer with legacy reader.");
+                NativeAssert::Succeeded(WcaCaDataReaderReadInteger(&reader, &iValue), "Failed to read negative integer.");
+                Assert::Equal(iLegacy, iValue);
+                Assert::Equal(-7, iValue);
+
+                NativeAssert::Succeeded(WcaReadStreamFromCaData(&pwzLegacy, &pbLegacy, &cbLegacy), "Failed to read stream with legacy reader.");
+                NativeAssert::Succeeded(WcaCaDataReaderReadStream(&reader, &pbValue, &cbValue), "Failed to read stream.");
+                Assert::Equal<DWORD_PTR>(cbLegacy, cbValue);
+                Assert::Equal<DWORD_PTR>(countof(rgbStream), cbValue);
+                Assert::Equal(0, memcmp(rgbStream, pbValue, countof(rgbStream)));
+
+                // Reading an integer from an empty field fails the same way and still moves past it.
+                Assert::Equal<HRESULT>(E_NOMOREITEMS, WcaReadIntegerFromCaData(&pwzLegacy, &iLegacy));
+                Assert::Equal<HRESULT>(E_NOMOREITEMS, WcaCaDataReaderReadInteger(&reader, &iValue));
+
+                NativeAssert::Succeeded(WcaReadStringFromCaData(&pwzLegacy, &sczLegacyValue), "Failed to read last string with legacy reader.");
+                NativeAssert::Succeeded(WcaCaDataReaderReadString(&reader, &sczValue), "Failed to read last string.");
+                NativeAssert::StringEqual(sczLegacyValue, sczValue);
+                NativeAssert::StringEqual(L"last", sczValue);
+
+                Assert::False(WcaCaDataReaderHasMore(&reader));
+                Assert::Equal<HRESULT>(E_NOMOREITEMS, WcaReadStringFromCaData(&pwzLegacy, &sczLegacyValue));
+                Assert::Equal<HRESULT>(E_NOMOREITEMS, WcaCaDataReaderReadString(&reader, &sczValue));
+
+                // The reader leaves the data alone.
+                Assert::Equal<SIZE_T>(builder.cchData, lstrlenW(builder.pwzData));
+
+                WcaCaDataReaderInitialize(&reader, NULL);
+                Assert::False(WcaCaDataReaderHasMore(&reader));
+                Assert::Equal<HRESULT>(E_NOMOREITEMS, WcaCaDataReaderReadString(&reader, &sczValue));
+            }
+            finally
+            {
+                if (pbLegacy)
+                {
+                    WcaFreeStream(pbLegacy);
+                }
+                if (pbValue)
+                {
+                    WcaFreeStream(pbValue);
+                }
+                ReleaseStr(sczValue);
+                ReleaseStr(sczLegacyValue);
+                ReleaseStr(sczCopy);
+                WcaCaDataBuilderUninitialize(&builder);
+            }
+        }
+    };
+}
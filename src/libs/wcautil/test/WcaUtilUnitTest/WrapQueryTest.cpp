@@ -0,0 +1,251 @@
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+#include "precomp.h"
+
+using namespace System;
+using namespace Xunit;
+using namespace WixInternal::TestSupport;
+
+struct WRAP_QUERY_TEST_ROW
+{
+    LPCWSTR wzKey;
+    LPCWSTR wzValue;
+};
+
+static void WrapQueryTest_Unwrap(
+    __in_ecount(cRows) const WRAP_QUERY_TEST_ROW* rgRows,
+    __in DWORD cRows,
+    __out WCA_WRAPQUERY_HANDLE* phWrapQuery
+    );
+static int WrapQueryTest_FetchWhere(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in DWORD dwColumn,
+    __in_z LPCWSTR wzValue
+    );
+
+namespace WcaUtilTests
+{
+    public ref class WrapQuery
+    {
+    public:
+        [Fact]
+        void WrapQueryFetchWhereStringFollowsCursorTest()
+        {
+            WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
+            WRAP_QUERY_TEST_ROW rgRows[] =
+            {
+                { L"A", L"Site1" },
+                { L"B", L"Site2" },
+                { L"A", L"Site3" },
+                { L"a", L"Site4" },
+                { L"C", L"Site5" },
+                { L"A", L"Site6" },
+            };
+
+            try
+            {
+                WrapQueryTest_Unwrap(rgRows, countof(rgRows), &hWrapQuery);
+                Assert::Equal<DWORD>(countof(rgRows), WcaGetQueryRecords(hWrapQuery));
+
+                // Every match comes back in row order, then the search runs off the end.
+                Assert::Equal(0, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"A"));
+                Assert::Equal(2, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"A"));
+                Assert::Equal(5, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"A"));
+                Assert::Equal(-1, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"A"));
+
+                // Like the old scan, a miss leaves the cursor at the end.
+                WcaFetchWrappedReset(hWrapQuery);
+                Assert::Equal(-1, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"Z"));
+                Assert::Equal(-1, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"B"));
+
+                // Searches start at the current fetch position, not at the last match.
+                WcaFetchWrappedReset(hWrapQuery);
+                for (DWORD i = 0; i < 3; ++i)
+                {
+                    MSIHANDLE hRec = NULL;
+                    NativeAssert::Succeeded(WcaFetchWrappedRecord(hWrapQuery, &hRec), "Failed to fetch wrapped record.");
+                }
+                Assert::Equal(5, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"A"));
+
+                // Values are compared with lstrcmpW, which is case-sensitive.
+                WcaFetchWrappedReset(hWrapQuery);
+                Assert::Equal(3, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"a"));
+                Assert::Equal(-1, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"a"));
+
+                // A second column gets its own index.
+                WcaFetchWrappedReset(hWrapQuery);
+                Assert::Equal(4, WrapQueryTest_FetchWhere(hWrapQuery, 2, L"Site5"));
+                Assert::Equal(5, WrapQueryTest_FetchWhere(hWrapQuery, 1, L"A"));
+            }
+            finally
+            {
+                WcaFinishUnwrapQuery(hWrapQuery);
+            }
+        }
+
+        [Fact]
+        void WrapQueryFetchWhereStringMatchesLinearScanTest()
+        {
+            HRESULT hr = S_OK;
+            WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
+            LPCWSTR rgwzValues[] = { L"caf\x00E9", L"cafe\x0301", L"co-op", L"coop", L"", L"Key", L"KEY" };
+            WRAP_QUERY_TEST_ROW rgRows[countof(rgwzValues) * 3] = { };
+
+            for (DWORD i = 0; i < countof(rgRows); ++i)
+            {
+                rgRows[i].wzKey = rgwzValues[(i * 5) % countof(rgwzValues)];
+                rgRows[i].wzValue = L"";
+            }
+
+            try
+            {
+                WrapQueryTest_Unwrap(rgRows, countof(rgRows), &hWrapQuery);
+
+                hr = WcaIndexWrappedQueryColumn(hWrapQuery, 1);
+                NativeAssert::Succeeded(hr, "Failed to index column 1.");
+
+                // Whatever lstrcmpW treats as equal in this locale must share a bucket, so the index
+                // returns exactly the rows a linear scan with lstrcmpW would.
+                for (DWORD i = 0; i < countof(rgwzValues); ++i)
+                {
+                    WcaFetchWrappedReset(hWrapQuery);
+
+                    for (DWORD j = 0; j < countof(rgRows); ++j)
+                    {
+                        if (0 == lstrcmpW(rgRows[j].wzKey, rgwzValues[i]))
+                        {
+                            Assert::Equal<int>(j, WrapQueryTest_FetchWhere(hWrapQuery, 1, rgwzValues[i]));
+                        }
+                    }
+
+                    Assert::Equal(-1, WrapQueryTest_FetchWhere(hWrapQuery, 1, rgwzValues[i]));
+                }
+            }
+            finally
+            {
+                WcaFinishUnwrapQuery(hWrapQuery);
+            }
+        }
+
+        [Fact]
+        void WrapQueryIndexRejectsInvalidColumnTest()
+        {
+            WCA_WRAPQUERY_HANDLE hWrapQuery = NULL;
+            WRAP_QUERY_TEST_ROW rgRows[] =
+            {
+                { L"A", L"Site1" },
+            };
+
+            try
+            {
+                WrapQueryTest_Unwrap(rgRows, countof(rgRows), &hWrapQuery);
+
+                Assert::Equal<HRESULT>(E_INVALIDARG, WcaIndexWrappedQueryColumn(hWrapQuery, 0));
+                Assert::Equal<HRESULT>(E_INVALIDARG, WcaIndexWrappedQueryColumn(hWrapQuery, 4));
+            }
+            finally
+            {
+                WcaFinishUnwrapQuery(hWrapQuery);
+            }
+        }
+    };
+}
+
+
+static void WrapQueryTest_Unwrap(
+    __in_ecount(cRows) const WRAP_QUERY_TEST_ROW* rgRows,
+    __in DWORD cRows,
+    __out WCA_WRAPQUERY_HANDLE* phWrapQuery
+    )
+{
+    HRESULT hr = S_OK;
+    LPWSTR sczData = NULL;
+    LPWSTR pwzData = NULL;
+
+    // Same layout WcaWrapQuery writes: two string columns and an integer column holding the row number.
+    hr = WcaWriteIntegerToCaData(wqaTableBegin, &sczData);
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteIntegerToCaData(3, &sczData);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteIntegerToCaData(static_cast<int>(cRows), &sczData);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteStringToCaData(L"Key", &sczData);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteIntegerToCaData(cdtString, &sczData);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteStringToCaData(L"Value", &sczData);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteIntegerToCaData(cdtString, &sczData);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteStringToCaData(L"Row", &sczData);
+    }
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteIntegerToCaData(cdtInt, &sczData);
+    }
+
+    for (DWORD i = 0; SUCCEEDED(hr) && i < cRows; ++i)
+    {
+        hr = WcaWriteIntegerToCaData(wqaRowBegin, &sczData);
+        if (SUCCEEDED(hr))
+        {
+            hr = WcaWriteStringToCaData(rgRows[i].wzKey, &sczData);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = WcaWriteStringToCaData(rgRows[i].wzValue, &sczData);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = WcaWriteIntegerToCaData(static_cast<int>(i), &sczData);
+        }
+        if (SUCCEEDED(hr))
+        {
+            hr = WcaWriteIntegerToCaData(wqaRowFinish, &sczData);
+        }
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        hr = WcaWriteIntegerToCaData(wqaTableFinish, &sczData);
+    }
+    NativeAssert::Succeeded(hr, "Failed to write wrapped query to custom action data.");
+
+    // Unwrapping breaks the data apart in place and moves the pointer along.
+    pwzData = sczData;
+    hr = WcaBeginUnwrapQuery(phWrapQuery, &pwzData);
+    ReleaseStr(sczData);
+    NativeAssert::Succeeded(hr, "Failed to unwrap query.");
+}
+
+static int WrapQueryTest_FetchWhere(
+    __in WCA_WRAPQUERY_HANDLE hWrapQuery,
+    __in DWORD dwColumn,
+    __in_z LPCWSTR wzValue
+    )
+{
+    MSIHANDLE hRec = NULL;
+    HRESULT hr = WcaFetchWrappedRecordWhereString(hWrapQuery, dwColumn, wzValue, &hRec);
+
+    if (E_NOMOREITEMS == hr)
+    {
+        return -1;
+    }
+
+    NativeAssert::Succeeded(hr, "Failed to fetch wrapped record with value: {0}", wzValue);
+
+    return ::MsiRecordGetInteger(hRec, 3);
+}
@@ -0,0 +1,16 @@
+#pragma once
+// Copyright (c) .NET Foundation and contributors. All rights reserved. Licensed under the Microsoft Reciprocal License. See LICENSE.TXT file in the project root for full license information.
+
+
+#include <windows.h>
+#include <strsafe.h>
+#include <msi.h>
+#include <msiquery.h>
+
+#include <wcautil.h>
+#include <wcawrapquery.h>
+#include <memutil.h>
+#include <strutil.h>
+
+#pragma managed
+#include <vcclr.h>
@@ -451,6 +451,11 @@ namespace WixToolset.Core.Burn.Bundles
                         {
                             writer.WriteAttributeString("Bundle", "yes");
                         }
+
+                        if (exePackage.Independent)
+                        {
+                            writer.WriteAttributeString("Independent", "yes");
+                        }
                     }
                     else if (package.SpecificPackageSymbol is WixBundleMsiPackageSymbol msiPackage) // MSI
                     {
@@ -1995,6 +1995,7 @@ namespace WixToolset.Core
             var forcePerMachine = YesNoType.NotSet;
             CompilerPackagePayload childCompilerPackagePayload = null;
             var bundle = YesNoType.NotSet;
+            var independent = YesNoType.NotSet;
             var slipstream = YesNoType.NotSet;
             var hasPayloadInfo = false;
             WixBundleExePackageDetectionType? exeDetectionType = WixBundleExePackageDetectionType.None;
@@ -2098,6 +2099,10 @@ namespace WixToolset.Core
                             bundle = this.Core.GetAttributeYesNoValue(sourceLineNumbers, attrib);
                             allowed = (packageType == WixBundlePackageType.Exe);
                             break;
+                        case "Independent":
+                            independent = this.Core.GetAttributeYesNoValue(sourceLineNumbers, attrib);
+                            allowed = (packageType == WixBundlePackageType.Exe);
+                            break;
                         case "InstallArguments":
                             installArguments = this.Core.GetAttributeValue(sourceLineNumbers, attrib);
                             allowed = (packageType == WixBundlePackageType.Bundle || packageType == WixBundlePackageType.Exe);
@@ -2421,6 +2426,19 @@ namespace WixToolset.Core
                 {
                     protocol = "burn";
                 }
+
+                // Independent packages are launched next to each other, which the burn and netfx4 protocols don't support.
+                if (independent == YesNoType.Yes)
+                {
+                    if (bundle == YesNoType.Yes)
+                    {
+                        this.Core.Write(ErrorMessages.IllegalAttributeValueWithOtherAttribute(sourceLineNumbers, node.Name.LocalName, "Independent", "yes", "Bundle", "yes"));
+                    }
+                    else if (!String.IsNullOrEmpty(protocol) && !protocol.Equals("none", StringComparison.Ordinal))
+                    {
+                        this.Core.Write(ErrorMessages.IllegalAttributeValueWithOtherAttribute(sourceLineNumbers, node.Name.LocalName, "Independent", "yes", "Protocol", protocol));
+                    }
+                }
             }
             else if (packageType == WixBundlePackageType.Msp)
             {
@@ -2497,6 +2515,7 @@ namespace WixToolset.Core
                         WixBundleExePackageAttributes exeAttributes = 0;
                         exeAttributes |= (YesNoType.Yes == bundle) ? WixBundleExePackageAttributes.Bundle : 0;
                         exeAttributes |= (YesNoType.Yes == arpWin64) ? WixBundleExePackageAttributes.ArpWin64 : 0;
+                        exeAttributes |= (YesNoType.Yes == independent) ? WixBundleExePackageAttributes.Independent : 0;
 
                         this.Core.AddSymbol(new WixBundleExePackageSymbol(sourceLineNumbers, id)
                         {